@@ -90,6 +90,52 @@ EventParam AnalyzeEvent(PRadHyCalSystem *sys, const EventData &event, double thr
     return res;
 }
 
+// the same parameters from the groups formed by the island reconstruction,
+// it saves the second grouping of the modules, but the groups are from the
+// reconstruction threshold and adjacency, so the values are slightly different
+// from AnalyzeEvent, the networks trained with AnalyzeEvent should not use it
+// the reconstructor should keep the groups, see SetKeepGroups
+EventParam AnalyzeGroups(PRadHyCalSystem *sys, const EventData &event)
+{
+    EventParam res;
+    sys->Reconstruct(event);
+
+    auto &ctx = sys->GetReconstructor()->GetClusterContext();
+    res.n_groups = (ctx.group_info.size() > 100) ? 100 : ctx.group_info.size();
+
+    const GroupInfo *m_group = nullptr;
+    for(size_t i = 0; i < ctx.group_info.size(); ++i)
+    {
+        auto &info = ctx.group_info.at(i);
+        if(i < res.n_groups)
+            res.group_hits[i] = info.shape.nhits;
+
+        res.group_size += info.shape.nhits;
+        res.group_energy.total += info.shape.energy;
+        if(info.shape.max_energy > res.group_energy.maximum)
+            res.group_energy.maximum = info.shape.max_energy;
+
+        if(!m_group || info.shape.nhits > m_group->shape.nhits)
+            m_group = &info;
+    }
+
+    if(!m_group)
+        return res;
+
+    auto &shape = m_group->shape;
+    res.max_group_size = shape.nhits;
+    res.max_group_energy.total = shape.energy;
+    res.max_group_energy.maximum = shape.max_energy;
+    res.max_group_energy.uniform = shape.uniform;
+    res.max_group_line.success = (shape.nhits < 3) ? -1 : 1;
+    res.max_group_line.k = shape.k;
+    res.max_group_line.b = shape.b;
+    res.max_group_line.rsq = shape.rsq;
+    res.max_group_line.chisq = shape.chisq;
+
+    return res;
+}
+
 // fill fired modules with energy larger than threshold
 void GetFiredModules(const PRadHyCalDetector *det, std::vector<PRadHyCalModule*> &m, double thres)
 {
@@ -0,0 +1,456 @@
+//============================================================================//
+// Benchmarks of the hot paths with fixed reference samples                   //
+// Every benchmark is repeated, the throughput, time and allocations per      //
+// event are reported in a JSON file, so the versions can be compared         //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDataHandler.h"
+#include "PRadDSTParser.h"
+#include "PRadInfoCenter.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadCoordSystem.h"
+#include "PRadDetMatch.h"
+#include "PRadProfiler.h"
+#include "PRadMemoryTracker.h"
+#include "ConfigOption.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// default number of repetitions of each benchmark
+#define BENCH_REPEATS 10
+// default maximum number of physics events taken from the reference DST
+#define BENCH_MAX_EVENTS 20000
+
+using namespace std;
+
+// allocation counter, only the allocations in the timed parts are counted
+static atomic<bool> count_alloc(false);
+static atomic<uint64_t> alloc_count(0);
+
+void *operator new(size_t size)
+{
+    if(count_alloc.load(memory_order_relaxed))
+        alloc_count.fetch_add(1, memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if(!p)
+        throw bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// timer of the measured parts, it can be started and stopped several times
+// in one repetition to exclude the preparations
+class BenchTimer
+{
+public:
+    typedef chrono::steady_clock Clock;
+
+    BenchTimer() : elapsed(0), allocs(0) {}
+
+    void Start()
+    {
+        alloc_count = 0;
+        count_alloc = true;
+        start = Clock::now();
+    }
+
+    void Stop()
+    {
+        auto end = Clock::now();
+        count_alloc = false;
+        elapsed += chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+        allocs += alloc_count;
+    }
+
+    uint64_t GetElapsed() const {return elapsed;}
+    uint64_t GetAllocs() const {return allocs;}
+
+private:
+    Clock::time_point start;
+    uint64_t elapsed, allocs;
+};
+
+struct BenchResult
+{
+    string name;
+    uint64_t events;
+    vector<double> ns_per_event, allocs_per_event;
+};
+
+// a benchmark returns the number of events processed in one repetition
+typedef function<uint64_t(BenchTimer &)> BenchFunc;
+
+BenchResult runBench(const string &name, unsigned int repeats, const BenchFunc &func);
+double percentile(vector<double> vals, double p);
+void writeResults(ostream &os, const string &evio, const string &dst,
+                  unsigned int repeats, const vector<BenchResult> &results);
+
+int main(int argc, char *argv[])
+{
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_require, 'r');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'n');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'o');
+    conf_opt.AddOpt(ConfigOption::arg_none, 'p');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: benchPerform <reference_evio> <reference_dst>");
+    conf_opt.SetDesc('r', "number of repetitions of each benchmark, default 10.");
+    conf_opt.SetDesc('n', "maximum number of physics events from the DST sample, default 20000.");
+    conf_opt.SetDesc('o', "output JSON file, default prints to the standard output.");
+    conf_opt.SetDesc('p', "print the profiler and memory summary, the timing needs the library built with LIB_OPTION PROFILE.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() != 2) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    string evio_file = conf_opt.GetArgument(0).String();
+    string dst_file = conf_opt.GetArgument(1).String();
+    unsigned int repeats = BENCH_REPEATS;
+    unsigned int max_events = BENCH_MAX_EVENTS;
+    string output;
+    bool profile = false;
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 'r':
+            repeats = max(1, opt.var.Int());
+            break;
+        case 'n':
+            max_events = opt.var.Int();
+            break;
+        case 'o':
+            output = opt.var.String();
+            break;
+        case 'p':
+            profile = true;
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    PRadDataHandler *handler = new PRadDataHandler();
+    PRadHyCalSystem *hycal = new PRadHyCalSystem("config/hycal.conf");
+    PRadGEMSystem *gem = new PRadGEMSystem("config/gem.conf");
+    PRadCoordSystem *coord_sys = new PRadCoordSystem("database/coordinates.dat");
+    PRadDetMatch *det_match = new PRadDetMatch("config/det_match.conf");
+
+    handler->SetHyCalSystem(hycal);
+    handler->SetGEMSystem(gem);
+    handler->InitializeByData(evio_file);
+    coord_sys->ChooseCoord(PRadInfoCenter::GetRunNumber());
+
+    // the results should be computed every time
+    hycal->GetReconstructor()->SetCacheSize(0);
+    gem->SetCacheSize(0);
+
+    // the reference events are kept in memory for the compute benchmarks
+    vector<EventData> events;
+    PRadDSTParser dst_parser;
+    dst_parser.OpenInput(dst_file);
+    while(dst_parser.Read() && events.size() < max_events)
+    {
+        if(dst_parser.EventType() == PRadDSTParser::Type::event &&
+           dst_parser.GetCurrentEvent().is_physics_event())
+            events.push_back(dst_parser.GetCurrentEvent());
+    }
+    dst_parser.CloseInput();
+
+    if(events.empty()) {
+        cerr << "Bench Error: no physics events in " << dst_file << endl;
+        return -1;
+    }
+
+    vector<BenchResult> results;
+
+    // decoding, the events are kept by the handler
+    results.push_back(runBench("evio_decode", repeats,
+        [&] (BenchTimer &timer)
+        {
+            handler->Clear();
+            timer.Start();
+            handler->ReadFromEvio(evio_file);
+            timer.Stop();
+            uint64_t count = handler->GetEventCount();
+            handler->Clear();
+            return count;
+        }));
+
+    results.push_back(runBench("dst_read", repeats,
+        [&] (BenchTimer &timer)
+        {
+            PRadDSTParser parser;
+            parser.OpenInput(dst_file);
+            uint64_t count = 0;
+            timer.Start();
+            while(parser.Read() && count < max_events)
+            {
+                if(parser.EventType() == PRadDSTParser::Type::event)
+                    ++count;
+            }
+            timer.Stop();
+            parser.CloseInput();
+            return count;
+        }));
+
+    string temp_dst = output.empty() ? "bench_temp.dst" : output + ".temp.dst";
+    results.push_back(runBench("dst_write", repeats,
+        [&] (BenchTimer &timer)
+        {
+            PRadDSTParser parser;
+            parser.OpenOutput(temp_dst);
+            timer.Start();
+            for(auto &event : events)
+                parser.Write(event);
+            parser.CloseOutput();
+            timer.Stop();
+            return events.size();
+        }));
+    remove(temp_dst.c_str());
+
+    // HyCal clustering methods
+    for(auto &method : hycal->GetReconstructor()->GetClusterMethodNames())
+    {
+        hycal->GetReconstructor()->SetClusterMethod(method);
+        results.push_back(runBench("hycal_" + method, repeats,
+            [&] (BenchTimer &timer)
+            {
+                timer.Start();
+                for(auto &event : events)
+                    hycal->Reconstruct(event);
+                timer.Stop();
+                return events.size();
+            }));
+    }
+
+    // leakage correction on the clusters from island
+    hycal->GetReconstructor()->SetClusterMethod("Island");
+    vector<vector<ModuleCluster>> clusters;
+    for(auto &event : events)
+    {
+        hycal->Reconstruct(event);
+        clusters.push_back(hycal->GetReconstructor()->GetClusters());
+    }
+
+    results.push_back(runBench("hycal_leak_corr", repeats,
+        [&] (BenchTimer &timer)
+        {
+            // the correction changes the clusters
+            auto work = clusters;
+            timer.Start();
+            for(auto &event_clusters : work)
+            {
+                for(auto &cluster : event_clusters)
+                    hycal->GetReconstructor()->LeakCorr(cluster);
+            }
+            timer.Stop();
+            return work.size();
+        }));
+
+    // GEM zero suppression (filling the strip hits) and clustering
+    results.push_back(runBench("gem_zero_suppression", repeats,
+        [&] (BenchTimer &timer)
+        {
+            timer.Start();
+            for(auto &event : events)
+                gem->ChooseEvent(event);
+            timer.Stop();
+            return events.size();
+        }));
+
+    results.push_back(runBench("gem_clustering", repeats,
+        [&] (BenchTimer &timer)
+        {
+            for(auto &event : events)
+            {
+                gem->ChooseEvent(event);
+                timer.Start();
+                gem->Reconstruct();
+                timer.Stop();
+            }
+            return events.size();
+        }));
+
+    // matching with the projected hits
+    struct MatchInput
+    {
+        vector<HyCalHit> hycal;
+        vector<GEMHit> gem1, gem2;
+    };
+    vector<MatchInput> match_inputs;
+    for(auto &event : events)
+    {
+        MatchInput input;
+        hycal->Reconstruct(event);
+        gem->Reconstruct(event);
+        input.hycal = hycal->GetDetector()->GetHits();
+        input.gem1 = gem->GetDetector(PRadDetector::PRadGEM1)->GetHits();
+        input.gem2 = gem->GetDetector(PRadDetector::PRadGEM2)->GetHits();
+
+        coord_sys->Transform(PRadDetector::HyCal, input.hycal.begin(), input.hycal.end());
+        coord_sys->Transform(PRadDetector::PRadGEM1, input.gem1.begin(), input.gem1.end());
+        coord_sys->Transform(PRadDetector::PRadGEM2, input.gem2.begin(), input.gem2.end());
+        coord_sys->Projection(input.hycal.begin(), input.hycal.end());
+        coord_sys->Projection(input.gem1.begin(), input.gem1.end());
+        coord_sys->Projection(input.gem2.begin(), input.gem2.end());
+        match_inputs.emplace_back(move(input));
+    }
+
+    results.push_back(runBench("det_match", repeats,
+        [&] (BenchTimer &timer)
+        {
+            // the matching changes the hits
+            auto work = match_inputs;
+            timer.Start();
+            for(auto &input : work)
+                det_match->Match(input.hycal, input.gem1, input.gem2);
+            timer.Stop();
+            return work.size();
+        }));
+
+    if(output.empty()) {
+        writeResults(cout, evio_file, dst_file, repeats, results);
+    } else {
+        ofstream out(output);
+        if(!out.is_open()) {
+            cerr << "Bench Error: cannot open file " << output << endl;
+            return -1;
+        }
+        writeResults(out, evio_file, dst_file, repeats, results);
+        cout << "Saved the results of " << results.size()
+             << " benchmarks to " << output << endl;
+    }
+
+    // the memory of the subsystems is shown with the profiler summary
+    if(profile) {
+        auto &tracker = PRadMemoryTracker::Instance();
+        tracker.Register("Reference Events", [&] ()
+                                             {
+                                                 MemoryUsage usage;
+                                                 usage.Add(events);
+                                                 for(auto &event : events)
+                                                     usage.Add(event);
+                                                 return usage;
+                                             });
+        tracker.Register("HyCal", [hycal] () {return hycal->GetMemoryUsage();});
+        tracker.Register("GEM", [gem] () {return gem->GetMemoryUsage();});
+        tracker.SetEventCounter([&events] () {return events.size();});
+        PRadProfiler::Instance().PrintSummary(cerr);
+    }
+
+    return 0;
+}
+
+// the first repetition warms up the caches and is not counted
+BenchResult runBench(const string &name, unsigned int repeats, const BenchFunc &func)
+{
+    BenchResult res;
+    res.name = name;
+    res.events = 0;
+
+    cerr << "Running " << setw(24) << left << name << right << flush;
+    for(unsigned int i = 0; i <= repeats; ++i)
+    {
+        BenchTimer timer;
+        uint64_t count = func(timer);
+        if(i == 0 || count == 0)
+            continue;
+
+        res.events = count;
+        res.ns_per_event.push_back((double)timer.GetElapsed()/count);
+        res.allocs_per_event.push_back((double)timer.GetAllocs()/count);
+    }
+
+    if(res.events)
+        cerr << setw(12) << fixed << setprecision(1)
+             << percentile(res.ns_per_event, 50.) << " ns/event" << endl;
+    else
+        cerr << "no events" << endl;
+    return res;
+}
+
+// percentile with linear interpolation
+double percentile(vector<double> vals, double p)
+{
+    if(vals.empty())
+        return 0.;
+
+    sort(vals.begin(), vals.end());
+    double pos = p/100.*(vals.size() - 1);
+    size_t i = pos;
+    if(i + 1 >= vals.size())
+        return vals.back();
+    return vals[i] + (pos - i)*(vals[i + 1] - vals[i]);
+}
+
+void writeResults(ostream &os, const string &evio, const string &dst,
+                  unsigned int repeats, const vector<BenchResult> &results)
+{
+    os << "{" << endl
+       << "  \"evio\": \"" << evio << "\"," << endl
+       << "  \"dst\": \"" << dst << "\"," << endl
+       << "  \"repeats\": " << repeats << "," << endl
+       << "  \"benchmarks\": [";
+
+    os << fixed << setprecision(3);
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        auto &res = results[i];
+        double median = percentile(res.ns_per_event, 50.);
+        os << ((i == 0) ? "" : ",") << endl
+           << "    {\"name\": \"" << res.name << "\", "
+           << "\"events\": " << res.events << ", "
+           << "\"events_per_s\": " << ((median > 0.) ? 1e9/median : 0.) << ", "
+           << "\"allocs_per_event\": " << percentile(res.allocs_per_event, 50.) << ", "
+           << "\"ns_per_event\": {"
+           << "\"min\": " << percentile(res.ns_per_event, 0.) << ", "
+           << "\"p10\": " << percentile(res.ns_per_event, 10.) << ", "
+           << "\"p50\": " << median << ", "
+           << "\"p90\": " << percentile(res.ns_per_event, 90.) << ", "
+           << "\"max\": " << percentile(res.ns_per_event, 100.) << "}}";
+    }
+    os << endl << "  ]" << endl << "}" << endl;
+}
@@ -5,7 +5,7 @@
 // 11/12/2016                                                                 //
 //============================================================================//
 
-#include "PRadDSTParser.h"
+#include "PRadEventSource.h"
 #include <iostream>
 #include <iomanip>
 #include <string>
@@ -34,29 +34,18 @@ int main(int argc, char *argv[])
 
 void showLiveTime(const string &file)
 {
-    PRadDSTParser dst_parser;
-    dst_parser.OpenInput(file);
-
     cout << "Live time for " << "\"" << file << "\"." << endl;
 
     int total_sum_cnt = 0, lg_sum_cnt = 0;
     int previous_period = 0;
     vector<int> counts_total(6, 0), counts_period(6, 0);
 
-    while(dst_parser.Read())
+    // only interested in physics events, the file is read ahead in background
+    PRadEventSource source(file, [] (const EventData &ev) {return ev.is_physics_event();});
+    for(const EventView &event : source)
     {
-        // only interested in events
-        if(dst_parser.EventType() != PRadDSTParser::Type::event)
-            continue;
-
-        auto event = dst_parser.GetEvent();
-
-        // only interested in physics events
-        if(!event.is_physics_event())
-            continue;
-
         // count trigger types
-        switch(event.trigger)
+        switch(event.trigger())
         {
         case PHYS_LeadGlassSum: lg_sum_cnt++; break;
         case PHYS_TotalSum: total_sum_cnt++; break;
@@ -79,7 +68,7 @@ void showLiveTime(const string &file)
             }
 
             std::cout << "======================================================\n"
-                      << "Current period: " << previous_period << " - " << event.event_number << "\n"
+                      << "Current period: " << previous_period << " - " << event.event_number() << "\n"
                       << "TRG(LG_SUM) = " << lg_sum_cnt << "\n"
                       << "TRG(TOTAL_SUM) = " << total_sum_cnt << "\n"
                       << "LT(LG_SUM) = " << liveTime(counts_period[0], counts_period[1]) << "\n"
@@ -89,7 +78,7 @@ void showLiveTime(const string &file)
 
             lg_sum_cnt = 0;
             total_sum_cnt = 0;
-            previous_period = event.event_number;
+            previous_period = event.event_number();
         }
 
     }
@@ -0,0 +1,64 @@
+//============================================================================//
+// An application to compact a DST file updated in place                      //
+// The records are copied in their order, the replaced records are taken     //
+// from their latest updates, so the output has no update record             //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDSTParser.h"
+#include "PRadDSTReader.h"
+#include "PRadBenchMark.h"
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if(argc != 3) {
+        cout << "usage: compactDST <in_file> <out_file>" << endl;
+        return -1;
+    }
+
+    string input = argv[1], output = argv[2];
+
+    // keep the format of the input
+    bool chunked;
+    {
+        PRadDSTReader reader;
+        if(!reader.Open(input)) {
+            cout << "Cannot open " << input << endl;
+            return -1;
+        }
+        chunked = reader.IsChunked();
+    }
+
+    PRadDSTParser dst_in, dst_out;
+    dst_in.OpenInput(input);
+    if(chunked)
+        dst_out.SetChunkedOutput();
+    dst_out.OpenOutput(output);
+
+    if(!dst_in.IsInputUpdated())
+        cout << input << " has no update, it is copied." << endl;
+
+    PRadBenchMark timer;
+    size_t count = 0;
+    PRadDSTParser::RawRecord rec;
+    while(dst_in.Read())
+    {
+        if(!dst_in.GetRecord(rec))
+            continue;
+        dst_out.WriteRecord(rec);
+        count++;
+    }
+
+    dst_in.CloseInput();
+    dst_out.CloseOutput();
+
+    cout << "Copied " << count << " records to " << output
+         << " in " << timer.GetElapsedTimeStr() << endl;
+    return 0;
+}
@@ -0,0 +1,101 @@
+//============================================================================//
+// An application to convert the cluster profiles and density parameters      //
+// listed in the HyCal configuration to the binary format, the binary files   //
+// are loaded in place of the text ones by changing the configuration values  //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadClusterProfile.h"
+#include "PRadClusterDensity.h"
+#include "PRadHyCalModule.h"
+#include "ConfigObject.h"
+#include "ConfigParser.h"
+#include "ConfigOption.h"
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_require, 'c');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'o');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: convertHyCalTables");
+    conf_opt.SetDesc('c', "HyCal configuration file, default is config/hycal.conf.");
+    conf_opt.SetDesc('o', "output directory, default is the directory of each table.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() != 0) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    string conf_path = "config/hycal.conf", out_dir;
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 'c':
+            conf_path = opt.var.String();
+            break;
+        case 'o':
+            out_dir = opt.var.String();
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    ConfigObject conf;
+    if(!conf.ReadConfigFile(conf_path))
+        return -1;
+
+    // output path of a table
+    auto bin_path = [&out_dir] (const string &path)
+                    {
+                        auto info = ConfigParser::decompose_path(path);
+                        if(!out_dir.empty())
+                            info.dir = out_dir;
+                        info.ext = "bin";
+                        return ConfigParser::compose_path(info);
+                    };
+
+    // cluster profiles
+    PRadClusterProfile profile;
+    for(int i = 0; i < static_cast<int>(PRadHyCalModule::Max_Types); ++i)
+    {
+        string key = "Cluster Profile [" + PRadHyCalModule::Type2str(i) + "]";
+        string path = conf.GetConfig<string>(key);
+        if(path.empty())
+            continue;
+
+        profile.Load(i, path);
+        string out = bin_path(path);
+        if(profile.SaveBinary(i, out))
+            cout << key << " = " << out << endl;
+    }
+
+    // density parameters, both parts are saved in one file
+    PRadClusterDensity density;
+    for(int i = 0; i < static_cast<int>(PRadClusterDensity::Max_SetEnums); ++i)
+    {
+        string set_name = PRadClusterDensity::SetEnum2str(i);
+        string key = "Density Profile [" + set_name + "]";
+        string p_path = conf.GetConfig<string>(key);
+        string e_path = conf.GetConfig<string>("S-Shape Energy Profile [" + set_name + "]");
+        if(p_path.empty() || !density.Load(i, p_path, e_path))
+            continue;
+
+        string out = bin_path(p_path);
+        if(density.SaveBinary(i, out))
+            cout << key << " = " << out << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+//============================================================================//
+// An application to export a DST file to Apache Arrow streams, the events    //
+// and epics events are saved in two files that can be read by pyarrow        //
+//     pyarrow.ipc.open_stream("<out>.arrows").read_all()                     //
+// and saved to a parquet file by pyarrow.parquet.write_table if needed       //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDSTParser.h"
+#include "PRadArrowWriter.h"
+#include "PRadBenchMark.h"
+#include "ConfigParser.h"
+#include "ConfigOption.h"
+#include <iostream>
+#include <string>
+
+#define PROGRESS_COUNT 10000
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_require, 'o');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'n');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: dst2arrow <dst_file>");
+    conf_opt.SetDesc('o', "output name, <name>.arrows and <name>_epics.arrows are written, default is the input name.");
+    conf_opt.SetDesc('n', "number of events in a record batch, default 10000.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() != 1) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    string input = conf_opt.GetArgument(0).String();
+    string output = ConfigParser::decompose_path(input).name;
+    unsigned int batch = ARROW_BATCH_EVENTS;
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 'o':
+            output = opt.var.String();
+            break;
+        case 'n':
+            batch = opt.var.Int();
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    PRadDSTParser dst_parser;
+    dst_parser.OpenInput(input);
+
+    PRadArrowWriter writer(batch);
+    if(!writer.Open(output + ".arrows", output + "_epics.arrows"))
+        return -1;
+
+    PRadBenchMark timer;
+    int count = 0;
+    while(dst_parser.Read())
+    {
+        if(dst_parser.EventType() == PRadDSTParser::Type::event) {
+            writer.Write(dst_parser.GetCurrentEvent());
+            if(++count%PROGRESS_COUNT == 0) {
+                cout << "------[ ev " << count << " ]---"
+                     << "---[ " << timer.GetElapsedTimeStr() << " ]------"
+                     << "\r" << flush;
+            }
+        } else if(dst_parser.EventType() == PRadDSTParser::Type::epics) {
+            writer.Write(dst_parser.GetCurrentEPICS());
+        }
+    }
+
+    dst_parser.CloseInput();
+    writer.Close();
+
+    cout << "------[ ev " << count << " ]---"
+         << "---[ " << timer.GetElapsedTimeStr() << " ]------"
+         << endl;
+    cout << "Exported " << count << " events in " << writer.GetEventBatches()
+         << " record batches to " << output << ".arrows" << endl;
+    return 0;
+}
@@ -19,7 +19,9 @@
 using namespace std;
 
 void EventSelect(const string &file, const string &bad_file);
-void WriteEvents(PRadDSTParser &dst, const PRadEventFilter &filter, const vector<EventData> &data);
+void WriteEvents(PRadDSTParser &dst, const PRadEventFilter &filter,
+                 const EventData &begin, const EventData &end,
+                 const vector<PRadDSTParser::RawRecord> &records, size_t size);
 
 // expecting two input string, event file path and bad events list path
 int main(int argc, char *argv[])
@@ -47,6 +49,8 @@ void EventSelect(const string &file, const string &bad_file)
     PRadDSTParser dst_parser, dst_parser2;
 
     dst_parser.OpenInput(file);
+    // only the event information is needed, the records are copied as they are
+    dst_parser.SetBankMask(0);
     auto path_info = ConfigParser::decompose_path(file);
     string fname = path_info.name;
 
@@ -57,27 +61,36 @@ void EventSelect(const string &file, const string &bad_file)
     double time = 0.;
 
     // a package for a period (from sync event to sync event
-    vector<EventData> event_pack;
-    event_pack.reserve(150000);
+    // the records are reused for the packages
+    vector<PRadDSTParser::RawRecord> event_pack;
+    size_t pack_size = 0;
+    EventData pack_begin;
+    PRadDSTParser::RawRecord record;
 
     unsigned int m_count = 0, p_count = 0, t_count = 0;
     bool first_sync = true;
     while(dst_parser.Read())
     {
         if(dst_parser.EventType() == PRadDSTParser::Type::event) {
-            auto event = dst_parser.GetEvent();
+            auto &event = dst_parser.GetCurrentEvent();
             t_count++;
 
             // write the monitoring event
             if(event.is_monitor_event()) {
                 m_count++;
-                dst_parser2.Write(event);
+                dst_parser.GetRecord(record);
+                dst_parser2.WriteRecord(record);
                 continue;
             }
 
             // throw away everything before the first sync
-            if(!first_sync)
-                event_pack.push_back(event);
+            if(!first_sync) {
+                if(pack_size == 0)
+                    pack_begin = event;
+                if(pack_size >= event_pack.size())
+                    event_pack.resize(pack_size + 1);
+                dst_parser.GetRecord(event_pack[pack_size++]);
+            }
 
             // sync event is the beginning of this package
             if(event.is_sync_event()) {
@@ -90,13 +103,13 @@ void EventSelect(const string &file, const string &bad_file)
                          << ", start recording."
                          << endl;
                 } else {
-                    WriteEvents(dst_parser, filter, event_pack);
+                    WriteEvents(dst_parser, filter, pack_begin, event, event_pack, pack_size);
 
                     // show progress
                     double t = timer.GetElapsedTime();
                     time += t;
                     timer.Reset();
-                    p_count += event_pack.size();
+                    p_count += pack_size;
 
                     cout << "---[ ev " << p_count << " ]---"
                          << "---[ " << t << " ms ]---"
@@ -104,7 +117,7 @@ void EventSelect(const string &file, const string &bad_file)
                 }
 
                 // clear event package after writing
-                event_pack.clear();
+                pack_size = 0;
             }
         } else if(dst_parser.EventType() == PRadDSTParser::Type::epics) {
             dst_parser.WriteEPICS();
@@ -125,16 +138,19 @@ void EventSelect(const string &file, const string &bad_file)
          << endl;
 }
 
-void WriteEvents(PRadDSTParser &dst, const PRadEventFilter &filter, const vector<EventData> &data)
+void WriteEvents(PRadDSTParser &dst, const PRadEventFilter &filter,
+                 const EventData &begin, const EventData &end,
+                 const vector<PRadDSTParser::RawRecord> &records, size_t size)
 {
-    if(data.empty())
+    if(!size)
         return;
 
-    if(filter.IsBadPeriod(data.front(), data.back()))
+    if(filter.IsBadPeriod(begin, end))
         return;
 
-    for(auto &event : data)
+    // copy the records without re-encoding
+    for(size_t i = 0; i < size; ++i)
     {
-        dst.Write(event);
+        dst.WriteRecord(records[i]);
     }
 }
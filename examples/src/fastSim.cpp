@@ -0,0 +1,89 @@
+//============================================================================//
+// An example to produce dst files from the generator events with the fast    //
+// parametric simulation of HyCal and GEMs, the calibration constants and     //
+// coordinates are from the chosen run                                        //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadFastSim.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadCoordSystem.h"
+#include "PRadInfoCenter.h"
+#include "ConfigOption.h"
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_require, 'r');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'n');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'j');
+    conf_opt.AddOpt(ConfigOption::arg_require, 's');
+    conf_opt.AddOpt(ConfigOption::arg_none, 'g');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: fastSim [options] <gen_file> <out_dst>");
+    conf_opt.SetDesc('r', "run number for the calibration constants and coordinates, default 1288.");
+    conf_opt.SetDesc('n', "maximum number of events, default is all the events.");
+    conf_opt.SetDesc('j', "number of threads, default is the number of hardware threads.");
+    conf_opt.SetDesc('s', "seed of the random streams, default 1.");
+    conf_opt.SetDesc('g', "do not simulate the GEMs.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() != 2) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    int run = 1288, nevents = 0;
+    bool sim_gem = true;
+    PRadFastSim sim;
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 'r':
+            run = opt.var.Int();
+            break;
+        case 'n':
+            nevents = opt.var.Int();
+            break;
+        case 'j':
+            sim.SetThreads(opt.var.Int());
+            break;
+        case 's':
+            sim.SetSeed(opt.var.ULong());
+            break;
+        case 'g':
+            sim_gem = false;
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    PRadHyCalSystem hycal("config/hycal.conf");
+    PRadGEMSystem gem("config/gem.conf");
+    PRadCoordSystem coord_sys("database/coordinates.dat");
+
+    PRadInfoCenter::SetRunNumber(run);
+    hycal.UpdateRunFiles();
+    coord_sys.ChooseCoord(run);
+
+    sim.SetHyCalSystem(&hycal);
+    sim.SetCoordSystem(&coord_sys);
+    if(sim_gem)
+        sim.SetGEMSystem(&gem);
+
+    int64_t count = sim.Simulate(conf_opt.GetArgument(0).String(),
+                                 conf_opt.GetArgument(1).String(),
+                                 nevents);
+    return (count < 0) ? -1 : 0;
+}
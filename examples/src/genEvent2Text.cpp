@@ -0,0 +1,82 @@
+//============================================================================//
+// An application to print the header of a binary generator event file and    //
+// convert its events to the text format of the generators                    //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadGenEventFile.h"
+#include "ConfigOption.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#define READ_BLOCK 10000
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_require, 'o');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: genEvent2Text <event_file>");
+    conf_opt.SetDesc('o', "output text file, only the header is printed if it is not set.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() != 1) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    string output;
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 'o':
+            output = opt.var.String();
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    PRadGenEventFile input;
+    if(!input.Open(conf_opt.GetArgument(0).String()))
+        return -1;
+
+    auto &header = input.GetHeader();
+    cout << "Generator: " << header.generator << "\n"
+         << "Beam energy: " << header.energy << " MeV\n"
+         << "Angle range: " << header.min_angle << " ~ " << header.max_angle << " deg\n"
+         << "Photon energy range: " << header.v_min << " ~ " << header.v_cut << " MeV\n"
+         << "Number of events: " << header.nevents << "\n"
+         << "Integrated luminosity: " << header.luminosity << " nb^-1\n"
+         << "Seed: " << header.seed
+         << endl;
+
+    if(output.empty())
+        return 0;
+
+    ofstream out(output);
+    vector<PRadGenEventFile::Event> events;
+    while(input.Read(events, READ_BLOCK))
+    {
+        for(auto &event : events)
+        {
+            for(int i = 0; i < GEN_EVENT_PARTICLES; ++i)
+            {
+                auto &part = event.part[i];
+                out << part.p << "   " << part.theta << "   " << part.phi
+                    << ((i < GEN_EVENT_PARTICLES - 1) ? "   " : "\n");
+            }
+        }
+    }
+
+    cout << input.GetEventsRead() << " events are saved to \"" << output << "\"." << endl;
+    return 0;
+}
@@ -1,65 +1,49 @@
 //============================================================================//
 // Calculate the mean value of gain factor for each channel, for a given      //
-// period based on the LMS root file produced during zero-suppression replay, //
-// these files can be found on ifarm /work/hallb/prad/replay_LMS              //
+// period based on the replayed DST files, the runs are processed in parallel //
+// and the peaks are estimated by PRadHyCalSystem without ROOT fits           //
 //                                                                            //
 // Weizhi Xiong                                                               //
 // 10/23/2016                                                                 //
 //============================================================================//
 
-#include "PRadDataHandler.h"
+#include "PRadHyCalSystem.h"
+#include "PRadInfoCenter.h"
+#include "PRadDSTReader.h"
+#include "PRadBenchMark.h"
 #include "ConfigOption.h"
-#include "TFile.h"
-#include "TH1.h"
-#include "TMath.h"
-#include "TAxis.h"
+#include "ConfigParser.h"
 #include "TSystem.h"
-#include "TROOT.h"
-#include "TKey.h"
-#include "TClass.h"
-#include "TF1.h"
-#include <math.h>
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
-#include <cassert>
+#include <atomic>
 #include <iomanip>
+#include <algorithm>
+#include <thread>
 
-#define BLOCKS 1728
-#define NREFERENCE 3
 #define TOLERANCE 0.06
 
 using namespace std;
+
+typedef PRadHyCalSystem::GainTable GainTable;
+typedef PRadGausEstimator::Result GausResult;
+
 //global variables
-string inputDir = "./calibration/LMS"; //define input root file here
+string inputDir = "./replay"; //define input dst file here
 string outDir   = "./calibration/LMS"; //define output dat file here
-vector<string> inputFiles;
-TFile* rootFile;
 bool doAverage;
 int startRun;
 int endRun;
-string channelName[BLOCKS];
-double  pedMean[BLOCKS];
-double  pedSigma[BLOCKS];
-double  LMSMean[BLOCKS];
-double  LMSSigma[BLOCKS];
-double  refLMSMean[NREFERENCE];
-double  refLMSSigma[NREFERENCE];
-double  refPedMean[NREFERENCE];
-double  refPedSigma[NREFERENCE];
-double  refAlphaMean[NREFERENCE];
-double  refGain[NREFERENCE];
 
 //functions
-void  InitArray();
-int   GetRunNumber(string run);
-bool  SortFile(string name1, string name2);
-void  FindInputFiles();
-void  FitHistograms();
-void  FitHyCalHist(TKey* k, int & i);
-void  FitReferenceHist(TKey* k);
-double GetMaxBinCenterInRange(TH1* h, double xmin, double xmax);
-void  WriteOutput(double nTotal, int rNumber = -1);
+int   GetRunNumber(const string &path);
+vector<string> FindInputFiles();
+void  FillHistograms(PRadHyCalSystem &hycal, const string &path);
+void  CheckTable(const GainTable &table);
+void  AddTable(GainTable &total, const GainTable &table);
+void  WriteOutput(const GainTable &table, double nTotal, int rNumber = -1);
 
 int main(int argc, char * argv [])
 {
@@ -67,12 +51,16 @@ int main(int argc, char * argv [])
     conf_opt.AddOpt(ConfigOption::arg_none, 'a');
     conf_opt.AddOpt(ConfigOption::arg_require, 's');
     conf_opt.AddOpt(ConfigOption::arg_require, 'e');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'i');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'o');
+    conf_opt.AddOpt(ConfigOption::arg_require, 't');
 
     if(!conf_opt.ParseArgs(argc, argv)) exit(1);
 
     doAverage = false;
     startRun = 0;
     endRun = 0;
+    unsigned int nthreads = thread::hardware_concurrency();
     for(auto &opt : conf_opt.GetOptions())
     {
         switch(opt.mark)
@@ -86,6 +74,15 @@ int main(int argc, char * argv [])
         case 'e':
             endRun = opt.var.Int();
             break;
+        case 'i':
+            inputDir = opt.var.String();
+            break;
+        case 'o':
+            outDir = opt.var.String();
+            break;
+        case 't':
+            nthreads = opt.var.Int();
+            break;
         default:
             cerr << "Unkown option -" << opt.mark << endl;
             exit(1);
@@ -102,180 +99,141 @@ int main(int argc, char * argv [])
         exit(1);
     }
 
-    InitArray();
+    auto inputFiles = FindInputFiles();//search for dst files that within the directory
+    if (inputFiles.empty()) return -1;
 
-    FindInputFiles();//search for root files that within the directory
+    PRadHyCalSystem hycal_sys("config/hycal.conf");
 
-    FitHistograms();
+    // the runs are taken by the threads one by one, each thread fills the
+    // histograms of its own system, the channels of a run are estimated in
+    // the same thread
+    PRadBenchMark timer;
+    nthreads = max<unsigned int>(1, min<size_t>(nthreads, inputFiles.size()));
+    vector<GainTable> tables(inputFiles.size());
+    vector<PRadInfoCenter> infos(nthreads);
+    vector<PRadHyCalSystem*> systems;
+    for (unsigned int i=0; i<nthreads; i++){
+        systems.push_back(new PRadHyCalSystem(hycal_sys));
+        systems.back()->SetInfoCenter(&infos[i]);
+    }
 
-    return 0;
-}
+    atomic<size_t> next(0);
+    auto work = [&] (PRadHyCalSystem *hycal)
+                {
+                    size_t i;
+                    while ((i = next.fetch_add(1)) < inputFiles.size()){
+                        hycal->Reset();
+                        hycal->GetInfoCenter()->ChangeRunNumber(inputFiles[i]);
+                        FillHistograms(*hycal, inputFiles[i]);
+                        tables[i] = hycal->ExtractGains(1);
+                    }
+                };
 
-//_________________________________________________________________________________
-void InitArray()
-{
+    vector<thread> workers;
+    for (unsigned int i=1; i<nthreads; i++){
+        workers.emplace_back(work, systems[i]);
+    }
+    work(systems[0]);
+    for (auto &worker : workers){
+        worker.join();
+    }
 
-    for (int i=0; i<BLOCKS; i++){
-        pedMean[i]  = 0.;
-        pedSigma[i] = 0.;
-        LMSMean[i]  = 0.;
-        LMSSigma[i] = 0.;
+    for (auto &sys : systems){
+        delete sys;
     }
-    for (int i=0; i<NREFERENCE; i++){
-        refLMSMean[i]   = 0.;
-        refPedMean[i]   = 0.;
-        refAlphaMean[i] = 0.;
-        refLMSSigma[i]  = 0.;
-        refPedSigma[i]  = 0.;
-        refGain[i]      = 0.;
+
+    cout << "Analyzed " << inputFiles.size() << " runs, took "
+         << timer.GetElapsedTime()/1000. << " s" << endl;
+
+    // outputs in the run order
+    GainTable total;
+    for (auto &table : tables){
+        CheckTable(table);
+        if (doAverage) AddTable(total, table);
+        else WriteOutput(table, 1., table.run);
     }
+    if (doAverage) WriteOutput(total, (double)tables.size());
+
+    return 0;
 }
+
 //_________________________________________________________________________________
-void FitHistograms()
+void FillHistograms(PRadHyCalSystem &hycal, const string &path)
 {
-    for (unsigned int i=0; i<inputFiles.size(); i++){
-        rootFile = new TFile(inputFiles.at(i).c_str(), "READ");
-        cout<<"analyzing file "<<inputFiles[i]<<endl;
-        TIter next(rootFile->GetListOfKeys());
-        TKey *thisKey;
-        int ich = 0;
-        while ( (thisKey = (TKey*)next()) ){
-            TClass *thisClass = gROOT->GetClass(thisKey->GetClassName());
-            if (!thisClass->InheritsFrom("TList")) continue;
-            if ( (thisKey->GetName())[0] == 'W' || (thisKey->GetName())[0] == 'G' ){
-                if (i==0) channelName[ich] = string(thisKey->GetName());
+    PRadDSTReader reader;
+    if (!reader.Open(path)){
+        cerr << "cannot open file " << path << endl;
+        return;
+    }
+    // only the adc data is needed
+    reader.SetBankMask(PRadDSTParser::ADC_Bank);
+
+    cout << "analyzing file " << path << endl;
 
-                FitHyCalHist(thisKey, ich);
-                ich++;
+    EventData event;
+    if (reader.IsChunked()){
+        vector<EventData> events;
+        for (size_t c=0; c<reader.GetChunkCount(); c++){
+            reader.GetChunk(c, events);
+            for (auto &ev : events){
+                hycal.FillHists(ev);
             }
-            if ( !strncmp("LMS", thisKey->GetName(), 3))
-            FitReferenceHist(thisKey);
         }
-        if (!doAverage) WriteOutput(1., GetRunNumber(inputFiles[i]) );
-        delete rootFile; rootFile = 0;
+    }else{
+        for (size_t i=0; i<reader.GetEventCount(); i++){
+            if (reader.GetEvent(i, event)) hycal.FillHists(event);
+        }
     }
-    if (doAverage) WriteOutput((double)inputFiles.size());
 }
 //_________________________________________________________________________________
-void FitHyCalHist(TKey* k, int & i)
+void CheckTable(const GainTable &table)
 {
-    if (!doAverage){
-        pedMean[i]  = 0.; pedSigma[i] = 0.; LMSMean[i]  = 0.; LMSSigma[i] = 0.;
-    }
-    TList *thisList = (TList*)k->ReadObj();
-    string LMSHistName(k->GetName());
-    LMSHistName+="_LMS";
-    string PedHistName(k->GetName());
-    PedHistName+="_PED";
-    TH1 *theLMSHist = (TH1*)thisList->FindObject(LMSHistName.c_str());
-    TH1 *thePedHist = (TH1*)thisList->FindObject(PedHistName.c_str());
-    //fit HyCal Module LMS
-    TAxis *LMSAxis  = theLMSHist->GetXaxis();
-    double integral  = theLMSHist->Integral(LMSAxis->FindBin(1),
-                                           LMSAxis->FindBin(8190));
-    if (integral > 1000){
-        theLMSHist->Fit("gaus", "Qww", "", 1, 8190);
-        TF1*  thisFunc = theLMSHist->GetFunction("gaus");
-        double mean     = thisFunc->GetParameter(1);
-        double sigma    = thisFunc->GetParameter(2);
-        LMSMean[i]     = doAverage ? LMSMean[i]  + mean  : mean;
-        LMSSigma[i]    = doAverage ? LMSSigma[i] + sigma : sigma;
-        if (sigma/mean > TOLERANCE) cout<<"bad fitting for channel "<<channelName[i]<<endl;
-    }
-    //fit HyCal Module pedestal
-    TAxis *pedAxis  = thePedHist->GetXaxis();
-    int   binmax    = thePedHist->GetMaximumBin();
-    double x         = pedAxis->GetBinCenter(binmax);
-    integral        = thePedHist->Integral(pedAxis->FindBin(x - 30),
-                                           pedAxis->FindBin(x + 30));
-    if (integral > 1000){
-        thePedHist->Fit("gaus", "Qww", "", x - 30, x + 30);
-        TF1* thisFunc = thePedHist->GetFunction("gaus");
-        double mean    = thisFunc->GetParameter(1);
-        double sigma   = thisFunc->GetParameter(2);
-        pedMean[i]    = doAverage ? pedMean[i]  + mean  : mean;
-        pedSigma[i]   = doAverage ? pedSigma[i] + sigma : sigma;
-        if (sigma/mean > TOLERANCE) cout<<"bad fitting for channel "<<channelName[i]<<endl;
-    }
+    auto check = [&table] (const string &name, const GausResult &res, const char *what)
+                 {
+                     if (res.valid && res.sigma/res.mean > TOLERANCE)
+                         cout<<"run "<<table.run<<": bad fitting for "<<what<<" of "<<name<<endl;
+                 };
 
+    for (auto &entry : table.channels){
+        check(entry.name, entry.ped, "pedestal");
+        check(entry.name, entry.lms, "LMS");
+        check(entry.name, entry.alpha, "alpha");
+    }
 }
 //_________________________________________________________________________________
-void FitReferenceHist(TKey* k)
+// sum the tables to average them over the runs, the invalid peaks are zeros
+void AddTable(GainTable &total, const GainTable &table)
 {
-    TList *thisList = (TList*)k->ReadObj();
-    int iref = ( (k->GetName())[3] - '0' ) - 1;
-    assert(iref >=0 && iref < NREFERENCE);
-
-    //if not averaging things over many runs, clean arrays before filling
-    if (!doAverage){
-        refLMSMean[iref] = 0.; refPedMean[iref] = 0.; refAlphaMean[iref] = 0.; refGain[iref] = 0.;
-        refLMSSigma[iref] = 0.; refPedSigma[iref] = 0.;
-    }
-    string LMSHistName(k->GetName());
-    LMSHistName+="_LMS";
-    string PhysHistName(k->GetName());
-    PhysHistName+="_PHYS";
-
-    TH1 *theLMSHist = (TH1*)thisList->FindObject(LMSHistName.c_str());
-    TH1 *thePhysHist = (TH1*)thisList->FindObject(PhysHistName.c_str());
-
-    TAxis *physAxis = thePhysHist->GetXaxis();
-    double integral1 = thePhysHist->Integral(physAxis->FindBin(1), physAxis->FindBin(1000));
-    double integral2 = thePhysHist->Integral(physAxis->FindBin(1000), physAxis->FindBin(8190));
+    auto add = [] (GausResult &sum, const GausResult &res)
+               {
+                   if (!res.valid) return;
+                   sum.mean += res.mean;
+                   sum.sigma += res.sigma;
+                   sum.valid = true;
+               };
 
-    TAxis *LMSAxis  = theLMSHist->GetXaxis();
-    double integral3 = theLMSHist->Integral(LMSAxis->FindBin(1), LMSAxis->FindBin(8190));
-
-    double up = 0, down = 0;
-    if (integral1 > 1000){
-        double center = GetMaxBinCenterInRange(thePhysHist, 1, 1000);
-        TF1 *g1 = new TF1("g1", "gaus", center - 20, center + 20);
-        thePhysHist->Fit(g1, "RQww");
-        double mean = g1->GetParameter(1);
-        double sigma = g1->GetParameter(2);
-        refPedMean[iref]  += mean;
-        refPedSigma[iref] += sigma;
-        up = -1.*mean; down = -1.*mean;
-        if (sigma/mean > TOLERANCE) cout<<"bad fitting for pedestal of reference PMT "<<iref + 1<<endl;
-        delete g1;
+    if (total.channels.empty()){
+        total.channels.resize(table.channels.size());
+        for (unsigned int i=0; i<table.channels.size(); i++){
+            total.channels[i].name = table.channels[i].name;
+        }
     }
-
-    if (integral2 > 1000){
-        double center = GetMaxBinCenterInRange(thePhysHist, 1000, 8190);
-        TF1 *g1 = new TF1("g1", "gaus", center - 300, center + 300);
-        thePhysHist->Fit(g1, "RQww");
-        double mean = g1->GetParameter(1);
-        double sigma = g1->GetParameter(2);
-        refAlphaMean[iref] += mean;
-        down += mean;
-        if (sigma/mean > TOLERANCE) cout<<"bad fitting for alpha of reference PMT "<<iref + 1<<endl;
-        delete g1;
+    if (total.ref_gains.size() < table.ref_gains.size()){
+        total.ref_gains.resize(table.ref_gains.size(), 0.);
     }
 
-    if (integral3 > 1000){
-        theLMSHist->Fit("gaus", "Qww", "", 1, 8190);
-        TF1*  thisFunc = theLMSHist->GetFunction("gaus");
-        double mean     = thisFunc->GetParameter(1);
-        double sigma    = thisFunc->GetParameter(2);
-        refLMSMean[iref]  += mean;
-        refLMSSigma[iref] += sigma;
-        up += mean;
-        if (sigma/mean > TOLERANCE) cout<<"bad fitting for LMS of reference PMT "<<iref + 1<<endl;
+    for (unsigned int i=0; i<table.channels.size() && i<total.channels.size(); i++){
+        add(total.channels[i].ped, table.channels[i].ped);
+        add(total.channels[i].lms, table.channels[i].lms);
+        add(total.channels[i].alpha, table.channels[i].alpha);
     }
-
-    if (down > 0){
-        //if trying to estimate the average, the following two ways are actually difference,
-        //one is the many of all reference gains, the other is using the sum of all sparsified LMS
-        //divided by all sparsified alpha, not sure which one is better though
-
-        //refGain[iref] += ((refLMSMean[iref] - refPedMean[iref]) / (refAlphaMean[iref] - refPedMean[iref]));
-        refGain[iref] += up/down;
+    for (unsigned int i=0; i<table.ref_gains.size(); i++){
+        total.ref_gains[i] += table.ref_gains[i];
     }
 }
 //_________________________________________________________________________________
-void WriteOutput(double nTotal, int rNumber)
+void WriteOutput(const GainTable &table, double nTotal, int rNumber)
 {
-    if (rNumber < 0) assert(doAverage);
     ofstream outFile;
     string outFileName(outDir);
     outFileName += "/db_prad_baseinfo";
@@ -286,16 +244,19 @@ void WriteOutput(double nTotal, int rNumber)
     }
     outFile.open(outFileName);
 
-    for (int i=0; i<BLOCKS; i++){
-        outFile<<setw(12)<<channelName[i]<<setw(12)<<pedMean[i]/nTotal
-               <<setw(12)<<pedSigma[i]/nTotal<<setw(12)<<LMSMean[i]/nTotal
-               <<setw(12)<<LMSSigma[i]/nTotal<<endl;
+    // hycal modules first, then the reference PMTs
+    auto write_entry = [&] (const PRadHyCalSystem::GainEntry &entry)
+                       {
+                           outFile<<setw(12)<<entry.name<<setw(12)<<entry.ped.mean/nTotal
+                                  <<setw(12)<<entry.ped.sigma/nTotal<<setw(12)<<entry.lms.mean/nTotal
+                                  <<setw(12)<<entry.lms.sigma/nTotal<<endl;
+                       };
+
+    for (auto &entry : table.channels){
+        if (entry.name[0] == 'W' || entry.name[0] == 'G') write_entry(entry);
     }
-    for (int i=0; i<NREFERENCE; i++){
-        string thisName(Form("LMS%d", i+1));
-        outFile<<setw(12)<<thisName<<setw(12)<<refPedMean[i]/nTotal
-               <<setw(12)<<refPedSigma[i]/nTotal<<setw(12)<<refLMSMean[i]/nTotal
-               <<setw(12)<<refLMSSigma[i]/nTotal<<endl;
+    for (auto &entry : table.channels){
+        if (!entry.name.compare(0, 3, "LMS")) write_entry(entry);
     }
     outFile.close();
 
@@ -305,64 +266,48 @@ void WriteOutput(double nTotal, int rNumber)
     gainFile.open(gainFileName, std::ofstream::out | std::ofstream::app);
 
     string period;
-    if (doAverage) period = Form("%d_%d", startRun, endRun);
-    else period = Form("%d", rNumber);
+    if (doAverage) period = to_string(startRun) + "_" + to_string(endRun);
+    else period = to_string(rNumber);
 
-    gainFile<<setw(12)<<period<<setw(12)<<refGain[0]/nTotal<<setw(12)<<
-    refGain[1]/nTotal<<setw(12)<<refGain[2]/nTotal<<endl;
+    gainFile<<setw(12)<<period;
+    for (auto &gain : table.ref_gains){
+        gainFile<<setw(12)<<gain/nTotal;
+    }
+    gainFile<<endl;
     gainFile.close();
 }
 //_________________________________________________________________________________
-int GetRunNumber(string run)
-{
-    string sub = run.substr(strlen(run.c_str())-13 , 4);
-    if (sub.at(0) == '0'){
-        return stoi(sub.substr(1,4));
-    }else{
-        return stoi(sub);
-    }
-}
-//__________________________________________________________________________________
-bool SortFile(string name1, string name2)
+int GetRunNumber(const string &path)
 {
-    return (GetRunNumber(name1) < GetRunNumber(name2)) ;
+    string name = ConfigParser::decompose_path(path).name;
+    return ConfigParser::find_integer(name);
 }
 //__________________________________________________________________________________
-void FindInputFiles()
+vector<string> FindInputFiles()
 {
-    inputFiles.clear();
+    vector<string> inputFiles;
     void* dirp = gSystem->OpenDirectory(inputDir.c_str());
     if (!dirp) {
         cerr << "Error: Can't open input file directory "<< inputDir << endl;
-        return;
+        return inputFiles;
     }
     cout<<"Scanning for input files in "<< inputDir <<" "<<flush;
     const char* dir_item;
     while( (dir_item = gSystem->GetDirEntry(dirp)) ){
-        if (!strncmp("prad_", dir_item, 5) && !strncmp("LMS.root", dir_item+strlen(dir_item)-8, 8)){
-        string thisName = inputDir;
-        thisName.append("/");
-        thisName.append(dir_item);
-        int runNumber = GetRunNumber(thisName);
-        if (runNumber <= endRun && runNumber >= startRun)
-            inputFiles.push_back(thisName);
+        string file_name = dir_item;
+        if (!file_name.compare(0, 5, "prad_") && file_name.size() > 4 &&
+            file_name.substr(file_name.size() - 4) == ".dst"){
+            string thisName = inputDir;
+            thisName.append("/");
+            thisName.append(file_name);
+            int runNumber = GetRunNumber(thisName);
+            if (runNumber <= endRun && runNumber >= startRun)
+                inputFiles.push_back(thisName);
         }
     }
     cout<<endl<< "Found "<<inputFiles.size() <<" input files "<<endl;
-    std::sort(inputFiles.begin(), inputFiles.end(), SortFile);
+    std::sort(inputFiles.begin(), inputFiles.end(),
+              [] (const string &a, const string &b) {return GetRunNumber(a) < GetRunNumber(b);});
     gSystem->FreeDirectory(dirp);
-}
-//__________________________________________________________________________________
-double GetMaxBinCenterInRange(TH1* h, double xmin, double xmax)
-{
-    double max = 0;
-    double save = 0;
-    for (int i=1; i<h->GetXaxis()->GetNbins(); i++){
-        if (h->GetBinCenter(i) < xmin || h->GetBinCenter(i) > xmax) continue;
-        if (h->GetBinContent(i) > save) {
-            save = h->GetBinContent(i);
-            max  = h->GetBinCenter(i);
-        }
-    }
-    return max;
+    return inputFiles;
 }
@@ -0,0 +1,47 @@
+//============================================================================//
+// An example to build the block index sidecar files for evio files           //
+// The index allows PRadEvioParser::SeekEvent to jump to an event directly    //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEvioParser.h"
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2) {
+        cout << "usage: " << argv[0] << " <evio_file> [<evio_file> ...]" << endl;
+        return -1;
+    }
+
+    PRadEvioParser parser(nullptr);
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!parser.BuildIndex(argv[i], true)) {
+            cout << "Failed to index " << argv[i] << endl;
+            continue;
+        }
+
+        auto &index = parser.GetBlockIndex();
+        unsigned int first = 0, last = 0, nevents = 0;
+        for(auto &block : index)
+        {
+            nevents += block.nevents;
+            if(block.first && !first) first = block.first;
+            if(block.last) last = block.last;
+        }
+
+        cout << argv[i] << ": " << index.size() << " blocks, "
+             << nevents << " events (" << first << " - " << last << "), "
+             << "index saved to " << PRadEvioParser::index_path(argv[i])
+             << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+//============================================================================//
+// An application to merge DST files into one file in the given order         //
+// The records are copied without decoding, and the inputs are copied in      //
+// parallel                                                                   //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDSTMerger.h"
+#include "PRadBenchMark.h"
+#include "ConfigOption.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_require, 'j');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: mergeDST <out_file> <in_file1> [in_file2] ...");
+    conf_opt.SetDesc('j', "number of input files copied in parallel, default is the number of hardware threads.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() < 2) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    unsigned int threads = thread::hardware_concurrency();
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 'j':
+            threads = opt.var.Int();
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    string output = conf_opt.GetArgument(0).String();
+    vector<string> inputs;
+    for(size_t i = 1; i < conf_opt.NbofArgs(); ++i)
+        inputs.push_back(conf_opt.GetArgument(i).String());
+
+    PRadDSTMerger merger(threads);
+    PRadBenchMark timer;
+    if(!merger.Merge(inputs, output)) {
+        cout << "Failed to merge the files into " << output << endl;
+        return -1;
+    }
+
+    double t = timer.GetElapsedTime();
+    cout << "TIMER: Finished, merged " << merger.GetMergedRecords() << " records ("
+         << merger.GetMergedBytes()/1e6 << " MB) from " << inputs.size()
+         << " files, took " << t << " ms" << endl;
+
+    return 0;
+}
@@ -54,6 +54,8 @@ void Evaluate(const string &file)
 
     PRadDSTParser dst_parser;
     dst_parser.OpenInput(file);
+    // only HyCal is analyzed, the other banks are kept in the copied records
+    dst_parser.SetBankMask(PRadDSTParser::ADC_Bank | PRadDSTParser::TDC_Bank);
     dst_parser.OpenOutput(fname + "_sav.dst");
     PRadDSTParser dst_parser2;
     dst_parser2.OpenOutput(fname + "_rej.dst");
@@ -66,18 +68,21 @@ void Evaluate(const string &file)
     TH1F hist_rsq("R Square", "R Square", 100, 0., 1.);
     TH1F hist_chisq("Chi Square", "Chi Square", 100, 0., 10.);
 
+    // the selected records are copied without re-encoding
+    PRadDSTParser::RawRecord record;
+
     int count = 0;
     PRadBenchMark timer;
     while(dst_parser.Read())
     {
         if(dst_parser.EventType() == PRadDSTParser::Type::event) {
 
-            auto event = dst_parser.GetEvent();
+            auto &event = dst_parser.GetCurrentEvent();
 
             // save sync event no matter what it is
             if(event.is_sync_event())
             {
-                dst_parser.Write(event);
+                dst_parser.WriteEvent();
                 continue;
             }
 
@@ -103,10 +108,12 @@ void Evaluate(const string &file)
 
             if((param.group_energy.maximum > 1.3 * beam_energy) ||
                ((param.max_group_size == 1) && (param.group_energy.maximum > 0.2 * beam_energy)) ||
-               (param.max_group_size == 0))
-                dst_parser2.Write(event);
-            else
-                dst_parser.Write(event);
+               (param.max_group_size == 0)) {
+                dst_parser.GetRecord(record);
+                dst_parser2.WriteRecord(record);
+            } else {
+                dst_parser.WriteEvent();
+            }
 
         } else if (dst_parser.EventType() == PRadDSTParser::Type::epics) {
             dst_parser.WriteEPICS();
@@ -18,10 +18,13 @@
 
 //#define NEW_NET
 #define PROGRESS_COUNT 10000
+#define REJECT_BLOCK 4096
 
 using namespace std;
 
 void NeuralReject(CNeuralNetwork &net, PRadHyCalSystem &sys, string path);
+void RejectBlock(CNeuralNetwork &net, vector<EventData> &events, vector<float> &inputs,
+                 TH1F &hist, PRadDSTParser &rej, PRadDSTParser &sav, int &reject);
 
 int main(int argc, char *argv[])
 {
@@ -63,6 +66,11 @@ void NeuralReject(CNeuralNetwork &net, PRadHyCalSystem &sys, string path)
 
     int count = 0, reject = 0;
     PRadBenchMark timer;
+
+    // events are evaluated by the network in blocks
+    vector<EventData> events;
+    vector<float> inputs;
+    events.reserve(REJECT_BLOCK);
     while(dst_parser.Read())
     {
         if(dst_parser.EventType() == PRadDSTParser::Type::event)
@@ -81,19 +89,15 @@ void NeuralReject(CNeuralNetwork &net, PRadHyCalSystem &sys, string path)
 
             // choose this event, get energies for all modules
             auto param = AnalyzeEvent(&sys, event);
-            net.Update(param.GetParamList());
-            hist.Fill(net.GetOutput().at(0));
-            if(net.GetOutput().at(0) > 0.5)
-            {
-                dst_parser.Write(event);
-                reject++;
-            }
-            else
-            {
-                dst_parser2.Write(event);
-            }
+            for(auto &val : param.GetParamList())
+                inputs.push_back(val);
+            events.emplace_back(move(event));
+
+            if(events.size() >= REJECT_BLOCK)
+                RejectBlock(net, events, inputs, hist, dst_parser, dst_parser2, reject);
         }
     }
+    RejectBlock(net, events, inputs, hist, dst_parser, dst_parser2, reject);
 
     cout << "----------event " << count
          << "-------[ " << timer.GetElapsedTimeStr() << " ]------"
@@ -104,3 +108,29 @@ void NeuralReject(CNeuralNetwork &net, PRadHyCalSystem &sys, string path)
     hist.Write();
     f.Save();
 }
+
+// evaluate a block of events and write them to the output files
+void RejectBlock(CNeuralNetwork &net, vector<EventData> &events, vector<float> &inputs,
+                 TH1F &hist, PRadDSTParser &rej, PRadDSTParser &sav, int &reject)
+{
+    vector<float> outputs(events.size()*net.GetOutputSize());
+    net.UpdateBatch(inputs.data(), events.size(), outputs.data());
+
+    for(size_t i = 0; i < events.size(); ++i)
+    {
+        float prob = outputs[i*net.GetOutputSize()];
+        hist.Fill(prob);
+        if(prob > 0.5)
+        {
+            rej.Write(events[i]);
+            reject++;
+        }
+        else
+        {
+            sav.Write(events[i]);
+        }
+    }
+
+    events.clear();
+    inputs.clear();
+}
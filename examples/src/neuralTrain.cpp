@@ -17,6 +17,7 @@
 #include <cstdlib>
 #include <random>
 #include <vector>
+#include <algorithm>
 
 #define PROGRESS_COUNT 1000
 #define NN_INPUT 6
@@ -29,7 +30,8 @@ void NeuralTrain(CNeuralNetwork &net,
                  const string &path,
                  const string &path2,
                  int train_times,
-                 unsigned int cap);
+                 unsigned int cap,
+                 unsigned int batch);
 
 void FillParams(PRadHyCalSystem &sys,
                 const string &path,
@@ -41,6 +43,8 @@ int main(int argc, char *argv[])
     string net_path, save_path, layer_str;
     double learn_factor = 0.1;
     int learn_times = 5000, cap = 1000;
+    unsigned int batch = 0, threads = 0;
+    CNeuralNetwork::Optimizer optimizer = CNeuralNetwork::SGD;
 
     save_path = "saved.net";
 
@@ -51,6 +55,9 @@ int main(int argc, char *argv[])
     conf_opt.AddOpts(ConfigOption::arg_require, 'f', "learning-factor");
     conf_opt.AddOpts(ConfigOption::arg_require, 't', "training-times");
     conf_opt.AddOpts(ConfigOption::arg_require, 'c', "bank-capacity");
+    conf_opt.AddOpts(ConfigOption::arg_require, 'b', "batch-size");
+    conf_opt.AddOpts(ConfigOption::arg_require, 'o', "optimizer");
+    conf_opt.AddOpts(ConfigOption::arg_require, 'j', "threads");
     conf_opt.AddOpts(ConfigOption::help_message, 'h', "help");
 
     conf_opt.SetDesc("neuralTrain <cosmic_data> <good_data>");
@@ -60,6 +67,9 @@ int main(int argc, char *argv[])
     conf_opt.SetDesc('f', "define learning factor, 0.1 is the default value.");
     conf_opt.SetDesc('t', "set the training times (1,000 as the unit), 5,000k is the default value.");
     conf_opt.SetDesc('c', "set the training bank capacity (1,000 as the unit), 1,000k is the default value.");
+    conf_opt.SetDesc('b', "set the mini-batch size, 0 (default) means training with one pair of events each time.");
+    conf_opt.SetDesc('o', "set the optimizer for mini-batch training, \"sgd\" (default), \"momentum\" or \"adam\".");
+    conf_opt.SetDesc('j', "set the number of threads for mini-batch training, 0 (default) means all cores.");
     conf_opt.SetDesc('h', "show instruction.");
 
     if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() != 2) {
@@ -89,6 +99,22 @@ int main(int argc, char *argv[])
         case 'l':
             layer_str = opt.var.String();
             break;
+        case 'b':
+            batch = opt.var.Int();
+            break;
+        case 'j':
+            threads = opt.var.Int();
+            break;
+        case 'o':
+            if(opt.var.String() == "momentum") {
+                optimizer = CNeuralNetwork::Momentum;
+            } else if(opt.var.String() == "adam") {
+                optimizer = CNeuralNetwork::Adam;
+            } else if(opt.var.String() != "sgd") {
+                cout << "Unknown optimizer " << opt.var.String() << endl;
+                return -1;
+            }
+            break;
         default:
             std::cout << conf_opt.GetInstruction() << std::endl;
             return -1;
@@ -133,10 +159,13 @@ int main(int argc, char *argv[])
         }
     }
 
+    my_net.SetOptimizer(optimizer);
+    my_net.SetThreads(threads);
+
     PRadHyCalSystem sys;
     sys.Configure("config/hycal.conf");
 
-    NeuralTrain(my_net, sys, cosmic_file, good_file, learn_times*1000, cap*1000);
+    NeuralTrain(my_net, sys, cosmic_file, good_file, learn_times*1000, cap*1000, batch);
 
     my_net.SaveNet(save_path.c_str());
     return 0;
@@ -147,7 +176,8 @@ void NeuralTrain(CNeuralNetwork &net,
                  const string &path,
                  const string &path2,
                  int number,
-                 unsigned int cap)
+                 unsigned int cap,
+                 unsigned int batch)
 {
 
     vector<vector<double>> cosmic_params;
@@ -173,6 +203,37 @@ void NeuralTrain(CNeuralNetwork &net,
 
     int count = 0;
     PRadBenchMark timer;
+
+    // mini-batch training, half cosmic and half good events in a batch
+    if(batch > 0) {
+        unsigned int half = (batch + 1)/2;
+        vector<double> inputs, expects;
+        while(count < number)
+        {
+            inputs.clear();
+            expects.clear();
+            for(unsigned int i = 0; i < half; ++i)
+            {
+                auto &cosmic_input = cosmic_params.at(cosmic_dist(rng));
+                inputs.insert(inputs.end(), cosmic_input.begin(), cosmic_input.end());
+                expects.insert(expects.end(), cosmic_expect.begin(), cosmic_expect.end());
+
+                auto &good_input = good_params.at(good_dist(rng));
+                inputs.insert(inputs.end(), good_input.begin(), good_input.end());
+                expects.insert(expects.end(), good_expect.begin(), good_expect.end());
+            }
+            net.BatchTrain(inputs.data(), expects.data(), 2*half);
+
+            int prev = count;
+            count = min(number, count + (int)half);
+            if(count/PROGRESS_COUNT != prev/PROGRESS_COUNT) {
+                cout << "----------training " << count
+                     << "-------[ " << timer.GetElapsedTimeStr() << " ]------"
+                     << "\r" << flush;
+            }
+        }
+    }
+
     while(++count <= number)
     {
         if(count%PROGRESS_COUNT == 0) {
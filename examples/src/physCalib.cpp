@@ -21,11 +21,13 @@ int main(int argc, char * argv [])
     ConfigOption conf_opt;
     conf_opt.AddOpt(ConfigOption::arg_require, 'i');
     conf_opt.AddOpt(ConfigOption::arg_require, 'o');
+    conf_opt.AddOpt(ConfigOption::arg_require, 't');
     conf_opt.AddOpt(ConfigOption::help_message, 'h');
 
     conf_opt.SetDesc("usage: physCalib <options> <begin_run> <end_run>");
     conf_opt.SetDesc('i', "input file directory");
     conf_opt.SetDesc('o', "output file directory");
+    conf_opt.SetDesc('t', "number of threads, 0 means all the hardware threads, default 0");
     conf_opt.SetDesc('h', "show instruction");
 
     // determine input files
@@ -34,6 +36,7 @@ int main(int argc, char * argv [])
     run[1] = 999999;
     string in_dir = "./"; //define your dst data file folder here
     string out_dir = "./";
+    unsigned int nthreads = 0;
 
     if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() != 2) {
         std::cout << conf_opt.GetInstruction() << std::endl;
@@ -50,6 +53,9 @@ int main(int argc, char * argv [])
         case 'i':
             in_dir = opt.var.String();
             break;
+        case 't':
+            nthreads = opt.var.Int();
+            break;
         default:
             std::cout << conf_opt.GetInstruction() << std::endl;
             return -1;
@@ -70,16 +76,11 @@ int main(int argc, char * argv [])
         return -1;
     }
 
-    hycal_sys = new PRadHyCalSystem("config/hycal.conf");
-    gem_sys = new PRadGEMSystem("config/gem.conf");
-    epics = new PRadEPICSystem("config/epics_channels.conf");
-    coord_sys = new PRadCoordSystem("database/coordinates.dat");
-    det_match = new PRadDetMatch("config/det_match.conf");
-    dst_parser = new PRadDSTParser();
-
-    hycal = hycal_sys->GetDetector();
-    gem1 = gem_sys->GetDetector("PRadGEM1");
-    gem2 = gem_sys->GetDetector("PRadGEM2");
+    PRadHyCalSystem *hycal_sys = new PRadHyCalSystem("config/hycal.conf");
+    PRadGEMSystem *gem_sys = new PRadGEMSystem("config/gem.conf");
+    PRadEPICSystem *epics = new PRadEPICSystem("config/epics_channels.conf");
+    PRadCoordSystem *coord_sys = new PRadCoordSystem("database/coordinates.dat");
+    PRadDetMatch *det_match = new PRadDetMatch("config/det_match.conf");
 
     InitInnerModule();
     InitProfileData();
@@ -89,125 +90,117 @@ int main(int argc, char * argv [])
     string out_file = "cal" + to_string(run[0]) + "_" + to_string(run[1]) + ".root";
     TFile *f = new TFile((out_dir + out_file).c_str(), "RECREATE");
 
-    InitHistogram();  //initialize global histograms
-    HyCalZ = 5817.;  //fDetCoor->GetHyCalZ();
-
     //------------------------------analyze events--------------------------------//
-    for (auto &file : inputFiles)
-    {
-        dst_parser->OpenInput(file.c_str());
+    // the files are analyzed in parallel by the calibration pipeline, every
+    // thread has its own copies of the systems and histograms
+    PhysCalibAnalyzer analyzer(hycal_sys->GetDetector(), epics->GetChannel("MBSY2C_energy"));
+
+    PRadCalibPipeline pipeline(nthreads);
+    pipeline.SetHyCalSystem(hycal_sys);
+    pipeline.SetGEMSystem(gem_sys);
+    pipeline.SetCoordSystem(coord_sys);
+    pipeline.SetDetMatch(det_match);
+    pipeline.AcceptTrigger(PHYS_LeadGlassSum);
+    pipeline.AcceptTrigger(PHYS_TotalSum);
+    pipeline.Process(inputFiles, &analyzer);
 
-        cout << "Open input file: " << file << endl;
-
-        hycal_sys->ChooseRun(file);
+    //----------------------------------------------------------------------------//
 
-        coord_sys->ChooseCoord(PRadInfoCenter::GetRunNumber());
+    analyzer.Write(f);
+    f->Close();
 
-        int count = 0;
-        int beam_energy_ch = epics->GetChannel("MBSY2C_energy");
-        PRadBenchMark timer;
-        while(dst_parser->Read())
-        {
-            if(dst_parser->EventType() == PRadDSTParser::Type::event) {
-                auto event = dst_parser->GetEvent();
-
-                if (!(event.trigger == PHYS_LeadGlassSum || event.trigger == PHYS_TotalSum))
-                    continue;
-
-                count++;
-                if (count%PROGRESS_COUNT == 0) {
-                    cout <<"------[ ev " << count << " ]---"
-                         << "---[ " << timer.GetElapsedTimeStr() << " ]---"
-                         << "---[ " << timer.GetElapsedTime()/(double)count << " ms/ev ]------"
-                         << "\r" << flush;
-                }
-
-                current_event = &event;
-                //reconstruct HyCal clusters
-                hycal_sys->Reconstruct(event);
-                //reconstruct GEM clusters
-                gem_sys->Reconstruct(event);
-
-                //get reconstructed hits
-                auto &hycal_hits = hycal->GetHits();
-                auto &gem1_hits = gem1->GetHits();
-                auto &gem2_hits = gem2->GetHits();
-
-                // check cluster size
-	            clusterN = hycal_hits.size();
-	            if (clusterN >= MAXCLUSTER) continue;
-
-                //transform coordinates to beam frame
-                coord_sys->Transform(hycal->GetDetID(), hycal_hits.begin(), hycal_hits.end());
-                coord_sys->Transform(gem1->GetDetID(), gem1_hits.begin(), gem1_hits.end());
-                coord_sys->Transform(gem2->GetDetID(), gem2_hits.begin(), gem2_hits.end());
-
-                // projection, default projection is from target to hycal surface
-                coord_sys->Projection(hycal_hits.begin(), hycal_hits.end());
-                coord_sys->Projection(gem1_hits.begin(), gem1_hits.end());
-                coord_sys->Projection(gem2_hits.begin(), gem2_hits.end());
-
-                // match hits
-                auto matched = det_match->Match(hycal_hits, gem1_hits, gem2_hits);
-
-                // fill gem hits if only 1 cluster is detected
-                if(gem1_hits.size() == 1) GEM_ep_x_y->Fill(gem1_hits.front().x, gem1_hits.front().y);
-                if(gem2_hits.size() == 1) GEM_ep_x_y->Fill(gem2_hits.front().x, gem2_hits.front().y);
-
-                // combine hycalhits and gemhits if matched
-                CombinedHit *myhits = new CombinedHit[clusterN];
-                for(int i = 0; i < clusterN; ++i)
-                {
-                    myhits[i] = hycal_hits[i];
-                }
+    return 0;
+}
+//____________________________________________________________________________________________
+PhysCalibAnalyzer::PhysCalibAnalyzer(PRadHyCalDetector *det, int beam_ch)
+: hycal(det), beam_energy_ch(beam_ch), current_event(nullptr), clusterN(0), eventNumber(0),
+  Ebeam(0.), HyCalZ(5817.) //fDetCoor->GetHyCalZ();
+{
+    countFill.resize(innerModule.size(), 0);
+    std::fill(&moduleEnergy[0][0][0], &moduleEnergy[0][0][0] + 64*12*12, 0.);
+    InitHistogram();
+}
+//____________________________________________________________________________________________
+PRadCalibAnalyzer *PhysCalibAnalyzer::Clone()
+const
+{
+    return new PhysCalibAnalyzer(hycal, beam_energy_ch);
+}
+//____________________________________________________________________________________________
+void PhysCalibAnalyzer::Process(const CalibEvent &event)
+{
+    current_event = &event;
+    // the modules of the worker system have the energies of the chosen event
+    hycal = event.hycal_sys->GetDetector();
+
+    // only update beam energy when there is an epics event
+    if(event.epics)
+        Ebeam = event.epics->values.at(beam_energy_ch);
+
+    //get reconstructed hits
+    auto &hycal_hits = event.hycal_hits;
+    auto &gem1_hits = event.gem1_hits;
+    auto &gem2_hits = event.gem2_hits;
+
+    // check cluster size
+    clusterN = hycal_hits.size();
+    if (clusterN >= MAXCLUSTER) return;
+
+    // fill gem hits if only 1 cluster is detected
+    if(gem1_hits.size() == 1) GEM_ep_x_y->Fill(gem1_hits.front().x, gem1_hits.front().y);
+    if(gem2_hits.size() == 1) GEM_ep_x_y->Fill(gem2_hits.front().x, gem2_hits.front().y);
+
+    // combine hycalhits and gemhits if matched
+    myhits.assign(clusterN, CombinedHit());
+    for(int i = 0; i < clusterN; ++i)
+    {
+        myhits[i] = hycal_hits[i];
+    }
 
-                // set the matched gem position
-                for(auto hit : matched)
-                {
-                    myhits[hit.hycal_idx].x_gem = hit.x;
-                    myhits[hit.hycal_idx].y_gem = hit.y;
-                    // take the matching flag in
-                    myhits[hit.hycal_idx].match_flag = hit.mflag;
-                }
+    // set the matched gem position
+    for(auto hit : event.matched)
+    {
+        myhits[hit.hycal_idx].x_gem = hit.x;
+        myhits[hit.hycal_idx].y_gem = hit.y;
+        // take the matching flag in
+        myhits[hit.hycal_idx].match_flag = hit.mflag;
+    }
 
-	            //get beam energy
-	            eventNumber = event.event_number;
-	            h_beam_e->Fill(Ebeam);
-	            if (clusterN == 1) {
-	                EPAnalyzer(myhits);
-	            }
-	            else if (clusterN == 2) {
-	                MollerAnalyzer(myhits);
-	                OffsetAnalyzer(myhits);
-	            }
-	            else if (clusterN > 2) {
-                    MultiHitAnalyzer(myhits, clusterN);
-                }
+    //get beam energy
+    eventNumber = event.event->event_number;
+    h_beam_e->Fill(Ebeam);
+    if (clusterN == 1) {
+        EPAnalyzer(&myhits[0]);
+    }
+    else if (clusterN == 2) {
+        MollerAnalyzer(&myhits[0]);
+        OffsetAnalyzer(&myhits[0]);
+    }
+    else if (clusterN > 2) {
+        MultiHitAnalyzer(&myhits[0], clusterN);
+    }
+}
+//____________________________________________________________________________________________
+// the moller pairs left in the clones are not merged
+void PhysCalibAnalyzer::Merge(const PRadCalibAnalyzer &that)
+{
+    PRadCalibAnalyzer::Merge(that);
 
-                delete [] myhits;
+    auto &ana = static_cast<const PhysCalibAnalyzer&>(that);
+    for (unsigned int i=0; i<countFill.size(); i++) {
+        countFill[i] += ana.countFill[i];
+    }
+    for (int i=0; i<64; i++) {
+        for (int j=0; j<12; j++) {
+            for (int k=0; k<12; k++) {
+                moduleEnergy[i][j][k] += ana.moduleEnergy[i][j][k];
             }
-            else if(dst_parser->EventType() == PRadDSTParser::Type::epics) {
-                auto epics_ev = dst_parser->GetEPICS();
-	            // save epics into handler, otherwise get epicsvalue won't work
-	            epics->AddEvent(epics_ev);
-                // only update beam energy when there is an epics event
-                Ebeam = epics_ev.values.at(beam_energy_ch);
-                // or it can find the value that is closest to current event
-                // Ebeam = epics->FindValue(eventNumber,"MBSY2C_energy");
-	        }
         }
-
-        dst_parser->CloseInput();
-        cout <<"------[ ev " << count << " ]---"
-             << "---[ " << timer.GetElapsedTimeStr() << " ]---"
-             << "---[ " << timer.GetElapsedTime()/(double)count << " ms/ev ]------"
-             << endl;
-        cout << "Analyzed " << file << "."
-             << endl;
     }
-
-    //----------------------------------------------------------------------------//
-
+}
+//____________________________________________________________________________________________
+void PhysCalibAnalyzer::Finish()
+{
     double maxModuleEnergy = 0;
     for (unsigned int i=0; i<innerModule.size(); i++) {
         if (countFill[i] == 0) continue;
@@ -223,7 +216,10 @@ int main(int argc, char * argv [])
         profile[i]->Fill(5, 6, -0.01*maxModuleEnergy);
         profile[i]->Fill(6, 5, -0.01*maxModuleEnergy);
     }
-
+}
+//____________________________________________________________________________________________
+void PhysCalibAnalyzer::Write(TFile *f)
+{
     f->cd();
 
     h_beam_e->Write();
@@ -279,12 +275,9 @@ int main(int argc, char * argv [])
         ratio_x[i]->Write();
         ratio_y[i]->Write();
     }
-  f->Close();
-
-  return 0;
 }
 //____________________________________________________________________________________________
-void InitHistogram()
+void PhysCalibAnalyzer::InitHistogram()
 {
     float Ehigh = 0;
     int nBin = 0;
@@ -297,29 +290,29 @@ void InitHistogram()
         nBin = 270;
     }
 
-    h_beam_e = new TH1F("h_beam_e","beam E",500, 0, Ehigh);
-    ep_x_y = new TH2F("ep_x_y","ep cluster position",500,-600,600,500,-600,600);
+    h_beam_e = Book(new TH1F("h_beam_e","beam E",500, 0, Ehigh));
+    ep_x_y = Book(new TH2F("ep_x_y","ep cluster position",500,-600,600,500,-600,600));
     ep_x_y->SetOption("colz");
-    GEM_x_y = new TH2F("GEM_x_y","GEM hiy position",500,-600,600,500,-600,600);
+    GEM_x_y = Book(new TH2F("GEM_x_y","GEM hiy position",500,-600,600,500,-600,600));
     GEM_x_y->SetOption("colz");
-    GEM_ep_x_y = new TH2F("GEM_ep_x_y","GEM ep hit position",500,-600,600,500,-600,600);
+    GEM_ep_x_y = Book(new TH2F("GEM_ep_x_y","GEM ep hit position",500,-600,600,500,-600,600));
     GEM_ep_x_y->SetOption("colz");
-    ep_ratio_all = new TH1F("ep_ratio_all","ep ratio all",500,0.0,2.0);
-    ep_angle_E = new TH2F("ep_angle_E","ep recE vs angle",500,0.0,8.0,500,0,Ehigh);
+    ep_ratio_all = Book(new TH1F("ep_ratio_all","ep ratio all",500,0.0,2.0));
+    ep_angle_E = Book(new TH2F("ep_angle_E","ep recE vs angle",500,0.0,8.0,500,0,Ehigh));
     ep_angle_E->SetOption("colz");
-    ee1_x_y = new TH2F("ee1_x_y","ee1 cluster position",500,-600,600,500,-600,600);
+    ee1_x_y = Book(new TH2F("ee1_x_y","ee1 cluster position",500,-600,600,500,-600,600));
     ee1_x_y->SetOption("colz");
-    ee2_x_y = new TH2F("ee2_x_y","ee2 cluster position",500,-600,600,500,-600,600);
+    ee2_x_y = Book(new TH2F("ee2_x_y","ee2 cluster position",500,-600,600,500,-600,600));
     ee2_x_y->SetOption("colz");
-    ee_ratio_all = new TH1F("ee_ratio_all","ee ratio all",500,0.0,2.0);
-    ee_angle_E = new TH2F("ee_angle_E","ee recE vs angle",500,0.0,8.0,500,0,Ehigh);
+    ee_ratio_all = Book(new TH1F("ee_ratio_all","ee ratio all",500,0.0,2.0));
+    ee_angle_E = Book(new TH2F("ee_angle_E","ee recE vs angle",500,0.0,8.0,500,0,Ehigh));
     ee_angle_E->SetOption("colz");
-    sym_ee_x_y = new TH2F("sym_ee_x_y", "sym_ee_x_y", 500, -600, 600, 500, -600, 600);
+    sym_ee_x_y = Book(new TH2F("sym_ee_x_y", "sym_ee_x_y", 500, -600, 600, 500, -600, 600));
     sym_ee_x_y->SetOption("colz");
-    sym_ee_E = new TH1F("sym_ee_E", "sym_ee_E", 500, Ehigh/2. - 500, Ehigh/2. + 500);
-    eloss = new TH2F("eloss", "eloss", 500, 0, Ehigh, 500, 0, 5);
+    sym_ee_E = Book(new TH1F("sym_ee_E", "sym_ee_E", 500, Ehigh/2. - 500, Ehigh/2. + 500));
+    eloss = Book(new TH2F("eloss", "eloss", 500, 0, Ehigh, 500, 0, 5));
     eloss->SetOption("colz");
-    total_angle_E = new TH2F("total_angle_E", "total_angle_E", 500, 0, 8.0, 500, 0, Ehigh);
+    total_angle_E = Book(new TH2F("total_angle_E", "total_angle_E", 500, 0, 8.0, 500, 0, Ehigh));
     total_angle_E->SetOption("colz");
 
     for(int i=0;i<T_BLOCKS;i++) {
@@ -329,10 +322,10 @@ void InitHistogram()
             string ep_name2 = "ep_energy_" + module->GetName();
             string ee_name1 = "ee_ratio_" + module->GetName();
             string ee_name2 = "ee_energy_" + module->GetName();
-            ep_ratio[i] = new TH1F(ep_name1.c_str(),ep_name1.c_str(),200,0,2);
-            ep_energy[i] = new TH1F(ep_name2.c_str(),ep_name2.c_str(),nBin,0,Ehigh);
-            ee_ratio[i] = new TH1F(ee_name1.c_str(),ee_name1.c_str(),200,0,2);
-            ee_energy[i] = new TH1F(ee_name2.c_str(),ee_name2.c_str(),nBin,0,Ehigh);
+            ep_ratio[i] = Book(new TH1F(ep_name1.c_str(),ep_name1.c_str(),200,0,2));
+            ep_energy[i] = Book(new TH1F(ep_name2.c_str(),ep_name2.c_str(),nBin,0,Ehigh));
+            ee_ratio[i] = Book(new TH1F(ee_name1.c_str(),ee_name1.c_str(),200,0,2));
+            ee_energy[i] = Book(new TH1F(ee_name2.c_str(),ee_name2.c_str(),nBin,0,Ehigh));
         } else {
             ep_ratio[i] = nullptr;
             ep_energy[i] = nullptr;
@@ -342,26 +335,26 @@ void InitHistogram()
     }
 
     for (int i=0; i<2; i++) {
-        deltaCoor[i] = new TH1F(Form("delta_coor_%d", i+1), Form("delta_coor_%d", i+1), 500, -100, 100 );
-        coorIntersect[i] = new TH1F(Form("intersect_%d", i+1), Form("intersect_%d", i+1), 500, -50, 50);
-        deltaCoor_GEM[i] = new TH1F(Form("delta_coor_%d_GEM", i+1), Form("delta_coor_%d_GEM", i+1), 500, -20, 20 );
-        coorIntersect_GEM[i] = new TH1F(Form("intersect_%d_GEM", i+1), Form("intersect_%d_GEM", i+1), 500, -20, 20);
-        sym_ee_r[i] = new TH1F(Form("sym_ee_r_%d", i+1), Form("sym_ee_r_%d", i+1), 500, 50, 350);
+        deltaCoor[i] = Book(new TH1F(Form("delta_coor_%d", i+1), Form("delta_coor_%d", i+1), 500, -100, 100 ));
+        coorIntersect[i] = Book(new TH1F(Form("intersect_%d", i+1), Form("intersect_%d", i+1), 500, -50, 50));
+        deltaCoor_GEM[i] = Book(new TH1F(Form("delta_coor_%d_GEM", i+1), Form("delta_coor_%d_GEM", i+1), 500, -20, 20 ));
+        coorIntersect_GEM[i] = Book(new TH1F(Form("intersect_%d_GEM", i+1), Form("intersect_%d_GEM", i+1), 500, -20, 20));
+        sym_ee_r[i] = Book(new TH1F(Form("sym_ee_r_%d", i+1), Form("sym_ee_r_%d", i+1), 500, 50, 350));
     }
 
     for (unsigned int i=0; i<innerModule.size(); i++) {
-        TH2F* thisPlot = new TH2F(Form("profile_%d", innerModule[i]), Form("profile_%d", innerModule[i]), 12, 0, 12, 12, 0, 12);
+        TH2F* thisPlot = Book(new TH2F(Form("profile_%d", innerModule[i]), Form("profile_%d", innerModule[i]), 12, 0, 12, 12, 0, 12));
         thisPlot->SetOption("LEGO1");
         profile.push_back(thisPlot);
     }
 
     for (int i=0; i<12; i++) {
-        inner_ratio[i] = new TH1F(Form("inner_ratio_%d", innerModuleList[i]), Form("inner_ratio_%d", innerModuleList[i]), 500,  0, 100);
-        inner_deltax[i] = new TH1F(Form("inner_deltax_%d", innerModuleList[i]), Form("inner_deltax_%d", innerModuleList[i]), 500,  -60, 60);
-        inner_deltay[i] = new TH1F(Form("inner_deltay_%d", innerModuleList[i]), Form("inner_deltay_%d", innerModuleList[i]), 500,  -60, 60);
-        ratio_x[i] = new TH2F(Form("ratio_x_%d", innerModuleList[i]), Form("ratio_x_%d", innerModuleList[i]), 1000, -80, 80, 1000, 0, 2);
+        inner_ratio[i] = Book(new TH1F(Form("inner_ratio_%d", innerModuleList[i]), Form("inner_ratio_%d", innerModuleList[i]), 500,  0, 100));
+        inner_deltax[i] = Book(new TH1F(Form("inner_deltax_%d", innerModuleList[i]), Form("inner_deltax_%d", innerModuleList[i]), 500,  -60, 60));
+        inner_deltay[i] = Book(new TH1F(Form("inner_deltay_%d", innerModuleList[i]), Form("inner_deltay_%d", innerModuleList[i]), 500,  -60, 60));
+        ratio_x[i] = Book(new TH2F(Form("ratio_x_%d", innerModuleList[i]), Form("ratio_x_%d", innerModuleList[i]), 1000, -80, 80, 1000, 0, 2));
         ratio_x[i]->SetOption("colz");
-        ratio_y[i] = new TH2F(Form("ratio_y_%d", innerModuleList[i]), Form("ratio_y_%d", innerModuleList[i]), 1000, -80, 80, 1000, 0, 2);
+        ratio_y[i] = Book(new TH2F(Form("ratio_y_%d", innerModuleList[i]), Form("ratio_y_%d", innerModuleList[i]), 1000, -80, 80, 1000, 0, 2));
         ratio_y[i]->SetOption("colz");
     }
 }
@@ -385,7 +378,7 @@ void InitProfileData()
     parser.CloseFile();
 }
 //____________________________________________________________________________________________
-inline void EPAnalyzer(CombinedHit* h)
+void PhysCalibAnalyzer::EPAnalyzer(CombinedHit* h)
 {
     if (h[0].nblocks <= 3) return; //some channel has over charge
 
@@ -413,12 +406,12 @@ inline void EPAnalyzer(CombinedHit* h)
 
 }
 //____________________________________________________________________________________________
-void InnerModuleAnalyzer(CombinedHit* h)
+void PhysCalibAnalyzer::InnerModuleAnalyzer(CombinedHit* h)
 {
     if (! MatchedGEM(h[0]) || !TEST_BIT(h[0].flag, kPbWO4)) return;
 
     // we need module energy, so need to refresh all modules' energies by choose current event
-    hycal_sys->ChooseEvent(*current_event);
+    current_event->hycal_sys->ChooseEvent(*current_event->event);
 
     //we work here in the internal coordinate system of HyCal for now, unit in cm
     //x axis points to beam left, y points up
@@ -501,7 +494,7 @@ void InnerModuleAnalyzer(CombinedHit* h)
 	}
 }
 //____________________________________________________________________________________________
-inline void FillInnerHist(int& id, float& E, float& expectE, ParticleType type)
+void PhysCalibAnalyzer::FillInnerHist(int& id, float& E, float& expectE, ParticleType type)
 {
     if (type == kProton) {
         ep_ratio[id - 1]->Fill(E / expectE);
@@ -512,7 +505,7 @@ inline void FillInnerHist(int& id, float& E, float& expectE, ParticleType type)
     }
 }
 //____________________________________________________________________________________________
-inline void MollerAnalyzer(CombinedHit* h, int index1, int index2)
+void PhysCalibAnalyzer::MollerAnalyzer(CombinedHit* h, int index1, int index2)
 {
     int in[2] = {index1, index2};
     float r[2], phi[2], ratio[2], theta[2];
@@ -581,7 +574,7 @@ inline void MollerAnalyzer(CombinedHit* h, int index1, int index2)
     sym_ee_E->Fill(h[index2].E);
 }
 //____________________________________________________________________________________________
-inline void MultiHitAnalyzer(CombinedHit* h, int& n)
+void PhysCalibAnalyzer::MultiHitAnalyzer(CombinedHit* h, int& n)
 {
     if (n >= MAXCLUSTER) return;
     std::sort(h, h+n, SortForE);
@@ -608,7 +601,7 @@ inline void MultiHitAnalyzer(CombinedHit* h, int& n)
     MollerAnalyzer(h, 0, idSave);
 }
 //_________________________________________________________________________________________________
-inline void OffsetAnalyzer(CombinedHit* h)
+void PhysCalibAnalyzer::OffsetAnalyzer(CombinedHit* h)
 {
     assert(clusterN == 2); //we want only two cluster event to do this
 
@@ -648,7 +641,7 @@ inline void OffsetAnalyzer(CombinedHit* h)
     }
 }
 //_________________________________________________________________________________________________
-inline void LinesIntersect(float &xsect, float &ysect, float &xsect_GEM, float & ysect_GEM)
+void PhysCalibAnalyzer::LinesIntersect(float &xsect, float &ysect, float &xsect_GEM, float & ysect_GEM)
 {
     float xa[2];
     float ya[2];
@@ -723,7 +716,7 @@ vector<string> FindInputFiles(const string &in_dir, int start, int end)
 
 }
 //______________________________________________________________________________________________
-float GetExpectedEnergy(ParticleType type, float& x, float& y)
+float PhysCalibAnalyzer::GetExpectedEnergy(ParticleType type, float& x, float& y)
 {
     float theta = atan(sqrt(x*x + y*y)/HyCalZ);
     float expectE = Ebeam*targetMass[type] / ( Ebeam*(1.-cos(theta)) + targetMass[type] );
@@ -812,7 +805,6 @@ void InitInnerModule()
     for (int i=0; i<8; i++) {
         for (int j=0; j<8; j++) {
             innerModule.push_back(1000 + (startRow+i)*34 + startCol+j);
-            countFill.push_back(0);
             count++;
         }
     }
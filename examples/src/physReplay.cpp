@@ -1,6 +1,9 @@
 //============================================================================//
 // An example showing how to replay the dst files and extract all the phyiscs //
 // events information and save to root files                                  //
+// With -i, the evio files are decoded, reconstructed in batches on several   //
+// threads and written to the ntuple and/or a reconstructed-hit DST in one    //
+// pass, the raw DST is only written if it is requested                       //
 //                                                                            //
 // Weizhi Xiong                                                               //
 // 08/02/2017                                                                 //
@@ -8,6 +11,7 @@
 
 #include "PRadDataHandler.h"
 #include "PRadDSTParser.h"
+#include "PRadEventSink.h"
 #include "PRadInfoCenter.h"
 #include "PRadBenchMark.h"
 #include "PRadEPICSystem.h"
@@ -15,7 +19,9 @@
 #include "PRadHyCalSystem.h"
 #include "PRadGEMSystem.h"
 #include "PRadCoordSystem.h"
+#include "PRadConfigLoader.h"
 #include "PRadDetMatch.h"
+#include "ConfigOption.h"
 #include "canalib.h"
 #include "TFile.h"
 #include "TH1.h"
@@ -37,7 +43,11 @@ PRadGEMSystem *gem;
 PRadCoordSystem *coord_sys;
 PRadDetMatch *det_match;
 void physReplay(const string &path);
+void streamReplay(const string &input, int split, const string &raw_dst,
+                  const string &recon_dst, bool ntuple, unsigned int threads);
 void InitTree(TTree* t);
+void FillTree(TTree* t, int evNumber, const vector<HyCalHit> &hycal_hit,
+              const vector<MatchHit> &matched);
 ostream &operator <<(ostream &os, const PRadBenchMark &timer);
 
 #define MAXC 100
@@ -64,6 +74,29 @@ vector<string> inputFiles;
 int startRun = 0;
 int endRun = 9999;
 
+// fill the tree with the events from the batch reconstruction
+class NtupleOutput : public PRadReconOutput
+{
+public:
+    NtupleOutput(TTree *t, int ch) : tree(t), beam_energy_ch(ch) {}
+
+    void Write(const EventData &, const ReconData &recon)
+    {
+        FillTree(tree, recon.event_number, recon.hycal_hits, recon.match_hits);
+    }
+
+    // only update beam energy when there is an epics event
+    void WriteEPICS(const EpicsData &epics_ev)
+    {
+        if(beam_energy_ch >= 0 && beam_energy_ch < (int)epics_ev.values.size())
+            Ebeam = epics_ev.values.at(beam_energy_ch);
+    }
+
+private:
+    TTree *tree;
+    int beam_energy_ch;
+};
+
 int GetRunNumber(string run)
 {
     string sub = run.substr(strlen(run.c_str())-12 , 4);
@@ -106,26 +139,97 @@ void FindInputFiles()
 
 int main(int argc, char *argv[])
 {
-    if(argc != 3) {
-        cout << "usage: physReplay <start_run> <end_run> ..." << endl;
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_require, 'i');
+    conf_opt.AddOpt(ConfigOption::arg_require, 's');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'd');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'r');
+    conf_opt.AddOpt(ConfigOption::arg_none, 'n');
+    conf_opt.AddOpt(ConfigOption::arg_require, 't');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: physReplay <start_run> <end_run>, or physReplay -i <evio_file> [options]");
+    conf_opt.SetDesc('i', "decode and reconstruct the evio file in one pass instead of the dst files.");
+    conf_opt.SetDesc('s', "spliting file number of the evio file, default -1 (no splitting).");
+    conf_opt.SetDesc('d', "also write the decoded events to a raw DST file, only with -i.");
+    conf_opt.SetDesc('r', "write the reconstructed hits to a DST file, only with -i.");
+    conf_opt.SetDesc('n', "do not write the ntuple, only with -i.");
+    conf_opt.SetDesc('t', "number of reconstruction threads, default 0 (all hardware threads), only with -i.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv)) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    string evio_file, raw_dst, recon_dst;
+    int split = -1;
+    bool ntuple = true;
+    unsigned int threads = 0;
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 'i':
+            evio_file = opt.var.String();
+            break;
+        case 's':
+            split = opt.var.Int();
+            break;
+        case 'd':
+            raw_dst = opt.var.String();
+            break;
+        case 'r':
+            recon_dst = opt.var.String();
+            break;
+        case 'n':
+            ntuple = false;
+            break;
+        case 't':
+            threads = opt.var.Int();
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    if((evio_file.empty() && conf_opt.NbofArgs() != 2) ||
+       (!evio_file.empty() && conf_opt.NbofArgs() != 0)) {
+        cout << conf_opt.GetInstruction() << endl;
         return -1;
     }
 
     // get the prad root directory
-    string prad_root = getenv("PRAD_PATH");
+    const char *prad_env = getenv("PRAD_PATH");
+    string prad_root = prad_env ? prad_env : "";
     if(prad_root.size() && prad_root.back() != '/') prad_root += "/";
 
-    startRun = stoi(argv[1]);
-    endRun   = stoi(argv[2]);
-    FindInputFiles();
-
     // initialize objects
-    epics = new PRadEPICSystem(prad_root + "config/epics_channels.conf");
-    gem = new PRadGEMSystem(prad_root + "config/gem.conf");
-    hycal = new PRadHyCalSystem(prad_root + "config/hycal.conf");
-    coord_sys = new PRadCoordSystem(prad_root + "database/coordinates.dat");
+    epics = new PRadEPICSystem();
+    gem = new PRadGEMSystem();
+    hycal = new PRadHyCalSystem();
+    coord_sys = new PRadCoordSystem();
     det_match = new PRadDetMatch(prad_root + "config/det_match.conf");
 
+    // the configuration files are independent, load them concurrently
+    PRadConfigLoader loader;
+    loader.Add("EPICS Channels", [&] () {epics->ReadMap(prad_root + "config/epics_channels.conf");});
+    loader.Add("GEM System", [&] () {gem->Configure(prad_root + "config/gem.conf");});
+    loader.Add("HyCal System", [&] () {hycal->Configure(prad_root + "config/hycal.conf");});
+    loader.Add("Coordinates", [&] () {coord_sys->LoadCoordData(prad_root + "database/coordinates.dat");});
+    loader.Wait();
+    loader.Report();
+
+    if(!evio_file.empty()) {
+        streamReplay(evio_file, split, raw_dst, recon_dst, ntuple, threads);
+        return 0;
+    }
+
+    startRun = conf_opt.GetArgument(0).Int();
+    endRun   = conf_opt.GetArgument(1).Int();
+    FindInputFiles();
+
     for(unsigned int i = 0; i < inputFiles.size(); ++i)
     {
         cout<<"analyzing file "<<inputFiles[i]<<endl;
@@ -157,7 +261,7 @@ void physReplay(const string &path)
     while(dst_parser->Read())
     {
         if(dst_parser->EventType() == PRadDSTParser::Type::event) {
-            auto event = dst_parser->GetEvent();
+            auto &event = dst_parser->GetCurrentEvent();
 
             // only interested in physics event
             if(!event.is_physics_event())
@@ -198,69 +302,10 @@ void physReplay(const string &path)
 
             coord_sys->Projection(matched.begin(), matched.end());
 
-            eventNumber = event.event_number;
-
-            clusterN = hycal_hit.size() > MAXC ? MAXC : hycal_hit.size();
-
-            totalE = 0.;
-            //save info for HyCal
-            for (int i=0; i<clusterN; i++){
-                clusterE[i]    = hycal_hit[i].E;
-                totalE += clusterE[i];
-                clusterX[i]    = hycal_hit[i].x;
-                clusterY[i]    = hycal_hit[i].y;
-                clusterZ[i]    = hycal_hit[i].z;
-                clusterFlag[i] = hycal_hit[i].flag;
-                clusterNHit[i] = hycal_hit[i].nblocks;
-                clusterCID[i]  = hycal_hit[i].cid;
-                clusterTime[0][i] = hycal_hit[i].time[0];
-                clusterTime[1][i] = hycal_hit[i].time[1];
-                clusterTime[2][i] = hycal_hit[i].time[2];
-                //init array for GEM
-                GEMX[i] = 0;
-                GEMY[i] = 0;
-                GEMZ[i] = 0;
-                ONGEMX[i] = 0;
-                ONGEMY[i] = 0;
-                ONGEMZ[i] = 0;
-                GEMChargeX[i] = 0;
-                GEMChargeY[i] = 0;
-                GEMPeakX[i] = 0;
-                GEMPeakY[i] = 0;
-                GEMSizeX[i] = 0;
-                GEMSizeY[i] = 0;
-                GEMID[i] = -1;
-                // matching flag
-                clusterMatch[i] = 0;
-            }
-
-            for(auto &hit : matched)
-            {
-                GEMX[hit.hycal_idx]       = hit.x;
-                GEMY[hit.hycal_idx]       = hit.y;
-                GEMZ[hit.hycal_idx]       = hit.z;
-                clusterMatch[hit.hycal_idx]= hit.mflag;
-
-                GEMHit* thisHit = 0;
-                if (TEST_BIT(hit.mflag, kGEM1Match)) thisHit = &hit.gem1.front();
-                else if (TEST_BIT(hit.mflag, kGEM2Match))thisHit = &hit.gem2.front();
-
-                GEMChargeX[hit.hycal_idx] = thisHit->x_charge;
-                GEMChargeY[hit.hycal_idx] = thisHit->y_charge;
-                GEMPeakX[hit.hycal_idx]   = thisHit->x_peak;
-                GEMPeakY[hit.hycal_idx]   = thisHit->y_peak;
-                GEMSizeX[hit.hycal_idx]   = thisHit->x_size;
-                GEMSizeY[hit.hycal_idx]   = thisHit->y_size;
-                GEMID[hit.hycal_idx]      = thisHit->det_id;
-                ONGEMX[hit.hycal_idx]     = thisHit->x;
-                ONGEMY[hit.hycal_idx]     = thisHit->y;
-                ONGEMZ[hit.hycal_idx]     = thisHit->z;
-            }
-
-            t->Fill();
+            FillTree(t, event.event_number, hycal_hit, matched);
 
         } else if(dst_parser->EventType() == PRadDSTParser::Type::epics) {
-            auto epics_ev = dst_parser->GetEPICS();
+            auto &epics_ev = dst_parser->GetCurrentEPICS();
 	        // save epics into handler, otherwise get epicsvalue won't work
 	        epics->AddEvent(epics_ev);
             // only update beam energy when there is an epics event
@@ -277,6 +322,133 @@ void physReplay(const string &path)
     delete dst_parser;
 }
 //___________________________________________________________________________________________
+void FillTree(TTree* t, int evNumber, const vector<HyCalHit> &hycal_hit,
+              const vector<MatchHit> &matched)
+{
+    eventNumber = evNumber;
+
+    clusterN = hycal_hit.size() > MAXC ? MAXC : hycal_hit.size();
+
+    totalE = 0.;
+    //save info for HyCal
+    for (int i=0; i<clusterN; i++){
+        clusterE[i]    = hycal_hit[i].E;
+        totalE += clusterE[i];
+        clusterX[i]    = hycal_hit[i].x;
+        clusterY[i]    = hycal_hit[i].y;
+        clusterZ[i]    = hycal_hit[i].z;
+        clusterFlag[i] = hycal_hit[i].flag;
+        clusterNHit[i] = hycal_hit[i].nblocks;
+        clusterCID[i]  = hycal_hit[i].cid;
+        clusterTime[0][i] = hycal_hit[i].time[0];
+        clusterTime[1][i] = hycal_hit[i].time[1];
+        clusterTime[2][i] = hycal_hit[i].time[2];
+        //init array for GEM
+        GEMX[i] = 0;
+        GEMY[i] = 0;
+        GEMZ[i] = 0;
+        ONGEMX[i] = 0;
+        ONGEMY[i] = 0;
+        ONGEMZ[i] = 0;
+        GEMChargeX[i] = 0;
+        GEMChargeY[i] = 0;
+        GEMPeakX[i] = 0;
+        GEMPeakY[i] = 0;
+        GEMSizeX[i] = 0;
+        GEMSizeY[i] = 0;
+        GEMID[i] = -1;
+        // matching flag
+        clusterMatch[i] = 0;
+    }
+
+    for(auto &hit : matched)
+    {
+        GEMX[hit.hycal_idx]       = hit.x;
+        GEMY[hit.hycal_idx]       = hit.y;
+        GEMZ[hit.hycal_idx]       = hit.z;
+        clusterMatch[hit.hycal_idx]= hit.mflag;
+
+        const GEMHit* thisHit = 0;
+        if (TEST_BIT(hit.mflag, kGEM1Match)) thisHit = &hit.gem1.front();
+        else if (TEST_BIT(hit.mflag, kGEM2Match))thisHit = &hit.gem2.front();
+
+        GEMChargeX[hit.hycal_idx] = thisHit->x_charge;
+        GEMChargeY[hit.hycal_idx] = thisHit->y_charge;
+        GEMPeakX[hit.hycal_idx]   = thisHit->x_peak;
+        GEMPeakY[hit.hycal_idx]   = thisHit->y_peak;
+        GEMSizeX[hit.hycal_idx]   = thisHit->x_size;
+        GEMSizeY[hit.hycal_idx]   = thisHit->y_size;
+        GEMID[hit.hycal_idx]      = thisHit->det_id;
+        ONGEMX[hit.hycal_idx]     = thisHit->x;
+        ONGEMY[hit.hycal_idx]     = thisHit->y;
+        ONGEMZ[hit.hycal_idx]     = thisHit->z;
+    }
+
+    t->Fill();
+}
+//___________________________________________________________________________________________
+// decode, reconstruct and fill in one pass, the batch reconstruction runs on
+// its own thread, so the decoding of the next events is not waiting for it
+void streamReplay(const string &input, int split, const string &raw_dst,
+                  const string &recon_dst, bool ntuple, unsigned int threads)
+{
+    PRadDataHandler *handler = new PRadDataHandler();
+    handler->SetEPICSystem(epics);
+    handler->SetHyCalSystem(hycal);
+    handler->SetGEMSystem(gem);
+    handler->InitializeByData(input + ((split < 0) ? "" : ".0"));
+    int runNumber = PRadInfoCenter::GetRunNumber();
+    coord_sys->ChooseCoord(runNumber);
+
+    PRadBatchReconSink recon_sink(hycal, gem, coord_sys, det_match, threads);
+
+    PRadReconDSTOutput recon_out;
+    if(!recon_dst.empty()) {
+        recon_out.Open(recon_dst);
+        recon_sink.AddOutput(&recon_out);
+    }
+
+    TFile *outFile = nullptr;
+    TTree *t = nullptr;
+    NtupleOutput *tuple_out = nullptr;
+    if(ntuple) {
+        outFile = new TFile(Form("physReplay_%d.root", runNumber), "RECREATE");
+        t = new TTree("T", "T");
+        InitTree(t);
+        tuple_out = new NtupleOutput(t, epics->GetChannel("MBSY2C_energy"));
+        recon_sink.AddOutput(tuple_out);
+    }
+
+    // the raw events are only saved if requested
+    PRadDSTSink dst_sink;
+    handler->AddSink(&recon_sink, true);
+    if(!raw_dst.empty()) {
+        dst_sink.Open(raw_dst);
+        handler->AddSink(&dst_sink, true);
+    }
+
+    PRadBenchMark timer;
+    handler->ReadFromSplitEvio(input, split);
+    handler->ClearSinks();
+    dst_sink.Close();
+    recon_out.Close();
+
+    cout << "Reconstructed " << recon_sink.GetCount() << " physics events, took "
+         << timer.GetElapsedTime()/1000. << " s" << endl;
+    if(!recon_dst.empty())
+        cout << "Reconstructed hits saved with configuration hash 0x"
+             << hex << recon_sink.GetConfigHash() << dec << endl;
+
+    if(ntuple) {
+        outFile->cd();
+        t->Write();
+        outFile->Close();
+        delete tuple_out;
+    }
+
+    delete handler;
+}
+//___________________________________________________________________________________________
 void InitTree(TTree* t)
 {
     t->Branch("EventNumber",          &eventNumber,          "EventNumber/I"           );
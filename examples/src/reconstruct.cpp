@@ -95,7 +95,7 @@ void reconstruct(const char *path)
     {
         if(dst_parser.EventType() == PRadDSTParser::Type::event) {
 
-            auto event = dst_parser.GetEvent();
+            auto &event = dst_parser.GetCurrentEvent();
             if(!event.is_physics_event())
                 continue;
 
@@ -13,7 +13,10 @@
 #include "PRadGEMSystem.h"
 #include "PRadInfoCenter.h"
 #include "PRadEvioParser.h"
+#include "PRadReplayDriver.h"
 #include "PRadBenchMark.h"
+#include "PRadMetrics.h"
+#include "PRadThreadTopology.h"
 #include "ConfigOption.h"
 #include <iostream>
 #include <iomanip>
@@ -29,11 +32,23 @@ int main(int argc, char * argv[])
     conf_opt.AddLongOpt(ConfigOption::arg_none, "init-evio", 'e');
     conf_opt.AddLongOpt(ConfigOption::arg_none, "init-database", 'd');
     conf_opt.AddOpt(ConfigOption::arg_require, 'r');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'j');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'c');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'k');
+    conf_opt.AddLongOpt(ConfigOption::arg_none, "resume", 'a');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'm');
+    conf_opt.AddLongOpt(ConfigOption::arg_require, "auto-tune", 't');
     conf_opt.AddOpt(ConfigOption::help_message, 'h');
 
     conf_opt.SetDesc("usage: replay <in_file> <out_file>");
     conf_opt.SetDesc('s', "spliting file number, default -1 (no splitting).");
     conf_opt.SetDesc('r', "set run number, only valid for --init-database, default -1 (determined from file name).");
+    conf_opt.SetDesc('j', "number of split files replayed in parallel, default 1.");
+    conf_opt.SetDesc('c', "number of events per chunk for the compressed DST format, default 0 (not chunked).");
+    conf_opt.SetDesc('k', "number of EPICS events between the keyframes, the others only save the changed channels, default 0 (all keyframes).");
+    conf_opt.SetDesc('a', "resume the outputs from their last checkpoints if they exist.");
+    conf_opt.SetDesc('m', "dump the live metrics to the file every 10 s, in Prometheus text format if it ends with .prom, otherwise in JSON.");
+    conf_opt.SetDesc('t', "use the tuned workers of this host from the file, they are benchmarked and saved if the host is not in it, \"default\" for ~/" TUNE_FILE ".");
     conf_opt.SetDesc('e', "initialize from evio.0 file");
     conf_opt.SetDesc('d', "initialize from database");
     conf_opt.SetDesc('h', "show instruction.");
@@ -45,7 +60,10 @@ int main(int argc, char * argv[])
 
     bool evio_database = true;
 
-    int split = -1, run = -1;
+    int split = -1, run = -1, threads = 1, chunk = 0, keyframe = 0;
+    bool resume = false;
+    string metrics_file, tune_file;
+    bool auto_tune = false;
     for(auto &opt : conf_opt.GetOptions())
     {
         switch(opt.mark)
@@ -62,6 +80,27 @@ int main(int argc, char * argv[])
         case 'r':
             run = opt.var.Int();
             break;
+        case 'j':
+            threads = opt.var.Int();
+            break;
+        case 'c':
+            chunk = opt.var.Int();
+            break;
+        case 'k':
+            keyframe = opt.var.Int();
+            break;
+        case 'a':
+            resume = true;
+            break;
+        case 'm':
+            metrics_file = opt.var.String();
+            break;
+        case 't':
+            auto_tune = true;
+            tune_file = opt.var.String();
+            if(tune_file == "default")
+                tune_file.clear();
+            break;
         default:
             std::cout << conf_opt.GetInstruction() << std::endl;
             return -1;
@@ -71,6 +110,10 @@ int main(int argc, char * argv[])
     string input = conf_opt.GetArgument(0).String();
     string output = conf_opt.GetArgument(1).String();
 
+    // placement of the workers on the numa nodes, it is before any of them
+    // starts
+    PRadThreadTopology::Instance().Configure("config/thread_topology.conf");
+
     PRadDataHandler *handler = new PRadDataHandler();
     PRadEPICSystem *epics = new PRadEPICSystem("config/epics_channels.conf");
     PRadHyCalSystem *hycal = new PRadHyCalSystem("config/hycal.conf");
@@ -82,6 +125,12 @@ int main(int argc, char * argv[])
     handler->SetHyCalSystem(hycal);
     handler->SetGEMSystem(gem);
 
+    if(!metrics_file.empty()) {
+        bool prom = metrics_file.size() > 5 && metrics_file.substr(metrics_file.size() - 5) == ".prom";
+        PRadMetrics::Instance().StartDump(metrics_file, METRICS_DUMP_INTERVAL,
+                                          prom ? PRadMetrics::Prometheus : PRadMetrics::JSON);
+    }
+
     PRadBenchMark timer;
     if(evio_database) {
         handler->InitializeByData(input + ".0");
@@ -91,7 +140,24 @@ int main(int argc, char * argv[])
         else
             hycal->ChooseRun(run);
     }
-    handler->Replay(input, split, output);
+
+    if((threads > 1 || auto_tune) && split > 0) {
+        PRadReplayDriver driver(threads);
+        driver.SetAutoTune(auto_tune, tune_file);
+        driver.SetEPICSystem(epics);
+        driver.SetTaggerSystem(tagger);
+        driver.SetHyCalSystem(hycal);
+        driver.SetGEMSystem(gem);
+        driver.SetChunkedDST(chunk);
+        driver.SetEPICSDeltaDST(keyframe);
+        driver.SetResume(resume);
+        driver.Replay(input, split, output);
+    } else {
+        handler->SetChunkedDST(chunk);
+        handler->SetEPICSDeltaDST(keyframe);
+        handler->Replay(input, split, output, resume);
+    }
+    PRadMetrics::Instance().StopDump();
 
 
     cout << "TIMER: Finished, took " << timer.GetElapsedTime() << " ms" << endl;
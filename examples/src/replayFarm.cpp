@@ -0,0 +1,153 @@
+//============================================================================//
+// An application replaying many runs with worker processes                   //
+// The coordinator reads a run list, each line is "<evio_file> <split>        //
+// <out_dst>", and distributes the split files to the workers, which can be   //
+// local processes or started on the farm nodes by the given commands         //
+// The worker mode (-w) is started by the coordinator, not by the users       //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadReplayFarm.h"
+#include "PRadDataHandler.h"
+#include "PRadEPICSystem.h"
+#include "PRadTaggerSystem.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "ConfigParser.h"
+#include "ConfigOption.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+
+using namespace std;
+
+int serve();
+
+int main(int argc, char *argv[])
+{
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_none, 'w');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'n');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'c');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'u');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'r');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'k');
+    conf_opt.AddOpt(ConfigOption::arg_none, 'p');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: replayFarm [options] <run_list>");
+    conf_opt.SetDesc('w', "worker mode, serve the units from the coordinator on standard input and output.");
+    conf_opt.SetDesc('n', "number of local workers, default is the number of hardware threads if no -c is given.");
+    conf_opt.SetDesc('c', "command to start a worker, such as \"ssh node01 'cd /work && replayFarm -w'\", it can be given multiple times.");
+    conf_opt.SetDesc('u', "size of a work unit in MB, default 4096.");
+    conf_opt.SetDesc('r', "number of retries for a failed unit, default 2.");
+    conf_opt.SetDesc('k', "checkpoint file, default is <run_list>.ckpt.");
+    conf_opt.SetDesc('p', "keep the split outputs and unit histograms after merging.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv)) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    PRadReplayFarm farm;
+    bool worker_mode = false, keep_parts = false, remote = false;
+    int nlocal = -1;
+    string ckpt;
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 'w':
+            worker_mode = true;
+            break;
+        case 'n':
+            nlocal = opt.var.Int();
+            break;
+        case 'c':
+            farm.AddWorker(opt.var.String());
+            remote = true;
+            break;
+        case 'u':
+            farm.SetUnitBytes(opt.var.ULong()*1000000ULL);
+            break;
+        case 'r':
+            farm.SetRetries(opt.var.Int());
+            break;
+        case 'k':
+            ckpt = opt.var.String();
+            break;
+        case 'p':
+            keep_parts = true;
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    if(worker_mode)
+        return (serve() >= 0) ? 0 : -1;
+
+    if(conf_opt.NbofArgs() != 1) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    string run_list = conf_opt.GetArgument(0).String();
+    ConfigParser c_parser;
+    if(!c_parser.OpenFile(run_list)) {
+        cerr << "Cannot open run list " << run_list << endl;
+        return -1;
+    }
+
+    string input, output;
+    int split;
+    while(c_parser.ParseLine())
+    {
+        if(c_parser.NbofElements() != 3) {
+            cerr << "Unknown run list line, expected <evio_file> <split> <out_dst>" << endl;
+            continue;
+        }
+        c_parser >> input >> split >> output;
+        farm.AddRun(input, split, output);
+    }
+
+    // local workers are this program in the worker mode
+    if(nlocal < 0)
+        nlocal = remote ? 0 : thread::hardware_concurrency();
+    for(int i = 0; i < nlocal; ++i)
+        farm.AddWorker(string(argv[0]) + " -w");
+
+    farm.SetCheckpoint(ckpt.empty() ? run_list + ".ckpt" : ckpt);
+    farm.SetKeepParts(keep_parts);
+
+    return farm.Process() ? 0 : -1;
+}
+
+// the systems are the same as the replay
+int serve()
+{
+    PRadDataHandler *handler = new PRadDataHandler();
+    PRadEPICSystem *epics = new PRadEPICSystem("config/epics_channels.conf");
+    PRadHyCalSystem *hycal = new PRadHyCalSystem("config/hycal.conf");
+    PRadGEMSystem *gem = new PRadGEMSystem("config/gem.conf");
+    PRadTaggerSystem *tagger = new PRadTaggerSystem;
+
+    handler->SetEPICSystem(epics);
+    handler->SetTaggerSystem(tagger);
+    handler->SetHyCalSystem(hycal);
+    handler->SetGEMSystem(gem);
+
+    int count = PRadReplayFarm::Serve(handler);
+
+    delete handler;
+    delete epics;
+    delete hycal;
+    delete gem;
+    delete tagger;
+    return count;
+}
@@ -0,0 +1,59 @@
+//============================================================================//
+// An example showing how to select runs by the summaries of the DST files   //
+// Only the summary after the event map is read from every file              //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDSTParser.h"
+#include "PRadRunSummary.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+using namespace std;
+
+void showSummary(const string &file);
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        cout << "usage: " << argv[0] << " <file1> [file2] ..." << endl;
+        return -1;
+    }
+
+    cout << setw(8) << "run"
+         << setw(12) << "events"
+         << setw(12) << "LG_SUM"
+         << setw(12) << "TOTAL_SUM"
+         << setw(14) << "charge"
+         << setw(10) << "live"
+         << "  file"
+         << endl;
+
+    for(int i = 1; i < argc; ++i)
+        showSummary(argv[i]);
+
+    return 0;
+}
+
+void showSummary(const string &file)
+{
+    PRadRunSummary sum;
+    if(!PRadDSTParser::ReadSummary(file, sum)) {
+        cout << "No run summary in \"" << file << "\"." << endl;
+        return;
+    }
+
+    cout << setw(8) << sum.GetRunNumber()
+         << setw(12) << sum.GetEventCount()
+         << setw(12) << sum.GetTriggerCount(PHYS_LeadGlassSum)
+         << setw(12) << sum.GetTriggerCount(PHYS_TotalSum)
+         << setw(14) << sum.GetBeamCharge()
+         << setw(10) << sum.GetLiveTime()
+         << "  " << file
+         << (sum.IsComplete() ? "" : " (incomplete)")
+         << endl;
+}
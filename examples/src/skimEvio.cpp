@@ -0,0 +1,89 @@
+//============================================================================//
+// An example to skim the raw evio files into a smaller evio file             //
+// The selected events are copied without decoding, so the output keeps the   //
+// raw GEM samples and can be replayed the same as the original files         //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEvioSkimmer.h"
+#include "PRadBenchMark.h"
+#include "ConfigOption.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    ConfigOption conf_opt;
+    conf_opt.AddOpt(ConfigOption::arg_require, 't');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'r');
+    conf_opt.AddOpt(ConfigOption::arg_require, 'n');
+    conf_opt.AddOpt(ConfigOption::arg_none, 'c');
+    conf_opt.AddOpt(ConfigOption::help_message, 'h');
+
+    conf_opt.SetDesc("usage: skimEvio [options] <out_evio> <in_evio> [<in_evio> ...]");
+    conf_opt.SetDesc('t', "accept the trigger type (1: LeadGlassSum, 2: TotalSum, 3: LMS_Led, "
+                          "4: LMS_Alpha, 5: TaggerE, 6: Scintillator), it can be given multiple times.");
+    conf_opt.SetDesc('r', "accept the event range <first>:<last>, it can be given multiple times.");
+    conf_opt.SetDesc('n', "maximum number of physics events.");
+    conf_opt.SetDesc('c', "drop the control and EPICS events.");
+    conf_opt.SetDesc('h', "show instruction.");
+
+    if(!conf_opt.ParseArgs(argc, argv) || conf_opt.NbofArgs() < 2) {
+        cout << conf_opt.GetInstruction() << endl;
+        return -1;
+    }
+
+    PRadEvioSkimmer skimmer;
+    for(auto &opt : conf_opt.GetOptions())
+    {
+        switch(opt.mark)
+        {
+        case 't':
+            skimmer.AcceptTrigger(static_cast<PRadTriggerType>(opt.var.Int()));
+            break;
+        case 'r':
+        {
+            string range = opt.var.String();
+            size_t sep = range.find(':');
+            if(sep == string::npos) {
+                cerr << "Unknown event range " << range << ", expected <first>:<last>" << endl;
+                return -1;
+            }
+            skimmer.AddEventRange(stoul(range.substr(0, sep)), stoul(range.substr(sep + 1)));
+        }
+            break;
+        case 'n':
+            skimmer.SetMaxEvents(opt.var.Int());
+            break;
+        case 'c':
+            skimmer.SetKeepControl(false);
+            break;
+        default:
+            cout << conf_opt.GetInstruction() << endl;
+            return -1;
+        }
+    }
+
+    vector<string> inputs;
+    for(size_t i = 1; i < conf_opt.NbofArgs(); ++i)
+        inputs.push_back(conf_opt.GetArgument(i).String());
+
+    PRadBenchMark timer;
+    int count = skimmer.Skim(inputs, conf_opt.GetArgument(0).String());
+    if(count < 0)
+        return -1;
+
+    double sec = timer.GetElapsedTime()/1000.;
+    cout << "Skimmed " << count << " physics events, "
+         << skimmer.GetInputBytes()/1e6 << " MB -> "
+         << skimmer.GetOutputBytes()/1e6 << " MB, took " << sec << " s ("
+         << ((sec > 0.) ? skimmer.GetInputBytes()/1e6/sec : 0.) << " MB/s)"
+         << endl;
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+//============================================================================//
+// An example of processing a run in one streaming pass with pipeline stages  //
+// The events are decoded, reconstructed and matched on one thread, and then  //
+// written to a DST file on another thread, the events are not kept in memory //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDataHandler.h"
+#include "PRadEventSink.h"
+#include "PRadInfoCenter.h"
+#include "PRadBenchMark.h"
+#include "PRadEPICSystem.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadCoordSystem.h"
+#include "PRadDetMatch.h"
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3) {
+        cout << "usage: streamRecon <evio_file> <out_dst> [split] [recon_dst]" << endl;
+        return -1;
+    }
+
+    string input = argv[1];
+    string output = argv[2];
+    int split = (argc > 3) ? stoi(argv[3]) : -1;
+    string recon_output = (argc > 4) ? argv[4] : "";
+
+    PRadDataHandler *handler = new PRadDataHandler();
+    PRadEPICSystem *epics = new PRadEPICSystem("config/epics_channels.conf");
+    PRadHyCalSystem *hycal = new PRadHyCalSystem("config/hycal.conf");
+    PRadGEMSystem *gem = new PRadGEMSystem("config/gem.conf");
+    PRadCoordSystem *coord_sys = new PRadCoordSystem("database/coordinates.dat");
+    PRadDetMatch *det_match = new PRadDetMatch("config/det_match.conf");
+
+    handler->SetEPICSystem(epics);
+    handler->SetHyCalSystem(hycal);
+    handler->SetGEMSystem(gem);
+    handler->InitializeByData(input + ((split < 0) ? "" : ".0"));
+    coord_sys->ChooseCoord(PRadInfoCenter::GetRunNumber());
+
+    // stages on the end process thread
+    PRadHistSink hist_sink(handler);
+    PRadReconSink recon_sink(hycal, gem, coord_sys);
+    PRadMatchSink match_sink(hycal, gem, coord_sys, det_match);
+    int nmatched = 0;
+    PRadCallbackSink count_sink([&] (EventData &)
+                                {
+                                    nmatched += match_sink.GetMatched().size();
+                                    return true;
+                                });
+    // reconstructed hits, so the later jobs can skip the clustering
+    PRadReconDSTSink recon_dst_sink(&recon_sink, &match_sink, recon_output);
+    // DST writing on its own thread
+    PRadDSTSink dst_sink(output);
+
+    handler->AddSink(&hist_sink);
+    handler->AddSink(&recon_sink);
+    handler->AddSink(&match_sink);
+    handler->AddSink(&count_sink);
+    if(!recon_output.empty())
+        handler->AddSink(&recon_dst_sink);
+    handler->AddSink(&dst_sink, true);
+
+    PRadBenchMark timer;
+    int count = handler->ReadFromSplitEvio(input, split);
+    handler->ClearSinks();
+    dst_sink.Close();
+    recon_dst_sink.Close();
+
+    cout << "TIMER: Finished, took " << timer.GetElapsedTime() << " ms" << endl;
+    cout << "Processed " << count << " events, matched "
+         << nmatched << " HyCal clusters with GEM." << endl;
+    if(!recon_output.empty())
+        cout << "Reconstructed hits saved with configuration hash 0x"
+             << hex << recon_dst_sink.GetConfigHash() << dec << endl;
+
+    delete handler;
+    delete epics;
+    delete hycal;
+    delete gem;
+    delete coord_sys;
+    delete det_match;
+    return 0;
+}
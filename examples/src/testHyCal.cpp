@@ -16,6 +16,8 @@
 #include <string>
 #include <vector>
 
+#define BATCH_SIZE 10000
+
 using namespace std;
 
 int main(int /*argc*/, char * /*argv*/ [])
@@ -79,41 +81,64 @@ int main(int /*argc*/, char * /*argv*/ [])
 
     PRadBenchMark timer;
 
+    // the events are reconstructed in batches by several threads
+    vector<EventData> events;
+    vector<vector<HyCalHit>> batch_hits(BATCH_SIZE);
+    ReconStats stats;
+    events.reserve(BATCH_SIZE);
+
+    auto fill_batch = [&] ()
+                      {
+                          sys->ReconstructBatch(events.data(), events.size(), batch_hits.data(),
+                                                0, &stats);
+                          for(size_t k = 0; k < events.size(); ++k)
+                          {
+                              const auto &hits = batch_hits[k];
+                              N = hits.size();
+                              bool save = false;
+                              for(size_t i = 0; i < hits.size(); ++i)
+                              {
+                                  const auto &hit = hits.at(i);
+                                  x[i] = hit.x;
+                                  y[i] = hit.y;
+                                  E[i] = hit.E;
+                                  corr[i] = hit.lin_corr;
+                                  leak[i] = hit.E_leak;
+                                  if(hit.E_leak > 100)
+                                      save = true;
+                              }
+                              t->Fill();
+
+                              if(save)
+                                  dst_parser->Write(events[k]);
+                          }
+                          events.clear();
+                      };
+
     while(dst_parser->Read())
     {
         if(dst_parser->EventType() == PRadDSTParser::Type::event) {
 
-            auto event = dst_parser->GetEvent();
+            auto &event = dst_parser->GetCurrentEvent();
             if(!event.is_physics_event())
                 continue;
 
-            sys->Reconstruct(event);
-            auto hits = sys->GetDetector()->GetHits();
-            N = hits.size();
-            bool save = false;
-            for(size_t i = 0; i < hits.size(); ++i)
-            {
-                const auto &hit = hits.at(i);
-                x[i] = hit.x;
-                y[i] = hit.y;
-                E[i] = hit.E;
-                corr[i] = hit.lin_corr;
-                leak[i] = hit.E_leak;
-                if(hit.E_leak > 100)
-                    save = true;
-            }
-            t->Fill();
-
-            if(save)
-                dst_parser->Write(event);
+            events.push_back(event);
+            if(events.size() >= BATCH_SIZE)
+                fill_batch();
         }
     }
+    fill_batch();
 
     t->Write();
     f->Close();
     dst_parser->CloseInput();
     dst_parser->CloseOutput();
     cout << "TIMER: Finished, took " << timer.GetElapsedTime() << " ms" << endl;
+    cout << "Split " << stats.split_groups << " groups in "
+         << stats.split_iters << " iterations, corrected leakage of "
+         << stats.leak_clusters << " clusters in "
+         << stats.leak_iters << " iterations." << endl;
 
     return 0;
 }
@@ -6,6 +6,7 @@
 //============================================================================//
 
 #include "CNeuralNetwork.h"
+#include "CNeuralInference.h"
 #include <iostream>
 
 #define NEW_NET
@@ -70,5 +71,18 @@ int main(int /*argc*/, char * /*argv*/ [])
          << endl;
     // save the result
     my_net.SaveNet("saved.net");
+
+    // accuracy of the compiled networks for inference
+    std::vector<float> samples(input.begin(), input.end());
+    samples.insert(samples.end(), input2.begin(), input2.end());
+    const char *names[] = {"double", "float", "int8"};
+    for(int i = 0; i < 3; ++i)
+    {
+        CNeuralInference inf(my_net, (CNeuralInference::Precision)i);
+        auto acc = inf.Compare(my_net, samples.data(), 2);
+        cout << names[i] << " inference: " << inf.GetWeightBytes() << " bytes, "
+             << "max delta " << acc.max_delta << ", mean delta " << acc.mean_delta
+             << endl;
+    }
     return 0;
 }
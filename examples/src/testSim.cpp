@@ -45,8 +45,9 @@ int main(int /*argc*/, char * /*argv*/ [])
     t->Branch("ClusterY", &y[0], "ClusterY[NClusters]/D");
 
 
-    for(auto &event : handler->GetEventData())
+    for(unsigned int i = 0; i < handler->GetEventCount(); ++i)
     {
+        auto &event = handler->GetEvent(i);
         hycal->Reconstruct(event);
         auto &hits = hycal->GetDetector()->GetHits();
         N = (int)hits.size();
@@ -13,19 +13,77 @@
 #include <iomanip>
 #include <string>
 #include <vector>
-#include "DSTReaderV1.h"
+#include <unordered_map>
 
 #define PROGRESS_COUNT 10000
 
 using namespace std;
 
 void UpdateDST(const string &inf, const string &outf);
+void UpdateEPICS(const string &dst, const string &epics);
+// only the EPICS records are appended to the file, use compactDST to remove
+// the replaced records if necessary
+void UpdateEPICS(const string &dst, const string &epics)
+{
+    unordered_map<int, vector<float>> values;
+    ConfigParser c_parser;
+    if(!c_parser.ReadFile(epics)) {
+        cout << "Cannot read epics file " << epics << endl;
+        return;
+    }
+    while(c_parser.ParseLine())
+    {
+        int event_number = c_parser.TakeFirst().Int();
+        auto &vals = values[event_number];
+        vals.clear();
+        while(c_parser.NbofElements() > 0)
+            vals.push_back(c_parser.TakeFirst().Float());
+    }
+
+    PRadDSTParser dst_parser;
+    if(!dst_parser.OpenUpdate(dst))
+        return;
+
+    PRadBenchMark timer;
+    auto positions = dst_parser.GetInputMap().GetType(PRadDSTParser::Type::epics);
+    for(auto &pos : positions)
+    {
+        if(!dst_parser.Read(pos) || dst_parser.EventType() != PRadDSTParser::Type::epics)
+            continue;
+
+        EpicsData ep = dst_parser.GetEPICS();
+        auto it = values.find(ep.event_number);
+        if(it == values.end())
+            continue;
+
+        ep.values = it->second;
+        dst_parser.Replace(pos, ep);
+    }
+
+    size_t n = dst_parser.GetReplacedCount();
+    if(!dst_parser.CommitUpdate())
+        cout << "Failed to update " << dst << endl;
+    else
+        cout << "Replaced " << n << " EPICS events in " << dst
+             << " in " << timer.GetElapsedTimeStr() << endl;
+    dst_parser.CloseUpdate();
+}
+
 void ListEvents(const string &inf);
 
 int main(int argc, char *argv[])
 {
+    if(argc == 4 && string(argv[1]) == "-e") {
+        UpdateEPICS(argv[2], argv[3]);
+        return 0;
+    }
+
     if(argc != 3) {
-        cout << "usage: updateDST <in_file> <out_file>" << endl;
+        cout << "usage: updateDST <in_file> <out_file>\n"
+             << "       updateDST -e <dst_file> <epics_file>\n"
+             << "the second form replaces the values of the EPICS events in place, "
+             << "the lines of the epics file are <event_number> <value1> <value2> ..."
+             << endl;
         return -1;
     }
 
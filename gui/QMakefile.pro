@@ -32,6 +32,9 @@ DEFINES += MULTI_THREAD
 # enable the reconstruction display in GUI
 #GUI_OPTION += RECON_DISPLAY
 
+# enable the OpenGL heat map of HyCal, it requires Qt 5.4 or newer
+#GUI_OPTION += GL_HEATMAP
+
 ######################################################################
 # optional components end
 ######################################################################
@@ -96,9 +99,11 @@ contains(GUI_OPTION, ONLINE_MODE) {
     DEFINES += USE_ONLINE_MODE
     HEADERS += include/online_monitor/PRadETChannel.h \
                include/online_monitor/PRadETStation.h \
+               include/online_monitor/PRadOnlineWorker.h \
                include/online_monitor/ETSettingPanel.h
     SOURCES += src/online_monitor/PRadETChannel.cpp \
                src/online_monitor/PRadETStation.cpp \
+               src/online_monitor/PRadOnlineWorker.cpp \
                src/online_monitor/ETSettingPanel.cpp
     INCLUDEPATH += $$(ET_INC)
     LIBS += -L$$(ET_LIB) -let -lexpat
@@ -134,14 +139,25 @@ contains(GUI_OPTION, STANDARD_EVIO) {
 contains(GUI_OPTION, RECON_DISPLAY) {
     DEFINES += RECON_DISPLAY
     HEADERS += include/ReconSettingPanel.h \
+               include/ReconWorker.h \
                include/MarkSettingWidget.h
     SOURCES += src/ReconSettingPanel.cpp \
+               src/ReconWorker.cpp \
                src/MarkSettingWidget.cpp
     message("Reconstruct Events Display = Enabled")
 } else {
     message("Reconstruct Events Display = Disabled")
 }
 
+contains(GUI_OPTION, GL_HEATMAP) {
+    DEFINES += USE_GL_HEATMAP
+    HEADERS += include/HyCalHeatMap.h
+    SOURCES += src/HyCalHeatMap.cpp
+    message("OpenGL Heat Map = Enabled")
+} else {
+    message("OpenGL Heat Map = Disabled")
+}
+
 ######################################################################
 # self-defined components end
 ######################################################################
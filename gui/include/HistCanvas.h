@@ -23,6 +23,7 @@ public:
     void UpdateHist(int index, TH1 *hist, bool auto_range = true);
     void UpdateHist(int index, TH1 *hist, int range_min, int range_max);
     void UpdateHist(int index, TH2 *hist);
+    bool IsInteracting(qint64 idle_time) const;
 
 
 protected:
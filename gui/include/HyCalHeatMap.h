@@ -0,0 +1,53 @@
+#ifndef QT_HYCAL_HEAT_MAP_H
+#define QT_HYCAL_HEAT_MAP_H
+
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <vector>
+
+// size of the texture that stores the module indices (texels)
+#define HEATMAP_INDEX_SIZE 1024
+// number of modules in one row of the color texture
+#define HEATMAP_COLOR_WIDTH 64
+
+class HyCalScene;
+class HyCalModule;
+class QOpenGLShaderProgram;
+
+// HyCal map drawn as a single textured quad
+// the module geometry is baked into an index texture once, and the module
+// colors are uploaded as one small texture when they are changed
+class HyCalHeatMap : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+
+public:
+    HyCalHeatMap(QWidget *parent = 0);
+    virtual ~HyCalHeatMap();
+
+    void SetDetector(HyCalScene *det);
+    void UpdateModules();
+    HyCalModule *GetModule(const QPoint &pos) const;
+
+protected:
+    void initializeGL();
+    void paintGL();
+    void mousePressEvent(QMouseEvent *event);
+
+private:
+    void bakeGeometry();
+    QRect mapArea() const;
+
+private:
+    HyCalScene *scene;
+    std::vector<HyCalModule*> modules;
+    // index of the module + 1 for each texel, 0 means no module
+    std::vector<unsigned short> index_map;
+    std::vector<unsigned char> colors;
+    double x_min, y_min, step;
+    bool index_changed, color_changed;
+    QOpenGLShaderProgram *program;
+    GLuint index_tex, color_tex;
+};
+
+#endif
@@ -19,8 +19,9 @@ public:
     virtual ~HyCalModule();
 
     void Initialize();
-    void SetColor(const QColor &c) {color = c;}
+    void SetColor(const QColor &c);
     void SetColor(const double &val);
+    const QColor &GetColor() const {return color;}
     void ShowPedestal();
     void ShowPedSigma();
     void ShowOccupancy();
@@ -2,6 +2,7 @@
 #define QT_HYCAL_SCENE_H
 
 #include <QGraphicsScene>
+#include <QPixmap>
 #include <vector>
 #include "PRadHyCalDetector.h"
 
@@ -89,7 +90,9 @@ public:
     void ClearHitsMarks();
     void UpdateScalerBox(const QString &text, const int &group = 0);
     void UpdateScalerBox(const QStringList &texts);
-    void ShowScalers(const bool &s = true) {showScalers = s;}
+    void ShowScalers(const bool &s = true);
+    void UpdateModules();
+    void SelectModule(HyCalModule *module);
     void ShowEvent();
     void ShowEvent(const EventData &event);
     void ShowCluster(const ModuleCluster &cluster);
@@ -109,9 +112,12 @@ protected:
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event);
 
 private:
-    void drawScalerBoxes(QPainter *painter);
+    void drawScalerBoxes(QPainter *painter, const QRectF &rect);
     void drawTDCBoxes(QPainter *painter);
-    void drawHitsMarks(QPainter *painter);
+    void drawHitsMarks(QPainter *painter, const QRectF &rect);
+    void paintTDCBoxes(QPainter *painter);
+    QRectF scalerArea(const TextBox &box) const;
+    QRectF markArea(const HitsMark &mark) const;
     void drawHitsMark(QPainter *painter, const QPointF &pos, const MarkAttributes &attr);
 
 private:
@@ -121,6 +127,9 @@ private:
     QList<TextBox> tdcBoxList;
     QVector<TextBox> scalarBoxList;
     QVector<HitsMark> hitsMarkList;
+    // the static tdc boxes are cached in device coordinates
+    QPixmap tdcLayer;
+    QTransform tdcTransform;
 };
 
 #endif
@@ -23,13 +23,16 @@ class PRadHyCalSystem;
 class PRadGEMSystem;
 class PRadCoordSystem;
 class PRadDetMatch;
+struct EventData;
 
 #ifdef RECON_DISPLAY
+#include "ReconWorker.h"
 class ReconSettingPanel;
 #endif
 
 #ifdef USE_ONLINE_MODE
 class PRadETChannel;
+class PRadOnlineWorker;
 class ETSettingPanel;
 #endif
 
@@ -37,6 +40,10 @@ class ETSettingPanel;
 class PRadHVSystem;
 #endif
 
+#ifdef USE_GL_HEATMAP
+class HyCalHeatMap;
+#endif
+
 QT_BEGIN_NAMESPACE
 class QPushButton;
 class QComboBox;
@@ -49,6 +56,7 @@ class QTreeWidget;
 class QTreeWidgetItem;
 class QTimer;
 class QAction;
+class QStackedWidget;
 QT_END_NAMESPACE
 
 enum HistType {
@@ -106,11 +114,16 @@ public slots:
 private slots:
     void handleEventChange(int event);
     void openDataFile();
+    void openDSTIndex();
+    void updateLoadProgress();
+    void finishLoading();
+    void cancelLoading();
     void initializeFromFile();
     void openCalibrationFile();
     void openGainFactorFile();
     void openCustomMap();
     void handleRootEvents();
+    void drawHistCanvas();
     void saveHistToFile();
     void findPeak();
     void fitPedestal();
@@ -124,10 +137,12 @@ private slots:
     void changeCurrentEvent(int evt);
     void eraseBufferAction();
     void findEvent();
+    void showMemoryUsage();
     void editCustomValueLabel(QTreeWidgetItem* item, int column);
 
 private:
     void initView();
+    void registerMemory();
     void setupUI();
     void generateSpectrum();
     void generateHyCalModules();
@@ -141,9 +156,10 @@ private:
     void setupInfoWindow();
     void updateEventRange();
     void chooseEvent(int index);
+    void showEvent(const EventData &event);
     void readEventFromFile(const QString &filepath);
+    void loadDataFiles(const QStringList &files);
     void readCustomValue(const QString &filepath);
-    void onlineUpdate(const size_t &max_events);
     bool onlineSettings();
     QMenu *setupFileMenu();
     QMenu *setupCalibMenu();
@@ -178,6 +194,7 @@ private:
     HyCalScene *HyCal;
     HyCalView *view;
     HistCanvas *histCanvas;
+    QTimer *histTimer;
 
     QString fileName;
 
@@ -200,6 +217,7 @@ private:
     QLabel *rStatusLabel;
 
     QAction *openDataAction;
+    QAction *openIndexAction;
 
     QFileDialog *fileDialog;
     SpectrumSettingPanel *specSetting;
@@ -208,6 +226,12 @@ private:
     QFuture<bool> future;
     QFutureWatcher<void> watcher;
 
+    // data files are read in background
+    QFutureWatcher<void> loadWatcher;
+    QTimer *loadTimer;
+    QPushButton *cancelLoadButton;
+    QStringList loadingFiles;
+
 #ifdef USE_ONLINE_MODE
 public:
     void UpdateOnlineInfo();
@@ -222,6 +246,7 @@ private:
     QMenu *setupOnlineMenu();
 
     PRadETChannel *etChannel;
+    PRadOnlineWorker *onlineWorker;
     QTimer *onlineTimer;
     ETSettingPanel *etSetting;
     QAction *onlineEnAction;
@@ -249,6 +274,16 @@ private:
     QAction *hvRestoreAction;
 #endif
 
+#ifdef USE_GL_HEATMAP
+private slots:
+    void switchHeatMap(bool on);
+private:
+    void setupHeatMap();
+
+    HyCalHeatMap *heatMap;
+    QStackedWidget *hycalStack;
+#endif
+
 #ifdef RECON_DISPLAY
 private slots:
     void setupReconMethods();
@@ -260,6 +295,8 @@ private:
     PRadCoordSystem *coordSystem;
     PRadDetMatch *detMatch;
     ReconSettingPanel *reconSetting;
+    ReconWorker *reconWorker;
+    ReconResult reconResult;
     QSpinBox *clusterSpin;
 #endif
 };
@@ -2,6 +2,7 @@
 #define Q_ROOT_CANVAS_H
 
 #include <QWidget>
+#include <QElapsedTimer>
 #include "TCanvas.h"
 
 class TObject;
@@ -20,6 +21,8 @@ public:
     virtual ~QRootCanvas();
     void Refresh() {fCanvas->Modified(); fCanvas->Update();}
     TCanvas *GetCanvas() {return fCanvas;}
+    // time since the last interaction with the canvas (ms)
+    qint64 GetIdleTime() const {return fInputTimer.elapsed();}
 
     // wrapper class
     void SetFillColor(Color_t c);
@@ -112,6 +115,7 @@ protected:
 
 private:
     bool fNeedResize;
+    QElapsedTimer fInputTimer;
 };
 
 #endif
@@ -0,0 +1,82 @@
+#ifndef RECON_WORKER_H
+#define RECON_WORKER_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include "PRadEventStruct.h"
+#include "PRadHyCalReconstructor.h"
+
+// number of reconstructed events kept for the display
+#define RECON_DISPLAY_EVENTS 64
+// number of events reconstructed after the requested one
+#define RECON_DISPLAY_AHEAD 16
+
+class PRadDataHandler;
+class PRadHyCalSystem;
+class PRadGEMSystem;
+class PRadCoordSystem;
+class PRadDetMatch;
+
+// reconstructed hits of an event, they are transformed and projected to
+// HyCal surface and ready to be shown
+struct ReconResult
+{
+    EventData event;
+    std::vector<HyCalHit> hycal;
+    std::vector<GEMHit> gem1, gem2;
+    std::vector<MatchHit> matched;
+    std::vector<ModuleCluster> clusters;
+};
+
+// background reconstruction for the event display
+// the requested event and the following ones are reconstructed by a thread
+// with its own copy of the GEM system and a calibration snapshot of HyCal,
+// the latest results are kept so the hits can be shown without waiting
+class ReconWorker
+{
+public:
+    ReconWorker(PRadDataHandler *h, PRadHyCalSystem *hycal, PRadGEMSystem *gem,
+                PRadCoordSystem *coord, PRadDetMatch *match);
+    ~ReconWorker();
+
+    void Start();
+    void Stop();
+    void Reset();
+    void Request(int index);
+    bool Find(const EventData &event, ReconResult &res) const;
+    bool GetLatest(ReconResult &res) const;
+    void Reconstruct(const EventData &event, ReconResult &res);
+
+    // block the worker so the settings can be changed
+    std::unique_lock<std::mutex> Pause() {return std::unique_lock<std::mutex>(recon_locker);}
+
+private:
+    void run();
+    void transformHits(ReconResult &res) const;
+
+private:
+    PRadDataHandler *handler;
+    PRadHyCalSystem *hycal_sys;
+    PRadGEMSystem *gem_sys;
+    PRadCoordSystem *coord_sys;
+    PRadDetMatch *det_match;
+
+    // the copy used by the thread
+    std::unique_ptr<PRadGEMSystem> gem_copy;
+    PRadHyCalReconstructor::Context context;
+
+    std::thread thread;
+    bool alive;
+    int request, latest;
+    unsigned int generation;
+    std::deque<ReconResult> results;
+    mutable std::mutex locker;
+    std::mutex recon_locker;
+    std::condition_variable cv;
+};
+
+#endif
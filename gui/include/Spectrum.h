@@ -3,6 +3,10 @@
 
 #include <QGraphicsObject>
 #include <QGradient>
+#include <QVector>
+
+// number of colors in the lookup table of the spectrum
+#define SPECTRUM_LUT_SIZE 1024
 
 class Spectrum : public QGraphicsObject
 {
@@ -44,6 +48,13 @@ public:
     double GetRangeMin() {return settings.range_min;}
     double GetRangeMax() {return settings.range_max;}
     QColor GetColor(const double &val);
+    // map the values to the indices of the colors in one pass, the index is
+    // -1 for the values below the range, which are shown in white
+    void MapIndices(const double *vals, int *indices, int n) const;
+    QColor GetIndexColor(int index) const
+    {
+        return (index < 0) ? QColor(Qt::white) : lut[index];
+    }
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
     void paintTicks(QPainter *painter);
     QRectF boundingRect() const;
@@ -53,7 +64,9 @@ signals:
 
 private:
     void updateGradient();
+    void updateScaling();
     double scaling(const double &val);
+    int scaleToIndex(double scale) const;
     QColor scaleToColor(const double &scale);
 
 private:
@@ -64,6 +77,11 @@ private:
     double wavelength2;
     QLinearGradient gradient;
     QPainterPath shape;
+    // colors are only calculated when the type is changed, and the values
+    // are mapped to scale = (value - map_min)*map_factor, in log10 for log
+    // scale, the mapping is updated when the range or scale is changed
+    QVector<QColor> lut;
+    double map_min, map_factor;
 };
 
 #endif
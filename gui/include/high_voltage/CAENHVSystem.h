@@ -148,6 +148,7 @@ public:
     void CheckStatus();
     void SetPower(const bool &on_off);
     const int &GetHandle() {return handle;}
+    const unsigned char &GetID() {return id;}
     const std::string &GetName() {return name;}
     const std::string &GetIP() {return ip;}
     std::vector<CAEN_Board*> &GetBoardList() {return boardList;}
@@ -6,9 +6,18 @@
 #include <string>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <memory>
 #include <unordered_map>
 #include "datastruct.h"
 
+// the crates are polled every tick (s)
+#define HV_QUERY_TICK 1
+// voltages are read every this many ticks
+#define HV_READ_PERIOD 5
+// channel status are checked every this many ticks
+#define HV_STATUS_PERIOD 30
+
 class PRadEventViewer;
 class PRadHVSystem
 {
@@ -22,6 +31,16 @@ public:
        Voltage(float vm, float vs, bool o = false) : Vmon(vm), Vset(vs), ON(o) {}
     };
 
+    // voltages of a crate from the last sweep, indexed by slot and channel
+    struct Snapshot
+    {
+        std::unordered_map<int, std::vector<Voltage>> slots;
+        double sweep_time;      // time spent on the last sweep (ms)
+        double max_sweep_time;  // longest sweep since the monitor started (ms)
+        unsigned int sweeps;
+        Snapshot() : sweep_time(0.), max_sweep_time(0.), sweeps(0) {}
+    };
+
 
 public:
     PRadHVSystem(PRadEventViewer *p);
@@ -55,16 +74,35 @@ public:
     Voltage GetVoltage(const std::string &name, int slot, int channel) const;
     Voltage GetVoltage(int id, int slot, int channel) const;
     Voltage GetVoltage(const ChannelAddress &addr) const;
+    std::shared_ptr<const Snapshot> GetSnapshot(int id) const;
+
+private:
+    // every crate is polled by its own thread, the sweep results are published
+    // as snapshots so readers never wait for a crate
+    struct CrateMonitor
+    {
+        CAEN_Crate *crate;
+        std::thread thread;
+        std::mutex locker;
+        std::shared_ptr<const Snapshot> snapshot;
+        CrateMonitor(CAEN_Crate *c) : crate(c), snapshot(std::make_shared<Snapshot>()) {}
+    };
+
+    void queryLoop(CrateMonitor *mon);
+    void sweepCrate(CrateMonitor *mon, bool check_status);
+    CrateMonitor *getMonitor(int id) const;
 
 private:
     PRadEventViewer *console;
     std::vector<CAEN_Crate*> crateList;
+    std::vector<CrateMonitor*> monitorList;
     volatile bool alive;
-    std::thread queryThread;
     std::mutex locker;
+    std::mutex stop_locker;
+    std::condition_variable stop_cv;
     std::unordered_map<int, CAEN_Crate*> crate_id_map;
     std::unordered_map<std::string, CAEN_Crate*> crate_name_map;
-    void queryLoop();
+    std::unordered_map<int, CrateMonitor*> monitor_id_map;
 };
 
 #endif
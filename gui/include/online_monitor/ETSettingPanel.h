@@ -2,9 +2,12 @@
 #define ET_SETTING_PANEL_H
 
 #include <QDialog>
+#include <QVector>
+#include <cstdint>
 
 class QLineEdit;
 class QSpinBox;
+class QCheckBox;
 
 class ETSettingPanel : public QDialog {
     Q_OBJECT
@@ -15,12 +18,19 @@ public:
     QString GetETFilePath();
     QString GetStationName();
     int GetETPort();
+    double GetSampleFraction();
+    // triggers selected by the ET system, 0 means all the events
+    uint32_t GetTriggerMask();
+    int GetPrescale();
 
 private:
     QLineEdit *ipEdit;
     QSpinBox *portEdit;
     QLineEdit *fileEdit;
     QLineEdit *stationEdit;
+    QSpinBox *sampleEdit;
+    QSpinBox *prescaleEdit;
+    QVector<QCheckBox*> triggerBoxes;
 
 };
 
@@ -3,6 +3,7 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include "et.h"
 #include "PRadException.h"
@@ -58,6 +59,12 @@ public:
     void ForceClose();
     bool Read() throw(PRadException);
     void *GetBuffer() {return (void*) buffer;}
+    // bulk read, the data are used in place from the ET buffers, so the events
+    // need to be put back by PutEvents after they are decoded
+    size_t ReadEvents(size_t max_events = ET_CHUNK_SIZE) throw(PRadException);
+    void PutEvents() throw(PRadException);
+    size_t GetNbofEvents() const {return nevents;}
+    const uint32_t *GetEventData(size_t i, size_t &words) const;
     size_t GetBufferLength() {return bufferSize;}
     Configuration &GetConfig() {return config;}
     et_sys_id &GetID() {return et_id;}
@@ -72,6 +79,8 @@ private:
     et_event *etEvent;
     uint32_t *buffer;
     size_t bufferSize;
+    std::vector<et_event*> etEvents;
+    size_t nevents;
     void copyEvent();
 };
 
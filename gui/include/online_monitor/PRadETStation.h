@@ -4,6 +4,14 @@
 #include "et.h"
 #include "PRadException.h"
 #include <string>
+#include <cstdint>
+
+// control words of the events used by the station selection, the event
+// builder puts the CODA event type in the first word and the TI trigger bits
+// in the second one, the built-in match of ET compares the first word for
+// equality and the second one by bitwise and
+#define ET_SELECT_TYPE_WORD 0
+#define ET_SELECT_TRIGGER_WORD 1
 
 class PRadETChannel;
 
@@ -44,6 +52,12 @@ public:
     et_att_id &GetAttachID() {return attach_id;}
     std::string GetName() {return name;}
     void PreSetting(int mode) throw(PRadException);
+    // select the events on the ET system before they are sent to the station
+    // trigger_mask has the bits (1 << trigger type) of the triggers to keep,
+    // the epics events are always kept, 0 keeps all the events
+    // prescale keeps one of every n selected events
+    // it should be called before the station is created
+    void SetSelection(uint32_t trigger_mask, int prescale = 1, bool blocking = false);
     void Create() throw(PRadException);
     void Attach() throw(PRadException);
     void Detach() throw(PRadException);
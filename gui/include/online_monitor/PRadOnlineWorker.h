@@ -0,0 +1,79 @@
+#ifndef PRAD_ONLINE_WORKER_H
+#define PRAD_ONLINE_WORKER_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// sleep time when the ET system has no new events (ms)
+#define ONLINE_IDLE_TIME 50
+// refresh interval of the display in online mode (ms)
+#define ONLINE_REFRESH_TIME 1000
+// time window to update the event rates (ms)
+#define ONLINE_RATE_WINDOW 1000
+// back-pressure of the full decoding, the fraction is reduced by the factor
+// when ET has more events than a chunk, and recovers by the step otherwise
+#define ONLINE_MIN_FRACTION 0.01
+#define ONLINE_FRACTION_FACTOR 0.8
+#define ONLINE_FRACTION_STEP 0.02
+
+class PRadETChannel;
+class PRadDataHandler;
+
+// acquisition thread for online mode
+// it drains the ET events into the data handler, the histograms and the event
+// buffer are filled by this thread, so the GUI should only access them with
+// the lock and take the latest snapshot at its own refresh rate
+// the trigger and scaler information is decoded for every event, while the
+// full decoding only runs on a fraction of the events, the fraction is set by
+// user and lowered automatically if the decoding cannot keep up with ET
+class PRadOnlineWorker
+{
+public:
+    typedef std::recursive_mutex Locker;
+
+public:
+    PRadOnlineWorker(PRadETChannel *ch, PRadDataHandler *h);
+    ~PRadOnlineWorker();
+
+    void Start();
+    void Stop();
+    bool IsRunning() const {return running;}
+
+    // sampling of the full decoding, fraction is in (0, 1]
+    void SetSampleFraction(double f);
+    double GetSampleFraction() const {return sample_fraction;}
+    double GetCurrentFraction() const {return current_fraction;}
+    // rates of the received events and the fully decoded events (Hz)
+    double GetEventRate() const {return event_rate;}
+    double GetDecodeRate() const {return decode_rate;}
+
+    // lock it before accessing the handler and detector systems in online mode
+    std::unique_lock<Locker> Lock() {return std::unique_lock<Locker>(locker);}
+    // number of the events decoded after the last call, it resets the count
+    uint64_t TakeNewEvents() {return new_events.exchange(0);}
+    uint64_t GetDecodedEvents() const {return decoded;}
+    // error message if the thread stopped because of a failure
+    std::string GetError();
+
+private:
+    void run();
+    void updateFraction(bool backlog);
+
+private:
+    PRadETChannel *channel;
+    PRadDataHandler *handler;
+    std::thread thread;
+    Locker locker;
+    std::mutex wait_locker, err_locker;
+    std::condition_variable wait_cv;
+    std::atomic<bool> running, stop_flag;
+    std::atomic<uint64_t> new_events, decoded;
+    std::atomic<double> sample_fraction, current_fraction, event_rate, decode_rate;
+    std::string error;
+};
+
+#endif
@@ -104,3 +104,15 @@ void HistCanvas::UpdateHist(int index, TH2 *hist)
 
     canvases[index]->Refresh();
 }
+
+// check if any canvas has been used within the idle time (ms)
+bool HistCanvas::IsInteracting(qint64 idle_time)
+const
+{
+    for(auto canvas : canvases)
+    {
+        if(canvas->GetIdleTime() < idle_time)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,266 @@
+//============================================================================//
+// HyCal heat map drawn with OpenGL, an alternative to the graphics scene     //
+// The module geometry is baked into an index texture, a fragment shader      //
+// looks up the module colors, so a refresh only uploads the colors           //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "HyCalHeatMap.h"
+#include "HyCalScene.h"
+#include "HyCalModule.h"
+#include <QOpenGLShaderProgram>
+#include <QMouseEvent>
+#include <QVector2D>
+#include <QVector4D>
+#include <cmath>
+#include <algorithm>
+
+static const char *heatmap_vertex_shader = R"(
+attribute vec2 position;
+varying vec2 uv;
+void main()
+{
+    uv = (position + vec2(1.0, 1.0))*0.5;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+// the module index is stored in the red (low byte) and green (high byte)
+static const char *heatmap_fragment_shader = R"(
+uniform sampler2D index_map;
+uniform sampler2D colors;
+uniform vec2 color_size;
+uniform vec4 background;
+varying vec2 uv;
+void main()
+{
+    vec4 id = texture2D(index_map, uv);
+    float index = floor(id.r*255.0 + 0.5) + floor(id.g*255.0 + 0.5)*256.0 - 1.0;
+    if(index < 0.0) {
+        gl_FragColor = background;
+    } else {
+        float row = floor(index/color_size.x);
+        vec2 pos = vec2(index - row*color_size.x + 0.5, row + 0.5)/color_size;
+        gl_FragColor = texture2D(colors, pos);
+    }
+}
+)";
+
+HyCalHeatMap::HyCalHeatMap(QWidget *parent)
+: QOpenGLWidget(parent), scene(nullptr), x_min(0.), y_min(0.), step(1.),
+  index_changed(false), color_changed(false), program(nullptr), index_tex(0), color_tex(0)
+{
+    setMinimumSize(200, 200);
+}
+
+HyCalHeatMap::~HyCalHeatMap()
+{
+    makeCurrent();
+    if(index_tex)
+        glDeleteTextures(1, &index_tex);
+    if(color_tex)
+        glDeleteTextures(1, &color_tex);
+    delete program;
+    doneCurrent();
+}
+
+// the modules are taken from the detector and their geometry is baked
+void HyCalHeatMap::SetDetector(HyCalScene *det)
+{
+    scene = det;
+    modules.clear();
+    if(scene) {
+        for(auto &module : scene->GetModuleList())
+            modules.push_back((HyCalModule*)module);
+    }
+
+    bakeGeometry();
+
+    size_t rows = (modules.size() + HEATMAP_COLOR_WIDTH - 1)/HEATMAP_COLOR_WIDTH;
+    colors.assign(std::max<size_t>(rows, 1)*HEATMAP_COLOR_WIDTH*4, 0);
+    UpdateModules();
+}
+
+// fill the texels inside each module with its index, a gap of about one
+// texel is left between the modules to show their boundaries
+void HyCalHeatMap::bakeGeometry()
+{
+    index_map.assign(HEATMAP_INDEX_SIZE*HEATMAP_INDEX_SIZE, 0);
+    index_changed = true;
+    if(modules.empty())
+        return;
+
+    double x1 = 1e9, x2 = -1e9, y1 = 1e9, y2 = -1e9;
+    for(auto &module : modules)
+    {
+        x1 = std::min(x1, module->GetX() - module->GetSizeX()/2.);
+        x2 = std::max(x2, module->GetX() + module->GetSizeX()/2.);
+        y1 = std::min(y1, module->GetY() - module->GetSizeY()/2.);
+        y2 = std::max(y2, module->GetY() + module->GetSizeY()/2.);
+    }
+
+    // square map with HyCal in center
+    step = std::max(x2 - x1, y2 - y1)/HEATMAP_INDEX_SIZE;
+    x_min = (x1 + x2 - step*HEATMAP_INDEX_SIZE)/2.;
+    y_min = (y1 + y2 - step*HEATMAP_INDEX_SIZE)/2.;
+
+    for(size_t k = 0; k < modules.size(); ++k)
+    {
+        auto module = modules.at(k);
+        double left = module->GetX() - module->GetSizeX()/2. + step/2.;
+        double right = module->GetX() + module->GetSizeX()/2. - step/2.;
+        double bottom = module->GetY() - module->GetSizeY()/2. + step/2.;
+        double top = module->GetY() + module->GetSizeY()/2. - step/2.;
+
+        // texels with the center inside the shrunk module
+        int i1 = std::max(0, (int)std::ceil((left - x_min)/step - 0.5));
+        int i2 = std::min(HEATMAP_INDEX_SIZE - 1, (int)std::floor((right - x_min)/step - 0.5));
+        int j1 = std::max(0, (int)std::ceil((bottom - y_min)/step - 0.5));
+        int j2 = std::min(HEATMAP_INDEX_SIZE - 1, (int)std::floor((top - y_min)/step - 0.5));
+
+        for(int j = j1; j <= j2; ++j)
+            for(int i = i1; i <= i2; ++i)
+                index_map[j*HEATMAP_INDEX_SIZE + i] = k + 1;
+    }
+}
+
+// take the colors of the modules, they are set by the view modes
+void HyCalHeatMap::UpdateModules()
+{
+    for(size_t k = 0; k < modules.size(); ++k)
+    {
+        const QColor &c = modules.at(k)->GetColor();
+        colors[4*k] = c.red();
+        colors[4*k + 1] = c.green();
+        colors[4*k + 2] = c.blue();
+        colors[4*k + 3] = 255;
+    }
+
+    color_changed = true;
+    update();
+}
+
+// the map is kept square in the center of the widget
+QRect HyCalHeatMap::mapArea()
+const
+{
+    int size = std::min(width(), height());
+    return QRect((width() - size)/2, (height() - size)/2, size, size);
+}
+
+HyCalModule *HyCalHeatMap::GetModule(const QPoint &pos)
+const
+{
+    QRect area = mapArea();
+    if(!area.contains(pos) || area.width() <= 0)
+        return nullptr;
+
+    // the texture rows start from the bottom
+    int i = (pos.x() - area.left())*HEATMAP_INDEX_SIZE/area.width();
+    int j = (area.bottom() - pos.y())*HEATMAP_INDEX_SIZE/area.height();
+    i = std::min(std::max(i, 0), HEATMAP_INDEX_SIZE - 1);
+    j = std::min(std::max(j, 0), HEATMAP_INDEX_SIZE - 1);
+
+    unsigned short index = index_map[j*HEATMAP_INDEX_SIZE + i];
+    if(index == 0 || index > modules.size())
+        return nullptr;
+    return modules.at(index - 1);
+}
+
+void HyCalHeatMap::mousePressEvent(QMouseEvent *event)
+{
+    if(event->button() != Qt::LeftButton || !scene)
+        return;
+
+    HyCalModule *module = GetModule(event->pos());
+    if(module)
+        scene->SelectModule(module);
+}
+
+void HyCalHeatMap::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    GLuint tex[2];
+    glGenTextures(2, tex);
+    index_tex = tex[0];
+    color_tex = tex[1];
+    for(auto t : tex)
+    {
+        glBindTexture(GL_TEXTURE_2D, t);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    program = new QOpenGLShaderProgram;
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, heatmap_vertex_shader);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, heatmap_fragment_shader);
+    program->bindAttributeLocation("position", 0);
+    if(!program->link())
+        qWarning("HyCal Heat Map Error: cannot link shaders, %s", qPrintable(program->log()));
+
+    // the textures are uploaded in the new context
+    index_changed = true;
+    color_changed = true;
+}
+
+void HyCalHeatMap::paintGL()
+{
+    // same background as the graphics scene
+    glClearColor(1., 1., 238./255., 1.);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if(modules.empty() || !program->isLinked())
+        return;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // the geometry is only uploaded once
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, index_tex);
+    if(index_changed) {
+        std::vector<unsigned char> texels(index_map.size()*4, 0);
+        for(size_t i = 0; i < index_map.size(); ++i)
+        {
+            texels[4*i] = index_map[i]&0xff;
+            texels[4*i + 1] = (index_map[i] >> 8)&0xff;
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, HEATMAP_INDEX_SIZE, HEATMAP_INDEX_SIZE,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        index_changed = false;
+    }
+
+    // one small upload for new colors
+    int rows = colors.size()/4/HEATMAP_COLOR_WIDTH;
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, color_tex);
+    if(color_changed) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, HEATMAP_COLOR_WIDTH, rows,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, colors.data());
+        color_changed = false;
+    }
+
+    QRect area = mapArea();
+    qreal ratio = devicePixelRatio();
+    glViewport(area.left()*ratio, (height() - area.bottom() - 1)*ratio,
+               area.width()*ratio, area.height()*ratio);
+
+    static const GLfloat quad[] = {-1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, 1.f};
+
+    program->bind();
+    program->setUniformValue("index_map", 0);
+    program->setUniformValue("colors", 1);
+    program->setUniformValue("color_size", QVector2D(HEATMAP_COLOR_WIDTH, rows));
+    program->setUniformValue("background", QVector4D(1., 1., 238./255., 1.));
+    program->enableAttributeArray(0);
+    program->setAttributeArray(0, GL_FLOAT, quad, 2);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    program->disableAttributeArray(0);
+    program->release();
+
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -49,6 +49,10 @@ void HyCalModule::Initialize()
     double size_x = geometry.size_x;
     double size_y = geometry.size_y;
     shape.addRect(-size_x/2., -size_y/2., size_x, size_y);
+
+    // the outline and labels are painted into a pixmap, it is only repainted
+    // when the module is updated
+    setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 }
 
 // define the bound of this item
@@ -152,11 +156,21 @@ void HyCalModule::setSelected(bool selected)
         console->SelectModule(this);
 }
 
+// only the module with a changed color is repainted
+void HyCalModule::SetColor(const QColor &c)
+{
+    if(c == color)
+        return;
+
+    color = c;
+    update();
+}
+
 // Get color from the spectrum
 void HyCalModule::SetColor(const double &val)
 {
     if(console)
-        color = console->GetColor(val);
+        SetColor(console->GetColor(val));
 }
 
 void HyCalModule::ShowPedestal()
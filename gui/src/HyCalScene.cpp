@@ -35,24 +35,27 @@ void HyCalScene::drawForeground(QPainter *painter, const QRectF &rect)
     painter->save();
 
     if(showScalers)
-        drawScalerBoxes(painter);
+        drawScalerBoxes(painter, rect);
 
     if(console->GetAnnoType() == ShowTDC)
         drawTDCBoxes(painter);
 
     if(console->GetViewMode() == EnergyView)
-        drawHitsMarks(painter);
+        drawHitsMarks(painter, rect);
 
     painter->restore();
 }
 
 
-// show scaler boxes
-void HyCalScene::drawScalerBoxes(QPainter *painter)
+// show scaler boxes, only the ones in the exposed area are drawn
+void HyCalScene::drawScalerBoxes(QPainter *painter, const QRectF &rect)
 {
     painter->setFont(QFont("times", 16, QFont::Bold));
     for(auto it = scalarBoxList.begin(); it != scalarBoxList.end(); ++it)
     {
+        if(!rect.intersects(scalerArea(*it)))
+            continue;
+
         QPen pen(it->textColor);
         pen.setWidth(2);
         pen.setCosmetic(true);
@@ -72,7 +75,41 @@ void HyCalScene::drawScalerBoxes(QPainter *painter)
 }
 
 // show the tdc groups
+// they are static, so they are painted once for the current scale of view and
+// then drawn from the cached pixmap
 void HyCalScene::drawTDCBoxes(QPainter *painter)
+{
+    if(tdcBoxList.isEmpty())
+        return;
+
+    QRectF area;
+    for(auto &box : tdcBoxList)
+        area |= box.bound;
+
+    QTransform trans = painter->worldTransform();
+    QRect dev_area = trans.mapRect(area).toAlignedRect().adjusted(-2, -2, 2, 2);
+
+    // only translation is allowed for the cached pixmap
+    if(tdcLayer.isNull() ||
+       trans.m11() != tdcTransform.m11() || trans.m12() != tdcTransform.m12() ||
+       trans.m21() != tdcTransform.m21() || trans.m22() != tdcTransform.m22()) {
+        tdcLayer = QPixmap(dev_area.size());
+        tdcLayer.fill(Qt::transparent);
+        QPainter layer(&tdcLayer);
+        layer.setRenderHints(painter->renderHints());
+        layer.setTransform(trans*QTransform::fromTranslate(-dev_area.left(), -dev_area.top()));
+        paintTDCBoxes(&layer);
+        tdcTransform = trans;
+    }
+
+    painter->save();
+    painter->resetTransform();
+    painter->drawPixmap(dev_area.topLeft(), tdcLayer);
+    painter->restore();
+}
+
+// paint the tdc groups
+void HyCalScene::paintTDCBoxes(QPainter *painter)
 {
     painter->setFont(QFont("times", 24, QFont::Bold));
     for(auto it = tdcBoxList.begin(); it != tdcBoxList.end(); ++it)
@@ -93,10 +130,13 @@ void HyCalScene::drawTDCBoxes(QPainter *painter)
 }
 
 // draw hits marks
-void HyCalScene::drawHitsMarks(QPainter *painter)
+void HyCalScene::drawHitsMarks(QPainter *painter, const QRectF &rect)
 {
     for(auto &mark : hitsMarkList)
     {
+        if(!rect.intersects(markArea(mark)))
+            continue;
+
         drawHitsMark(painter, mark.hitPos, mark.attr);
 
         // draw text
@@ -236,6 +276,8 @@ void HyCalScene::AddTDCBox(const QString &text,
                            const QColor &bkgColor)
 {
     tdcBoxList.append(TextBox(text, textColor, textBox, bkgColor));
+    // repaint the cached tdc boxes
+    tdcLayer = QPixmap();
 }
 
 void HyCalScene::AddScalerBox(const QString &text,
@@ -252,6 +294,7 @@ void HyCalScene::AddHitsMark(const QString &name,
                              const QString &text)
 {
     hitsMarkList.push_back(HitsMark(name, text, position, m));
+    update(markArea(hitsMarkList.back()));
 }
 
 void HyCalScene::UpdateScalerBox(const QString &text, const int &group)
@@ -259,7 +302,13 @@ void HyCalScene::UpdateScalerBox(const QString &text, const int &group)
     if(group < 0 || group >= scalarBoxList.size())
         return;
 
-    scalarBoxList[group].text = text;
+    TextBox &box = scalarBoxList[group];
+    if(box.text == text)
+        return;
+
+    box.text = text;
+    if(showScalers)
+        update(scalerArea(box));
 }
 
 void HyCalScene::UpdateScalerBox(const QStringList &texts)
@@ -290,11 +339,7 @@ void HyCalScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
            !pModule->isSelected() &&
            pModule == dynamic_cast<HyCalModule*>(itemAt(event->scenePos(), QTransform()))
           ) {
-            pModule->setSelected(true);
-            if(sModule) {
-                sModule->setSelected(false);
-            }
-            sModule = pModule;
+            SelectModule(pModule);
         }
     } else if(event->button() == Qt::RightButton) {
         if(rModule &&
@@ -307,11 +352,62 @@ void HyCalScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
     }
 }
 
+// select a module, the previous selection is released
+void HyCalScene::SelectModule(HyCalModule *module)
+{
+    if(!module || module->isSelected())
+        return;
+
+    module->setSelected(true);
+    if(sModule) {
+        sModule->setSelected(false);
+    }
+    sModule = module;
+}
+
 void HyCalScene::ClearHitsMarks()
 {
+    for(auto &mark : hitsMarkList)
+        update(markArea(mark));
     hitsMarkList.clear();
 }
 
+void HyCalScene::ShowScalers(const bool &s)
+{
+    if(showScalers == s)
+        return;
+
+    showScalers = s;
+    for(auto &box : scalarBoxList)
+        update(scalerArea(box));
+}
+
+// repaint all the modules, it is needed when the labels are changed
+void HyCalScene::UpdateModules()
+{
+    for(auto &module : module_list)
+        ((HyCalModule*)module)->update();
+}
+
+// area of a scaler box including its name and frame
+QRectF HyCalScene::scalerArea(const TextBox &box)
+const
+{
+    QRectF area = box.bound | box.bound.translated(0, -box.bound.height());
+    return area.adjusted(-4., -4., 4., 4.);
+}
+
+// area of a hits mark including its text
+QRectF HyCalScene::markArea(const HitsMark &mark)
+const
+{
+    double half = mark.attr.size + mark.attr.width;
+    QRectF area(mark.hitPos.x() - half, mark.hitPos.y() - half, 2.*half, 2.*half);
+    if(!mark.text.isEmpty())
+        area |= mark.textBox;
+    return area.adjusted(-1., -1., 1., 1.);
+}
+
 void HyCalScene::ShowEvent()
 {
     ModuleAction(&HyCalModule::SetEnergy);
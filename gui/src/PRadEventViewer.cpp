@@ -19,6 +19,7 @@
 #include <iostream>
 #include <iomanip>
 #include <unordered_map>
+#include <thread>
 
 #if QT_VERSION >= 0x050000
 #include <QtWidgets>
@@ -45,6 +46,8 @@
 #include "PRadTaggerSystem.h"
 #include "PRadHyCalSystem.h"
 #include "PRadGEMSystem.h"
+#include "PRadConfigLoader.h"
+#include "PRadMemoryTracker.h"
 
 #ifdef RECON_DISPLAY
 #include "PRadHyCalCluster.h"
@@ -52,10 +55,12 @@
 #include "PRadCoordSystem.h"
 #include "PRadDetMatch.h"
 #include "ReconSettingPanel.h"
+#include "ReconWorker.h"
 #endif
 
 #ifdef USE_ONLINE_MODE
 #include "online_monitor/PRadETChannel.h"
+#include "online_monitor/PRadOnlineWorker.h"
 #include "online_monitor/ETSettingPanel.h"
 #endif
 
@@ -63,11 +68,21 @@
 #include "high_voltage/PRadHVSystem.h"
 #endif
 
+#ifdef USE_GL_HEATMAP
+#include "HyCalHeatMap.h"
+#endif
+
 #ifdef USE_EVIO_LIB
 #include "evioUtil.hxx"
 #include "evioFileChannel.hxx"
 #endif
 
+// interval to show the events that have been loaded (ms)
+#define LOAD_REFRESH_TIME 1000
+// the histogram redraw requests within the interval are merged (ms)
+#define HIST_REDRAW_INTERVAL 50
+// root events are processed until the canvases are idle for this long (ms)
+#define ROOT_EVENT_IDLE_TIME 3000
 
 
 //============================================================================//
@@ -91,19 +106,32 @@ PRadEventViewer::PRadEventViewer()
     handler->SetTaggerSystem(tagger_sys);
     handler->SetHyCalSystem(hycal_sys);
     handler->SetGEMSystem(gem_sys);
+    // use all the cores to load data files
+    handler->SetDecodeThreads(std::thread::hardware_concurrency());
+    registerMemory();
     initView();
     setupUI();
 }
 
 PRadEventViewer::~PRadEventViewer()
 {
+    // stop the file reading in background
+    handler->StopReading();
+    loadWatcher.waitForFinished();
+
+    for(auto &name : {"Events", "EPICS", "HyCal", "GEM"})
+        PRadMemoryTracker::Instance().Unregister(name);
+    PRadMemoryTracker::Instance().SetEventCounter(nullptr);
+
 #ifdef USE_ONLINE_MODE
+    delete onlineWorker;
     delete etChannel;
 #endif
 #ifdef USE_CAEN_HV
     delete hvSystem;
 #endif
 #ifdef RECON_DISPLAY
+    delete reconWorker;
     delete coordSystem;
     delete detMatch;
 #endif
@@ -123,10 +151,21 @@ void PRadEventViewer::initView()
     generateScalerBoxes();
     generateSpectrum();
 
-    epic_sys->ReadMap(prad_root + "config/epics_channels.conf");
-    hycal_sys->SetDetector(HyCal);
-    hycal_sys->Configure(prad_root + "config/hycal.conf");
-    gem_sys->Configure(prad_root + "config/gem.conf");
+    // the systems are configured concurrently, HyCal stays in this thread
+    // because its modules are the graphic items of the scene
+    {
+        PRadConfigLoader loader;
+        loader.Add("EPICS Channels", [this] () {epic_sys->ReadMap(prad_root + "config/epics_channels.conf");});
+        loader.Add("GEM System", [this] () {gem_sys->Configure(prad_root + "config/gem.conf");});
+        hycal_sys->SetDetector(HyCal);
+        hycal_sys->Configure(prad_root + "config/hycal.conf");
+        loader.Wait();
+        loader.Report();
+    }
+
+    // the browsed events are reconstructed again and again with same settings
+    hycal_sys->GetReconstructor()->SetCacheSize(RECON_CACHE_SIZE);
+    gem_sys->SetCacheSize(RECON_CACHE_SIZE);
 
     // TDC Group Box
     setTDCGroupBox();
@@ -156,6 +195,10 @@ void PRadEventViewer::initView()
 #ifdef USE_CAEN_HV
     setupHVSystem("high_voltage/crate_list.txt");
 #endif
+
+#ifdef USE_GL_HEATMAP
+    setupHeatMap();
+#endif
 }
 
 // set up the UI
@@ -176,7 +219,15 @@ void PRadEventViewer::setupUI()
     rightPanel->setStretchFactor(1,2);
 
     mainSplitter = new QSplitter(Qt::Horizontal);
+#ifdef USE_GL_HEATMAP
+    // the heat map takes the place of HyCal view when it is switched on
+    hycalStack = new QStackedWidget;
+    hycalStack->addWidget(view);
+    hycalStack->addWidget(heatMap);
+    mainSplitter->addWidget(hycalStack);
+#else
     mainSplitter->addWidget(view);
+#endif
     mainSplitter->addWidget(rightPanel);
     mainSplitter->setStretchFactor(0,2);
     mainSplitter->setStretchFactor(1,3);
@@ -251,6 +302,8 @@ QMenu *PRadEventViewer::setupFileMenu()
     openDataAction = fileMenu->addAction(tr("&Open Data File"));
     openDataAction->setShortcuts(QKeySequence::Open);
 
+    openIndexAction = fileMenu->addAction(tr("Open DST File (Index Only)"));
+
     QAction *saveHistAction = fileMenu->addAction(tr("Save &Histograms"));
     saveHistAction->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_H));
 
@@ -258,6 +311,7 @@ QMenu *PRadEventViewer::setupFileMenu()
     quitAction->setShortcuts(QKeySequence::Quit);
 
     connect(openDataAction, SIGNAL(triggered()), this, SLOT(openDataFile()));
+    connect(openIndexAction, SIGNAL(triggered()), this, SLOT(openDSTIndex()));
     connect(saveHistAction, SIGNAL(triggered()), this, SLOT(saveHistToFile()));
     connect(quitAction, SIGNAL(triggered()), qApp, SLOT(quit()));
 
@@ -312,12 +366,16 @@ QMenu *PRadEventViewer::setupToolMenu()
     QAction *findEventAction = toolMenu->addAction(tr("Find Event"));
     findEventAction->setShortcut(QKeySequence(Qt::CTRL + Qt::ALT + Qt::Key_E));
 
+    QAction *memoryAction = toolMenu->addAction(tr("Memory Usage"));
+    memoryAction->setShortcut(QKeySequence(Qt::CTRL + Qt::ALT + Qt::Key_M));
+
     connect(eraseAction, SIGNAL(triggered()), this, SLOT(eraseBufferAction()));
     connect(findPeakAction, SIGNAL(triggered()), this, SLOT(findPeak()));
     connect(fitHistAction, SIGNAL(triggered()), this, SLOT(fitHistogram()));
     connect(snapShotAction, SIGNAL(triggered()), this, SLOT(takeSnapShot()));
     connect(showCustomAction, SIGNAL(triggered()), this, SLOT(openCustomMap()));
     connect(findEventAction, SIGNAL(triggered()), this, SLOT(findEvent()));
+    connect(memoryAction, SIGNAL(triggered()), this, SLOT(showMemoryUsage()));
 
     return toolMenu;
 }
@@ -336,6 +394,12 @@ QMenu *PRadEventViewer::setupSettingMenu()
     connect(setupRecon, SIGNAL(triggered()), this, SLOT(setupReconMethods()));
 #endif
 
+#ifdef USE_GL_HEATMAP
+    QAction *heatMapAction = reconMenu->addAction(tr("OpenGL Heat Map"));
+    heatMapAction->setCheckable(true);
+    connect(heatMapAction, SIGNAL(toggled(bool)), this, SLOT(switchHeatMap(bool)));
+#endif
+
     return reconMenu;
 }
 
@@ -414,8 +478,18 @@ void PRadEventViewer::createStatusBar()
     rStatusLabel->setAlignment(Qt::AlignRight);
 
 
+    // cancel the background file reading
+    cancelLoadButton = new QPushButton(tr("Cancel Loading"));
+    cancelLoadButton->setVisible(false);
+    connect(cancelLoadButton, SIGNAL(clicked()), this, SLOT(cancelLoading()));
+
     statusBar()->addPermanentWidget(lStatusLabel, 1);
     statusBar()->addPermanentWidget(rStatusLabel, 1);
+    statusBar()->addPermanentWidget(cancelLoadButton);
+
+    loadTimer = new QTimer(this);
+    connect(loadTimer, SIGNAL(timeout()), this, SLOT(updateLoadProgress()));
+    connect(&loadWatcher, SIGNAL(finished()), this, SLOT(finishLoading()));
 }
 
 // Status window
@@ -430,6 +504,11 @@ void PRadEventViewer::createStatusWindow()
     histCanvas->AddCanvas(1, 0, 46);
     histCanvas->AddCanvas(2, 0, 30);
 
+    // histograms are redrawn at most once in an interval
+    histTimer = new QTimer(this);
+    histTimer->setSingleShot(true);
+    connect(histTimer, SIGNAL(timeout()), this, SLOT(drawHistCanvas()));
+
     statusWindow->addWidget(statusInfoWidget);
     statusWindow->addWidget(histCanvas);
 }
@@ -549,27 +628,77 @@ QColor PRadEventViewer::GetColor(const double &val)
     return energySpectrum->GetColor(val);
 }
 
+// the values of all modules are mapped to the colors in one pass before the
+// modules are updated, get returns false for a module without value, and the
+// module keeps its color
+template<class Getter>
+static void showModuleValues(const std::vector<PRadHyCalModule*> &modules,
+                             const Spectrum *spectrum, Getter get)
+{
+    std::vector<HyCalModule*> shown;
+    std::vector<double> values;
+    shown.reserve(modules.size());
+    values.reserve(modules.size());
+
+    for(auto m : modules)
+    {
+        HyCalModule *module = (HyCalModule*)m;
+        double val;
+        if(get(module, val)) {
+            shown.push_back(module);
+            values.push_back(val);
+        }
+    }
+
+    std::vector<int> indices(values.size());
+    spectrum->MapIndices(values.data(), indices.data(), values.size());
+    for(size_t i = 0; i < shown.size(); ++i)
+        shown[i]->SetColor(spectrum->GetIndexColor(indices[i]));
+}
+
 // refresh all the view
 void PRadEventViewer::Refresh()
 {
+    const auto &modules = HyCal->GetModuleList();
+
     switch(viewMode)
     {
     default:
         break;
     case PedestalView:
-        HyCal->ModuleAction(&HyCalModule::ShowPedestal);
+        showModuleValues(modules, energySpectrum,
+                         [] (HyCalModule *m, double &v) -> bool
+                         {
+                             if(!m->GetChannel()) return false;
+                             v = m->GetChannel()->GetPedestal().mean;
+                             return true;
+                         });
         break;
     case SigmaView:
-        HyCal->ModuleAction(&HyCalModule::ShowPedSigma);
+        showModuleValues(modules, energySpectrum,
+                         [] (HyCalModule *m, double &v) -> bool
+                         {
+                             if(!m->GetChannel()) return false;
+                             v = m->GetChannel()->GetPedestal().sigma;
+                             return true;
+                         });
         break;
     case OccupancyView:
-        HyCal->ModuleAction(&HyCalModule::ShowOccupancy);
+        showModuleValues(modules, energySpectrum,
+                         [] (HyCalModule *m, double &v) -> bool
+                         {
+                             if(!m->GetChannel()) return false;
+                             v = m->GetChannel()->GetOccupancy();
+                             return true;
+                         });
         break;
     case EnergyView:
-        HyCal->ModuleAction(&HyCalModule::ShowEnergy);
+        showModuleValues(modules, energySpectrum,
+                         [] (HyCalModule *m, double &v) -> bool {v = m->GetEnergy(); return true;});
         break;
     case CustomView:
-        HyCal->ModuleAction(&HyCalModule::ShowCustomValue);
+        showModuleValues(modules, energySpectrum,
+                         [] (HyCalModule *m, double &v) -> bool {v = m->GetCustomValue(); return true;});
         break;
 #ifdef USE_CAEN_HV
     case HighVoltageView:
@@ -602,7 +731,14 @@ void PRadEventViewer::Refresh()
 
     UpdateStatusInfo();
 
-    view->viewport()->update();
+#ifdef USE_GL_HEATMAP
+    // the module colors are uploaded to the heat map together
+    if(hycalStack->currentWidget() == heatMap)
+        heatMap->UpdateModules();
+#endif
+
+    // the modules and marks repaint their own areas when they are changed,
+    // and the updates are done together in the next event loop
 }
 
 // clean all the data buffer
@@ -635,30 +771,169 @@ void PRadEventViewer::openDataFile()
 
     eraseData();
 
+    // the events can be viewed while the files are being read
+    loadingFiles = fileList;
+    openDataAction->setEnabled(false);
+    openIndexAction->setEnabled(false);
+#ifdef USE_ONLINE_MODE
+    onlineEnAction->setEnabled(false);
+#endif
+    cancelLoadButton->setVisible(true);
+    cancelLoadButton->setEnabled(true);
+    lStatusLabel->setText(tr("Loading %1 data files").arg(fileList.size()));
+
+    handler->StopReading(false);
+    loadWatcher.setFuture(QtConcurrent::run(this, &PRadEventViewer::loadDataFiles, fileList));
+    loadTimer->start(LOAD_REFRESH_TIME);
+}
+
+// open a DST file without reading its events, the events are decoded when
+// they are viewed, so the run size is not limited by the memory
+void PRadEventViewer::openDSTIndex()
+{
+    QString codaData;
+    codaData.sprintf("%s", getenv("CODA_DATA"));
+    if (codaData.isEmpty())
+        codaData = QDir::currentPath();
+
+    QStringList filters;
+    filters << "DST files (*.dst)"
+            << "All files (*)";
+
+    QString file = getFileName(tr("Choose a DST file"), codaData, filters, "");
+
+    if (file.isEmpty())
+        return;
+
+    eraseData();
+
+    if(!handler->OpenDST(file.toStdString())) {
+        QMessageBox::critical(this,
+                              tr("Open DST File"),
+                              tr("Failed to open ") + file);
+        return;
+    }
+
+    fileName = file;
+    UpdateStatusBar(DATA_FILE);
+    updateEventRange();
+}
+
+// read the data files, it runs in background
+void PRadEventViewer::loadDataFiles(const QStringList &files)
+{
     PRadBenchMark timer;
 
-    for(QString &file : fileList)
+    int count = 0;
+    for(auto &file : files)
     {
-        //TODO, dialog to notice waiting
-//        QtConcurrent::run(this, &PRadEventViewer::readEventFromFile, fileName);
-        fileName = file;
-        if(fileName.contains(".dst")) {
-            handler->ReadFromDST(fileName.toStdString());
+        if(handler->IsReadingStopped())
+            break;
+
+        if(file.contains(".dst")) {
+            handler->ReadFromDST(file.toStdString());
         } else {
-            readEventFromFile(fileName);
+            readEventFromFile(file);
         }
-        UpdateStatusBar(DATA_FILE);
+        ++count;
     }
 
+    auto lock = handler->LockData();
     std::cout << "Parsed " << handler->GetEventCount() << " events and "
               << epic_sys->GetEventCount() << " EPICS events from "
-              << fileList.size() << " files." << std::endl
+              << count << " files." << std::endl
               << " Used " << timer.GetElapsedTime() << " ms."
               << std::endl;
+}
+
+// show the events that have been loaded
+void PRadEventViewer::updateLoadProgress()
+{
+    auto lock = handler->LockData();
+    int total = handler->GetEventCount();
+    if(!total)
+        return;
+
+    bool first = (eventSpin->maximum() == 0);
+    eventCntLabel->setText(tr("Loading events: ") + QString::number(total));
+    eventSpin->setRange(1, total);
+    UpdateHistCanvas();
+
+    // show the first event once it is available
+    if(first)
+        emit currentEventChanged(eventSpin->value());
+}
+
+void PRadEventViewer::finishLoading()
+{
+    loadTimer->stop();
+    cancelLoadButton->setVisible(false);
+    openDataAction->setEnabled(true);
+    openIndexAction->setEnabled(true);
+#ifdef USE_ONLINE_MODE
+    onlineEnAction->setEnabled(true);
+#endif
+
+    if(handler->IsReadingStopped())
+        rStatusLabel->setText(tr("Loading is canceled"));
+    handler->StopReading(false);
+
+    if(!loadingFiles.isEmpty()) {
+        fileName = loadingFiles.last();
+        UpdateStatusBar(DATA_FILE);
+    }
 
     updateEventRange();
 }
 
+void PRadEventViewer::cancelLoading()
+{
+    // the events already read are kept
+    handler->StopReading();
+    cancelLoadButton->setEnabled(false);
+}
+
+// the subsystems report their memory to the tracker, it is only computed when
+// the usage is shown
+void PRadEventViewer::registerMemory()
+{
+    auto &tracker = PRadMemoryTracker::Instance();
+    tracker.Register("Events", [this] () {return handler->GetMemoryUsage();});
+    tracker.Register("EPICS", [this] () {return epic_sys->GetMemoryUsage();});
+    tracker.Register("HyCal", [this] () {return hycal_sys->GetMemoryUsage();});
+    tracker.Register("GEM", [this] () {return gem_sys->GetMemoryUsage();});
+    tracker.SetEventCounter([this] () {return handler->GetEventCount();});
+}
+
+void PRadEventViewer::showMemoryUsage()
+{
+    auto &tracker = PRadMemoryTracker::Instance();
+    size_t nevents = tracker.GetEventCount();
+
+    QString table = tr("<table cellpadding=\"3\"><tr><th align=\"left\">Subsystem</th>"
+                       "<th>Live (MB)</th><th>Blocks</th><th>Bytes/Event</th></tr>");
+    MemoryUsage total;
+    auto add_row = [&] (const QString &name, const MemoryUsage &usage)
+                   {
+                       table += tr("<tr><td>%1</td><td align=\"right\">%2</td>"
+                                   "<td align=\"right\">%3</td><td align=\"right\">%4</td></tr>")
+                                .arg(name)
+                                .arg(usage.bytes/1048576., 0, 'f', 2)
+                                .arg(usage.blocks)
+                                .arg(nevents ? (double)usage.bytes/nevents : 0., 0, 'f', 1);
+                   };
+
+    for(auto &entry : tracker.GetUsage())
+    {
+        total += entry.usage;
+        add_row(QString::fromStdString(entry.name), entry.usage);
+    }
+    add_row(tr("<b>Total</b>"), total);
+    table += tr("</table><p>%1 events</p>").arg(nevents);
+
+    QMessageBox::information(this, tr("Memory Usage"), table);
+}
+
 // initialize handler from data file
 void PRadEventViewer::initializeFromFile()
 {
@@ -701,6 +976,9 @@ void PRadEventViewer::openCalibrationFile()
 
     if (!file.isEmpty()) {
         hycal_sys->GetDetector()->ReadCalibrationFile(file.toStdString());
+#ifdef RECON_DISPLAY
+        reconWorker->Reset();
+#endif
     }
 }
 
@@ -716,6 +994,9 @@ void PRadEventViewer::openGainFactorFile()
 
     if (!file.isEmpty()) {
         hycal_sys->ReadRunInfoFile(file.toStdString());
+#ifdef RECON_DISPLAY
+        reconWorker->Reset();
+#endif
     }
 }
 
@@ -779,6 +1060,9 @@ void PRadEventViewer::changeHistType(int index)
 void PRadEventViewer::changeAnnoType(int index)
 {
     annoType = (AnnoType)index;
+    // the labels are cached in the modules
+    HyCal->UpdateModules();
+    HyCal->update();
     Refresh();
 }
 
@@ -786,6 +1070,8 @@ void PRadEventViewer::changeViewMode(int index)
 {
     viewMode = (ViewMode)index;
     specSetting->ChoosePreSetting(index);
+    // the hits marks are only shown in energy view
+    HyCal->update();
     Refresh();
 }
 
@@ -863,6 +1149,7 @@ void PRadEventViewer::handleEventChange(int evt)
 
 void PRadEventViewer::updateEventRange()
 {
+    auto data_lock = handler->LockData();
     int total = handler->GetEventCount();
 
     if(total) {
@@ -879,8 +1166,21 @@ void PRadEventViewer::updateEventRange()
 
 void PRadEventViewer::chooseEvent(int index)
 {
+    // the events may be loaded in background
+    auto data_lock = handler->LockData();
     auto &event = handler->GetEvent(index);
 
+    showEvent(event);
+
+#ifdef RECON_DISPLAY
+    // get the following events ready while this one is shown
+    if(reconSetting->IsEnabled())
+        reconWorker->Request(index + 1);
+#endif
+}
+
+void PRadEventViewer::showEvent(const EventData &event)
+{
     // update event information
     event_number = event.event_number;
     HyCal->ShowEvent(event);
@@ -897,29 +1197,15 @@ void PRadEventViewer::chooseEvent(int index)
     if(!reconSetting->IsEnabled() || !event.is_physics_event())
         return;
 
-    // reconstruction
-    hycal_sys->Reconstruct();
-    gem_sys->Reconstruct();
-    auto gem1 = gem_sys->GetDetector(PRadDetector::PRadGEM1);
-    auto gem2 = gem_sys->GetDetector(PRadDetector::PRadGEM2);
+    // the event may be reconstructed in background already
+    if(!reconWorker->Find(event, reconResult))
+        reconWorker->Reconstruct(event, reconResult);
 
     // get reconstructed hits
-    auto &hycal_hit = HyCal->GetHits();
-    auto &gem1_hit = gem1->GetHits();
-    auto &gem2_hit = gem2->GetHits();
-
-    // coordinates transform, projection
-    coordSystem->TransformHits(HyCal);
-    coordSystem->TransformHits(gem1);
-    coordSystem->TransformHits(gem2);
-
-    // project hits to HyCal surface
-    coordSystem->Projection(hycal_hit.begin(), hycal_hit.end());
-    coordSystem->Projection(gem1_hit.begin(), gem1_hit.end());
-    coordSystem->Projection(gem2_hit.begin(), gem2_hit.end());
-
-    // hits matching
-    auto matched = detMatch->Match(hycal_hit, gem1_hit, gem2_hit);
+    auto &hycal_hit = reconResult.hycal;
+    auto &gem1_hit = reconResult.gem1;
+    auto &gem2_hit = reconResult.gem2;
+    auto &matched = reconResult.matched;
 
     // display HyCal hits
     if(reconSetting->ShowDetector(PRadDetector::HyCal)) {
@@ -984,15 +1270,29 @@ void PRadEventViewer::chooseEvent(int index)
     }
 
     // update the cluster size
-    int mcl = hycal_sys->GetReconstructor()->GetClusters().size();
+    int mcl = reconResult.clusters.size();
     clusterSpin->setRange(0, mcl);
 
 #endif // RECON_DISPLAY
 }
 
+// the requests are merged and the canvases are redrawn later
 void PRadEventViewer::UpdateHistCanvas()
 {
-    gSystem->ProcessEvents();
+    if(!histTimer->isActive())
+        histTimer->start(HIST_REDRAW_INTERVAL);
+}
+
+void PRadEventViewer::drawHistCanvas()
+{
+#ifdef USE_ONLINE_MODE
+    // the histograms are filled by the acquisition thread in online mode
+    auto lock = onlineWorker->Lock();
+#endif
+    // the histograms are also filled by the background loading
+    auto data_lock = handler->LockData();
+    // show the buffered counts
+    hycal_sys->SyncHists();
     switch(histType) {
     default:
     case EnergyTDCHist:
@@ -1129,7 +1429,7 @@ void PRadEventViewer::readEventFromFile(const QString &filepath)
         evio::evioFileChannel *chan = new evio::evioFileChannel(filepath.toStdString().c_str(),"r");
         chan->open();
 
-        while(chan->read())
+        while(!handler->IsReadingStopped() && chan->read())
         {
             handler->Decode(chan->getBuffer());
         }
@@ -1251,6 +1551,11 @@ void PRadEventViewer::findPeak()
     if(!selection || !selection->GetChannel())
         return;
 
+#ifdef USE_ONLINE_MODE
+    auto lock = onlineWorker->Lock();
+#endif
+    auto data_lock = handler->LockData();
+    hycal_sys->SyncHists();
     TH1 *h = selection->GetChannel()->GetHist("Physics");
 
     //Use TSpectrum to find the peak candidates
@@ -1338,6 +1643,9 @@ void PRadEventViewer::fitHistogram()
 void PRadEventViewer::correctGainFactor()
 {
     hycal_sys->CorrectGainFactor(2);
+#ifdef RECON_DISPLAY
+    reconWorker->Reset();
+#endif
     // Refill the histogram to show the changes
     handler->RefillEnergyHist();
     UpdateHistCanvas();
@@ -1388,9 +1696,11 @@ void PRadEventViewer::editCustomValueLabel(QTreeWidgetItem* item, int column)
         item->setFlags(item->flags() & ~Qt::ItemIsEditable);
 }
 
+// only process root events when the canvases are in use
 void PRadEventViewer::handleRootEvents()
 {
-    gSystem->ProcessEvents();
+    if(histCanvas->IsInteracting(ROOT_EVENT_IDLE_TIME))
+        gSystem->ProcessEvents();
 }
 
 #ifdef RECON_DISPLAY
@@ -1410,6 +1720,9 @@ void PRadEventViewer::setupReconDisplay()
     reconSetting->ConnectCoordSystem(coordSystem);
     reconSetting->ConnectMatchSystem(detMatch);
 
+    // the events are reconstructed in background for the display
+    reconWorker = new ReconWorker(handler, hycal_sys, gem_sys, coordSystem, detMatch);
+    reconWorker->Start();
 }
 
 void PRadEventViewer::enableReconstruct()
@@ -1433,8 +1746,13 @@ void PRadEventViewer::setupReconMethods()
         return;
     }
 
-    // apply the changes to connected objects
-    reconSetting->ApplyChanges();
+    // apply the changes to connected objects, the reconstructed events are
+    // out of date
+    {
+        auto pause = reconWorker->Pause();
+        reconSetting->ApplyChanges();
+    }
+    reconWorker->Reset();
 
     emit(changeCurrentEvent(eventSpin->value()));
 }
@@ -1442,7 +1760,7 @@ void PRadEventViewer::setupReconMethods()
 void PRadEventViewer::handleClusterChange(int idx)
 {
     if(idx > 0) {
-        HyCal->ShowCluster(hycal_sys->GetReconstructor()->GetClusters().at(idx - 1));
+        HyCal->ShowCluster(reconResult.clusters.at(idx - 1));
     } else {
         HyCal->ShowEvent();
     }
@@ -1466,6 +1784,7 @@ void PRadEventViewer::setupOnlineMode()
     connect(&watcher, SIGNAL(finished()), this, SLOT(startOnlineMode()));
 
     etChannel = new PRadETChannel();
+    onlineWorker = new PRadOnlineWorker(etChannel, handler);
 }
 
 QMenu *PRadEventViewer::setupOnlineMenu()
@@ -1491,6 +1810,7 @@ void PRadEventViewer::initOnlineMode()
     // Disable buttons
     onlineEnAction->setEnabled(false);
     openDataAction->setEnabled(false);
+    openIndexAction->setEnabled(false);
     eventSpin->setEnabled(false);
     future = QtConcurrent::run(this, &PRadEventViewer::connectETClient);
     watcher.setFuture(future);
@@ -1503,6 +1823,9 @@ bool PRadEventViewer::connectETClient()
                         etSetting->GetETPort(),
                         etSetting->GetETFilePath().toStdString().c_str());
         etChannel->NewStation(etSetting->GetStationName().toStdString());
+        // only the events to be decoded are sent over the network
+        etChannel->GetCurrentStation()->SetSelection(etSetting->GetTriggerMask(),
+                                                     etSetting->GetPrescale());
         etChannel->AttachStation();
     } catch(PRadException e) {
         etChannel->ForceClose();
@@ -1524,6 +1847,7 @@ void PRadEventViewer::startOnlineMode()
         rStatusLabel->setText(tr("Failed to start Online Mode!"));
         onlineEnAction->setEnabled(true);
         openDataAction->setEnabled(true);
+        openIndexAction->setEnabled(true);
         eventSpin->setEnabled(true);
         return;
     }
@@ -1546,14 +1870,17 @@ void PRadEventViewer::startOnlineMode()
     HyCal->ShowScalers(true);
     Refresh();
 
-    // Start online timer
-    onlineTimer->start(5000);
+    // Start the acquisition thread, the timer only refreshes the display
+    onlineWorker->SetSampleFraction(etSetting->GetSampleFraction());
+    onlineWorker->Start();
+    onlineTimer->start(ONLINE_REFRESH_TIME);
 }
 
 void PRadEventViewer::stopOnlineMode()
 {
-    // Stop timer
+    // Stop timer and the acquisition thread
     onlineTimer->stop();
+    onlineWorker->Stop();
 
     etChannel->ForceClose();
     QMessageBox::information(this,
@@ -1565,6 +1892,7 @@ void PRadEventViewer::stopOnlineMode()
     // Enable buttons
     onlineEnAction->setEnabled(true);
     openDataAction->setEnabled(true);
+    openIndexAction->setEnabled(true);
     onlineDisAction->setEnabled(false);
     eventSpin->setEnabled(true);
 
@@ -1578,33 +1906,43 @@ void PRadEventViewer::stopOnlineMode()
 
 void PRadEventViewer::handleOnlineTimer()
 {
-//   QtConcurrent::run(this, &PRadEventViewer::onlineUpdate, ET_CHUNK_SIZE);
-    onlineUpdate(ET_CHUNK_SIZE);
-}
+    // the acquisition thread stopped because of an error
+    if(!onlineWorker->IsRunning()) {
+        std::cerr << onlineWorker->GetError() << std::endl;
+        stopOnlineMode();
+        return;
+    }
 
-void PRadEventViewer::onlineUpdate(const size_t &max_events)
-{
-    try {
-        size_t num;
+    // show the decoding rate
+    rStatusLabel->setText(tr("Decoding %1 of %2 events/s (%3%)")
+                          .arg(onlineWorker->GetDecodeRate(), 0, 'f', 0)
+                          .arg(onlineWorker->GetEventRate(), 0, 'f', 0)
+                          .arg(onlineWorker->GetCurrentFraction()*100., 0, 'f', 1));
 
-        for(num = 0; etChannel->Read() && num < max_events; ++num)
-        {
-            handler->Decode(etChannel->GetBuffer());
-        }
+    if(!onlineWorker->TakeNewEvents())
+        return;
 
-        if(num) {
-            // always show the front event
+    // take the snapshot of the latest events and histograms
+    {
+        auto lock = onlineWorker->Lock();
+#ifdef RECON_DISPLAY
+        // the front event is reconstructed in background, show the latest one
+        // that is ready instead of reconstructing it here
+        ReconResult latest;
+        if(reconSetting->IsEnabled() && reconWorker->GetLatest(latest))
+            showEvent(latest.event);
+        else
             chooseEvent(0);
-            UpdateHistCanvas();
-            UpdateOnlineInfo();
-            Refresh();
-        }
-
-    } catch(PRadException e) {
-        std::cerr << e.FailureType() << ": "
-                  << e.FailureDesc() << std::endl;
-        return;
+        if(reconSetting->IsEnabled())
+            reconWorker->Request(0);
+#else
+        // always show the front event
+        chooseEvent(0);
+#endif
+        UpdateHistCanvas();
+        UpdateOnlineInfo();
     }
+    Refresh();
 }
 
 void PRadEventViewer::UpdateOnlineInfo()
@@ -1752,3 +2090,26 @@ void PRadEventViewer::restoreHVSetting()
     hvSystem->StartMonitor();
 }
 #endif
+
+#ifdef USE_GL_HEATMAP
+//============================================================================//
+// OpenGL heat map functions                                                  //
+//============================================================================//
+
+void PRadEventViewer::setupHeatMap()
+{
+    // the module geometry is taken once from the scene
+    heatMap = new HyCalHeatMap;
+    heatMap->SetDetector(HyCal);
+}
+
+void PRadEventViewer::switchHeatMap(bool on)
+{
+    if(on) {
+        hycalStack->setCurrentWidget(heatMap);
+        heatMap->UpdateModules();
+    } else {
+        hycalStack->setCurrentWidget(view);
+    }
+}
+#endif
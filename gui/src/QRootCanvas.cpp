@@ -14,8 +14,10 @@
 
 
 QRootCanvas::QRootCanvas(QWidget *parent)
-: QWidget(parent, 0), fCanvas(0)
+: QWidget(parent, 0), fCanvas(0), fNeedResize(false)
 {
+    fInputTimer.start();
+
     // set options needed to properly update the canvas when resizing the widget
     // and to properly handle context menus and mouse move events
 #if QT_VERSION < 0x050000
@@ -39,6 +41,7 @@ QRootCanvas::~QRootCanvas()
 
 void QRootCanvas::mouseMoveEvent(QMouseEvent *e)
 {
+    fInputTimer.restart();
     // Handle mouse move events.
     if(fCanvas) {
         if(e->buttons() & Qt::LeftButton) {
@@ -55,6 +58,7 @@ void QRootCanvas::mouseMoveEvent(QMouseEvent *e)
 
 void QRootCanvas::mousePressEvent(QMouseEvent *e)
 {
+    fInputTimer.restart();
     // Handle mouse button press events.
     if(fCanvas) {
         switch (e->button())
@@ -80,6 +84,7 @@ void QRootCanvas::mousePressEvent(QMouseEvent *e)
 
 void QRootCanvas::mouseReleaseEvent(QMouseEvent *e)
 {
+    fInputTimer.restart();
     // Handle mouse button release events.
     if(fCanvas) {
         switch (e->button())
@@ -104,6 +109,7 @@ void QRootCanvas::mouseReleaseEvent(QMouseEvent *e)
 
 void QRootCanvas::mouseDoubleClickEvent(QMouseEvent *e)
 {
+    fInputTimer.restart();
     // Handle mouse button release events.
     if(fCanvas) {
         switch (e->button())
@@ -128,6 +134,7 @@ void QRootCanvas::resizeEvent(QResizeEvent *e)
     // Handle resize events.
     QWidget::resizeEvent(e);
     fNeedResize = true;
+    fInputTimer.restart();
 }
 
 void QRootCanvas::paintEvent(QPaintEvent *)
@@ -147,6 +154,7 @@ void QRootCanvas::paintEvent(QPaintEvent *)
 
 void QRootCanvas::leaveEvent(QEvent * /*e*/)
 {
+    fInputTimer.restart();
     if(fCanvas) fCanvas->HandleInput(kMouseLeave, 0, 0);
 }
 
@@ -0,0 +1,216 @@
+//============================================================================//
+// Background reconstruction for the event display                            //
+// The requested event and the following ones are reconstructed in a thread,  //
+// so the hits can be shown as soon as an event is chosen                     //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "ReconWorker.h"
+#include "PRadDataHandler.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadCoordSystem.h"
+#include "PRadDetMatch.h"
+#include "PRadException.h"
+#include <iostream>
+
+
+
+ReconWorker::ReconWorker(PRadDataHandler *h, PRadHyCalSystem *hycal, PRadGEMSystem *gem,
+                         PRadCoordSystem *coord, PRadDetMatch *match)
+: handler(h), hycal_sys(hycal), gem_sys(gem), coord_sys(coord), det_match(match),
+  alive(false), request(-1), latest(-1), generation(0)
+{
+    Reset();
+}
+
+ReconWorker::~ReconWorker()
+{
+    Stop();
+}
+
+void ReconWorker::Start()
+{
+    if(thread.joinable())
+        return;
+
+    alive = true;
+    thread = std::thread(&ReconWorker::run, this);
+}
+
+void ReconWorker::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(locker);
+        alive = false;
+    }
+    cv.notify_all();
+
+    if(thread.joinable())
+        thread.join();
+}
+
+// the settings or calibration are changed, previous results are dropped and
+// the systems are copied again
+void ReconWorker::Reset()
+{
+    auto pause = Pause();
+
+    gem_copy.reset(new PRadGEMSystem(*gem_sys));
+    gem_copy->SetAPVThreads(1);
+    context.calib = hycal_sys->TakeCalibSnapshot();
+
+    std::lock_guard<std::mutex> lock(locker);
+    results.clear();
+    latest = -1;
+    ++generation;
+}
+
+// reconstruct the event at index and the ones after it
+void ReconWorker::Request(int index)
+{
+    {
+        std::lock_guard<std::mutex> lock(locker);
+        request = index;
+    }
+    cv.notify_all();
+}
+
+bool ReconWorker::Find(const EventData &event, ReconResult &res)
+const
+{
+    std::lock_guard<std::mutex> lock(locker);
+    for(auto &result : results)
+    {
+        if(result.event.event_number == event.event_number &&
+           result.event.timestamp == event.timestamp) {
+            res = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the result of the last requested event
+bool ReconWorker::GetLatest(ReconResult &res)
+const
+{
+    std::lock_guard<std::mutex> lock(locker);
+    for(auto &result : results)
+    {
+        if(result.event.event_number == latest) {
+            res = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+// reconstruct the event in the calling thread with the systems, it uses their
+// result caches
+void ReconWorker::Reconstruct(const EventData &event, ReconResult &res)
+{
+    res.event = event;
+    hycal_sys->Reconstruct(event);
+    gem_sys->Reconstruct(event);
+
+    res.hycal = hycal_sys->GetDetector()->GetHits();
+    res.clusters = hycal_sys->GetReconstructor()->GetClusters();
+    res.gem1 = gem_sys->GetDetector(PRadDetector::PRadGEM1)->GetHits();
+    res.gem2 = gem_sys->GetDetector(PRadDetector::PRadGEM2)->GetHits();
+    transformHits(res);
+}
+
+// coordinates transform, projection and matching
+void ReconWorker::transformHits(ReconResult &res)
+const
+{
+    coord_sys->Transform(PRadDetector::HyCal, res.hycal.begin(), res.hycal.end());
+    coord_sys->Transform(PRadDetector::PRadGEM1, res.gem1.begin(), res.gem1.end());
+    coord_sys->Transform(PRadDetector::PRadGEM2, res.gem2.begin(), res.gem2.end());
+
+    // project hits to HyCal surface
+    coord_sys->Projection(res.hycal.begin(), res.hycal.end());
+    coord_sys->Projection(res.gem1.begin(), res.gem1.end());
+    coord_sys->Projection(res.gem2.begin(), res.gem2.end());
+
+    res.matched = det_match->Match(res.hycal, res.gem1, res.gem2);
+}
+
+void ReconWorker::run()
+{
+    const PRadHyCalReconstructor *recon = hycal_sys->GetReconstructor();
+    const PRadHyCalDetector *hycal = hycal_sys->GetDetector();
+
+    while(true)
+    {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(locker);
+            cv.wait(lock, [this] () {return !alive || request >= 0;});
+            if(!alive)
+                return;
+            index = request;
+            request = -1;
+        }
+
+        for(int i = index; i < index + RECON_DISPLAY_AHEAD; ++i)
+        {
+            // a new request comes
+            {
+                std::lock_guard<std::mutex> lock(locker);
+                if(!alive || request >= 0)
+                    break;
+            }
+
+            ReconResult res;
+            try {
+                auto data_lock = handler->LockData();
+                if((unsigned int) i >= handler->GetEventCount())
+                    break;
+                res.event = handler->GetEvent(i);
+            } catch(PRadException &e) {
+                std::cerr << e.FailureType() << ": " << e.FailureDesc() << std::endl;
+                break;
+            }
+
+            if(!res.event.is_physics_event())
+                continue;
+
+            // reconstructed before
+            if(Find(res.event, res)) {
+                std::lock_guard<std::mutex> lock(locker);
+                if(i == index)
+                    latest = res.event.event_number;
+                continue;
+            }
+
+            unsigned int gen;
+            {
+                auto pause = Pause();
+                {
+                    std::lock_guard<std::mutex> lock(locker);
+                    gen = generation;
+                }
+                recon->Reconstruct(hycal, res.event, context, res.hycal);
+                res.clusters = context.module_clusters;
+                gem_copy->Reconstruct(res.event);
+                res.gem1 = gem_copy->GetDetector(PRadDetector::PRadGEM1)->GetHits();
+                res.gem2 = gem_copy->GetDetector(PRadDetector::PRadGEM2)->GetHits();
+            }
+            transformHits(res);
+
+            std::lock_guard<std::mutex> lock(locker);
+            // the results are out of date
+            if(gen != generation)
+                break;
+            if(i == index)
+                latest = res.event.event_number;
+            results.emplace_front(std::move(res));
+            if(results.size() > RECON_DISPLAY_EVENTS)
+                results.pop_back();
+        }
+    }
+}
@@ -18,8 +18,10 @@ Spectrum::Spectrum(double w, double h, double l1, double l2)
     gradient = QLinearGradient(QPoint(width/2., height/2.),
                                QPoint(width/2., -height/2.));
     updateGradient();
+    updateScaling();
 }
 
+// the gradient and the color table are made when the type is changed
 void Spectrum::updateGradient()
 {
     double scale;
@@ -28,6 +30,26 @@ void Spectrum::updateGradient()
         scale = (double)i/100;
         gradient.setColorAt(scale, scaleToColor(scale));
     }
+
+    lut.resize(SPECTRUM_LUT_SIZE);
+    for(int i = 0; i < SPECTRUM_LUT_SIZE; ++i)
+        lut[i] = scaleToColor((double)i/(SPECTRUM_LUT_SIZE - 1));
+}
+
+// the mapping from value to scale, it is the same as scaling()
+void Spectrum::updateScaling()
+{
+    double rmin, rmax;
+    if(settings.scale == LogScale) {
+        rmin = log10(std::max(0.1, settings.range_min));
+        rmax = log10(std::max(1.0, settings.range_max));
+    } else {
+        rmin = settings.range_min;
+        rmax = settings.range_max;
+    }
+
+    map_min = rmin;
+    map_factor = (rmax != rmin) ? 1./(rmax - rmin) : 0.;
 }
 
 void Spectrum::SetSpectrumType(const SpectrumType &type)
@@ -46,6 +68,7 @@ void Spectrum::SetSpectrumScale(const SpectrumScale &scale)
         return;
 
     settings.scale = scale;
+    updateScaling();
     emit spectrumChanged();
 }
 
@@ -56,6 +79,7 @@ void Spectrum::SetSpectrumRange(const double &x1, const double &x2)
 
     settings.range_min = x1;
     settings.range_max = x2;
+    updateScaling();
     emit spectrumChanged();
 }
 
@@ -65,6 +89,7 @@ void Spectrum::SetSpectrumRangeMin(double &min)
         return;
 
     settings.range_min = min;
+    updateScaling();
     emit spectrumChanged();
 }
 
@@ -74,16 +99,47 @@ void Spectrum::SetSpectrumRangeMax(double &max)
         return;
 
     settings.range_max = max;
+    updateScaling();
     emit spectrumChanged();
 }
 
-// get color in log scale
+// get color from the table
 QColor Spectrum::GetColor(const double &val)
 {
     if(val < settings.range_min || (settings.range_min == settings.range_max))
         return Qt::white;
     else
-        return scaleToColor(scaling(val));
+        return lut[scaleToIndex(scaling(val))];
+}
+
+// the loops have no branches, so they can be vectorized
+void Spectrum::MapIndices(const double *vals, int *indices, int n)
+const
+{
+    const double rmin = settings.range_min, offset = map_min, factor = map_factor;
+    const double top = SPECTRUM_LUT_SIZE - 1;
+    // all values are out of an empty range
+    const bool empty = (settings.range_min == settings.range_max);
+
+    double scale;
+    if(settings.scale == LogScale) {
+        for(int i = 0; i < n; ++i)
+        {
+            scale = (log10(vals[i]) - offset)*factor;
+            // nan goes to 0
+            scale = (scale > 0.) ? scale : 0.;
+            scale = (scale < 1.) ? scale : 1.;
+            indices[i] = (vals[i] < rmin || empty) ? -1 : (int)(scale*top + 0.5);
+        }
+    } else {
+        for(int i = 0; i < n; ++i)
+        {
+            scale = (vals[i] - offset)*factor;
+            scale = (scale > 0.) ? scale : 0.;
+            scale = (scale < 1.) ? scale : 1.;
+            indices[i] = (vals[i] < rmin || empty) ? -1 : (int)(scale*top + 0.5);
+        }
+    }
 }
 
 double Spectrum::scaling(const double &val)
@@ -107,6 +163,15 @@ double Spectrum::scaling(const double &val)
     return scale;
 }
 
+// the nearest color in the table
+int Spectrum::scaleToIndex(double scale)
+const
+{
+    scale = (scale > 0.) ? scale : 0.;
+    scale = (scale < 1.) ? scale : 1.;
+    return (int)(scale*(SPECTRUM_LUT_SIZE - 1) + 0.5);
+}
+
 // calculte the color
 QColor Spectrum::scaleToColor(const double &scale)
 {
@@ -14,6 +14,7 @@
 #include <fstream>
 #include <iomanip>
 #include <chrono>
+#include <algorithm>
 
 #include "HyCalModule.h"
 
@@ -27,6 +28,8 @@ PRadHVSystem::PRadHVSystem(PRadEventViewer *p)
 PRadHVSystem::~PRadHVSystem()
 {
     Disconnect();
+    for(auto &mon : monitorList)
+        delete mon;
     for(auto &crate : crateList)
         delete crate;
 }
@@ -57,6 +60,10 @@ void PRadHVSystem::AddCrate(const string &name,
     crate_name_map[name] = newCrate;
 
     crateList.push_back(newCrate);
+
+    CrateMonitor *newMonitor = new CrateMonitor(newCrate);
+    monitor_id_map[id] = newMonitor;
+    monitorList.push_back(newMonitor);
 }
 
 void PRadHVSystem::Connect()
@@ -106,58 +113,107 @@ void PRadHVSystem::Disconnect()
     }
 }
 
+// start one polling thread for each crate
 void PRadHVSystem::StartMonitor()
 {
+    if(alive)
+        return;
+
     alive = true;
-    queryThread = thread(&PRadHVSystem::queryLoop, this);
+    for(auto &mon : monitorList)
+        mon->thread = thread(&PRadHVSystem::queryLoop, this, mon);
 }
 
 void PRadHVSystem::StopMonitor()
 {
-    alive = false;
-    if(queryThread.joinable())
-        queryThread.join();
+    {
+        lock_guard<mutex> lk(stop_locker);
+        alive = false;
+    }
+    stop_cv.notify_all();
+
+    for(auto &mon : monitorList)
+    {
+        if(mon->thread.joinable())
+            mon->thread.join();
+    }
 }
 
-void PRadHVSystem::queryLoop()
+// polling loop of a crate, a slow crate does not delay the others
+void PRadHVSystem::queryLoop(CrateMonitor *mon)
 {
     unsigned int loopCount = 0;
+    auto next = chrono::steady_clock::now();
     while(alive)
     {
-        if(!(loopCount%5))
-            ReadVoltage();
-
-        if(!(loopCount%30))
-            CheckStatus();
+        if(!(loopCount%HV_READ_PERIOD)) {
+            sweepCrate(mon, !(loopCount%HV_STATUS_PERIOD));
+            // update the display from the GUI thread
+            QMetaObject::invokeMethod(console, "Refresh", Qt::QueuedConnection);
+        }
 
         ++loopCount;
-        this_thread::sleep_for(chrono::seconds(1));
+        next = max(next + chrono::seconds(HV_QUERY_TICK), chrono::steady_clock::now());
+        unique_lock<mutex> lk(stop_locker);
+        stop_cv.wait_until(lk, next, [this] () {return !alive;});
     }
 }
 
-void PRadHVSystem::ReadVoltage()
+// read all the channels of a crate and publish the values
+void PRadHVSystem::sweepCrate(CrateMonitor *mon, bool check_status)
 {
-    locker.lock();
+    auto start = chrono::steady_clock::now();
+    auto snap = make_shared<Snapshot>();
 
-    for(auto &crate : crateList)
     {
-        crate->ReadVoltage();
+        lock_guard<mutex> lk(mon->locker);
+        // the parameters are read for all channels of a board in one call
+        mon->crate->ReadVoltage();
+        if(check_status)
+            mon->crate->CheckStatus();
+
+        for(auto &board : mon->crate->GetBoardList())
+        {
+            auto &volts = snap->slots[board->GetSlot()];
+            volts.resize(board->GetChannelList().size());
+            for(auto &ch : board->GetChannelList())
+            {
+                if(ch->GetChannel() < volts.size())
+                    volts[ch->GetChannel()] = Voltage(ch->GetVMon(), ch->GetVSet(), ch->IsTurnedOn());
+            }
+        }
+    }
+
+    auto last = atomic_load(&mon->snapshot);
+    snap->sweep_time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    snap->max_sweep_time = max(last->max_sweep_time, snap->sweep_time);
+    snap->sweeps = last->sweeps + 1;
+    atomic_store(&mon->snapshot, shared_ptr<const Snapshot>(snap));
+
+    if(snap->sweep_time > HV_READ_PERIOD*HV_QUERY_TICK*1000.) {
+        cerr << "HV System Warning: Reading crate " << mon->crate->GetName()
+             << " took " << snap->sweep_time << " ms, longer than the polling period."
+             << endl;
+    }
+}
+
+void PRadHVSystem::ReadVoltage()
+{
+    for(auto &mon : monitorList)
+    {
+        sweepCrate(mon, false);
     }
-    locker.unlock();
 
     console->Refresh();
 }
 
 void PRadHVSystem::CheckStatus()
 {
-    locker.lock();
-
-    for(auto &crate : crateList)
+    for(auto &mon : monitorList)
     {
-        crate->CheckStatus();
+        lock_guard<mutex> lk(mon->locker);
+        mon->crate->CheckStatus();
     }
-
-    locker.unlock();
 }
 
 void PRadHVSystem::SaveCurrentSetting(const string &path)
@@ -237,14 +293,16 @@ void PRadHVSystem::SetVoltage(const ChannelAddress &addr, const float &Vset)
         return;
     }
 
+    lock_guard<mutex> lk(getMonitor(addr.crate)->locker);
     channel->SetVoltage(Vset);
 }
 
 void PRadHVSystem::SetPower(const bool &on_off)
 {
-    for(auto crate : crateList)
+    for(auto mon : monitorList)
     {
-        crate->SetPower(on_off);
+        lock_guard<mutex> lk(mon->locker);
+        mon->crate->SetPower(on_off);
     }
 }
 
@@ -261,6 +319,7 @@ void PRadHVSystem::SetPower(const ChannelAddress &addr, const bool &on_off)
         return;
     }
 
+    lock_guard<mutex> lk(getMonitor(addr.crate)->locker);
     channel->SetPower(on_off);
 }
 
@@ -282,6 +341,15 @@ const
     return nullptr;
 }
 
+PRadHVSystem::CrateMonitor *PRadHVSystem::getMonitor(int id)
+const
+{
+    auto it = monitor_id_map.find(id);
+    if(it != monitor_id_map.end())
+        return it->second;
+    return nullptr;
+}
+
 CAEN_Board *PRadHVSystem::GetBoard(const string &n, int slot)
 const
 {
@@ -327,24 +395,28 @@ const
 PRadHVSystem::Voltage PRadHVSystem::GetVoltage(const string &n, int slot, int channel)
 const
 {
-    Voltage volt;
-
-    CAEN_Channel *ch = GetChannel(n, slot, channel);
-
-    if(ch) {
-        volt.ON = ch->IsTurnedOn();
-        volt.Vmon = ch->GetVMon();
-        volt.Vset = ch->GetVSet();
-    }
-
-    return volt;
+    CAEN_Crate *crate = GetCrate(n);
+    if(crate)
+        return GetVoltage(crate->GetID(), slot, channel);
+    return Voltage();
 }
 
+// the values are from the last sweep, or from the crate map if it is not polled
 PRadHVSystem::Voltage PRadHVSystem::GetVoltage(int id, int slot, int channel)
 const
 {
     Voltage volt;
 
+    auto snap = GetSnapshot(id);
+    if(snap) {
+        auto it = snap->slots.find(slot);
+        if(it != snap->slots.end()) {
+            if(channel >= 0 && channel < (int)it->second.size())
+                volt = it->second.at(channel);
+            return volt;
+        }
+    }
+
     CAEN_Channel *ch = GetChannel(id, slot, channel);
 
     if(ch) {
@@ -362,3 +434,11 @@ const
     return GetVoltage(addr.crate, addr.slot, addr.channel);
 }
 
+shared_ptr<const PRadHVSystem::Snapshot> PRadHVSystem::GetSnapshot(int id)
+const
+{
+    CrateMonitor *mon = getMonitor(id);
+    if(mon)
+        return atomic_load(&mon->snapshot);
+    return nullptr;
+}
@@ -6,7 +6,10 @@
 //============================================================================//
 
 #include "online_monitor/ETSettingPanel.h"
+#include "datastruct.h"
 #include <QDialogButtonBox>
+#include <QCheckBox>
+#include <QGridLayout>
 #include <QPushButton>
 #include <QLabel>
 #include <QFormLayout>
@@ -43,10 +46,39 @@ ETSettingPanel::ETSettingPanel(QWidget *parent)
     stationEdit = new QLineEdit(this);
     stationEdit->setText("online monitor");
 
+    // the other events only have their scalers decoded
+    QLabel *sampleLabel = new QLabel("Full Decoding");
+    sampleEdit = new QSpinBox(this);
+    sampleEdit->setRange(1, 100);
+    sampleEdit->setValue(100);
+    sampleEdit->setSuffix("% of events");
+
+    // the events of the other triggers are not sent by the ET system
+    QLabel *triggerLabel = new QLabel("Triggers");
+    QGridLayout *triggerLayout = new QGridLayout();
+    const char *trigger_names[] = {"Lead Glass Sum", "Total Sum", "LMS Led",
+                                   "LMS Alpha Source", "Tagger Master OR", "Scintillator"};
+    for(int trg = PHYS_LeadGlassSum; trg < MAX_Trigger; ++trg)
+    {
+        QCheckBox *box = new QCheckBox(trigger_names[trg - PHYS_LeadGlassSum], this);
+        box->setChecked(true);
+        triggerLayout->addWidget(box, triggerBoxes.size()/2, triggerBoxes.size()%2);
+        triggerBoxes.push_back(box);
+    }
+
+    QLabel *prescaleLabel = new QLabel("Prescale");
+    prescaleEdit = new QSpinBox(this);
+    prescaleEdit->setRange(1, 10000);
+    prescaleEdit->setValue(1);
+    prescaleEdit->setPrefix("1 of ");
+
     dialogLayout->addRow(warnLabel);
     dialogLayout->addRow(ipLabel, hostLayout);
     dialogLayout->addRow(fileLabel, fileEdit);
     dialogLayout->addRow(stationLabel, stationEdit);
+    dialogLayout->addRow(sampleLabel, sampleEdit);
+    dialogLayout->addRow(triggerLabel, triggerLayout);
+    dialogLayout->addRow(prescaleLabel, prescaleEdit);
 
     // Add standard buttons to layout
     QDialogButtonBox *buttonBox = new QDialogButtonBox(this);
@@ -79,3 +111,32 @@ QString ETSettingPanel::GetStationName()
 {
     return stationEdit->text();
 }
+
+double ETSettingPanel::GetSampleFraction()
+{
+    return sampleEdit->value()/100.;
+}
+
+uint32_t ETSettingPanel::GetTriggerMask()
+{
+    uint32_t mask = 0;
+    bool all = true;
+    for(int i = 0; i < triggerBoxes.size(); ++i)
+    {
+        if(triggerBoxes[i]->isChecked())
+            mask |= 1u << (PHYS_LeadGlassSum + i);
+        else
+            all = false;
+    }
+
+    // no selection is needed for all the triggers, and without any trigger
+    // only the events not from TI are kept
+    if(all)
+        return 0;
+    return mask ? mask : (1u << NotFromTI);
+}
+
+int ETSettingPanel::GetPrescale()
+{
+    return prescaleEdit->value();
+}
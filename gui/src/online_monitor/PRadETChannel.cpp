@@ -8,6 +8,7 @@
 #include "online_monitor/PRadETChannel.h"
 #include "online_monitor/PRadETStation.h"
 #include <iostream>
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
@@ -18,8 +19,61 @@
 
 using namespace std;
 
+// check the status from getting events
+static void check_get_status(int status) throw(PRadException)
+{
+    switch(status)
+    {
+    case ET_OK:
+    case ET_ERROR_EMPTY:
+        break;
+    case ET_ERROR_DEAD:
+        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: et is dead!"));
+    case ET_ERROR_TIMEOUT:
+        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: got timeout!!"));
+    case ET_ERROR_BUSY:
+        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: station is busy!"));
+    case ET_ERROR_WAKEUP:
+        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: someone told me to wake up."));
+    default:
+        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: unkown error!"));
+    }
+}
+
+// check the status from putting events back
+static void check_put_status(int status) throw(PRadException)
+{
+    switch(status)
+    {
+    case ET_OK:
+        break;
+    case ET_ERROR_DEAD:
+        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: et is dead!"));
+    default:
+        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: unkown error!"));
+    }
+}
+
+// the event data without the block header
+static const uint32_t *event_data(et_event *ev, size_t &words)
+{
+    void *data;
+    size_t length;
+    et_event_getdata(ev, &data);
+    et_event_getlength(ev, &length);
+    words = length/4; // from byte to int32 words
+
+    const uint32_t *data_buffer = (const uint32_t*) data;
+    // check if it is a block header
+    if(words >= 8 && data_buffer[7] == 0xc0da0100) {
+        data_buffer += 8;
+        words -= 8;
+    }
+    return data_buffer;
+}
+
 PRadETChannel::PRadETChannel(size_t size)
-: curr_stat(nullptr), et_id(nullptr), bufferSize(size)
+: curr_stat(nullptr), et_id(nullptr), bufferSize(size), etEvents(ET_CHUNK_SIZE), nevents(0)
 {
     buffer = new uint32_t[bufferSize];
 }
@@ -41,6 +95,8 @@ void PRadETChannel::ForceClose()
         et_forcedclose(et_id);
         et_id = nullptr;
     }
+    // the held events are released with the connection
+    nevents = 0;
 }
 
 // Open ET
@@ -141,63 +197,68 @@ bool PRadETChannel::Read() throw(PRadException)
 
     // get the event
     int status = et_event_get(et_id, att, &etEvent, ET_ASYNC, nullptr);
-
-    switch(status)
-    {
-    case ET_OK:
-        break;
-    case ET_ERROR_EMPTY:
+    check_get_status(status);
+    if(status == ET_ERROR_EMPTY)
         return false;
-    case ET_ERROR_DEAD:
-        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: et is dead!"));
-     case ET_ERROR_TIMEOUT:
-        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: got timeout!!"));
-     case ET_ERROR_BUSY:
-        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: station is busy!"));
-     case ET_ERROR_WAKEUP:
-        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: someone told me to wake up."));
-     default:
-        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: unkown error!"));
-     }
 
     // copy the data buffer
     copyEvent();
 
     // put back the event
-    status = et_event_put(et_id, att, etEvent);
-
-    switch(status)
-    {
-    case ET_OK:
-        break;
-    case ET_ERROR_DEAD:
-        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: et is dead!"));
-    default:
-        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: unkown error!"));
-    }
+    check_put_status(et_event_put(et_id, att, etEvent));
 
     return true;
 }
 
-void PRadETChannel::copyEvent()
+// read up to max_events from ET station, return the number of events
+// the events from the last read are put back first if they are still held
+size_t PRadETChannel::ReadEvents(size_t max_events) throw(PRadException)
 {
-    void *data;
-    et_event_getdata(etEvent, &data);
-    et_event_getlength(etEvent, &bufferSize);
-    bufferSize /= 4; // from byte to int32 words
+    PutEvents();
 
-    uint32_t *data_buffer = (uint32_t*) data;
-    size_t index = 0;
-    // check if it is a block header
-    if(bufferSize >= 8 && data_buffer[7] == 0xc0da0100) {
-        index += 8;
-        bufferSize -= 8;
-    }
+    // check if et is opened or alive
+    if(et_id == nullptr || !et_alive(et_id))
+        throw(PRadException(PRadException::ET_READ_ERROR,"et_client: et is not opened or dead!"));
 
-    for(size_t i = 0; i < bufferSize; ++i)
-    {
-        buffer[i] = data_buffer[index+i];
+    if(max_events > etEvents.size())
+        max_events = etEvents.size();
+
+    int nread = 0;
+    int status = et_events_get(et_id, curr_stat->GetAttachID(), &etEvents[0], ET_ASYNC,
+                               nullptr, max_events, &nread);
+    check_get_status(status);
+
+    nevents = (status == ET_OK) ? nread : 0;
+    return nevents;
+}
+
+// put back the events from the last bulk read
+void PRadETChannel::PutEvents() throw(PRadException)
+{
+    if(nevents == 0)
+        return;
+
+    int num = nevents;
+    nevents = 0;
+    check_put_status(et_events_put(et_id, curr_stat->GetAttachID(), &etEvents[0], num));
+}
+
+// data of the i-th event from the last bulk read, it is valid until PutEvents
+const uint32_t *PRadETChannel::GetEventData(size_t i, size_t &words)
+const
+{
+    if(i >= nevents) {
+        words = 0;
+        return nullptr;
     }
+
+    return event_data(etEvents[i], words);
+}
+
+void PRadETChannel::copyEvent()
+{
+    const uint32_t *data_buffer = event_data(etEvent, bufferSize);
+    std::copy(data_buffer, data_buffer + bufferSize, buffer);
 }
 
 
@@ -7,6 +7,8 @@
 
 #include "online_monitor/PRadETStation.h"
 #include "online_monitor/PRadETChannel.h"
+#include "datastruct.h"
+#include <algorithm>
 
 PRadETStation::PRadETStation(PRadETChannel *p, std::string n, int mode)
 : et_system(p), name(n)
@@ -71,6 +73,31 @@ void PRadETStation::PreSetting(int mode) throw(PRadException)
     }
 }
 
+// the events not selected stay in the ET system, so the monitor only receives
+// the events it decodes
+void PRadETStation::SetSelection(uint32_t trigger_mask, int prescale, bool blocking)
+{
+    config.SetBlock(blocking ? ET_STATION_BLOCKING : ET_STATION_NONBLOCKING);
+    config.SetPrescale(std::max(prescale, 1));
+
+    if(!trigger_mask) {
+        config.SetSelect(ET_STATION_SELECT_ALL);
+        return;
+    }
+
+    // -1 means the word is not compared
+    int selections[ET_STATION_SELECT_INTS];
+    for(auto &word : selections)
+        word = -1;
+
+    // epics events have no trigger bits
+    selections[ET_SELECT_TYPE_WORD] = EPICS_Info;
+    selections[ET_SELECT_TRIGGER_WORD] = (int)trigger_mask;
+
+    config.SetSelect(ET_STATION_SELECT_MATCH);
+    config.SetSelectWords(selections);
+}
+
 // Create station
 void PRadETStation::Create() throw(PRadException)
 {
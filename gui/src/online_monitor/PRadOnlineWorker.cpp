@@ -0,0 +1,159 @@
+//============================================================================//
+// Acquisition thread for the online mode                                     //
+// The ET events are read and decoded in chunks in a dedicated thread, so the //
+// GUI is not blocked by the decoding and only refreshes the latest snapshot  //
+// Only a fraction of the events are fully decoded at high rates, the others  //
+// only have their trigger and scaler information decoded                     //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "online_monitor/PRadOnlineWorker.h"
+#include "online_monitor/PRadETChannel.h"
+#include "PRadDataHandler.h"
+#include "PRadException.h"
+#include <chrono>
+#include <algorithm>
+
+
+
+PRadOnlineWorker::PRadOnlineWorker(PRadETChannel *ch, PRadDataHandler *h)
+: channel(ch), handler(h), running(false), stop_flag(false), new_events(0), decoded(0),
+  sample_fraction(1.), current_fraction(1.), event_rate(0.), decode_rate(0.)
+{
+    // place holder
+}
+
+PRadOnlineWorker::~PRadOnlineWorker()
+{
+    Stop();
+}
+
+// start the acquisition thread
+void PRadOnlineWorker::Start()
+{
+    Stop();
+
+    {
+        std::lock_guard<std::mutex> lock(err_locker);
+        error.clear();
+    }
+    new_events = 0;
+    decoded = 0;
+    current_fraction = sample_fraction.load();
+    event_rate = 0.;
+    decode_rate = 0.;
+    stop_flag = false;
+    running = true;
+    thread = std::thread(&PRadOnlineWorker::run, this);
+}
+
+// stop the acquisition thread, it returns after the current chunk is done
+void PRadOnlineWorker::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(wait_locker);
+        stop_flag = true;
+    }
+    wait_cv.notify_all();
+
+    if(thread.joinable())
+        thread.join();
+    running = false;
+}
+
+// set the fraction of the events to be fully decoded
+void PRadOnlineWorker::SetSampleFraction(double f)
+{
+    f = std::min(1., std::max(ONLINE_MIN_FRACTION, f));
+    sample_fraction = f;
+    current_fraction = std::min(current_fraction.load(), f);
+}
+
+std::string PRadOnlineWorker::GetError()
+{
+    std::lock_guard<std::mutex> lock(err_locker);
+    return error;
+}
+
+// the loop of the acquisition thread
+void PRadOnlineWorker::run()
+{
+    typedef std::chrono::steady_clock clock;
+    auto window_start = clock::now();
+    uint64_t window_events = 0, window_decoded = 0;
+    // the events are fully decoded when the credit reaches one
+    double credit = 0.;
+
+    while(!stop_flag)
+    {
+        size_t nread = 0, nfull = 0;
+
+        try {
+            // the handler is only locked for one chunk, so the GUI can take
+            // the snapshot between the chunks
+            auto lock = Lock();
+            nread = channel->ReadEvents(ET_CHUNK_SIZE);
+
+            double fraction = current_fraction;
+            size_t words;
+            for(size_t i = 0; i < nread; ++i)
+            {
+                credit += fraction;
+                if(credit >= 1.) {
+                    credit -= 1.;
+                    handler->Decode(channel->GetEventData(i, words));
+                    ++nfull;
+                } else {
+                    handler->DecodeScalers(channel->GetEventData(i, words));
+                }
+            }
+
+            channel->PutEvents();
+        } catch(PRadException &e) {
+            std::lock_guard<std::mutex> lock(err_locker);
+            error = e.FailureType() + ": " + e.FailureDesc();
+            break;
+        }
+
+        // a full chunk means there are more events waiting in ET
+        updateFraction(nread == ET_CHUNK_SIZE);
+
+        window_events += nread;
+        window_decoded += nfull;
+        auto now = clock::now();
+        double msec = std::chrono::duration<double, std::milli>(now - window_start).count();
+        if(msec >= ONLINE_RATE_WINDOW) {
+            event_rate = window_events*1000./msec;
+            decode_rate = window_decoded*1000./msec;
+            window_events = 0;
+            window_decoded = 0;
+            window_start = now;
+        }
+
+        if(nread) {
+            decoded += nfull;
+            new_events += nread;
+            continue;
+        }
+
+        // no new events, wait for a while
+        std::unique_lock<std::mutex> lock(wait_locker);
+        wait_cv.wait_for(lock, std::chrono::milliseconds(ONLINE_IDLE_TIME),
+                         [this] () {return stop_flag.load();});
+    }
+
+    running = false;
+}
+
+// back-pressure on the full decoding
+void PRadOnlineWorker::updateFraction(bool backlog)
+{
+    double fraction = current_fraction;
+    if(backlog)
+        fraction = std::max(ONLINE_MIN_FRACTION, fraction*ONLINE_FRACTION_FACTOR);
+    else
+        fraction = std::min(sample_fraction.load(), fraction + ONLINE_FRACTION_STEP);
+    current_fraction = fraction;
+}
@@ -4,6 +4,7 @@
 #include <cmath>
 #include <vector>
 #include <cstddef>
+#include <algorithm>
 
 // limit of bins for simpson integration by precision
 #define MAX_SIMPSON_BINS 50000
@@ -21,9 +22,16 @@ namespace cana
         weight_point(double xi, double wi) : x(xi), w(wi) {}
     };
     struct legendre_nodes { int order; std::vector<weight_point> weights; };
+    // all the abscissas and weights in [-1, 1] for the batch quadrature
+    struct legendre_rule { int order; std::vector<double> x, w; };
 
     // legendre polynomial calculation to get the weight table
     legendre_nodes calc_legendre_nodes(int n, double prec = 1e-10);
+    legendre_rule calc_legendre_rule(const legendre_nodes &ln);
+    // the nodes and rule of the order are calculated once with the default
+    // precision and cached, the references are valid for the whole program
+    const legendre_nodes &get_legendre_nodes(int n);
+    const legendre_rule &get_legendre_rule(int n);
     // gauss-legendre quadrature
     template<typename F, typename... Args>
     double gauss_quad(const legendre_nodes &ln, F &&f, double a, double b, Args&&... args)
@@ -61,6 +69,34 @@ namespace cana
         return gauss_quad(ln, fn, a, b, args...);
     }
 
+    // gauss-legendre quadrature with a batch integrand, the range is divided
+    // into steps and all the abscissas are passed in one call
+    // f(const double *x, double *y, size_t n) should fill y[i] = f(x[i])
+    template<typename F>
+    double gauss_quad_batch(const legendre_rule &lr, F &&f, double a, double b, int steps = 1)
+    {
+        size_t np = lr.x.size();
+        if(lr.order < 2 || steps < 1) return 0.;
+
+        // convert every step to [-1, 1]
+        double A = (b - a)/2./steps;
+        std::vector<double> xs(np*steps), ys(np*steps);
+        for(int k = 0; k < steps; ++k)
+        {
+            double B = a + (2*k + 1)*A;
+            for(size_t i = 0; i < np; ++i)
+                xs[k*np + i] = B + A*lr.x[i];
+        }
+
+        f(xs.data(), ys.data(), xs.size());
+
+        double s = 0.;
+        for(size_t i = 0; i < xs.size(); ++i)
+            s += lr.w[i%np]*ys[i];
+
+        return A*s;
+    }
+
 
     // simpson integration
     template<typename F, typename... Args>
@@ -137,6 +173,118 @@ namespace cana
 
         return simpson_prec_helper(fn, a, f_a, b, f_b, prec, count, args...);
     }
+
+    // result of the adaptive integration
+    struct integrate_result
+    {
+        double value, error;    // integral and its estimated absolute error
+        int count;              // number of function evaluations
+        bool converged;
+
+        integrate_result() : value(0.), error(0.), count(0), converged(false) {}
+    };
+
+    // an interval of the adaptive simpson integration, the function values at
+    // the ends, quarters and center are kept for the subdivision
+    struct simpson_interval
+    {
+        double a, b, f[5];
+        double value, error;
+
+        bool operator <(const simpson_interval &rhs) const {return error < rhs.error;}
+    };
+
+    // intervals of the adaptive integration, it can be reused by the calls
+    // from the same thread to avoid the allocations
+    struct simpson_workspace
+    {
+        std::vector<simpson_interval> intervals;
+    };
+
+    // simpson estimate of the interval from the 5 points, the error is from
+    // the difference between one and two simpson bins
+    inline void simpson_estimate(simpson_interval &itv)
+    {
+        double h = (itv.b - itv.a)/12.;
+        double s1 = 2.*h*(itv.f[0] + 4.*itv.f[2] + itv.f[4]);
+        double s2 = h*(itv.f[0] + 4.*itv.f[1] + 2.*itv.f[2] + 4.*itv.f[3] + itv.f[4]);
+        itv.value = s2 + (s2 - s1)/15.;
+        itv.error = std::abs(s2 - s1)/15.;
+    }
+
+    // iterative adaptive simpson integration, the interval with the largest
+    // error is always divided first, until the total error is below prec
+    // relative to the integral, or MAX_SIMPSON_BINS evaluations are reached
+    // every division reuses the 3 points of the interval and evaluates 4 more
+    template<typename F, typename... Args>
+    integrate_result simpson_adaptive(F &&f, double a, double b, double prec,
+                                      simpson_workspace &ws, Args&&... args)
+    {
+        integrate_result res;
+        auto &heap = ws.intervals;
+        heap.clear();
+
+        simpson_interval itv;
+        itv.a = a, itv.b = b;
+        for(int i = 0; i < 5; ++i)
+            itv.f[i] = f(a + (b - a)*i/4., args...);
+        res.count = 5;
+        simpson_estimate(itv);
+        heap.push_back(itv);
+
+        // intervals that are too small to be divided
+        double fixed_value = 0., fixed_error = 0.;
+        double value = itv.value, error = itv.error;
+
+        while(!heap.empty() && error > prec*std::abs(value) &&
+              res.count + 4 <= MAX_SIMPSON_BINS)
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            simpson_interval parent = heap.back();
+            heap.pop_back();
+            value -= parent.value;
+            error -= parent.error;
+
+            double c = (parent.a + parent.b)/2.;
+            if(std::abs(parent.a/c - 1.) <= MIN_SIMPSON_SIZE) {
+                fixed_value += parent.value;
+                fixed_error += parent.error;
+                continue;
+            }
+
+            simpson_interval left, right;
+            left.a = parent.a, left.b = c;
+            right.a = c, right.b = parent.b;
+            left.f[0] = parent.f[0], left.f[2] = parent.f[1], left.f[4] = parent.f[2];
+            right.f[0] = parent.f[2], right.f[2] = parent.f[3], right.f[4] = parent.f[4];
+            left.f[1] = f((3.*left.a + left.b)/4., args...);
+            left.f[3] = f((left.a + 3.*left.b)/4., args...);
+            right.f[1] = f((3.*right.a + right.b)/4., args...);
+            right.f[3] = f((right.a + 3.*right.b)/4., args...);
+            res.count += 4;
+
+            for(auto &child : {left, right})
+            {
+                heap.push_back(child);
+                simpson_estimate(heap.back());
+                value += heap.back().value;
+                error += heap.back().error;
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+
+        // sum again to remove the accumulated rounding errors
+        res.value = fixed_value;
+        res.error = fixed_error;
+        for(auto &it : heap)
+        {
+            res.value += it.value;
+            res.error += it.error;
+        }
+        res.converged = (res.error <= prec*std::abs(res.value));
+        return res;
+    }
+
 } // namespace cana
 
 #endif // CANA_INTEGRATE_H
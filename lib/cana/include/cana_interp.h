@@ -4,6 +4,7 @@
 #include "cana_utils.h"
 #include <cmath>
 #include <vector>
+#include <cstddef>
 
 namespace cana
 {
@@ -165,6 +166,72 @@ namespace cana
         return res;
     }
 
+    //
+    // batch interpolations on regular grids, the queries outside the grid
+    // are clamped to its edges
+    //
+    // linear interpolation of m points xq on the grid of n values at
+    // x0 + i*dx, n should be at least 1
+    template<typename T>
+    inline void interp_linear_grid(const T *grid, size_t n, T x0, T dx,
+                                   const T *xq, T *out, size_t m)
+    {
+        if(!n) return;
+
+        T umax = T(n - 1);
+        int last = (n > 1) ? int(n - 2) : 0, step = (n > 1) ? 1 : 0;
+        for(size_t i = 0; i < m; ++i)
+        {
+            T u = (xq[i] - x0)/dx;
+            u = (u > T(0)) ? u : T(0);
+            u = (u < umax) ? u : umax;
+            int k = int(u);
+            k = (k < last) ? k : last;
+            T t = u - T(k);
+            T y1 = grid[k], y2 = grid[k + step];
+            out[i] = y1 + t*(y2 - y1);
+        }
+    }
+
+    // bilinear interpolation of m points (xq, yq) on the grid of nx*ny values
+    // at (x0 + i*dx, y0 + j*dy), stored in rows as grid[i*ny + j]
+    template<typename T>
+    inline void interp_bilinear_grid(const T *grid, size_t nx, size_t ny,
+                                     T x0, T dx, T y0, T dy,
+                                     const T *xq, const T *yq, T *out, size_t m)
+    {
+        if(!nx || !ny) return;
+
+        T umax = T(nx - 1), vmax = T(ny - 1);
+        int lastx = (nx > 1) ? int(nx - 2) : 0, lasty = (ny > 1) ? int(ny - 2) : 0;
+        int stepx = (nx > 1) ? int(ny) : 0, stepy = (ny > 1) ? 1 : 0;
+        for(size_t i = 0; i < m; ++i)
+        {
+            T u = (xq[i] - x0)/dx, v = (yq[i] - y0)/dy;
+            u = (u > T(0)) ? u : T(0);
+            u = (u < umax) ? u : umax;
+            v = (v > T(0)) ? v : T(0);
+            v = (v < vmax) ? v : vmax;
+            int kx = int(u), ky = int(v);
+            kx = (kx < lastx) ? kx : lastx;
+            ky = (ky < lasty) ? ky : lasty;
+            T tx = u - T(kx), ty = v - T(ky);
+
+            const T *g = grid + kx*int(ny) + ky;
+            T a = g[0] + ty*(g[stepy] - g[0]);
+            T b = g[stepx] + ty*(g[stepx + stepy] - g[stepx]);
+            out[i] = a + tx*(b - a);
+        }
+    }
+
+    // the float versions are vectorized (AVX2) if the cpu supports it, the
+    // results are identical to the template versions
+    void interp_linear_grid(const float *grid, size_t n, float x0, float dx,
+                            const float *xq, float *out, size_t m);
+    void interp_bilinear_grid(const float *grid, size_t nx, size_t ny,
+                              float x0, float dx, float y0, float dy,
+                              const float *xq, const float *yq, float *out, size_t m);
+
 } // namespace cana
 
 #endif // CANA_INTERP_H
@@ -4,6 +4,9 @@
 #include <random>
 #include <functional>
 #include <iostream>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
 #include "cana_interp.h"
 
 namespace cana
@@ -20,6 +23,194 @@ namespace cana
         return re;
     }
 
+    // xoshiro256++ engine by D. Blackman and S. Vigna, with a period of 2^256 - 1
+    // jump() advances it by 2^128 steps, so the copies of an engine jumped
+    // different times are independent streams for parallel sampling
+    // it returns the upper 32 bits, the same range as std::mt19937
+    class xoshiro256
+    {
+    public:
+        typedef uint32_t result_type;
+
+        explicit xoshiro256(uint64_t seed = 0) {Seed(seed);}
+
+        static constexpr result_type min() {return 0;}
+        static constexpr result_type max() {return UINT32_MAX;}
+
+        // the state is filled by splitmix64 from the seed
+        void Seed(uint64_t seed)
+        {
+            for(auto &st : s)
+            {
+                uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+                z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+                st = z ^ (z >> 31);
+            }
+        }
+
+        result_type operator() () {return next() >> 32;}
+
+        void jump()
+        {
+            static const uint64_t jump_poly[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                                 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+
+            uint64_t t[4] = {0, 0, 0, 0};
+            for(auto poly : jump_poly)
+            {
+                for(int b = 0; b < 64; ++b)
+                {
+                    if(poly & (1ULL << b)) {
+                        for(int i = 0; i < 4; ++i)
+                            t[i] ^= s[i];
+                    }
+                    next();
+                }
+            }
+            for(int i = 0; i < 4; ++i)
+                s[i] = t[i];
+        }
+
+    private:
+        static uint64_t rotl(uint64_t x, int k) {return (x << k) | (x >> (64 - k));}
+
+        uint64_t next()
+        {
+            uint64_t res = rotl(s[0] + s[3], 23) + s[0];
+            uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+            return res;
+        }
+
+    private:
+        uint64_t s[4];
+    };
+
+    // Philox4x32-10 counter-based engine by J. Salmon et al. (Random123)
+    // the output is a bijection of the counter under the key from the seed, the
+    // upper 64 bits of the counter is the stream id and the lower 64 bits is
+    // the position in the stream, so every stream can be started directly
+    // without stepping through the others
+    class philox4x32
+    {
+    public:
+        typedef uint32_t result_type;
+
+        explicit philox4x32(uint64_t seed = 0, uint64_t stream = 0) {Seed(seed, stream);}
+
+        static constexpr result_type min() {return 0;}
+        static constexpr result_type max() {return UINT32_MAX;}
+
+        void Seed(uint64_t seed, uint64_t stream = 0)
+        {
+            key[0] = seed & 0xffffffff;
+            key[1] = seed >> 32;
+            SetStream(stream);
+        }
+
+        // select the stream and go to its beginning
+        void SetStream(uint64_t stream)
+        {
+            ctr[2] = stream & 0xffffffff;
+            ctr[3] = stream >> 32;
+            SetPosition(0);
+        }
+
+        // go to the n-th block of 4 outputs in the current stream
+        void SetPosition(uint64_t n)
+        {
+            ctr[0] = n & 0xffffffff;
+            ctr[1] = n >> 32;
+            index = 4;
+        }
+
+        uint64_t GetStream() const {return ((uint64_t)ctr[3] << 32) | ctr[2];}
+
+        result_type operator() ()
+        {
+            if(index >= 4) {
+                generate(ctr, key, out);
+                increment();
+                index = 0;
+            }
+            return out[index++];
+        }
+
+        // skip n outputs
+        void discard(unsigned long long n)
+        {
+            for(; n && index < 4; --n)
+                ++index;
+            uint64_t pos = (((uint64_t)ctr[1] << 32) | ctr[0]) + n/4;
+            SetPosition(pos);
+            for(n %= 4; n; --n)
+                operator()();
+        }
+
+        // fill the array with uniform numbers in [0, 1), the same sequence as
+        // rand_gen<double, philox4x32> from this engine
+        void fill(double *vals, size_t n)
+        {
+            const double divisor = 4294967296.;
+            size_t i = 0;
+            // the rest of the current block
+            for(; i < n && index < 4; ++i)
+                vals[i] = out[index++]/divisor;
+
+            // whole blocks, the counters are independent of each other
+            uint32_t c[4] = {ctr[0], ctr[1], ctr[2], ctr[3]};
+            for(; i + 4 <= n; i += 4)
+            {
+                uint32_t res[4];
+                generate(c, key, res);
+                for(int k = 0; k < 4; ++k)
+                    vals[i + k] = res[k]/divisor;
+                if(!++c[0])
+                    ++c[1];
+            }
+            ctr[0] = c[0], ctr[1] = c[1];
+
+            for(; i < n; ++i)
+                vals[i] = operator()()/divisor;
+        }
+
+    private:
+        void increment()
+        {
+            if(!++ctr[0])
+                ++ctr[1];
+        }
+
+        static void generate(const uint32_t *c, const uint32_t *k, uint32_t *res)
+        {
+            const uint64_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+            const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+            uint32_t x0 = c[0], x1 = c[1], x2 = c[2], x3 = c[3];
+            uint32_t k0 = k[0], k1 = k[1];
+            for(int r = 0; r < 10; ++r)
+            {
+                uint64_t p0 = M0*x0, p1 = M1*x2;
+                uint32_t y0 = (p1 >> 32) ^ x1 ^ k0, y2 = (p0 >> 32) ^ x3 ^ k1;
+                x1 = (uint32_t) p1;
+                x3 = (uint32_t) p0;
+                x0 = y0, x2 = y2;
+                k0 += W0, k1 += W1;
+            }
+            res[0] = x0, res[1] = x1, res[2] = x2, res[3] = x3;
+        }
+
+    private:
+        uint32_t ctr[4], key[2], out[4];
+        int index;
+    };
+
     // random number generator
     template<typename T = double, class Engine = std::mt19937>
     class rand_gen
@@ -27,7 +218,12 @@ namespace cana
     public:
         // constructor
         rand_gen()
-        : engine(seeded_random_engine<Engine>())
+        : rand_gen(seeded_random_engine<Engine>())
+        {}
+
+        // use the engine as it is, for reproducible streams
+        explicit rand_gen(const Engine &e)
+        : engine(e)
         {
             typename Engine::result_type range = engine.max() - engine.min();
             divisor = static_cast<T>(range) + 1;
@@ -51,6 +247,13 @@ namespace cana
             return static_cast<T>(engine() - engine.min())/divisor*(max - min) + min;
         }
 
+        // fill the array with random numbers in (0, 1)
+        void fill(T *vals, size_t n)
+        {
+            for(size_t i = 0; i < n; ++i)
+                vals[i] = operator()();
+        }
+
     private:
         Engine engine;
         T divisor;
@@ -77,7 +280,7 @@ namespace cana
     template<class RdmIt, typename T>
     inline T uni2dist(RdmIt begin, RdmIt end, T val)
     {
-        auto itv = cana::binary_search_interval(begin, end, val);
+        auto itv = cana::fast_binary_search_interval(begin, end, val);
 
         // should not happen
         if(itv.first == end || itv.second == end)
@@ -94,6 +297,145 @@ namespace cana
                                        val);
         }
     }
+
+    // Walker's alias table by Vose's method, a bin is sampled by its weight
+    // with one uniform random number in O(1)
+    class alias_table
+    {
+    public:
+        alias_table() {}
+
+        template<class Iter>
+        alias_table(Iter beg, Iter end) {build(beg, end);}
+
+        // build the table from the weights of the bins
+        template<class Iter>
+        void build(Iter beg, Iter end)
+        {
+            std::vector<double> weights(beg, end);
+            size_t n = weights.size();
+            prob.assign(n, 1.);
+            alias.resize(n);
+
+            double sum = 0.;
+            for(auto &w : weights)
+                sum += w;
+            if(n == 0 || sum <= 0.)
+                return;
+
+            std::vector<size_t> small, large;
+            for(size_t i = 0; i < n; ++i)
+            {
+                alias[i] = i;
+                weights[i] *= n/sum;
+                if(weights[i] < 1.)
+                    small.push_back(i);
+                else
+                    large.push_back(i);
+            }
+
+            while(!small.empty() && !large.empty())
+            {
+                size_t s = small.back(), l = large.back();
+                small.pop_back();
+                prob[s] = weights[s];
+                alias[s] = l;
+                weights[l] -= 1. - weights[s];
+                if(weights[l] < 1.) {
+                    large.pop_back();
+                    small.push_back(l);
+                }
+            }
+            // the rest are 1 up to the rounding errors
+            for(auto i : small)
+                prob[i] = 1.;
+        }
+
+        // u is uniform in [0, 1), returns the sampled bin
+        // frac is a uniform random number in [0, 1) reused from u
+        size_t sample(double u, double &frac) const
+        {
+            double x = u*prob.size();
+            size_t i = std::min<size_t>(x, prob.size() - 1);
+            double r = x - i;
+            if(r < prob[i]) {
+                frac = r/prob[i];
+                return i;
+            }
+            frac = (r - prob[i])/(1. - prob[i]);
+            return alias[i];
+        }
+
+        size_t size() const {return prob.size();}
+        bool empty() const {return prob.empty();}
+
+    private:
+        std::vector<double> prob;
+        std::vector<size_t> alias;
+    };
+
+    // guide table of a val-cdf distribution, it gives the inverse cdf in
+    // expected O(1) without binary search, and keeps the order of the input
+    // so the quantiles of different distributions can be interpolated
+    class guide_table
+    {
+    public:
+        guide_table() : cdf_min(0.), cdf_max(0.) {}
+
+        template<class RdmIt>
+        guide_table(RdmIt beg, RdmIt end) {build(beg, end);}
+
+        // the cdf must be in ascending order, one guide for one bin
+        template<class RdmIt>
+        void build(RdmIt beg, RdmIt end)
+        {
+            size_t n = end - beg;
+            guide.clear();
+            cdf_min = cdf_max = 0.;
+            if(n < 2)
+                return;
+
+            cdf_min = beg->cdf;
+            cdf_max = (end - 1)->cdf;
+            guide.resize(n - 1);
+
+            // the last point at or below the lower edge of the guide
+            size_t i = 0;
+            for(size_t k = 0; k < guide.size(); ++k)
+            {
+                double target = cdf_min + (cdf_max - cdf_min)*k/guide.size();
+                while(i + 2 < n && beg[i + 1].cdf <= target)
+                    ++i;
+                guide[k] = i;
+            }
+        }
+
+        // value at the cdf, the range is the same as the input distribution
+        template<class RdmIt>
+        double inverse(RdmIt beg, double cdf) const
+        {
+            if(guide.empty())
+                return beg->val;
+
+            double x = (cdf - cdf_min)/(cdf_max - cdf_min)*guide.size();
+            size_t k = (x > 0.) ? std::min<size_t>(x, guide.size() - 1) : 0;
+            size_t i = guide[k];
+            while(i < guide.size() - 1 && beg[i + 1].cdf < cdf)
+                ++i;
+
+            const auto &p1 = beg[i], &p2 = beg[i + 1];
+            if(p2.cdf == p1.cdf)
+                return p1.val;
+            return p1.val + (p2.val - p1.val)*(cdf - p1.cdf)/(p2.cdf - p1.cdf);
+        }
+
+        bool empty() const {return guide.empty();}
+
+    private:
+        std::vector<size_t> guide;
+        double cdf_min, cdf_max;
+    };
+
 } // namespace cana
 
 #endif // CANA_RANDOM_H
@@ -5,6 +5,15 @@
 #include <utility>
 #include <cmath>
 #include <algorithm>
+#include <vector>
+#include <cstddef>
+
+// hint to load the memory that will be compared soon
+#if defined(__GNUC__)
+#define CANA_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define CANA_PREFETCH(addr)
+#endif
 
 namespace cana
 {
@@ -310,6 +319,181 @@ namespace cana
         }
     }
 
+    // branchless lower bound, the first element that is not less than val
+    // the loop has a fixed number of steps and no unpredictable branch, the
+    // two possible elements of the next step are prefetched
+    template<class RdmaccIt, typename T, class Less>
+    RdmaccIt branchless_lower_bound(RdmaccIt beg, RdmaccIt end, const T &val, Less less)
+    {
+        size_t n = end - beg;
+        if(!n)
+            return end;
+
+        RdmaccIt base = beg;
+        while(n > 1)
+        {
+            size_t half = n/2;
+            CANA_PREFETCH(&*(base + half/2));
+            CANA_PREFETCH(&*(base + half + half/2));
+            base = less(*(base + half), val) ? base + half : base;
+            n -= half;
+        }
+        return less(*base, val) ? base + 1 : base;
+    }
+
+    template<class RdmaccIt, typename T>
+    RdmaccIt branchless_lower_bound(RdmaccIt beg, RdmaccIt end, const T &val)
+    {
+        return branchless_lower_bound(beg, end, val,
+                                      [] (const decltype(*beg) &a, const T &b) {return a < b;});
+    }
+
+    // branchless upper bound, the first element that is greater than val
+    template<class RdmaccIt, typename T>
+    RdmaccIt branchless_upper_bound(RdmaccIt beg, RdmaccIt end, const T &val)
+    {
+        return branchless_lower_bound(beg, end, val,
+                                      [] (const decltype(*beg) &a, const T &b) {return !(b < a);});
+    }
+
+    // the same results as binary_search, binary_search_interval and
+    // binary_search_close_less, they are based on the branchless lower bound,
+    // so the element should also have operator < with val
+    template<class RdmaccIt, typename T>
+    RdmaccIt fast_binary_search(RdmaccIt beg, RdmaccIt end, const T &val)
+    {
+        RdmaccIt it = branchless_lower_bound(beg, end, val);
+        if(it != end && *it == val)
+            return it;
+        return end;
+    }
+
+    template<class RdmaccIt, typename T>
+    std::pair<RdmaccIt, RdmaccIt> fast_binary_search_interval(RdmaccIt beg,
+                                                              RdmaccIt end,
+                                                              const T &val)
+    {
+        RdmaccIt it = branchless_lower_bound(beg, end, val);
+        if(it == end)
+            return std::make_pair(end, end);
+        if(*it == val)
+            return std::make_pair(it, it);
+        if(it == beg)
+            return std::make_pair(end, end);
+        return std::make_pair(it - 1, it);
+    }
+
+    template<class RdmaccIt, typename T>
+    RdmaccIt fast_binary_search_close_less(RdmaccIt beg, RdmaccIt end, const T &val)
+    {
+        RdmaccIt it = branchless_lower_bound(beg, end, val);
+        if(it != end && *it == val)
+            return it;
+        if(it == beg)
+            return end;
+        return it - 1;
+    }
+
+    // sorted keys in the Eytzinger (breadth-first) layout, the first levels of
+    // the implicit tree share the cache lines, and the children of 4 levels
+    // below are prefetched, it is for the large read-mostly tables
+    // the results are the indices in the original sorted order
+    template<typename T>
+    class eytzinger
+    {
+    public:
+        eytzinger() {}
+
+        template<class RdmaccIt>
+        eytzinger(RdmaccIt beg, RdmaccIt end) {build(beg, end);}
+
+        explicit eytzinger(const std::vector<T> &sorted) {build(sorted.begin(), sorted.end());}
+
+        // keys are from the sorted range [beg, end)
+        template<class RdmaccIt>
+        void build(RdmaccIt beg, RdmaccIt end)
+        {
+            size_t n = end - beg;
+            keys.resize(n + 1);
+            order.resize(n + 1);
+            size_t i = 0;
+            fill(beg, i, 1, n);
+        }
+
+        // build from a member of the elements, such as the cdf of val_cdf
+        template<class RdmaccIt, class Key>
+        void build(RdmaccIt beg, RdmaccIt end, Key key)
+        {
+            std::vector<T> sorted;
+            sorted.reserve(end - beg);
+            for(RdmaccIt it = beg; it != end; ++it)
+                sorted.push_back(key(*it));
+            build(sorted.begin(), sorted.end());
+        }
+
+        size_t size() const {return keys.empty() ? 0 : keys.size() - 1;}
+
+        // index of the first key not less than val, size() if none
+        size_t lower_bound(const T &val) const
+        {
+            size_t n = size(), k = 1;
+            while(k <= n)
+            {
+                if(16*k <= n)
+                    CANA_PREFETCH(keys.data() + 16*k);
+                k = 2*k + (keys[k] < val);
+            }
+            // go back to the last left turn
+            k >>= ffs(~k);
+            return k ? order[k] : n;
+        }
+
+        // index of the first key greater than val, size() if none
+        size_t upper_bound(const T &val) const
+        {
+            size_t n = size(), k = 1;
+            while(k <= n)
+            {
+                if(16*k <= n)
+                    CANA_PREFETCH(keys.data() + 16*k);
+                k = 2*k + !(val < keys[k]);
+            }
+            k >>= ffs(~k);
+            return k ? order[k] : n;
+        }
+
+    private:
+        // in-order traversal of the implicit tree assigns the sorted keys
+        template<class RdmaccIt>
+        void fill(RdmaccIt beg, size_t &i, size_t k, size_t n)
+        {
+            if(k > n)
+                return;
+            fill(beg, i, 2*k, n);
+            keys[k] = *(beg + i);
+            order[k] = i++;
+            fill(beg, i, 2*k + 1, n);
+        }
+
+        // position of the lowest set bit, 1-based
+        static inline int ffs(size_t v)
+        {
+#if defined(__GNUC__)
+            return __builtin_ffsll(v);
+#endif
+            int i = 1;
+            while(!(v&1)) {
+                v >>= 1;
+                ++i;
+            }
+            return i;
+        }
+
+    private:
+        std::vector<T> keys;
+        std::vector<size_t> order;
+    };
+
 } // namespace cana
 
 #endif // CANA_UTILS_H
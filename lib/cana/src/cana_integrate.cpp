@@ -1,6 +1,9 @@
 #include "cana_integrate.h"
 #include "cana_utils.h"
 #include "data/legendre_table.h"
+#include <limits>
+#include <map>
+#include <mutex>
 
 // calculate legendre polynomial from look-up table
 // based on the code from http://www.holoborodko.com/pavel/?page_id=679
@@ -87,4 +90,60 @@ cana::legendre_nodes cana::calc_legendre_nodes(int n, double prec)
 	return res;
 }
 
+// expand the half nodes to all the abscissas
+cana::legendre_rule cana::calc_legendre_rule(const legendre_nodes &ln)
+{
+    cana::legendre_rule res;
+    res.order = ln.order;
+    if(ln.order < 2) return res;
+
+    for(size_t i = 0; i < ln.weights.size(); ++i)
+    {
+        const auto &p = ln.weights[i];
+        // the first point is at 0 for the odd orders
+        if(i == 0 && (ln.order&1)) {
+            res.x.push_back(0.);
+            res.w.push_back(p.w);
+        } else {
+            res.x.push_back(p.x);
+            res.w.push_back(p.w);
+            res.x.push_back(-p.x);
+            res.w.push_back(p.w);
+        }
+    }
+
+    return res;
+}
+
+// cache of the nodes, the elements of std::map are never moved
+struct legendre_cache
+{
+    cana::legendre_nodes nodes;
+    cana::legendre_rule rule;
+};
+
+static const legendre_cache &get_legendre_cache(int n)
+{
+    static std::map<int, legendre_cache> caches;
+    static std::mutex locker;
+
+    std::lock_guard<std::mutex> lock(locker);
+    auto it = caches.find(n);
+    if(it == caches.end()) {
+        legendre_cache cache;
+        cache.nodes = cana::calc_legendre_nodes(n);
+        cache.rule = cana::calc_legendre_rule(cache.nodes);
+        it = caches.emplace(n, std::move(cache)).first;
+    }
+    return it->second;
+}
+
+const cana::legendre_nodes &cana::get_legendre_nodes(int n)
+{
+    return get_legendre_cache(n).nodes;
+}
 
+const cana::legendre_rule &cana::get_legendre_rule(int n)
+{
+    return get_legendre_cache(n).rule;
+}
@@ -0,0 +1,102 @@
+#include "cana_interp.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CANA_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef CANA_X86_SIMD
+// same operations in the same order as the template versions, no fma so the
+// results do not change with the kernels
+__attribute__((target("avx2")))
+static size_t linear_grid_avx2(const float *grid, size_t n, float x0, float dx,
+                               const float *xq, float *out, size_t m)
+{
+    const __m256 vx0 = _mm256_set1_ps(x0), vdx = _mm256_set1_ps(dx);
+    const __m256 vzero = _mm256_setzero_ps(), vmax = _mm256_set1_ps(float(n - 1));
+    const __m256i vlast = _mm256_set1_epi32(int(n - 2));
+
+    size_t i = 0;
+    for(; i + 8 <= m; i += 8)
+    {
+        __m256 u = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(xq + i), vx0), vdx);
+        // max returns the second operand for nan, same as the scalar clamp
+        u = _mm256_min_ps(_mm256_max_ps(u, vzero), vmax);
+        __m256i k = _mm256_min_epi32(_mm256_cvttps_epi32(u), vlast);
+        __m256 t = _mm256_sub_ps(u, _mm256_cvtepi32_ps(k));
+        __m256 y1 = _mm256_i32gather_ps(grid, k, 4);
+        __m256 y2 = _mm256_i32gather_ps(grid + 1, k, 4);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(y1, _mm256_mul_ps(t, _mm256_sub_ps(y2, y1))));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t bilinear_grid_avx2(const float *grid, size_t nx, size_t ny,
+                                 float x0, float dx, float y0, float dy,
+                                 const float *xq, const float *yq, float *out, size_t m)
+{
+    const __m256 vx0 = _mm256_set1_ps(x0), vdx = _mm256_set1_ps(dx);
+    const __m256 vy0 = _mm256_set1_ps(y0), vdy = _mm256_set1_ps(dy);
+    const __m256 vzero = _mm256_setzero_ps();
+    const __m256 vumax = _mm256_set1_ps(float(nx - 1)), vvmax = _mm256_set1_ps(float(ny - 1));
+    const __m256i vlastx = _mm256_set1_epi32(int(nx - 2)), vlasty = _mm256_set1_epi32(int(ny - 2));
+    const __m256i vny = _mm256_set1_epi32(int(ny));
+    const float *grid_x = grid + ny;
+
+    size_t i = 0;
+    for(; i + 8 <= m; i += 8)
+    {
+        __m256 u = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(xq + i), vx0), vdx);
+        __m256 v = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(yq + i), vy0), vdy);
+        u = _mm256_min_ps(_mm256_max_ps(u, vzero), vumax);
+        v = _mm256_min_ps(_mm256_max_ps(v, vzero), vvmax);
+        __m256i kx = _mm256_min_epi32(_mm256_cvttps_epi32(u), vlastx);
+        __m256i ky = _mm256_min_epi32(_mm256_cvttps_epi32(v), vlasty);
+        __m256 tx = _mm256_sub_ps(u, _mm256_cvtepi32_ps(kx));
+        __m256 ty = _mm256_sub_ps(v, _mm256_cvtepi32_ps(ky));
+
+        __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(kx, vny), ky);
+        __m256 g00 = _mm256_i32gather_ps(grid, idx, 4);
+        __m256 g01 = _mm256_i32gather_ps(grid + 1, idx, 4);
+        __m256 g10 = _mm256_i32gather_ps(grid_x, idx, 4);
+        __m256 g11 = _mm256_i32gather_ps(grid_x + 1, idx, 4);
+
+        __m256 a = _mm256_add_ps(g00, _mm256_mul_ps(ty, _mm256_sub_ps(g01, g00)));
+        __m256 b = _mm256_add_ps(g10, _mm256_mul_ps(ty, _mm256_sub_ps(g11, g10)));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(tx, _mm256_sub_ps(b, a))));
+    }
+    return i;
+}
+
+static bool use_avx2()
+{
+    static const bool res = __builtin_cpu_supports("avx2");
+    return res;
+}
+#endif
+
+void cana::interp_linear_grid(const float *grid, size_t n, float x0, float dx,
+                              const float *xq, float *out, size_t m)
+{
+    size_t i = 0;
+#ifdef CANA_X86_SIMD
+    if(n > 1 && use_avx2())
+        i = linear_grid_avx2(grid, n, x0, dx, xq, out, m);
+#endif
+    // the tails
+    cana::interp_linear_grid<float>(grid, n, x0, dx, xq + i, out + i, m - i);
+}
+
+void cana::interp_bilinear_grid(const float *grid, size_t nx, size_t ny,
+                                float x0, float dx, float y0, float dy,
+                                const float *xq, const float *yq, float *out, size_t m)
+{
+    size_t i = 0;
+#ifdef CANA_X86_SIMD
+    if(nx > 1 && ny > 1 && use_avx2())
+        i = bilinear_grid_avx2(grid, nx, ny, x0, dx, y0, dy, xq, yq, out, m);
+#endif
+    cana::interp_bilinear_grid<float>(grid, nx, ny, x0, dx, y0, dy,
+                                      xq + i, yq + i, out + i, m - i);
+}
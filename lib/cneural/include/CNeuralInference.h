@@ -0,0 +1,64 @@
+#ifndef C_NEURAL_INFERENCE_H
+#define C_NEURAL_INFERENCE_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "CNeuralNetwork.h"
+
+// compiled copy of a trained network for inference only
+// the weights are stored in the selected precision, int8 weights are quantized
+// with one scale for each neuron and the signals are calculated in float
+class CNeuralInference
+{
+public:
+    enum Precision
+    {
+        Double = 0,
+        Float,
+        Int8,
+    };
+
+    // accuracy of the outputs against the double precision network
+    struct Accuracy
+    {
+        double max_delta, mean_delta;
+        size_t samples;
+
+        Accuracy() : max_delta(0.), mean_delta(0.), samples(0) {}
+    };
+
+public:
+    CNeuralInference();
+    CNeuralInference(const CNeuralNetwork &net, Precision p = Float);
+
+    void Compile(const CNeuralNetwork &net, Precision p = Float);
+    void Update(const float *input, float *output) const;
+    void UpdateBatch(const float *inputs, size_t n, float *outputs) const;
+    Accuracy Compare(const CNeuralNetwork &net, const float *inputs, size_t n) const;
+
+    Precision GetPrecision() const {return precision;}
+    unsigned int GetInputSize() const {return (layers.empty()) ? 0 : layers.front().input_size;}
+    unsigned int GetOutputSize() const {return (layers.empty()) ? 0 : layers.back().size;}
+    size_t GetWeightBytes() const;
+
+private:
+    struct Layer
+    {
+        unsigned int input_size, size;
+        bool with_bias;
+        std::vector<double> w_double, b_double;
+        std::vector<float> w_float, b_float, scale;
+        std::vector<int8_t> w_int8;
+    };
+
+    template<typename T>
+    void update(const float *input, float *output, std::vector<T> &buf1, std::vector<T> &buf2) const;
+
+private:
+    Precision precision;
+    std::vector<Layer> layers;
+    double output_norm, output_shift;
+};
+
+#endif
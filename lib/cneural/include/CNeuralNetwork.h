@@ -2,10 +2,27 @@
 #define C_NEURAL_NETWORK_H
 
 #include <vector>
+#include <cstddef>
 #include "CNeuronLayer.h"
 
+// samples in one chunk of a mini-batch or batch update, every chunk is handled
+// by one thread, the gradients are summed in the order of chunks
+#define CNN_BATCH_CHUNK 64
+// parameters for the Adam optimizer
+#define CNN_ADAM_BETA1 0.9
+#define CNN_ADAM_BETA2 0.999
+#define CNN_ADAM_EPS 1e-8
+
 class CNeuralNetwork
 {
+public:
+    enum Optimizer
+    {
+        SGD = 0,
+        Momentum,
+        Adam,
+    };
+
 public:
 	CNeuralNetwork(double factor = 0.2);
 
@@ -17,21 +34,49 @@ public:
     void SetLearnFactor(double f) {learn_factor = f;}
     void SetNormFactor(double n) {output_norm = n;}
     void SetShift(double s) {output_shift = s;}
+    void SetOptimizer(Optimizer opt) {optimizer = opt; ResetOptimizer();}
+    void SetMomentum(double m) {momentum = m;}
+    void SetThreads(unsigned int n) {nthreads = n;}
+    void ResetOptimizer();
     void Update(const std::vector<double> &input);
+    void UpdateBatch(const float *inputs, size_t n, float *outputs) const;
     void Train(const std::vector<double> &input, const std::vector<double> &expect);
+    double BatchTrain(const double *inputs, const double *expects, size_t n);
 
     void SaveNet(const char *path) const;
     const std::vector<double> &GetOutput() const {return output;}
     double GetLearnFactor() const {return learn_factor;}
     double GetNormFactor() const {return output_norm;}
+    double GetShift() const {return output_shift;}
+    Optimizer GetOptimizer() const {return optimizer;}
+    double GetMomentum() const {return momentum;}
+    unsigned int GetThreads() const {return nthreads;}
+    unsigned int GetInputSize() const {return (layers.empty()) ? 0 : layers.front().GetInputSize();}
+    unsigned int GetOutputSize() const {return (layers.empty()) ? 0 : layers.back().GetSize();}
+    const std::vector<CNeuronLayer> &GetLayers() const {return layers;}
 
     void BP_Train(const std::vector<double> &in, const std::vector<double> &req);
 
+private:
+    // moments of the gradients for the optimizers
+    struct OptState
+    {
+        std::vector<double> w1, w2, b1, b2;
+    };
+
+    void update_params(const std::vector<double> &grad, std::vector<double> &m1,
+                       std::vector<double> &m2, std::vector<double> &delta) const;
+
 private:
     std::vector<CNeuronLayer> layers;
     std::vector<double> output;
     double learn_factor;
     double output_norm, output_shift;
+    Optimizer optimizer;
+    double momentum;
+    unsigned int nthreads;
+    std::vector<OptState> opt_states;
+    unsigned int opt_steps;
 };
 
 #endif
@@ -2,24 +2,52 @@
 #define C_NEURON_LAYER_H
 
 #include <vector>
-#include "CNeuron.h"
+#include <cstddef>
 
+// a layer of neurons, the weights of all neurons are stored in a row-major
+// matrix (one row for one neuron), so the signals of a layer are updated by a
+// matrix-vector product
 class CNeuronLayer
 {
 public:
     CNeuronLayer(unsigned int con_size, unsigned int size);
-    CNeuronLayer(CNeuronLayer &prev_layer, unsigned int size);
 
-    void Connect(CNeuronLayer &prev_layer);
     void Update(const std::vector<double> &input);
-    void Update();
-    std::vector<CNeuron> &GetNeurons() {return neurons;}
-    const std::vector<CNeuron> &GetNeurons() const {return neurons;}
+    void Update(const double *input);
+    void Update(const CNeuronLayer &prev_layer);
+    void SetWeights(unsigned int idx, const std::vector<double> &w);
+    std::vector<double> GetWeights(unsigned int idx) const;
+    unsigned int GetWeightSize() const {return input_size + 1;}
     unsigned int GetInputSize() const {return input_size;}
+    unsigned int GetSize() const {return size;}
+    const std::vector<double> &GetSignals() const {return signals;}
+
+    // Back Propagation Trainning functions
+    void BP_Init(const double *dE);
+    void BP_Init();
+    void BP_Propagate(CNeuronLayer &prev_layer) const;
+    void BP_Learn(const CNeuronLayer &prev_layer, const double &factor);
+    void BP_Learn(const double *input, const double &factor);
+
+    // batch functions for n samples, they do not change the layer
+    void Forward(const double *input, double *output, size_t n, bool with_bias) const;
+    void Backward(const double *input, const double *output, double *dE, double *prev_dE,
+                  double *grad_w, double *grad_b, size_t n) const;
+    // apply the weight and bias differences from the batch training
+    void Learn(const std::vector<double> &dw, const std::vector<double> &db);
+    size_t GetWeightMatrixSize() const {return weights.size();}
+
+private:
+    void gemv(const double *input, bool with_bias);
+    void sigmoid();
+    void response(std::vector<double> &res) const;
 
 private:
-    unsigned int input_size;
-    std::vector<CNeuron> neurons;
+    unsigned int input_size, size;
+    std::vector<double> weights;
+    std::vector<double> bias;
+    std::vector<double> signals;
+    std::vector<double> sigmas;
 };
 
 #endif
@@ -0,0 +1,214 @@
+//============================================================================//
+// A compiled neural network for inference only                               //
+// The weights of a trained network are copied in double, float or int8, the  //
+// lower precisions reduce the memory traffic for the online rejection        //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "CNeuralInference.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+
+
+// constructor
+CNeuralInference::CNeuralInference()
+: precision(Float), output_norm(1.0), output_shift(0.0)
+{
+    // place holder
+}
+
+CNeuralInference::CNeuralInference(const CNeuralNetwork &net, Precision p)
+: CNeuralInference()
+{
+    Compile(net, p);
+}
+
+// copy the weights from the network in the selected precision
+void CNeuralInference::Compile(const CNeuralNetwork &net, Precision p)
+{
+    precision = p;
+    output_norm = net.GetNormFactor();
+    output_shift = net.GetShift();
+    layers.clear();
+
+    auto &net_layers = net.GetLayers();
+    for(unsigned int l = 0; l < net_layers.size(); ++l)
+    {
+        auto &net_layer = net_layers.at(l);
+        Layer layer;
+        layer.input_size = net_layer.GetInputSize();
+        layer.size = net_layer.GetSize();
+        // the bias only applies to the first layer like the network
+        layer.with_bias = (l == 0);
+
+        for(unsigned int i = 0; i < layer.size; ++i)
+        {
+            auto w = net_layer.GetWeights(i);
+            double b = w.back();
+            w.pop_back();
+
+            switch(precision)
+            {
+            case Double:
+                layer.w_double.insert(layer.w_double.end(), w.begin(), w.end());
+                layer.b_double.push_back(b);
+                break;
+            case Float:
+                layer.w_float.insert(layer.w_float.end(), w.begin(), w.end());
+                layer.b_float.push_back(b);
+                break;
+            case Int8:
+                {
+                    // symmetric quantization with one scale for one neuron
+                    double wmax = 0.;
+                    for(auto &val : w)
+                        wmax = std::max(wmax, std::abs(val));
+                    double scale = (wmax > 0.) ? wmax/127. : 1.;
+                    for(auto &val : w)
+                        layer.w_int8.push_back(std::lround(val/scale));
+                    layer.scale.push_back(scale);
+                    layer.b_float.push_back(b);
+                }
+                break;
+            }
+        }
+
+        layers.emplace_back(std::move(layer));
+    }
+}
+
+// inner product of a neuron row and the signals, W is the type of weights
+template<typename W, typename T>
+inline T __cni_dot(const W *w, const T *x, unsigned int n)
+{
+    T sum = 0.;
+    for(unsigned int j = 0; j < n; ++j)
+        sum += w[j]*x[j];
+    return sum;
+}
+
+// update one sample layer by layer, T is the type of signals
+template<typename T>
+void CNeuralInference::update(const float *input, float *output,
+                              std::vector<T> &buf1, std::vector<T> &buf2)
+const
+{
+    buf1.assign(input, input + GetInputSize());
+    for(auto &layer : layers)
+    {
+        buf2.resize(layer.size);
+        for(unsigned int i = 0; i < layer.size; ++i)
+        {
+            size_t row = i*layer.input_size;
+            T sum;
+            switch(precision)
+            {
+            case Double:
+                sum = __cni_dot(&layer.w_double[row], buf1.data(), layer.input_size);
+                break;
+            case Float:
+                sum = __cni_dot(&layer.w_float[row], buf1.data(), layer.input_size);
+                break;
+            default:
+            case Int8:
+                sum = __cni_dot(&layer.w_int8[row], buf1.data(), layer.input_size)*layer.scale[i];
+                break;
+            }
+
+            if(layer.with_bias)
+                sum -= (precision == Double) ? layer.b_double[i] : layer.b_float[i];
+            buf2[i] = sum;
+        }
+
+        // sigmoid function for output
+        for(auto &sig : buf2)
+            sig = T(1)/(T(1) + std::exp(-sig));
+        buf1.swap(buf2);
+    }
+
+    for(unsigned int i = 0; i < GetOutputSize(); ++i)
+        output[i] = (buf1[i] + output_shift)*output_norm;
+}
+
+// evaluate one sample
+void CNeuralInference::Update(const float *input, float *output)
+const
+{
+    UpdateBatch(input, 1, output);
+}
+
+// evaluate n samples, inputs is n x input size and outputs is n x output size
+void CNeuralInference::UpdateBatch(const float *inputs, size_t n, float *outputs)
+const
+{
+    if(layers.empty())
+        return;
+
+    size_t in_size = GetInputSize(), out_size = GetOutputSize();
+    if(precision == Double) {
+        std::vector<double> buf1, buf2;
+        for(size_t k = 0; k < n; ++k)
+            update(inputs + k*in_size, outputs + k*out_size, buf1, buf2);
+    } else {
+        std::vector<float> buf1, buf2;
+        for(size_t k = 0; k < n; ++k)
+            update(inputs + k*in_size, outputs + k*out_size, buf1, buf2);
+    }
+}
+
+// compare the outputs with the double precision network for n samples
+CNeuralInference::Accuracy CNeuralInference::Compare(const CNeuralNetwork &net,
+                                                     const float *inputs,
+                                                     size_t n)
+const
+{
+    Accuracy res;
+    size_t in_size = GetInputSize(), out_size = GetOutputSize();
+    if(net.GetInputSize() != in_size || net.GetOutputSize() != out_size) {
+        std::cerr << "Unmatched dimensions between the compiled network and "
+                  << "the reference network, abort comparison."
+                  << std::endl;
+        return res;
+    }
+
+    std::vector<float> outputs(n*out_size);
+    UpdateBatch(inputs, n, outputs.data());
+
+    // use a copy because Update changes the output of the network
+    CNeuralNetwork ref = net;
+    std::vector<double> input(in_size);
+    for(size_t k = 0; k < n; ++k)
+    {
+        std::copy(inputs + k*in_size, inputs + (k + 1)*in_size, input.begin());
+        ref.Update(input);
+        for(size_t i = 0; i < out_size; ++i)
+        {
+            double delta = std::abs(outputs[k*out_size + i] - ref.GetOutput().at(i));
+            res.max_delta = std::max(res.max_delta, delta);
+            res.mean_delta += delta;
+        }
+    }
+
+    res.samples = n;
+    if(n > 0)
+        res.mean_delta /= n*out_size;
+    return res;
+}
+
+// memory of the weights and biases
+size_t CNeuralInference::GetWeightBytes()
+const
+{
+    size_t res = 0;
+    for(auto &layer : layers)
+    {
+        res += (layer.w_double.size() + layer.b_double.size())*sizeof(double)
+             + (layer.w_float.size() + layer.b_float.size() + layer.scale.size())*sizeof(float)
+             + layer.w_int8.size()*sizeof(int8_t);
+    }
+    return res;
+}
@@ -10,12 +10,46 @@
 #include <iomanip>
 #include <fstream>
 #include <random>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 
 
+// run func(i) for i in [0, n) with several threads
+template<class Func>
+inline void parallel_for(size_t n, unsigned int nthreads, Func func)
+{
+    std::atomic<size_t> next(0);
+    auto work = [&] ()
+                {
+                    size_t i;
+                    while((i = next++) < n)
+                        func(i);
+                };
+
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, n));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(work);
+    work();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    (void) nthreads;
+    work();
+#endif
+}
+
 // constructor
 CNeuralNetwork::CNeuralNetwork(double factor)
-: learn_factor(factor), output_norm(1.0), output_shift(0.0)
+: learn_factor(factor), output_norm(1.0), output_shift(0.0),
+  optimizer(SGD), momentum(0.9), nthreads(0), opt_steps(0)
 {
     // place holder
 }
@@ -30,12 +64,12 @@ inline void __cnn_print_structure(const std::vector<CNeuronLayer> &layers)
         std::cout << std::setw(6) << " " << "Input dimension: "
                   << layers.front().GetInputSize() << std::endl
                   << std::setw(6) << " " << "Output dimension: "
-                  << layers.back().GetNeurons().size() << std::endl
+                  << layers.back().GetSize() << std::endl
                   << std::setw(6) << " " << "Hidden layers: "
-                  << layers.front().GetNeurons().size();
+                  << layers.front().GetSize();
         for(unsigned int i = 1; i < layers.size() - 1; ++i)
         {
-            std::cout << ", " << layers.at(i).GetNeurons().size();
+            std::cout << ", " << layers.at(i).GetSize();
         }
         std::cout << std::endl;
     }
@@ -66,15 +100,10 @@ unsigned int CNeuralNetwork::CreateNet(unsigned int input_size,
     // output layer
     layers.emplace_back(input_size, output_size);
 
-    // build connections
-    for(unsigned int i = 1; i < layers.size(); ++i)
-    {
-        layers.at(i).Connect(layers.at(i-1));
-    }
-
     std::cout << "Create a new neural network" << std::endl;
     __cnn_print_structure(layers);
 
+    ResetOptimizer();
     return layers.size();
 }
 
@@ -123,7 +152,6 @@ unsigned int CNeuralNetwork::CreateNet(const char *path)
         // read weights from the layer
         for(unsigned int i = 0; i < neurons_size; ++i)
         {
-            CNeuron &neuron = new_layer.GetNeurons().at(i);
             __cnn_read_uint32(inf, uint_word);
             unsigned int weights_size = uint_word;
             std::vector<double> weights(weights_size);
@@ -132,7 +160,7 @@ unsigned int CNeuralNetwork::CreateNet(const char *path)
                 __cnn_read_real64(inf, real_word);
                 weights[j] = real_word;
             }
-            neuron.SetWeights(weights);
+            new_layer.SetWeights(i, weights);
         }
 
         layers.emplace_back(std::move(new_layer));
@@ -142,12 +170,6 @@ unsigned int CNeuralNetwork::CreateNet(const char *path)
     __cnn_read_real64(inf, output_norm);
     __cnn_read_real64(inf, output_shift);
 
-    // build connections
-    for(unsigned int i = 1; i < layers.size(); ++i)
-    {
-        layers.at(i).Connect(layers.at(i-1));
-    }
-
     std::cout << "Create neural network from file "
               << "\"" << path << "\"\n"
               << "Output Normalization Factor: " << output_norm << "\n"
@@ -156,6 +178,7 @@ unsigned int CNeuralNetwork::CreateNet(const char *path)
 
     __cnn_print_structure(layers);
 
+    ResetOptimizer();
     return layers.size();
 }
 
@@ -168,17 +191,39 @@ void CNeuralNetwork::InitializeWeights()
 
     for(auto &layer : layers)
     {
-        for(auto &neuron : layer.GetNeurons())
+        for(unsigned int n = 0; n < layer.GetSize(); ++n)
         {
             std::vector<double> weights;
-            weights.reserve(neuron.GetWeightSize());
-            for(unsigned int i = 0; i < neuron.GetWeightSize(); ++i)
+            weights.reserve(layer.GetWeightSize());
+            for(unsigned int i = 0; i < layer.GetWeightSize(); ++i)
             {
                 weights.push_back(uni_dist(rng));
             }
-            neuron.SetWeights(weights);
+            layer.SetWeights(n, weights);
         }
     }
+
+    ResetOptimizer();
+}
+
+// clear the moments of the optimizer
+void CNeuralNetwork::ResetOptimizer()
+{
+    opt_states.clear();
+    opt_steps = 0;
+    for(auto &layer : layers)
+    {
+        OptState state;
+        if(optimizer != SGD) {
+            state.w1.assign(layer.GetWeightMatrixSize(), 0.);
+            state.b1.assign(layer.GetSize(), 0.);
+        }
+        if(optimizer == Adam) {
+            state.w2.assign(layer.GetWeightMatrixSize(), 0.);
+            state.b2.assign(layer.GetSize(), 0.);
+        }
+        opt_states.emplace_back(std::move(state));
+    }
 }
 
 // helper functions for writing binary file
@@ -220,12 +265,12 @@ const
     for(auto &layer : layers)
     {
         // layer size
-        __cnn_write_uint32(outf, layer.GetNeurons().size());
+        __cnn_write_uint32(outf, layer.GetSize());
         // weights
-        for(auto &neuron : layer.GetNeurons())
+        for(unsigned int n = 0; n < layer.GetSize(); ++n)
         {
             // number of weights
-            auto weights = neuron.GetWeights();
+            auto weights = layer.GetWeights(n);
             __cnn_write_uint32(outf, weights.size());
             for(auto &weight : weights)
             {
@@ -252,14 +297,49 @@ void CNeuralNetwork::Update(const std::vector<double> &input)
     // the other layers will look for its previous layer's signals
     for(unsigned int i = 1; i < layers.size(); ++i)
     {
-        layers[i].Update();
+        layers[i].Update(layers[i - 1]);
     }
 
     // save output
-    auto &outn = layers.back().GetNeurons();
+    auto &signals = layers.back().GetSignals();
     output.clear();
-    for(auto &neuron : outn)
-        output.push_back((neuron.signal + output_shift)*output_norm);
+    for(auto &signal : signals)
+        output.push_back((signal + output_shift)*output_norm);
+}
+
+// evaluate n samples, inputs is n x input size and outputs is n x output size,
+// both are row-major, the outputs are the same as Update for every sample
+// the layers are updated for a chunk of samples together by several threads
+void CNeuralNetwork::UpdateBatch(const float *inputs, size_t n, float *outputs)
+const
+{
+    if(layers.empty() || n == 0)
+        return;
+
+    size_t nlayers = layers.size();
+    size_t in_size = layers.front().GetInputSize();
+    size_t out_size = layers.back().GetSize();
+    size_t nchunks = (n + CNN_BATCH_CHUNK - 1)/CNN_BATCH_CHUNK;
+
+    parallel_for(nchunks, nthreads,
+                 [&] (size_t c)
+                 {
+                     size_t beg = c*CNN_BATCH_CHUNK;
+                     size_t m = std::min<size_t>(n - beg, CNN_BATCH_CHUNK);
+
+                     std::vector<double> in(inputs + beg*in_size, inputs + (beg + m)*in_size);
+                     std::vector<double> out;
+                     for(size_t l = 0; l < nlayers; ++l)
+                     {
+                         out.resize(m*layers[l].GetSize());
+                         layers[l].Forward(in.data(), out.data(), m, l == 0);
+                         in.swap(out);
+                     }
+
+                     float *res = outputs + beg*out_size;
+                     for(size_t k = 0; k < m*out_size; ++k)
+                         res[k] = (in[k] + output_shift)*output_norm;
+                 });
 }
 
 // Training with erro back propagation
@@ -283,50 +363,175 @@ void CNeuralNetwork::BP_Train(const std::vector<double> &input,
     }
 
     // start from output layer
-    auto &out_neurons = layers.back().GetNeurons();
-
-    for(unsigned int i = 0; i < out_neurons.size(); ++i)
+    std::vector<double> dE(output.size());
+    for(unsigned int i = 0; i < output.size(); ++i)
     {
-        double dE = (output.at(i) - expect.at(i))/output_norm;
-        // set error
-        out_neurons.at(i).BP_Init(dE);
+        dE[i] = (output.at(i) - expect.at(i))/output_norm;
     }
+    // set error
+    layers.back().BP_Init(dE.data());
 
     // initialize the response for other layers
     for(unsigned int i = 0; i < layers.size() - 1;  ++i)
     {
-        auto &layer = layers.at(i);
-
-        for(auto &neuron : layer.GetNeurons())
-        {
-            neuron.BP_Init(0.);
-        }
+        layers.at(i).BP_Init();
     }
 
     // propagate responses backwardly
-    for(auto it = layers.rbegin(); it != layers.rend(); ++it)
+    for(unsigned int i = layers.size() - 1; i > 0; --i)
     {
-        for(auto &neuron : it->GetNeurons())
-        {
-            neuron.BP_Propagate();
-        }
+        layers.at(i).BP_Propagate(layers.at(i - 1));
     }
 
     // update weights for all the neurons
     // input layer is specially treated
-    auto &in_neurons = layers.front().GetNeurons();
-    for(auto &neuron : in_neurons)
+    layers.front().BP_Learn(input.data(), learn_factor);
+
+    for(unsigned int i = 1; i < layers.size(); ++i)
     {
-        neuron.BP_Learn(input, learn_factor);
+        layers.at(i).BP_Learn(layers.at(i - 1), learn_factor);
     }
+}
 
-    for(unsigned int i = 1; i < layers.size(); ++i)
+// train the network with one sample
+void CNeuralNetwork::Train(const std::vector<double> &input, const std::vector<double> &expect)
+{
+    BP_Train(input, expect);
+}
+
+// mini-batch training with n samples, inputs is n x input size and expects is
+// n x output size, both are row-major
+// the batch is split into chunks for the threads, and the gradients are
+// averaged over the batch before the weights are changed by the optimizer
+// return the mean squared error of the outputs before the training
+double CNeuralNetwork::BatchTrain(const double *inputs, const double *expects, size_t n)
+{
+    // sanity check
+    if(layers.empty() || n == 0)
+        return 0.;
+
+    if(opt_states.size() != layers.size())
+        ResetOptimizer();
+
+    size_t nlayers = layers.size();
+    size_t in_size = layers.front().GetInputSize();
+    size_t out_size = layers.back().GetSize();
+    size_t nchunks = (n + CNN_BATCH_CHUNK - 1)/CNN_BATCH_CHUNK;
+
+    // gradients and loss of every chunk
+    std::vector<std::vector<std::vector<double>>> grad_w(nchunks), grad_b(nchunks);
+    std::vector<double> loss(nchunks, 0.);
+
+    parallel_for(nchunks, nthreads,
+                 [&] (size_t c)
+                 {
+                     size_t beg = c*CNN_BATCH_CHUNK;
+                     size_t m = std::min<size_t>(n - beg, CNN_BATCH_CHUNK);
+                     const double *in = inputs + beg*in_size;
+                     const double *ex = expects + beg*out_size;
+
+                     // forward pass, signals of all layers
+                     std::vector<std::vector<double>> signals(nlayers);
+                     for(size_t l = 0; l < nlayers; ++l)
+                     {
+                         signals[l].resize(m*layers[l].GetSize());
+                         layers[l].Forward((l == 0) ? in : signals[l - 1].data(),
+                                           signals[l].data(), m, l == 0);
+                     }
+
+                     // errors of the outputs
+                     auto &out = signals.back();
+                     std::vector<double> dE(m*out_size);
+                     for(size_t k = 0; k < m*out_size; ++k)
+                     {
+                         double diff = (out[k] + output_shift)*output_norm - ex[k];
+                         loss[c] += diff*diff;
+                         dE[k] = diff/output_norm;
+                     }
+
+                     // backward pass
+                     grad_w[c].resize(nlayers);
+                     grad_b[c].resize(nlayers);
+                     for(size_t l = nlayers; l-- > 0;)
+                     {
+                         grad_w[c][l].assign(layers[l].GetWeightMatrixSize(), 0.);
+                         grad_b[c][l].assign(layers[l].GetSize(), 0.);
+
+                         std::vector<double> prev_dE;
+                         if(l > 0)
+                             prev_dE.assign(m*layers[l].GetInputSize(), 0.);
+
+                         layers[l].Backward((l == 0) ? in : signals[l - 1].data(),
+                                            signals[l].data(), dE.data(),
+                                            (l == 0) ? nullptr : prev_dE.data(),
+                                            grad_w[c][l].data(), grad_b[c][l].data(), m);
+                         dE.swap(prev_dE);
+                     }
+                 });
+
+    // sum the chunks in order, so the result does not depend on the threads
+    ++opt_steps;
+    double total_loss = 0.;
+    for(size_t c = 0; c < nchunks; ++c)
+        total_loss += loss[c];
+
+    for(size_t l = 0; l < nlayers; ++l)
     {
-        auto &layer = layers.at(i);
+        std::vector<double> gw(layers[l].GetWeightMatrixSize(), 0.), gb(layers[l].GetSize(), 0.);
+        for(size_t c = 0; c < nchunks; ++c)
+        {
+            for(size_t i = 0; i < gw.size(); ++i)
+                gw[i] += grad_w[c][l][i];
+            for(size_t i = 0; i < gb.size(); ++i)
+                gb[i] += grad_b[c][l][i];
+        }
+        for(auto &g : gw)
+            g /= n;
+        for(auto &g : gb)
+            g /= n;
+
+        std::vector<double> dw, db;
+        auto &state = opt_states[l];
+        update_params(gw, state.w1, state.w2, dw);
+        update_params(gb, state.b1, state.b2, db);
+        layers[l].Learn(dw, db);
+    }
 
-        for(auto &neuron : layer.GetNeurons())
+    return total_loss/(n*out_size);
+}
+
+// differences of the parameters from the gradients with the optimizer
+void CNeuralNetwork::update_params(const std::vector<double> &grad, std::vector<double> &m1,
+                                   std::vector<double> &m2, std::vector<double> &delta)
+const
+{
+    delta.resize(grad.size());
+
+    switch(optimizer)
+    {
+    default:
+    case SGD:
+        for(size_t i = 0; i < grad.size(); ++i)
+            delta[i] = learn_factor*grad[i];
+        break;
+    case Momentum:
+        for(size_t i = 0; i < grad.size(); ++i)
+        {
+            m1[i] = momentum*m1[i] + grad[i];
+            delta[i] = learn_factor*m1[i];
+        }
+        break;
+    case Adam:
         {
-            neuron.BP_Learn(learn_factor);
+            double c1 = 1. - std::pow(CNN_ADAM_BETA1, opt_steps);
+            double c2 = 1. - std::pow(CNN_ADAM_BETA2, opt_steps);
+            for(size_t i = 0; i < grad.size(); ++i)
+            {
+                m1[i] = CNN_ADAM_BETA1*m1[i] + (1. - CNN_ADAM_BETA1)*grad[i];
+                m2[i] = CNN_ADAM_BETA2*m2[i] + (1. - CNN_ADAM_BETA2)*grad[i]*grad[i];
+                delta[i] = learn_factor*(m1[i]/c1)/(std::sqrt(m2[i]/c2) + CNN_ADAM_EPS);
+            }
         }
+        break;
     }
 }
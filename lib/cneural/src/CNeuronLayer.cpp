@@ -7,58 +7,222 @@
 
 #include "CNeuronLayer.h"
 #include <iostream>
+#include <cmath>
 
 
 
 // constructor
-CNeuronLayer::CNeuronLayer(unsigned int input, unsigned int size)
-: input_size(input)
+CNeuronLayer::CNeuronLayer(unsigned int input, unsigned int n)
+: input_size(input), size(n), weights(input*n, 0.), bias(n, 0.), signals(n, 0.), sigmas(n, 0.)
 {
-	for(unsigned int i = 0; i < size; ++i)
+    // place holder
+}
+
+// give the layer an input array and get its output array
+void CNeuronLayer::Update(const std::vector<double> &input)
+{
+    if(input.size() != input_size)
+    {
+        std::cerr << "Input size " << input.size() << " unmatches expected size "
+                  << input_size << ", abort layer signals update."
+                  << std::endl;
+        return;
+    }
+
+    Update(input.data());
+}
+
+// the input array must have the input size of this layer
+void CNeuronLayer::Update(const double *input)
+{
+    gemv(input, true);
+    sigmoid();
+}
+
+// update the signals from the previous layer, the bias only applies to the
+// first layer like the trained networks
+void CNeuronLayer::Update(const CNeuronLayer &prev_layer)
+{
+    gemv(prev_layer.signals.data(), false);
+    sigmoid();
+}
+
+// set the weights for a neuron, the last one is bias
+void CNeuronLayer::SetWeights(unsigned int idx, const std::vector<double> &w)
+{
+    if(w.size() != input_size + 1)
     {
-		neurons.emplace_back(input);
+        std::cerr << "Unmatched input size " << w.size()
+                  << " and weights size " << input_size + 1
+                  << ", abort weight setting."
+                  << std::endl;
+        return;
     }
+
+    if(idx >= size)
+        return;
+
+    std::copy(w.begin(), w.end() - 1, weights.begin() + idx*input_size);
+    bias[idx] = w.back();
+}
+
+// get weights from all connections and bias of a neuron
+std::vector<double> CNeuronLayer::GetWeights(unsigned int idx)
+const
+{
+    std::vector<double> res;
+    if(idx >= size)
+        return res;
+
+    res.reserve(input_size + 1);
+    auto row = weights.begin() + idx*input_size;
+    res.insert(res.end(), row, row + input_size);
+    res.push_back(bias[idx]);
+
+    return res;
 }
 
-CNeuronLayer::CNeuronLayer(CNeuronLayer &prev_layer, unsigned int size)
-: input_size(prev_layer.GetNeurons().size())
+// Initialize the responses to errors for BP training
+void CNeuronLayer::BP_Init(const double *dE)
 {
+    for(unsigned int i = 0; i < size; ++i)
+        sigmas[i] = dE[i];
+}
+
+void CNeuronLayer::BP_Init()
+{
+    for(auto &sigma : sigmas)
+        sigma = 0.;
+}
+
+// Propagate the error responses to the previous layer
+void CNeuronLayer::BP_Propagate(CNeuronLayer &prev_layer)
+const
+{
+    std::vector<double> res;
+    response(res);
+
+    double *prev = prev_layer.sigmas.data();
     for(unsigned int i = 0; i < size; ++i)
     {
-        neurons.emplace_back(prev_layer.GetNeurons());
+        const double *row = &weights[i*input_size];
+        for(unsigned int j = 0; j < input_size; ++j)
+            prev[j] += res[i]*row[j];
     }
 }
 
-void CNeuronLayer::Connect(CNeuronLayer &prev_layer)
+// change the weightings according to the responses to errors
+void CNeuronLayer::BP_Learn(const CNeuronLayer &prev_layer, const double &factor)
+{
+    BP_Learn(prev_layer.signals.data(), factor);
+}
+
+void CNeuronLayer::BP_Learn(const double *input, const double &factor)
 {
-    for(auto &neuron : neurons)
+    std::vector<double> res;
+    response(res);
+
+    for(unsigned int i = 0; i < size; ++i)
     {
-        neuron.Connect(prev_layer.GetNeurons());
+        double *row = &weights[i*input_size];
+        for(unsigned int j = 0; j < input_size; ++j)
+            row[j] -= factor*res[i]*input[j];
+
+        // bias always has -1 as input
+        bias[i] += factor*res[i];
     }
 }
 
-// give the layer an input array and get its output array
-void CNeuronLayer::Update(const std::vector<double> &input)
+// update the signals of n samples, input is n x input size and output is
+// n x layer size, both are row-major
+void CNeuronLayer::Forward(const double *input, double *output, size_t n, bool with_bias)
+const
 {
-    if(input.size() != input_size)
+    for(size_t k = 0; k < n; ++k)
     {
-        std::cerr << "Input size " << input.size() << " unmatches expected size "
-                  << input_size << ", abort layer signals update."
-                  << std::endl;
-        return;
+        const double *x = input + k*input_size;
+        double *y = output + k*size;
+        for(unsigned int i = 0; i < size; ++i)
+        {
+            const double *row = &weights[i*input_size];
+            double sum = 0.;
+            for(unsigned int j = 0; j < input_size; ++j)
+                sum += row[j]*x[j];
+            y[i] = (with_bias) ? sum - bias[i] : sum;
+        }
+        for(unsigned int i = 0; i < size; ++i)
+            y[i] = 1./(1. + std::exp(-y[i]));
     }
+}
 
-    for(auto &neuron : neurons)
+// back propagation of n samples, dE is the error responses of the outputs and
+// it is replaced by the neuron responses, the gradients are accumulated to
+// grad_w and grad_b, the error responses of the inputs are accumulated to
+// prev_dE if it is not nullptr
+void CNeuronLayer::Backward(const double *input, const double *output, double *dE,
+                            double *prev_dE, double *grad_w, double *grad_b, size_t n)
+const
+{
+    for(size_t k = 0; k < n; ++k)
     {
-        neuron.Update(input);
+        const double *x = input + k*input_size;
+        const double *y = output + k*size;
+        double *r = dE + k*size;
+        for(unsigned int i = 0; i < size; ++i)
+        {
+            r[i] = y[i]*(1. - y[i])*r[i];
+
+            const double *row = &weights[i*input_size];
+            double *grow = grad_w + i*input_size;
+            for(unsigned int j = 0; j < input_size; ++j)
+                grow[j] += r[i]*x[j];
+            // bias always has -1 as input
+            grad_b[i] -= r[i];
+
+            if(prev_dE) {
+                double *prev = prev_dE + k*input_size;
+                for(unsigned int j = 0; j < input_size; ++j)
+                    prev[j] += r[i]*row[j];
+            }
+        }
     }
 }
 
-void CNeuronLayer::Update()
+// change the weights and biases by the differences
+void CNeuronLayer::Learn(const std::vector<double> &dw, const std::vector<double> &db)
+{
+    for(size_t i = 0; i < weights.size() && i < dw.size(); ++i)
+        weights[i] -= dw[i];
+    for(size_t i = 0; i < bias.size() && i < db.size(); ++i)
+        bias[i] -= db[i];
+}
+
+// matrix-vector product of the weights and the input
+void CNeuronLayer::gemv(const double *input, bool with_bias)
 {
-    for(auto &neuron : neurons)
+    for(unsigned int i = 0; i < size; ++i)
     {
-        neuron.Update();
+        const double *row = &weights[i*input_size];
+        double sum = 0.;
+        for(unsigned int j = 0; j < input_size; ++j)
+            sum += row[j]*input[j];
+        signals[i] = (with_bias) ? sum - bias[i] : sum;
     }
 }
 
+// sigmoid function for output
+void CNeuronLayer::sigmoid()
+{
+    for(auto &sig : signals)
+        sig = 1./(1. + std::exp(-sig));
+}
+
+// response of the neurons, the derivative of sigmoid times the error response
+void CNeuronLayer::response(std::vector<double> &res)
+const
+{
+    res.resize(size);
+    // sigmoid f(x) derivative f'(x) = f(x) * (1 - f(x))
+    for(unsigned int i = 0; i < size; ++i)
+        res[i] = signals[i]*(1. - signals[i])*sigmas[i];
+}
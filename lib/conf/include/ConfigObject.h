@@ -5,12 +5,37 @@
 #include <utility>
 #include <vector>
 #include <unordered_map>
+#include <functional>
 #include "ConfigParser.h"
 
 #define CONF_CONN(val, str, def, warn) val=getDefConfig<decltype(val)>(str, def, warn)
 
+// a typed handle to a configuration value
+// the key is resolved at the first use, and the converted value is kept until
+// the configuration is changed
+template<typename T>
+class ConfigHandle
+{
+    friend class ConfigObject;
+
+public:
+    ConfigHandle(const std::string &n = "") : name(n), rev(0), value() {}
+
+    const std::string &GetName() const {return name;}
+
+private:
+    std::string name, key;
+    uint64_t rev;
+    T value;
+};
+
 class ConfigObject
 {
+public:
+    // called with the key of the changed value, an empty key means that all the
+    // values could be changed
+    typedef std::function<void(const std::string &key)> ConfigHook;
+
 public:
     // constructor, desctructor
     ConfigObject(const std::string &spliiter = ":=",
@@ -27,6 +52,8 @@ public:
     bool ReadConfigFile(const std::string &path);
     void ReadConfigString(const std::string &content);
     void SetConfigValue(const std::string &var_name, const ConfigValue &c_value);
+    int AddConfigHook(ConfigHook &&hook);
+    void RemoveConfigHook(int id);
     void SetIgnoreChars(const std::string &ignore) {ignore_chars = ignore;}
     void SetSplitChars(const std::string &splitter) {split_chars = splitter;}
     void SetReplacePair(const std::string &open, const std::string &close)
@@ -41,6 +68,7 @@ public:
     const std::string &GetSpaceChars() const {return ignore_chars;}
     const std::pair<std::string, std::string> &GetReplacePair() const {return replace_pair;}
     std::vector<std::string> GetKeyList() const;
+    uint64_t GetConfigHash(uint64_t seed = CONFIG_HASH_SEED) const;
 
     template<typename T>
     T GetConfig(const std::string &var_name)
@@ -49,11 +77,37 @@ public:
         return GetConfigValue(var_name).Convert<T>();
     }
 
+    // the value is only converted again after the configuration is changed
+    template<typename T>
+    const T &GetConfig(ConfigHandle<T> &handle)
+    const
+    {
+        if(handle.rev != config_rev) {
+            if(handle.key.empty())
+                handle.key = formKey(handle.name);
+            ConfigValue val = getConfigValue(handle.key);
+            handle.value = val.Convert<T>();
+            handle.rev = config_rev;
+        }
+        return handle.value;
+    }
+
+    template<typename T>
+    void SetConfigValue(ConfigHandle<T> &handle, const ConfigValue &c_value)
+    {
+        if(handle.key.empty())
+            handle.key = formKey(handle.name);
+        setConfigValue(handle.key, c_value);
+    }
+
     // functions that to be overloaded
     virtual void Configure(const std::string &path = "");
 
 protected:
     // protected member functions
+    std::string formKey(const std::string &name) const;
+    ConfigValue getConfigValue(const std::string &key) const;
+    void setConfigValue(const std::string &key, const ConfigValue &c_value);
     void reform(std::string &input,
                 const std::string &open,
                 const std::string &close) const;
@@ -70,6 +124,7 @@ private:
     void parserProcess(ConfigParser &p, const std::string &source);
     void parseControl(const std::string &control_word);
     void parseTerm(std::string &&var_name, std::string &&var_value);
+    void changed(const std::string &key, bool notify = true);
 
 protected:
     std::string split_chars;
@@ -77,6 +132,19 @@ protected:
     std::pair<std::string, std::string> replace_pair;
     std::string config_path;
     std::unordered_map<std::string, std::string> config_map;
+    // revision of the configuration, it is unique among all the objects
+    uint64_t config_rev;
+
+    // the hooks are bound to an object, they are not copied
+    struct HookList
+    {
+        std::vector<std::pair<int, ConfigHook>> hooks;
+        int id;
+
+        HookList() : id(0) {}
+        HookList(const HookList &) : id(0) {}
+        HookList &operator =(const HookList &) {return *this;}
+    } config_hooks;
 
     // return this reference when there is no value found in the map
     ConfigValue __empty_value;
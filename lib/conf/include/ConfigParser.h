@@ -5,23 +5,33 @@
 #include <vector>
 #include <deque>
 #include <fstream>
+#include <cstdint>
 #include "ConfigValue.h"
 
+// initial value of the hash (64-bit FNV-1a offset basis)
+#define CONFIG_HASH_SEED 0xcbf29ce484222325ULL
+
 // a macro to auto generate enum2str and str2enum
 // name mapping begins at bias and continuously increase, split by '|'
-// an example:
+// the names are found in the string literal without allocations, and the
+// look-ups can be evaluated at compile time, an example:
 // enum ABC {a = 3, b, c};
 // ENUM_MAP(ABC, 3, "a|b|c")
 // ABC2str(3) = "a"
+// ABC2view(3) = StringView of "a"
 // str2ABC("b") = 4
 #define ENUM_MAP(type, bias, strings) \
+    static constexpr ConfigParser::StringView type ## 2view(int T) \
+    { \
+        return ConfigParser::split_part_view(T - (bias), strings, '|'); \
+    } \
     static std::string type ## 2str(int T) \
     { \
-        return ConfigParser::get_split_part(T - (bias), strings, '|'); \
-    }; \
-    static type str2 ## type(const char *str) \
+        return type ## 2view(T).String(); \
+    } \
+    static constexpr type str2 ## type(const char *str) \
     { \
-        return static_cast<type>(bias + ConfigParser::get_part_count(str, strings, '|')); \
+        return static_cast<type>(bias + ConfigParser::part_index(str, strings, '|')); \
     }
 
 // config parser class
@@ -55,11 +65,12 @@ public:
             data.resize(cap);
         }
 
-        void Reset() {begin = 0; end = 0; data.clear();}
+        // the storage is kept for reuse
+        void Reset() {begin = 0; end = 0;}
         void Add(char ch)
         {
             if(data.size() <= end)
-                data.resize(2*data.size());
+                data.resize(2*data.size() + 1);
 
             data[end++] = ch;
         }
@@ -77,6 +88,43 @@ public:
         inline char &operator [] (size_t idx) {return data[idx];}
     };
 
+    // a non-owning view of an element, it is valid until the next parsing
+    struct StringView
+    {
+        const char *data;
+        size_t size;
+
+        constexpr StringView() : data(""), size(0) {}
+        constexpr StringView(const char *d, size_t s) : data(d), size(s) {}
+
+        std::string String() const {return std::string(data, size);}
+        bool IsEmpty() const {return size == 0;}
+        bool operator ==(const char *str) const;
+
+        // the numbers are converted without creating strings
+        template<typename T>
+        T Convert() const {return convert(__cv_id<T>());}
+
+    private:
+        template<typename T>
+        T convert(__cv_id<T> &&) const {return ConfigValue(String()).Convert<T>();}
+
+        bool convert(__cv_id<bool> &&) const;
+        short convert(__cv_id<short> &&) const;
+        unsigned short convert(__cv_id<unsigned short> &&) const;
+        int convert(__cv_id<int> &&) const;
+        unsigned int convert(__cv_id<unsigned int> &&) const;
+        long convert(__cv_id<long> &&) const;
+        unsigned long convert(__cv_id<unsigned long> &&) const;
+        long long convert(__cv_id<long long> &&) const;
+        unsigned long long convert(__cv_id<unsigned long long> &&) const;
+        float convert(__cv_id<float> &&) const;
+        double convert(__cv_id<double> &&) const;
+        long double convert(__cv_id<long double> &&) const;
+        std::string convert(__cv_id<std::string> &&) const {return String();}
+        ConfigValue convert(__cv_id<ConfigValue> &&) const {return ConfigValue(String());}
+    };
+
 public:
     ConfigParser(Format f = Format::BashLike());
 
@@ -103,6 +151,10 @@ public:
     // dealing with file/buffer
     bool OpenFile(const std::string &path, size_t cap = 64*1024);
     bool ReadFile(const std::string &path);
+    // map the file into memory, the elements are then kept as views of the
+    // parsed text and taking them does not allocate
+    bool MapFile(const std::string &path);
+    bool IsViewMode() const {return view_mode;}
     void ReadBuffer(const char*);
     void CloseFile();
     void Clear();
@@ -116,23 +168,26 @@ public:
 
     // get current parsing status
     bool CheckElements(int num, int optional = 0);
-    int NbofElements() const {return elements.size();}
+    int NbofElements() const {return (view_mode) ? views.size() - view_pos : elements.size();}
     int LineNumber() const {return line_number;}
     std::string CurrentLine() const {return cur_line.String();}
 
     // take the elements
     ConfigValue TakeFirst();
+    StringView TakeFirstView();
 
     template<typename T>
     T TakeFirst()
     {
+        if(view_mode)
+            return TakeFirstView().Convert<T>();
         return TakeFirst().Convert<T>();
     }
 
     template<typename T>
     ConfigParser &operator >>(T &t)
     {
-        t = (*this).TakeFirst().Convert<T>();
+        t = (*this).TakeFirst<T>();
         return *this;
     }
 
@@ -142,11 +197,15 @@ public:
         int count = 0;
         for(auto it = first; it != last; ++it, ++count)
         {
-            if(elements.empty())
+            if(NbofElements() <= 0)
                 break;
 
-            *it = elements.front();
-            elements.pop_front();
+            if(view_mode) {
+                *it = TakeFirstView().String();
+            } else {
+                *it = elements.front();
+                elements.pop_front();
+            }
         }
         return count;
     }
@@ -155,6 +214,10 @@ public:
     Container<ConfigValue, std::allocator<ConfigValue>> TakeAll()
     {
         Container<ConfigValue, std::allocator<ConfigValue>> res;
+        while(view_mode && NbofElements() > 0)
+        {
+            res.emplace_back(TakeFirstView().String());
+        }
         while(elements.size())
         {
             res.emplace_back(std::move(elements.front()));
@@ -167,6 +230,10 @@ public:
     Container<T, std::allocator<T>> TakeAll()
     {
         Container<T, std::allocator<T>> res;
+        while(view_mode && NbofElements() > 0)
+        {
+            res.emplace_back(TakeFirstView().Convert<T>());
+        }
         while(elements.size())
         {
             ConfigValue tmp(std::move(elements.front()));
@@ -182,6 +249,8 @@ private:
     bool getBuffer();
     bool getLine(CharBuffer &line_buf, bool recursive = false);
     int parseBuffer(const CharBuffer &line);
+    int parseView(const char *str, size_t size);
+    void unmapFile();
 
 private:
     // private members
@@ -190,6 +259,13 @@ private:
     CharBuffer buf, cur_line;
     int line_number;
     std::deque<std::string> elements;
+    // mapped file and the elements as ranges of the parsed text
+    const char *map_data;
+    size_t map_size;
+    bool view_mode;
+    CharBuffer view_text;
+    std::vector<std::pair<size_t, size_t>> views;
+    size_t view_pos;
 
 public:
     // static functions
@@ -200,6 +276,36 @@ public:
     static std::deque<std::string> split(const char* str, const size_t &len, const std::string &s);
     static std::string get_split_part(int num, const char *str, const char &s);
     static int get_part_count(const char *cmp, const char *str, const char &s);
+    // helpers for the parts of a string split by a character, they work on
+    // the string in place and can be evaluated at compile time
+    static constexpr size_t part_size(const char *str, char s)
+    {
+        return (*str == '\0' || *str == s) ? 0 : 1 + part_size(str + 1, s);
+    }
+    // beginning of the num-th part, nullptr if it does not exist
+    static constexpr const char *part_begin(int num, const char *str, char s)
+    {
+        return (num < 0) ? nullptr :
+               (num == 0) ? str :
+               (*str == '\0') ? nullptr : part_begin(num - (*str == s), str + 1, s);
+    }
+    static constexpr bool part_equal(const char *cmp, const char *part, char s)
+    {
+        return (*part == '\0' || *part == s) ? (*cmp == '\0') :
+               (*cmp == *part) && part_equal(cmp + 1, part + 1, s);
+    }
+    // index of the part that is the same as cmp, -1 if not found
+    static constexpr int part_index(const char *cmp, const char *str, char s, int idx = 0)
+    {
+        return part_equal(cmp, str, s) ? idx :
+               (str[part_size(str, s)] == '\0') ? -1 :
+               part_index(cmp, str + part_size(str, s) + 1, s, idx + 1);
+    }
+    static constexpr StringView split_part_view(int num, const char *str, char s)
+    {
+        return (part_begin(num, str, s) == nullptr) ? StringView() :
+               StringView(part_begin(num, str, s), part_size(part_begin(num, str, s), s));
+    }
     static std::vector<int> stois(const std::string &str, const std::string &s, const std::string &w);
     static std::vector<float> stofs(const std::string &str, const std::string &s, const std::string &w);
     static std::vector<double> stods(const std::string &str, const std::string &s, const std::string &w);
@@ -212,6 +318,8 @@ public:
                                                const std::string &close,
                                                size_t pos = 0);
     static bool case_ins_equal(const std::string &str1, const std::string &str2);
+    static bool case_ins_equal(const std::string &str1, const char *str2);
+    static bool case_ins_equal(const char *str1, size_t size1, const char *str2, size_t size2);
     static int find_integer(const std::string &str, const size_t &pos = 0);
     static std::vector<int> find_integers(const std::string &str);
     static void find_integer_helper(const std::string &str, std::vector<int> &result);
@@ -220,6 +328,8 @@ public:
     static std::string compose_path(const PathInfo &path);
     static std::string form_path(const std::string &dir, const std::string &file);
     static std::string file_to_string(const std::string &path);
+    // hash a block of bytes, the seed can be a previous hash to chain them
+    static uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = CONFIG_HASH_SEED);
     // break text file into several blocks in the format
     // <label> <open_mark> <content> <close_mark>, this structure can be separated by sep characters
     // return extracted <residual> {<label> <content>} with white characters trimmed
@@ -13,10 +13,21 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include "ConfigObject.h"
 
 
 
+// a new revision number, 0 is never used so the new handles are resolved
+static uint64_t new_revision()
+{
+    static std::atomic<uint64_t> revision(0);
+    return ++revision;
+}
+
+
+
 //============================================================================//
 // Constructor, Destructor                                                    //
 //============================================================================//
@@ -24,7 +35,8 @@
 // constructor
 ConfigObject::ConfigObject(const std::string &splitter,
                            const std::string &ignore)
-: split_chars(splitter), ignore_chars(ignore), __empty_value("")
+: split_chars(splitter), ignore_chars(ignore), config_rev(new_revision()),
+  __empty_value("")
 {
     // set default replace bracket
     replace_pair = std::make_pair("{", "}");
@@ -49,6 +61,7 @@ void ConfigObject::Configure(const std::string &path)
 
     // clear the map
     config_map.clear();
+    changed("", false);
 
     // read configuration file in
     ReadConfigFile(path);
@@ -59,6 +72,7 @@ void ConfigObject::ClearConfig()
 {
     config_path = "";
     config_map.clear();
+    changed("");
 }
 
 // read configuration file and build the configuration map
@@ -70,6 +84,7 @@ bool ConfigObject::ReadConfigFile(const std::string &path)
     if(c_parser.ReadFile(path)) {
         // current directory
         parserProcess(c_parser, path);
+        changed("");
         return true;
     } else {
         std::cerr << "Cannot open configuration file "
@@ -88,6 +103,7 @@ void ConfigObject::ReadConfigString(const std::string &content)
     c_parser.ReadBuffer(content.c_str());
 
     parserProcess(c_parser, "buffer_string");
+    changed("");
 }
 
 // continue parse the terms
@@ -126,7 +142,7 @@ void ConfigObject::parserProcess(ConfigParser &c_parser, const std::string &sour
 bool ConfigObject::HasKey(const std::string &var_name)
 const
 {
-    std::string key = ConfigParser::str_lower(ConfigParser::str_remove(var_name, ignore_chars));
+    std::string key = formKey(var_name);
     if(config_map.find(key) != config_map.end())
         return true;
     return false;
@@ -154,6 +170,25 @@ const
     return res;
 }
 
+// hash of all the configuration values, independent of the key order
+// it identifies a configuration, e.g., the one used to produce the results
+uint64_t ConfigObject::GetConfigHash(uint64_t seed)
+const
+{
+    std::vector<std::string> keys = GetKeyList();
+    std::sort(keys.begin(), keys.end());
+
+    uint64_t hash = seed;
+    for(auto &key : keys)
+    {
+        const std::string &val = config_map.at(key);
+        // the terminating null separates the strings
+        hash = ConfigParser::hash_bytes(key.c_str(), key.size() + 1, hash);
+        hash = ConfigParser::hash_bytes(val.c_str(), val.size() + 1, hash);
+    }
+    return hash;
+}
+
 // save current configuration into a file
 void ConfigObject::SaveConfig(const std::string &path)
 const
@@ -179,26 +214,34 @@ const
 ConfigValue ConfigObject::GetConfigValue(const std::string &var_name)
 const
 {
-    // convert to lower case and remove uninterested characters
-    std::string key = ConfigParser::str_lower(ConfigParser::str_remove(var_name, ignore_chars));
-
-    auto it = config_map.find(key);
-    if(it == config_map.end()) {
-        return __empty_value;
-    } else {
-        ConfigValue result(it->second);
-        reform(result._value, replace_pair.first, replace_pair.second);
-        return result;
-    }
+    return getConfigValue(formKey(var_name));
 }
 
 // set configuration value by its name/key
 void ConfigObject::SetConfigValue(const std::string &var_name, const ConfigValue &c_value)
 {
-    // convert to lower case and remove uninterested characters
-    std::string key = ConfigParser::str_lower(ConfigParser::str_remove(var_name, ignore_chars));
+    setConfigValue(formKey(var_name), c_value);
+}
 
-    config_map[key] = c_value;
+// add a hook to be notified of the configuration changes, return its id
+int ConfigObject::AddConfigHook(ConfigHook &&hook)
+{
+    int id = config_hooks.id++;
+    config_hooks.hooks.emplace_back(id, std::move(hook));
+    return id;
+}
+
+// remove the hook by its id
+void ConfigObject::RemoveConfigHook(int id)
+{
+    auto &hooks = config_hooks.hooks;
+    for(auto it = hooks.begin(); it != hooks.end(); ++it)
+    {
+        if(it->first == id) {
+            hooks.erase(it);
+            return;
+        }
+    }
 }
 
 
@@ -213,7 +256,7 @@ ConfigValue ConfigObject::getDefConfig(const std::string &name,
                                        const ConfigValue &def_value,
                                        bool verbose)
 {
-    std::string key = ConfigParser::str_lower(ConfigParser::str_remove(name, ignore_chars));
+    std::string key = formKey(name);
 
     auto it = config_map.find(key);
     if(it == config_map.end())
@@ -227,7 +270,7 @@ ConfigValue ConfigObject::getDefConfig(const std::string &name,
                       << def_value
                       << std::endl;
         }
-        config_map[key] = def_value;
+        setConfigValue(key, def_value);
         return def_value;
     }
 
@@ -236,6 +279,45 @@ ConfigValue ConfigObject::getDefConfig(const std::string &name,
     return result;
 }
 
+// convert to lower case and remove uninterested characters, in one pass
+std::string ConfigObject::formKey(const std::string &name)
+const
+{
+    std::string key;
+    key.reserve(name.size());
+    for(auto c : name)
+    {
+        if(ignore_chars.find(c) == std::string::npos)
+            key.push_back(tolower(c));
+    }
+    return key;
+}
+
+// get configuration value by the formed key
+ConfigValue ConfigObject::getConfigValue(const std::string &key)
+const
+{
+    auto it = config_map.find(key);
+    if(it == config_map.end()) {
+        return __empty_value;
+    } else {
+        ConfigValue result(it->second);
+        reform(result._value, replace_pair.first, replace_pair.second);
+        return result;
+    }
+}
+
+// set configuration value by the formed key, nothing changes for the same value
+void ConfigObject::setConfigValue(const std::string &key, const ConfigValue &c_value)
+{
+    auto it = config_map.find(key);
+    if(it != config_map.end() && it->second == c_value._value)
+        return;
+
+    config_map[key] = c_value;
+    changed(key);
+}
+
 // replace the contents inside replace_pair with the configuration value
 void ConfigObject::reform(std::string &input,
                           const std::string &op,
@@ -313,7 +395,7 @@ void ConfigObject::parseControl(const std::string &word)
 void ConfigObject::parseTerm(std::string &&var_name, std::string &&var_value)
 {
     // convert to lower case and remove uninterested characters
-    std::string key = ConfigParser::str_lower(ConfigParser::str_remove(var_name, ignore_chars));
+    std::string key = formKey(var_name);
 
     if(key.back() == '+') {
         key.pop_back();
@@ -326,3 +408,18 @@ void ConfigObject::parseTerm(std::string &&var_name, std::string &&var_value)
         config_map[key] = var_value;
     }
 }
+
+// a new revision for the changed configuration, the handles will be resolved again
+// any value can be affected since the values may refer to the others
+void ConfigObject::changed(const std::string &key, bool notify)
+{
+    config_rev = new_revision();
+
+    if(!notify)
+        return;
+
+    // a copy so the hooks can be removed in the notification
+    auto hooks = config_hooks.hooks;
+    for(auto &hook : hooks)
+        hook.second(key);
+}
@@ -8,7 +8,12 @@
 #include "ConfigParser.h"
 #include <cstring>
 #include <climits>
+#include <cstdlib>
 #include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 using namespace std;
 
@@ -20,21 +25,21 @@ using namespace std;
 
 // constructor, with format input
 ConfigParser::ConfigParser(Format f)
-: form(f), line_number(0)
+: form(f), line_number(0), map_data(nullptr), map_size(0), view_mode(false), view_pos(0)
 {
     // place holder
 }
 
 // copy constructor, only copy format
 ConfigParser::ConfigParser(const ConfigParser &that)
-: form(that.form), line_number(0)
+: form(that.form), line_number(0), map_data(nullptr), map_size(0), view_mode(false), view_pos(0)
 {
     // place holder
 }
 
 // move constructor, only move format
 ConfigParser::ConfigParser(ConfigParser &&that)
-: form(that.form), line_number(0)
+: form(that.form), line_number(0), map_data(nullptr), map_size(0), view_mode(false), view_pos(0)
 {
     // place holder
 }
@@ -100,9 +105,44 @@ bool ConfigParser::ReadFile(const string &path)
     return true;
 }
 
+// map the whole file into memory, the lines are read from the mapped memory
+// and the elements are views of the parsed text
+bool ConfigParser::MapFile(const string &path)
+{
+    Clear();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+
+    map_size = st.st_size;
+    if(map_size > 0) {
+        void *addr = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr == MAP_FAILED) {
+            close(fd);
+            map_size = 0;
+            return false;
+        }
+        map_data = static_cast<const char*>(addr);
+    }
+    close(fd);
+
+    buf.begin = 0;
+    buf.end = map_size;
+    view_mode = true;
+    return true;
+}
+
 // close file
 void ConfigParser::CloseFile()
 {
+    unmapFile();
     return infile.close();
 }
 
@@ -115,6 +155,12 @@ void ConfigParser::Clear()
     line_number = 0;
     cur_line.Reset();
 
+    // reset views
+    view_mode = false;
+    view_text.Reset();
+    views.clear();
+    view_pos = 0;
+
     // close file
     CloseFile();
 }
@@ -136,8 +182,11 @@ void ConfigParser::ReadBuffer(const char *buf_in)
 bool ConfigParser::ParseLine()
 {
     elements.clear();
+    view_text.Reset();
+    views.clear();
+    view_pos = 0;
 
-    while(elements.empty())
+    while(NbofElements() == 0)
     {
         if(!getLine(cur_line))
             return false;
@@ -145,7 +194,10 @@ bool ConfigParser::ParseLine()
         // count the line number
         ++line_number;
 
-        parseBuffer(cur_line);
+        if(view_mode)
+            parseView(&cur_line[cur_line.begin], cur_line.end - cur_line.begin);
+        else
+            parseBuffer(cur_line);
     }
 
     return true;
@@ -156,16 +208,22 @@ bool ConfigParser::ParseLine()
 bool ConfigParser::ParseAll()
 {
     elements.clear();
+    view_text.Reset();
+    views.clear();
+    view_pos = 0;
 
     while(true)
     {
         if(!getLine(cur_line))
-            return !elements.empty();
+            return NbofElements() > 0;
 
         // count the line number
         ++line_number;
 
-        parseBuffer(cur_line);
+        if(view_mode)
+            parseView(&cur_line[cur_line.begin], cur_line.end - cur_line.begin);
+        else
+            parseBuffer(cur_line);
     }
 }
 
@@ -173,6 +231,9 @@ bool ConfigParser::ParseAll()
 // the trail white spaces in the elements will be trimmed
 int ConfigParser::ParseString(const string &line)
 {
+    if(view_mode)
+        return parseView(line.c_str(), line.size());
+
     deque<string> eles = split(line.c_str(), line.size(), form.split);
 
     int count = 0;
@@ -193,10 +254,11 @@ int ConfigParser::ParseString(const string &line)
 bool ConfigParser::CheckElements(int num, int optional)
 {
     string num_str;
+    size_t nele = NbofElements();
 
     if(optional > 0) {
-        if((elements.size() >= (size_t)num) &&
-           (elements.size() <= (size_t)(num + optional))) {
+        if((nele >= (size_t)num) &&
+           (nele <= (size_t)(num + optional))) {
             return true;
         }
 
@@ -204,14 +266,14 @@ bool ConfigParser::CheckElements(int num, int optional)
 
     } else if(optional == 0) {
 
-        if(elements.size() == (size_t)num) {
+        if(nele == (size_t)num) {
             return true;
         }
 
         num_str = to_string(num);
 
     } else { // optional < 0
-        if(elements.size() >= (size_t)num) {
+        if(nele >= (size_t)num) {
             return true;
         }
 
@@ -232,6 +294,9 @@ bool ConfigParser::CheckElements(int num, int optional)
 // take the first element
 ConfigValue ConfigParser::TakeFirst()
 {
+    if(view_mode)
+        return ConfigValue(TakeFirstView().String());
+
     if(elements.empty()) {
         cout << "Config Parser Warning: Trying to take elements while there is "
              << "nothing, 0 value returned." << endl;
@@ -244,6 +309,20 @@ ConfigValue ConfigParser::TakeFirst()
     return output;
 }
 
+// take the first element as a view of the parsed text, it only works in the
+// view mode and the view is valid until the next parsing
+ConfigParser::StringView ConfigParser::TakeFirstView()
+{
+    if(!view_mode || view_pos >= views.size()) {
+        cout << "Config Parser Warning: Trying to take elements while there is "
+             << "nothing, 0 value returned." << endl;
+        return StringView("0", 1);
+    }
+
+    auto &range = views[view_pos++];
+    return StringView(&view_text[range.first], range.second - range.first);
+}
+
 
 
 //============================================================================//
@@ -257,7 +336,7 @@ bool ConfigParser::getBuffer()
     if(buf.begin < buf.end)
         return true;
 
-    if(!infile.is_open() || infile.bad() || infile.eof())
+    if(map_data || !infile.is_open() || infile.bad() || infile.eof())
         return false;
 
     infile.read(&buf.data[0], buf.data.size());
@@ -335,10 +414,12 @@ bool ConfigParser::getLine(CharBuffer &line_buf, bool recursive)
     while(getBuffer())
     {
         success = true;
+        // read from the mapped file or the buffer
+        const char *src = (map_data) ? map_data : &buf.data[0];
 
         while(buf.begin < buf.end)
         {
-            auto &ch = buf[buf.begin++];
+            const char &ch = src[buf.begin++];
             switch(stat.val)
             {
             default:
@@ -409,6 +490,179 @@ int ConfigParser::parseBuffer(const CharBuffer &line)
     return count;
 }
 
+// copy a string to the view text and split it into elements, the elements are
+// kept as ranges of the view text so the text can grow
+int ConfigParser::parseView(const char *str, size_t size)
+{
+    size_t offset = view_text.end;
+    for(size_t i = 0; i < size; ++i)
+        view_text.Add(str[i]);
+
+    size_t ele_begin = offset;
+    int count = 0;
+
+    // intended to visit i == view_text.end, so the rest of the string get parsed
+    for(size_t i = offset; i <= view_text.end; ++i)
+    {
+        if(i == view_text.end || form.split.find(view_text[i]) != string::npos) {
+            size_t ele_end = i;
+            trimbuf(view_text.data, ele_begin, ele_end, form.white);
+            if(ele_begin < ele_end) {
+                views.emplace_back(ele_begin, ele_end);
+                count++;
+            }
+            ele_begin = i + 1;
+        }
+    }
+
+    return count;
+}
+
+// release the mapped file
+void ConfigParser::unmapFile()
+{
+    if(map_data) {
+        munmap(const_cast<char*>(map_data), map_size);
+        map_data = nullptr;
+        map_size = 0;
+        buf.begin = buf.end = 0;
+    }
+}
+
+
+
+//============================================================================//
+// String View                                                                //
+//============================================================================//
+
+bool ConfigParser::StringView::operator ==(const char *str)
+const
+{
+    return (strlen(str) == size) && (strncmp(str, data, size) == 0);
+}
+
+// case insensitive comparison to a c string
+inline bool view_case_equal(const ConfigParser::StringView &v, const char *str)
+{
+    return ConfigParser::case_ins_equal(v.data, v.size, str, strlen(str));
+}
+
+// convert the view with a c conversion function, the view is copied to a
+// null-terminated buffer on stack
+template<typename T, class Func>
+inline T view_to_number(const ConfigParser::StringView &v, Func func, const char *type)
+{
+    char tmp[128];
+    if(v.size >= sizeof(tmp))
+        return ConfigValue(v.String()).Convert<T>();
+
+    memcpy(tmp, v.data, v.size);
+    tmp[v.size] = '\0';
+
+    char *end;
+    auto val = func(tmp, &end);
+    if(end == tmp) {
+        cerr << "Config Value: Failed to convert "
+             << tmp << " to " << type << ". 0 returned." << endl;
+        return 0;
+    }
+    return static_cast<T>(val);
+}
+
+inline long long view_strtoll(const char *str, char **end) {return strtoll(str, end, 10);}
+inline unsigned long long view_strtoull(const char *str, char **end) {return strtoull(str, end, 10);}
+
+bool ConfigParser::StringView::convert(__cv_id<bool> &&)
+const
+{
+    if((*this == "1") ||
+       view_case_equal(*this, "T") ||
+       view_case_equal(*this, "True") ||
+       view_case_equal(*this, "Y") ||
+       view_case_equal(*this, "Yes"))
+        return true;
+
+    if((*this == "0") ||
+       view_case_equal(*this, "F") ||
+       view_case_equal(*this, "False") ||
+       view_case_equal(*this, "N") ||
+       view_case_equal(*this, "No"))
+        return false;
+
+    cout << "Config Value: Failed to convert "
+         << String() << " to bool type. Return false."
+         << endl;
+    return false;
+}
+
+short ConfigParser::StringView::convert(__cv_id<short> &&)
+const
+{
+    return view_to_number<short>(*this, view_strtoll, "short");
+}
+
+unsigned short ConfigParser::StringView::convert(__cv_id<unsigned short> &&)
+const
+{
+    return view_to_number<unsigned short>(*this, view_strtoull, "unsigned short");
+}
+
+int ConfigParser::StringView::convert(__cv_id<int> &&)
+const
+{
+    return view_to_number<int>(*this, view_strtoll, "int");
+}
+
+unsigned int ConfigParser::StringView::convert(__cv_id<unsigned int> &&)
+const
+{
+    return view_to_number<unsigned int>(*this, view_strtoull, "unsigned int");
+}
+
+long ConfigParser::StringView::convert(__cv_id<long> &&)
+const
+{
+    return view_to_number<long>(*this, view_strtoll, "long");
+}
+
+unsigned long ConfigParser::StringView::convert(__cv_id<unsigned long> &&)
+const
+{
+    return view_to_number<unsigned long>(*this, view_strtoull, "unsigned long");
+}
+
+long long ConfigParser::StringView::convert(__cv_id<long long> &&)
+const
+{
+    return view_to_number<long long>(*this, view_strtoll, "long long");
+}
+
+unsigned long long ConfigParser::StringView::convert(__cv_id<unsigned long long> &&)
+const
+{
+    return view_to_number<unsigned long long>(*this, view_strtoull, "unsigned long long");
+}
+
+float ConfigParser::StringView::convert(__cv_id<float> &&)
+const
+{
+    return view_to_number<float>(*this, strtof, "float");
+}
+
+double ConfigParser::StringView::convert(__cv_id<double> &&)
+const
+{
+    return view_to_number<double>(*this, strtod, "double");
+}
+
+long double ConfigParser::StringView::convert(__cv_id<long double> &&)
+const
+{
+    return view_to_number<long double>(*this, strtold, "long double");
+}
+
+
+
 //============================================================================//
 // Public Static Function                                                     //
 //============================================================================//
@@ -568,67 +822,13 @@ vector<double> ConfigParser::stods(const string &str, const string &s, const str
 // get the split part at num
 string ConfigParser::get_split_part(int num, const char *str, const char &s)
 {
-    // unavailable
-    if(num < 0) return "";
-
-    int beg = 0, cur = 0;
-    while(str[cur] != '\0')
-    {
-        if(str[cur] == s) {
-            // number macthed
-            if(num-- == 0) {
-                return string(&str[beg], cur - beg);
-            // update segment
-            } else {
-                beg = cur + 1;
-            }
-        }
-        ++cur;
-    }
-
-    // last element
-    if(num == 0)
-        return string(&str[beg], cur - beg);
-
-    return "";
-}
-
-// check if the short string is the same with the first part of a long string
-bool cstr_cmp_helper(const char *cmp, const char *str, int size)
-{
-    for(int i = 0; i < size; ++i)
-    {
-        if(cmp[i] != str[i] || cmp[i] == '\0' || str[i] == '\0')
-            return false;
-    }
-
-    if(cmp[size] != '\0')
-        return false;
-
-    return true;
+    return split_part_view(num, str, s).String();
 }
 
 // split a long string and find if a short string is belong to its elements
 int ConfigParser::get_part_count(const char *cmp, const char *str, const char &s)
 {
-    int cnt = 0, beg = 0, cur = 0;
-    while(str[cur] != '\0')
-    {
-        if(str[cur] == s) {
-            if(cstr_cmp_helper(cmp, &str[beg], cur - beg)) {
-                return cnt;
-            }
-
-            ++cnt;
-            beg = cur + 1;
-        }
-        ++cur;
-    }
-
-    if(cstr_cmp_helper(cmp, &str[beg], cur-beg))
-        return cnt;
-
-    return -1;
+    return part_index(cmp, str, s);
 }
 
 // find the integer in a string
@@ -762,13 +962,24 @@ string ConfigParser::str_replace(const string &str, const string &list, const ch
 // compare two strings, can be case insensitive
 bool ConfigParser::case_ins_equal(const string &str1, const string &str2)
 {
-    if(str1.size() != str2.size()) {
+    return case_ins_equal(str1.data(), str1.size(), str2.data(), str2.size());
+}
+
+// compare to a c string, no temporary string is created
+bool ConfigParser::case_ins_equal(const string &str1, const char *str2)
+{
+    return case_ins_equal(str1.data(), str1.size(), str2, strlen(str2));
+}
+
+bool ConfigParser::case_ins_equal(const char *str1, size_t size1, const char *str2, size_t size2)
+{
+    if(size1 != size2) {
         return false;
     }
 
-    for(auto c1 = str1.begin(), c2 = str2.begin(); c1 != str1.end(); ++c1, ++c2)
+    for(size_t i = 0; i < size1; ++i)
     {
-        if(tolower(*c1) != tolower(*c2)) {
+        if(tolower(str1[i]) != tolower(str2[i])) {
             return false;
         }
     }
@@ -910,6 +1121,19 @@ string ConfigParser::file_to_string(const string &path)
     return str;
 }
 
+// 64-bit FNV-1a hash, it is not cryptographic but stable across platforms
+uint64_t ConfigParser::hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 // break text file into several blocks in the format
 // <label> <open_mark> <content> <close_mark>
 // return extracted <residual> {<label> <content>}
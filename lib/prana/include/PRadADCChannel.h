@@ -5,8 +5,13 @@
 #include <vector>
 #include <iostream>
 #include <unordered_map>
+#include <atomic>
 #include "PRadDAQChannel.h"
+#ifndef PRAD_NO_ROOT
 #include "TH1.h"
+#else
+class TH1;
+#endif
 
 
 class PRadHyCalModule;
@@ -55,8 +60,15 @@ public:
     // reset data
     void Reset();
 
+    // zero suppression threshold from pedestal, shared with the bank sparsifier
+    static unsigned short SparsifyThreshold(const Pedestal &p)
+    {
+        return (unsigned short)(p.mean + 5.*p.sigma + 0.5); // round
+    }
+
     // check if adc passed threshold
-    void Sparsify() {occupancy++;}
+    void Sparsify() {occupancy.fetch_add(1, std::memory_order_relaxed);}
+    void AddOccupancy(int n) {occupancy.fetch_add(n, std::memory_order_relaxed);}
     bool Sparsify (const unsigned short &adcVal);
     int GetOccupancy() const {return occupancy;}
     unsigned short GetValue() const {return adc_value;}
@@ -67,18 +79,23 @@ public:
     PRadHyCalModule *GetModule() const {return module;}
     PRadTDCChannel *GetTDC() const {return tdc_group;}
 
-    // histograms manipulations
+    // histograms manipulations, the channels have no histograms without ROOT
     void ResetHists();
     void ClearHists();
+    void MergeHists(const PRadADCChannel &that);
     bool AddHist(const std::string &name, TH1 *hist);
     bool MapHist(const std::string &name, int trg);
     void RemoveHist(const std::string &name);
     template<typename T>
     void FillHist(const T& t, int trg)
     {
+#ifndef PRAD_NO_ROOT
         if(trg_hist[trg]) {
             trg_hist[trg]->Fill(t);
         }
+#else
+        (void)t, (void)trg;
+#endif
     }
     TH1 *GetHist(const std::string &name = "Physics") const;
     TH1 *GetHist(PRadTriggerType type) const {return trg_hist[(int)type];}
@@ -88,7 +105,8 @@ protected:
     PRadHyCalModule *module;
     PRadTDCChannel *tdc_group;
     Pedestal pedestal;
-    int occupancy;
+    // events may be decoded in parallel
+    std::atomic<int> occupancy;
     unsigned short sparsify;
     unsigned short adc_value;
     // histograms
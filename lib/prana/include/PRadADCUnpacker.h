@@ -0,0 +1,52 @@
+#ifndef PRAD_ADC_UNPACKER_H
+#define PRAD_ADC_UNPACKER_H
+
+#include <cstdint>
+#include <cstddef>
+
+// maximum number of words unpacked at a time, a Fastbus board has at most 127
+// words by the word count in its header
+#define ADC_UNPACK_BLOCK 128
+
+
+// unpack the data words of Fastbus ADC1881M, the words of a board are
+// contiguous, and the run stops at the first word from another slot
+// the channels and values are written to the staging arrays, the kernel is
+// chosen at runtime as PRadSparsifier does
+class PRadADCUnpacker
+{
+public:
+    typedef size_t (*Kernel)(const uint32_t *words, size_t n, uint32_t slot,
+                             uint16_t *channels, uint16_t *values);
+
+    enum KernelType
+    {
+        Scalar = 0,
+        AVX2,
+    };
+
+    // staging arrays of the unpacked words
+    struct Staging
+    {
+        uint16_t channel[ADC_UNPACK_BLOCK];
+        uint16_t value[ADC_UNPACK_BLOCK];
+    };
+
+public:
+    PRadADCUnpacker();
+
+    // unpack at most ADC_UNPACK_BLOCK words
+    // return the number of words belong to the slot
+    size_t Unpack(const uint32_t *words, size_t n, uint32_t slot, Staging &out) const;
+    void SetKernel(KernelType type);
+    KernelType GetKernel() const {return ktype;}
+
+    // cpu dispatch
+    static KernelType BestKernel();
+
+private:
+    KernelType ktype;
+    Kernel kernel;
+};
+
+#endif
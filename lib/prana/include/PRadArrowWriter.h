@@ -0,0 +1,118 @@
+#ifndef PRAD_ARROW_WRITER_H
+#define PRAD_ARROW_WRITER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include "PRadEventStruct.h"
+
+// number of events in a record batch, the memory is bounded by one batch
+#define ARROW_BATCH_EVENTS 10000
+
+// export events to the Apache Arrow IPC streaming format, so they can be read
+// as tables by pyarrow (pyarrow.ipc.open_stream) without other conversions
+// the events are written as record batches with one list column per bank,
+// and the epics events are written to a separate stream
+// the format is written directly, no Arrow library is required
+class PRadArrowWriter
+{
+public:
+    // a column of the schema
+    struct Field
+    {
+        enum Kind {Int, Float, List, Struct};
+
+        std::string name;
+        Kind kind;
+        int bits;
+        bool is_signed;
+        std::vector<Field> children;
+
+        Field(const std::string &n, Kind k, int b = 0, bool s = false)
+        : name(n), kind(k), bits(b), is_signed(s) {}
+        Field(const std::string &n, Kind k, const std::vector<Field> &c)
+        : name(n), kind(k), bits(0), is_signed(false), children(c) {}
+    };
+
+    // a record batch being built
+    struct Batch
+    {
+        int64_t length;
+        std::vector<int64_t> nodes;     // length of every field in pre-order
+        std::vector<char> body;
+        std::vector<int64_t> buffers;   // offset and length pairs in body
+
+        Batch() : length(0) {}
+        void Clear() {length = 0; nodes.clear(); body.clear(); buffers.clear();}
+        void AddBuffer(const void *data, size_t size);
+        template<typename T>
+        void AddColumn(const std::vector<T> &vals)
+        {
+            nodes.push_back(vals.size());
+            AddBuffer(nullptr, 0);
+            AddBuffer(vals.data(), vals.size()*sizeof(T));
+        }
+        void AddList(const std::vector<int32_t> &offsets);
+        void AddStruct(int64_t size);
+    };
+
+    // an output stream
+    struct Stream
+    {
+        std::ofstream out;
+        std::vector<Field> schema;
+        Batch batch;
+        uint64_t batches;
+
+        Stream() : batches(0) {}
+    };
+
+public:
+    PRadArrowWriter(uint32_t batch_events = ARROW_BATCH_EVENTS);
+    virtual ~PRadArrowWriter();
+
+    PRadArrowWriter(const PRadArrowWriter &) = delete;
+    PRadArrowWriter &operator =(const PRadArrowWriter &) = delete;
+
+    // epics events are not written if epics_path is empty
+    bool Open(const std::string &event_path, const std::string &epics_path = "");
+    void Close();
+    void Write(const EventData &ev);
+    void Write(const EpicsData &ep);
+    uint64_t GetEventBatches() const {return events.batches;}
+    uint64_t GetEPICSBatches() const {return epics.batches;}
+
+    static std::vector<Field> EventSchema();
+    static std::vector<Field> EPICSSchema();
+
+private:
+    bool openStream(Stream &s, const std::string &path, const std::vector<Field> &schema);
+    void closeStream(Stream &s);
+    void writeMessage(Stream &s, const std::vector<char> &meta, const std::vector<char> &body);
+    void flushEvents();
+    void flushEPICS();
+    void clearEvents();
+
+private:
+    uint32_t batch_size;
+    Stream events, epics;
+
+    // columns of the current event batch
+    std::vector<int32_t> ev_number;
+    std::vector<uint8_t> ev_type, ev_trigger;
+    std::vector<uint64_t> ev_timestamp;
+    std::vector<int32_t> adc_offsets, tdc_offsets, gem_offsets, dsc_offsets;
+    std::vector<uint16_t> adc_channel, adc_value, tdc_channel, tdc_value;
+    std::vector<uint8_t> gem_fec, gem_adc, gem_strip;
+    std::vector<int32_t> sample_offsets;
+    std::vector<float> gem_samples;
+    std::vector<uint32_t> dsc_gated, dsc_ungated;
+
+    // columns of the current epics batch
+    std::vector<int32_t> ep_number;
+    std::vector<int32_t> ep_offsets;
+    std::vector<float> ep_values;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef PRAD_ASYNC_IO_H
+#define PRAD_ASYNC_IO_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// requests in flight of a queue
+#define ASYNC_IO_DEPTH 8
+// size of the segments of the sequential reader and writer
+#define ASYNC_IO_SEGMENT (4UL << 20)
+// threads of the fallback backend
+#define ASYNC_IO_THREADS 4
+
+
+// queue of asynchronous file reads and writes at given offsets
+// with io_uring (built with LIB_OPTION IO_URING on linux), the requests are
+// submitted to the kernel ring, and the registered buffers are used by the
+// fixed-buffer operations, so the pages are not mapped for every request
+// otherwise, or if the kernel refuses the ring, a small pool of threads does
+// pread/pwrite, and without MULTI_THREAD the requests are done at submission
+// a queue belongs to one thread, the reader and writer below are the users
+class PRadAsyncIO
+{
+public:
+    enum Backend
+    {
+        Backend_Sync = 0,       // done at submission
+        Backend_Threads,        // pread/pwrite on the pool threads
+        Backend_IOUring,        // kernel ring
+    };
+
+    struct Completion
+    {
+        uint64_t tag;
+        int64_t result;         // bytes transferred, -errno on failure
+    };
+
+public:
+    PRadAsyncIO(unsigned int depth = ASYNC_IO_DEPTH, Backend prefer = Backend_IOUring);
+    virtual ~PRadAsyncIO();
+
+    PRadAsyncIO(const PRadAsyncIO &) = delete;
+    PRadAsyncIO &operator =(const PRadAsyncIO &) = delete;
+
+    // the buffers are used by their index in the submissions, it should be
+    // called before any submission, false if they are only used as plain ones
+    bool RegisterBuffers(const std::vector<void*> &bufs, size_t bytes);
+
+    // submit a request, the tag is returned with its completion, buf_index is
+    // the registered buffer containing buf, or -1
+    // it waits for a completion if the queue is full, it is kept for Wait
+    bool SubmitRead(int fd, void *buf, size_t bytes, int64_t offset, uint64_t tag,
+                    int buf_index = -1);
+    bool SubmitWrite(int fd, const void *buf, size_t bytes, int64_t offset, uint64_t tag,
+                     int buf_index = -1);
+    // wait for a completion, false if no request is in flight
+    bool Wait(Completion &comp);
+
+    unsigned int InFlight() const {return in_flight + kept.size();}
+    unsigned int GetDepth() const {return depth;}
+    Backend GetBackend() const {return backend;}
+    bool HasRegisteredBuffers() const {return registered;}
+    static const char *BackendName(Backend b);
+
+private:
+    struct Request
+    {
+        bool write;
+        int fd;
+        void *buf;
+        size_t bytes;
+        int64_t offset;
+        uint64_t tag;
+        int buf_index;
+    };
+
+    class Ring;
+    class Pool;
+
+    bool submit(const Request &req);
+    bool reap(Completion &comp);
+    static int64_t transfer(const Request &req);
+
+private:
+    unsigned int depth, in_flight;
+    Backend backend;
+    bool registered;
+    std::unique_ptr<Ring> ring;
+    std::unique_ptr<Pool> pool;
+    // completions taken while waiting for a free slot
+    std::deque<Completion> kept;
+};
+
+
+// sequential reading of a file, the following segments are read while the
+// current one is copied out, it is used as the input stream of the evio files
+class PRadAsyncReader
+{
+public:
+    PRadAsyncReader(unsigned int depth = ASYNC_IO_DEPTH, size_t segment = ASYNC_IO_SEGMENT);
+    virtual ~PRadAsyncReader();
+
+    PRadAsyncReader(const PRadAsyncReader &) = delete;
+    PRadAsyncReader &operator =(const PRadAsyncReader &) = delete;
+
+    bool Open(const std::string &path);
+    void Close();
+    // restart the reading from the offset
+    void Seek(int64_t offset);
+    // copy the next bytes, the returned count is less than requested at the end
+    // of file or a read failure
+    size_t Read(void *buf, size_t bytes);
+
+    bool IsOpen() const {return fd >= 0;}
+    bool Good() const {return good;}
+    int64_t Tell() const {return pos;}
+    int64_t Size() const {return size;}
+    const PRadAsyncIO &GetIO() const {return io;}
+
+private:
+    struct Segment
+    {
+        char *data;
+        int64_t offset;
+        // requested and read bytes, the copied ones
+        size_t request, length, cursor;
+        bool busy;
+    };
+
+    void issue(size_t index);
+    void complete(const PRadAsyncIO::Completion &comp);
+    void drain();
+
+private:
+    PRadAsyncIO io;
+    size_t seg_size;
+    std::vector<Segment> segs;
+    int fd;
+    int64_t size, pos, next_offset;
+    size_t head;
+    bool good;
+};
+
+
+// sequential writing of a file from an offset, the bytes are gathered in
+// segments, and several full segments are written while the next is filled
+class PRadAsyncWriter
+{
+public:
+    PRadAsyncWriter(unsigned int depth = ASYNC_IO_DEPTH, size_t segment = ASYNC_IO_SEGMENT);
+    virtual ~PRadAsyncWriter();
+
+    PRadAsyncWriter(const PRadAsyncWriter &) = delete;
+    PRadAsyncWriter &operator =(const PRadAsyncWriter &) = delete;
+
+    // truncate the file, or write into the existing file from the offset
+    bool Open(const std::string &path, bool truncate = true, int64_t offset = 0);
+    // return false if the file is not writable or a write failed
+    bool Close();
+    bool Write(const void *buf, size_t bytes);
+    // wait for the written segments
+    bool Flush();
+
+    bool IsOpen() const {return fd >= 0;}
+    bool Good() const {return good;}
+    // the end of the written and gathered bytes
+    int64_t Tell() const {return offset + (int64_t)segs[current].length;}
+    const PRadAsyncIO &GetIO() const {return io;}
+
+private:
+    struct Segment
+    {
+        char *data;
+        int64_t offset;
+        size_t length;
+        bool busy;
+    };
+
+    void submit();
+    void complete(const PRadAsyncIO::Completion &comp);
+
+private:
+    PRadAsyncIO io;
+    size_t seg_size;
+    std::vector<Segment> segs;
+    int fd;
+    int64_t offset;
+    size_t current;
+    bool good;
+};
+
+#endif // PRAD_ASYNC_IO_H
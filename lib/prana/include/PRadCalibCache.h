@@ -0,0 +1,125 @@
+#ifndef PRAD_CALIB_CACHE_H
+#define PRAD_CALIB_CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// version of the cache format, the caches of other versions are regenerated
+#define CALIB_CACHE_VERSION 1
+// maximum length of the module and channel names
+#define CALIB_CACHE_NAME 16
+// maximum number of the reference gains
+#define CALIB_CACHE_GAINS 8
+
+// binary cache of the run dependent constants read from the text files,
+// one cache file for one run, it contains the calibration constants and the
+// run information (reference gains, pedestals, LMS and status)
+// the file consists of fixed size records so it is mapped into memory and
+// used in place, it is valid only if its source files are not changed
+class PRadCalibCache
+{
+public:
+    // identification of a source file, size is -1 if the file does not exist
+    struct Stamp
+    {
+        uint64_t path_hash;
+        int64_t size;
+        int64_t mtime;
+
+        bool operator ==(const Stamp &rhs) const
+        {return path_hash == rhs.path_hash && size == rhs.size && mtime == rhs.mtime;}
+        bool operator !=(const Stamp &rhs) const {return !(*this == rhs);}
+    };
+
+    // a line in the calibration file
+    struct CalibEntry
+    {
+        char name[CALIB_CACHE_NAME];
+        uint32_t ngains;
+        double factor, energy, non_linear;
+        double gains[CALIB_CACHE_GAINS];
+    };
+
+    // a line in the run information file
+    struct StatusEntry
+    {
+        char name[CALIB_CACHE_NAME];
+        uint32_t status;
+        double ped_mean, ped_sigma, lms_mean, lms_sigma;
+    };
+
+    // reference pmt gains, the first line of the run information file
+    struct RefGains
+    {
+        uint32_t ref, ngains;
+        double gains[CALIB_CACHE_GAINS];
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        int32_t run;
+        Stamp calib_src, info_src;
+        uint32_t calib_read, info_read;
+        uint32_t ncalib, nstatus;
+        RefGains ref_gains;
+    };
+
+public:
+    PRadCalibCache(int run = 0);
+    virtual ~PRadCalibCache();
+
+    PRadCalibCache(const PRadCalibCache &) = delete;
+    PRadCalibCache &operator =(const PRadCalibCache &) = delete;
+
+    // records from the text files
+    void Reset(int run);
+    void SetCalibRead(bool r) {calib_read = r;}
+    void SetInfoRead(bool r) {info_read = r;}
+    void AddCalib(const std::string &name, double factor, double energy, double nl,
+                  const std::vector<double> &gains);
+    void SetRefGains(unsigned int ref, const std::vector<double> &gains);
+    void AddStatus(const std::string &name, double ped_mean, double ped_sigma,
+                   double lms_mean, double lms_sigma, unsigned int status);
+
+    // cache file, the sources are checked against the stamps in the cache
+    bool Save(const std::string &path, const std::string &calib_src,
+              const std::string &info_src) const;
+    bool Load(const std::string &path, int run, const std::string &calib_src,
+              const std::string &info_src);
+    void Close();
+
+    // the records, from the mapped file if it is loaded
+    int GetRun() const {return run;}
+    bool IsValid() const {return valid;}
+    bool IsCalibRead() const {return calib_read;}
+    bool IsInfoRead() const {return info_read;}
+    const RefGains &GetRefGains() const {return ref_gains;}
+    size_t GetCalibCount() const {return ncalib;}
+    const CalibEntry *GetCalib() const {return calib;}
+    size_t GetStatusCount() const {return nstatus;}
+    const StatusEntry *GetStatus() const {return status;}
+
+    static Stamp GetStamp(const std::string &path);
+    static std::string GetName(const char *name);
+
+private:
+    int run;
+    bool valid, calib_read, info_read;
+    RefGains ref_gains;
+    const CalibEntry *calib;
+    const StatusEntry *status;
+    size_t ncalib, nstatus;
+
+    // recorded entries
+    std::vector<CalibEntry> calib_buf;
+    std::vector<StatusEntry> status_buf;
+
+    // mapped file
+    const char *addr;
+    size_t length;
+};
+
+#endif // PRAD_CALIB_CACHE_H
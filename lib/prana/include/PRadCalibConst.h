@@ -25,6 +25,8 @@ public:
     void SetCalibEnergy(double energy) {base_energy = energy;}
     void SetNonLinearFactor(double nl) {non_linear = nl;}
     void GainCorrection(double gain, int ref);
+    // restore the corrected factor, the base factor is not changed
+    void SetCorrectedConst(double f) {factor = f;}
 
     double GetCalibConst() const {return factor;}
     double GetRefGain(int ref) const;
@@ -0,0 +1,175 @@
+#ifndef PRAD_CALIB_PIPELINE_H
+#define PRAD_CALIB_PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include "PRadEventStruct.h"
+#include "PRadInfoCenter.h"
+#include "PRadCoordSystem.h"
+#include "PRadEvioParser.h"
+
+// default number of events in a work unit, the units are taken by the workers
+#define CALIB_UNIT_EVENTS 50000
+// number of events reconstructed by one batch call
+#define CALIB_BATCH_EVENTS 2000
+
+class TH1;
+class PRadHyCalSystem;
+class PRadGEMSystem;
+class PRadDetMatch;
+class PRadDSTReader;
+
+// a reconstructed event handed to the analyzers, the hits are transformed to
+// the beam frame and projected to the HyCal surface
+struct CalibEvent
+{
+    const EventData *event;
+    // the last epics event before this event, nullptr if there is none
+    const EpicsData *epics;
+    // the system of the worker, it can be used to choose this event for the
+    // module energies
+    PRadHyCalSystem *hycal_sys;
+    int run;
+    std::vector<HyCalHit> hycal_hits;
+    std::vector<GEMHit> gem1_hits;
+    std::vector<GEMHit> gem2_hits;
+    std::vector<MatchHit> matched;
+
+    CalibEvent() : event(nullptr), epics(nullptr), hycal_sys(nullptr), run(0) {}
+};
+
+// base class of the analyzers in the calibration pipeline
+// the analyzer is cloned for every worker, the clones fill their own
+// histograms, and they are merged back to the original one at the end
+class PRadCalibAnalyzer
+{
+public:
+    PRadCalibAnalyzer() {}
+    virtual ~PRadCalibAnalyzer();
+
+    PRadCalibAnalyzer(const PRadCalibAnalyzer &) = delete;
+    PRadCalibAnalyzer &operator =(const PRadCalibAnalyzer &) = delete;
+
+    // a new analyzer with empty results, it is called in the pipeline thread
+    virtual PRadCalibAnalyzer *Clone() const = 0;
+    // called by a worker thread for every accepted event
+    virtual void Process(const CalibEvent &event) = 0;
+    // merge the results of a clone, the booked histograms are added
+    virtual void Merge(const PRadCalibAnalyzer &that);
+    // called once after all the clones are merged
+    virtual void Finish() {}
+
+    const std::vector<TH1*> &GetHists() const {return hists;}
+
+protected:
+    // the histogram is owned by the analyzer and detached from the ROOT
+    // directories, so the clones can fill them in different threads, they are
+    // merged in the booking order
+    template<class T>
+    T *Book(T *hist)
+    {
+        bookHist(hist);
+        return hist;
+    }
+
+private:
+    void bookHist(TH1 *hist);
+
+private:
+    std::vector<TH1*> hists;
+};
+
+class PRadCalibPipeline
+{
+public:
+    // a worker has its own copies of the systems, run information and the
+    // analyzer, the buffers are reused between the batches
+    struct Worker
+    {
+        PRadInfoCenter info;
+        PRadHyCalSystem *hycal;
+        PRadGEMSystem *gem;
+        PRadCoordSystem coord;
+        PRadCalibAnalyzer *analyzer;
+        int file;
+        int count;
+        std::vector<EventData> events;
+        std::vector<std::vector<HyCalHit>> hycal_hits;
+        std::vector<std::vector<GEMHit>> gem_hits;
+        CalibEvent event;
+
+        Worker(const PRadCalibPipeline &pipeline, const PRadCalibAnalyzer &ana);
+        ~Worker();
+    };
+
+    // an input file, the epics events are read in advance for the look-up
+    struct Input
+    {
+        PRadDSTReader *reader;
+        std::vector<EpicsData> epics;
+
+        const EpicsData *FindEPICS(int event_number) const;
+    };
+
+    // a range of events in a file, or a range of chunks for the chunked format
+    struct Unit
+    {
+        int file;
+        size_t begin, end;
+    };
+
+public:
+    // nthreads 0 means using all the hardware threads
+    PRadCalibPipeline(unsigned int nthreads = 0);
+    virtual ~PRadCalibPipeline();
+
+    PRadCalibPipeline(const PRadCalibPipeline &) = delete;
+    PRadCalibPipeline &operator =(const PRadCalibPipeline &) = delete;
+
+    // the systems are cloned for the workers, the detector match is shared
+    void SetHyCalSystem(PRadHyCalSystem *hycal) {hycal_sys = hycal;}
+    void SetGEMSystem(PRadGEMSystem *gem) {gem_sys = gem;}
+    void SetCoordSystem(PRadCoordSystem *coord) {coord_sys = coord;}
+    void SetDetMatch(PRadDetMatch *match) {det_match = match;}
+    void SetThreads(unsigned int n);
+    void SetUnitEvents(size_t n) {unit_events = (n > 0) ? n : CALIB_UNIT_EVENTS;}
+    // only the events with accepted triggers are reconstructed, 0 accepts all
+    void SetTriggerMask(uint32_t mask) {trigger_mask = mask;}
+    void AcceptTrigger(const PRadTriggerType &trg) {trigger_mask |= PRadEvioParser::trigger_to_bit(trg);}
+    unsigned int GetThreads() const {return threads;}
+    uint32_t GetTriggerMask() const {return trigger_mask;}
+
+    // process the DST files in parallel, the results are merged to analyzer
+    // return the number of processed events
+    int Process(const std::vector<std::string> &files, PRadCalibAnalyzer *analyzer);
+
+private:
+    bool openInputs(const std::vector<std::string> &files);
+    void closeInputs();
+    void work(Worker *worker);
+    void chooseFile(Worker *worker, int file);
+    size_t readEvents(Worker *worker, const Input &input, size_t begin, size_t end);
+    size_t readChunk(Worker *worker, const Input &input, size_t chunk);
+    void analyze(Worker *worker, const Input &input, size_t n);
+    bool accept(const EventData &event) const;
+    void report(int count);
+
+private:
+    PRadHyCalSystem *hycal_sys;
+    PRadGEMSystem *gem_sys;
+    PRadCoordSystem *coord_sys;
+    PRadDetMatch *det_match;
+    unsigned int threads;
+    size_t unit_events;
+    uint32_t trigger_mask;
+
+    std::vector<Input> inputs;
+    std::vector<Unit> units;
+    std::atomic<size_t> next_unit;
+    std::atomic<size_t> done_units;
+    std::mutex print_locker;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef PRAD_CALIB_SNAPSHOT_H
+#define PRAD_CALIB_SNAPSHOT_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "PRadTriggerConst.h"
+#include "PRadClusterDensity.h"
+
+
+class PRadHyCalSystem;
+class PRadHyCalDetector;
+class PRadHyCalModule;
+
+// an immutable copy of the calibration of a run taken from the hycal system
+// the pedestals are indexed by the adc channel id, and the calibration
+// constants are indexed by the module index in the detector
+// a snapshot is shared by reference counting, the system can switch to other
+// runs while the reconstruction threads still use the taken snapshots
+// the modules are not copied, so the detector layout must not be changed
+class PRadCalibSnapshot
+{
+public:
+    typedef std::shared_ptr<const PRadCalibSnapshot> Ptr;
+
+    // take the calibration of the current run from the system
+    static Ptr Take(const PRadHyCalSystem &sys);
+
+public:
+    PRadCalibSnapshot(const PRadHyCalSystem &sys);
+    virtual ~PRadCalibSnapshot();
+
+    PRadCalibSnapshot(const PRadCalibSnapshot &) = delete;
+    PRadCalibSnapshot &operator =(const PRadCalibSnapshot &) = delete;
+
+    // run information
+    int GetRunNumber() const {return run;}
+    const PRadHyCalDetector *GetDetector() const {return detector;}
+    PRadClusterDensity::SetEnum GetDensitySet() const {return density_set;}
+
+    // adc channels
+    size_t GetChannelCount() const {return ch_module.size();}
+    PRadHyCalModule *GetModule(uint16_t ch) const
+    {return (ch < ch_module.size()) ? ch_module[ch] : nullptr;}
+    double GetPedestalMean(uint16_t ch) const {return ped_mean[ch];}
+    double GetPedestalSigma(uint16_t ch) const {return ped_sigma[ch];}
+    bool IsDead(uint16_t ch) const {return ch_dead[ch];}
+    // energy of the adc value, the channel must have a module
+    double GetEnergy(uint16_t ch, uint16_t value) const
+    {
+        double val = (double)value - ped_mean[ch];
+        return (val < 0.) ? 0. : factor[ch_index[ch]]*val;
+    }
+    // flat arrays by adc channel id for collecting the module hits, they have
+    // one more entry at the end for the channels out of range, the channels
+    // without a module have zero factor and the type PRadHyCalModule::Max_Types
+    const double *GetPedestalData() const {return ped_mean.data();}
+    const double *GetChannelFactorData() const {return ch_factor.data();}
+    const uint8_t *GetChannelTypeData() const {return ch_type.data();}
+    int GetModuleID(uint16_t ch) const {return ch_id[ch];}
+
+    // modules
+    size_t GetModuleCount() const {return factor.size();}
+    double GetCalibFactor(int idx) const {return factor[idx];}
+    double GetCalibEnergy(int idx) const {return base_energy[idx];}
+    double GetNonLinearFactor(int idx) const {return non_linear[idx];}
+    float NonLinearCorr(int idx, float E) const
+    {return non_linear[idx]*(E - base_energy[idx])/1000.;}
+    double GetTriggerEfficiency(int idx, double E) const
+    {return trg_const[idx].GetTriggerEfficiency(E);}
+
+private:
+    int run;
+    PRadClusterDensity::SetEnum density_set;
+    const PRadHyCalDetector *detector;
+
+    // by adc channel id
+    std::vector<PRadHyCalModule*> ch_module;
+    std::vector<int> ch_index;
+    std::vector<double> ped_mean, ped_sigma;
+    std::vector<uint8_t> ch_dead;
+    std::vector<double> ch_factor;
+    std::vector<uint8_t> ch_type;
+    std::vector<int> ch_id;
+
+    // by module index
+    std::vector<double> factor, base_energy, non_linear;
+    std::vector<PRadTriggerConst> trg_const;
+};
+
+#endif // PRAD_CALIB_SNAPSHOT_H
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <unordered_map>
 #include "PRadEventStruct.h"
 #include "ConfigParser.h"
@@ -10,6 +11,12 @@
 
 
 #define NB_ECORR_PARS 8
+// version of the binary parameter format
+#define DENSITY_BIN_VERSION 1
+// geometry index of the modules not in the table
+#define GEO_INDEX_UNKNOWN -2
+
+class PRadHyCalDetector;
 
 
 class PRadClusterDensity
@@ -36,6 +43,11 @@ public:
         std::vector<Params> ppars;
         std::unordered_map<int, Params> epars_ee, epars_ep;
 
+        // dense tables indexed by module id, NB_ECORR_PARS parameters for
+        // every module, the valid flag is 0 if the module has no parameters
+        std::vector<float> ep_table, ee_table;
+        std::vector<uint8_t> ep_valid, ee_valid;
+
         void Resize(int ng, int ne, int np)
         {
             ppars.resize(ng*ne);
@@ -47,28 +59,61 @@ public:
         }
     };
 
+    // header of the binary parameter file, it is followed by the energy range,
+    // the x and y position parameters of every group, and the energy parameters
+    // as EneEntry for ep and ee, the hash is calculated from the data after it
+    struct BinHeader
+    {
+        char magic[8];
+        uint32_t version;
+        float beam_energy;
+        uint32_t nrange, ngroups, npars;
+        uint32_t nep, nee;
+        uint64_t hash;
+    };
+
+    struct EneEntry
+    {
+        int32_t id;
+        float pars[NB_ECORR_PARS];
+    };
+
 public:
     PRadClusterDensity();
     virtual ~PRadClusterDensity();
 
+    // a binary file as p_path contains both parts, e_path is not used then
     bool Load(int is, const std::string &p_path, const std::string &e_path);
+    bool SaveBinary(int is, const std::string &path) const;
     void CorrectBias(const ModuleHit &ctr, HyCalHit &hit, bool pos, bool ene) const;
+    void CorrectBias(const ModuleHit &ctr, HyCalHit &hit, bool pos, bool ene, SetEnum iset) const;
     float GetPosBias(const std::vector<float> &pars, const float &dx) const;
     float GetEneBias(const std::vector<float> &pars, const float &dx,
                      const float &dy, const float &E0) const;
+    float GetEneBias(const float *pars, const float &dx,
+                     const float &dy, const float &E0) const;
 
     void ChooseSet(SetEnum iset) {cur_set = iset;}
+    SetEnum GetSet() const {return cur_set;}
+    void UpdateLayout(const PRadHyCalDetector *det);
 
 private:
-    int getEnergyIndex(float energy, float theta, float res) const;
+    int getEnergyIndex(const ParamsSet &pset, float energy, float theta, float res) const;
     int getGeometryIndex(const ModuleHit &center) const;
     bool processPosPars(ConfigParser &c_parser, ParamsSet &pset);
     bool processEnePars(ConfigParser &c_parser, ParamsSet &pset);
+    int loadBinary(ParamsSet &pset, const std::string &path);
+    void buildEneTables(ParamsSet &pset);
+    inline int geometryIndex(const ModuleHit &center) const;
+    inline const float *eneParams(const std::vector<float> &table,
+                                  const std::vector<uint8_t> &valid, int id) const;
 
 
 private:
     SetEnum cur_set;
     ParamsSet psets[Max_SetEnums];
+    // geometry index of the modules from the detector layout
+    std::vector<int> geo_index;
 };
 
 #endif // PRAD_CLUSTER_DENSITY_H
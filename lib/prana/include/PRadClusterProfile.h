@@ -3,8 +3,13 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include "PRadEventStruct.h"
 
+// the rows of the flattened profile table are padded to this number of floats
+#define PROFILE_ROW_ALIGN 16
+// version of the binary profile format
+#define PROFILE_BIN_VERSION 1
 
 class PRadHyCalDetector;
 
@@ -24,6 +29,11 @@ public:
         double max_dist, step_dist;
         std::vector<std::vector<Value>> values;
 
+        // flattened table for the batch look-up, [energy][distance] in rows
+        size_t row_size;
+        float max_dist_f;
+        std::vector<float> frac_table, err_table;
+
         void Resize(int Ne, int Nd)
         {
             // energy grids
@@ -33,17 +43,59 @@ public:
                 e_prof.resize(Nd);
         }
 
+        void Flatten();
+
         typedef std::vector<std::vector<Value>>::size_type size_type;
         inline std::vector<Value> &operator [] (size_type i) {return values[i];}
         inline const std::vector<Value> &operator [] (size_type i) const {return values[i];}
     };
 
+    // the distance profile at one energy, it points to the flattened table
+    // and is valid until the profile is loaded again
+    struct Row
+    {
+        int type;
+        float energy, w1, w2, max_dist;
+        double step;
+        const float *frac1, *frac2, *err1, *err2;
+
+        Row()
+        : type(-1), energy(0.), w1(1.), w2(0.), max_dist(0.), step(1.),
+          frac1(nullptr), frac2(nullptr), err1(nullptr), err2(nullptr)
+        {}
+
+        void Get(const float *dist, float *frac, float *err, size_t n) const;
+    };
+
+    // header of the binary profile file, it is followed by the values in
+    // [energy][distance] order, the hash is calculated from the values
+    struct BinHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t ne, nd;
+        uint32_t reserved;
+        double min_ene, max_ene, step_ene;
+        double max_dist, step_dist;
+        uint64_t hash;
+    };
+
 public:
     PRadClusterProfile();
     virtual ~PRadClusterProfile();
 
+    // the file can be either the text profile or the binary one
     void Load(int type, const std::string &path);
+    bool SaveBinary(int type, const std::string &path) const;
     Value Get(int type, double dist, double energy) const;
+    // profiles of n distances at the same energy, err can be nullptr
+    void GetBatch(int type, const float *dist, float energy,
+                  float *frac, float *err, size_t n) const;
+    Row GetRow(int type, float energy) const;
+    const Row &GetRow(int type, float energy, Row &cache) const;
+
+private:
+    int loadBinary(Profile &profile, const std::string &path);
 
 private:
     std::vector<Profile> profiles;
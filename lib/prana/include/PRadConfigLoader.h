@@ -0,0 +1,54 @@
+#ifndef PRAD_CONFIG_LOADER_H
+#define PRAD_CONFIG_LOADER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iostream>
+#include <functional>
+#include "PRadBenchMark.h"
+
+
+class PRadTaskPool;
+
+// load independent configuration resources concurrently
+// the resources must be joined by Wait before they are used, and at most one
+// of the tasks may create ROOT objects since the directories are not locked
+class PRadConfigLoader
+{
+public:
+    typedef std::function<void()> Task;
+
+    struct Resource
+    {
+        std::string name;
+        unsigned int time;      // loading time in msec
+        bool success;
+        std::string error;
+    };
+
+public:
+    PRadConfigLoader(unsigned int nthreads = 0);
+    virtual ~PRadConfigLoader();
+
+    PRadConfigLoader(const PRadConfigLoader &) = delete;
+    PRadConfigLoader &operator =(const PRadConfigLoader &) = delete;
+
+    void Add(const std::string &name, Task &&task);
+    void Wait();
+    void Report(std::ostream &os = std::cout) const;
+    const std::vector<Resource> &GetResources() const {return resources;}
+    unsigned int GetElapsedTime() const {return total_time;}
+
+private:
+    void load(const std::string &name, const Task &task);
+
+private:
+    PRadTaskPool *pool;
+    std::mutex locker;
+    std::vector<Resource> resources;
+    PRadBenchMark timer;
+    unsigned int total_time;
+};
+
+#endif
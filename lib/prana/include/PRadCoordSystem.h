@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include <iostream>
 #include <cmath>
 #include "canalib.h"
@@ -42,6 +43,60 @@ struct RunCoord
 
 std::ostream &operator <<(std::ostream &os, const RunCoord &coord);
 
+// 3x4 affine matrix, row major, the last column is the translation
+struct AffineMatrix
+{
+    float m[12];
+
+    AffineMatrix() : m{1., 0., 0., 0., 0., 1., 0., 0., 0., 0., 1., 0.} {}
+
+    inline void Apply(float &x, float &y, float &z) const
+    {
+        float xi = x, yi = y, zi = z;
+        x = m[0]*xi + m[1]*yi + m[2]*zi + m[3];
+        y = m[4]*xi + m[5]*yi + m[6]*zi + m[7];
+        z = m[8]*xi + m[9]*yi + m[10]*zi + m[11];
+    }
+
+    // arrays of coordinates, the loop has no dependency so it can be vectorized
+    void Apply(float *x, float *y, float *z, size_t n) const;
+};
+
+// coordinates of a run and the matrices calculated from them, indexed by
+// detector id
+struct RunCoordEntry
+{
+    RunCoord coord;
+    std::vector<AffineMatrix> trans_mat, inv_mat;
+
+    RunCoordEntry(const RunCoord &c = RunCoord());
+};
+
+// coordinates of all the runs with their matrices, it is not changed after it
+// is built, so the copies of the coordinate system share one table, and
+// choosing a run only changes the entry they point to
+class PRadCoordTable
+{
+public:
+    // the runs should be in order
+    PRadCoordTable(const std::vector<RunCoord> &coords = std::vector<RunCoord>());
+
+    PRadCoordTable(const PRadCoordTable &) = delete;
+    PRadCoordTable &operator =(const PRadCoordTable &) = delete;
+
+    // the nearest previous run, the first one if the run is before all of
+    // them, nullptr if the table is empty
+    const RunCoordEntry *Find(int run) const;
+    const RunCoordEntry *At(size_t i) const {return (i < entries.size()) ? &entries[i] : nullptr;}
+    const std::vector<RunCoord> &GetCoords() const {return coords;}
+    size_t size() const {return entries.size();}
+    bool empty() const {return entries.empty();}
+
+private:
+    std::vector<RunCoord> coords;
+    std::vector<RunCoordEntry> entries;
+};
+
 class PRadCoordSystem
 {
 public:
@@ -56,14 +111,27 @@ public:
 
     // set members
     bool SetCurrentCoord(const RunCoord &coords);
+    // share a coordinate table and choose the run from it
+    void SetCoordTable(std::shared_ptr<const PRadCoordTable> tab, int run = 0);
 
     // get members
-    const std::vector<RunCoord> &GetCoordsData() const {return coords_data;}
-    RunCoord GetCurrentCoords() const {return current_coord;}
+    const std::vector<RunCoord> &GetCoordsData() const {return table->GetCoords();}
+    std::shared_ptr<const PRadCoordTable> GetCoordTable() const {return table;}
+    RunCoord GetCurrentCoords() const {return current->coord;}
 
-    // basic transform functions
+    // basic transform functions, they use the matrices calculated when the
+    // current coordinates are changed
     void Transform(int det_id, float &x, float &y, float &z) const;
     void InvTransform(int det_id, float &x, float &y, float &z) const;
+    // transform arrays of coordinates
+    void TransformBatch(int det_id, float *x, float *y, float *z, size_t n) const;
+    void InvTransformBatch(int det_id, float *x, float *y, float *z, size_t n) const;
+    // transform the hit columns, the gem hits are transformed by the runs of
+    // the same det_id
+    void Transform(int det_id, HyCalHitSoA &hits) const;
+    void Transform(GEMHitSoA &hits) const;
+    const AffineMatrix &GetTransMatrix(int det_id) const {return current->trans_mat.at(det_id);}
+    const AffineMatrix &GetInvTransMatrix(int det_id) const {return current->inv_mat.at(det_id);}
 
     // template functions
     // transform for clusters with det_id
@@ -86,9 +154,10 @@ public:
     void Transform(int det_id, T *t, int NCluster)
     const
     {
+        const AffineMatrix &mat = current->trans_mat.at(det_id);
         for(int i = 0; i < NCluster; ++i)
         {
-            Transform(det_id, t[i].x, t[i].y, t[i].z);
+            mat.Apply(t[i].x, t[i].y, t[i].z);
         }
     }
 
@@ -97,9 +166,10 @@ public:
     void Transform(int det_id, T_it first, T_it last)
     const
     {
+        const AffineMatrix &mat = current->trans_mat.at(det_id);
         for(T_it it = first; it != last; ++it)
         {
-            Transform(det_id, (*it).x, (*it).y, (*it).z);
+            mat.Apply((*it).x, (*it).y, (*it).z);
         }
     }
 
@@ -108,9 +178,10 @@ public:
     void TransformHits(DetPtr det)
     const
     {
+        const AffineMatrix &mat = current->trans_mat.at(det->GetDetID());
         for(auto it = det->GetHits().begin(); it != det->GetHits().end(); ++it)
         {
-            Transform(det->GetDetID(), it->x, it->y, it->z);
+            mat.Apply(it->x, it->y, it->z);
         }
     }
 
@@ -121,7 +192,7 @@ public:
                     int det_id = (int)PRadDetector::HyCal)
     const
     {
-        float zf = current_coord.dets[det_id].trans.z;
+        float zf = current->coord.dets[det_id].trans.z;
         Projection(t.x, t.y, t.z, pi.x, pi.y, pi.z, zf);
     }
 
@@ -141,7 +212,7 @@ public:
                     int det_id = (int)PRadDetector::HyCal)
     const
     {
-        float zf = current_coord.dets[det_id].trans.z;
+        float zf = current->coord.dets[det_id].trans.z;
         for(int i = 0; i < NCluster; ++i)
         {
             Projection(t[i].x, t[i].y, t[i].z, pi.x, pi.y, pi.z, zf);
@@ -164,7 +235,7 @@ public:
                     int det_id = (int)PRadDetector::HyCal)
     const
     {
-        float zf = current_coord.dets[det_id].trans.z;
+        float zf = current->coord.dets[det_id].trans.z;
         for(T_it it = first; it != last; ++it)
         {
             Projection((*it).x, (*it).y, (*it).z, pi.x, pi.y, pi.z, zf);
@@ -188,6 +259,13 @@ public:
     static void Projection(float &x, float &y, float &z, const Point &pi, const float &zf);
     static float ProjectionDistance(Point p1, Point p2, Point ori, float proj_z);
     static Point ProjectionCoordDiff(Point p1, Point p2, Point ori, float proj_z);
+    // project arrays of points from pi to zf, the projected x and y are
+    // written to px and py, the loops can be vectorized
+    static void ProjectionBatch(const float *x, const float *y, const float *z, size_t n,
+                                const Point &pi, float zf, float *px, float *py);
+    // project the hit columns in place
+    static void Projection(HyCalHitSoA &hits, const Point &pi, float zf);
+    static void Projection(GEMHitSoA &hits, const Point &pi, float zf);
 
     template<class T1, class T2>
     static inline float ProjectionDistance(const T1 &t1, const T2 &t2, Point ori = target(), float proj_z = hycal_z())
@@ -227,8 +305,13 @@ public:
 
 
 protected:
-    RunCoord current_coord;
-    std::vector<RunCoord> coords_data;
+    // the coordinates are at the origin before any run is chosen
+    static const RunCoordEntry &defaultEntry();
+
+protected:
+    std::shared_ptr<const PRadCoordTable> table;
+    // the entry of the current run in the table
+    const RunCoordEntry *current;
 };
 
 #endif
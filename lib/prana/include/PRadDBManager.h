@@ -0,0 +1,126 @@
+#ifndef PRAD_DB_MANAGER_H
+#define PRAD_DB_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#ifdef MULTI_THREAD
+#include <thread>
+#include <condition_variable>
+#endif
+#include "PRadCalibCache.h"
+
+// number of runs kept in the in-process cache
+#define DB_CACHE_RUNS 64
+
+
+// the run dependent constants of HyCal (calibration constants and run info)
+// for the run switches, the records of a run are read once and shared by all
+// the systems of the process, such as the copies used by the workers
+// the records are from an sqlite database (built with LIB_OPTION SQLITE), or
+// parsed from the text files, the runs parsed from the text files are added to
+// the database, and the database records are used only if their text files
+// are unchanged or not available
+// the next runs of a job can be read ahead on a background thread, so the run
+// switches take them from the cache without reading any file
+class PRadDBManager
+{
+public:
+    // source files of a run
+    struct RunFiles
+    {
+        int run;
+        std::string calib, info;
+
+        RunFiles(int r = 0, const std::string &c = "", const std::string &i = "")
+        : run(r), calib(c), info(i) {}
+        bool operator ==(const RunFiles &rhs) const
+        {return run == rhs.run && calib == rhs.calib && info == rhs.info;}
+    };
+
+    typedef std::shared_ptr<const PRadCalibCache> Record;
+
+    struct Stats
+    {
+        uint64_t hits, misses, prefetched, db_reads, file_reads;
+
+        Stats() : hits(0), misses(0), prefetched(0), db_reads(0), file_reads(0) {}
+    };
+
+public:
+    static PRadDBManager &Instance();
+
+    // the database is created if it does not exist
+    bool OpenDatabase(const std::string &path);
+    void CloseDatabase();
+    bool IsDatabaseOpen() const;
+
+    // the systems use the cache once it is enabled, by opening a database,
+    // prefetching or SetCacheEnabled
+    void SetCacheEnabled(bool e) {enabled = e;}
+    bool IsCacheEnabled() const {return enabled;}
+    void SetCacheRuns(size_t n);
+    void ClearCache();
+
+    // the records of a run, it waits if the run is being prefetched, and reads
+    // it now if it is not in the cache
+    // nullptr if the files cannot be read or the records cannot be kept (such
+    // as a too long module name), the systems read the text files then
+    Record GetRun(const RunFiles &files);
+    // read the runs on the background thread, without MULTI_THREAD they are
+    // read now
+    void Prefetch(const std::vector<RunFiles> &runs);
+    Stats GetStats() const;
+
+    // parse the text files to the records, the formats are the ones read by
+    // PRadHyCalDetector::ReadCalibrationFile and
+    // PRadHyCalSystem::ReadRunInfoFile
+    static bool ReadCalibFile(const std::string &path, PRadCalibCache &rec);
+    static bool ReadRunInfoFile(const std::string &path, PRadCalibCache &rec);
+
+private:
+    PRadDBManager();
+    ~PRadDBManager();
+    PRadDBManager(const PRadDBManager &) = delete;
+    PRadDBManager &operator =(const PRadDBManager &) = delete;
+
+    struct Entry
+    {
+        RunFiles files;
+        Record rec;
+        bool loading;
+        uint64_t used;
+    };
+
+    Record load(const RunFiles &files);
+    Record readDatabase(const RunFiles &files);
+    void writeDatabase(const RunFiles &files, const PRadCalibCache &rec);
+    void store(const RunFiles &files, const Record &rec);
+    void evict();
+    void prefetch();
+
+private:
+    bool enabled;
+    size_t max_runs;
+    uint64_t use_count;
+    std::map<int, Entry> cache;
+    std::deque<RunFiles> queue;
+    Stats stats;
+    mutable std::mutex locker;
+
+    // sqlite3 handle, it has its own lock
+    void *db;
+    mutable std::mutex db_locker;
+
+#ifdef MULTI_THREAD
+    std::thread worker;
+    std::condition_variable cond;
+    bool stop;
+#endif
+};
+
+#endif // PRAD_DB_MANAGER_H
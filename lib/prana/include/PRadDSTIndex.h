@@ -0,0 +1,80 @@
+#ifndef PRAD_DST_INDEX_H
+#define PRAD_DST_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "PRadEventStruct.h"
+
+// magic word and version of the saved index file
+#define DST_INDEX_MAGIC 0x58444950
+#define DST_INDEX_VERSION 1
+
+
+class PRadDSTReader;
+
+// index of the events in a set of DST files from different runs
+// the events are sorted by (run, event number), so any event in the dataset is
+// found by binary search and read directly from its file with the file map
+// the index can be saved and loaded, the files are only opened on reading
+class PRadDSTIndex
+{
+public:
+    struct Entry
+    {
+        int32_t run;
+        int32_t event_number;
+        uint64_t timestamp;
+        uint32_t file;          // index of the file in the list
+        uint32_t index;         // index of the event in the file
+
+        bool operator <(const Entry &rhs) const
+        {
+            return (run < rhs.run) || (run == rhs.run && event_number < rhs.event_number);
+        }
+    };
+
+public:
+    PRadDSTIndex();
+    virtual ~PRadDSTIndex();
+
+    PRadDSTIndex(const PRadDSTIndex &that) = delete;
+    PRadDSTIndex &operator =(const PRadDSTIndex &rhs) = delete;
+
+    // run number is taken from the file name if it is not positive
+    bool AddFile(const std::string &path, int run = 0);
+    void Clear();
+    bool Save(const std::string &path) const;
+    bool Load(const std::string &path);
+
+    // index of the entry, -1 if it is not found
+    int Find(int run, int event_number) const;
+    // the first event of the run at or after the time
+    int FindTime(int run, uint64_t timestamp) const;
+    // the events of the run are in [first, last)
+    std::pair<size_t, size_t> GetRunRange(int run) const;
+
+    // read the event from its file, the files are opened on demand so it
+    // should not be called from multiple threads
+    bool ReadEvent(size_t i, EventData &event);
+
+    size_t size() const {return entries.size();}
+    const Entry &operator [](size_t i) const {return entries[i];}
+    const std::vector<Entry> &GetEntries() const {return entries;}
+    const std::vector<std::string> &GetFiles() const {return files;}
+    std::vector<int> GetRuns() const;
+
+private:
+    void sortEntries();
+    PRadDSTReader *getReader(uint32_t file);
+
+private:
+    std::vector<std::string> files;
+    std::vector<Entry> entries;
+    // entry indices sorted by (run, timestamp)
+    std::vector<uint32_t> time_order;
+    std::vector<std::unique_ptr<PRadDSTReader>> readers;
+};
+
+#endif
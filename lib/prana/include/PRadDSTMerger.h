@@ -0,0 +1,38 @@
+#ifndef PRAD_DST_MERGER_H
+#define PRAD_DST_MERGER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// size of a single copy from an input to the output
+#define DST_MERGE_BLOCK 67108864 // 64 MB
+
+// concatenate DST files into one, the record contents of the inputs are
+// copied as they are with large sequential writes, and only the event map is
+// rebuilt, the inputs are copied in parallel to their places in the output
+// files of different versions are merged record by record through the parser
+class PRadDSTMerger
+{
+public:
+    PRadDSTMerger(unsigned int nthreads = 1);
+    virtual ~PRadDSTMerger();
+
+    void SetThreads(unsigned int n);
+    unsigned int GetThreads() const {return threads;}
+
+    bool Merge(const std::vector<std::string> &inputs, const std::string &output);
+    // merged content size and number of events (including epics and recon)
+    uint64_t GetMergedBytes() const {return merged_bytes;}
+    size_t GetMergedRecords() const {return merged_records;}
+
+private:
+    bool mergeRecords(const std::vector<std::string> &inputs, const std::string &output);
+
+private:
+    unsigned int threads;
+    uint64_t merged_bytes;
+    size_t merged_records;
+};
+
+#endif
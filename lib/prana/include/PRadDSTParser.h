@@ -2,10 +2,38 @@
 #define PRAD_DST_PARSER_H
 
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <functional>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "PRadException.h"
 #include "PRadEventStruct.h"
+#include "PRadRunSummary.h"
+
+// asynchronous output, the serialized buffers are coalesced into chunks and
+// written by a writer thread
+#define DST_WRITE_CHUNK 8388608 // 8 MB
+#define DST_WRITE_QUEUE 4       // number of chunks, including being filled
+
+// chunked format, a number of events are encoded and compressed together
+#define DST_CHUNK_EVENTS 1000   // default events per chunk
+#define DST_CHUNK_LEVEL 3       // default compression level
+
+// checkpoints, the positions of the recent records are saved every a number
+// of records, so a file not closed properly can be indexed from them
+#define DST_CHECKPOINT_RECORDS 1000 // default records between checkpoints
+
+// delta epics records, only the channels changed since the previous epics
+// record are saved, with a keyframe of all the channels every a number of them
+#define DST_EPICS_KEYFRAME 100   // default epics records between keyframes
+
+// the records start after the file header and content length
+#define DST_CONTENT_BEGIN 16
 
 
 
@@ -18,6 +46,17 @@ public:
         FileHeader = 0xa1b1,
         EventHeader = 0xa2b2,
         MapHeader = 0xa3b3,
+        SummaryHeader = 0xa4b4,
+    };
+
+    // data banks of an event, to select the banks to be decoded
+    enum Bank : uint32_t
+    {
+        ADC_Bank = 1 << 0,
+        TDC_Bank = 1 << 1,
+        GEM_Bank = 1 << 2,
+        DSC_Bank = 1 << 3,
+        All_Banks = 0xf,
     };
 
     enum class Type : uint16_t
@@ -25,6 +64,10 @@ public:
         // event types
         event = 0,
         epics,
+        chunk,
+        recon,
+        checkpoint,
+        update,
         max_type,
     };
 
@@ -101,6 +144,48 @@ public:
         }
     };
 
+    // statistics of the asynchronous output
+    struct WriteStats
+    {
+        uint64_t bytes, writes, submits;
+        size_t max_depth;
+        double depth_sum, write_time, wait_time;
+
+        WriteStats() {Reset();}
+        void Reset()
+        {
+            bytes = writes = submits = 0;
+            max_depth = 0;
+            depth_sum = write_time = wait_time = 0.;
+        }
+        // in MB/s
+        double Throughput() const {return (write_time > 0.) ? bytes/write_time/1e3 : 0.;}
+        double AvgDepth() const {return submits ? depth_sum/submits : 0.;}
+    };
+
+    // a copy of an input record, it can be written to the other outputs
+    // without being decoded and re-encoded
+    struct RawRecord
+    {
+        Header header;
+        uint16_t version;
+        bool in_chunk;      // an event encoded in a chunk
+        std::vector<char> data;
+
+        RawRecord() : version(0), in_chunk(false) {}
+    };
+
+    // a checkpoint record, it has the positions of the records written since
+    // the previous checkpoint and the numbers written so far
+    struct Checkpoint
+    {
+        int64_t position, previous;     // previous is -1 for the first one
+        uint64_t events, epics, recons;
+        Map map;
+
+        Checkpoint() : position(-1), previous(-1), events(0), epics(0), recons(0) {}
+    };
+
 public:
     // constructor
     PRadDSTParser(uint32_t size = 1000000);
@@ -121,15 +206,58 @@ public:
                     std::ios::openmode mode = std::ios::out | std::ios::binary);
     void OpenInput(const std::string &path,
                    std::ios::openmode mode = std::ios::in | std::ios::binary);
+    bool ResumeOutput(const std::string &path, Checkpoint &ckpt);
+    // in-place update of a closed file, the replacements of the records are
+    // appended as an update record, followed by a new map and the content
+    // length is moved to it, the replaced records and the old map are left in
+    // the file and skipped, so the cost is the changed records and the map
+    // the file is opened as the input, so the records can be read to modify
+    bool OpenUpdate(const std::string &path);
+    // replace the record at pos (from the input map) by a record of the same
+    // type, the chunk of the chunked format is replaced as a whole
+    // an epics record is replaced by a keyframe, the delta records after it
+    // are applied to its values
+    bool Replace(int64_t pos, const EventData &ev);
+    bool Replace(int64_t pos, const EpicsData &ep);
+    bool Replace(int64_t pos, const ReconData &rec);
+    bool ReplaceChunk(int64_t pos, const std::vector<EventData> &events);
+    // write the update to the file, the file is reopened for more updates
+    bool CommitUpdate();
+    // discard the replacements not committed and close the file
+    void CloseUpdate();
+    bool IsUpdating() const {return upd_active;}
+    size_t GetReplacedCount() const {return upd_pairs.size();}
+    // the input has updates, they are compacted by a copy of the file
+    bool IsInputUpdated() const {return in_updated;}
     void CloseOutput();
     void CloseInput();
     void ResizeBuffer(uint32_t size);
+    void SetAsyncOutput(bool async);
+    bool IsAsyncOutput() const {return async_out;}
+    const WriteStats &GetWriteStats() const {return write_stats;}
+    void SetChunkedOutput(uint32_t nevents = DST_CHUNK_EVENTS, int level = DST_CHUNK_LEVEL);
+    uint32_t GetChunkSize() const {return chunk_size;}
+    // a checkpoint is written every nrecords records, 0 disables it
+    void SetCheckpoint(uint32_t nrecords = DST_CHECKPOINT_RECORDS) {ckpt_interval = nrecords;}
+    uint32_t GetCheckpoint() const {return ckpt_interval;}
+    // a keyframe of all the epics channels is written every nrecords epics
+    // records, the others are delta records, 0 disables the delta records
+    // it should be set before opening the output file
+    void SetEPICSDelta(uint32_t nrecords = DST_EPICS_KEYFRAME);
+    uint32_t GetEPICSDelta() const {return epics_keyframe;}
+    // the banks not in the mask are skipped and left empty when reading
+    void SetBankMask(uint32_t mask) {bank_mask = mask;}
+    uint32_t GetBankMask() const {return bank_mask;}
+    uint16_t GetInputVersion() const {return in_version;}
 
     // write information
     void WriteEvent() throw(PRadException);
     void WriteEPICS() throw(PRadException);
     void Write(const EventData &data) throw(PRadException);
     void Write(const EpicsData &data) throw(PRadException);
+    void WriteRecon() throw(PRadException);
+    void Write(const ReconData &data) throw(PRadException);
+    void WriteRecord(const RawRecord &rec) throw(PRadException);
 
     // get information from current buffer
     bool Read(int64_t pos = -1);
@@ -137,24 +265,153 @@ public:
     Type EventType() const {return cur_evh.GetType(EventHeader);}
     uint32_t GetBufSize() const {return buf_size;}
     EventData GetEvent() const;
+    bool GetEvent(EventData &ev) const;
     EpicsData GetEPICS() const;
+    bool GetEPICS(EpicsData &ep) const;
+    ReconData GetRecon() const;
+    bool GetRecon(ReconData &rec) const;
+    bool GetRecord(RawRecord &rec) const;
+    // decoded into the memory kept by parser, valid until the next call
+    const EventData &GetCurrentEvent() const;
+    const EpicsData &GetCurrentEPICS() const;
+    const ReconData &GetCurrentRecon() const;
     const Map &GetInputMap() const {return in_map;}
     const Map &GetOutputMap() const {return out_map;}
+    // summary of the written events, it is saved after the map on closing, the
+    // summaries of the inputs should be merged to it if their records are
+    // copied, otherwise it is marked as not complete
+    PRadRunSummary &GetOutputSummary() {return out_summary;}
+    const PRadRunSummary &GetOutputSummary() const {return out_summary;}
+    // summary of the input file, it is read when the input is opened
+    bool HasInputSummary() const {return in_has_summary;}
+    const PRadRunSummary &GetInputSummary() const {return in_summary;}
+
+    // decode the record buffers, shared with the other DST readers
+    static bool DecodeEvent(const char *buf, uint32_t length, EventData &ev,
+                            uint32_t mask = All_Banks, uint16_t version = Version());
+    // a delta epics record is applied to ep, which should have the values of
+    // the previous epics record, a keyframe replaces them
+    static bool DecodeEPICS(const char *buf, uint32_t length, EpicsData &ep);
+    static bool IsEPICSDelta(const char *buf, uint32_t length);
+    static bool DecodeRecon(const char *buf, uint32_t length, ReconData &rec);
+    static bool DecodeCheckpoint(const char *buf, uint32_t length, Checkpoint &ckpt);
+    static uint16_t Version();
+    static bool CheckVersion(uint16_t ver);
+
+    // every record is followed by the CRC32C of its header and data since
+    // version 4.0, the size of the checksum is 0 for the older versions
+    static uint32_t Checksum(const void *buf, size_t size, uint32_t crc = 0);
+    static uint32_t ChecksumSize(uint16_t ver);
+
+    // chunk records, the packed record is unpacked to a raw chunk, and the
+    // events in a raw chunk can be decoded in any order
+    static bool UnpackChunk(const char *buf, uint32_t length, std::vector<char> &raw);
+    static uint32_t ChunkEventCount(const char *buf, uint32_t length);
+    static uint32_t ChunkEventCount(const std::vector<char> &raw);
+    static bool DecodeChunkEvent(const std::vector<char> &raw, uint32_t i, EventData &ev,
+                                 uint32_t mask = All_Banks, uint16_t version = Version());
+
+    // summary record after the map, with its header and checksum, decoding
+    // returns false if the buffer does not start with a valid summary
+    static void EncodeSummary(const PRadRunSummary &sum, std::vector<char> &rec);
+    static bool DecodeSummary(const char *rec, size_t size, PRadRunSummary &sum);
+    // only read the summary of a closed file, return false if it has none
+    static bool ReadSummary(const std::string &path, PRadRunSummary &sum);
 
 
 private:
     void writeMap() throw(PRadException);
-    void saveBuffer(std::ofstream &ofs, Header evh) throw(PRadException);
+    void writeSummary();
+    void writeEventData(const EventData &ev) throw(PRadException);
+    void writeEPICSData(const EpicsData &ep) throw(PRadException);
+    void trackEPICS(int64_t pos);
+    bool rebuildEPICS(size_t index);
+    void saveBuffer(std::ofstream &ofs, Header evh, const char *buf) throw(PRadException);
     Header getBuffer(std::ifstream &ifs) throw (PRadException);
+    void pushOutput(const char *buf, size_t size);
+    void submitChunk();
+    void flushOutput();
+    void writeChunks();
+    void saveChunk() throw(PRadException);
+    void saveCheckpoint() throw(PRadException);
+    void countRecord(const Header &evh, const char *buf) throw(PRadException);
+    void writeRaw(const Header &evh, uint16_t version, bool in_chunk, const char *buf)
+        throw(PRadException);
+    bool currentRaw(const char *&buf, uint32_t &length) const;
+    bool nextChunkEvent();
+    void readUpdates();
+    bool seekUpdated(int64_t &resume);
+    bool replace(int64_t pos, Type type, const std::function<void()> &write);
 
 private:
     Map in_map, out_map;
     Header cur_evh;
     int64_t content_length;
+    uint16_t in_version;
+    uint32_t bank_mask;
     std::ofstream dst_out;
     std::ifstream dst_in;
     char *in_buf, *out_buf;
     uint32_t buf_size;
+    mutable EventData event_cache;
+    mutable EpicsData epics_cache;
+    mutable ReconData recon_cache;
+    // the input was not closed properly, its map is recovered
+    bool in_recovered;
+    // the input has update records, the replaced records are redirected to
+    // their replacements while reading through the file
+    bool in_updated;
+    std::unordered_map<int64_t, int64_t> in_redirect;
+    // summaries of the input and output
+    bool in_has_summary;
+    PRadRunSummary in_summary, out_summary;
+
+    // asynchronous output, the output stream belongs to the writer thread
+    // while it is running, the thread writes the file by its path
+    std::string out_path;
+    bool async_out, writer_stop;
+    int64_t out_pos;
+    std::vector<char> out_chunk;
+    std::deque<std::vector<char>> full_chunks, free_chunks;
+    std::thread writer;
+    std::mutex writer_locker;
+    std::condition_variable writer_cond;
+    WriteStats write_stats;
+
+    // chunked output and input
+    uint32_t chunk_size;
+    int chunk_level;
+    std::vector<char> chunk_data, chunk_pack;
+    std::vector<uint32_t> chunk_offsets;
+    std::vector<char> chunk_in;
+    uint32_t chunk_count, chunk_index;
+
+    // checkpoints of the output, the map sizes are marked at the last one
+    uint32_t ckpt_interval, ckpt_records;
+    int64_t ckpt_last;
+    std::vector<size_t> ckpt_marks;
+    uint64_t out_events, out_epics, out_recons;
+
+    // delta epics output, the values of the last epics record and the number
+    // of records since its keyframe
+    uint32_t epics_keyframe, epics_since;
+    std::vector<float> epics_last;
+    std::vector<uint32_t> epics_ids;
+    // epics input, the records since the last keyframe, each after its length,
+    // the values are only reconstructed from them when a delta is decoded
+    std::vector<char> epics_chain;
+    int64_t epics_index;            // input map index of the last epics record
+    mutable size_t epics_applied;   // bytes of the chain applied to the values
+    mutable EpicsData epics_values;
+
+    // in-place update, the replacements are collected in memory
+    bool upd_active;
+    std::string upd_path;
+    int64_t upd_base;           // position of the update record
+    uint32_t upd_records;       // records written by the current replacement
+    std::vector<char> upd_buf;
+    std::vector<std::pair<int64_t, int64_t>> upd_pairs;
+    std::unordered_map<int64_t, Type> upd_types;
 };
 
 #endif
@@ -0,0 +1,104 @@
+#ifndef PRAD_DST_READER_H
+#define PRAD_DST_READER_H
+
+#include <string>
+#include <vector>
+#include "PRadDSTParser.h"
+
+
+// read-only access to a DST file mapped into memory
+// the records are indexed by the event map of the file, so any event can be
+// accessed directly, and the const members can be called from multiple
+// threads concurrently
+// for the chunked format, the events are accessed by chunks, every chunk can
+// be unpacked independently
+class PRadDSTReader
+{
+public:
+    typedef PRadDSTParser::Header Header;
+    typedef PRadDSTParser::Type Type;
+
+    // a record in the mapped file, the data is valid while the file is opened
+    struct Record
+    {
+        Header header;
+        const char *data;
+
+        Record() : data(nullptr) {}
+        Record(const Header &h, const char *d) : header(h), data(d) {}
+        bool Valid() const {return data != nullptr;}
+        uint32_t Length() const {return header.length;}
+    };
+
+public:
+    PRadDSTReader(const std::string &path = "");
+    virtual ~PRadDSTReader();
+
+    PRadDSTReader(const PRadDSTReader &that) = delete;
+    PRadDSTReader &operator =(const PRadDSTReader &rhs) = delete;
+
+    bool Open(const std::string &path);
+    void Close();
+    bool IsOpen() const {return addr != nullptr;}
+    const std::string &GetPath() const {return file_path;}
+    uint16_t GetVersion() const {return version;}
+    // the mapped file, the records are within the content length
+    const char *GetData() const {return addr;}
+    int64_t GetContentLength() const {return content_length;}
+    // the banks not in the mask are skipped, it should not be changed while
+    // the other threads are reading
+    void SetBankMask(uint32_t mask) {bank_mask = mask;}
+    uint32_t GetBankMask() const {return bank_mask;}
+
+    // random access by the index of the type
+    size_t GetCount(Type t) const {return index.GetType(t).size();}
+    size_t GetEventCount() const {return GetCount(Type::event) + chunk_events;}
+    size_t GetEPICSCount() const {return GetCount(Type::epics);}
+    size_t GetReconCount() const {return GetCount(Type::recon);}
+    const std::vector<int64_t> &GetOffsets(Type t) const {return index.GetType(t);}
+    Record GetRecord(Type t, size_t i) const;
+    bool GetEvent(size_t i, EventData &ev) const;
+    EventData GetEvent(size_t i) const;
+    // a delta epics record is applied to the records from its keyframe
+    bool GetEPICS(size_t i, EpicsData &ep) const;
+    EpicsData GetEPICS(size_t i) const;
+    bool GetRecon(size_t i, ReconData &rec) const;
+    ReconData GetRecon(size_t i) const;
+    // verify the record with its checksum, always true for the old versions
+    bool CheckRecord(Type t, size_t i) const;
+
+    // chunked format
+    bool IsChunked() const {return !chunk_first.empty();}
+    size_t GetChunkCount() const {return chunk_first.size();}
+    size_t GetChunkFirst(size_t c) const;
+    bool GetChunk(size_t c, std::vector<EventData> &events) const;
+
+    // summary after the map, return false if the file has none
+    bool HasSummary() const {return summary_pos > 0;}
+    bool GetSummary(PRadRunSummary &sum) const;
+
+private:
+    bool readMap();
+    void recoverRecords();
+    int64_t scanRecords(int64_t pos, int64_t end);
+    bool findCheckpoints(int64_t end, std::vector<PRadDSTParser::Checkpoint> &chain) const;
+    bool readCheckpoint(int64_t pos, int64_t end, PRadDSTParser::Checkpoint &ckpt) const;
+    bool checkRecord(int64_t pos, int64_t end) const;
+    void indexChunks();
+
+private:
+    std::string file_path;
+    const char *addr;
+    size_t length;
+    int64_t content_length;
+    uint16_t version;
+    uint32_t bank_mask;
+    PRadDSTParser::Map index;
+    // index of the first event in every chunk
+    std::vector<size_t> chunk_first;
+    size_t chunk_events;
+    // position of the summary record, 0 if there is none
+    size_t summary_pos;
+};
+
+#endif
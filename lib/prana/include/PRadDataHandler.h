@@ -3,23 +3,47 @@
 
 #include <deque>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <unordered_map>
 #include "PRadEvioParser.h"
 #include "PRadDSTParser.h"
 #include "PRadEventStruct.h"
+#include "PRadEventStore.h"
+#include "PRadEventCache.h"
+#include "PRadEventSpill.h"
+#include "PRadEnergyCache.h"
+#include "PRadADCUnpacker.h"
+#include "PRadTDCUnpacker.h"
+#include "PRadInfoCenter.h"
+#include "PRadOnlineBuffer.h"
+#include "PRadEventSink.h"
+#include "PRadMemoryTracker.h"
 #include "PRadException.h"
 
 // PMT 0 - 2
 #define DEFAULT_REF_PMT 2
 
+// number of events that can be buffered between decoding and processing
+#define EVENT_RING_SIZE 64
+
 class PRadHyCalSystem;
 class PRadGEMSystem;
 class PRadEPICSystem;
 class PRadTaggerSystem;
-class TH2I;
 
 class PRadDataHandler
 {
+public:
+    // side effects of reading the events, the events are always kept
+    enum ReadOption : uint32_t
+    {
+        Read_Hists = 1 << 0,        // fill the histograms of the systems
+        Read_Occupancy = 1 << 1,    // count the occupancy of the adc channels
+        Read_All = 0x3,
+    };
+
 public:
     // constructor
     PRadDataHandler();
@@ -37,6 +61,8 @@ public:
 
     // mode change
     void SetOnlineMode(const bool &mode);
+    void SetDecodeThreads(unsigned int n) {parser.SetDecodeThreads(n);}
+    PRadEvioParser *GetEvioParser() {return &parser;}
 
     // set systems
     void SetHyCalSystem(PRadHyCalSystem *hycal) {hycal_sys = hycal;}
@@ -46,63 +72,177 @@ public:
     PRadHyCalSystem *GetHyCalSystem() const {return hycal_sys;}
     PRadGEMSystem *GetGEMSystem() const {return gem_sys;}
     PRadEPICSystem *GetEPICSystem() const {return epic_sys;}
+    PRadTaggerSystem *GetTaggerSystem() const {return tagger_sys;}
+
+    // run information context, the global one is used by default
+    void SetInfoCenter(PRadInfoCenter *info);
+    PRadInfoCenter *GetInfoCenter() const {return info_center;}
+
+    // processing stages, they replace the default processing of events
+    void AddSink(PRadEventSink *sink, bool new_thread = false);
+    void RemoveSink(PRadEventSink *sink);
+    void ClearSinks();
+    PRadEventPipeline &GetPipeline() {return pipeline;}
 
     // file reading and writing
     void Decode(const void *buffer);
-    void ReadFromDST(const std::string &path);
+    void DecodeScalers(const void *buffer);
+    // the options are the ReadOption flags of the side effects
+    void ReadFromDST(const std::string &path, uint32_t options = Read_All);
+    // index-only mode, the events of the DST file are decoded on demand
+    bool OpenDST(const std::string &path);
+    void CloseDST();
+    bool IsIndexMode() const {return dst_events.IsOpen();}
     int ReadFromEvio(const std::string &path, int evt = -1, bool verbose = false);
     int ReadFromSplitEvio(const std::string &path, int split = -1, bool verbose = true);
     void WriteToDST(const std::string &path);
-    void Replay(const std::string &r_path, int split = -1, const std::string &w_path = "");
+    // stop the file reading from another thread, the following readings are
+    // also stopped until it is set back
+    void StopReading(bool s = true) {read_stop = s; parser.StopReading(s);}
+    bool IsReadingStopped() const {return read_stop;}
+    // the events and histograms are filled under this lock, lock it to access
+    // them while a file is being read in another thread
+    std::unique_lock<std::recursive_mutex> LockData() const
+    {
+        return std::unique_lock<std::recursive_mutex>(data_locker);
+    }
+    int Replay(const std::string &r_path, int split = -1, const std::string &w_path = "",
+               bool resume = false);
 
     // data handler
     void Clear();
-    void StartofNewEvent(const unsigned char &tag);
+    void StartofNewEvent(const unsigned char &tag, EventData &event);
     void EndofThisEvent(const unsigned int &ev);
     void EndProcess(EventData *data);
     void FillHistograms(const EventData &data);
-    void UpdateTrgType(const unsigned char &trg);
-
-
-    // feeding data
-    void FeedData(const JLabTIData &tiData);
-    void FeedData(const JLabDSCData &dscData);
-    void FeedData(const ADC1881MData &adcData);
-    void FeedData(const TDCV767Data &tdcData);
-    void FeedData(const TDCV1190Data &tdcData);
-    void FeedData(const GEMRawData &gemData);
-    void FeedData(const std::vector<GEMZeroSupData> &gemData);
-    void FeedData(const EPICSRawData &epicsData);
+    void UpdateTrgType(const unsigned char &trg, EventData &event);
+
+
+    // feeding data to the event being built
+    void FeedData(const JLabTIData &tiData, EventData &event);
+    void FeedData(const JLabDSCData &dscData, EventData &event);
+    void FeedData(const ADC1881MData &adcData, EventData &event);
+    void FeedData(const TDCV767Data &tdcData, EventData &event);
+    void FeedData(const TDCV1190Data &tdcData, EventData &event);
+    void FeedData(const GEMRawData &gemData, EventData &event);
+    void FeedData(const std::vector<GEMZeroSupData> &gemData, EventData &event);
+    void FeedData(const EPICSRawData &epicsData, EventData &event);
+
+    // feeding a whole bank to the event being built
+    uint32_t FeedADCBank(const unsigned int &crate, const unsigned int &slot,
+                         const uint32_t *words, const uint32_t &n, EventData &event);
+    void FeedTDCBank(const TDCV1190Data *tdcData, const uint32_t &n, EventData &event);
+    uint32_t FeedTDCV1190Bank(const unsigned int &crate, const uint32_t *words,
+                              const uint32_t &n, EventData &event);
+    uint32_t FeedTDCV767Bank(const unsigned int &crate, const unsigned int &slot,
+                             const uint32_t *words, const uint32_t &n, EventData &event);
+    void FeedGEMBanks(const GEMRawData *gemData, const uint32_t &n, EventData &event);
+    void FeedGEMZeroSup(const GEMZeroSupData *gemData, const uint32_t &n, EventData &event);
 
 
     // event storage
-    unsigned int GetEventCount() const {return event_data.size();}
+    // online mode keeps the recent events in a ring, index 0 is the latest
+    unsigned int GetEventCount() const;
+    MemoryUsage GetMemoryUsage() const;
     const EventData &GetEvent(const unsigned int &index) const throw (PRadException);
-    const std::deque<EventData> &GetEventData() const {return event_data;}
+    EventView GetEventView(const unsigned int &index) const throw (PRadException);
+    // the events in memory, the spilled ones are not included
+    const PRadEventStore &GetEventData() const {return event_data;}
+    // keep the events in memory under the budget in bytes, the stored events
+    // are spilled to temporary files in dir when it is exceeded, they are
+    // still accessed by index, 0 keeps all the events in memory
+    void SetMemoryBudget(size_t bytes, const std::string &dir = "");
+    size_t GetMemoryBudget() const {return memory_budget;}
+    const PRadEventSpill &GetEventSpill() const {return event_spill;}
+    // scaler snapshots of the sync events kept
+    const PRadScalerStore &GetScalerStore() const {return event_data.GetScalers();}
+    void SetOnlineBufferSize(size_t size);
+    // share the recent events with the monitors in the other processes
+    bool PublishOnline(const std::string &name, size_t size = ONLINE_BUFFER_SIZE);
+    bool AttachOnline(const std::string &name);
+    const PRadOnlineBuffer &GetOnlineBuffer() const {return online_buffer;}
+    // replay output in the chunked DST format, 0 events disables it
+    void SetChunkedDST(uint32_t nevents, int level = DST_CHUNK_LEVEL)
+    {dst_parser.SetChunkedOutput(nevents, level);}
+    // delta epics records with a keyframe every nrecords, 0 disables it
+    void SetEPICSDeltaDST(uint32_t nrecords = DST_EPICS_KEYFRAME)
+    {dst_parser.SetEPICSDelta(nrecords);}
 
     // analysis tools
     void InitializeByData(const std::string &path = "", int ref = DEFAULT_REF_PMT);
-    void RefillEnergyHist();
+    // the results of the initialization are saved in the folder, and they are
+    // restored for the same data file, empty folder uses the calibration cache
+    // folder of HyCal
+    void SetInitSnapshot(bool use, const std::string &dir = "")
+    {use_init_snapshot = use; init_snapshot_dir = dir;}
+    bool IsInitSnapshot() const {return use_init_snapshot;}
+    // the energies are recalculated from the cached adc sums
+    void RefillEnergyHist(unsigned int nthreads = 0);
     int FindEvent(int event_number) const;
 
 private:
     void waitEventProcess();
+    void waitRingSlot(size_t head);
+    void startEventProcess();
+    void stopEventProcess();
+    void processEvents();
+    bool readDSTParallel(const std::string &path, unsigned int nthreads, uint32_t options);
+    void checkMemoryBudget();
+    std::string initSnapshotPath(int run);
+    void feedTDCHits(const unsigned int &crate, const PRadTDCUnpacker::Staging &staging,
+                     size_t nhits, EventData &event);
 
 private:
     PRadEvioParser parser;
     PRadDSTParser dst_parser;
+    PRadADCUnpacker adc_unpacker;
+    PRadTDCUnpacker tdc_unpacker;
     PRadEPICSystem *epic_sys;
     PRadTaggerSystem *tagger_sys;
     PRadHyCalSystem *hycal_sys;
     PRadGEMSystem *gem_sys;
+    PRadInfoCenter *info_center;
+    // run counters of the processed events, merged to the context after the
+    // events are all processed
+    PRadInfoCenter::RunCounter run_counter;
     bool onlineMode;
     bool replayMode;
+    // the event in processing only has the trigger and scaler information
+    bool scaler_only;
+    std::atomic<bool> read_stop;
+    mutable std::recursive_mutex data_locker;
+    // the events already in the resumed output are not written again
+    uint64_t replay_skip_events, replay_skip_epics;
+    // snapshot of the initialization by data
+    bool use_init_snapshot;
+    std::string init_snapshot_dir;
+
+    // data related, events are kept in the columnar store, and built into
+    // the cache on request
+    PRadEventStore event_data;
+    mutable EventData event_cache;
+    // events of the DST file opened in index-only mode
+    mutable PRadEventCache dst_events;
+    // events spilled out of the store, they are before the events in memory
+    size_t memory_budget;
+    mutable PRadEventSpill event_spill;
+    // adc sums of the physics events for refilling the energy histogram
+    PRadEnergyCache energy_cache;
+    // recent events in online mode, written by the end process only
+    PRadOnlineBuffer online_buffer;
+
+    // configured processing stages
+    PRadEventPipeline pipeline;
+
+    // single producer (decoder) single consumer (end process) ring of events
+    // the locker is only used to sleep when the ring is empty or full
+    EventData *event_ring;
+    std::atomic<size_t> ring_head, ring_tail;
+    std::atomic<bool> producer_wait, consumer_wait;
+    bool end_stop;
     std::thread end_thread;
-
-    // data related
-    std::deque<EventData> event_data;
-    EventData *new_event;
-    EventData *proc_event;
+    std::mutex ring_locker;
+    std::condition_variable ring_cond;
 };
 
 #endif
@@ -8,23 +8,99 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include "PRadEventStruct.h"
 #include "ConfigObject.h"
 
 
+// the gem hits are put in a uniform grid on HyCal plane, its cells are at least
+// the largest matching range, and enlarged to have no more than this number
+#define DET_MATCH_GRID_MAX 4096
+
 class PRadDetMatch : public ConfigObject
 {
+public:
+    // matched hits of an event in the buffers owned by the caller, the gem
+    // candidates are the ranges in cands, which are the indices of the gem
+    // hits given to Match sorted by the distances, and the hycal index is for
+    // the hycal hits sorted by Match, so reusing the result for the following
+    // events does not allocate once the buffers have grown
+    struct Result
+    {
+        struct Hit : public BaseHit
+        {
+            uint32_t hycal_idx, mflag;
+            // the best matched hit, in gem1 if kGEM1Match is set or in gem2
+            uint32_t gem_idx;
+            uint32_t gem1_begin, gem1_end, gem2_begin, gem2_end;
+        };
+
+        // scratch of the matching, defined in PRadDetMatch.cpp
+        struct Scratch;
+
+        std::vector<Hit> hits;
+        std::vector<uint32_t> cands;
+        std::unique_ptr<Scratch> scratch;
+
+        Result();
+        Result(Result &&that);
+        ~Result();
+        Result &operator =(Result &&rhs);
+
+        void clear() {hits.clear(); cands.clear();}
+        size_t size() const {return hits.size();}
+        bool empty() const {return hits.empty();}
+        const Hit &operator [](size_t i) const {return hits[i];}
+        // the matched hit with the copies of the candidates
+        MatchHit ToMatchHit(size_t i, const std::vector<HyCalHit> &hycal,
+                            const std::vector<GEMHit> &gem1,
+                            const std::vector<GEMHit> &gem2) const;
+    };
+
 public:
     PRadDetMatch(const std::string &path = "");
     virtual ~PRadDetMatch();
 
     void Configure(const std::string& path);
 
+    // each hycal hit is only pre-matched with the gem hits in the nearby grid
+    // cells, and the matched gem hits are marked by their indices
     std::vector<MatchHit> Match(std::vector<HyCalHit> &hycal,
                                 const std::vector<GEMHit> &gem1,
                                 const std::vector<GEMHit> &gem2) const;
+    // the gem hits are projected from their columns, which are built from
+    // the same hits, such as the ones from the reconstructors
+    std::vector<MatchHit> Match(std::vector<HyCalHit> &hycal,
+                                const std::vector<GEMHit> &gem1,
+                                const std::vector<GEMHit> &gem2,
+                                const GEMHitSoA &cols1,
+                                const GEMHitSoA &cols2) const;
+    // the same matching to a reusable result, see Result
+    void Match(std::vector<HyCalHit> &hycal,
+               const std::vector<GEMHit> &gem1,
+               const std::vector<GEMHit> &gem2,
+               Result &res) const;
+    void Match(std::vector<HyCalHit> &hycal,
+               const std::vector<GEMHit> &gem1,
+               const std::vector<GEMHit> &gem2,
+               const GEMHitSoA &cols1,
+               const GEMHitSoA &cols2,
+               Result &res) const;
     bool PreMatch(const HyCalHit &h, const GEMHit &g) const;
+    // pre match with n gem hits already projected to HyCal plane, pass[i] is
+    // set for the hit within the range, no sqrt is needed for the distances
+    // returns the number of hits within the range
+    size_t PreMatch(const HyCalHit &h, const float *px, const float *py, size_t n,
+                    char *pass) const;
+    // pre match the columns of the hits from several events, px and py are the
+    // projected gem hits, the index pairs (hycal, gem) are appended to pairs
+    size_t PreMatch(const HyCalHitSoA &hycal, const float *px, const float *py,
+                    const GEMHitSoA &gem,
+                    std::vector<std::pair<uint32_t, uint32_t>> &pairs) const;
     void PostMatch(MatchHit &h) const;
+    // the same as PostMatch for the candidates of a result
+    void PostMatch(const HyCalHit &hycal, const std::vector<GEMHit> &gem1,
+                   const std::vector<GEMHit> &gem2, Result &res, Result::Hit &h) const;
 
 private:
     float gemRes;
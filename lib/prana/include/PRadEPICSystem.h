@@ -7,6 +7,10 @@
 #include <unordered_map>
 #include "PRadEventStruct.h"
 #include "PRadException.h"
+#include "PRadMemoryTracker.h"
+
+// number of epics events kept in the history of online mode
+#define EPICS_ONLINE_WINDOW 2000
 
 // epics channel
 struct EPICSChannel
@@ -22,6 +26,27 @@ struct EPICSChannel
 
 class PRadEPICSystem
 {
+public:
+    // read the values of a channel for increasing event numbers, the epics
+    // event is advanced from the last one, so it is O(1) for subsequent events
+    // it falls back to binary search if the event number goes backward
+    class Cursor
+    {
+    public:
+        Cursor(const PRadEPICSystem *s = nullptr, int ch = -1)
+        : sys(s), channel(ch), index(-1)
+        {}
+
+        float Value(int event_number);
+        int GetChannel() const {return channel;}
+        int GetEventIndex() const {return index;}
+
+    private:
+        const PRadEPICSystem *sys;
+        int channel;
+        int index;
+    };
+
 public:
     PRadEPICSystem(const std::string &path = "");
     virtual ~PRadEPICSystem();
@@ -46,14 +71,63 @@ public:
     const std::deque<EpicsData> &GetEventData() const {return epics_data;}
     unsigned int GetEventCount() const {return epics_data.size();}
     float FindValue(int event_number, const std::string &name) const;
+    float FindValue(int event_number, int channel) const;
     int FindEvent(int event_number) const;
 
+    // columnar data, the values of a channel in all epics events
+    Cursor GetCursor(const std::string &name) const {return Cursor(this, GetChannel(name));}
+    Cursor GetCursor(int channel) const {return Cursor(this, channel);}
+    const std::vector<int32_t> &GetEventNumbers() const {return epics_evnums;}
+    const std::vector<float> &GetChannelValues(int channel) const;
+
+    // epoch counts the epics events since reset, it is not changed when the
+    // old events are removed in online mode, so it can be attached to events
+    int GetEpoch() const {return epics_evnums.empty() ? -1 : epics_base + epics_evnums.size() - 1;}
+    int FindEpoch(int event_number) const;
+    float GetEpochValue(int epoch, int channel) const;
+    float GetEventValue(const EventData &event, int channel) const
+    {
+        return GetEpochValue(event.epics_index, channel);
+    }
+
+    // online mode only keeps the latest epics event, and the recent ones are
+    // kept in the history by the changed channels
+    void SetOnlineWindow(size_t n);
+    size_t GetOnlineWindow() const {return online_window;}
+    size_t GetHistorySize() const {return history.size();}
+    MemoryUsage GetMemoryUsage() const;
+    // (event number, value) of the channel in the history
+    std::vector<std::pair<int, float>> GetHistory(int channel) const;
+
+private:
+    // changed channels from the previous epics event
+    struct EpicsDelta
+    {
+        int32_t event_number;
+        std::vector<std::pair<uint32_t, float>> changes;
+    };
+
+    void addColumns(const EpicsData &data);
+    void addHistory(const EpicsData &data);
+    float getHistoryValue(int epoch, int channel) const;
+
 
 private:
     // data related
     std::unordered_map<std::string, uint32_t> epics_map;
     std::vector<float> epics_values;
     std::deque<EpicsData> epics_data;
+    // the same data in columns, all channels have a value in every event
+    std::vector<int32_t> epics_evnums;
+    std::vector<std::vector<float>> epics_columns;
+    // epoch of the first event in the columns
+    int epics_base;
+
+    // online history, values before the first delta and of the latest event
+    size_t online_window;
+    int history_base;
+    std::vector<float> history_front, history_last;
+    std::deque<EpicsDelta> history;
 };
 
 #endif
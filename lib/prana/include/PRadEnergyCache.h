@@ -0,0 +1,54 @@
+#ifndef PRAD_ENERGY_CACHE_H
+#define PRAD_ENERGY_CACHE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// number of events for one thread to take at a time
+#define ENERGY_CACHE_BLOCK 4096
+
+
+class PRadEventStore;
+class PRadHyCalSystem;
+class PRadHyCalModule;
+class PRadADCChannel;
+
+// pedestal subtracted adc sums of the physics events, grouped by the modules
+// the energy of an event is the sum of module calibration factor times its adc
+// sum, so the total energies only need a dot product after the gains changed
+// the cache is rebuilt when the events, channels or pedestals changed
+class PRadEnergyCache
+{
+public:
+    PRadEnergyCache();
+
+    void Clear();
+    // build the sums from the events if the cache is not valid for them
+    // return true if it is rebuilt
+    bool Update(const PRadEventStore &store, const PRadHyCalSystem &sys);
+    // total energies of the cached events with the current calibration factors
+    void GetEnergies(std::vector<double> &energies, unsigned int nthreads = 0) const;
+
+    size_t GetEventCount() const {return offsets.size() - 1;}
+    size_t MemoryUsage() const;
+
+private:
+    bool isValid(const PRadEventStore &store, const PRadHyCalSystem &sys) const;
+
+private:
+    // channels and their pedestals when the cache was built
+    size_t nevents;
+    std::vector<const PRadADCChannel*> channels;
+    std::vector<const PRadHyCalModule*> ch_module;
+    std::vector<double> ped_mean;
+
+    // the groups are the modules connected to channels
+    std::vector<const PRadHyCalModule*> groups;
+    // compressed rows of the event by group matrix
+    std::vector<size_t> offsets;
+    std::vector<uint16_t> group_index;
+    std::vector<float> sums;
+};
+
+#endif // PRAD_ENERGY_CACHE_H
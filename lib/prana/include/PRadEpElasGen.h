@@ -4,6 +4,15 @@
 #include <vector>
 #include "canalib.h"
 
+// default number of bins of the structure function table
+#define EP_FF_TABLE_BINS 2000
+// gauss-legendre order and steps for the smooth tau ranges out of the peak
+#define EP_TAU_GAUSS_ORDER 16
+#define EP_TAU_GAUSS_STEPS 8
+// the v integrations are divided into at least this many sub-intervals for
+// every thread
+#define EP_V_TASKS_PER_THREAD 4
+
 // unit MeV, degree and nb
 class PRadEpElasGen
 {
@@ -15,17 +24,46 @@ public:
 
     void GetXSdQsq(double S, double Q2,
                    double &sig_born, double &sig_nrad, double &sig_rad) const;
+    // the Q2 values are calculated by the threads set by SetThreads
+    void GetXSdQsq(double S, const std::vector<double> &Q2,
+                   std::vector<double> &sig_born, std::vector<double> &sig_nrad,
+                   std::vector<double> &sig_rad) const;
+    // number of threads, 0 means the number of cores, the batch call shares
+    // them among the Q2 values and the v sub-intervals, the results do not
+    // depend on the number of threads
+    void SetThreads(unsigned int n) {nthreads = n;}
+    unsigned int GetThreads() const {return nthreads;}
     void GetEMFF(double Q2, double &GE, double &GM) const;
     void GetHadStrFunc(double Q2, double &F1, double &F2) const;
+    void GetHadStrFuncAnalytic(double Q2, double &F1, double &F2) const;
+
+    // tabulate the structure functions in the Q2 range (MeV^2) with cubic
+    // splines, the analytic functions are used outside of the range, and for
+    // all Q2 without the table (validation mode)
+    void SetFFTable(double q2_min, double q2_max, unsigned int nbins = EP_FF_TABLE_BINS);
+    void ClearFFTable();
+    bool IsFFTabulated() const {return !ff_q2.empty();}
 
     double SigmaBorn(double S, double Q2) const;
     double SigmaVphIR(double S, double Q2, double v_min) const;
     double SigmaBrem(double v, double tau, double phik, double S, double Q2, bool finite) const;
     double SigmaBrem_phik(double v, double tau, double S, double Q2, bool finite) const;
+    // both terms for n tau values at the same v, sig_fin can be nullptr if the
+    // finite term is not needed, sig_born is only used by the finite term
+    void SigmaBrem_phik(double v, const double *tau, size_t n, double S, double Q2,
+                        double sig_born, double *sig_fin, double *sig_inf) const;
     double SigmaBrem_phik_tau(double v, double S, double Q2, bool finite, double prec) const;
     double SigmaFh(double v1, double v2, double S, double Q2) const;
     double SigmaFs(double v1, double v2, double S, double Q2) const;
 
+private:
+    void getXSdQsq(double S, double Q2, double &sig_born, double &sig_nrad,
+                   double &sig_rad, unsigned int threads) const;
+    double sigmaBremTau(double v, double S, double Q2, bool finite, bool infinite,
+                        double prec) const;
+    double sigmaFh(double v1, double v2, double S, double Q2, unsigned int threads) const;
+    double sigmaFs(double v1, double v2, double S, double Q2, unsigned int threads) const;
+
 private:
     // v_min defines the minimum photon energy that to be generated (hard photons)
     // v_cut defines the integration range to the highest photon energy
@@ -34,6 +72,11 @@ private:
     unsigned int min_bins;
     // required theta interpolation precision
     double q2_prec, v_prec;
+    // number of threads for the batch calculations
+    unsigned int nthreads;
+    // structure function table, values and second derivatives of the splines
+    double ff_min, ff_step;
+    std::vector<double> ff_q2, ff_f1, ff_f2, ff_d1, ff_d2;
 };
 
 #endif
@@ -0,0 +1,78 @@
+#ifndef PRAD_EVENT_CACHE_H
+#define PRAD_EVENT_CACHE_H
+
+#include <list>
+#include <utility>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "PRadDSTReader.h"
+#include "PRadEventStruct.h"
+
+// number of the decoded events kept in the cache
+#define EVENT_CACHE_SIZE 512
+// number of the events decoded ahead of the viewing direction
+#define EVENT_PREFETCH_SIZE 64
+
+
+// on-demand access to the events of a DST file, only the event map of the file
+// is read when it is opened, and the events are decoded when they are asked
+// the recently used events are kept in a least recently used cache, and the
+// events ahead in the direction of the accesses are decoded in background
+class PRadEventCache
+{
+    typedef std::pair<size_t, EventData> Item;
+    typedef std::list<Item>::iterator Iter;
+
+public:
+    PRadEventCache(size_t cap = EVENT_CACHE_SIZE, size_t ahead = EVENT_PREFETCH_SIZE);
+    virtual ~PRadEventCache();
+
+    // the mapped file and the background decoding are not shareable
+    PRadEventCache(const PRadEventCache &) = delete;
+    PRadEventCache &operator =(const PRadEventCache &) = delete;
+
+    bool Open(const std::string &path);
+    void Close();
+    void Clear();
+    bool IsOpen() const {return reader.IsOpen();}
+    const PRadDSTReader &GetReader() const {return reader;}
+    size_t GetEventCount() const {return reader.GetEventCount();}
+
+    // copy the event, return false if it cannot be decoded
+    bool GetEvent(size_t i, EventData &ev);
+
+    void SetCapacity(size_t cap);
+    void SetPrefetch(size_t ahead) {prefetch_size = ahead;}
+    size_t GetCapacity() const {return capacity;}
+    size_t GetPrefetch() const {return prefetch_size;}
+    size_t Size() const {return items.size();}
+
+private:
+    bool decode(size_t i, EventData *ev = nullptr);
+    void insert(size_t i, EventData &&ev);
+    void trim();
+    void startPrefetch();
+    void stopPrefetch();
+    void prefetch();
+
+private:
+    PRadDSTReader reader;
+    size_t capacity, prefetch_size;
+    std::list<Item> items;
+    std::unordered_map<size_t, Iter> index;
+
+    // the last accessed event and the direction
+    size_t last;
+    int direction;
+
+    // background decoding of the events ahead
+    std::mutex locker;
+    std::condition_variable cond;
+    std::thread prefetch_thread;
+    bool prefetch_stop, prefetch_pending;
+};
+
+#endif
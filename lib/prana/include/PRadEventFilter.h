@@ -17,6 +17,21 @@ private:
         ev_interval(int b, int e) : begin(b), end(e) {}
     };
 
+public:
+    // check bad events with increasing event numbers, the interval is advanced
+    // from the last one, it falls back to binary search for a backward event
+    class Cursor
+    {
+    public:
+        Cursor(const PRadEventFilter *f = nullptr) : filter(f), index(0) {}
+
+        bool IsBadEvent(int event_number);
+
+    private:
+        const PRadEventFilter *filter;
+        size_t index;
+    };
+
 public:
     PRadEventFilter(const std::string &path);
     virtual ~PRadEventFilter();
@@ -24,10 +39,19 @@ public:
     void LoadBadEventsList(const std::string &path, bool clear_exist = true);
     void ClearBadEventsList();
     bool IsBadEvent(const EventData &event) const;
+    bool IsBadEvent(int event_number) const;
     bool IsBadPeriod(const EventData &begin, const EventData &end) const;
+    bool IsBadPeriod(int begin, int end) const;
+    Cursor GetCursor() const {return Cursor(this);}
+
+private:
+    void mergeIntervals();
+    size_t findInterval(int event_number) const;
 
 private:
     std::vector<ev_interval> bad_events_list;
+    // sorted and merged intervals of the list
+    std::vector<ev_interval> merged_list;
 };
 
 #endif
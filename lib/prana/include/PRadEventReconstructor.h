@@ -0,0 +1,106 @@
+#ifndef PRAD_EVENT_RECONSTRUCTOR_H
+#define PRAD_EVENT_RECONSTRUCTOR_H
+
+#include <vector>
+#include <atomic>
+#include "PRadEventStruct.h"
+#include "PRadCoordSystem.h"
+
+// default number of events a stage takes at a time from the batch
+#define EVENT_RECON_SLICE 32
+
+class PRadHyCalSystem;
+class PRadGEMSystem;
+class PRadGEMDetector;
+class PRadDetMatch;
+class PRadTaskPool;
+
+// the results of one event, the hits are transformed to the beam frame, the
+// HyCal hits and matched hits are projected to the HyCal surface
+struct ReconEvent
+{
+    int event_number;
+    std::vector<HyCalHit> hycal_hits;
+    std::vector<GEMHit> gem1_hits;
+    std::vector<GEMHit> gem2_hits;
+    std::vector<MatchHit> matched;
+
+    ReconEvent() : event_number(-1) {}
+    void Clear()
+    {
+        event_number = -1;
+        hycal_hits.clear(), gem1_hits.clear(), gem2_hits.clear(), matched.clear();
+    }
+};
+
+// the combined HyCal and GEM reconstruction of the production pass
+//     HyCal and GEM reconstruction -> coordinate transform -> HyCal projection
+//     -> detector match -> projection of the matched hits
+// every thread has a stage with its own copies of the systems, the events of
+// a batch are distributed to the stages in slices, and the results are
+// written to the slots of their events, so they are in the input order and
+// identical to the serial path, which is the same stage run on one event
+class PRadEventReconstructor
+{
+public:
+    struct Stage
+    {
+        PRadHyCalSystem *hycal;
+        PRadGEMSystem *gem;
+        PRadGEMDetector *gem1, *gem2;
+        PRadCoordSystem coord;
+        int count;
+
+        Stage(const PRadEventReconstructor &rec);
+        ~Stage();
+    };
+
+public:
+    // nthreads 0 means using all the hardware threads
+    PRadEventReconstructor(unsigned int nthreads = 0);
+    virtual ~PRadEventReconstructor();
+
+    PRadEventReconstructor(const PRadEventReconstructor &) = delete;
+    PRadEventReconstructor &operator =(const PRadEventReconstructor &) = delete;
+
+    // the systems are copied to the stages by Init, the detector match has
+    // no event state, so it is shared by the stages
+    void SetHyCalSystem(PRadHyCalSystem *hycal) {hycal_sys = hycal;}
+    void SetGEMSystem(PRadGEMSystem *gem) {gem_sys = gem;}
+    void SetCoordSystem(PRadCoordSystem *coord) {coord_sys = coord;}
+    void SetDetMatch(PRadDetMatch *match) {det_match = match;}
+    void SetThreads(unsigned int n);
+    void SetSliceEvents(size_t n) {slice_events = (n > 0) ? n : EVENT_RECON_SLICE;}
+    unsigned int GetThreads() const {return threads;}
+
+    // copy the systems to the stages, it should be called again after the
+    // settings of the systems are changed, return false if HyCal is not set
+    bool Init();
+    void Clear();
+
+    // the non-physics events have empty results
+    void Reconstruct(const EventData &event, ReconEvent &res);
+    void Reconstruct(const EventData *events, size_t n, ReconEvent *res);
+    void Reconstruct(const std::vector<EventData> &events, std::vector<ReconEvent> &res);
+
+    // number of events reconstructed by the stages
+    int GetCount() const;
+
+private:
+    void process(Stage &stage, const EventData &event, ReconEvent &res) const;
+    void work(Stage &stage, const EventData *events, size_t n, ReconEvent *res);
+
+private:
+    PRadHyCalSystem *hycal_sys;
+    PRadGEMSystem *gem_sys;
+    PRadCoordSystem *coord_sys;
+    PRadDetMatch *det_match;
+    unsigned int threads;
+    size_t slice_events;
+
+    std::vector<Stage*> stages;
+    PRadTaskPool *pool;
+    std::atomic<size_t> next_event;
+};
+
+#endif
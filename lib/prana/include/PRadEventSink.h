@@ -0,0 +1,299 @@
+#ifndef PRAD_EVENT_SINK_H
+#define PRAD_EVENT_SINK_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include "PRadEventStruct.h"
+#include "PRadDSTParser.h"
+#include "PRadMetrics.h"
+
+// number of events buffered in front of a stage running on its own thread
+#define SINK_QUEUE_SIZE 256
+// number of physics events reconstructed together by the batch stage
+#define SINK_RECON_BATCH 1000
+
+class PRadDataHandler;
+class PRadEventStore;
+class PRadHyCalSystem;
+class PRadGEMSystem;
+class PRadCoordSystem;
+class PRadDetMatch;
+
+// a stage of the event processing pipeline
+class PRadEventSink
+{
+public:
+    PRadEventSink(const std::string &n) : name(n) {}
+    virtual ~PRadEventSink() {}
+
+    // process an event, return false to stop it from the later stages
+    virtual bool Process(EventData &event) = 0;
+    // process an epics event
+    virtual void ProcessEPICS(const EpicsData &) {}
+    // all the events given to the pipeline are processed
+    virtual void Flush() {}
+
+    const std::string &GetName() const {return name;}
+
+protected:
+    std::string name;
+};
+
+// fill the histograms of the systems connected to data handler
+class PRadHistSink : public PRadEventSink
+{
+public:
+    PRadHistSink(PRadDataHandler *h) : PRadEventSink("Histogram"), handler(h) {}
+    bool Process(EventData &event);
+
+private:
+    PRadDataHandler *handler;
+};
+
+// keep the events into a store
+class PRadStoreSink : public PRadEventSink
+{
+public:
+    PRadStoreSink(PRadEventStore *s) : PRadEventSink("Store"), store(s) {}
+    bool Process(EventData &event);
+
+private:
+    PRadEventStore *store;
+};
+
+// write the events to a DST file
+class PRadDSTSink : public PRadEventSink
+{
+public:
+    PRadDSTSink(const std::string &path = "");
+    ~PRadDSTSink();
+
+    void Open(const std::string &path);
+    void Close();
+    bool Process(EventData &event);
+    void ProcessEPICS(const EpicsData &epics);
+
+private:
+    PRadDSTParser dst_parser;
+};
+
+// reconstruct HyCal and GEM hits for physics events, the hits are transformed
+// to the lab frame if the coordinate system is given
+class PRadReconSink : public PRadEventSink
+{
+public:
+    PRadReconSink(PRadHyCalSystem *h, PRadGEMSystem *g, PRadCoordSystem *c = nullptr)
+    : PRadEventSink("Reconstruct"), hycal(h), gem(g), coord(c) {}
+    bool Process(EventData &event);
+    // hash of the reconstruction configuration, calibration and coordinates
+    uint64_t GetConfigHash() const;
+    PRadHyCalSystem *GetHyCalSystem() const {return hycal;}
+    PRadGEMSystem *GetGEMSystem() const {return gem;}
+
+private:
+    PRadHyCalSystem *hycal;
+    PRadGEMSystem *gem;
+    PRadCoordSystem *coord;
+};
+
+// match the reconstructed HyCal hits with the GEM hits, it should be after
+// the reconstruction on the same thread, the results are kept until the next
+// physics event
+class PRadMatchSink : public PRadEventSink
+{
+public:
+    PRadMatchSink(PRadHyCalSystem *h, PRadGEMSystem *g, PRadCoordSystem *c, PRadDetMatch *m)
+    : PRadEventSink("Match"), hycal(h), gem(g), coord(c), matcher(m) {}
+    bool Process(EventData &event);
+    const std::vector<MatchHit> &GetMatched() const {return matched;}
+    // hash of the matching configuration, chained to the given one
+    uint64_t GetConfigHash(uint64_t seed) const;
+
+private:
+    PRadHyCalSystem *hycal;
+    PRadGEMSystem *gem;
+    PRadCoordSystem *coord;
+    PRadDetMatch *matcher;
+    std::vector<MatchHit> matched;
+};
+
+// write the reconstructed hits of physics events to a DST file, tagged with
+// the configuration hash, it should be on the same thread after the
+// reconstruction and matching stages
+class PRadReconDSTSink : public PRadEventSink
+{
+public:
+    PRadReconDSTSink(PRadReconSink *r, PRadMatchSink *m = nullptr, const std::string &path = "");
+    ~PRadReconDSTSink();
+
+    void Open(const std::string &path);
+    void Close();
+    bool Process(EventData &event);
+    uint64_t GetConfigHash() const {return recon_data.config_hash;}
+
+private:
+    PRadReconSink *recon;
+    PRadMatchSink *match;
+    ReconData recon_data;
+    PRadDSTParser dst_parser;
+};
+
+// a consumer of the events reconstructed by the batch stage, the events come
+// in the original order, and the epics events are in between them
+class PRadReconOutput
+{
+public:
+    virtual ~PRadReconOutput() {}
+
+    virtual void Write(const EventData &event, const ReconData &recon) = 0;
+    virtual void WriteEPICS(const EpicsData &) {}
+};
+
+// write the reconstructed hits and the epics events to a DST file
+class PRadReconDSTOutput : public PRadReconOutput
+{
+public:
+    PRadReconDSTOutput(const std::string &path = "");
+    ~PRadReconDSTOutput();
+
+    void Open(const std::string &path);
+    void Close();
+    void Write(const EventData &event, const ReconData &recon);
+    void WriteEPICS(const EpicsData &epics);
+
+private:
+    PRadDSTParser dst_parser;
+};
+
+// reconstruct the physics events in batches on several threads, the hits are
+// transformed to the lab frame, projected and matched like the reconstruction
+// and matching stages, the results go to the outputs instead of the systems,
+// so the decoding, reconstruction and outputs are done in one pass
+// an epics event completes the pending batch to keep the outputs in order,
+// the later stages see the events before they are reconstructed
+class PRadBatchReconSink : public PRadEventSink
+{
+public:
+    PRadBatchReconSink(PRadHyCalSystem *h, PRadGEMSystem *g, PRadCoordSystem *c = nullptr,
+                       PRadDetMatch *m = nullptr, unsigned int nthreads = 0);
+
+    // the outputs are not owned by the stage
+    void AddOutput(PRadReconOutput *out) {if(out) outputs.push_back(out);}
+    void ClearOutputs() {outputs.clear();}
+    void SetThreads(unsigned int n) {threads = n;}
+    void SetBatchSize(size_t n) {batch_size = (n > 0) ? n : SINK_RECON_BATCH;}
+    bool Process(EventData &event);
+    void ProcessEPICS(const EpicsData &epics);
+    void Flush();
+    // hash of the reconstruction and matching configurations
+    uint64_t GetConfigHash() const;
+    int GetCount() const {return count;}
+
+private:
+    void reconstruct();
+
+private:
+    PRadHyCalSystem *hycal;
+    PRadGEMSystem *gem;
+    PRadCoordSystem *coord;
+    PRadDetMatch *matcher;
+    std::vector<PRadReconOutput*> outputs;
+    unsigned int threads;
+    size_t batch_size;
+    int count;
+
+    // the batch, the buffers are reused
+    std::vector<EventData> events;
+    size_t nevents;
+    std::vector<std::vector<HyCalHit>> hycal_hits;
+    std::vector<std::vector<GEMHit>> gem_hits;
+    std::vector<GEMHit> gem1_hits, gem2_hits;
+    ReconData recon_data;
+};
+
+// user function as a stage
+class PRadCallbackSink : public PRadEventSink
+{
+public:
+    typedef std::function<bool(EventData &)> Callback;
+
+    PRadCallbackSink(Callback f, const std::string &n = "Callback")
+    : PRadEventSink(n), func(f) {}
+    bool Process(EventData &event) {return func(event);}
+
+private:
+    Callback func;
+};
+
+// a chain of the sinks, consecutive sinks are grouped into segments, a
+// segment runs either on the calling thread or on its own thread with a
+// bounded queue in front of it, the sinks are not owned by the pipeline
+class PRadEventPipeline
+{
+public:
+    // an event or epics event passed through the pipeline
+    struct Item
+    {
+        bool is_epics;
+        EventData event;
+        EpicsData epics;
+
+        Item() : is_epics(false) {}
+    };
+
+    struct Segment
+    {
+        std::vector<PRadEventSink*> sinks;
+        bool threaded;
+
+        // queue to the segment thread, slots are recycled
+        std::vector<Item> queue;
+        size_t head, tail;
+        bool stop;
+        std::thread thread;
+        std::mutex locker;
+        std::condition_variable cond;
+
+        // metrics of the segment thread
+        std::string label;
+        PRadMetricCounter *busy_ns, *wait_ns;
+
+        Segment(bool t)
+        : threaded(t), head(0), tail(0), stop(false), busy_ns(nullptr), wait_ns(nullptr)
+        {}
+    };
+
+public:
+    PRadEventPipeline();
+    virtual ~PRadEventPipeline();
+
+    PRadEventPipeline(const PRadEventPipeline &) = delete;
+    PRadEventPipeline &operator =(const PRadEventPipeline &) = delete;
+
+    void AddSink(PRadEventSink *sink, bool new_thread = false);
+    // the segment is removed with its last sink
+    void RemoveSink(PRadEventSink *sink);
+    void Clear();
+    void Process(EventData &event);
+    void ProcessEPICS(const EpicsData &epics);
+    void Flush();
+    void Stop();
+    bool Empty() const {return segments.empty();}
+    std::vector<PRadEventSink*> GetSinks() const;
+
+private:
+    void pass(size_t index, Item &item);
+    void run(Segment *seg, Item &item, size_t index);
+    void work(size_t index);
+    void startMetrics(Segment *seg);
+
+private:
+    std::vector<Segment*> segments;
+    Item input;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef PRAD_EVENT_SOURCE_H
+#define PRAD_EVENT_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "PRadEventStore.h"
+
+// number of events in a block of the read-ahead queue
+#define EVENT_SOURCE_BLOCK 1000
+// number of blocks read ahead of the iteration
+#define EVENT_SOURCE_QUEUE 4
+
+
+class PRadDataHandler;
+class PRadEventFilter;
+class PRadDSTParser;
+
+// iterable events of a dst or evio file
+//
+//     for(const EventView &ev : PRadEventSource(path, filter)) { ... }
+//
+// the file is read and decoded ahead on a background thread, the accepted
+// events are packed into blocks of columnar stores, and at most
+// EVENT_SOURCE_QUEUE blocks are waiting, so the reading overlaps the analysis
+// with bounded memory
+// the views point to the block being iterated, they are valid until the
+// iteration moves to the next block, use EventView::Fill to keep an event
+// evio files (with ".evio" in the path) are decoded by the data handler with
+// the connected systems, the source is added as the last stage of its pipeline
+// while reading, so the epics events still go to the epics system
+// it is a single pass source, begin() starts the reading only once
+// without MULTI_THREAD, the dst files are read block by block on the calling
+// thread, and the evio files are read as a whole at begin()
+class PRadEventSource
+{
+public:
+    // accept an event if it returns true
+    typedef std::function<bool(const EventData &)> Filter;
+
+    class iterator
+    {
+    public:
+        iterator(PRadEventSource *s = nullptr) : source(s) {}
+        EventView operator *() const {return (*source->current)[source->cur_index];}
+        iterator &operator ++() {if(!source->advance()) source = nullptr; return *this;}
+        bool operator ==(const iterator &rhs) const {return source == rhs.source;}
+        bool operator !=(const iterator &rhs) const {return source != rhs.source;}
+
+    private:
+        PRadEventSource *source;
+    };
+
+    friend class iterator;
+
+public:
+    PRadEventSource(const std::string &path, const Filter &filter = nullptr,
+                    PRadDataHandler *handler = nullptr);
+    virtual ~PRadEventSource();
+
+    PRadEventSource(const PRadEventSource &) = delete;
+    PRadEventSource &operator =(const PRadEventSource &) = delete;
+
+    // options before the iteration
+    void SetBlockEvents(size_t n) {block_events = (n > 0) ? n : EVENT_SOURCE_BLOCK;}
+    void SetQueueBlocks(size_t n) {queue_blocks = (n > 0) ? n : EVENT_SOURCE_QUEUE;}
+
+    iterator begin();
+    iterator end() {return iterator();}
+    // stop the reading, the iteration ends after the queued blocks
+    void Stop();
+
+    const std::string &GetPath() const {return path;}
+    bool IsEvio() const {return evio;}
+    uint64_t GetAcceptedEvents() const {return accepted;}
+    uint64_t GetSkippedEvents() const {return skipped;}
+
+    // filter of the bad events list
+    static Filter SkipBadEvents(const PRadEventFilter &filter);
+
+private:
+    class SourceSink;
+
+    void produce();
+    bool readDST();
+    void readEvio();
+    void finish();
+    bool push(const EventData &event);
+    void commit();
+    PRadEventStore *takeFree();
+    bool fetch();
+    bool advance();
+
+private:
+    std::string path;
+    Filter filter;
+    PRadDataHandler *handler;
+    bool evio;
+    size_t block_events, queue_blocks;
+
+    // blocks owned by the source, they go around the free and ready queues
+    std::vector<std::unique_ptr<PRadEventStore>> blocks;
+    std::deque<PRadEventStore*> free_blocks, ready_blocks;
+    PRadEventStore *filling, *current;
+    size_t cur_index;
+
+    // reading status, the dst parser and buffer belong to the reader
+    std::unique_ptr<PRadDSTParser> dst;
+    EventData buffer;
+    int32_t epics_epoch;
+
+    std::thread reader;
+    std::mutex locker;
+    std::condition_variable cond;
+    bool started, finished;
+    std::atomic<bool> stop;
+    std::atomic<uint64_t> accepted, skipped;
+};
+
+#endif // PRAD_EVENT_SOURCE_H
@@ -0,0 +1,82 @@
+#ifndef PRAD_EVENT_SPILL_H
+#define PRAD_EVENT_SPILL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "PRadEventStruct.h"
+#include "PRadDSTParser.h"
+
+// default directory of the temporary files if TMPDIR is not set
+#define EVENT_SPILL_DIR "/tmp"
+// number of the decoded events kept for the segment being accessed
+#define EVENT_SPILL_CACHE 128
+#define EVENT_SPILL_PREFETCH 32
+
+
+class PRadEventStore;
+class PRadEventCache;
+
+// events moved out of the memory, every spill writes the events of a store to
+// a temporary file in the chunked DST format as a segment, and the segments
+// cover the events in the order they were spilled
+// only the event numbers of the segments are kept in memory, the events are
+// decoded from the file of the segment being accessed through an event cache,
+// it is switched to another file when the access moves to its segment
+// the temporary files are removed when the spill is cleared or destroyed
+class PRadEventSpill
+{
+    struct Segment
+    {
+        std::string path;
+        size_t first;
+        std::vector<int32_t> evnums;
+    };
+
+public:
+    PRadEventSpill(const std::string &dir = "");
+    virtual ~PRadEventSpill();
+
+    // the temporary files belong to one spill
+    PRadEventSpill(const PRadEventSpill &) = delete;
+    PRadEventSpill &operator =(const PRadEventSpill &) = delete;
+    PRadEventSpill(PRadEventSpill &&that);
+    PRadEventSpill &operator =(PRadEventSpill &&rhs);
+
+    // "" uses TMPDIR or the default directory
+    void SetDirectory(const std::string &dir);
+    const std::string &GetDirectory() const {return directory;}
+    void SetChunkedOutput(uint32_t nevents = DST_CHUNK_EVENTS, int level = DST_CHUNK_LEVEL);
+
+    // write all the events of the store to a new segment, the store is not
+    // changed, return false if the file cannot be written
+    bool Spill(const PRadEventStore &store);
+    void Clear();
+
+    // copy the event, return false if it cannot be decoded
+    bool GetEvent(size_t i, EventData &ev);
+    int Find(int event_number) const;
+
+    size_t size() const {return total;}
+    bool empty() const {return !total;}
+    size_t GetSegmentCount() const {return segments.size();}
+    size_t MemoryUsage() const;
+
+private:
+    int findSegment(size_t i) const;
+    bool openSegment(int seg);
+
+private:
+    std::string directory;
+    uint32_t chunk_events;
+    int chunk_level;
+    std::vector<Segment> segments;
+    size_t total;
+
+    // decoded events of the current segment
+    std::unique_ptr<PRadEventCache> cache;
+    int current;
+};
+
+#endif // PRAD_EVENT_SPILL_H
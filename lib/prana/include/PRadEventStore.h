@@ -0,0 +1,343 @@
+#ifndef PRAD_EVENT_STORE_H
+#define PRAD_EVENT_STORE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "PRadEventStruct.h"
+
+
+class PRadEventStore;
+
+// a contiguous range of data in the store
+template<class T>
+class DataRange
+{
+public:
+    DataRange() : first(nullptr), last(nullptr) {}
+    DataRange(const T *b, const T *e) : first(b), last(e) {}
+
+    const T *begin() const {return first;}
+    const T *end() const {return last;}
+    size_t size() const {return last - first;}
+    bool empty() const {return first == last;}
+    const T &operator [](size_t i) const {return first[i];}
+
+private:
+    const T *first, *last;
+};
+
+// tdc values of an event sorted by the channels, the values of a channel are a
+// slice of one array, the offsets are built in one pass of counting sort
+class TDCTable
+{
+public:
+    // the channels with id >= nch are dropped, nch = 0 takes the largest id
+    void Build(const std::vector<TDC_Data> &tdcs, size_t nch = 0)
+    {
+        if(!nch) {
+            for(auto &tdc : tdcs)
+                nch = std::max<size_t>(nch, tdc.channel_id + 1);
+        }
+
+        offsets.assign(nch + 1, 0);
+        for(auto &tdc : tdcs)
+        {
+            if(tdc.channel_id < nch)
+                offsets[tdc.channel_id + 1]++;
+        }
+        for(size_t i = 0; i < nch; ++i)
+            offsets[i + 1] += offsets[i];
+
+        values.resize(offsets.back());
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for(auto &tdc : tdcs)
+        {
+            if(tdc.channel_id < nch)
+                values[fill[tdc.channel_id]++] = tdc.value;
+        }
+    }
+
+    void Clear()
+    {
+        offsets.clear();
+        values.clear();
+    }
+
+    // values of a channel in the order of the event
+    DataRange<unsigned short> Get(size_t id) const
+    {
+        if(id + 1 >= offsets.size())
+            return DataRange<unsigned short>();
+        return DataRange<unsigned short>(values.data() + offsets[id],
+                                         values.data() + offsets[id + 1]);
+    }
+
+    size_t size() const {return values.size();}
+
+private:
+    std::vector<uint32_t> offsets, fill;
+    std::vector<unsigned short> values;
+};
+
+// the discriminator scalers only come with the synchronization events, they
+// are kept as a time series of snapshots keyed by event number, and the events
+// refer to the last snapshot up to them by its epoch, like the epics events
+class PRadScalerStore
+{
+public:
+    PRadScalerStore();
+
+    // add a snapshot, the event numbers are assumed to be in order
+    // return the epoch of the snapshot
+    int Add(int32_t event_number, const std::vector<DSC_Data> &dsc);
+    // append the snapshots from another store, the epochs of them are moved
+    // after the existing ones
+    void Append(const PRadScalerStore &that);
+    void Clear();
+
+    // epoch counts the snapshots, -1 means there is no snapshot
+    int GetEpoch() const {return (int)evnums.size() - 1;}
+    int FindEpoch(int event_number) const;
+    size_t size() const {return evnums.size();}
+    bool empty() const {return evnums.empty();}
+    int GetEventNumber(int epoch) const;
+    const std::vector<int32_t> &GetEventNumbers() const {return evnums;}
+    DataRange<DSC_Data> GetSnapshot(int epoch) const;
+
+    // the same quantities as from the sync events, 0 if the channel is missing
+    double GetBeamTime(int epoch) const;
+    double GetLiveTime(int epoch) const;
+    double GetBeamCharge(int epoch) const;
+    size_t MemoryUsage() const;
+
+private:
+    std::vector<int32_t> evnums;
+    // the channels of snapshot i are in [offsets[i], offsets[i + 1])
+    std::vector<uint32_t> offsets;
+    std::vector<DSC_Data> counts;
+};
+
+// gem hit in the store, the time samples are in the value column
+struct GEMHitRef
+{
+    GEMChannelAddress addr;
+    uint8_t nvalues;
+    size_t value_begin;
+};
+
+// light weight accessor of an event in the store, it is valid until the store
+// is modified
+class EventView
+{
+public:
+    EventView() : store(nullptr), index(0) {}
+    EventView(const PRadEventStore *s, size_t i) : store(s), index(i) {}
+
+    inline int32_t event_number() const;
+    inline uint8_t type() const;
+    inline uint8_t trigger() const;
+    inline uint64_t timestamp() const;
+    inline int32_t epics_index() const;
+    inline int32_t dsc_index() const;
+    inline bool is_physics_event() const;
+    inline bool is_monitor_event() const;
+    inline bool is_sync_event() const;
+
+    inline DataRange<ADC_Data> adc_data() const;
+    inline DataRange<TDC_Data> tdc_data() const;
+    // the scalers of this event, only the sync events have them
+    inline DataRange<DSC_Data> dsc_data() const;
+    // the last scalers up to this event
+    inline DataRange<DSC_Data> scalers() const;
+    inline DataRange<GEMHitRef> gem_data() const;
+    inline DataRange<float> gem_values(const GEMHitRef &hit) const;
+    inline DSC_Data get_trg_channel(uint32_t trg_type) const;
+    inline DSC_Data get_ref_channel() const;
+
+    // build a full event
+    void Fill(EventData &event) const;
+
+private:
+    const PRadEventStore *store;
+    size_t index;
+};
+
+// append-only columnar storage of events, data from all the events are in
+// contiguous arrays, and the events only keep the offsets
+// the scalers are not an event column, they are in the scaler store once per
+// sync event, and the events only keep the epoch
+class PRadEventStore
+{
+public:
+    // event information and the offsets in the data arrays
+    struct EventInfo
+    {
+        int32_t event_number;
+        uint8_t type;
+        uint8_t trigger;
+        uint64_t timestamp;
+        int32_t epics_index;
+        int32_t dsc_index;
+        size_t adc_begin, tdc_begin, gem_begin;
+    };
+
+    class const_iterator
+    {
+    public:
+        const_iterator(const PRadEventStore *s, size_t i) : store(s), index(i) {}
+        EventView operator *() const {return EventView(store, index);}
+        const_iterator &operator ++() {++index; return *this;}
+        bool operator ==(const const_iterator &rhs) const {return index == rhs.index;}
+        bool operator !=(const const_iterator &rhs) const {return index != rhs.index;}
+        size_t GetIndex() const {return index;}
+
+    private:
+        const PRadEventStore *store;
+        size_t index;
+    };
+
+    friend class EventView;
+
+public:
+    PRadEventStore();
+
+    void Append(const EventData &event);
+    void Append(const PRadEventStore &that);
+    void Clear();
+    // remove the events but keep the scaler snapshots, the later events still
+    // refer to them after the events are moved out of the store
+    void ClearEvents();
+    void Release();
+    void Reserve(size_t events, size_t adcs_per_event);
+    int Find(int event_number) const;
+    size_t MemoryUsage() const;
+    // bytes of the events in the store, not including the reserved space
+    size_t DataSize() const;
+
+    size_t size() const {return events.size();}
+    bool empty() const {return events.empty();}
+    EventView operator [](size_t i) const {return EventView(this, i);}
+    EventView back() const {return EventView(this, events.size() - 1);}
+    const_iterator begin() const {return const_iterator(this, 0);}
+    const_iterator end() const {return const_iterator(this, events.size());}
+    const PRadScalerStore &GetScalers() const {return scalers;}
+
+private:
+    std::vector<EventInfo> events;
+    std::vector<ADC_Data> adc;
+    std::vector<TDC_Data> tdc;
+    std::vector<GEMHitRef> gem;
+    std::vector<float> gem_values;
+    PRadScalerStore scalers;
+};
+
+
+// inline accessors
+int32_t EventView::event_number() const
+{
+    return store->events[index].event_number;
+}
+
+uint8_t EventView::type() const
+{
+    return store->events[index].type;
+}
+
+uint8_t EventView::trigger() const
+{
+    return store->events[index].trigger;
+}
+
+uint64_t EventView::timestamp() const
+{
+    return store->events[index].timestamp;
+}
+
+int32_t EventView::epics_index() const
+{
+    return store->events[index].epics_index;
+}
+
+int32_t EventView::dsc_index() const
+{
+    return store->events[index].dsc_index;
+}
+
+bool EventView::is_physics_event() const
+{
+    uint8_t trg = trigger();
+    return ( (trg == PHYS_LeadGlassSum) ||
+             (trg == PHYS_TotalSum)     ||
+             (trg == PHYS_TaggerE)      ||
+             (trg == PHYS_Scintillator) );
+}
+
+bool EventView::is_monitor_event() const
+{
+    uint8_t trg = trigger();
+    return ( (trg == LMS_Led) ||
+             (trg == LMS_Alpha) );
+}
+
+bool EventView::is_sync_event() const
+{
+    return type() == CODA_Sync;
+}
+
+// the data of an event ends at the beginning of the next event
+#define EVENT_STORE_RANGE(col, beg) \
+    const auto &info = store->events[index]; \
+    size_t end = (index + 1 < store->events.size()) ? \
+                 store->events[index + 1].beg : store->col.size(); \
+    return {store->col.data() + info.beg, store->col.data() + end}
+
+DataRange<ADC_Data> EventView::adc_data() const
+{
+    EVENT_STORE_RANGE(adc, adc_begin);
+}
+
+DataRange<TDC_Data> EventView::tdc_data() const
+{
+    EVENT_STORE_RANGE(tdc, tdc_begin);
+}
+
+DataRange<GEMHitRef> EventView::gem_data() const
+{
+    EVENT_STORE_RANGE(gem, gem_begin);
+}
+
+#undef EVENT_STORE_RANGE
+
+DataRange<DSC_Data> EventView::dsc_data() const
+{
+    const auto &info = store->events[index];
+    if(store->scalers.GetEventNumber(info.dsc_index) != info.event_number)
+        return DataRange<DSC_Data>();
+    return store->scalers.GetSnapshot(info.dsc_index);
+}
+
+DataRange<DSC_Data> EventView::scalers() const
+{
+    return store->scalers.GetSnapshot(dsc_index());
+}
+
+DataRange<float> EventView::gem_values(const GEMHitRef &hit) const
+{
+    const float *beg = store->gem_values.data() + hit.value_begin;
+    return {beg, beg + hit.nvalues};
+}
+
+DSC_Data EventView::get_trg_channel(uint32_t trg_type) const
+{
+    // physics trigger enum starts at 1, while stored at 0
+    return dsc_data()[trg_type - 1];
+}
+
+DSC_Data EventView::get_ref_channel() const
+{
+    return dsc_data()[REF_CHANNEL];
+}
+
+#endif
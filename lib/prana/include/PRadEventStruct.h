@@ -19,6 +19,9 @@
 #define FCUP_OFFSET 100.0
 #define FCUP_SLOPE 906.2
 
+// maximum number of time samples kept in a gem hit
+#define GEM_MAX_TIME_SAMPLES 9
+
 //============================================================================//
 // *BEGIN* RUN INFORMATION STRUCTURE                                          //
 //============================================================================//
@@ -179,16 +182,18 @@ struct GEMChannelAddress
     {}
 };
 
+// time samples are stored inline, so a hit does not need heap memory
 struct GEM_Data
 {
     GEMChannelAddress addr;
-    std::vector<float> values;
+    uint8_t nvalues;
+    float values[GEM_MAX_TIME_SAMPLES];
 
-    GEM_Data() {}
+    GEM_Data() : nvalues(0) {}
     GEM_Data(const uint8_t &f,
              const uint8_t &a,
              const uint8_t &s)
-    : addr(f, a, s)
+    : addr(f, a, s), nvalues(0)
     {}
 
     void set_address (const uint8_t &f,
@@ -200,10 +205,19 @@ struct GEM_Data
         addr.strip = s;
     }
 
-    void add_value(const float &v)
+    // values beyond the maximum are discarded
+    bool add_value(const float &v)
     {
-        values.push_back(v);
+        if(nvalues >= GEM_MAX_TIME_SAMPLES)
+            return false;
+        values[nvalues++] = v;
+        return true;
     }
+
+    void clear_values() {nvalues = 0;}
+    uint32_t size() const {return nvalues;}
+    const float *begin() const {return values;}
+    const float *end() const {return values + nvalues;}
 };
 
 //============================================================================//
@@ -222,8 +236,14 @@ struct EventData
     uint8_t type;
     uint8_t trigger;
     uint64_t timestamp;
-
-    // data banks
+    // epoch of the epics event before this event, -1 if there is none
+    // it is not saved in files, the data handler attaches it when reading
+    int32_t epics_index;
+    // epoch of the scaler snapshot up to this event in the store it is from,
+    // -1 if there is none, it is not saved in files either
+    int32_t dsc_index;
+
+    // data banks, only the sync events have the scalers
     std::vector< ADC_Data > adc_data;
     std::vector< TDC_Data > tdc_data;
     std::vector< GEM_Data > gem_data;
@@ -231,10 +251,10 @@ struct EventData
 
     // constructors
     EventData()
-    : event_number(0), type(0), trigger(0), timestamp(0)
+    : event_number(0), type(0), trigger(0), timestamp(0), epics_index(-1), dsc_index(-1)
     {}
     EventData(const uint8_t &t)
-    : event_number(0), type(t), trigger(0), timestamp(0)
+    : event_number(0), type(t), trigger(0), timestamp(0), epics_index(-1), dsc_index(-1)
     {}
     EventData(const uint8_t &t,
               const PRadTriggerType &trg,
@@ -242,8 +262,8 @@ struct EventData
               std::vector<TDC_Data> &tdc,
               std::vector<GEM_Data> &gem,
               std::vector<DSC_Data> &dsc)
-    : event_number(0), type(t), trigger((uint8_t)trg), timestamp(0),
-      adc_data(adc), tdc_data(tdc), gem_data(gem), dsc_data(dsc)
+    : event_number(0), type(t), trigger((uint8_t)trg), timestamp(0), epics_index(-1),
+      dsc_index(-1), adc_data(adc), tdc_data(tdc), gem_data(gem), dsc_data(dsc)
     {}
 
     void clear()
@@ -252,6 +272,8 @@ struct EventData
         type = 0;
         trigger = 0;
         timestamp = 0;
+        epics_index = -1;
+        dsc_index = -1;
         adc_data.clear();
         tdc_data.clear();
         gem_data.clear();
@@ -436,6 +458,14 @@ struct ModuleCluster
         hits.reserve(100);
     }
 
+    // start a new cluster, the hit vector keeps its memory
+    void Reset(const ModuleHit &hit, uint32_t f)
+    {
+        center = hit;
+        hits.clear();
+        energy = 0, leakage = 0, flag = f;
+    }
+
     void AddHit(const ModuleHit &hit)
     {
         hits.emplace_back(hit);
@@ -611,10 +641,15 @@ public:
     }
 
     void set_time(const std::vector<uint16_t> &t)
+    {
+        set_time(t.data(), t.size());
+    }
+
+    void set_time(const uint16_t *t, size_t n)
     {
         for(int i = 0; i < TIME_MEASURE_SIZE; ++i)
         {
-            if(i < (int)t.size())
+            if(i < (int)n)
                 time[i] = t[i];
             else
                 time[i] = 0;
@@ -691,6 +726,162 @@ public:
     }
 };
 
+// structure of arrays for the hits, only the members used by the analysis
+// loops are kept in columns, so the coordinate transforms, cuts and histogram
+// fills go through contiguous arrays, the hits of several events can be put
+// together, and the event column tells which event a hit belongs to
+// the full hit is still available from the original container through the
+// index column
+class HyCalHitSoA
+{
+public:
+    std::vector<float> x, y, z, E;
+    std::vector<float> sig_pos;
+    std::vector<uint32_t> flag;
+    std::vector<int16_t> cid;
+    std::vector<uint32_t> event;
+    std::vector<uint32_t> index;
+
+    size_t size() const {return x.size();}
+    bool empty() const {return x.empty();}
+
+    void clear()
+    {
+        x.clear(); y.clear(); z.clear(); E.clear(); sig_pos.clear();
+        flag.clear(); cid.clear(); event.clear(); index.clear();
+    }
+
+    void reserve(size_t n)
+    {
+        x.reserve(n); y.reserve(n); z.reserve(n); E.reserve(n); sig_pos.reserve(n);
+        flag.reserve(n); cid.reserve(n); event.reserve(n); index.reserve(n);
+    }
+
+    void push_back(const HyCalHit &hit, uint32_t ev = 0, uint32_t idx = 0)
+    {
+        x.push_back(hit.x);
+        y.push_back(hit.y);
+        z.push_back(hit.z);
+        E.push_back(hit.E);
+        sig_pos.push_back(hit.sig_pos);
+        flag.push_back(hit.flag);
+        cid.push_back(hit.cid);
+        event.push_back(ev);
+        index.push_back(idx);
+    }
+
+    // append the hits of an event
+    void Append(const std::vector<HyCalHit> &hits, uint32_t ev = 0)
+    {
+        for(size_t i = 0; i < hits.size(); ++i)
+            push_back(hits[i], ev, i);
+    }
+
+    void Assign(const std::vector<HyCalHit> &hits, uint32_t ev = 0)
+    {
+        clear();
+        reserve(hits.size());
+        Append(hits, ev);
+    }
+
+    // view of a hit, the members not in the columns are default
+    HyCalHit at(size_t i) const
+    {
+        HyCalHit hit(cid[i], flag[i], E[i], 0.);
+        hit.x = x[i];
+        hit.y = y[i];
+        hit.z = z[i];
+        hit.sig_pos = sig_pos[i];
+        return hit;
+    }
+
+    // write the coordinates back to the original hits of an event, which
+    // is needed after the transform or projection of the columns
+    void Update(std::vector<HyCalHit> &hits, uint32_t ev = 0) const
+    {
+        for(size_t i = 0; i < size(); ++i)
+        {
+            if(event[i] != ev || index[i] >= hits.size())
+                continue;
+            auto &hit = hits[index[i]];
+            hit.x = x[i];
+            hit.y = y[i];
+            hit.z = z[i];
+        }
+    }
+};
+
+class GEMHitSoA
+{
+public:
+    std::vector<float> x, y, z;
+    std::vector<float> x_charge, y_charge;
+    std::vector<float> sig_pos;
+    std::vector<int32_t> det_id;
+    std::vector<uint32_t> event;
+    std::vector<uint32_t> index;
+
+    size_t size() const {return x.size();}
+    bool empty() const {return x.empty();}
+
+    void clear()
+    {
+        x.clear(); y.clear(); z.clear(); x_charge.clear(); y_charge.clear();
+        sig_pos.clear(); det_id.clear(); event.clear(); index.clear();
+    }
+
+    void reserve(size_t n)
+    {
+        x.reserve(n); y.reserve(n); z.reserve(n); x_charge.reserve(n); y_charge.reserve(n);
+        sig_pos.reserve(n); det_id.reserve(n); event.reserve(n); index.reserve(n);
+    }
+
+    void push_back(const GEMHit &hit, uint32_t ev = 0, uint32_t idx = 0)
+    {
+        x.push_back(hit.x);
+        y.push_back(hit.y);
+        z.push_back(hit.z);
+        x_charge.push_back(hit.x_charge);
+        y_charge.push_back(hit.y_charge);
+        sig_pos.push_back(hit.sig_pos);
+        det_id.push_back(hit.det_id);
+        event.push_back(ev);
+        index.push_back(idx);
+    }
+
+    void Append(const std::vector<GEMHit> &hits, uint32_t ev = 0)
+    {
+        for(size_t i = 0; i < hits.size(); ++i)
+            push_back(hits[i], ev, i);
+    }
+
+    void Assign(const std::vector<GEMHit> &hits, uint32_t ev = 0)
+    {
+        clear();
+        reserve(hits.size());
+        Append(hits, ev);
+    }
+
+    GEMHit at(size_t i) const
+    {
+        return GEMHit(x[i], y[i], z[i], det_id[i], x_charge[i], y_charge[i],
+                      0., 0., 0, 0, sig_pos[i]);
+    }
+
+    void Update(std::vector<GEMHit> &hits, uint32_t ev = 0) const
+    {
+        for(size_t i = 0; i < size(); ++i)
+        {
+            if(event[i] != ev || index[i] >= hits.size())
+                continue;
+            auto &hit = hits[index[i]];
+            hit.x = x[i];
+            hit.y = y[i];
+            hit.z = z[i];
+        }
+    }
+};
+
 // a function to get the hit with the greatest energy
 template<typename Iter>
 inline Iter MostEnergeticHit(Iter beg, Iter end)
@@ -707,6 +898,30 @@ inline Iter MostEnergeticHit(Iter beg, Iter end)
     return res;
 }
 
+// reconstructed hits of an event, config_hash identifies the reconstruction
+// configuration that produced them
+struct ReconData
+{
+    int32_t event_number;
+    uint64_t config_hash;
+    std::vector<HyCalHit> hycal_hits;
+    std::vector<GEMHit> gem_hits;       // hits from all GEM detectors
+    std::vector<MatchHit> match_hits;
+
+    ReconData()
+    : event_number(0), config_hash(0)
+    {}
+
+    void clear()
+    {
+        event_number = 0;
+        config_hash = 0;
+        hycal_hits.clear();
+        gem_hits.clear();
+        match_hits.clear();
+    }
+};
+
 //============================================================================//
 // *END* DETECTOR HIT STRUCTURE                                               //
 //============================================================================//
@@ -2,38 +2,202 @@
 #define PRAD_EVIO_PARSER_H
 
 #include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <functional>
 #include <cstdint>
 #include "datastruct.h"
+#include "PRadEventStruct.h"
 #include "PRadException.h"
 
 class PRadDataHandler;
+class PRadTaskPool;
+class PRadAsyncReader;
+
+// decoders registered for any roc
+#define ANY_ROC -1
 
 class PRadEvioParser
 {
+public:
+    // decoder of a data bank, the bank header is followed by its data
+    // it fills the event builder of the parser or feeds its handler
+    typedef std::function<void(PRadEvioParser &, const PRadEventHeader *)> BankDecoder;
+
+    // registered decoder for the banks of a roc, or of any roc
+    // the trigger related decoders are still called in partial parse
+    struct DecoderEntry
+    {
+        int roc, bank;
+        BankDecoder func;
+        bool trigger_info;
+
+        DecoderEntry(int r, int b, const BankDecoder &f, bool t)
+        : roc(r), bank(b), func(f), trigger_info(t) {}
+    };
+
+    // flat dispatch table compiled from the registry, the decoder index of a
+    // bank is found by the roc slot and the bank tag offset, -1 means skip
+    struct DispatchTable
+    {
+        std::vector<int16_t> roc_slots;
+        std::vector<int16_t> slots;
+        uint32_t bank_min, bank_span;
+        std::vector<BankDecoder> funcs;
+        std::vector<uint8_t> trigger_info;
+
+        DispatchTable() : bank_min(0), bank_span(0) {}
+        int ROCSlot(uint32_t roc) const
+        {
+            return (roc < roc_slots.size()) ? roc_slots[roc] : -1;
+        }
+        int Decoder(int roc_slot, uint32_t bank) const
+        {
+            bank -= bank_min;
+            return (bank < bank_span) ? slots[roc_slot*bank_span + bank] : -1;
+        }
+    };
+
+    // decoded events from one evio block, used by block-parallel decoding
+    // the events are recycled to keep their memory, only the first nevents
+    // are valid
+    struct BlockEvents
+    {
+        std::vector<EventData> events;
+        size_t nevents;
+        // events that have to be decoded in order (EPICS), the decoded events
+        // only contain a place holder for them
+        std::vector<const PRadEventHeader*> deferred;
+
+        BlockEvents() : nevents(0) {}
+        void clear() {nevents = 0; deferred.clear();}
+        EventData &next()
+        {
+            if(nevents == events.size())
+                events.emplace_back();
+            EventData &ev = events[nevents++];
+            ev.clear();
+            return ev;
+        }
+    };
+
+    // index of an evio block, it is saved in a sidecar file for random access
+    struct BlockIndex
+    {
+        uint64_t pos;       // position in words
+        uint32_t size;      // block size in words
+        uint32_t nevents;   // number of physics events
+        uint32_t first;     // first event number, 0 means no numbered event
+        uint32_t last;      // last event number
+
+        BlockIndex() : pos(0), size(0), nevents(0), first(0), last(0) {}
+        BlockIndex(uint64_t p, uint32_t s) : pos(p), size(s), nevents(0), first(0), last(0) {}
+    };
+
 public:
     // constructor, destructor
     PRadEvioParser(PRadDataHandler* handler);
     virtual ~PRadEvioParser();
 
+    // the task pool and staging events are not shareable
+    PRadEvioParser(const PRadEvioParser &) = delete;
+    PRadEvioParser &operator =(const PRadEvioParser &) = delete;
+
     // public member functions
     int ReadEvioFile(const char *filepath, int evt = -1, bool verbose = false);
     int ReadEventBuffer(const void *buf);
+    void ReserveBuffer(size_t words);
+    void ReleaseBuffer();
+    void PrefetchFile(const char *filepath);
+    void StopPrefetch();
+    // the file reading returns after the current block once it is stopped,
+    // it can be called from another thread
+    void StopReading(bool s = true) {read_stop = s;}
+    bool IsReadingStopped() const {return read_stop;}
+
+    // block index for random access
+    bool BuildIndex(const char *filepath, bool save = true);
+    bool LoadIndex(const char *filepath);
+    bool SaveIndex(const char *filepath) const;
+    void ClearIndex();
+    int SeekEvent(int ev);
+    void SetIndexMode(bool i) {use_index = i;}
+
+    // trigger filter, rejected physics events are skipped before decoding
+    void SetTriggerMask(uint32_t mask) {trigger_mask = mask;}
+    void AcceptTrigger(const PRadTriggerType &trg) {trigger_mask |= trigger_to_bit(trg);}
+    void ResetFilterStats() {skipped_events = 0; skipped_bytes = 0;}
+    uint32_t GetTriggerMask() const {return trigger_mask;}
+    uint64_t GetSkippedEvents() const {return skipped_events;}
+    uint64_t GetSkippedBytes() const {return skipped_bytes;}
+    bool IsIndexMode() const {return use_index;}
+    const std::vector<BlockIndex> &GetBlockIndex() const {return block_index;}
 
     void SetHandler(PRadDataHandler *h) {myHandler = h;}
+    void SetEventBuilder(EventData *ev) {builder = ev;}
     void SetEventNumber(const unsigned int &ev) {event_number = ev;}
+    void SetMapping(bool m) {use_mmap = m;}
+    void SetBufferPresize(bool p) {presize_buffer = p;}
+    void SetDecodeThreads(unsigned int n) {decode_threads = (n > 0) ? n : 1;}
+    // stage the raw GEM data of an event and feed them together at the end
+    // of the event, so the APVs can be processed in parallel
+    void SetGEMStaging(bool s) {gem_staging = s;}
+    bool IsGEMStaging() const {return gem_staging;}
+    // only parse the trigger, scaler and EPICS banks, it is a cheap parse for
+    // the events that are not fully decoded in online mode
+    void SetPartialParse(bool p) {partial_parse = p;}
+    bool IsPartialParse() const {return partial_parse;}
     unsigned int GetEventNumber() const {return event_number;}
+    PRadDataHandler *GetHandler() const {return myHandler;}
+    EventData *GetEventBuilder() const {return builder;}
+    unsigned int GetDecodeThreads() const {return decode_threads;}
+    bool IsMapping() const {return use_mmap;}
+    size_t GetBufferSize() const {return buffer_size;}
+
+    // decoder registry, the dispatch table is compiled for every change
+    // a decoder for a specific roc overrides the one for ANY_ROC
+    void RegisterDecoder(int roc, int bank, const BankDecoder &func, bool trigger_info = false);
+    void RemoveDecoder(int roc, int bank);
+    void ResetDecoders();
+    // the disabled rocs and banks are skipped without decoding
+    void EnableROC(int roc, bool e = true);
+    void EnableBank(int bank, bool e = true, int roc = ANY_ROC);
+    bool IsROCEnabled(int roc) const;
+    bool IsBankEnabled(int roc, int bank) const;
+    const std::vector<DecoderEntry> &GetDecoders() const {return decoders;}
+    const DispatchTable &GetDispatchTable() const {return *dispatch;}
 
 public:
     // static functions
     static PRadTriggerType bit_to_trigger(const unsigned int &bit);
     static unsigned int trigger_to_bit(const PRadTriggerType &trg);
+    static std::string index_path(const std::string &filepath);
+    static uint32_t peek_event_number(const PRadEventHeader *evt_header);
+    static PRadTriggerType peek_trigger(const PRadEventHeader *evt_header);
+    // decode n zero-suppressed GEM data words, the fields are extracted by
+    // fixed shifts and masks, so the loop can be vectorized
+    static void unpack_gem_zerosup(const uint32_t *words, size_t n, GEMZeroSupData *out);
 
 private:
     // private member functions
-    int parseEvioBlock(std::ifstream &s, uint32_t *buf, int max_evt) throw(PRadException);
+    int readEvioStream(const char *filepath, int max_evt, bool verbose);
+    int readEvioMapping(const char *filepath, int max_evt, bool verbose);
+    int readStreamAhead(PRadAsyncReader &in, int max_evt, const char *filepath);
+    void prefetch(std::string filepath);
+    void indexBlocks(const uint32_t *buf, size_t total);
+    void prepareIndex(const char *filepath);
+    size_t seekStart(const char *filepath);
+    int parseEvioBlock(PRadAsyncReader &s, int max_evt) throw(PRadException);
+    int parseEvioBlock(const uint32_t *buf, int max_evt);
+    int parseEvioBlocks(const uint32_t *buf, const std::vector<size_t> &blocks, int max_evt);
     int parseEvent(const PRadEventHeader *evt_header);
     void parseROCBank(const PRadEventHeader *roc_header);
-    void parseDataBank(const PRadEventHeader *data_header);
+    void parseROCTasks();
+    void parseDataBank(int roc_slot, const PRadEventHeader *data_header);
+    void compileDecoders();
     void parseADC1881M(const uint32_t *data);
     void parseGEMData(const uint32_t *data, const uint32_t &size, const int &fec_id);
     void parseGEMZeroSupData(const uint32_t *data, const uint32_t &size);
@@ -46,7 +210,52 @@ private:
 
 private:
     PRadDataHandler *myHandler;
+    EventData *builder;
+    BlockEvents *output;
     unsigned int event_number;
+    unsigned int decode_threads;
+    bool use_mmap;
+    bool presize_buffer;
+    bool gem_staging;
+    bool partial_parse;
+    std::vector<GEMRawData> gem_banks;
+    std::atomic<bool> read_stop;
+
+    // decoder registry, the compiled table is shared with the roc parsers
+    std::vector<DecoderEntry> decoders;
+    std::vector<int> rocs;
+    std::vector<std::pair<int, int>> disabled_banks;
+    std::shared_ptr<const DispatchTable> dispatch;
+
+    // trigger filter, 0 means accepting all
+    uint32_t trigger_mask;
+    uint64_t skipped_events;
+    uint64_t skipped_bytes;
+
+    // block index of the file, and the pending seek on it
+    bool use_index;
+    std::string index_file;
+    std::vector<BlockIndex> block_index;
+    int seek_block;
+    uint32_t skip_before;
+
+    // background reading of the next file to warm up the page cache
+    std::thread prefetch_thread;
+    std::atomic<bool> prefetch_stop;
+
+    // block buffer for stream reading, it only grows and is reused
+    uint32_t *block_buffer;
+    size_t buffer_size;
+
+    // large roc banks are parsed by the task pool, each of them is built into
+    // its own staging event and then merged, so no locks are needed
+    PRadTaskPool *roc_pool;
+    std::vector<const PRadEventHeader*> roc_tasks;
+    std::vector<EventData> roc_staging;
+    std::vector<PRadEvioParser*> roc_parsers;
+
+    // decoded zero-suppressed gem words of a bank, it only grows and is reused
+    std::vector<GEMZeroSupData> gem_zerosup;
 };
 
 #endif
@@ -0,0 +1,77 @@
+#ifndef PRAD_EVIO_SKIMMER_H
+#define PRAD_EVIO_SKIMMER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "datastruct.h"
+#include "PRadAsyncIO.h"
+
+// maximum size of an output block in words, the events are packed into the
+// blocks until it is reached
+#define SKIM_BLOCK_WORDS 2000000
+// evio block header size in words
+#define SKIM_HEADER_WORDS 8
+
+// write a smaller evio file with the selected events of the input files
+// the events are copied byte-for-byte without decoding their roc banks, only
+// the trigger type and event number are peeked, the block headers are
+// rewritten for the packed events
+// sync events are always kept for the scalers, and the control and EPICS
+// events are kept unless SetKeepControl(false)
+// the input and output files go through the asynchronous backend, so the next
+// input segments are read and the packed blocks are written while skimming
+class PRadEvioSkimmer
+{
+public:
+    PRadEvioSkimmer();
+    virtual ~PRadEvioSkimmer();
+
+    // selections, the physics events should pass all of them
+    // trigger mask 0 means accepting all the triggers
+    void SetTriggerMask(uint32_t mask) {trigger_mask = mask;}
+    void AcceptTrigger(const PRadTriggerType &trg);
+    // inclusive range of event numbers, an event in any range is accepted,
+    // no ranges means accepting all
+    void AddEventRange(uint32_t first, uint32_t last) {ranges.emplace_back(first, last);}
+    void ClearEventRanges() {ranges.clear();}
+    // stop after n physics events are copied, n <= 0 means no limit
+    void SetMaxEvents(int n) {max_events = n;}
+    void SetKeepControl(bool k) {keep_control = k;}
+    void SetBlockWords(uint32_t w) {block_words = (w > SKIM_HEADER_WORDS) ? w : SKIM_BLOCK_WORDS;}
+
+    // skim the inputs (such as split files of a run) into one output file
+    // return the number of copied physics events, -1 if the output fails
+    int Skim(const std::string &input, const std::string &output);
+    int Skim(const std::vector<std::string> &inputs, const std::string &output);
+
+    uint64_t GetInputBytes() const {return input_bytes;}
+    uint64_t GetOutputBytes() const {return output_bytes;}
+    uint64_t GetSkippedEvents() const {return skipped_events;}
+
+private:
+    bool copyFile(const std::string &path);
+    bool accept(const PRadEventHeader *header) const;
+    void append(const uint32_t *event, uint32_t size);
+    void flushBlock(bool last);
+
+private:
+    uint32_t trigger_mask;
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    int max_events;
+    bool keep_control;
+    uint32_t block_words;
+
+    // status of the current skim
+    PRadAsyncReader in;
+    PRadAsyncWriter out;
+    std::vector<uint32_t> in_block, out_block;
+    uint32_t header_tmpl[SKIM_HEADER_WORDS];
+    bool has_tmpl;
+    uint32_t block_number, block_events;
+    int copied;
+    uint64_t input_bytes, output_bytes, skipped_events;
+};
+
+#endif
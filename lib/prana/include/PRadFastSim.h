@@ -0,0 +1,145 @@
+#ifndef PRAD_FAST_SIM_H
+#define PRAD_FAST_SIM_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "PRadEventStruct.h"
+#include "PRadGenEventFile.h"
+#include "PRadCalibSnapshot.h"
+#include "PRadCoordSystem.h"
+
+// number of events simulated and written together
+#define FASTSIM_BLOCK 10000
+// events simulated by one task, they share the scratch buffers
+#define FASTSIM_TASK_EVENTS 256
+// maximum value of the hycal adc
+#define FASTSIM_ADC_MAX 8191
+// the showers are shared to the modules within this quantized distance
+#define FASTSIM_SHOWER_DIST 2.5
+// strips within this number of sigmas are filled for a gem hit
+#define FASTSIM_STRIP_SIGMAS 3.
+
+
+class PRadHyCalSystem;
+class PRadGEMSystem;
+class PRadSparsifier;
+class PRadClusterProfile;
+
+// parametric response of hycal and gems to the generated particles, the output
+// is the same raw data as the replayed events, so they can be written to dst
+// files and go through the whole reconstruction
+// hycal: the particle energy and position are smeared by the detector
+//        resolutions, the energy is shared to the modules by the cluster
+//        profile, and converted to adc values by the calibration constants and
+//        pedestals of the current run, then sparsified as the daq does
+// gems:  the charged particles leave gaussian charges on the strips of both
+//        planes, the strips are mapped back to the apv channels
+// every event has its own random stream from the seed and the event index, so
+// the output does not depend on the number of threads
+class PRadFastSim
+{
+public:
+    enum ParticleType
+    {
+        Ignored = 0,            // not simulated, such as the recoil proton
+        Charged,                // hycal and gems
+        Neutral,                // hycal only
+    };
+
+    // the strip table of a gem plane, plane strip number to apv channel
+    struct StripMap
+    {
+        float pos0, pitch;      // position of strip 0 and the strip step
+        uint32_t time_samples;
+        std::vector<GEMChannelAddress> strips;
+        std::vector<char> valid;
+
+        StripMap() : pos0(0.), pitch(1.), time_samples(0) {}
+    };
+
+    struct GEMLayout
+    {
+        int det_id;
+        StripMap planes[2];     // x and y
+    };
+
+public:
+    PRadFastSim(PRadHyCalSystem *h = nullptr, PRadGEMSystem *g = nullptr,
+                PRadCoordSystem *c = nullptr);
+    virtual ~PRadFastSim();
+
+    // systems, the gems are only simulated with the coordinate system
+    void SetHyCalSystem(PRadHyCalSystem *h) {hycal = h; prepared = false;}
+    void SetGEMSystem(PRadGEMSystem *g) {gem = g; prepared = false;}
+    void SetCoordSystem(PRadCoordSystem *c) {coord = c; prepared = false;}
+
+    // threads to simulate the events, 0 means the number of cores
+    void SetThreads(unsigned int n) {nthreads = n;}
+    unsigned int GetThreads() const {return nthreads;}
+    // seed of the random streams, the same seed gives the same events
+    void SetSeed(uint64_t s) {seed = s;}
+    uint64_t GetSeed() const {return seed;}
+    // particles in the order of the generator records, the default is the
+    // moller output (electron, electron, photon)
+    void SetParticleType(int i, ParticleType t);
+    ParticleType GetParticleType(int i) const {return ptypes[i];}
+    void SetTrigger(PRadTriggerType t) {trigger = t;}
+    // hycal response
+    void SetMinEnergy(double e) {min_energy = e;}
+    void SetNonLinearity(bool nl) {non_linear = nl;}
+    void SetSparsify(bool s) {sparsify = s;}
+    // gem response, the charge of a hit in adc units, the spread of the
+    // charge on strips in mm, and the minimum charge of a strip
+    void SetGEMEfficiency(double eff) {gem_eff = eff;}
+    void SetGEMCharge(double mean, double sigma) {gem_charge = mean; gem_charge_sig = sigma;}
+    void SetGEMSpread(double sigma) {gem_spread = sigma;}
+    void SetGEMThreshold(double thres) {gem_thres = thres;}
+
+    // take the calibration and detector layouts, it is called by Simulate if
+    // any system is changed, call it again after switching runs
+    bool Prepare();
+
+    // simulate n events, the event numbers start from first + 1, and the
+    // random streams are from the event indices starting by first
+    void Simulate(const PRadGenEventFile::Event *gen, size_t n, EventData *out,
+                  uint64_t first = 0);
+    // simulate the events from the binary generator file and save them in
+    // the dst file, max_events <= 0 means all the events
+    // return the number of saved events, -1 if the files cannot be opened
+    int64_t Simulate(const std::string &gen_path, const std::string &dst_path,
+                     int64_t max_events = 0, bool verbose = true);
+
+private:
+    struct Scratch;
+    void simEvent(const PRadGenEventFile::Event &gen, uint64_t index,
+                  EventData &event, Scratch &scr) const;
+    void simShower(float x, float y, double energy, Scratch &scr) const;
+    void simStrips(const StripMap &plane, float pos, float charge, EventData &event) const;
+    bool project(int det_id, const PRadGenEventFile::Particle &part,
+                 float &x, float &y) const;
+
+private:
+    PRadHyCalSystem *hycal;
+    PRadGEMSystem *gem;
+    PRadCoordSystem *coord;
+
+    unsigned int nthreads;
+    uint64_t seed;
+    ParticleType ptypes[GEN_EVENT_PARTICLES];
+    PRadTriggerType trigger;
+    double min_energy;
+    bool non_linear, sparsify;
+    double gem_eff, gem_charge, gem_charge_sig, gem_spread, gem_thres;
+
+    // taken by Prepare
+    bool prepared;
+    PRadCalibSnapshot::Ptr calib;
+    const PRadSparsifier *sparsifier;
+    const PRadClusterProfile *profile;
+    std::vector<int> mod_channel;           // adc channel id by module index
+    std::vector<GEMLayout> gem_layouts;
+    RunCoord run_coord;
+};
+
+#endif // PRAD_FAST_SIM_H
@@ -2,10 +2,13 @@
 #define PRAD_GEM_APV_H
 
 #include <vector>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include "PRadEventStruct.h"
 #include "datastruct.h"
+#include "PRadMemoryTracker.h"
 
 //1 time sample data have 128 channel
 #define APV_CHANNEL_SIZE 128
@@ -17,6 +20,17 @@
 // this depends on the configuration in the readout list
 #define APV_EXTEND_SIZE 130
 
+// time samples of a strip are padded to multiple of this number in the strip
+// major data
+#define STRIP_DATA_PAD 4
+
+// minimum entries for the pedestal statistics to update the pedestal
+#define GEM_PED_MIN_ENTRIES 1000
+// entries before the clipping of the pedestal statistics starts
+#define GEM_PED_CLIP_START 100
+// default fraction of the channels trimmed at both ends for the common mode
+#define GEM_CM_TRIM 0.25
+
 
 class PRadGEMFEC;
 class PRadGEMPlane;
@@ -25,6 +39,16 @@ class TH1I;
 class PRadGEMAPV
 {
 public:
+    // common mode from the thresholded mean, or from the sorted channels that
+    // are less biased by the fired strips in the high occupancy events
+    enum CommonModeMethod
+    {
+        CM_Mean = 0,
+        CM_Median,
+        CM_TrimmedMean,
+        Max_CommonModeMethods,
+    };
+
     struct Pedestal
     {
         float offset;
@@ -39,6 +63,27 @@ public:
         {}
     };
 
+    // streaming statistics of the pedestal data in flat arrays, the offsets
+    // are from the averaged raw values, and the noises are from the common
+    // mode subtracted values, by the Welford's algorithm
+    struct PedestalStats
+    {
+        uint32_t count[APV_CHANNEL_SIZE];
+        double offset_mean[APV_CHANNEL_SIZE];
+        double offset_m2[APV_CHANNEL_SIZE];
+        double noise_mean[APV_CHANNEL_SIZE];
+        double noise_m2[APV_CHANNEL_SIZE];
+
+        PedestalStats() {Reset();}
+        void Reset();
+        // samples beyond clip*sigma are rejected after GEM_PED_CLIP_START
+        // entries, clip <= 0 means no clipping
+        void Add(uint32_t ch, double offset, double noise, double clip);
+        double GetOffset(uint32_t ch) const {return offset_mean[ch];}
+        double GetNoise(uint32_t ch) const
+        {return (count[ch] > 1) ? std::sqrt(noise_m2[ch]/(count[ch] - 1)) : 0.;}
+    };
+
     struct StripNb
     {
         unsigned char local;
@@ -73,10 +118,13 @@ public:
     void ReleasePedHist();
     void FillPedHist();
     void ResetPedHist();
-    void FitPedestal();
+    // the pedestal is from the statistics, or from the gaussian fits of the
+    // histograms if root_fit is true
+    void FitPedestal(bool root_fit = false);
     void FillRawData(const uint32_t *buf, const uint32_t &siz);
     void FillZeroSupData(const uint32_t &ch, const uint32_t &ts, const unsigned short &val);
     void FillZeroSupData(const uint32_t &ch, const std::vector<float> &vals);
+    void FillZeroSupData(const uint32_t &ch, const float *vals, const uint32_t &size);
     void UpdatePedestal(std::vector<Pedestal> &ped);
     void UpdatePedestal(const Pedestal &ped, const uint32_t &index);
     void UpdatePedestal(const float &offset, const float &noise, const uint32_t &index);
@@ -88,6 +136,9 @@ public:
     void ResetHitPos();
     void PrintOutPedestal(std::ofstream &out);
     StripNb MapStrip(int ch);
+    // channel to strip mapping of all channels, the tables are shared by the
+    // APVs with the same configuration, and they are never released
+    static const StripNb *StripTable(bool special, bool reversed, int plane_index);
     bool IsCrossTalkStrip(const uint32_t &strip) const;
 
     // get parameters
@@ -101,15 +152,23 @@ public:
     int GetHeaderLevel() const {return header_level;}
     bool GetSplitStatus() const {return split;}
     float GetCommonModeThresLevel() const {return common_thres;}
+    int GetCommonModeMethod() const {return common_method;}
+    float GetCommonModeTrim() const {return common_trim;}
     float GetZeroSupThresLevel() const {return zerosup_thres;}
     float GetCrossTalkThresLevel() const {return crosstalk_thres;}
+    float GetPedestalClipLevel() const {return ped_clip;}
+    float GetPedestalTracking() const {return ped_track;}
+    const PedestalStats &GetPedestalStats() const {return ped_stats;}
     uint32_t GetBufferSize() const {return buffer_size;}
+    uint32_t GetHitCount() const;
     int GetLocalStripNb(const uint32_t &ch) const;
     int GetPlaneStripNb(const uint32_t &ch) const;
     PRadGEMFEC *GetFEC() const {return fec;}
     PRadGEMPlane *GetPlane() const {return plane;}
+    std::mutex &GetLocker() {return locker;}
     std::vector<TH1I *> GetHistList() const;
     std::vector<Pedestal> GetPedestalList() const;
+    MemoryUsage GetMemoryUsage() const;
     float GetMaxCharge(const uint32_t &ch) const;
     float GetAveragedCharge(const uint32_t &ch) const;
     float GetIntegratedCharge(const uint32_t &ch) const;
@@ -122,15 +181,26 @@ public:
     void SetTimeSample(const uint32_t &t);
     void SetOrientation(const int &o) {orient = o;}
     void SetHeaderLevel(const int &h) {header_level = h;}
-    void SetCommonModeThresLevel(const float &t) {common_thres = t;}
-    void SetZeroSupThresLevel(const float &t) {zerosup_thres = t;}
+    void SetCommonModeThresLevel(const float &t) {common_thres = t; kernel_update = true;}
+    void SetZeroSupThresLevel(const float &t) {zerosup_thres = t; kernel_update = true;}
+    // the trim is the fraction of channels excluded at both ends for the
+    // trimmed mean, the threshold level is only used by the mean
+    void SetCommonModeMethod(int m, float trim = GEM_CM_TRIM);
     void SetCrossTalkThresLevel(const float &t) {crosstalk_thres = t;}
+    void SetPedestalClipLevel(const float &c) {ped_clip = c;}
+    // pedestal tracking in physics events, the strips without hits update the
+    // pedestal by exponentially weighted statistics, weight 0 disables it
+    void SetPedestalTracking(const float &w) {ped_track = w;}
 
 private:
     void initialize();
     void getAverage(float &ave, const float *buf, const uint32_t &set = 0);
     uint32_t getTimeSampleStart();
     void buildStripMap();
+    void updateKernelArrays();
+    float sortedTrim() const {return (common_method == CM_Median) ? 0.5 : common_trim;}
+    void transposeData();
+    void trackPedestal();
 
 private:
     PRadGEMFEC *fec;
@@ -149,11 +219,32 @@ private:
     uint32_t buffer_size;
     uint32_t ts_begin;
     float *raw_data;
+    // corrected data in strip major, time samples of a strip are contiguous
+    uint32_t strip_stride;
+    float *strip_data;
     Pedestal pedestal[APV_CHANNEL_SIZE];
-    StripNb strip_map[APV_CHANNEL_SIZE];
+    const StripNb *strip_map;
     bool hit_pos[APV_CHANNEL_SIZE];
+    // the hit positions in bits
+    uint32_t hit_mask[APV_CHANNEL_SIZE/32];
     TH1I *offset_hist[APV_CHANNEL_SIZE];
     TH1I *noise_hist[APV_CHANNEL_SIZE];
+    PedestalStats ped_stats;
+    float ped_clip;
+    float ped_track;
+    int common_method;
+    float common_trim;
+
+    // thresholds for the kernels in structure of arrays, they are updated from
+    // pedestal, thresholds and strip map before the zero suppression
+    bool kernel_update;
+    float cm_offset[APV_CHANNEL_SIZE];
+    float cm_thres[APV_CHANNEL_SIZE];
+    int32_t cm_group[APV_CHANNEL_SIZE];
+    float zs_thres[APV_CHANNEL_SIZE];
+
+    // raw data space is shared by the events being decoded in parallel
+    std::mutex locker;
 };
 
 std::ostream &operator <<(std::ostream &os, const APVAddress &ad);
@@ -7,6 +7,10 @@
 #include "PRadEventStruct.h"
 #include "ConfigObject.h"
 
+// the cross talk clusters are checked against the position windows of the
+// characteristic distances when there are at least this number of clusters
+#define CROSS_TALK_WINDOW_MIN 16
+
 class PRadGEMDetector;
 
 class PRadGEMCluster : public ConfigObject
@@ -17,10 +21,17 @@ public:
 
     // functions that to be overloaded
     void Configure(const std::string &path = "");
+    // hash of the parameters
+    uint64_t SettingHash() const;
 
     bool IsGoodCluster(const StripCluster &cluster) const;
     void FormClusters(std::vector<StripHit> &hits,
                       std::vector<StripCluster> &clusters) const;
+    // the clusters in the container are reused, and the scratch buffers are
+    // from the context, so no allocation in the steady state
+    void FormClusters(std::vector<StripHit> &hits,
+                      std::vector<StripCluster> &clusters,
+                      StripClusterContext &ctx) const;
     void CartesianReconstruct(const std::vector<StripCluster> &x_cluster,
                               const std::vector<StripCluster> &y_cluster,
                               std::vector<GEMHit> &container,
@@ -28,9 +39,12 @@ public:
                               float resolution) const;
 
 protected:
-    void groupHits(std::vector<StripHit> &h, std::vector<StripCluster> &c) const;
+    size_t groupHits(std::vector<StripHit> &h, std::vector<StripCluster> &c,
+                     StripClusterContext &ctx) const;
     void reconstructCluster(StripCluster &cluster) const;
     void setCrossTalk(std::vector<StripCluster> &clusters) const;
+    void setCrossTalk(std::vector<StripCluster> &clusters, StripClusterContext &ctx) const;
+    void setCrossTalkDirect(std::vector<StripCluster> &clusters) const;
 
 protected:
     // parameters
@@ -39,6 +53,11 @@ protected:
     unsigned int consecutive_thres;
     float split_cluster_diff;
     float cross_talk_width;
+    // charge correlation of x and y clusters, only the pairs with
+    // y/x charge ratio within [center/window, center*window] are accepted,
+    // window <= 1 means accepting all the combinations
+    float charge_ratio_window;
+    float charge_ratio_center;
 
     // cross talk characteristic distances
     std::vector<float> charac_dists;
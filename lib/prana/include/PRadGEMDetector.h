@@ -50,6 +50,10 @@ public:
     void DisconnectPlane(const int &type, bool false_disconn = false);
     void ConnectPlanes();
     void Reconstruct(PRadGEMCluster *c);
+    // the two steps of Reconstruct, the planes can be clustered in parallel
+    // since the cluster method is reentrant
+    void FormClusters(PRadGEMCluster *c);
+    void ReconstructHits(PRadGEMCluster *c);
     void CollectHits();
     void ClearHits();
     void Reset();
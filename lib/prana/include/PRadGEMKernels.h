@@ -0,0 +1,75 @@
+#ifndef PRAD_GEM_KERNELS_H
+#define PRAD_GEM_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+
+// maximum channels of the sorted common mode kernels
+#define CM_SORT_SIZE 128
+
+// vectorized kernels for the GEM APV data processing, the kernels are chosen
+// at runtime by the cpu features, the results are identical to the scalar
+// versions, except that the common mode sums are accumulated in several lanes
+// and thus may differ in the last bits
+class PRadGEMKernels
+{
+public:
+    enum KernelType
+    {
+        Scalar = 0,
+        SSE,
+        AVX2,
+        AVX512,
+    };
+
+    typedef void (*UnpackKernel)(const uint32_t *buf, size_t size, float *out);
+    typedef void (*CommonModeKernel)(float *buf, const float *offset, const float *thres,
+                                     const int32_t *group, size_t size);
+    typedef void (*SortedCommonModeKernel)(float *buf, const float *offset, const int32_t *group,
+                                           size_t size, float trim);
+    typedef void (*ZeroSupKernel)(const float *buf, size_t stride, uint32_t nts,
+                                  const float *thres, size_t size, uint32_t *mask);
+
+public:
+    // split the 32 bit SRS words into 2 16 bit adc values with the endianness
+    // changed, out should have space for 2*size values
+    static void UnpackRaw(const uint32_t *buf, size_t size, float *out)
+    {unpack_kernel(buf, size, out);}
+
+    // common mode correction of one time sample, buf = offset - buf, and the
+    // average of the channels below thres is subtracted, the averages are
+    // separated for the channels in group 0 and group -1 (all bits set)
+    static void CommonMode(float *buf, const float *offset, const float *thres,
+                           const int32_t *group, size_t size)
+    {cm_kernel(buf, offset, thres, group, size);}
+
+    // common mode correction of one time sample from the sorted channels, the
+    // median (trim >= 0.5) or the mean without the trim fraction at both ends
+    // is subtracted, the groups are the same as CommonMode, the channels are
+    // sorted by bitonic networks in the vector registers, and the results are
+    // identical to the scalar version, size should not exceed CM_SORT_SIZE
+    static void SortedCommonMode(float *buf, const float *offset, const int32_t *group,
+                                 size_t size, float trim)
+    {cm_sort_kernel(buf, offset, group, size, trim);}
+
+    // zero suppression, channel i is fired if the average of its nts time
+    // samples buf[i + ts*stride] is above thres[i], the results are set as
+    // bits in mask, which should have space for (size + 31)/32 words
+    static void ZeroSup(const float *buf, size_t stride, uint32_t nts,
+                        const float *thres, size_t size, uint32_t *mask)
+    {zs_kernel(buf, stride, nts, thres, size, mask);}
+
+    // kernel selection, fall back to the best supported one
+    static void SetKernel(KernelType type);
+    static KernelType GetKernel() {return ktype;}
+    static KernelType BestKernel();
+
+private:
+    static KernelType ktype;
+    static UnpackKernel unpack_kernel;
+    static CommonModeKernel cm_kernel;
+    static SortedCommonModeKernel cm_sort_kernel;
+    static ZeroSupKernel zs_kernel;
+};
+
+#endif // PRAD_GEM_KERNELS_H
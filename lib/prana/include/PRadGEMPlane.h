@@ -17,6 +17,19 @@
 class PRadGEMDetector;
 class PRadGEMCluster;
 
+// scratch buffers of the strip clustering, every plane has its own context, so
+// the planes can be clustered by different threads, the buffers only grow and
+// are reused by the next events
+struct StripClusterContext
+{
+    std::vector<uint32_t> counts;   // counting sort by strip number
+    std::vector<StripHit> sorted;
+    std::vector<StripHit> dup1;     // duplicated strips of the central hole
+    std::vector<StripHit> dup2;
+    std::vector<std::pair<float, uint32_t>> ct_pos; // cluster positions with the peak order
+    std::vector<uint32_t> ct_table;                 // range maximum of the peak order
+};
+
 class PRadGEMPlane
 {
 public:
@@ -92,6 +105,7 @@ private:
     // plane raw hits and clusters
     std::vector<StripHit> strip_hits;
     std::vector<StripCluster> strip_clusters;
+    StripClusterContext cluster_ctx;
 };
 
 #endif
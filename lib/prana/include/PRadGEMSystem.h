@@ -11,13 +11,22 @@
 #include "PRadGEMDetector.h"
 #include "PRadGEMFEC.h"
 #include "PRadGEMCluster.h"
+#include "PRadReconCache.h"
+#include "PRadHistSnapshot.h"
+#include "PRadMemoryTracker.h"
 #include "ConfigObject.h"
 #include <mutex>
 
 
+class PRadTaskPool;
+
 // fec id should be consecutive from 0
 // enlarge this value if there are more FECs
 #define MAX_FEC_ID 12
+// events are distributed to the threads in blocks for batch reconstruction
+#define GEM_BATCH_BLOCK 64
+// zero-suppressed words are grouped by the 4-bit fec id and 4-bit adc channel
+#define GEM_ZEROSUP_KEYS 256
 
 class PRadGEMSystem : public ConfigObject
 {
@@ -49,26 +58,63 @@ public:
     void Clear();
     void ChooseEvent(const EventData &data);
     void Reconstruct();
+    // the hits are cached by the event if the cache is enabled, the strip hits
+    // and clusters on the planes are not restored from cache
     void Reconstruct(const EventData &data);
+    // reconstruct n events by several threads, each of them reconstructs on its
+    // own copy of the system, out should have n containers for the hits of all
+    // detectors, the cache is not used
+    void ReconstructBatch(const EventData *events, size_t n, std::vector<GEMHit> *out,
+                          unsigned int nthreads = 0) const;
+    // the hits of all the events are put in columns, tagged by the event index
+    void ReconstructBatch(const EventData *events, size_t n, GEMHitSoA &out,
+                          unsigned int nthreads = 0) const;
     int GetStripCrossTalkFlag(const GEM_Data &p, const GEM_Data &c, const GEM_Data &n);
     void RebuildDetectorMap();
     void RebuildDAQMap();
     void FillRawData(const GEMRawData &raw, EventData &event);
+    // raw data of the APVs from one event, they are processed in parallel if
+    // the apv threads are set, the hits are appended in the order of raws
+    void FillRawData(const GEMRawData *raws, size_t n, EventData &event);
     void FillZeroSupData(const std::vector<GEMZeroSupData> &data_pack, EventData &event);
+    // the words are grouped by APVs with a counting sort, so each APV is looked
+    // up once for its words
+    void FillZeroSupData(const GEMZeroSupData *data, size_t n, EventData &event);
     void FillZeroSupData(const GEMZeroSupData &data);
     bool Register(PRadGEMDetector *det);
     bool Register(PRadGEMFEC *fec);
 
     void SetUnivCommonModeThresLevel(const float &thres);
+    // median or trimmed mean common mode, see PRadGEMAPV::CommonModeMethod
+    void SetUnivCommonModeMethod(int method, float trim = GEM_CM_TRIM);
     void SetUnivZeroSupThresLevel(const float &thres);
     void SetUnivTimeSample(const uint32_t &thres);
-    void SetPedestalMode(const bool &m);
-    void FitPedestal();
+    // exponential weight of the pedestal tracking, 0 disables it
+    void SetUnivPedestalTracking(const float &weight);
+    // the ROOT histograms of channels are only filled with root_hist
+    void SetPedestalMode(const bool &m, bool root_hist = false);
+    // 0 means the number of cores, 1 means processing APVs serially, the
+    // threads also cluster the planes in parallel for Reconstruct
+    void SetAPVThreads(unsigned int n);
+    unsigned int GetAPVThreads() const {return apv_threads;}
+    // pedestal from the statistics in parallel, or from the gaussian fits of
+    // the histograms one by one with root_fit, nthreads = 0 means all cores
+    void FitPedestal(bool root_fit = false, unsigned int nthreads = 0);
     void Reset();
     void SavePedestal(const std::string &path) const;
     void SaveHistograms(const std::string &path) const;
+    // a copy of the APV histograms, see PRadHyCalSystem::SnapshotHists
+    PRadHistSnapshot SnapshotHistograms() const;
+    bool SaveHistSnapshot(const std::string &path) const;
+    std::future<bool> SaveHistogramsAsync(const std::string &path) const;
 
     PRadGEMCluster *GetClusterMethod() {return &gem_recon;}
+
+    // results cache, the changes of the cluster method parameters are checked
+    // by their hash, it is cleared when the system settings are changed
+    void SetCacheSize(size_t size) {recon_cache.SetCapacity(size);}
+    size_t GetCacheSize() const {return recon_cache.GetCapacity();}
+    void ClearCache() {recon_cache.Clear();}
     PRadGEMDetector *GetDetector(const int &id) const;
     PRadGEMDetector *GetDetector(const std::string &name) const;
     PRadGEMFEC *GetFEC(const int &id) const;
@@ -78,6 +124,7 @@ public:
     std::vector<GEM_Data> GetZeroSupData() const;
     std::vector<PRadGEMAPV*> GetAPVList() const;
     std::vector<PRadGEMFEC*> GetFECList() const;
+    MemoryUsage GetMemoryUsage() const;
     std::vector<PRadGEMDetector*> GetDetectorList() const;
 
 private:
@@ -86,6 +133,8 @@ private:
     void buildPlane(std::list<ConfigValue> &pln_args);
     void buildFEC(std::list<ConfigValue> &fec_args);
     void buildAPV(std::list<ConfigValue> &apv_args);
+    void processAPV(const GEMRawData &raw, const EventData &event,
+                    std::vector<GEM_Data> &hits);
 
 private:
     PRadGEMCluster gem_recon;
@@ -102,8 +151,18 @@ private:
     float def_zth;
     float def_ctth;
 
-    // a locker for multi threading
+    // hits of the detectors in det_slots by the events
+    PRadReconCache<std::vector<std::vector<GEMHit>>> recon_cache;
+
+    // a locker for multi threading, zero-suppressed data involve all the APVs
     std::mutex __gem_locker;
+    // staging buffers to group the zero-suppressed words, guarded by the locker
+    std::vector<GEMZeroSupData> zs_sorted;
+    std::vector<uint32_t> zs_start, zs_fill;
+
+    // pool for processing the APVs or planes of one event in parallel
+    unsigned int apv_threads;
+    PRadTaskPool *apv_pool;
 };
 
 #endif
@@ -0,0 +1,132 @@
+#ifndef PRAD_GAIN_MONITOR_H
+#define PRAD_GAIN_MONITOR_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cmath>
+#include "PRadEventStruct.h"
+
+// default number of monitor events in a window
+#define GAIN_MONITOR_WINDOW 500
+// separation of the pedestal and alpha source signals of a reference PMT
+#define GAIN_MONITOR_REF_SEP 1000
+// the led signal of a module should be above its pedestal by this value
+#define GAIN_MONITOR_MIN_LED 30
+// minimum entries of a running mean to be used
+#define GAIN_MONITOR_MIN_ENTRIES 10
+
+
+// gain monitoring from the LMS events while they are read
+// the led signals of the channels and the pedestal and alpha source signals of
+// the reference PMTs are accumulated as running means, a window is closed
+// every N monitor events, and the gains of the window are
+//     ref_gain = (led - ped)/(alpha - ped) of the reference PMT
+//     gain = (led - pedestal)/ref_gain of a module
+// the same factors as PRadHyCalSystem::CorrectGainFactor from the whole run
+// the alpha events are rare, the reference pedestal and alpha are kept from
+// the last windows until there are enough new entries
+// a monitor is filled by one thread, it is owned by the system that fills it
+class PRadGainMonitor
+{
+public:
+    // a channel by its id in the events
+    struct Channel
+    {
+        std::string name;
+        double ped;
+        int ref;                // reference PMT index, -1 for the others
+        bool module;            // connected to a HyCal module
+    };
+
+    struct ChannelGain
+    {
+        float led, led_sigma, gain;     // gain is 0 if not measured
+        uint32_t entries;
+    };
+
+    // the gains of a window
+    struct Window
+    {
+        int run;
+        uint32_t index;
+        int32_t first_event, last_event;
+        uint64_t begin_time, end_time;
+        uint32_t led_events, alpha_events;
+        // reference gains in the order of LMS1, LMS2, ..., 0 if not measured
+        std::vector<double> ref_gains;
+        std::vector<ChannelGain> channels;
+    };
+
+    typedef std::function<void(const Window &)> Callback;
+
+public:
+    PRadGainMonitor(unsigned int window = 0, int ref = 2);
+
+    // 0 window disables the monitor
+    void SetWindow(unsigned int n) {window_size = n;}
+    // reference PMT for the module gains, started from 1 as in CorrectGainFactor
+    void SetReference(int r) {ref = r;}
+    void SetCallback(Callback cb) {callback = cb;}
+    // the windows are kept for GetSeries and SaveSeries
+    void SetKeepSeries(bool k) {keep = k;}
+    // the current window is closed before the change
+    void SetChannels(const std::vector<Channel> &chs);
+    void SetRun(int run);
+
+    // only the monitor events are used
+    void Fill(const EventData &event);
+    // close the current window even if it is not full
+    void Flush();
+    // remove the series and the running means
+    void Reset();
+
+    bool IsEnabled() const {return window_size > 0;}
+    unsigned int GetWindow() const {return window_size;}
+    int GetReference() const {return ref;}
+    const std::vector<Window> &GetSeries() const {return series;}
+    bool SaveSeries(const std::string &path) const;
+
+private:
+    // running mean and variance
+    struct Stat
+    {
+        uint32_t n;
+        double mean, m2;
+
+        Stat() : n(0), mean(0.), m2(0.) {}
+        void Add(double x)
+        {
+            ++n;
+            double d = x - mean;
+            mean += d/n;
+            m2 += d*(x - mean);
+        }
+        double Sigma() const {return (n > 1) ? std::sqrt(m2/(n - 1)) : 0.;}
+        bool Valid() const {return n >= GAIN_MONITOR_MIN_ENTRIES;}
+    };
+
+    void close();
+
+private:
+    unsigned int window_size;
+    int ref, run;
+    bool keep;
+    Callback callback;
+    std::vector<Channel> channels;
+    std::vector<int> ref_channels;
+
+    // current window
+    uint32_t index, led_events, alpha_events;
+    int32_t first_event, last_event;
+    uint64_t begin_time, end_time;
+    std::vector<Stat> leds;
+    // pedestal and alpha signals of the reference PMTs, and the values kept
+    std::vector<Stat> ref_peds, ref_alphas;
+    std::vector<double> last_peds, last_alphas;
+
+    std::vector<Window> series;
+};
+
+#endif // PRAD_GAIN_MONITOR_H
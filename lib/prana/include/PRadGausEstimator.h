@@ -0,0 +1,41 @@
+#ifndef PRAD_GAUS_ESTIMATOR_H
+#define PRAD_GAUS_ESTIMATOR_H
+
+#include <vector>
+
+// half width of the window in sigma for the truncated moments
+#define GAUS_EST_WINDOW 2.5
+// maximum number of iterations
+#define GAUS_EST_ITERS 20
+
+
+class TH1;
+
+// estimate the mean and sigma of a gaussian peak from histogram bins without
+// fitting, it starts from the highest bin and its full width at half maximum,
+// and iterates the moments within mean +- GAUS_EST_WINDOW*sigma, the sigma is
+// corrected for the truncation and the bin width
+// the functions only read the histograms, so different histograms can be
+// estimated by different threads
+class PRadGausEstimator
+{
+public:
+    struct Result
+    {
+        double mean, sigma, entries;
+        unsigned int iters;
+        bool valid;
+
+        Result() : mean(0.), sigma(0.), entries(0.), iters(0), valid(false) {}
+    };
+
+public:
+    // fixed bins of width, the first bin starts from xmin
+    static Result Estimate(const double *bins, int nbins, double xmin, double width,
+                           double min_entries = 0.);
+    // bins of the histogram in [range_min, range_max), only with ROOT
+    static Result Estimate(const TH1 *hist, double range_min, double range_max,
+                           double min_entries = 0.);
+};
+
+#endif // PRAD_GAUS_ESTIMATOR_H
@@ -0,0 +1,76 @@
+#ifndef PRAD_GEN_EVENT_FILE_H
+#define PRAD_GEN_EVENT_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+// version of the binary event file
+#define GEN_EVENT_VERSION 1
+// number of outgoing particles in an event record
+#define GEN_EVENT_PARTICLES 3
+// maximum length of the generator name
+#define GEN_EVENT_NAME 16
+
+
+// binary event file of the event generators, it has a header with the
+// generator parameters and the integrated luminosity, followed by fixed size
+// records of the outgoing particles
+// the particles are the same as the columns of the text output, a particle
+// that is not emitted (no hard photon) has all zeros
+class PRadGenEventFile
+{
+public:
+    struct Particle
+    {
+        float p, theta, phi;    // MeV, rad, rad
+    };
+
+    struct Event
+    {
+        Particle part[GEN_EVENT_PARTICLES];
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version, nparticles;
+        char generator[GEN_EVENT_NAME];
+        // beam energy (MeV), angle range (deg), photon energy range (MeV)
+        double energy, min_angle, max_angle, v_min, v_cut;
+        // integrated luminosity (nb^-1)
+        double luminosity;
+        uint64_t nevents, seed;
+    };
+
+public:
+    PRadGenEventFile();
+    virtual ~PRadGenEventFile();
+
+    PRadGenEventFile(const PRadGenEventFile &) = delete;
+    PRadGenEventFile &operator =(const PRadGenEventFile &) = delete;
+
+    // reader
+    bool Open(const std::string &path);
+    void Close();
+    // read the next event, false at the end of the file
+    bool Read(Event &event);
+    // read at most n events, returns the number of events read
+    size_t Read(std::vector<Event> &events, size_t n);
+
+    bool IsOpen() const {return in.is_open();}
+    const Header &GetHeader() const {return header;}
+    uint64_t GetEventsRead() const {return nread;}
+
+    // header with the magic word and version filled, the others are zero
+    static Header MakeHeader(const std::string &generator);
+    static Event MakeEvent(const double *vals);
+
+private:
+    std::ifstream in;
+    Header header;
+    uint64_t nread;
+};
+
+#endif // PRAD_GEN_EVENT_FILE_H
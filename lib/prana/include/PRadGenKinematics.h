@@ -0,0 +1,45 @@
+#ifndef PRAD_GEN_KINEMATICS_H
+#define PRAD_GEN_KINEMATICS_H
+
+#include <vector>
+#include <cstddef>
+#include "PRadGenEventFile.h"
+
+
+// kinematics of the generated particles for blocks of events
+// the four momenta of one particle are saved in separated arrays (SoA), so the
+// loops over the events are simple and can be vectorized by the compiler
+class PRadGenKinematics
+{
+public:
+    // four momenta (E, px, py, pz) of one particle in a block of events
+    struct Block
+    {
+        std::vector<double> e, px, py, pz;
+
+        void resize(size_t n) {e.resize(n); px.resize(n); py.resize(n); pz.resize(n);}
+        size_t size() const {return e.size();}
+        void set(size_t i, const double *p) {e[i] = p[0]; px[i] = p[1]; py[i] = p[2]; pz[i] = p[3];}
+    };
+
+public:
+    // boost along z axis, E and pz are changed in place
+    static void BoostZ(Block &block, double beta);
+    // momentum magnitude
+    static void Momentum(const Block &block, double *p);
+    // polar angle in [0, pi/2], the same as the text output of the generators
+    static void Polar(const Block &block, double *theta);
+    // azimuthal angle, atan2(px, py) as the text output of the generators
+    static void Azimuthal(const Block &block, double *phi);
+
+    // convert the particles to the records of binary file, a particle is zero
+    // if its mask is 0, the masks can be nullptr (all particles are emitted)
+    static void FillEvents(const Block *parts, const char *const *masks,
+                           PRadGenEventFile::Event *events, size_t n);
+    // the momentum, polar and azimuthal angles of the particles in the order
+    // of the text columns for every event
+    static void FillValues(const Block *parts, const char *const *masks,
+                           double *vals, size_t n);
+};
+
+#endif // PRAD_GEN_KINEMATICS_H
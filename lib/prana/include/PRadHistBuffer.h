@@ -0,0 +1,89 @@
+#ifndef PRAD_HIST_BUFFER_H
+#define PRAD_HIST_BUFFER_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "PRadEventStruct.h"
+
+
+class TH1;
+class TAxis;
+class PRadADCChannel;
+class PRadTDCChannel;
+
+// integer histograms buffering the filling of the ROOT histograms of the
+// hycal channels, since ROOT histograms are not thread safe
+// every thread fills its own buffer without any lock, the buffers are merged
+// and converted to the ROOT histograms on demand
+// the channels and their histograms should not be changed while a buffer of
+// their layout is being used
+class PRadHistBuffer
+{
+public:
+    // binning of a ROOT histogram, bin 0 and nbins + 1 are underflow and
+    // overflow as in ROOT
+    struct Hist
+    {
+        TH1 *target;
+        const TAxis *axis;      // only used for the variable bins
+        size_t offset;          // first bin in the counts
+        int nbins;
+        double min, max;
+        bool fixed;
+
+        int FindBin(double x) const;
+    };
+
+    // histograms of the channels, it is shared by the buffers of all threads
+    struct Layout
+    {
+        std::vector<const PRadADCChannel*> adcs;    // by adc channel id
+        std::vector<int> adc_hists;                 // by id*MAX_Trigger + trigger
+        std::vector<int> tdc_hists;                 // by tdc channel id
+        int energy_hist;
+        std::vector<Hist> hists;
+        size_t nbins;
+
+        Layout() : energy_hist(-1), nbins(0) {}
+    };
+
+public:
+    PRadHistBuffer(std::shared_ptr<const Layout> layout = nullptr);
+
+    // the channel lists are indexed by channel id
+    static std::shared_ptr<const Layout> BuildLayout(const std::vector<PRadADCChannel*> &adcs,
+                                                     const std::vector<PRadTDCChannel*> &tdcs,
+                                                     TH1 *energy_hist);
+
+    // fill the adc values for all events, energy and tdc for physics events
+    void Fill(const EventData &event);
+    void FillEnergy(double energy) {fill(layout->energy_hist, energy);}
+    // add the counts of a buffer with the same layout
+    bool Merge(const PRadHistBuffer &that);
+    void Reset();
+    // add the counts to the ROOT histograms and reset the buffer
+    void Flush();
+
+    const std::shared_ptr<const Layout> &GetLayout() const {return layout;}
+    uint64_t GetEntries() const {return entries_total;}
+
+private:
+    void fill(int h, double x)
+    {
+        if(h < 0)
+            return;
+        auto &hist = layout->hists[h];
+        counts[hist.offset + hist.FindBin(x)]++;
+        entries[h]++;
+        entries_total++;
+    }
+
+private:
+    std::shared_ptr<const Layout> layout;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> entries;
+    uint64_t entries_total;
+};
+
+#endif // PRAD_HIST_BUFFER_H
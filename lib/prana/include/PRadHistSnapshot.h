@@ -0,0 +1,67 @@
+#ifndef PRAD_HIST_SNAPSHOT_H
+#define PRAD_HIST_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <future>
+#include <cstdint>
+
+// version of the snapshot file
+#define HIST_SNAPSHOT_VERSION 1
+
+
+class TH1;
+
+// a copy of the channel histograms, the bins of all histograms are in one
+// contiguous array, and the metadata of the histograms index into it
+// a snapshot file is written with a single write, so saving thousands of the
+// channel histograms does not go through the ROOT objects one by one
+// the snapshot is independent of the histograms once it is taken, it can be
+// exported to a ROOT file on a background thread while the histograms are
+// filled or reset for the next run
+class PRadHistSnapshot
+{
+public:
+    struct Hist
+    {
+        std::string dir;        // directory in the ROOT file, "" for the top
+        std::string name, title;
+        int32_t nbins;
+        double min, max, entries;
+        // the nbins + 2 contents include the underflow and overflow bins, the
+        // nbins + 1 edges are only stored for the variable bins
+        uint64_t offset, edges;
+        bool fixed;
+    };
+
+public:
+    PRadHistSnapshot();
+
+    // copy the bins of a 1d ROOT histogram
+    bool Add(const std::string &dir, const TH1 *hist);
+    void Clear();
+
+    bool Save(const std::string &path) const;
+    bool Load(const std::string &path);
+
+    // write the histograms to a ROOT file, in the same directories and
+    // order they were added
+    bool ExportROOT(const std::string &path) const;
+    // export on a background thread (MULTI_THREAD), the snapshot is copied,
+    // the future should be kept until the file is needed, since its
+    // destructor waits for the export
+    std::future<bool> ExportROOTAsync(const std::string &path) const;
+
+    const std::vector<Hist> &GetHists() const {return hists;}
+    const std::vector<double> &GetBins() const {return bins;}
+    const double *GetContents(const Hist &h) const {return &bins[h.offset];}
+    const double *GetEdges(const Hist &h) const {return h.fixed ? nullptr : &bins[h.edges];}
+    size_t Size() const {return hists.size();}
+    bool Empty() const {return hists.empty();}
+
+private:
+    std::vector<Hist> hists;
+    std::vector<double> bins;
+};
+
+#endif // PRAD_HIST_SNAPSHOT_H
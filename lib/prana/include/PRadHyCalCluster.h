@@ -2,17 +2,196 @@
 #define PRAD_HYCAL_CLUSTER_H
 
 #include <vector>
+#include <memory>
+#include <cstdint>
 #include "PRadEventStruct.h"
+#include "PRadClusterProfile.h"
 
 
 
+// do not split the group if the number of hits in it exceed this number
+#define SPLIT_MAX_HITS 100
+// do not split the group if the number of maxima in it exceed this number
+#define SPLIT_MAX_MAXIMA 10
+
+struct SplitContainer
+{
+    float frac[SPLIT_MAX_HITS][SPLIT_MAX_MAXIMA], total[SPLIT_MAX_HITS];
+    // distances and profiles of the hits to one center
+    float dist[SPLIT_MAX_HITS], prof[SPLIT_MAX_HITS];
+    // distance profile of every maximum, reused through the iterations
+    PRadClusterProfile::Row rows[SPLIT_MAX_MAXIMA];
+
+    // a helper function to sum 2d array
+    void sum_frac(size_t hits, size_t maximums)
+    {
+        for(size_t i = 0; i < hits; ++i)
+        {
+            total[i] = 0;
+            for(size_t j = 0; j < maximums; ++j)
+                total[i] += frac[i][j];
+        }
+    }
+
+    // get the normalized fraction
+    inline float norm_frac(size_t i, size_t j)
+    {
+        return frac[j][i]/total[j];
+    }
+};
+
+// counters of the iterations in reconstruction, for tuning the convergence
+struct ReconStats
+{
+    uint64_t split_groups, split_iters, leak_clusters, leak_iters;
+
+    ReconStats() {Clear();}
+    void Clear() {split_groups = 0, split_iters = 0, leak_clusters = 0, leak_iters = 0;}
+    ReconStats &operator +=(const ReconStats &rhs)
+    {
+        split_groups += rhs.split_groups, split_iters += rhs.split_iters;
+        leak_clusters += rhs.leak_clusters, leak_iters += rhs.leak_iters;
+        return *this;
+    }
+};
+
+// shape moments of the hits of a group or a cluster
+struct ShapeMoments
+{
+    uint32_t nhits;
+    float energy, max_energy;
+    // energy weighted centroid and second central moments (mm, mm^2)
+    float x, y, sxx, syy, sxy;
+    // line fit y = k*x + b of the module centers, chisq is normalized by the
+    // module size, rsq is 0 and chisq is 10 if it cannot be fitted
+    float k, b, rsq, chisq;
+    // mean relative deviation of the hit energies, 10 for a single hit
+    float uniform;
+
+    ShapeMoments()
+    : nhits(0), energy(0), max_energy(0), x(0), y(0), sxx(0), syy(0), sxy(0),
+      k(0), b(0), rsq(0), chisq(10), uniform(10)
+    {}
+
+    static ShapeMoments Eval(const std::vector<ModuleHit*> &hits);
+    static ShapeMoments Eval(const std::vector<ModuleHit> &hits);
+};
+
+// a group of adjacent hits formed by the clustering, its local maxima and the
+// clusters split from it
+struct GroupInfo
+{
+    uint32_t group;                 // index in ClusterContext::groups
+    uint32_t max_begin, max_end;    // range in ClusterContext::maxima
+    uint32_t cl_begin, cl_end;      // range in the formed clusters
+    ShapeMoments shape;
+};
+
+// scratch buffers of the clustering methods, the methods keep no state of
+// events, so they can be shared by the threads with their own contexts
+struct ClusterContext
+{
+    std::vector<std::vector<ModuleHit*>> groups;
+    // hit index of every module by its index in detector, -1 for no hit
+    std::vector<int> hit_slots;
+    SplitContainer split;
+    ReconStats stats;
+
+    // the topology of the last clustered event, it is only recorded if
+    // keep_groups is set, the hits point to the module hits of the event
+    bool keep_groups;
+    std::vector<GroupInfo> group_info;
+    std::vector<ModuleHit*> maxima;
+    // shapes of the formed clusters, before the leakage correction
+    std::vector<ShapeMoments> cluster_shapes;
+
+    // scratch of the leakage correction, the virtual hits of a cluster and
+    // their energies before the last iteration
+    std::vector<ModuleHit> vhits;
+    std::vector<double> vhits_e;
+
+    // the clusters and groups of the last event are moved to the pools, so
+    // the next event reuses their memory instead of growing new vectors
+    std::vector<ModuleCluster> cluster_pool;
+    std::vector<std::vector<ModuleHit*>> group_pool;
+    // local maxima of a group, visited hits and cluster indices of a hit
+    std::vector<ModuleHit*> local_max;
+    std::vector<uint8_t> visits;
+    std::vector<unsigned int> indices;
+
+    // the large events are clustered by several threads if intra_event is set,
+    // it is not set for the contexts of the event-parallel batches
+    bool intra_event;
+    // hits of every sector, the sector group of every hit and the links of
+    // the hits across sectors, the seeds are the first hits of the groups
+    std::vector<std::vector<int>> sector_hits;
+    std::vector<std::vector<std::pair<int, int>>> sector_links;
+    std::vector<int> hit_sectors, labels, seeds;
+    // the clusters of every group and the scratch of the threads
+    std::vector<std::vector<ModuleCluster>> group_clusters;
+    std::vector<std::unique_ptr<ClusterContext>> workers;
+
+    ClusterContext() : keep_groups(false), intra_event(true) {}
+    void ClearGroups() {group_info.clear(); maxima.clear(); cluster_shapes.clear();}
+
+    void RecycleClusters(std::vector<ModuleCluster> &cls)
+    {
+        for(auto &cl : cls)
+            cluster_pool.emplace_back(std::move(cl));
+        cls.clear();
+    }
+
+    // add a cluster to the end of cls, it is from the pool if there is one
+    ModuleCluster &NewCluster(std::vector<ModuleCluster> &cls, const ModuleHit &center,
+                              uint32_t flag)
+    {
+        if(cluster_pool.empty()) {
+            cls.emplace_back(center, flag);
+        } else {
+            cls.emplace_back(std::move(cluster_pool.back()));
+            cluster_pool.pop_back();
+            cls.back().Reset(center, flag);
+        }
+        return cls.back();
+    }
+
+    void RecycleGroups()
+    {
+        for(auto &group : groups)
+        {
+            group.clear();
+            group_pool.emplace_back(std::move(group));
+        }
+        groups.clear();
+    }
+
+    std::vector<ModuleHit*> &NewGroup()
+    {
+        if(group_pool.empty()) {
+            groups.emplace_back();
+        } else {
+            groups.emplace_back(std::move(group_pool.back()));
+            group_pool.pop_back();
+        }
+        return groups.back();
+    }
+};
+
 class PRadHyCalCluster
 {
 public:
     virtual ~PRadHyCalCluster();
     virtual PRadHyCalCluster *Clone() const;
 
-    virtual void FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls) const;
+    virtual void FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls,
+                             ClusterContext &ctx) const;
+    // cluster the hits of n events, hs[i] of the event i are clustered to cls[i]
+    virtual void FormClusterBatch(std::vector<ModuleHit> *hs, std::vector<ModuleCluster> *cls,
+                                  size_t n, ClusterContext &ctx) const;
+    // prepare the tables that depend on the detector layout
+    virtual void UpdateLayout(const class PRadHyCalDetector *det);
+    // the reconstructor providing the settings, it is changed for the copies
+    virtual void SetReconstructor(class PRadHyCalReconstructor *) {}
 
 protected:
     PRadHyCalCluster();
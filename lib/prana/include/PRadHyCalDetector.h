@@ -5,17 +5,28 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cstdint>
 #include <unordered_map>
 #include "ConfigParser.h"
 #include "PRadException.h"
 #include "PRadHyCalModule.h"
 #include "PRadDetector.h"
 #include "PRadEventStruct.h"
+#include "PRadHyCalGeometry.h"
 
+// the quantized distances between modules in different sectors are cached
+// within this range (in module size), it covers the cluster profile range
+#define QDIST_CACHE_RANGE 5.0
 
+// resolutions are tabulated in fixed energy bins (MeV) and linearly
+// interpolated, the formula is used for the energies outside the table
+#define RES_TABLE_MIN 50.
+#define RES_TABLE_STEP 5.
+#define RES_TABLE_BINS 1000
 
 class PRadHyCalSystem;
 class PRadHyCalCluster;
+class PRadCalibCache;
 
 class PRadHyCalDetector : public PRadDetector
 {
@@ -90,6 +101,9 @@ public:
     {
         // each params set should have 3 parameters for resolution calculation
         double ene[Max_ResRegions][3], pos[Max_ResRegions][3];
+        // resolutions in MeV and mm at the energy bins
+        double ene_table[Max_ResRegions][RES_TABLE_BINS + 1];
+        double pos_table[Max_ResRegions][RES_TABLE_BINS + 1];
 
         // constructor, zero all elements
         ResParams()
@@ -102,7 +116,31 @@ public:
                     pos[i][j] = 0.;
                 }
             }
+            UpdateTables();
         }
+
+        // it should be called after the parameters changed
+        void UpdateTables();
+    };
+
+    // cached quantized distance between two modules
+    struct PairDist
+    {
+        uint32_t key;
+        double dx, dy, dist;
+    };
+
+    // uniform grid of the modules in a sector, the cells are of the module
+    // size, and each cell lists the modules overlapping it
+    struct SectorGrid
+    {
+        double xmin, ymin, cell_x, cell_y;
+        int nx, ny;
+        std::vector<uint32_t> start;
+        std::vector<PRadHyCalModule*> modules;
+
+        SectorGrid() : xmin(0.), ymin(0.), cell_x(1.), cell_y(1.), nx(0), ny(0) {}
+        PRadHyCalModule *Find(double x, double y) const;
     };
 
 public:
@@ -125,7 +163,9 @@ public:
     void UnsetSystem(bool force_unset = false);
     virtual bool ReadModuleList(const std::string &path);
     bool ReadVModuleList(const std::string &path);
-    bool ReadCalibrationFile(const std::string &path);
+    // the constants are also recorded in cache if it is given
+    bool ReadCalibrationFile(const std::string &path, PRadCalibCache *cache = nullptr);
+    void SetCalibration(const PRadCalibCache &cache);
     void InitLayout();
     void UpdateSectorInfo();
     void SaveModuleList(const std::string &path) const;
@@ -152,7 +192,10 @@ public:
     // get parameters
     PRadHyCalSystem *GetSystem() const {return system;}
     PRadHyCalModule *GetModule(int primex_id) const;
+    // the module is located by the sector and then the grid of the sector
     PRadHyCalModule *GetModule(double x, double y) const;
+    // batch lookup of n points, nullptr for the points outside of modules
+    void GetModules(const float *x, const float *y, size_t n, PRadHyCalModule **mods) const;
     PRadHyCalModule *GetModule(const std::string &module_name) const;
     double GetEnergy() const;
     int GetSectorID(double x, double y) const;
@@ -160,6 +203,8 @@ public:
     std::vector<HyCalHit> &GetHits() {return hycal_hits;}
     const std::vector<HyCalHit> &GetHits() const {return hycal_hits;}
     const std::vector<SectorInfo> &GetSectorInfo() const {return sector_info;}
+    // the modules match HyCalStdLayout, the compiled kernels are used
+    bool IsStdGeometry() const {return std_geo;}
 
     // resolution related
     // inpput energy should be MeV
@@ -170,6 +215,11 @@ public:
     double GetPosRes(ResRegion, double E) const;
     bool SetEneRes(ResRegion, double a, double b, double c);
     bool SetPosRes(ResRegion, double a, double b, double c);
+    // batch evaluation for the hits by their center modules
+    // fill sig_ene and sig_pos of the hits
+    void SetResolutions(HyCalHit *hits, size_t n) const;
+    // trigger efficiencies of the hits, it is 1 for the hits without module
+    void GetTriggerEfficiency(const HyCalHit *hits, size_t n, double *eff) const;
 
     // quantized distance between modules
     double QuantizedDist(const PRadHyCalModule *m1, const PRadHyCalModule *m2) const;
@@ -190,8 +240,28 @@ public:
         return sqrt(pars[0]*pars[0]/E + pars[1]*pars[1] + pars[2]*pars[2]/E/E);
     }
 
+    // linear interpolation in the resolution table, E is in MeV
+    // return false if E is out of the table range
+    static inline bool interpolate(const double *table, double E, double &val)
+    {
+        double x = (E - RES_TABLE_MIN)/RES_TABLE_STEP;
+        if(!(x >= 0. && x < RES_TABLE_BINS))
+            return false;
+        int i = static_cast<int>(x);
+        val = table[i] + (x - i)*(table[i + 1] - table[i]);
+        return true;
+    }
+
 protected:
     virtual void setLayout(PRadHyCalModule &module) const;
+    void indexModules();
+    void buildPairCache();
+    void buildModuleGrids();
+    const PairDist *findPair(const PRadHyCalModule *m1, const PRadHyCalModule *m2) const;
+    bool matchStdGeometry() const;
+    void quantizedDist(double x1, double y1, int s1, double x2, double y2, int s2,
+                       double &dx, double &dy) const;
+    void setCalibConst(const std::string &name, const PRadCalibConst &cal_const);
 
 protected:
     PRadHyCalSystem *system;
@@ -200,6 +270,10 @@ protected:
     std::unordered_map<std::string, PRadHyCalModule*> name_map;
     std::vector<HyCalHit> hycal_hits;
     std::vector<SectorInfo> sector_info;
+    std::vector<PairDist> pair_dists;
+    unsigned int pair_bits;
+    bool std_geo;
+    std::vector<SectorGrid> module_grids;
     ResParams res_pars;
 };
 
@@ -0,0 +1,89 @@
+#ifndef PRAD_HYCAL_GEOMETRY_H
+#define PRAD_HYCAL_GEOMETRY_H
+
+#include <cmath>
+
+// the quantized distance and sector logic for a fixed layout, the layout is a
+// rectangular crystal area in the center, surrounded by four lead glass sectors
+// with one module size, the constants are folded into the kernels at compile
+// time, and the kernels have no branch on the sectors
+// PRadHyCalDetector uses them if its modules match the layout, other layouts
+// go through the runtime sector information
+
+
+// the PRad HyCal, 34x34 PbWO4 modules and the PbGlass modules around (mm)
+struct HyCalStdLayout
+{
+    static constexpr double center_x1 = -353.09;
+    static constexpr double center_y1 = -352.75;
+    static constexpr double center_x2 = 353.09;
+    static constexpr double center_y2 = 352.75;
+    static constexpr double center_size_x = 20.77;
+    static constexpr double center_size_y = 20.75;
+    static constexpr double outer_size_x = 38.15;
+    static constexpr double outer_size_y = 38.15;
+};
+
+
+template<class Layout>
+struct HyCalGeometry
+{
+    // same ids as PRadHyCalDetector::SectorType
+    enum {Center = 0, Top, Right, Bottom, Left};
+
+    static constexpr double inv_center_x = 1./Layout::center_size_x;
+    static constexpr double inv_center_y = 1./Layout::center_size_y;
+    static constexpr double inv_outer_x = 1./Layout::outer_size_x;
+    static constexpr double inv_outer_y = 1./Layout::outer_size_y;
+
+    // the same division as PRadHyCalDetector::GetSectorID, the outer sectors
+    // are the strips turning around the center area
+    static inline int SectorID(double x, double y)
+    {
+        int r = x > Layout::center_x2, l = x < Layout::center_x1;
+        int t = y > Layout::center_y2, b = y < Layout::center_y1;
+        int m = 1 - r - l;
+
+        return r*(Right + b*(Bottom - Right)) + l*(Left + t*(Top - Left))
+               + m*(t*Top + b*Bottom);
+    }
+
+    // the outer sectors are convex and outside the center area, so the
+    // distance is the part of the segment inside the center area divided by
+    // the crystal size, and the rest divided by the lead glass size
+    // the part inside is from the slab intersection with the center area
+    static inline void QuantizedDist(double x1, double y1, double x2, double y2,
+                                     double &dx, double &dy)
+    {
+        double ddx = x2 - x1, ddy = y2 - y1;
+        double ix = 1./ddx, iy = 1./ddy;
+
+        double tx1 = (Layout::center_x1 - x1)*ix, tx2 = (Layout::center_x2 - x1)*ix;
+        double ty1 = (Layout::center_y1 - y1)*iy, ty2 = (Layout::center_y2 - y1)*iy;
+
+        // fmin and fmax drop the nan from a segment along the boundary
+        double t_in = std::fmax(std::fmin(tx1, tx2), std::fmin(ty1, ty2));
+        double t_out = std::fmin(std::fmax(tx1, tx2), std::fmax(ty1, ty2));
+        double f = std::fmin(t_out, 1.) - std::fmax(t_in, 0.);
+        f = std::fmin(std::fmax(f, 0.), 1.);
+
+        dx = ddx*(f*inv_center_x + (1. - f)*inv_outer_x);
+        dy = ddy*(f*inv_center_y + (1. - f)*inv_outer_y);
+    }
+
+    static inline double QuantizedDist(double x1, double y1, double x2, double y2)
+    {
+        double dx, dy;
+        QuantizedDist(x1, y1, x2, y2, dx, dy);
+        return std::sqrt(dx*dx + dy*dy);
+    }
+};
+
+template<class Layout> constexpr double HyCalGeometry<Layout>::inv_center_x;
+template<class Layout> constexpr double HyCalGeometry<Layout>::inv_center_y;
+template<class Layout> constexpr double HyCalGeometry<Layout>::inv_outer_x;
+template<class Layout> constexpr double HyCalGeometry<Layout>::inv_outer_y;
+
+typedef HyCalGeometry<HyCalStdLayout> HyCalStdGeometry;
+
+#endif // PRAD_HYCAL_GEOMETRY_H
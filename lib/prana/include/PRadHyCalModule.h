@@ -99,10 +99,13 @@ public:
     // get members
     PRadHyCalDetector *GetDetector() const {return detector;};
     unsigned short GetID() const {return id;}
+    // index in the module list of detector, -1 if it does not belong to one
+    int GetIndex() const {return index;}
     const std::string &GetName() const {return name;}
     const Geometry &GetGeometry() const {return geometry;}
     const Layout &GetLayout() const {return layout;}
     const PRadCalibConst &GetCalibConst() const {return cal_const;}
+    const PRadTriggerConst &GetTriggerConst() const {return trg_const;}
     PRadADCChannel *GetChannel() const {return daq_ch;}
     const std::vector<Neighbor> &GetNeighbors() const {return neighbors;}
     const std::vector<Neighbor> &GetVirtNeighbors() const {return vneighbors;}
@@ -149,7 +152,7 @@ protected:
     PRadHyCalDetector *detector;
     PRadADCChannel *daq_ch;
     std::string name;
-    int id;
+    int id, index;
     Geometry geometry;
     Layout layout;
     PRadCalibConst cal_const;
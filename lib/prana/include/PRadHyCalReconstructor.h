@@ -6,6 +6,9 @@
 #include "PRadEventStruct.h"
 #include "PRadClusterProfile.h"
 #include "PRadClusterDensity.h"
+#include "PRadHyCalCluster.h"
+#include "PRadCalibSnapshot.h"
+#include "PRadReconCache.h"
 #include "ConfigParser.h"
 #include "ConfigObject.h"
 
@@ -13,6 +16,10 @@
 // we use 3x3 adjacent hits to reconstruct position
 // here gives a larger volume to save the information
 #define POS_RECON_HITS 15
+// events taken by a thread at a time in the batch reconstruction
+#define RECON_BATCH_BLOCK 64
+// adc words converted to energies at a time when collecting the module hits
+#define COLLECT_HITS_BLOCK 256
 
 class PRadHyCalDetector;
 
@@ -49,18 +56,48 @@ public:
         // general
         bool depth_corr, leak_corr, linear_corr, den_corr, sene_corr;
         float log_weight_thres, min_cluster_energy, min_center_energy;
-        float least_leak, linear_corr_limit;
+        float least_leak, linear_corr_limit, leak_conv;
         unsigned int min_cluster_size, leak_iters;
         std::vector<float> min_module_energy;
 
         // for island
         bool corner_conn;
         unsigned int split_iter;
-        float least_split;
+        float least_split, split_conv;
+        // the events with at least intra_hits hits are clustered by sectors
+        // with intra_threads threads, 0 for all cores and 1 to disable it
+        unsigned int intra_hits, intra_threads;
         // for square
         unsigned int square_size;
     };
 
+    // buffers of reconstructing one event, the reconstruction with a context
+    // does not change the reconstructor, so several threads can reconstruct
+    // events at the same time with their own contexts
+    struct Context
+    {
+        std::vector<ModuleHit> module_hits;
+        std::vector<ModuleCluster> module_clusters;
+        ClusterContext cluster;
+        // calibration of the events, the constants in the detector and its
+        // DAQ system are used if it is not set
+        PRadCalibSnapshot::Ptr calib;
+        // flat channel constants of the detector for collecting the module
+        // hits if calib is not set, they are rebuilt after ClearCache
+        PRadCalibSnapshot::Ptr channels;
+        // hits and clusters of the events in a batch
+        std::vector<std::vector<ModuleHit>> batch_hits;
+        std::vector<std::vector<ModuleCluster>> batch_clusters;
+    };
+
+    // cached result of an event
+    struct CachedEvent
+    {
+        std::vector<ModuleHit> module_hits;
+        std::vector<ModuleCluster> module_clusters;
+        std::vector<HyCalHit> hits;
+    };
+
 public:
     PRadHyCalReconstructor(const std::string &conf_path = "");
 
@@ -77,9 +114,11 @@ public:
 
     // configuration
     void Configure(const std::string &path);
+    void UpdateLayout(const PRadHyCalDetector *det);
 
     // core functions
     void Reconstruct(PRadHyCalDetector *det);
+    // the results are cached by the event if the cache is enabled
     void Reconstruct(PRadHyCalDetector *det, const EventData &event);
     void CollectHits(PRadHyCalDetector *det);
     void CollectHits(PRadHyCalDetector *det, const EventData &event);
@@ -87,9 +126,30 @@ public:
     void AddTiming(PRadHyCalDetector *det);
     void AddTiming(PRadHyCalDetector *det, const EventData &event);
 
+    // reentrant reconstruction, the hits are saved to the given container
+    // instead of the detector, the detector and its DAQ system are only read
+    void Reconstruct(const PRadHyCalDetector *det, const EventData &event,
+                     Context &ctx, std::vector<HyCalHit> &hits) const;
+    void CollectHits(const PRadHyCalDetector *det, const EventData &event,
+                     std::vector<ModuleHit> &mhits) const;
+    void CollectHits(const PRadCalibSnapshot &calib, const EventData &event,
+                     std::vector<ModuleHit> &mhits) const;
+    void ReconstructHits(Context &ctx, std::vector<HyCalHit> &hits) const;
+    void AddTiming(const PRadHyCalDetector *det, const EventData &event,
+                   std::vector<HyCalHit> &hits) const;
+    // reconstruct n events by several threads, out should have n containers
+    // the iteration counts of the threads are added to stats if it is given
+    // the events are calibrated by calib if it is given
+    void ReconstructBatch(const PRadHyCalDetector *det, const EventData *events, size_t n,
+                          std::vector<HyCalHit> *out, unsigned int nthreads = 0,
+                          ReconStats *stats = nullptr,
+                          const PRadCalibSnapshot::Ptr &calib = nullptr) const;
+
     // help functions
-    HyCalHit Cluster2Hit(const ModuleCluster &cl) const;
-    void LeakCorr(ModuleCluster &cluster) const;
+    HyCalHit Cluster2Hit(const ModuleCluster &cl, const PRadCalibSnapshot *calib = nullptr) const;
+    unsigned int LeakCorr(ModuleCluster &cluster) const;
+    // the virtual hits are in the buffers of ctx
+    unsigned int LeakCorr(ModuleCluster &cluster, ClusterContext &ctx) const;
     void CorrectVirtHits(BaseHit &hit, std::vector<ModuleHit> &vhits,
                          const ModuleCluster &cluster) const;
     bool CheckCluster(const ModuleCluster &cluster) const;
@@ -97,11 +157,12 @@ public:
 
     // profile related
     PRadClusterProfile *GetProfile() {return &profile;}
-    void LoadProfile(int t, const std::string &path) {profile.Load(t, path);}
+    void LoadProfile(int t, const std::string &path) {profile.Load(t, path); ClearCache();}
     PRadClusterDensity *GetDensityParams() {return &density;}
     void LoadDensityParams(int t, const std::string &p_path, const std::string &e_path)
-    {density.Load(t, p_path, e_path);}
-    void ChooseDensitySet(PRadClusterDensity::SetEnum i) {density.ChooseSet(i);}
+    {density.Load(t, p_path, e_path); ClearCache();}
+    void ChooseDensitySet(PRadClusterDensity::SetEnum i) {density.ChooseSet(i); updateSetting();}
+    PRadClusterDensity::SetEnum GetDensitySet() const {return density.GetSet();}
 
     // methods information
     bool SetClusterMethod(const std::string &name);
@@ -119,20 +180,46 @@ public:
 
 
     // containers
-    const std::vector<ModuleHit> &GetHits() const {return module_hits;}
-    const std::vector<ModuleCluster> &GetClusters() const {return module_clusters;}
+    const std::vector<ModuleHit> &GetHits() const {return context.module_hits;}
+    const std::vector<ModuleCluster> &GetClusters() const {return context.module_clusters;}
+    const ReconStats &GetStats() const {return context.cluster.stats;}
+    void ClearStats() {context.cluster.stats.Clear();}
+    // record the groups, maxima and shapes of the events for the analysis
+    // (such as the cosmic rejection), it is only supported by island
+    void SetKeepGroups(bool k) {context.cluster.keep_groups = k;}
+    bool IsKeepGroups() const {return context.cluster.keep_groups;}
+    const ClusterContext &GetClusterContext() const {return context.cluster;}
+
+    // results cache, the events found in the cache are not counted in stats
+    // it is cleared when the settings are changed, the calibration changes
+    // should be notified by ClearCache, which also drops the channel constants
+    void SetCacheSize(size_t size) {recon_cache.SetCapacity(size);}
+    size_t GetCacheSize() const {return recon_cache.GetCapacity();}
+    void ClearCache() {recon_cache.Clear(); context.channels.reset();}
 
 protected:
+    void updateSetting();
     float getWeight(const float &E, const float &E0) const;
     float getPosBias(const std::vector<float> &pars, const float &dx) const;
     float getShowerDepth(int module_type, const float &E) const;
-    int reconstructPos(const ModuleHit &center, BaseHit *temp, int count, BaseHit *hit) const;
+    int reconstructPos(const ModuleHit &center, BaseHit *temp, int count, BaseHit *hit) const
+    {return (this->*pos_kernel)(center, temp, count, hit);}
     int reconstructPos(const ModuleCluster &cl, BaseHit *hit) const;
+    template<PosMethod M>
+    int posKernel(const ModuleHit &center, BaseHit *temp, int count, BaseHit *hit) const;
     int fillHits(BaseHit *temp, int max_hits, const ModuleHit &center,
                  const std::vector<ModuleHit> &hits) const;
+    void clustersToHits(std::vector<ModuleCluster> &clusters, ClusterContext &ctx,
+                        const PRadCalibSnapshot *calib, std::vector<HyCalHit> &hits) const;
+    void reconstructBlock(const PRadHyCalDetector *det, const EventData *events, size_t n,
+                          Context &ctx, std::vector<HyCalHit> *out) const;
     PRadClusterProfile::Value getProf(const ModuleHit &c, const ModuleHit &hit) const;
     PRadClusterProfile::Value getProf(double cx, double cy, double cE, const ModuleHit &hit) const;
     PRadClusterProfile::Value getProf(const BaseHit &c, const ModuleHit &hit) const;
+    void getProfBatch(const ModuleHit &c, const std::vector<ModuleHit*> &hits,
+                      float *dist, float *frac) const;
+    void getProfBatch(const BaseHit &c, const std::vector<ModuleHit*> &hits,
+                      float *dist, float *frac, PRadClusterProfile::Row &row) const;
 
 
 private:
@@ -141,10 +228,16 @@ private:
     ClMethod cltype;
     class PRadHyCalCluster *cluster;
     PosMethod postype;
+    // position reconstruction kernel for postype
+    int (PRadHyCalReconstructor::*pos_kernel)(const ModuleHit&, BaseHit*, int, BaseHit*) const;
     Config config;
 
-    std::vector<ModuleHit> module_hits;
-    std::vector<ModuleCluster> module_clusters;
+    // context of the reconstruction through the detector
+    Context context;
+
+    // hash of the configuration and methods, and the cached results
+    uint64_t setting;
+    PRadReconCache<CachedEvent> recon_cache;
 };
 
 #endif // PRAD_HYCAL_RECONSTRUCTOR
@@ -3,13 +3,23 @@
 
 #include <string>
 #include <ostream>
+#include <vector>
+#include <algorithm>
 #include <unordered_map>
 #include "PRadEventStruct.h"
+#include "PRadEventStore.h"
 #include "PRadHyCalDetector.h"
 #include "PRadHyCalReconstructor.h"
 #include "PRadTDCChannel.h"
 #include "PRadADCChannel.h"
+#include "PRadSparsifier.h"
+#include "PRadHistBuffer.h"
+#include "PRadHistSnapshot.h"
 #include "PRadCalibConst.h"
+#include "PRadDBManager.h"
+#include "PRadGainMonitor.h"
+#include "PRadGausEstimator.h"
+#include "PRadMemoryTracker.h"
 #include "ConfigObject.h"
 
 
@@ -17,7 +27,64 @@
 // better formed
 #define ADC_BUCKETS 2000
 
-class TH1D;
+class TH1;
+class PRadInfoCenter;
+class PRadCalibCache;
+
+// dense look-up table from daq address to channel, the address is small and
+// bounded, thus a flat array is much faster than the hash map on decoding
+template<class T>
+struct ChannelTable
+{
+    std::vector<T*> table;
+    unsigned int n_crate, n_slot, n_channel;
+
+    ChannelTable() : n_crate(0), n_slot(0), n_channel(0) {}
+
+    bool inside(const ChannelAddress &addr) const
+    {
+        return (addr.crate < n_crate) && (addr.slot < n_slot) && (addr.channel < n_channel);
+    }
+
+    size_t index(const ChannelAddress &addr) const
+    {
+        return (addr.crate*n_slot + addr.slot)*n_channel + addr.channel;
+    }
+
+    T *get(const ChannelAddress &addr) const
+    {
+        return table[index(addr)];
+    }
+
+    void set(const ChannelAddress &addr, T *ch)
+    {
+        if(inside(addr))
+            table[index(addr)] = ch;
+    }
+
+    // size the table by the largest address in the list
+    void build(const std::vector<T*> &list)
+    {
+        clear();
+        for(auto &ch : list)
+        {
+            const ChannelAddress &addr = ch->GetAddress();
+            n_crate = std::max(n_crate, addr.crate + 1);
+            n_slot = std::max(n_slot, addr.slot + 1);
+            n_channel = std::max(n_channel, addr.channel + 1);
+        }
+
+        table.assign(n_crate*n_slot*n_channel, nullptr);
+        for(auto &ch : list)
+            table[index(ch->GetAddress())] = ch;
+    }
+
+    void clear()
+    {
+        table.clear();
+        n_crate = n_slot = n_channel = 0;
+    }
+};
 
 class PRadHyCalSystem : public ConfigObject
 {
@@ -37,6 +104,24 @@ public:
         bool operator >(int run) const {return begin > run;}
     };
 
+    // peaks of the channel histograms in a run, the pedestal of a reference PMT
+    // is from its physics histogram together with the alpha source peak
+    struct GainEntry
+    {
+        std::string name;
+        PRadGausEstimator::Result ped, lms, alpha;
+    };
+
+    struct GainTable
+    {
+        int run;
+        std::vector<GainEntry> channels;
+        // (led - ped)/(alpha - ped) of the reference PMTs, 0 for a bad one
+        std::vector<double> ref_gains;
+
+        GainTable() : run(0) {}
+    };
+
 public:
     // constructor
     PRadHyCalSystem(const std::string &path = "");
@@ -55,28 +140,50 @@ public:
     // configuration
     void Configure(const std::string &path);
     bool ReadChannelList(const std::string &path);
-    bool ReadRunInfoFile(const std::string &path);
+    bool ReadRunInfoFile(const std::string &path, PRadCalibCache *cache = nullptr);
+    void SetRunInfo(const PRadCalibCache &cache);
     bool ReadTriggerEffFile(const std::string &path);
     bool ReadCalPeriodFile(const std::string &path);
     void ChooseRun(const std::string &path, bool verbose = true);
     void ChooseRun(int run, bool verbose = true);
     void UpdateRunFiles(bool verbose = true);
+    // read the run files of the next runs ahead, for the jobs over many runs
+    void PrefetchRuns(const std::vector<int> &runs);
+    void SetInfoCenter(PRadInfoCenter *info);
+    PRadInfoCenter *GetInfoCenter() const {return info_center;}
 
     // connections
     void BuildConnections();
 
     // events related
+    // only the channels set by the last chosen event are cleared
     void ChooseEvent(const EventData &data);
+    const std::vector<unsigned short> &GetADCValues() const {return adc_values;}
+    // time measures of a tdc channel from the chosen event
+    DataRange<unsigned short> GetTimeMeasure(int tdc_id) const {return tdc_table.Get(tdc_id);}
+    const TDCTable &GetTDCTable() const {return tdc_table;}
     void Reset();
     inline void Reconstruct() {return recon.Reconstruct(hycal);}
     inline void Reconstruct(const EventData &data) {return recon.Reconstruct(hycal, data);}
+    inline void ReconstructBatch(const EventData *events, size_t n, std::vector<HyCalHit> *out,
+                                 unsigned int nthreads = 0, ReconStats *stats = nullptr,
+                                 const PRadCalibSnapshot::Ptr &calib = nullptr) const
+    {recon.ReconstructBatch(hycal, events, n, out, nthreads, stats, calib);}
+    // the hits of all the events are put in columns, tagged by the event index
+    void ReconstructBatch(const EventData *events, size_t n, HyCalHitSoA &out,
+                          unsigned int nthreads = 0, ReconStats *stats = nullptr,
+                          const PRadCalibSnapshot::Ptr &calib = nullptr) const;
     PRadHyCalReconstructor *GetReconstructor() {return &recon;}
+    const PRadHyCalReconstructor *GetReconstructor() const {return &recon;}
+    // immutable copy of the calibration of the current run
+    PRadCalibSnapshot::Ptr TakeCalibSnapshot() const {return PRadCalibSnapshot::Take(*this);}
 
     // detector related
     void SetDetector(PRadHyCalDetector *h);
     void RemoveDetector();
     void DisconnectDetector(bool force_disconn = false);
     double GetEnergy(const EventData &event) const;
+    double GetEnergy(const DataRange<ADC_Data> &adcs) const;
     PRadHyCalModule *GetModule(const int &id) const;
     PRadHyCalModule *GetModule(const std::string &name) const;
     std::vector<PRadHyCalModule*> GetModuleList() const;
@@ -89,35 +196,87 @@ public:
     void ClearTDCChannel();
     PRadADCChannel *GetADCChannel(const int &id) const;
     PRadADCChannel *GetADCChannel(const std::string &name) const;
-    PRadADCChannel *GetADCChannel(const ChannelAddress &addr) const;
+    inline PRadADCChannel *GetADCChannel(const ChannelAddress &addr) const;
     PRadTDCChannel *GetTDCChannel(const int &id) const;
     PRadTDCChannel *GetTDCChannel(const std::string &name) const;
-    PRadTDCChannel *GetTDCChannel(const ChannelAddress &addr) const;
+    inline PRadTDCChannel *GetTDCChannel(const ChannelAddress &addr) const;
     const std::vector<PRadADCChannel*> &GetADCList() const {return adc_list;}
+    MemoryUsage GetMemoryUsage() const;
     const std::vector<PRadTDCChannel*> &GetTDCList() const {return tdc_list;}
     void Sparsify(const EventData &event);
+    size_t Sparsify(ADC_Data *data, size_t n);
+    // occupancy in flat counters by the adc channel id, so a thread counts
+    // many events without touching the channels, the counters are added to
+    // the channels by AddOccupancy
+    void CountOccupancy(const EventData &event, std::vector<uint32_t> &counts) const;
+    static void CountOccupancy(const ADC_Data *data, size_t n, uint32_t *counts, size_t nch);
+    void AddOccupancy(const std::vector<uint32_t> &counts);
+    void UpdateSparsifier() {sparsifier.Build(adc_list);}
+    PRadSparsifier &GetSparsifier() {return sparsifier;}
 
     // histogram related
-    void FillHists(const EventData &event);
+    // the histograms are filled through the buffer, SyncHists adds the buffered
+    // counts to the ROOT histograms, it is called by the functions using them
+    void FillHists(const EventData &event)
+    {
+        hist_buffer.Fill(event);
+        if(gain_monitor.IsEnabled() && event.is_monitor_event())
+            gain_monitor.Fill(event);
+    }
     void FillEnergyHist();
     void FillEnergyHist(const double &e);
     void FillEnergyHist(const EventData &event);
+    void FillEnergyHist(const EventView &event);
     void ResetEnergyHist();
-    TH1 *GetEnergyHist() const {return energy_hist;}
+    void MergeHists(const PRadHyCalSystem &that);
+    void MergeHists(const PRadHistBuffer &buffer) {hist_buffer.Merge(buffer);}
+    // a buffer for another thread, it is merged back by MergeHists
+    PRadHistBuffer CreateHistBuffer() const {return PRadHistBuffer(hist_buffer.GetLayout());}
+    void SyncHists() const {hist_buffer.Flush();}
+    void UpdateHistLayout();
+    TH1 *GetEnergyHist() const {SyncHists(); return energy_hist;}
     void SaveHists(const std::string &path) const;
+    // a copy of the histograms, in the directories of SaveHists, without the
+    // fitted functions
+    PRadHistSnapshot SnapshotHists() const;
+    bool SaveHistSnapshot(const std::string &path) const;
+    // SaveHists from a snapshot on a background thread, keep the future until
+    // the file is needed
+    std::future<bool> SaveHistsAsync(const std::string &path) const;
     std::vector<double> FitHist(const std::string &channel,
                                 const std::string &hist_name,
                                 const std::string &fit_function,
                                 const double &range_min,
                                 const double &range_max,
                                 const bool &verbose) const throw(PRadException);
-    void FitPedestal();
-    void CorrectGainFactor(int ref);
+    // the peaks are estimated by PRadGausEstimator for the channels in parallel
+    // root_fit uses the ROOT gaussian fits one by one instead, nthreads = 0
+    // means using all the hardware threads
+    void FitPedestal(bool root_fit = false, unsigned int nthreads = 0);
+    void CorrectGainFactor(int ref, bool root_fit = false, unsigned int nthreads = 0);
+    // the peaks of all channels and the reference gains from the histograms,
+    // they are estimated in parallel without changing the system
+    GainTable ExtractGains(unsigned int nthreads = 0) const;
+    // gain drifts from the monitor events filled by FillHists, window 0
+    // disables it, ref starts from 1 as in CorrectGainFactor
+    void SetGainMonitor(unsigned int window, int ref = 2);
+    PRadGainMonitor &GetGainMonitor() {return gain_monitor;}
+    const PRadGainMonitor &GetGainMonitor() const {return gain_monitor;}
+
+private:
+    void buildChannelTables();
+    void buildHistLayout();
+    void setChannelStatus(const std::string &name, double ped_mean, double ped_sig,
+                          double lms_mean, double ref_gain, int ref, unsigned int status);
+    void runInfoUpdated();
+    PRadDBManager::RunFiles runFiles(int run, bool verbose);
+    void updateGainMonitor();
 
 private:
     PRadHyCalDetector *hycal;
+    PRadInfoCenter *info_center;
     PRadHyCalReconstructor recon;
-    TH1D *energy_hist;
+    TH1 *energy_hist;
 
     std::vector<CalPeriod> cal_period;
 
@@ -125,11 +284,74 @@ private:
     std::vector<PRadADCChannel*> adc_list;
     std::vector<PRadTDCChannel*> tdc_list;
 
+    // adc values of the chosen event by channel id, and the channels set by it
+    // all the channels are cleared if reset_all is true
+    std::vector<unsigned short> adc_values;
+    std::vector<unsigned short> adc_touched;
+    // tdc values of the chosen event sorted by the channels
+    TDCTable tdc_table;
+    bool reset_all;
+
     // channel maps
     std::unordered_map<ChannelAddress, PRadADCChannel*> adc_addr_map;
     std::unordered_map<std::string, PRadADCChannel*> adc_name_map;
     std::unordered_map<ChannelAddress, PRadTDCChannel*> tdc_addr_map;
     std::unordered_map<std::string, PRadTDCChannel*> tdc_name_map;
+
+    // address look-up tables for decoding, built in BuildConnections
+    // the hash maps are used for the addresses outside the tables
+    ChannelTable<PRadADCChannel> adc_addr_table;
+    ChannelTable<PRadTDCChannel> tdc_addr_table;
+
+    // pedestal arrays for bank zero suppression, it needs to be updated by
+    // UpdateSparsifier if the pedestals are changed through the channels
+    PRadSparsifier sparsifier;
+
+    // gain drifts from the monitor events, the copies of the system do not
+    // monitor until it is set for them
+    PRadGainMonitor gain_monitor;
+
+    // integer buffer of the channel and energy histograms, it is flushed to
+    // the ROOT histograms when they are accessed
+    mutable PRadHistBuffer hist_buffer;
+
+    // configuration values used in every run switch, resolved once
+    struct RunConfig
+    {
+        ConfigHandle<int> run{"Run Number"};
+        ConfigHandle<int> period{"Period"};
+        ConfigHandle<int> sub_period{"Sub-period"};
+        ConfigHandle<std::string> calib_dir{"Calibration Folder"};
+        ConfigHandle<std::string> calib_file{"Calibration File"};
+        ConfigHandle<std::string> info_dir{"Run Info Folder"};
+        ConfigHandle<std::string> info_file{"Run Info File"};
+        ConfigHandle<std::string> cache_dir{"Calibration Cache Folder"};
+    } run_conf;
 };
 
+// address look-up on the decoding path, inlined
+PRadADCChannel *PRadHyCalSystem::GetADCChannel(const ChannelAddress &addr)
+const
+{
+    if(adc_addr_table.inside(addr))
+        return adc_addr_table.get(addr);
+
+    auto it = adc_addr_map.find(addr);
+    if(it != adc_addr_map.end())
+        return it->second;
+    return nullptr;
+}
+
+PRadTDCChannel *PRadHyCalSystem::GetTDCChannel(const ChannelAddress &addr)
+const
+{
+    if(tdc_addr_table.inside(addr))
+        return tdc_addr_table.get(addr);
+
+    auto it = tdc_addr_map.find(addr);
+    if(it != tdc_addr_map.end())
+        return it->second;
+    return nullptr;
+}
+
 #endif
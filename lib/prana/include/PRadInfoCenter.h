@@ -2,11 +2,53 @@
 #define PRAD_INFO_CENTER_H
 
 #include <string>
+#include <mutex>
+#include <atomic>
 #include "datastruct.h"
 #include "PRadEventStruct.h"
 
+// run information context, the data handler and systems hold it by pointer
+// the global instance is the default context, independent contexts can be
+// created for the pipelines running in parallel
 class PRadInfoCenter
 {
+public:
+    // run counters from the synchronization events, a thread can accumulate
+    // its own counter without any locks and merge it to the context later
+    struct RunCounter
+    {
+        double beam_charge;
+        double live_charge;
+        uint64_t dead_count;
+        uint64_t ungated_count;
+
+        RunCounter()
+        : beam_charge(0.), live_charge(0.), dead_count(0), ungated_count(0)
+        {}
+
+        void reset()
+        {
+            beam_charge = 0.;
+            live_charge = 0.;
+            dead_count = 0;
+            ungated_count = 0;
+        }
+
+        bool empty() const {return ungated_count == 0 && beam_charge == 0.;}
+        void Add(const EventData &event);
+        void Merge(const RunCounter &that)
+        {
+            beam_charge += that.beam_charge;
+            live_charge += that.live_charge;
+            dead_count += that.dead_count;
+            ungated_count += that.ungated_count;
+        }
+        double live_time() const
+        {
+            return ungated_count ? 1. - (double)dead_count/(double)ungated_count : 0.;
+        }
+    };
+
 public:
     static PRadInfoCenter &Instance()
     {
@@ -15,9 +57,12 @@ public:
         return instance;
     }
 
+    PRadInfoCenter();
+
     PRadInfoCenter(const PRadInfoCenter &)  = delete;
     void operator=(const PRadInfoCenter &)  = delete;
 
+    // static functions work on the global instance
     static bool SetRunNumber(int run);
     static bool SetRunNumber(const std::string &path);
     static int GetRunNumber();
@@ -25,20 +70,46 @@ public:
     static double GetLiveBeamCharge();
     static double GetLiveTime();
 
+    // member functions work on this context, they can be called from
+    // different threads
     void Reset();
     void UpdateInfo(const EventData &event);
-    void SetRunInfo(const RunInfo &info) {run_info = info;}
-    void SetOnlineInfo(const OnlineInfo &info) {online_info = info;}
+    void UpdateOnlineInfo(const EventData &event);
+    void Merge(const RunCounter &counter);
+    void Merge(const PRadInfoCenter &that);
+    void SetRunInfo(const RunInfo &info);
+    void SetOnlineInfo(const OnlineInfo &info);
+
+    bool ChangeRunNumber(int run);
+    bool ChangeRunNumber(const std::string &path);
+    int RunNumber() const {return run_number.load();}
+    double BeamCharge() const {return beam_charge.load();}
+    double LiveBeamCharge() const {return live_charge.load();}
+    double LiveTime() const;
 
-    const RunInfo &GetRunInfo() const {return run_info;}
-    const OnlineInfo &GetOnlineInfo() const {return online_info;}
+    // snapshots of the information, the run counters are read consistently
+    // without blocking the threads that merge counters
+    RunCounter GetRunCounter() const;
+    RunInfo GetRunInfo() const;
+    OnlineInfo GetOnlineInfo() const;
 
 private:
-    RunInfo run_info;
-    OnlineInfo online_info;
-    double live_scaled_charge;
+    void setCounter(const RunCounter &counter, bool add);
 
-    PRadInfoCenter();
+private:
+    std::atomic<int> run_number;
+    std::atomic<double> beam_charge;
+    std::atomic<double> live_charge;
+    std::atomic<uint64_t> dead_count;
+    std::atomic<uint64_t> ungated_count;
+    // sequence of the counter updates, it is odd during an update, readers
+    // retry if it is changed while reading, writers are serialized by the lock
+    std::atomic<uint64_t> counter_seq;
+    std::mutex counter_locker;
+
+    // online information is only updated by the latest values
+    OnlineInfo online_info;
+    mutable std::mutex online_locker;
 };
 
 #endif
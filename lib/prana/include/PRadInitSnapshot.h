@@ -0,0 +1,96 @@
+#ifndef PRAD_INIT_SNAPSHOT_H
+#define PRAD_INIT_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "PRadCalibCache.h"
+#include "PRadGEMAPV.h"
+
+// version of the snapshot format, the snapshots of other versions are ignored
+#define INIT_SNAPSHOT_VERSION 1
+// bytes at the beginning of the data file for its checksum
+#define INIT_SNAPSHOT_CHECK 1048576
+
+class PRadHyCalSystem;
+class PRadGEMSystem;
+
+// binary snapshot of the system state from the initialization by data, it
+// contains the fitted adc pedestals, the gain factors corrected from LMS and
+// the fitted APV pedestals
+// it is keyed by the run number, the reference PMT and the checksum of the
+// data file, so it is only used for the same input
+class PRadInitSnapshot
+{
+public:
+    struct ADCEntry
+    {
+        char name[CALIB_CACHE_NAME];
+        double ped_mean, ped_sigma;
+    };
+
+    // the corrected factor is only restored for the same base factor
+    struct ModuleEntry
+    {
+        char name[CALIB_CACHE_NAME];
+        double base_factor, factor;
+    };
+
+    struct APVEntry
+    {
+        int32_t fec, adc;
+        PRadGEMAPV::Pedestal pedestal[APV_CHANNEL_SIZE];
+    };
+
+    // identification of the data file
+    struct Source
+    {
+        int32_t run, ref;
+        int64_t size;
+        uint32_t checksum;
+
+        Source() : run(0), ref(0), size(-1), checksum(0) {}
+        bool operator ==(const Source &rhs) const
+        {
+            return run == rhs.run && ref == rhs.ref && size == rhs.size
+                   && checksum == rhs.checksum;
+        }
+        bool operator !=(const Source &rhs) const {return !(*this == rhs);}
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        Source src;
+        uint32_t nadc, nmodules, napvs;
+    };
+
+public:
+    PRadInitSnapshot();
+    virtual ~PRadInitSnapshot();
+
+    void Clear();
+    // take the state of the systems, any of them can be nullptr
+    void Take(const Source &src, const PRadHyCalSystem *hycal, const PRadGEMSystem *gem);
+    void Apply(PRadHyCalSystem *hycal, PRadGEMSystem *gem) const;
+    bool Save(const std::string &path) const;
+    // false if the file does not exist or it is from another source
+    bool Load(const std::string &path, const Source &src);
+
+    const Source &GetSource() const {return source;}
+    const std::vector<ADCEntry> &GetADCEntries() const {return adc_entries;}
+    const std::vector<ModuleEntry> &GetModuleEntries() const {return module_entries;}
+    const std::vector<APVEntry> &GetAPVEntries() const {return apv_entries;}
+
+public:
+    static Source file_source(const std::string &path, int run, int ref);
+
+private:
+    Source source;
+    std::vector<ADCEntry> adc_entries;
+    std::vector<ModuleEntry> module_entries;
+    std::vector<APVEntry> apv_entries;
+};
+
+#endif // PRAD_INIT_SNAPSHOT_H
@@ -2,38 +2,13 @@
 #define PRAD_ISLAND_CLUSTER_H
 
 #include <vector>
+#include <memory>
 #include "PRadHyCalCluster.h"
 
 
 
 // reserve some space for grouping hits
 #define ISLAND_GROUP_RESERVE 50
-// do not split the group if the number of hits in it exceed this number
-#define SPLIT_MAX_HITS 100
-// do not split the group if the number of maxima in it exceed this number
-#define SPLIT_MAX_MAXIMA 10
-
-struct SplitContainer
-{
-    float frac[SPLIT_MAX_HITS][SPLIT_MAX_MAXIMA], total[SPLIT_MAX_HITS];
-
-    // a helper function to sum 2d array
-    void sum_frac(size_t hits, size_t maximums)
-    {
-        for(size_t i = 0; i < hits; ++i)
-        {
-            total[i] = 0;
-            for(size_t j = 0; j < maximums; ++j)
-                total[i] += frac[i][j];
-        }
-    }
-
-    // get the normalized fraction
-    inline float norm_frac(size_t i, size_t j)
-    {
-        return frac[j][i]/total[j];
-    }
-};
 
 class PRadIslandCluster : public PRadHyCalCluster
 {
@@ -41,25 +16,46 @@ public:
     PRadIslandCluster(class PRadHyCalReconstructor *r);
     virtual ~PRadIslandCluster();
     PRadHyCalCluster *Clone() const;
+    void SetReconstructor(class PRadHyCalReconstructor *r) {rec = r;}
 
-    void FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls) const;
+    void FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls,
+                     ClusterContext &ctx) const;
+    // the sectors of the detector and the threads for the large events
+    void UpdateLayout(const class PRadHyCalDetector *det);
+    unsigned int GetIntraEventThreads() const;
 
 protected:
-    void groupHits(std::vector<ModuleHit> &hits,
-                   std::vector<std::vector<ModuleHit*>> &groups) const;
+    void groupHits(std::vector<ModuleHit> &hits, ClusterContext &ctx) const;
+    void fillHitSlots(std::vector<ModuleHit> &hits, ClusterContext &ctx) const;
+    void resetHitSlots(std::vector<ModuleHit> &hits, ClusterContext &ctx) const;
+    void traverseGroup(std::vector<ModuleHit> &hits, ClusterContext &ctx, int seed,
+                       std::vector<ModuleHit*> &group) const;
+    bool useIntraEvent(const std::vector<ModuleHit> &hits, const ClusterContext &ctx) const;
+    bool formClusterIntra(std::vector<ModuleHit> &hits, std::vector<ModuleCluster> &cls,
+                          ClusterContext &ctx) const;
+    void groupSector(std::vector<ModuleHit> &hits, ClusterContext &ctx, int sector) const;
+    void stitchSectors(std::vector<ModuleHit> &hits, ClusterContext &ctx) const;
     bool fillClusters(ModuleHit &hit, std::vector<std::vector<ModuleHit*>> &groups) const;
     bool checkAdjacent(const std::vector<ModuleHit*> &g1, const std::vector<ModuleHit*> &g2) const;
-    void splitCluster(const std::vector<ModuleHit*> &grp, std::vector<ModuleCluster> &c) const;
+    void splitCluster(const std::vector<ModuleHit*> &grp, const std::vector<ModuleHit*> &maxima,
+                      std::vector<ModuleCluster> &c, ClusterContext &ctx) const;
     std::vector<ModuleHit*> findMaximums(const std::vector<ModuleHit*> &g) const;
+    void findMaximums(const std::vector<ModuleHit*> &g, std::vector<ModuleHit*> &maxima) const;
     void splitHits(const std::vector<ModuleHit*> &maximums,
                    const std::vector<ModuleHit*> &hits,
-                   std::vector<ModuleCluster> &clusters) const;
-    void evalFraction(const std::vector<ModuleHit*> &maximums,
-                      const std::vector<ModuleHit*> &hits,
-                      SplitContainer &split) const;
+                   std::vector<ModuleCluster> &clusters,
+                   ClusterContext &ctx) const;
+    unsigned int evalFraction(const std::vector<ModuleHit*> &maximums,
+                              const std::vector<ModuleHit*> &hits,
+                              SplitContainer &split) const;
 
 protected:
     class PRadHyCalReconstructor *rec;
+
+    // the pool is shared by the copies, the events clustered at the same time
+    // share its threads
+    int nsectors;
+    std::shared_ptr<class PRadTaskPool> intra_pool;
 };
 
 #endif
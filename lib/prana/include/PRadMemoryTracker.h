@@ -0,0 +1,95 @@
+#ifndef PRAD_MEMORY_TRACKER_H
+#define PRAD_MEMORY_TRACKER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <functional>
+#include <cstddef>
+
+class TH1;
+struct EventData;
+
+// memory held by a subsystem, the bytes are taken from the capacity of the
+// containers, and blocks is the number of heap allocations behind them
+struct MemoryUsage
+{
+    size_t bytes, blocks;
+
+    MemoryUsage(size_t b = 0, size_t n = 0) : bytes(b), blocks(n) {}
+
+    MemoryUsage &operator +=(const MemoryUsage &rhs)
+    {
+        bytes += rhs.bytes;
+        blocks += rhs.blocks;
+        return *this;
+    }
+
+    template<typename T>
+    void Add(const std::vector<T> &v)
+    {
+        if(v.capacity()) {
+            bytes += v.capacity()*sizeof(T);
+            blocks++;
+        }
+    }
+
+    template<typename T>
+    void Add(const std::deque<T> &d)
+    {
+        bytes += d.size()*sizeof(T);
+        blocks += (d.size()*sizeof(T) + 511)/512 + 1;
+    }
+
+    void Add(const void *, size_t size)
+    {
+        if(size) {
+            bytes += size;
+            blocks++;
+        }
+    }
+
+    void Add(const TH1 *hist);
+    void Add(const EventData &event);
+};
+
+// opt-in memory accounting
+// the subsystems are registered with a function that reports their usage,
+// the usage is only computed on request, so there is no cost in the loops
+class PRadMemoryTracker
+{
+public:
+    typedef std::function<MemoryUsage()> Accountant;
+
+    struct Entry
+    {
+        std::string name;
+        MemoryUsage usage;
+    };
+
+public:
+    static PRadMemoryTracker &Instance();
+
+    void Register(const std::string &name, Accountant acc);
+    void Unregister(const std::string &name);
+    void SetEventCounter(std::function<size_t()> counter);
+    bool IsEmpty() const;
+
+    std::vector<Entry> GetUsage() const;
+    size_t GetEventCount() const;
+    void PrintSummary(std::ostream &os) const;
+
+private:
+    PRadMemoryTracker() {}
+    PRadMemoryTracker(const PRadMemoryTracker &) = delete;
+    PRadMemoryTracker &operator =(const PRadMemoryTracker &) = delete;
+
+private:
+    mutable std::mutex locker;
+    std::vector<std::pair<std::string, Accountant>> accountants;
+    std::function<size_t()> event_counter;
+};
+
+#endif
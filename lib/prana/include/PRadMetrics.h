@@ -0,0 +1,124 @@
+#ifndef PRAD_METRICS_H
+#define PRAD_METRICS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <ostream>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+
+// default interval of the periodic dump in ms
+#define METRICS_DUMP_INTERVAL 10000
+
+// a monotonic counter, it is updated with relaxed atomic operations, so it
+// can be increased by any thread in the event loops
+class PRadMetricCounter
+{
+public:
+    PRadMetricCounter() : value(0) {}
+
+    void Add(uint64_t n = 1) {value.fetch_add(n, std::memory_order_relaxed);}
+    uint64_t Get() const {return value.load(std::memory_order_relaxed);}
+
+private:
+    std::atomic<uint64_t> value;
+};
+
+// time the enclosing scope into a counter of nanoseconds
+class PRadMetricTimer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    PRadMetricTimer(PRadMetricCounter *c) : counter(c), start(Clock::now()) {}
+    ~PRadMetricTimer()
+    {
+        counter->Add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+private:
+    PRadMetricCounter *counter;
+    Clock::time_point start;
+};
+
+// live metrics of the long running jobs
+// counters are kept by the registry and never removed, so the pointers can be
+// cached by the callers, gauges are functions evaluated when the metrics are
+// written, the metrics can be dumped periodically to a file in JSON or in the
+// Prometheus text format (for the textfile collector of node exporter)
+// the names follow the Prometheus convention, labels can be part of the name,
+// such as prad_pipeline_queue_depth{segment="1"}
+class PRadMetrics
+{
+public:
+    enum Format
+    {
+        JSON = 0,
+        Prometheus,
+    };
+
+    typedef std::function<double()> Gauge;
+
+private:
+    struct CounterEntry
+    {
+        std::string name, help;
+        double scale;
+        PRadMetricCounter counter;
+        uint64_t last;
+    };
+
+    struct GaugeEntry
+    {
+        std::string name, help;
+        Gauge func;
+    };
+
+public:
+    static PRadMetrics &Instance();
+
+    // the value is multiplied by scale when written, e.g. 1e-9 for a counter
+    // of nanoseconds named with _seconds_total
+    PRadMetricCounter *GetCounter(const std::string &name, const std::string &help = "",
+                                  double scale = 1.);
+    void AddGauge(const std::string &name, Gauge func, const std::string &help = "");
+    void RemoveGauge(const std::string &name);
+
+    void Write(std::ostream &os, Format format);
+    bool Save(const std::string &path, Format format);
+    void StartDump(const std::string &path, unsigned int interval_ms = METRICS_DUMP_INTERVAL,
+                   Format format = JSON);
+    void StopDump();
+
+private:
+    PRadMetrics();
+    ~PRadMetrics();
+    PRadMetrics(const PRadMetrics &) = delete;
+    PRadMetrics &operator =(const PRadMetrics &) = delete;
+
+    void writeJSON(std::ostream &os);
+    void writePrometheus(std::ostream &os) const;
+    void dump(std::string path, unsigned int interval_ms, Format format);
+
+private:
+    std::mutex locker;
+    std::deque<CounterEntry> counters;
+    std::unordered_map<std::string, CounterEntry*> counter_map;
+    std::vector<GaugeEntry> gauges;
+    std::chrono::steady_clock::time_point start_time, last_time;
+
+    // periodic dump
+    std::thread dump_thread;
+    bool dump_stop;
+    std::mutex dump_locker;
+    std::condition_variable dump_cond;
+};
+
+#endif
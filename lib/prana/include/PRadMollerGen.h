@@ -2,10 +2,22 @@
 #define PRAD_MOLLER_GEN_H
 
 #include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <cstdint>
 #include "canalib.h"
 
 #define MAX_T_BINS 30000
 #define MAX_V_BINS 30000
+// version of the cached grids, it should be changed with the cross sections,
+// the caches of other versions are regenerated
+#define MOLLER_GRID_VERSION 1
+// number of events sampled from one random stream
+#define MOLLER_SAMPLE_BLOCK 10000
+// maximum number of v bins kept by the memo of the grid points
+#define MOLLER_MEMO_VBINS 2000000
 
 extern "C"
 {
@@ -26,12 +38,19 @@ extern "C"
 #define MERAD_NT1 30
 #define MERAD_NZ 60
 
-    extern struct
+    // the common blocks are thread private when multi-threading is enabled
+#ifdef MULTI_THREAD
+#define MERAD_COMMON extern __thread
+#else
+#define MERAD_COMMON extern
+#endif
+
+    MERAD_COMMON struct
     {
         double grt1[MERAD_NT1], grz[MERAD_NZ];
     } merad_grid_;
 
-    extern struct
+    MERAD_COMMON struct
     {
         double distsit1[4*MERAD_NT1], distart1[4*MERAD_NT1];
         double distsiz[MERAD_NZ], distarz[MERAD_NZ];
@@ -80,15 +99,62 @@ public:
                double &sig_born, double &sig_nrad, double &sig_rad) const;
     void GetXSdQsq(double s, double t,
                    double &sig_born, double &sig_nrad, double &sig_rad) const;
+    // the angles are calculated by the threads set by SetThreads
+    void GetXS(double Es, const std::vector<double> &angles,
+               std::vector<double> &sig_born, std::vector<double> &sig_nrad,
+               std::vector<double> &sig_rad) const;
 
     double GetNonRadXSdQsq(double s, double t) const;
     std::vector<VDist> GetRadVDist(double s, double t) const;
+    // a point of the sampling grids, it is from the memo if the same (s, t)
+    // was evaluated with the same v range and precision
+    TDist GetGridPoint(double s, double t) const;
+
+    // statistics of the grid point memo
+    struct MemoStats
+    {
+        uint64_t lookups, hits, points, vbins;
+
+        MemoStats() : lookups(0), hits(0), points(0), vbins(0) {}
+        double HitRate() const {return lookups ? (double)hits/(double)lookups : 0.;}
+    };
+
+    // the memo keeps the evaluated points for the later grids of the generator,
+    // such as another Generate with the same kinematics but a different seed
+    void SetPointMemo(bool m) {use_memo = m;}
+    bool IsPointMemo() const {return use_memo;}
+    MemoStats GetMemoStats() const;
+    void ClearPointMemo() const;
 
     void SetMinBins(unsigned int mbins) {min_bins = mbins;}
     void SetPrecision(double t_res, double v_res) {t_prec = t_res; v_prec = v_res;}
     unsigned int GetMinBins() const {return min_bins;}
     double GetTDistPrecision() const {return t_prec;}
     double GetVDistPrecision() const {return v_prec;}
+    // threads to initialize the grids and sample events, 0 means the number
+    // of cores, the results do not depend on it
+    void SetThreads(unsigned int n) {nthreads = n;}
+    unsigned int GetThreads() const {return nthreads;}
+    // seed of the random streams, 0 means a random seed for every call
+    void SetSeed(uint64_t s) {seed = s;}
+    uint64_t GetSeed() const {return seed;}
+    // save the events in the binary format of PRadGenEventFile instead of text
+    void SetBinaryOutput(bool b) {binary_output = b;}
+    bool IsBinaryOutput() const {return binary_output;}
+    // sample the t bins by an alias table and v by guide tables instead of the
+    // binary searches, the statistics are the same but not the single events
+    void SetAliasSampling(bool b) {alias_sampling = b;}
+    bool IsAliasSampling() const {return alias_sampling;}
+
+    // cache of the sampling grids, the grids are saved in the folder and loaded
+    // by the later calls with the same parameters, empty folder disables it
+    void SetGridCache(const std::string &dir) {cache_dir = dir;}
+    const std::string &GetGridCache() const {return cache_dir;}
+    std::string GetGridCachePath(double s, double t_min, double t_max) const;
+    bool SaveGrids(const std::string &path, double s, double t_min, double t_max,
+                   const std::vector<TDist> &grids) const;
+    bool LoadGrids(const std::string &path, double s, double t_min, double t_max,
+                   std::vector<TDist> &grids) const;
 
     // static functions
     static double SigmaBorn(double s, double t);
@@ -103,6 +169,7 @@ public:
 
 private:
     std::vector<TDist> init_grids(double s, double t_min, double t_max, bool verbose) const;
+    std::vector<TDist> get_grids(double s, double t_min, double t_max, bool verbose) const;
 
 private:
     // v_min defines the minimum photon energy that to be generated (hard photons)
@@ -112,6 +179,19 @@ private:
     unsigned int min_bins;
     // required theta interpolation precision
     double t_prec, v_prec;
+    // number of threads for the grids and sampling
+    unsigned int nthreads;
+    uint64_t seed;
+    bool binary_output, alias_sampling;
+    // folder of the cached grids
+    std::string cache_dir;
+
+    // evaluated points by (s, t), they are valid for the parameters below
+    bool use_memo;
+    mutable std::mutex memo_locker;
+    mutable std::map<std::pair<double, double>, TDist> memo;
+    mutable double memo_params[4];
+    mutable MemoStats memo_stats;
 };
 
 #endif
@@ -0,0 +1,110 @@
+#ifndef PRAD_ONLINE_BUFFER_H
+#define PRAD_ONLINE_BUFFER_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "PRadEventStruct.h"
+
+// default number of recent events kept in online mode
+#define ONLINE_BUFFER_SIZE 1000
+
+// maximum data kept for an event, the extra data are truncated
+#define ONLINE_MAX_ADC 2048
+#define ONLINE_MAX_TDC 1024
+#define ONLINE_MAX_DSC 64
+#define ONLINE_MAX_GEM 1024
+
+// version of the shared memory layout
+#define ONLINE_SHARED_VERSION 1
+
+// fixed-capacity circular buffer of the most recent events, it is written by
+// one thread and can be read by any threads without locks
+// every slot is protected by a sequence number (seqlock), a reader retries if
+// the slot is being written, and fails if the event has been overwritten
+// the buffer can be placed in a POSIX shared memory segment, so one process
+// decodes the events and the other processes on the node read them from the
+// same slots, the readers map the segment read-only
+class PRadOnlineBuffer
+{
+public:
+    // an event in plain arrays, so that it can be copied while being written
+    struct Slot
+    {
+        std::atomic<uint32_t> seq;
+        uint64_t index;
+        int32_t event_number;
+        uint8_t type;
+        uint8_t trigger;
+        uint64_t timestamp;
+        int32_t epics_index;
+        uint32_t nadc, ntdc, ndsc, ngem;
+        ADC_Data adc[ONLINE_MAX_ADC];
+        TDC_Data tdc[ONLINE_MAX_TDC];
+        DSC_Data dsc[ONLINE_MAX_DSC];
+        GEM_Data gem[ONLINE_MAX_GEM];
+
+        Slot() : seq(0), index(0), nadc(0), ntdc(0), ndsc(0), ngem(0) {}
+    };
+
+    // the counters are in the header of the shared segment
+    struct Header
+    {
+        char magic[8];
+        uint32_t version, slot_size;
+        uint64_t capacity;
+        std::atomic<uint64_t> written;
+        std::atomic<uint64_t> truncated;
+    };
+
+public:
+    PRadOnlineBuffer(size_t capacity = 0);
+    virtual ~PRadOnlineBuffer();
+
+    PRadOnlineBuffer(const PRadOnlineBuffer &) = delete;
+    PRadOnlineBuffer &operator =(const PRadOnlineBuffer &) = delete;
+
+    // writer side, resize is not allowed with readers
+    // it goes back to the private memory if the buffer is shared
+    void Resize(size_t capacity);
+    void Push(const EventData &event);
+    void Clear();
+
+    // create the shared segment /name and write the events to it, the segment
+    // is removed when the buffer is released
+    bool CreateShared(const std::string &name, size_t capacity);
+    // map an existing segment to read, Push and Clear are not allowed then
+    bool OpenShared(const std::string &name);
+    bool IsShared() const {return shm_addr != nullptr;}
+    bool IsReadOnly() const {return read_only;}
+    const std::string &GetSharedName() const {return shm_name;}
+
+    // reader side, back = 0 is the latest event
+    bool Read(size_t back, EventData &event) const;
+    // read the event by the count of the pushed events, the consumers can
+    // follow every event with it, return false if the event is not written
+    // yet or is overwritten
+    bool ReadAt(uint64_t index, EventData &event) const;
+    size_t Size() const;
+    size_t Capacity() const {return capacity;}
+    uint64_t GetWritten() const {return header->written.load(std::memory_order_acquire);}
+    uint64_t GetTruncated() const {return header->truncated.load(std::memory_order_relaxed);}
+
+private:
+    void release();
+
+private:
+    Header *header;
+    Slot *slots;
+    size_t capacity;
+    bool read_only;
+    Header local_header;
+
+    // shared segment
+    std::string shm_name;
+    void *shm_addr;
+    size_t shm_size;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef PRAD_PROFILER_H
+#define PRAD_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+// maximum number of named regions
+#define PROFILER_MAX_REGIONS 256
+// maximum number of trace records for one thread
+#define PROFILER_TRACE_SIZE 1000000
+
+// the regions are instrumented by PRAD_PROFILE_SCOPE("name"), it times the
+// enclosing scope, and compiles to nothing unless PRAD_PROFILE is defined
+#define PRAD_PROFILE_CAT2(a, b) a ## b
+#define PRAD_PROFILE_CAT(a, b) PRAD_PROFILE_CAT2(a, b)
+#ifdef PRAD_PROFILE
+#define PRAD_PROFILE_SCOPE(name) \
+    static const int PRAD_PROFILE_CAT(prof_region_, __LINE__) = PRadProfiler::Instance().Register(name); \
+    PRadProfiler::Scope PRAD_PROFILE_CAT(prof_scope_, __LINE__)(PRAD_PROFILE_CAT(prof_region_, __LINE__))
+#else
+#define PRAD_PROFILE_SCOPE(name) do {} while(0)
+#endif
+
+// profiler of the hot paths
+// every thread accumulates the timing of the regions in its own counters, the
+// counters are only written by the owner thread and read with relaxed atomic
+// operations, so the summary can be taken while the threads are running
+class PRadProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Summary
+    {
+        std::string name;
+        uint64_t calls, total_ns, max_ns;
+        unsigned int threads;
+        Summary() : calls(0), total_ns(0), max_ns(0), threads(0) {}
+    };
+
+    // the scoped timer
+    class Scope
+    {
+    public:
+        Scope(int region) : id(region), start(Clock::now()) {}
+        ~Scope() {PRadProfiler::Instance().Record(id, start, Clock::now());}
+
+    private:
+        int id;
+        Clock::time_point start;
+    };
+
+private:
+    struct Counter
+    {
+        std::atomic<uint64_t> calls, total_ns, max_ns;
+        Counter() : calls(0), total_ns(0), max_ns(0) {}
+    };
+
+    struct TraceRecord
+    {
+        int region;
+        uint64_t begin_ns, dur_ns;
+    };
+
+    // counters of a thread, they are owned by the profiler and kept after the
+    // thread exits
+    struct ThreadData
+    {
+        unsigned int tid;
+        Counter counters[PROFILER_MAX_REGIONS];
+        std::vector<TraceRecord> trace;
+        ThreadData(unsigned int t) : tid(t) {}
+    };
+
+public:
+    static PRadProfiler &Instance();
+
+    int Register(const std::string &name);
+    void Record(int region, const Clock::time_point &beg, const Clock::time_point &end);
+    void Reset();
+    void SetTrace(bool t) {trace = t;}
+    bool IsTracing() const {return trace;}
+
+    std::vector<Summary> GetSummary() const;
+    void PrintSummary(std::ostream &os) const;
+    bool SaveTrace(const std::string &path) const;
+
+private:
+    PRadProfiler();
+    ~PRadProfiler();
+    PRadProfiler(const PRadProfiler &) = delete;
+    PRadProfiler &operator =(const PRadProfiler &) = delete;
+
+    ThreadData *getThreadData();
+
+private:
+    mutable std::mutex locker;
+    std::vector<std::string> regions;
+    std::vector<ThreadData*> threads;
+    std::atomic<bool> trace;
+    Clock::time_point origin;
+};
+
+#endif
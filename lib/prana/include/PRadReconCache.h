@@ -0,0 +1,156 @@
+#ifndef PRAD_RECON_CACHE_H
+#define PRAD_RECON_CACHE_H
+
+#include <list>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include "PRadEventStruct.h"
+
+// suggested number of events to be cached for the event viewing
+#define RECON_CACHE_SIZE 256
+
+
+// fnv-1a hash, it is used to build the setting hashes of the reconstructions
+inline uint64_t recon_hash(const void *data, size_t size, uint64_t h = 14695981039346656037ULL)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; ++i)
+    {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// an event is identified by its number and time stamp, the setting is the hash
+// of everything that affects the reconstruction result
+struct ReconCacheKey
+{
+    int32_t event_number;
+    uint64_t timestamp;
+    uint64_t setting;
+
+    ReconCacheKey(const EventData &event, uint64_t s)
+    : event_number(event.event_number), timestamp(event.timestamp), setting(s)
+    {}
+
+    bool operator ==(const ReconCacheKey &rhs) const
+    {
+        return event_number == rhs.event_number &&
+               timestamp == rhs.timestamp &&
+               setting == rhs.setting;
+    }
+};
+
+struct ReconCacheKeyHash
+{
+    size_t operator ()(const ReconCacheKey &key) const
+    {
+        uint64_t h = recon_hash(&key.event_number, sizeof(key.event_number));
+        h = recon_hash(&key.timestamp, sizeof(key.timestamp), h);
+        return recon_hash(&key.setting, sizeof(key.setting), h);
+    }
+};
+
+// least recently used cache of the reconstruction results, capacity 0 means
+// it is disabled
+template<class Value>
+class PRadReconCache
+{
+    typedef std::pair<ReconCacheKey, Value> Item;
+    typedef typename std::list<Item>::iterator Iter;
+
+public:
+    PRadReconCache(size_t cap = 0) : capacity(cap) {}
+
+    // the index refers to the list items, so it is rebuilt for a copy
+    PRadReconCache(const PRadReconCache &that)
+    : capacity(that.capacity), items(that.items)
+    {
+        rebuildIndex();
+    }
+
+    PRadReconCache(PRadReconCache &&that) = default;
+
+    PRadReconCache &operator =(const PRadReconCache &rhs)
+    {
+        if(this != &rhs) {
+            capacity = rhs.capacity;
+            items = rhs.items;
+            rebuildIndex();
+        }
+        return *this;
+    }
+
+    PRadReconCache &operator =(PRadReconCache &&rhs) = default;
+
+    void SetCapacity(size_t cap)
+    {
+        capacity = cap;
+        trim();
+    }
+
+    size_t GetCapacity() const {return capacity;}
+    size_t Size() const {return items.size();}
+
+    void Clear()
+    {
+        items.clear();
+        index.clear();
+    }
+
+    // return nullptr if the key is not cached, the found item becomes the most
+    // recently used one
+    const Value *Find(const ReconCacheKey &key)
+    {
+        auto it = index.find(key);
+        if(it == index.end())
+            return nullptr;
+
+        items.splice(items.begin(), items, it->second);
+        return &it->second->second;
+    }
+
+    void Insert(const ReconCacheKey &key, const Value &val)
+    {
+        if(!capacity)
+            return;
+
+        auto it = index.find(key);
+        if(it != index.end()) {
+            it->second->second = val;
+            items.splice(items.begin(), items, it->second);
+            return;
+        }
+
+        items.emplace_front(key, val);
+        index.emplace(key, items.begin());
+        trim();
+    }
+
+private:
+    void trim()
+    {
+        while(items.size() > capacity)
+        {
+            index.erase(items.back().first);
+            items.pop_back();
+        }
+    }
+
+    void rebuildIndex()
+    {
+        index.clear();
+        for(auto it = items.begin(); it != items.end(); ++it)
+            index.emplace(it->first, it);
+    }
+
+private:
+    size_t capacity;
+    std::list<Item> items;
+    std::unordered_map<ReconCacheKey, Iter, ReconCacheKeyHash> index;
+};
+
+#endif // PRAD_RECON_CACHE_H
@@ -0,0 +1,135 @@
+#ifndef PRAD_REPLAY_DRIVER_H
+#define PRAD_REPLAY_DRIVER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include "PRadDataHandler.h"
+#include "PRadInfoCenter.h"
+#include "PRadProfiler.h"
+
+// default events read by every worker in a tuning trial
+#define TUNE_EVENTS 20000
+// default file of the tuned configurations, under the home directory
+#define TUNE_FILE ".prad_tune.conf"
+
+class PRadHyCalSystem;
+class PRadGEMSystem;
+class PRadEPICSystem;
+class PRadTaggerSystem;
+
+class PRadReplayDriver
+{
+public:
+    // a worker has its own copies of the systems, data handler and run
+    // information, so it does not share anything with the other workers
+    struct Worker
+    {
+        PRadInfoCenter info;
+        PRadDataHandler handler;
+        PRadHyCalSystem *hycal;
+        PRadGEMSystem *gem;
+        PRadEPICSystem *epics;
+        PRadTaggerSystem *tagger;
+        unsigned int id;        // placement by the thread topology
+        int count;
+        int nfiles;
+        int last_split;
+
+        Worker(const PRadReplayDriver &driver, unsigned int id = 0);
+        ~Worker();
+    };
+
+    // result of a tuning trial, the profiled regions are only available when
+    // the library is built with PRAD_PROFILE
+    struct TuneResult
+    {
+        unsigned int workers, decode_threads;
+        int events;
+        double time;    // wall time in ms
+        std::vector<PRadProfiler::Summary> stages;
+
+        TuneResult(unsigned int w = 1, unsigned int d = 1)
+        : workers(w), decode_threads(d), events(0), time(0.) {}
+        double Rate() const {return (time > 0.) ? events/time*1000. : 0.;}
+    };
+
+public:
+    // nthreads 0 means using all the hardware threads
+    PRadReplayDriver(unsigned int nthreads = 0);
+    virtual ~PRadReplayDriver();
+
+    PRadReplayDriver(const PRadReplayDriver &) = delete;
+    PRadReplayDriver &operator =(const PRadReplayDriver &) = delete;
+
+    // the systems are cloned for the workers, results are merged back to them
+    void SetHyCalSystem(PRadHyCalSystem *hycal) {hycal_sys = hycal;}
+    void SetGEMSystem(PRadGEMSystem *gem) {gem_sys = gem;}
+    void SetEPICSystem(PRadEPICSystem *epics) {epic_sys = epics;}
+    void SetTaggerSystem(PRadTaggerSystem *tagger) {tagger_sys = tagger;}
+    void SetInfoCenter(PRadInfoCenter *info);
+    void SetThreads(unsigned int n);
+    // block-parallel decoding threads of every worker
+    void SetDecodeThreads(unsigned int n) {decode_threads = (n > 0) ? n : 1;}
+    void SetChunkedDST(uint32_t nevents, int level = DST_CHUNK_LEVEL)
+    {chunk_events = nevents; chunk_level = level;}
+    void SetEPICSDeltaDST(uint32_t nrecords = DST_EPICS_KEYFRAME) {epics_keyframe = nrecords;}
+    // the split outputs are resumed from their last checkpoints
+    void SetResume(bool r) {resume = r;}
+    unsigned int GetThreads() const {return threads;}
+    unsigned int GetDecodeThreads() const {return decode_threads;}
+
+    // auto-tune mode, the configuration of this host is loaded from the tune
+    // file before replaying or processing, it is benchmarked and saved if the
+    // host is not in the file
+    void SetAutoTune(bool a, const std::string &file = "") {auto_tune = a; tune_file = file;}
+    void SetTuneEvents(int n) {tune_events = (n > 0) ? n : TUNE_EVENTS;}
+    bool IsAutoTune() const {return auto_tune;}
+    // benchmark the stage thread allocations over the first events of the
+    // input, the best one is applied and saved for this host
+    bool AutoTune(const std::string &r_path, int split, const std::string &file = "");
+    bool LoadTune(const std::string &file = "");
+    bool SaveTune(const std::string &file = "") const;
+    const std::vector<TuneResult> &GetTuneResults() const {return tune_results;}
+    PRadInfoCenter *GetInfoCenter() const {return info_center;}
+
+    // process the split files in parallel
+    int Replay(const std::string &r_path, int split, const std::string &w_path);
+    int Process(const std::string &r_path, int split);
+
+private:
+    int run(const std::string &r_path, int split, const std::string &w_path);
+    void work(Worker *worker, const std::string &r_path, int split, const std::string &w_path);
+    void merge(const std::vector<Worker*> &workers);
+    bool mergeDST(const std::string &w_path, int split);
+    void prepareTune(const std::string &r_path, int split);
+    TuneResult tuneTrial(const std::string &r_path, int split, unsigned int nworkers,
+                         unsigned int ndecode);
+
+public:
+    static std::string split_path(const std::string &path, int i);
+    static std::string tune_path(const std::string &file);
+    static std::string host_name();
+
+private:
+    PRadHyCalSystem *hycal_sys;
+    PRadGEMSystem *gem_sys;
+    PRadEPICSystem *epic_sys;
+    PRadTaggerSystem *tagger_sys;
+    PRadInfoCenter *info_center;
+    unsigned int threads;
+    unsigned int decode_threads;
+    uint32_t chunk_events;
+    int chunk_level;
+    uint32_t epics_keyframe;
+    bool resume;
+    std::atomic<int> next_split;
+
+    // auto-tune
+    bool auto_tune;
+    int tune_events;
+    std::string tune_file;
+    std::vector<TuneResult> tune_results;
+};
+
+#endif
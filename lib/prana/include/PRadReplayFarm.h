@@ -0,0 +1,140 @@
+#ifndef PRAD_REPLAY_FARM_H
+#define PRAD_REPLAY_FARM_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <sys/types.h>
+
+// default size of a work unit, consecutive split files of a run are grouped
+// until the unit reaches it
+#define FARM_UNIT_BYTES 4294967296ULL // 4 GB
+// times a failed unit is dispatched again
+#define FARM_RETRIES 2
+
+class PRadDataHandler;
+
+// a coordinator distributing the replay of many runs to worker processes
+// the split files of the runs are grouped into units balanced by bytes, and
+// the units are dispatched from the largest to the idle workers, the workers
+// are started by shell commands, so they can be on other nodes through ssh or
+// a batch system, and they talk to the coordinator with a line protocol on
+// their standard input and output
+//     coordinator -> worker: UNIT <id> <run_file> <first> <last> <out_dst> <out_hist> <resume>
+//                            QUIT
+//     worker -> coordinator: READY
+//                            DONE <id> <events>
+//                            FAIL <id> <reason>
+// the split outputs of a run are merged into its DST file, and the
+// histograms of the units into its histogram file, the finished units and
+// runs are recorded in a checkpoint file, so an interrupted farm continues
+// from where it stopped, the paths are shared by the coordinator and workers
+class PRadReplayFarm
+{
+public:
+    enum Status
+    {
+        Pending = 0,
+        Running,
+        Done,
+        Failed,
+    };
+
+    // a range of split files of a run
+    struct Unit
+    {
+        int id, run;
+        int first, last;
+        uint64_t bytes;
+        int attempts;
+        Status status;
+
+        Unit(int i, int r, int f, int l)
+        : id(i), run(r), first(f), last(l), bytes(0), attempts(0), status(Pending)
+        {}
+    };
+
+    struct Run
+    {
+        std::string input, output;
+        int split;
+        bool merged;
+        std::vector<int> units;
+    };
+
+    // a worker process and its pipes
+    struct Worker
+    {
+        std::string command;
+        pid_t pid;
+        int in_fd, out_fd;
+        bool ready;
+        int unit;
+        int restarts;
+        std::string buffer;
+
+        Worker(const std::string &c)
+        : command(c), pid(-1), in_fd(-1), out_fd(-1), ready(false), unit(-1), restarts(0)
+        {}
+    };
+
+public:
+    PRadReplayFarm();
+    virtual ~PRadReplayFarm();
+
+    PRadReplayFarm(const PRadReplayFarm &) = delete;
+    PRadReplayFarm &operator =(const PRadReplayFarm &) = delete;
+
+    // a worker is started by the shell command, such as "replayFarm -w" or
+    // "ssh node01 'cd /work && replayFarm -w'"
+    void AddWorker(const std::string &command) {workers.emplace_back(command);}
+    // split -1 means the run is a single file
+    void AddRun(const std::string &input, int split, const std::string &output);
+    void SetUnitBytes(uint64_t bytes) {unit_bytes = (bytes > 0) ? bytes : FARM_UNIT_BYTES;}
+    void SetRetries(int n) {retries = (n > 0) ? n : 0;}
+    void SetCheckpoint(const std::string &path) {ckpt_path = path;}
+    // keep the split outputs and unit histograms after they are merged
+    void SetKeepParts(bool k) {keep_parts = k;}
+
+    // replay all the runs, return true if all of them are merged
+    bool Process();
+    void Clear();
+
+    const std::vector<Unit> &GetUnits() const {return units;}
+    const std::vector<Run> &GetRuns() const {return runs;}
+
+    // the worker side, serve the units from standard input until QUIT, the
+    // normal outputs are redirected to the standard error
+    static int Serve(PRadDataHandler *handler);
+
+    // paths of the outputs
+    static std::string hist_path(const std::string &output);
+    static std::string unit_hist_path(const std::string &output, int first);
+
+private:
+    void partition();
+    void loadCheckpoint();
+    void record(const std::string &line);
+    std::string unitKey(const Unit &unit) const;
+    bool start(Worker &w);
+    void stop(Worker &w, bool kill_it);
+    bool dispatch(Worker &w);
+    void receive(Worker &w);
+    void handle(Worker &w, const std::string &line);
+    void release(Worker &w);
+    bool mergeRun(Run &run);
+
+private:
+    std::vector<Run> runs;
+    std::vector<Unit> units;
+    std::deque<Worker> workers;
+    std::deque<int> queue;
+    std::vector<std::string> finished;
+    uint64_t unit_bytes;
+    int retries;
+    bool keep_parts;
+    std::string ckpt_path;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef PRAD_RUN_SUMMARY_H
+#define PRAD_RUN_SUMMARY_H
+
+#include <vector>
+#include <cstdint>
+#include "datastruct.h"
+#include "PRadEventStruct.h"
+#include "PRadInfoCenter.h"
+
+// version of the encoded summary
+#define RUN_SUMMARY_VERSION 1
+
+
+// summary of the events in a DST file, it is accumulated by the writer and
+// saved after the event map, so the runs can be selected by reading a few KB
+// of every file instead of the events
+// the summary is not complete if some of the records were not accumulated,
+// such as the records copied from a file without a summary or written after
+// a resumed checkpoint
+class PRadRunSummary
+{
+public:
+    struct EPICSRange
+    {
+        uint32_t count;
+        float min, max;
+
+        EPICSRange() : count(0), min(0.), max(0.) {}
+        void Add(float val);
+        void Merge(const EPICSRange &that);
+    };
+
+public:
+    PRadRunSummary();
+
+    void Clear();
+    void Add(const EventData &event);
+    void Add(const EpicsData &epics);
+    // summary of the following records in another file
+    void Merge(const PRadRunSummary &that);
+
+    // encoded to the end of buf, decoding returns false for a corrupted buffer
+    void Encode(std::vector<char> &buf) const;
+    bool Decode(const char *buf, size_t size);
+
+    void SetRunNumber(int run) {run_number = run;}
+    void SetComplete(bool c) {complete = c;}
+    int GetRunNumber() const {return run_number;}
+    bool IsComplete() const {return complete;}
+
+    uint64_t GetEventCount() const {return nevents;}
+    uint64_t GetPhysicsCount() const {return nphysics;}
+    uint64_t GetEPICSCount() const {return nepics;}
+    int GetFirstEvent() const {return first_event;}
+    int GetLastEvent() const {return last_event;}
+    uint64_t GetFirstTime() const {return first_time;}
+    uint64_t GetLastTime() const {return last_time;}
+
+    // events by the trigger type
+    uint64_t GetTriggerCount(int trg) const;
+    const std::vector<uint64_t> &GetTriggerCounts() const {return trg_counts;}
+
+    // the beam charge and live time from the sync events
+    const PRadInfoCenter::RunCounter &GetRunCounter() const {return counter;}
+    double GetBeamCharge() const {return counter.beam_charge;}
+    double GetLiveBeamCharge() const {return counter.live_charge;}
+    double GetLiveTime() const {return counter.live_time();}
+
+    // physics events with the adc channel in the zero suppressed data
+    uint32_t GetOccupancy(uint32_t ch) const;
+    const std::vector<uint32_t> &GetOccupancies() const {return occupancy;}
+
+    // values of the epics channels, by the channel index
+    const std::vector<EPICSRange> &GetEPICSRanges() const {return epics_ranges;}
+
+private:
+    int32_t run_number;
+    bool complete;
+    uint64_t nevents, nphysics, nepics;
+    int32_t first_event, last_event;
+    uint64_t first_time, last_time;
+    std::vector<uint64_t> trg_counts;
+    PRadInfoCenter::RunCounter counter;
+    std::vector<uint32_t> occupancy;
+    std::vector<EPICSRange> epics_ranges;
+};
+
+#endif // PRAD_RUN_SUMMARY_H
@@ -0,0 +1,48 @@
+#ifndef PRAD_SPARSIFIER_H
+#define PRAD_SPARSIFIER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "PRadEventStruct.h"
+#include "PRadADCChannel.h"
+
+
+class PRadSparsifier
+{
+public:
+    typedef size_t (*Kernel)(const int32_t *thres, size_t nthres,
+                             const ADC_Data *in, size_t n, ADC_Data *out);
+
+    enum KernelType
+    {
+        Scalar = 0,
+        SSE,
+        AVX2,
+    };
+
+public:
+    PRadSparsifier();
+
+    void Build(const std::vector<PRadADCChannel*> &adc_list);
+    void Update(const PRadADCChannel *adc);
+    void Clear();
+    size_t Apply(const ADC_Data *in, size_t n, ADC_Data *out) const;
+    void SetKernel(KernelType type);
+    KernelType GetKernel() const {return ktype;}
+    size_t GetSize() const {return threshold.size();}
+
+    // cpu dispatch
+    static KernelType BestKernel();
+
+private:
+    // struct of arrays indexed by channel id
+    std::vector<double> ped_mean;
+    std::vector<double> ped_sigma;
+    std::vector<int32_t> threshold;
+
+    KernelType ktype;
+    Kernel kernel;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define PRAD_SQUARE_CLUSTER_H
 
 #include <vector>
+#include <cstdint>
 #include "PRadHyCalCluster.h"
 
 class PRadSquareCluster : public PRadHyCalCluster
@@ -10,20 +11,33 @@ public:
     PRadSquareCluster(class PRadHyCalReconstructor *r);
     virtual ~PRadSquareCluster();
     PRadHyCalCluster *Clone() const;
+    void SetReconstructor(class PRadHyCalReconstructor *r) {rec = r;}
 
-    void FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls) const;
+    void FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls,
+                     ClusterContext &ctx) const;
+    void UpdateLayout(const class PRadHyCalDetector *det);
 
 protected:
     void groupHits(std::vector<ModuleHit> &hits,
-                   std::vector<ModuleCluster> &clusters) const;
-    bool fillClusters(ModuleHit &hit, std::vector<ModuleCluster> &clusters) const;
+                   std::vector<ModuleCluster> &clusters,
+                   ClusterContext &ctx) const;
+    bool fillClusters(ModuleHit &hit, std::vector<ModuleCluster> &clusters,
+                      ClusterContext &ctx) const;
     bool splitHit(ModuleHit &hit,
                   std::vector<ModuleCluster> &clusters,
                   std::vector<unsigned int> &indices) const;
     bool checkBelongs(const ModuleHit &center, const ModuleHit &hit, float factor) const;
+    bool checkMasks(const ModuleHit &hit) const;
 
 protected:
     class PRadHyCalReconstructor *rec;
+
+    // square window of every module, bit j in the row of module i is set if
+    // module j is inside the square centered at module i
+    const class PRadHyCalDetector *mask_det;
+    unsigned int mask_size;
+    size_t mask_modules, mask_words;
+    std::vector<uint64_t> masks;
 };
 
 #endif
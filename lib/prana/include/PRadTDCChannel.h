@@ -29,22 +29,18 @@ public:
     void ConnectChannel(PRadADCChannel *ch);
     void DisconnectChannel(int id, bool force_disconn = false);
     void DisconnectChannels();
-    void AddTimeMeasure(const unsigned short &count);
-    void AddTimeMeasure(const std::vector<unsigned short> &counts);
-    void SetTimeMeasure(const std::vector<unsigned short> &counts);
     void FillHist(const unsigned short &time);
     void Reset();
     void ResetHists();
-    void ClearTimeMeasure();
+    void MergeHists(const PRadTDCChannel &that);
 
     PRadADCChannel* GetADCChannel(int id) const;
     TH1 *GetHist() const {return tdc_hist;}
     std::vector<PRadADCChannel*> GetChannelList() const;
-    const std::vector<unsigned short> &GetTimeMeasure() const {return time_measure;}
 
 private:
+    // the time measures of an event are kept by PRadHyCalSystem in one array
     std::unordered_map<int, PRadADCChannel*> group_map;
-    std::vector<unsigned short> time_measure;
     TH1 *tdc_hist;
 };
 
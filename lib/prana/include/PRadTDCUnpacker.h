@@ -0,0 +1,64 @@
+#ifndef PRAD_TDC_UNPACKER_H
+#define PRAD_TDC_UNPACKER_H
+
+#include <cstdint>
+#include <cstddef>
+
+// maximum number of words unpacked at a time
+#define TDC_UNPACK_BLOCK 256
+// key of the hit, slot in bits 7-11 and channel in bits 0-6, it is also the
+// index of the hit in tagger channel table
+#define TDC_KEY(slot, channel) (((slot)<<7)|(channel))
+#define TDC_KEY_SLOT(key) ((key)>>7)
+#define TDC_KEY_CHANNEL(key) ((key)&0x7F)
+
+
+// unpack the data words of CAEN V1190 and V767 banks, the word types are
+// classified by vector compare and only the measurement words are written to
+// the staging arrays, the kernel is chosen at runtime as PRadADCUnpacker does
+class PRadTDCUnpacker
+{
+public:
+    // slot is the state of V1190 words, it is updated by the global headers
+    // and carried to the next block, geo tells if the headers have geo address
+    typedef size_t (*V1190Kernel)(const uint32_t *words, size_t n, uint32_t &slot,
+                                  bool geo, uint32_t *keys, uint32_t *values);
+    typedef size_t (*V767Kernel)(const uint32_t *words, size_t n, uint32_t slot,
+                                 uint32_t *keys, uint32_t *values);
+
+    enum KernelType
+    {
+        Scalar = 0,
+        AVX2,
+    };
+
+    // staging arrays of the measurement words
+    struct Staging
+    {
+        uint32_t key[TDC_UNPACK_BLOCK];
+        uint32_t value[TDC_UNPACK_BLOCK];
+    };
+
+public:
+    PRadTDCUnpacker();
+
+    // unpack at most TDC_UNPACK_BLOCK words
+    // return the number of measurement words
+    size_t UnpackV1190(const uint32_t *words, size_t n, uint32_t &slot, bool geo,
+                       Staging &out) const;
+    // the header and end of block words should not be included
+    size_t UnpackV767(const uint32_t *words, size_t n, uint32_t slot,
+                      Staging &out) const;
+    void SetKernel(KernelType type);
+    KernelType GetKernel() const {return ktype;}
+
+    // cpu dispatch
+    static KernelType BestKernel();
+
+private:
+    KernelType ktype;
+    V1190Kernel v1190_kernel;
+    V767Kernel v767_kernel;
+};
+
+#endif
@@ -6,6 +6,8 @@
 
 #define TAGGER_CHANID 30000 // Tagger tdc id will start from this number
 #define TAGGER_T_CHANID 1000 // Start from TAGGER_CHANID, more than 1000 will be t channel
+#define TAGGER_TDC_SLOTS 32 // Slots and channels of V1190 words in the tagger crate
+#define TAGGER_TDC_CHANNELS 128
 
 class TH2I;
 
@@ -27,15 +29,32 @@ public:
     PRadTaggerSystem &operator =(PRadTaggerSystem &&rhs);
 
     void Reset();
+    void MergeHists(const PRadTaggerSystem &that);
 
     // fill hists
     void FeedTaggerHits(const TDCV1190Data &data, EventData &event);
+    // a bank of the tdc data from tagger crate
+    void FeedTaggerHits(const TDCV1190Data *data, size_t n, EventData &event);
+    // unpacked hits, the keys are the indices in the channel table
+    void FeedTaggerHits(const uint32_t *keys, const uint32_t *values, size_t n, EventData &event);
     void FillHists(const EventData &event);
 
+    // tdc channel id from the slot and channel in tagger crate, -1 if the
+    // channel does not belong to tagger E or T counters
+    static int GetChannelID(unsigned int slot, unsigned int channel)
+    {
+        if(slot >= TAGGER_TDC_SLOTS || channel >= TAGGER_TDC_CHANNELS)
+            return -1;
+        return channelTable()[slot*TAGGER_TDC_CHANNELS + channel];
+    }
+
     // get hists
     TH2I *GetECounterHist() const {return hist_E;}
     TH2I *GetTCounterHist() const {return hist_T;}
 
+private:
+    static const int *channelTable();
+
 private:
     TH2I *hist_E;
     TH2I *hist_T;
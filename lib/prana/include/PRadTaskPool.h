@@ -0,0 +1,53 @@
+#ifndef PRAD_TASK_POOL_H
+#define PRAD_TASK_POOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+
+class PRadTaskPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    // task queue for each worker, other workers steal from its back
+    struct TaskQueue
+    {
+        std::mutex locker;
+        std::deque<Task> tasks;
+    };
+
+public:
+    PRadTaskPool(unsigned int nthreads = 0);
+    virtual ~PRadTaskPool();
+
+    PRadTaskPool(const PRadTaskPool &) = delete;
+    PRadTaskPool &operator =(const PRadTaskPool &) = delete;
+
+    void Submit(Task &&task);
+    void Wait();
+    unsigned int GetThreadNumber() const {return threads.size();}
+
+private:
+    void work(unsigned int id);
+    bool takeTask(unsigned int id, Task &task);
+    void finishTask();
+
+private:
+    std::vector<std::thread> threads;
+    TaskQueue *queues;
+    unsigned int nqueues;
+    std::atomic<unsigned int> next_queue;
+    std::atomic<unsigned int> queued;
+    std::atomic<unsigned int> unfinished;
+    bool stop;
+    std::mutex cond_locker;
+    std::condition_variable task_cond, done_cond;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef PRAD_THREAD_TOPOLOGY_H
+#define PRAD_THREAD_TOPOLOGY_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include "ConfigObject.h"
+
+// size of a huge page
+#define TOPOLOGY_HUGE_PAGE (2UL << 20)
+// the buffers smaller than this are not aligned to the huge pages
+#define TOPOLOGY_HUGE_MIN (8UL << 20)
+// sysfs directory of the numa nodes
+#define TOPOLOGY_NODE_DIR "/sys/devices/system/node"
+
+
+// placement of the pipeline workers on the numa nodes and cores
+// the workers of the data handler pipeline (block decoders and dst ranges) are
+// numbered from 0, and every worker pins itself at its start, so the memory it
+// allocates and touches first (its events, stores and decoding buffers) is on
+// its own node by the kernel first-touch policy
+// the nodes are from the configuration file, or detected from sysfs within the
+// cpus allowed for the process, one node with all the cpus otherwise
+// the large buffers can be allocated on 2 MB huge pages
+class PRadThreadTopology : public ConfigObject
+{
+public:
+    enum PinMode
+    {
+        Pin_None = 0,           // the scheduler places the workers
+        Pin_Node,               // any core of the worker node
+        Pin_Core,               // one core for one worker
+    };
+
+    struct Node
+    {
+        int id;
+        std::vector<int> cpus;
+    };
+
+public:
+    static PRadThreadTopology &Instance();
+
+    void Configure(const std::string &path = "");
+
+    // pin the calling thread as the worker, return false if it is not pinned
+    bool PinWorker(unsigned int worker) const;
+    int GetWorkerNode(unsigned int worker) const;
+    int GetWorkerCore(unsigned int worker) const;
+
+    // memory for the large buffers, the pages are only placed when they are
+    // first touched, so the worker should allocate and fill its own buffers
+    void *Allocate(size_t bytes) const;
+    void Free(void *ptr, size_t bytes) const;
+
+    void SetPinMode(PinMode m) {pin_mode = m;}
+    void SetHugePages(bool h) {huge_pages = h;}
+    PinMode GetPinMode() const {return pin_mode;}
+    bool UseHugePages() const {return huge_pages;}
+    const std::vector<Node> &GetNodes() const {return nodes;}
+    size_t GetCoreCount() const;
+    void PrintSummary(std::ostream &os) const;
+
+    static std::vector<int> ParseCPUList(const std::string &list);
+
+private:
+    PRadThreadTopology();
+    PRadThreadTopology(const PRadThreadTopology &) = delete;
+    PRadThreadTopology &operator =(const PRadThreadTopology &) = delete;
+
+    void detectNodes();
+    std::vector<int> allowedCPUs() const;
+    bool workerPlace(unsigned int worker, int &node, int &core) const;
+
+private:
+    PinMode pin_mode;
+    bool huge_pages, compact;
+    std::vector<Node> nodes;
+};
+
+#endif // PRAD_THREAD_TOPOLOGY_H
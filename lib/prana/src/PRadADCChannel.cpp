@@ -25,6 +25,7 @@ PRadADCChannel::PRadADCChannel(const std::string &name, const ChannelAddress &da
 {
     // initialize histograms
     trg_hist.resize(MAX_Trigger, nullptr);
+#ifndef PRAD_NO_ROOT
     std::vector<std::string> hn= {"Physics", "Pedestal", "LMS"};
 
     AddHist(hn[0], new TH1I((ch_name+"_"+hn[0]).c_str(), hn[0].c_str(), 2048, 0, 8191));
@@ -47,32 +48,35 @@ PRadADCChannel::PRadADCChannel(const std::string &name, const ChannelAddress &da
         MapHist("Physics", PHYS_Scintillator);
     }
     MapHist("LMS", LMS_Led);
+#endif
 }
 
 // copy constructor
 PRadADCChannel::PRadADCChannel(const PRadADCChannel &that)
 : PRadDAQChannel(that),
   module(nullptr), tdc_group(nullptr), pedestal(that.pedestal),
-  occupancy(that.occupancy), sparsify(that.sparsify), adc_value(that.adc_value)
+  occupancy(that.GetOccupancy()), sparsify(that.sparsify), adc_value(that.adc_value)
 {
+    trg_hist.resize(that.trg_hist.size(), nullptr);
+#ifndef PRAD_NO_ROOT
     for(auto &it : that.hist_map)
     {
         hist_map[it.first] = (TH1*) it.second->Clone();
     }
 
-    trg_hist.resize(that.trg_hist.size(), nullptr);
     for(size_t i = 0; i < that.trg_hist.size(); ++i)
     {
         if(that.trg_hist[i] != nullptr)
             MapHist(that.trg_hist[i]->GetTitle(), i);
     }
+#endif
 }
 
 // move constructor
 PRadADCChannel::PRadADCChannel(PRadADCChannel &&that)
 : PRadDAQChannel(that),
   module(nullptr), tdc_group(nullptr), pedestal(that.pedestal),
-  occupancy(that.occupancy), sparsify(that.sparsify), adc_value(that.adc_value),
+  occupancy(that.GetOccupancy()), sparsify(that.sparsify), adc_value(that.adc_value),
   trg_hist(std::move(that.trg_hist)), hist_map(std::move(that.hist_map))
 {
     // place holder
@@ -81,10 +85,7 @@ PRadADCChannel::PRadADCChannel(PRadADCChannel &&that)
 // destructor
 PRadADCChannel::~PRadADCChannel()
 {
-    for(auto &ele : hist_map)
-    {
-        delete ele.second, ele.second = nullptr;
-    }
+    ClearHists();
 
     UnsetTDC();
     UnsetModule();
@@ -108,14 +109,12 @@ PRadADCChannel &PRadADCChannel::operator =(PRadADCChannel &&rhs)
         return *this;
 
     // release memories
-    for(auto &it : hist_map)
-        delete it.second;
-    hist_map.clear();
+    ClearHists();
     trg_hist.clear();
 
     PRadDAQChannel::operator =(rhs);
     pedestal = rhs.pedestal;
-    occupancy = rhs.occupancy;
+    occupancy = rhs.GetOccupancy();
     sparsify = rhs.sparsify;
     adc_value = rhs.adc_value;
     hist_map = std::move(hist_map);
@@ -243,7 +242,7 @@ void PRadADCChannel::SetPedestal(const Pedestal &p)
 {
     pedestal = p;
 
-    sparsify = (unsigned short)(pedestal.mean + 5.*pedestal.sigma + 0.5); // round
+    sparsify = SparsifyThreshold(pedestal);
 }
 
 // set pedestal
@@ -263,18 +262,38 @@ void PRadADCChannel::Reset()
 // reset histograms
 void PRadADCChannel::ResetHists()
 {
+#ifndef PRAD_NO_ROOT
     for(auto &it : hist_map)
     {
         if(it.second)
             it.second->Reset();
     }
+#endif
+}
+
+// add the histograms and occupancy from a copy of this channel, histograms
+// are matched by names
+void PRadADCChannel::MergeHists(const PRadADCChannel &that)
+{
+    occupancy.fetch_add(that.occupancy.load());
+
+#ifndef PRAD_NO_ROOT
+    for(auto &it : hist_map)
+    {
+        auto that_it = that.hist_map.find(it.first);
+        if(it.second && that_it != that.hist_map.end() && that_it->second)
+            it.second->Add(that_it->second);
+    }
+#endif
 }
 
 // erase histograms
 void PRadADCChannel::ClearHists()
 {
+#ifndef PRAD_NO_ROOT
     for(auto &it : hist_map)
         delete it.second;
+#endif
 
     hist_map.clear();
 
@@ -289,7 +308,7 @@ bool PRadADCChannel::Sparsify(const unsigned short &adcVal)
     if(adcVal < sparsify)
         return false;
 
-    ++occupancy;
+    occupancy.fetch_add(1, std::memory_order_relaxed);
     return true;
 }
 
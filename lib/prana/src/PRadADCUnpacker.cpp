@@ -0,0 +1,126 @@
+//============================================================================//
+// Unpacker of the Fastbus ADC1881M data words                                //
+// The slot, channel and value are extracted from several words at once, and  //
+// the slot of the words is checked by vector compare, AVX2 kernel is chosen  //
+// at runtime                                                                 //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadADCUnpacker.h"
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PRAD_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// word format, slot is in bits 27-31, channel in bits 17-22, value in 0-13
+#define ADC1881M_SLOT(word) (((word)>>27)&0x1F)
+#define ADC1881M_CHANNEL(word) (((word)>>17)&0x3F)
+#define ADC1881M_VALUE(word) ((word)&0x3FFF)
+
+
+
+//============================================================================//
+// Kernels                                                                    //
+//============================================================================//
+
+// scalar version, it is also used for the tails of the vectorized version
+static size_t unpack_scalar(const uint32_t *words, size_t n, uint32_t slot,
+                            uint16_t *channels, uint16_t *values)
+{
+    size_t i = 0;
+    for(; i < n; ++i)
+    {
+        if(ADC1881M_SLOT(words[i]) != slot)
+            break;
+        channels[i] = ADC1881M_CHANNEL(words[i]);
+        values[i] = ADC1881M_VALUE(words[i]);
+    }
+    return i;
+}
+
+#ifdef PRAD_X86_SIMD
+// avx2 version, 8 words at a time, the channels and values are packed to 16
+// bits together and separated by the permutation
+__attribute__((target("avx2")))
+static size_t unpack_avx2(const uint32_t *words, size_t n, uint32_t slot,
+                          uint16_t *channels, uint16_t *values)
+{
+    const __m256i slot_v = _mm256_set1_epi32((int32_t)slot);
+    const __m256i ch_mask = _mm256_set1_epi32(0x3F);
+    const __m256i val_mask = _mm256_set1_epi32(0x3FFF);
+
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i w = _mm256_loadu_si256((const __m256i*) &words[i]);
+        __m256i same = _mm256_cmpeq_epi32(_mm256_srli_epi32(w, 27), slot_v);
+        if(_mm256_movemask_ps(_mm256_castsi256_ps(same)) != 0xff)
+            break;
+
+        __m256i ch = _mm256_and_si256(_mm256_srli_epi32(w, 17), ch_mask);
+        __m256i val = _mm256_and_si256(w, val_mask);
+        // ch0-3, val0-3 | ch4-7, val4-7 -> ch0-7 | val0-7
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(ch, val), 0xd8);
+        _mm_storeu_si128((__m128i*) &channels[i], _mm256_castsi256_si128(packed));
+        _mm_storeu_si128((__m128i*) &values[i], _mm256_extracti128_si256(packed, 1));
+    }
+
+    return i + unpack_scalar(&words[i], n - i, slot, &channels[i], &values[i]);
+}
+#endif
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadADCUnpacker::PRadADCUnpacker()
+{
+    SetKernel(BestKernel());
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+size_t PRadADCUnpacker::Unpack(const uint32_t *words, size_t n, uint32_t slot,
+                               Staging &out)
+const
+{
+    return kernel(words, std::min<size_t>(n, ADC_UNPACK_BLOCK), slot,
+                  out.channel, out.value);
+}
+
+// choose the kernel, fall back to the best supported one
+void PRadADCUnpacker::SetKernel(KernelType type)
+{
+    KernelType best = BestKernel();
+    if(type > best)
+        type = best;
+
+    ktype = type;
+    switch(type)
+    {
+#ifdef PRAD_X86_SIMD
+    case AVX2: kernel = &unpack_avx2; break;
+#endif
+    default: ktype = Scalar; kernel = &unpack_scalar; break;
+    }
+}
+
+// the best kernel supported by current cpu
+PRadADCUnpacker::KernelType PRadADCUnpacker::BestKernel()
+{
+#ifdef PRAD_X86_SIMD
+    if(__builtin_cpu_supports("avx2"))
+        return AVX2;
+#endif
+    return Scalar;
+}
@@ -0,0 +1,630 @@
+//============================================================================//
+// Export events to the Apache Arrow IPC streaming format                     //
+// The stream is a schema message followed by record batch messages, the      //
+// message metadata are flatbuffers, which are written by a minimal builder   //
+// here, the column buffers are copied into the batch bodies                  //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadArrowWriter.h"
+#include <iostream>
+#include <algorithm>
+#include <deque>
+#include <cstring>
+
+// arrow format constants
+#define ARROW_CONTINUATION 0xffffffff
+#define ARROW_ALIGNMENT 8
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOAT 3
+#define ARROW_TYPE_LIST 12
+#define ARROW_TYPE_STRUCT 13
+#define ARROW_PRECISION_SINGLE 1
+
+
+
+//============================================================================//
+// Flatbuffers builder                                                        //
+//============================================================================//
+
+// an object in the flatbuffer, a table, a string or a vector
+struct FbObject
+{
+    enum Kind {Table, String, Vector, Structs};
+
+    struct Slot
+    {
+        uint16_t id;
+        uint8_t size;
+        uint64_t value;
+        FbObject *child;
+    };
+
+    Kind kind;
+    std::vector<Slot> slots;        // table fields
+    std::vector<char> bytes;        // string or struct data
+    size_t count, align;            // number of structs and their alignment
+    std::vector<FbObject*> elems;   // vector of tables
+
+    FbObject(Kind k) : kind(k), count(0), align(1) {}
+};
+
+// the objects are written front to back, every reference points forward, so
+// the offsets are always positive as flatbuffers requires, and all the values
+// are aligned to their sizes from the buffer beginning
+class FbBuilder
+{
+public:
+    FbObject *Table()
+    {
+        pool.emplace_back(FbObject::Table);
+        return &pool.back();
+    }
+
+    FbObject *String(const std::string &str)
+    {
+        pool.emplace_back(FbObject::String);
+        pool.back().bytes.assign(str.begin(), str.end());
+        return &pool.back();
+    }
+
+    FbObject *Vector(const std::vector<FbObject*> &elems)
+    {
+        pool.emplace_back(FbObject::Vector);
+        pool.back().elems = elems;
+        return &pool.back();
+    }
+
+    FbObject *Structs(const void *data, size_t count, size_t size, size_t align)
+    {
+        pool.emplace_back(FbObject::Structs);
+        const char *ptr = static_cast<const char*>(data);
+        pool.back().bytes.assign(ptr, ptr + count*size);
+        pool.back().count = count;
+        pool.back().align = std::max<size_t>(align, 4);
+        return &pool.back();
+    }
+
+    static void Scalar(FbObject *table, uint16_t id, uint8_t size, uint64_t value)
+    {
+        table->slots.push_back({id, size, value, nullptr});
+    }
+
+    static void Offset(FbObject *table, uint16_t id, FbObject *child)
+    {
+        table->slots.push_back({id, 4, 0, child});
+    }
+
+    // serialize with the root table, padded to the arrow alignment
+    std::vector<char> Finish(FbObject *root)
+    {
+        std::vector<char> buf(sizeof(uint32_t), 0);
+        patch(buf, 0, write(buf, root));
+        pad(buf, ARROW_ALIGNMENT);
+        return buf;
+    }
+
+private:
+    static void pad(std::vector<char> &buf, size_t align)
+    {
+        buf.resize((buf.size() + align - 1)/align*align, 0);
+    }
+
+    template<typename T>
+    static void append(std::vector<char> &buf, T val)
+    {
+        size_t pos = buf.size();
+        buf.resize(pos + sizeof(T));
+        memcpy(&buf[pos], &val, sizeof(T));
+    }
+
+    // forward offset from the position to the object
+    static void patch(std::vector<char> &buf, size_t pos, size_t obj)
+    {
+        uint32_t off = obj - pos;
+        memcpy(&buf[pos], &off, sizeof(off));
+    }
+
+    size_t write(std::vector<char> &buf, FbObject *obj)
+    {
+        switch(obj->kind)
+        {
+        case FbObject::Table: return writeTable(buf, obj);
+        case FbObject::String: return writeString(buf, obj);
+        case FbObject::Vector: return writeVector(buf, obj);
+        case FbObject::Structs: return writeStructs(buf, obj);
+        default: return 0;
+        }
+    }
+
+    size_t writeTable(std::vector<char> &buf, FbObject *obj)
+    {
+        // layout the fields by size, after the vtable offset
+        std::vector<FbObject::Slot> slots = obj->slots;
+        std::stable_sort(slots.begin(), slots.end(),
+                         [] (const FbObject::Slot &a, const FbObject::Slot &b)
+                         {
+                             return a.size > b.size;
+                         });
+
+        uint16_t nfields = 0;
+        for(auto &slot : slots)
+            nfields = std::max<uint16_t>(nfields, slot.id + 1);
+
+        std::vector<uint16_t> fields(nfields, 0);
+        size_t size = sizeof(int32_t);
+        for(auto &slot : slots)
+        {
+            size = (size + slot.size - 1)/slot.size*slot.size;
+            fields[slot.id] = size;
+            size += slot.size;
+        }
+
+        // vtable
+        pad(buf, sizeof(uint16_t));
+        size_t vtable = buf.size();
+        append<uint16_t>(buf, (2 + nfields)*sizeof(uint16_t));
+        append<uint16_t>(buf, size);
+        for(auto &f : fields)
+            append<uint16_t>(buf, f);
+
+        // table, aligned for the largest field
+        pad(buf, ARROW_ALIGNMENT);
+        size_t table = buf.size();
+        buf.resize(table + size, 0);
+        int32_t soffset = table - vtable;
+        memcpy(&buf[table], &soffset, sizeof(soffset));
+        for(auto &slot : slots)
+        {
+            if(!slot.child)
+                memcpy(&buf[table + fields[slot.id]], &slot.value, slot.size);
+        }
+
+        // children after the table
+        for(auto &slot : slots)
+        {
+            if(slot.child) {
+                size_t pos = table + fields[slot.id];
+                patch(buf, pos, write(buf, slot.child));
+            }
+        }
+
+        return table;
+    }
+
+    size_t writeString(std::vector<char> &buf, FbObject *obj)
+    {
+        pad(buf, sizeof(uint32_t));
+        size_t pos = buf.size();
+        append<uint32_t>(buf, obj->bytes.size());
+        buf.insert(buf.end(), obj->bytes.begin(), obj->bytes.end());
+        buf.push_back(0);
+        return pos;
+    }
+
+    size_t writeVector(std::vector<char> &buf, FbObject *obj)
+    {
+        pad(buf, sizeof(uint32_t));
+        size_t pos = buf.size();
+        append<uint32_t>(buf, obj->elems.size());
+        buf.resize(pos + sizeof(uint32_t)*(obj->elems.size() + 1), 0);
+        for(size_t i = 0; i < obj->elems.size(); ++i)
+        {
+            size_t slot = pos + sizeof(uint32_t)*(i + 1);
+            patch(buf, slot, write(buf, obj->elems[i]));
+        }
+        return pos;
+    }
+
+    size_t writeStructs(std::vector<char> &buf, FbObject *obj)
+    {
+        // the structs are aligned, they start after the length
+        while((buf.size() + sizeof(uint32_t))%obj->align)
+            buf.push_back(0);
+        size_t pos = buf.size();
+        append<uint32_t>(buf, obj->count);
+        buf.insert(buf.end(), obj->bytes.begin(), obj->bytes.end());
+        return pos;
+    }
+
+private:
+    std::deque<FbObject> pool;
+};
+
+// flatbuffer of a schema field
+static FbObject *field_object(FbBuilder &fb, const PRadArrowWriter::Field &field)
+{
+    FbObject *type = fb.Table();
+    uint8_t type_id = 0;
+    switch(field.kind)
+    {
+    case PRadArrowWriter::Field::Int:
+        type_id = ARROW_TYPE_INT;
+        FbBuilder::Scalar(type, 0, 4, field.bits);
+        FbBuilder::Scalar(type, 1, 1, field.is_signed);
+        break;
+    case PRadArrowWriter::Field::Float:
+        type_id = ARROW_TYPE_FLOAT;
+        FbBuilder::Scalar(type, 0, 2, ARROW_PRECISION_SINGLE);
+        break;
+    case PRadArrowWriter::Field::List:
+        type_id = ARROW_TYPE_LIST;
+        break;
+    case PRadArrowWriter::Field::Struct:
+        type_id = ARROW_TYPE_STRUCT;
+        break;
+    }
+
+    std::vector<FbObject*> children;
+    for(auto &child : field.children)
+        children.push_back(field_object(fb, child));
+
+    FbObject *obj = fb.Table();
+    FbBuilder::Offset(obj, 0, fb.String(field.name));
+    FbBuilder::Scalar(obj, 1, 1, 0);        // not nullable
+    FbBuilder::Scalar(obj, 2, 1, type_id);
+    FbBuilder::Offset(obj, 3, type);
+    FbBuilder::Offset(obj, 5, fb.Vector(children));
+    return obj;
+}
+
+// flatbuffer of a message
+static std::vector<char> message_buffer(FbBuilder &fb, uint8_t header_type,
+                                        FbObject *header, int64_t body_length)
+{
+    FbObject *msg = fb.Table();
+    FbBuilder::Scalar(msg, 0, 2, ARROW_METADATA_V5);
+    FbBuilder::Scalar(msg, 1, 1, header_type);
+    FbBuilder::Offset(msg, 2, header);
+    FbBuilder::Scalar(msg, 3, 8, body_length);
+    return fb.Finish(msg);
+}
+
+
+
+//============================================================================//
+// Record batch                                                               //
+//============================================================================//
+
+// append a buffer to the body, every buffer is aligned
+void PRadArrowWriter::Batch::AddBuffer(const void *data, size_t size)
+{
+    buffers.push_back(body.size());
+    buffers.push_back(size);
+    if(size) {
+        const char *ptr = static_cast<const char*>(data);
+        body.insert(body.end(), ptr, ptr + size);
+    }
+    body.resize((body.size() + ARROW_ALIGNMENT - 1)/ARROW_ALIGNMENT*ARROW_ALIGNMENT, 0);
+}
+
+// a list column, its values are the following columns
+void PRadArrowWriter::Batch::AddList(const std::vector<int32_t> &offsets)
+{
+    nodes.push_back(offsets.size() - 1);
+    AddBuffer(nullptr, 0);
+    AddBuffer(offsets.data(), offsets.size()*sizeof(int32_t));
+}
+
+// a struct column, its members are the following columns
+void PRadArrowWriter::Batch::AddStruct(int64_t size)
+{
+    nodes.push_back(size);
+    AddBuffer(nullptr, 0);
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadArrowWriter::PRadArrowWriter(uint32_t batch_events)
+: batch_size(batch_events ? batch_events : 1)
+{
+    clearEvents();
+    ep_offsets.assign(1, 0);
+}
+
+PRadArrowWriter::~PRadArrowWriter()
+{
+    Close();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// columns of the events, one list column per bank
+std::vector<PRadArrowWriter::Field> PRadArrowWriter::EventSchema()
+{
+    auto channels = [] (const std::string &name)
+                    {
+                        return Field(name, Field::List,
+                                     {Field("item", Field::Struct,
+                                            {Field("channel_id", Field::Int, 16, false),
+                                             Field("value", Field::Int, 16, false)})});
+                    };
+
+    return {Field("event_number", Field::Int, 32, true),
+            Field("type", Field::Int, 8, false),
+            Field("trigger", Field::Int, 8, false),
+            Field("timestamp", Field::Int, 64, false),
+            channels("adc"),
+            channels("tdc"),
+            Field("gem", Field::List,
+                  {Field("item", Field::Struct,
+                         {Field("fec", Field::Int, 8, false),
+                          Field("adc", Field::Int, 8, false),
+                          Field("strip", Field::Int, 8, false),
+                          Field("values", Field::List, {Field("item", Field::Float)})})}),
+            Field("dsc", Field::List,
+                  {Field("item", Field::Struct,
+                         {Field("gated_count", Field::Int, 32, false),
+                          Field("ungated_count", Field::Int, 32, false)})})};
+}
+
+std::vector<PRadArrowWriter::Field> PRadArrowWriter::EPICSSchema()
+{
+    return {Field("event_number", Field::Int, 32, true),
+            Field("values", Field::List, {Field("item", Field::Float)})};
+}
+
+// open the output streams and write their schemas
+bool PRadArrowWriter::Open(const std::string &event_path, const std::string &epics_path)
+{
+    Close();
+
+    if(!openStream(events, event_path, EventSchema()))
+        return false;
+
+    if(!epics_path.empty() && !openStream(epics, epics_path, EPICSSchema())) {
+        closeStream(events);
+        return false;
+    }
+
+    return true;
+}
+
+// write the last batches and the end of streams
+void PRadArrowWriter::Close()
+{
+    if(events.out.is_open()) {
+        flushEvents();
+        closeStream(events);
+    }
+
+    if(epics.out.is_open()) {
+        flushEPICS();
+        closeStream(epics);
+    }
+}
+
+// add an event to the current batch
+void PRadArrowWriter::Write(const EventData &ev)
+{
+    if(!events.out.is_open())
+        return;
+
+    ev_number.push_back(ev.event_number);
+    ev_type.push_back(ev.type);
+    ev_trigger.push_back(ev.trigger);
+    ev_timestamp.push_back(ev.timestamp);
+
+    for(auto &adc : ev.adc_data)
+    {
+        adc_channel.push_back(adc.channel_id);
+        adc_value.push_back(adc.value);
+    }
+    adc_offsets.push_back(adc_channel.size());
+
+    for(auto &tdc : ev.tdc_data)
+    {
+        tdc_channel.push_back(tdc.channel_id);
+        tdc_value.push_back(tdc.value);
+    }
+    tdc_offsets.push_back(tdc_channel.size());
+
+    for(auto &gem : ev.gem_data)
+    {
+        gem_fec.push_back(gem.addr.fec);
+        gem_adc.push_back(gem.addr.adc);
+        gem_strip.push_back(gem.addr.strip);
+        gem_samples.insert(gem_samples.end(), gem.values, gem.values + gem.nvalues);
+        sample_offsets.push_back(gem_samples.size());
+    }
+    gem_offsets.push_back(gem_fec.size());
+
+    for(auto &dsc : ev.dsc_data)
+    {
+        dsc_gated.push_back(dsc.gated_count);
+        dsc_ungated.push_back(dsc.ungated_count);
+    }
+    dsc_offsets.push_back(dsc_gated.size());
+
+    if(ev_number.size() >= batch_size)
+        flushEvents();
+}
+
+// add an epics event to the current batch
+void PRadArrowWriter::Write(const EpicsData &ep)
+{
+    if(!epics.out.is_open())
+        return;
+
+    ep_number.push_back(ep.event_number);
+    ep_values.insert(ep_values.end(), ep.values.begin(), ep.values.end());
+    ep_offsets.push_back(ep_values.size());
+
+    if(ep_number.size() >= batch_size)
+        flushEPICS();
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+bool PRadArrowWriter::openStream(Stream &s, const std::string &path,
+                                 const std::vector<Field> &schema)
+{
+    s.out.open(path, std::ios::out | std::ios::binary);
+    if(!s.out.is_open()) {
+        std::cerr << "Arrow Writer: Cannot open output file "
+                  << "\"" << path << "\"!"
+                  << std::endl;
+        return false;
+    }
+
+    s.schema = schema;
+    s.batches = 0;
+
+    FbBuilder fb;
+    std::vector<FbObject*> fields;
+    for(auto &field : schema)
+        fields.push_back(field_object(fb, field));
+
+    FbObject *header = fb.Table();
+    FbBuilder::Scalar(header, 0, 2, 0);     // little endian
+    FbBuilder::Offset(header, 1, fb.Vector(fields));
+
+    writeMessage(s, message_buffer(fb, ARROW_HEADER_SCHEMA, header, 0), std::vector<char>());
+    return true;
+}
+
+// end of stream mark
+void PRadArrowWriter::closeStream(Stream &s)
+{
+    uint32_t eos[2] = {ARROW_CONTINUATION, 0};
+    s.out.write((const char*) eos, sizeof(eos));
+    s.out.close();
+}
+
+// encapsulated message, continuation, metadata size, metadata and body
+void PRadArrowWriter::writeMessage(Stream &s, const std::vector<char> &meta,
+                                   const std::vector<char> &body)
+{
+    uint32_t prefix[2] = {ARROW_CONTINUATION, (uint32_t)meta.size()};
+    s.out.write((const char*) prefix, sizeof(prefix));
+    s.out.write(meta.data(), meta.size());
+    s.out.write(body.data(), body.size());
+}
+
+// write the record batch of the buffered events
+void PRadArrowWriter::flushEvents()
+{
+    if(ev_number.empty())
+        return;
+
+    Batch &b = events.batch;
+    b.Clear();
+    b.length = ev_number.size();
+
+    // columns in the order of schema, children follow their parents
+    b.AddColumn(ev_number);
+    b.AddColumn(ev_type);
+    b.AddColumn(ev_trigger);
+    b.AddColumn(ev_timestamp);
+    b.AddList(adc_offsets);
+    b.AddStruct(adc_channel.size());
+    b.AddColumn(adc_channel);
+    b.AddColumn(adc_value);
+    b.AddList(tdc_offsets);
+    b.AddStruct(tdc_channel.size());
+    b.AddColumn(tdc_channel);
+    b.AddColumn(tdc_value);
+    b.AddList(gem_offsets);
+    b.AddStruct(gem_fec.size());
+    b.AddColumn(gem_fec);
+    b.AddColumn(gem_adc);
+    b.AddColumn(gem_strip);
+    b.AddList(sample_offsets);
+    b.AddColumn(gem_samples);
+    b.AddList(dsc_offsets);
+    b.AddStruct(dsc_gated.size());
+    b.AddColumn(dsc_gated);
+    b.AddColumn(dsc_ungated);
+
+    FbBuilder fb;
+    std::vector<int64_t> nodes;
+    for(auto &n : b.nodes)
+    {
+        nodes.push_back(n);
+        nodes.push_back(0);   // null count
+    }
+
+    FbObject *header = fb.Table();
+    FbBuilder::Scalar(header, 0, 8, b.length);
+    FbBuilder::Offset(header, 1, fb.Structs(nodes.data(), b.nodes.size(), 2*sizeof(int64_t), 8));
+    FbBuilder::Offset(header, 2, fb.Structs(b.buffers.data(), b.buffers.size()/2, 2*sizeof(int64_t), 8));
+
+    writeMessage(events, message_buffer(fb, ARROW_HEADER_BATCH, header, b.body.size()), b.body);
+    events.batches++;
+    clearEvents();
+}
+
+// write the record batch of the buffered epics events
+void PRadArrowWriter::flushEPICS()
+{
+    if(ep_number.empty())
+        return;
+
+    Batch &b = epics.batch;
+    b.Clear();
+    b.length = ep_number.size();
+    b.AddColumn(ep_number);
+    b.AddList(ep_offsets);
+    b.AddColumn(ep_values);
+
+    FbBuilder fb;
+    std::vector<int64_t> nodes;
+    for(auto &n : b.nodes)
+    {
+        nodes.push_back(n);
+        nodes.push_back(0);
+    }
+
+    FbObject *header = fb.Table();
+    FbBuilder::Scalar(header, 0, 8, b.length);
+    FbBuilder::Offset(header, 1, fb.Structs(nodes.data(), b.nodes.size(), 2*sizeof(int64_t), 8));
+    FbBuilder::Offset(header, 2, fb.Structs(b.buffers.data(), b.buffers.size()/2, 2*sizeof(int64_t), 8));
+
+    writeMessage(epics, message_buffer(fb, ARROW_HEADER_BATCH, header, b.body.size()), b.body);
+    epics.batches++;
+
+    ep_number.clear();
+    ep_values.clear();
+    ep_offsets.assign(1, 0);
+}
+
+// clear the event columns, the memory is kept for the next batch
+void PRadArrowWriter::clearEvents()
+{
+    ev_number.clear();
+    ev_type.clear();
+    ev_trigger.clear();
+    ev_timestamp.clear();
+    adc_channel.clear();
+    adc_value.clear();
+    tdc_channel.clear();
+    tdc_value.clear();
+    gem_fec.clear();
+    gem_adc.clear();
+    gem_strip.clear();
+    gem_samples.clear();
+    dsc_gated.clear();
+    dsc_ungated.clear();
+    adc_offsets.assign(1, 0);
+    tdc_offsets.assign(1, 0);
+    gem_offsets.assign(1, 0);
+    sample_offsets.assign(1, 0);
+    dsc_offsets.assign(1, 0);
+}
@@ -0,0 +1,806 @@
+//============================================================================//
+// Asynchronous file backend for the evio and dst input/output                //
+// The reads and writes are queued to io_uring with registered buffers, or to //
+// a small pool of pread/pwrite threads if io_uring is not available          //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadAsyncIO.h"
+#include "PRadThreadTopology.h"
+#include <iostream>
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef MULTI_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+#if defined(USE_IO_URING) && defined(__linux__)
+#define ASYNC_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
+// largest transfer of a request, the ring takes 32-bit lengths
+#define ASYNC_IO_MAX_TRANSFER (1UL << 30)
+
+// finish a partial transfer with the blocking calls, return the total bytes or
+// -errno
+static int64_t finish_transfer(bool write, int fd, char *buf, size_t bytes, int64_t offset,
+                               size_t done)
+{
+    while(done < bytes)
+    {
+        ssize_t n = write ? pwrite(fd, buf + done, bytes - done, offset + done)
+                          : pread(fd, buf + done, bytes - done, offset + done);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            return -errno;
+        }
+        // end of file
+        if(n == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+static char *alloc_segment(size_t bytes)
+{
+    char *buf = (char*) PRadThreadTopology::Instance().Allocate(bytes);
+    if(!buf)
+        throw std::bad_alloc();
+    return buf;
+}
+
+
+
+//============================================================================//
+// Kernel ring of io_uring, only the raw system calls are used                //
+//============================================================================//
+
+#ifdef ASYNC_IO_URING
+class PRadAsyncIO::Ring
+{
+public:
+    Ring(unsigned int entries)
+    : fd(-1), sq_ptr(MAP_FAILED), cq_ptr(MAP_FAILED), sqes(nullptr), sq_bytes(0),
+      cq_bytes(0), sqe_bytes(0)
+    {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd = syscall(__NR_io_uring_setup, entries, &p);
+        if(fd < 0)
+            return;
+
+        // the plain read/write operations are required
+        if(!probe()) {
+            release();
+            return;
+        }
+
+        sq_bytes = p.sq_off.array + p.sq_entries*sizeof(unsigned int);
+        cq_bytes = p.cq_off.cqes + p.cq_entries*sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single)
+            sq_bytes = cq_bytes = std::max(sq_bytes, cq_bytes);
+
+        sq_ptr = mmap(nullptr, sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+        if(sq_ptr == MAP_FAILED) {
+            release();
+            return;
+        }
+
+        if(single) {
+            cq_ptr = sq_ptr;
+        } else {
+            cq_ptr = mmap(nullptr, cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_CQ_RING);
+            if(cq_ptr == MAP_FAILED) {
+                release();
+                return;
+            }
+        }
+
+        sqe_bytes = p.sq_entries*sizeof(io_uring_sqe);
+        void *ptr = mmap(nullptr, sqe_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQES);
+        if(ptr == MAP_FAILED) {
+            release();
+            return;
+        }
+        sqes = (io_uring_sqe*) ptr;
+
+        char *sq = (char*) sq_ptr, *cq = (char*) cq_ptr;
+        sq_tail = (unsigned int*) (sq + p.sq_off.tail);
+        sq_mask = (unsigned int*) (sq + p.sq_off.ring_mask);
+        sq_array = (unsigned int*) (sq + p.sq_off.array);
+        cq_head = (unsigned int*) (cq + p.cq_off.head);
+        cq_tail = (unsigned int*) (cq + p.cq_off.tail);
+        cq_mask = (unsigned int*) (cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe*) (cq + p.cq_off.cqes);
+    }
+
+    ~Ring()
+    {
+        release();
+    }
+
+    bool Good() const {return fd >= 0;}
+
+    bool Register(const std::vector<void*> &bufs, size_t bytes)
+    {
+        std::vector<iovec> iovs(bufs.size());
+        for(size_t i = 0; i < bufs.size(); ++i)
+        {
+            iovs[i].iov_base = bufs[i];
+            iovs[i].iov_len = bytes;
+        }
+        // it fails under a small locked memory limit
+        return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                       iovs.data(), iovs.size()) == 0;
+    }
+
+    bool Push(const Request &req, bool fixed)
+    {
+        unsigned int tail = *sq_tail;
+        unsigned int index = tail & *sq_mask;
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        if(fixed) {
+            sqe->opcode = req.write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->buf_index = req.buf_index;
+        } else {
+            sqe->opcode = req.write ? IORING_OP_WRITE : IORING_OP_READ;
+        }
+        sqe->fd = req.fd;
+        sqe->off = req.offset;
+        sqe->addr = (uint64_t) req.buf;
+        sqe->len = std::min(req.bytes, (size_t)ASYNC_IO_MAX_TRANSFER);
+        sqe->user_data = req.tag;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        while(syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0) < 0)
+        {
+            if(errno != EINTR)
+                return false;
+        }
+        return true;
+    }
+
+    bool Pop(Completion &comp)
+    {
+        unsigned int head = *cq_head;
+        while(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        {
+            if(syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+               errno != EINTR)
+                return false;
+        }
+
+        io_uring_cqe *cqe = &cqes[head & *cq_mask];
+        comp.tag = cqe->user_data;
+        comp.result = cqe->res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    bool probe()
+    {
+        const size_t nops = 256;
+        std::vector<char> buf(sizeof(io_uring_probe) + nops*sizeof(io_uring_probe_op), 0);
+        io_uring_probe *p = (io_uring_probe*) buf.data();
+        // the probe is newer than the read/write operations
+        if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, p, nops) < 0)
+            return false;
+
+        auto supported = [p] (unsigned int op)
+                         {
+                             return op <= p->last_op && (p->ops[op].flags & IO_URING_OP_SUPPORTED);
+                         };
+        return supported(IORING_OP_READ) && supported(IORING_OP_WRITE);
+    }
+
+    void release()
+    {
+        if(sqes)
+            munmap(sqes, sqe_bytes);
+        if(cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+            munmap(cq_ptr, cq_bytes);
+        if(sq_ptr != MAP_FAILED)
+            munmap(sq_ptr, sq_bytes);
+        if(fd >= 0)
+            close(fd);
+        fd = -1;
+        sq_ptr = cq_ptr = MAP_FAILED;
+        sqes = nullptr;
+    }
+
+private:
+    int fd;
+    void *sq_ptr, *cq_ptr;
+    io_uring_sqe *sqes;
+    io_uring_cqe *cqes;
+    size_t sq_bytes, cq_bytes, sqe_bytes;
+    unsigned int *sq_tail, *sq_mask, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+};
+#else
+// not built with io_uring
+class PRadAsyncIO::Ring
+{
+public:
+    Ring(unsigned int) {}
+    bool Good() const {return false;}
+    bool Register(const std::vector<void*> &, size_t) {return false;}
+    bool Push(const Request &, bool) {return false;}
+    bool Pop(Completion &) {return false;}
+};
+#endif
+
+
+
+//============================================================================//
+// Threads doing the blocking calls                                           //
+//============================================================================//
+
+#ifdef MULTI_THREAD
+class PRadAsyncIO::Pool
+{
+public:
+    Pool(unsigned int nthreads)
+    : stop(false)
+    {
+        for(unsigned int i = 0; i < nthreads; ++i)
+            threads.emplace_back(&Pool::work, this);
+    }
+
+    ~Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(locker);
+            stop = true;
+        }
+        req_cond.notify_all();
+        for(auto &thread : threads)
+            thread.join();
+    }
+
+    void Push(const Request &req)
+    {
+        {
+            std::lock_guard<std::mutex> lock(locker);
+            requests.push_back(req);
+        }
+        req_cond.notify_one();
+    }
+
+    // it is called with requests in flight
+    void Pop(Completion &comp)
+    {
+        std::unique_lock<std::mutex> lock(locker);
+        done_cond.wait(lock, [this] {return !done.empty();});
+        comp = done.front();
+        done.pop_front();
+    }
+
+private:
+    void work()
+    {
+        while(true)
+        {
+            Request req;
+            {
+                std::unique_lock<std::mutex> lock(locker);
+                req_cond.wait(lock, [this] {return stop || !requests.empty();});
+                if(requests.empty())
+                    return;
+                req = requests.front();
+                requests.pop_front();
+            }
+
+            Completion comp;
+            comp.tag = req.tag;
+            comp.result = PRadAsyncIO::transfer(req);
+
+            {
+                std::lock_guard<std::mutex> lock(locker);
+                done.push_back(comp);
+            }
+            done_cond.notify_one();
+        }
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<Request> requests;
+    std::deque<Completion> done;
+    std::mutex locker;
+    std::condition_variable req_cond, done_cond;
+    bool stop;
+};
+#else
+// no threads, the requests are done at submission
+class PRadAsyncIO::Pool
+{
+public:
+    Pool(unsigned int) {}
+    void Push(const Request &) {}
+    void Pop(Completion &) {}
+};
+#endif
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadAsyncIO::PRadAsyncIO(unsigned int d, Backend prefer)
+: depth(std::max(1u, d)), in_flight(0), backend(Backend_Sync), registered(false)
+{
+    if(prefer == Backend_IOUring) {
+        ring.reset(new Ring(depth));
+        if(ring->Good()) {
+            backend = Backend_IOUring;
+            return;
+        }
+        ring.reset();
+    }
+
+#ifdef MULTI_THREAD
+    if(prefer != Backend_Sync) {
+        pool.reset(new Pool(std::min(depth, (unsigned int)ASYNC_IO_THREADS)));
+        backend = Backend_Threads;
+    }
+#endif
+}
+
+// the pool threads and the ring should have no pending requests
+PRadAsyncIO::~PRadAsyncIO()
+{
+    Completion comp;
+    while(in_flight && reap(comp)) {}
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+bool PRadAsyncIO::RegisterBuffers(const std::vector<void*> &bufs, size_t bytes)
+{
+    if(backend != Backend_IOUring || registered || InFlight() || bufs.empty())
+        return false;
+
+    registered = ring->Register(bufs, bytes);
+    return registered;
+}
+
+bool PRadAsyncIO::SubmitRead(int fd, void *buf, size_t bytes, int64_t offset, uint64_t tag,
+                             int buf_index)
+{
+    return submit(Request{false, fd, buf, bytes, offset, tag, buf_index});
+}
+
+bool PRadAsyncIO::SubmitWrite(int fd, const void *buf, size_t bytes, int64_t offset,
+                              uint64_t tag, int buf_index)
+{
+    return submit(Request{true, fd, const_cast<void*>(buf), bytes, offset, tag, buf_index});
+}
+
+bool PRadAsyncIO::Wait(Completion &comp)
+{
+    if(!kept.empty()) {
+        comp = kept.front();
+        kept.pop_front();
+        return true;
+    }
+
+    if(!in_flight)
+        return false;
+
+    return reap(comp);
+}
+
+const char *PRadAsyncIO::BackendName(Backend b)
+{
+    switch(b)
+    {
+    case Backend_IOUring: return "io_uring";
+    case Backend_Threads: return "threads";
+    default: return "sync";
+    }
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+bool PRadAsyncIO::submit(const Request &req)
+{
+    if(backend == Backend_Sync) {
+        kept.push_back(Completion{req.tag, transfer(req)});
+        return true;
+    }
+
+    // make room for the request, the completions are kept in order
+    while(in_flight >= depth)
+    {
+        Completion comp;
+        if(!reap(comp))
+            return false;
+        kept.push_back(comp);
+    }
+
+    if(backend == Backend_IOUring) {
+        if(!ring->Push(req, registered && req.buf_index >= 0)) {
+            std::cerr << "PRad Async IO Error: Failed to submit the request to io_uring ("
+                      << strerror(errno) << ")." << std::endl;
+            return false;
+        }
+    } else {
+        pool->Push(req);
+    }
+
+    in_flight++;
+    return true;
+}
+
+bool PRadAsyncIO::reap(Completion &comp)
+{
+    if(backend == Backend_IOUring) {
+        if(!ring->Pop(comp)) {
+            std::cerr << "PRad Async IO Error: Failed to wait for io_uring ("
+                      << strerror(errno) << ")." << std::endl;
+            return false;
+        }
+    } else {
+        pool->Pop(comp);
+    }
+
+    in_flight--;
+    return true;
+}
+
+// a complete blocking transfer
+int64_t PRadAsyncIO::transfer(const Request &req)
+{
+    return finish_transfer(req.write, req.fd, (char*) req.buf, req.bytes, req.offset, 0);
+}
+
+
+
+//============================================================================//
+// Sequential reader                                                          //
+//============================================================================//
+
+PRadAsyncReader::PRadAsyncReader(unsigned int depth, size_t segment)
+: io(depth), seg_size(segment), fd(-1), size(0), pos(0), next_offset(0), head(0), good(false)
+{
+    std::vector<void*> bufs;
+    segs.resize(io.GetDepth());
+    for(auto &seg : segs)
+    {
+        seg = Segment{alloc_segment(seg_size), 0, 0, 0, 0, false};
+        bufs.push_back(seg.data);
+    }
+    io.RegisterBuffers(bufs, seg_size);
+}
+
+PRadAsyncReader::~PRadAsyncReader()
+{
+    Close();
+
+    for(auto &seg : segs)
+        PRadThreadTopology::Instance().Free(seg.data, seg_size);
+}
+
+bool PRadAsyncReader::Open(const std::string &path)
+{
+    Close();
+
+    fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat fs;
+    if(fstat(fd, &fs) < 0) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    size = fs.st_size;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    // nothing from the last file is kept
+    for(auto &seg : segs)
+        seg.offset = seg.request = seg.length = seg.cursor = 0;
+    good = true;
+    Seek(0);
+    return true;
+}
+
+void PRadAsyncReader::Close()
+{
+    if(fd < 0)
+        return;
+
+    drain();
+    close(fd);
+    fd = -1;
+}
+
+// the segments are read in turn from the offset, a position in the current
+// segment does not restart the reading
+void PRadAsyncReader::Seek(int64_t offset)
+{
+    if(fd < 0)
+        return;
+
+    Segment &cur = segs[head];
+    if(good && offset >= cur.offset && offset < cur.offset + (int64_t)cur.request) {
+        while(cur.busy)
+        {
+            PRadAsyncIO::Completion comp;
+            if(!io.Wait(comp))
+                break;
+            complete(comp);
+        }
+        if(!cur.busy && offset < cur.offset + (int64_t)cur.length) {
+            cur.cursor = offset - cur.offset;
+            pos = offset;
+            return;
+        }
+    }
+
+    drain();
+    pos = next_offset = std::max((int64_t)0, offset);
+    head = 0;
+    good = true;
+    for(size_t i = 0; i < segs.size(); ++i)
+        issue(i);
+}
+
+size_t PRadAsyncReader::Read(void *buf, size_t bytes)
+{
+    char *dst = (char*) buf;
+    size_t copied = 0;
+
+    while(copied < bytes && fd >= 0)
+    {
+        Segment &seg = segs[head];
+        while(seg.busy)
+        {
+            PRadAsyncIO::Completion comp;
+            if(!io.Wait(comp)) {
+                good = false;
+                return copied;
+            }
+            complete(comp);
+        }
+
+        size_t avail = seg.length - seg.cursor;
+        if(!avail) {
+            // end of file, or the reading stopped at a failure
+            if(!seg.request || seg.length < seg.request)
+                break;
+            issue(head);
+            head = (head + 1)%segs.size();
+            continue;
+        }
+
+        size_t n = std::min(avail, bytes - copied);
+        memcpy(dst + copied, seg.data + seg.cursor, n);
+        seg.cursor += n;
+        copied += n;
+        pos += n;
+    }
+
+    return copied;
+}
+
+// read the segment after the issued ones
+void PRadAsyncReader::issue(size_t index)
+{
+    Segment &seg = segs[index];
+    seg.offset = next_offset;
+    seg.cursor = seg.length = seg.request = 0;
+    seg.busy = false;
+    if(next_offset >= size || !good)
+        return;
+
+    seg.request = std::min((int64_t)seg_size, size - next_offset);
+    next_offset += seg.request;
+    seg.busy = io.SubmitRead(fd, seg.data, seg.request, seg.offset, index,
+                             io.HasRegisteredBuffers() ? index : -1);
+    if(!seg.busy)
+        good = false;
+}
+
+void PRadAsyncReader::complete(const PRadAsyncIO::Completion &comp)
+{
+    Segment &seg = segs[comp.tag];
+    seg.busy = false;
+
+    int64_t result = comp.result;
+    if(result >= 0 && (size_t)result < seg.request)
+        result = finish_transfer(false, fd, seg.data, seg.request, seg.offset, result);
+
+    if(result < 0) {
+        std::cerr << "PRad Async IO Error: Failed to read at offset " << seg.offset
+                  << " (" << strerror(-result) << ")." << std::endl;
+        result = 0;
+    }
+
+    seg.length = result;
+    if(seg.length < seg.request)
+        good = false;
+}
+
+void PRadAsyncReader::drain()
+{
+    PRadAsyncIO::Completion comp;
+    while(io.Wait(comp))
+        complete(comp);
+}
+
+
+
+//============================================================================//
+// Sequential writer                                                          //
+//============================================================================//
+
+PRadAsyncWriter::PRadAsyncWriter(unsigned int depth, size_t segment)
+: io(depth), seg_size(segment), fd(-1), offset(0), current(0), good(false)
+{
+    std::vector<void*> bufs;
+    segs.resize(io.GetDepth());
+    for(auto &seg : segs)
+    {
+        seg = Segment{alloc_segment(seg_size), 0, 0, false};
+        bufs.push_back(seg.data);
+    }
+    io.RegisterBuffers(bufs, seg_size);
+}
+
+PRadAsyncWriter::~PRadAsyncWriter()
+{
+    Close();
+
+    for(auto &seg : segs)
+        PRadThreadTopology::Instance().Free(seg.data, seg_size);
+}
+
+bool PRadAsyncWriter::Open(const std::string &path, bool truncate, int64_t off)
+{
+    Close();
+
+    int flags = O_WRONLY | O_CREAT;
+    if(truncate)
+        flags |= O_TRUNC;
+    fd = open(path.c_str(), flags, 0644);
+    if(fd < 0)
+        return false;
+
+    offset = truncate ? 0 : off;
+    current = 0;
+    for(auto &seg : segs)
+        seg.length = 0;
+    good = true;
+    return true;
+}
+
+bool PRadAsyncWriter::Close()
+{
+    if(fd < 0)
+        return good;
+
+    Flush();
+    if(close(fd) < 0)
+        good = false;
+    fd = -1;
+    return good;
+}
+
+bool PRadAsyncWriter::Write(const void *buf, size_t bytes)
+{
+    if(fd < 0)
+        return false;
+
+    const char *src = (const char*) buf;
+    while(bytes)
+    {
+        Segment &seg = segs[current];
+        size_t n = std::min(seg_size - seg.length, bytes);
+        memcpy(seg.data + seg.length, src, n);
+        seg.length += n;
+        src += n;
+        bytes -= n;
+
+        if(seg.length == seg_size)
+            submit();
+    }
+
+    return good;
+}
+
+bool PRadAsyncWriter::Flush()
+{
+    if(fd < 0)
+        return good;
+
+    submit();
+
+    PRadAsyncIO::Completion comp;
+    while(io.Wait(comp))
+        complete(comp);
+
+    return good;
+}
+
+// write the current segment, and wait for the next one if it is still written
+void PRadAsyncWriter::submit()
+{
+    Segment &seg = segs[current];
+    if(!seg.length)
+        return;
+
+    seg.offset = offset;
+    seg.busy = io.SubmitWrite(fd, seg.data, seg.length, seg.offset, current,
+                              io.HasRegisteredBuffers() ? current : -1);
+    if(!seg.busy)
+        good = false;
+    offset += seg.length;
+
+    current = (current + 1)%segs.size();
+    Segment &next = segs[current];
+    while(next.busy)
+    {
+        PRadAsyncIO::Completion comp;
+        if(!io.Wait(comp)) {
+            good = false;
+            next.busy = false;
+            break;
+        }
+        complete(comp);
+    }
+    next.length = 0;
+}
+
+void PRadAsyncWriter::complete(const PRadAsyncIO::Completion &comp)
+{
+    Segment &seg = segs[comp.tag];
+    seg.busy = false;
+
+    int64_t result = comp.result;
+    if(result >= 0 && (size_t)result < seg.length)
+        result = finish_transfer(true, fd, seg.data, seg.length, seg.offset, result);
+
+    if(result < 0 || (size_t)result < seg.length) {
+        std::cerr << "PRad Async IO Error: Failed to write at offset " << seg.offset;
+        if(result < 0)
+            std::cerr << " (" << strerror(-result) << ")";
+        std::cerr << "." << std::endl;
+        good = false;
+    }
+}
@@ -0,0 +1,283 @@
+//============================================================================//
+// Binary cache of the run dependent constants                                //
+// The calibration file and run information file of a run are parsed once,    //
+// and saved as fixed size records, the cache file is mapped into memory the  //
+// next time the run is chosen, as long as the source files are not changed   //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadCalibCache.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+static const char cache_magic[8] = {'P', 'R', 'A', 'D', 'C', 'A', 'L', '\0'};
+
+// FNV-1a hash, it does not depend on the standard library implementation
+inline uint64_t path_hash(const std::string &path)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(auto c : path)
+    {
+        hash ^= (unsigned char) c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// copy the name to a fixed size array, false if it is too long
+inline bool copy_name(char *dst, const std::string &name)
+{
+    if(name.size() >= CALIB_CACHE_NAME)
+        return false;
+    memset(dst, 0, CALIB_CACHE_NAME);
+    memcpy(dst, name.data(), name.size());
+    return true;
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadCalibCache::PRadCalibCache(int r)
+: addr(nullptr), length(0)
+{
+    Reset(r);
+}
+
+PRadCalibCache::~PRadCalibCache()
+{
+    Close();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// clear the records for a new run
+void PRadCalibCache::Reset(int r)
+{
+    Close();
+
+    run = r;
+    valid = true;
+    calib_read = false;
+    info_read = false;
+    memset(&ref_gains, 0, sizeof(ref_gains));
+    calib_buf.clear();
+    status_buf.clear();
+    calib = calib_buf.data();
+    status = status_buf.data();
+    ncalib = 0;
+    nstatus = 0;
+}
+
+// record a calibration entry, the cache becomes invalid if it cannot be saved
+void PRadCalibCache::AddCalib(const std::string &name, double factor, double energy, double nl,
+                              const std::vector<double> &gains)
+{
+    CalibEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    if(!copy_name(entry.name, name) || gains.size() > CALIB_CACHE_GAINS) {
+        valid = false;
+        return;
+    }
+
+    entry.ngains = gains.size();
+    entry.factor = factor;
+    entry.energy = energy;
+    entry.non_linear = nl;
+    std::copy(gains.begin(), gains.end(), entry.gains);
+
+    calib_buf.push_back(entry);
+    calib = calib_buf.data();
+    ncalib = calib_buf.size();
+}
+
+// record the reference gains
+void PRadCalibCache::SetRefGains(unsigned int ref, const std::vector<double> &gains)
+{
+    if(gains.size() > CALIB_CACHE_GAINS) {
+        valid = false;
+        return;
+    }
+
+    memset(&ref_gains, 0, sizeof(ref_gains));
+    ref_gains.ref = ref;
+    ref_gains.ngains = gains.size();
+    std::copy(gains.begin(), gains.end(), ref_gains.gains);
+}
+
+// record a status entry
+void PRadCalibCache::AddStatus(const std::string &name, double ped_mean, double ped_sigma,
+                               double lms_mean, double lms_sigma, unsigned int st)
+{
+    StatusEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    if(!copy_name(entry.name, name)) {
+        valid = false;
+        return;
+    }
+
+    entry.status = st;
+    entry.ped_mean = ped_mean;
+    entry.ped_sigma = ped_sigma;
+    entry.lms_mean = lms_mean;
+    entry.lms_sigma = lms_sigma;
+
+    status_buf.push_back(entry);
+    status = status_buf.data();
+    nstatus = status_buf.size();
+}
+
+// save the records to the cache file, it is written to a temporary file first
+// so the other processes never see an incomplete cache
+bool PRadCalibCache::Save(const std::string &path, const std::string &calib_src,
+                          const std::string &info_src)
+const
+{
+    if(!valid)
+        return false;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = CALIB_CACHE_VERSION;
+    header.run = run;
+    header.calib_src = GetStamp(calib_src);
+    header.info_src = GetStamp(info_src);
+    header.calib_read = calib_read;
+    header.info_read = info_read;
+    header.ncalib = ncalib;
+    header.nstatus = nstatus;
+    header.ref_gains = ref_gains;
+
+    // create the folder if it does not exist
+    size_t pos = path.find_last_of('/');
+    if(pos != std::string::npos && pos > 0)
+        mkdir(path.substr(0, pos).c_str(), 0755);
+
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << "PRad Calib Cache Warning: Cannot write cache file "
+                  << "\"" << tmp_path << "\"."
+                  << std::endl;
+        return false;
+    }
+
+    out.write((const char*) &header, sizeof(header));
+    out.write((const char*) calib, ncalib*sizeof(CalibEntry));
+    out.write((const char*) status, nstatus*sizeof(StatusEntry));
+    out.close();
+
+    if(!out || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "PRad Calib Cache Warning: Failed to save cache file "
+                  << "\"" << path << "\"."
+                  << std::endl;
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// map the cache file, false if it does not exist or its sources are changed
+bool PRadCalibCache::Load(const std::string &path, int r, const std::string &calib_src,
+                          const std::string &info_src)
+{
+    Reset(r);
+    valid = false;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat fs;
+    if(fstat(fd, &fs) < 0 || (size_t)fs.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = fs.st_size;
+    void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED)
+        return false;
+
+    addr = (const char*) ptr;
+    length = size;
+
+    Header header;
+    memcpy(&header, addr, sizeof(header));
+    if(memcmp(header.magic, cache_magic, sizeof(cache_magic)) ||
+       header.version != CALIB_CACHE_VERSION ||
+       header.run != r ||
+       header.calib_src != GetStamp(calib_src) ||
+       header.info_src != GetStamp(info_src) ||
+       length != sizeof(Header) + header.ncalib*sizeof(CalibEntry)
+                 + header.nstatus*sizeof(StatusEntry)) {
+        Close();
+        return false;
+    }
+
+    // the records are used in place
+    valid = true;
+    calib_read = header.calib_read;
+    info_read = header.info_read;
+    ref_gains = header.ref_gains;
+    ncalib = header.ncalib;
+    nstatus = header.nstatus;
+    calib = (const CalibEntry*) (addr + sizeof(Header));
+    status = (const StatusEntry*) (addr + sizeof(Header) + ncalib*sizeof(CalibEntry));
+    return true;
+}
+
+// unmap the file
+void PRadCalibCache::Close()
+{
+    if(addr)
+        munmap((void*) addr, length);
+
+    addr = nullptr;
+    length = 0;
+    valid = false;
+    calib = nullptr;
+    status = nullptr;
+    ncalib = 0;
+    nstatus = 0;
+}
+
+// identification of the file from its path, size and modification time
+PRadCalibCache::Stamp PRadCalibCache::GetStamp(const std::string &path)
+{
+    Stamp stamp;
+    stamp.path_hash = path_hash(path);
+    stamp.size = -1;
+    stamp.mtime = 0;
+
+    struct stat fs;
+    if(!path.empty() && stat(path.c_str(), &fs) == 0) {
+        stamp.size = fs.st_size;
+        stamp.mtime = fs.st_mtime;
+    }
+    return stamp;
+}
+
+// name from the fixed size array
+std::string PRadCalibCache::GetName(const char *name)
+{
+    return std::string(name, strnlen(name, CALIB_CACHE_NAME));
+}
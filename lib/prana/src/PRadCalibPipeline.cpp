@@ -0,0 +1,461 @@
+//============================================================================//
+// A pipeline that analyzes DST files in parallel for the calibration         //
+// The files are divided into ranges of events, the workers take the ranges   //
+// and reconstruct them in batches with their own copies of the systems.      //
+// The analyzers of the workers fill their own histograms, and they are       //
+// merged back to the analyzer of the pipeline at the end                     //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadCalibPipeline.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadDetMatch.h"
+#include "PRadDSTReader.h"
+#include "PRadBenchMark.h"
+#include "PRadProfiler.h"
+#include "ConfigParser.h"
+#ifndef PRAD_NO_ROOT
+#include "TH1.h"
+#endif
+#include <iostream>
+#include <algorithm>
+
+#ifdef MULTI_THREAD
+#include <thread>
+#endif
+
+
+
+//============================================================================//
+// Calibration Analyzer                                                       //
+//============================================================================//
+
+PRadCalibAnalyzer::~PRadCalibAnalyzer()
+{
+#ifndef PRAD_NO_ROOT
+    for(auto &hist : hists)
+        delete hist;
+#endif
+}
+
+// add the histograms booked in the same order
+void PRadCalibAnalyzer::Merge(const PRadCalibAnalyzer &that)
+{
+    if(that.hists.size() != hists.size()) {
+        std::cerr << "PRad Calib Analyzer Error: Cannot merge analyzers with "
+                  << that.hists.size() << " and " << hists.size()
+                  << " histograms." << std::endl;
+        return;
+    }
+
+#ifndef PRAD_NO_ROOT
+    for(size_t i = 0; i < hists.size(); ++i)
+    {
+        if(hists[i] && that.hists[i])
+            hists[i]->Add(that.hists[i]);
+    }
+#endif
+}
+
+void PRadCalibAnalyzer::bookHist(TH1 *hist)
+{
+#ifndef PRAD_NO_ROOT
+    if(hist)
+        hist->SetDirectory(nullptr);
+#endif
+    hists.push_back(hist);
+}
+
+
+
+//============================================================================//
+// Worker                                                                     //
+//============================================================================//
+
+// copy the systems and clone the analyzer in the pipeline thread
+PRadCalibPipeline::Worker::Worker(const PRadCalibPipeline &pipeline, const PRadCalibAnalyzer &ana)
+: hycal(nullptr), gem(nullptr), analyzer(ana.Clone()), file(-1), count(0)
+{
+    // the copies start with empty histograms and data
+    hycal = new PRadHyCalSystem(*pipeline.hycal_sys);
+    hycal->SetInfoCenter(&info);
+    hycal->Reset();
+
+    if(pipeline.gem_sys) {
+        gem = new PRadGEMSystem(*pipeline.gem_sys);
+        gem->Reset();
+        // the workers are already in parallel
+        gem->SetAPVThreads(1);
+    }
+
+    if(pipeline.coord_sys)
+        coord = *pipeline.coord_sys;
+
+    event.hycal_sys = hycal;
+}
+
+PRadCalibPipeline::Worker::~Worker()
+{
+    delete hycal;
+    delete gem;
+    delete analyzer;
+}
+
+
+
+//============================================================================//
+// Input                                                                      //
+//============================================================================//
+
+// the last epics event before the event number
+const EpicsData *PRadCalibPipeline::Input::FindEPICS(int event_number)
+const
+{
+    auto it = std::upper_bound(epics.begin(), epics.end(), event_number,
+                               [] (int ev, const EpicsData &ep)
+                               {
+                                   return ev < ep.event_number;
+                               });
+    return (it == epics.begin()) ? nullptr : &*(it - 1);
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadCalibPipeline::PRadCalibPipeline(unsigned int nthreads)
+: hycal_sys(nullptr), gem_sys(nullptr), coord_sys(nullptr), det_match(nullptr),
+  unit_events(CALIB_UNIT_EVENTS), trigger_mask(0), next_unit(0), done_units(0)
+{
+    SetThreads(nthreads);
+}
+
+PRadCalibPipeline::~PRadCalibPipeline()
+{
+    closeInputs();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// set number of workers, 0 means using all the hardware threads
+void PRadCalibPipeline::SetThreads(unsigned int n)
+{
+#ifdef MULTI_THREAD
+    if(n == 0)
+        n = std::thread::hardware_concurrency();
+    threads = (n > 0) ? n : 1;
+#else
+    // no threads at all, the units are processed one by one
+    (void) n;
+    threads = 1;
+#endif
+}
+
+// create workers and process the files, the results of their analyzers are
+// merged to the given one in the order of workers
+int PRadCalibPipeline::Process(const std::vector<std::string> &files, PRadCalibAnalyzer *analyzer)
+{
+    if(!hycal_sys || !analyzer) {
+        std::cerr << "Calib Pipeline Error: HyCal system and analyzer are required."
+                  << std::endl;
+        return 0;
+    }
+
+    PRadBenchMark timer;
+
+    if(!openInputs(files)) {
+        closeInputs();
+        return 0;
+    }
+
+    // the run files of the inputs are read ahead once, the workers switch runs
+    // from the shared cache
+    std::vector<int> runs;
+    for(auto &input : inputs)
+    {
+        int run = ConfigParser::find_integer(ConfigParser::decompose_path(input.reader->GetPath()).name);
+        if(run > 0 && std::find(runs.begin(), runs.end(), run) == runs.end())
+            runs.push_back(run);
+    }
+    if(!runs.empty())
+        hycal_sys->PrefetchRuns(runs);
+
+    unsigned int nworkers = std::max<size_t>(1, std::min<size_t>(threads, units.size()));
+
+    std::cout << "Calib Pipeline: Processing " << inputs.size() << " files in "
+              << units.size() << " units with " << nworkers << " workers."
+              << std::endl;
+
+    // systems are copied and analyzers are cloned in this thread
+    std::vector<Worker*> workers;
+    for(unsigned int i = 0; i < nworkers; ++i)
+    {
+        workers.push_back(new Worker(*this, *analyzer));
+    }
+
+    next_unit = 0;
+    done_units = 0;
+
+#ifdef MULTI_THREAD
+    std::vector<std::thread> worker_threads;
+    for(auto &worker : workers)
+    {
+        worker_threads.emplace_back(&PRadCalibPipeline::work, this, worker);
+    }
+
+    for(auto &thread : worker_threads)
+        thread.join();
+#else
+    for(auto &worker : workers)
+        work(worker);
+#endif
+
+    int count = 0;
+    for(auto &worker : workers)
+    {
+        analyzer->Merge(*worker->analyzer);
+        count += worker->count;
+        delete worker;
+    }
+    analyzer->Finish();
+
+    closeInputs();
+
+    std::cout << std::endl
+              << "Calib Pipeline: Done, took "
+              << timer.GetElapsedTime()/1000. << " s! "
+              << "Processed " << count << " events."
+              << std::endl;
+
+    return count;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// map the files, read their epics events and divide them into units
+bool PRadCalibPipeline::openInputs(const std::vector<std::string> &files)
+{
+    closeInputs();
+
+    for(auto &path : files)
+    {
+        PRadDSTReader *reader = new PRadDSTReader();
+        if(!reader->Open(path)) {
+            std::cerr << "Calib Pipeline Error: Cannot open file "
+                      << "\"" << path << "\", skipped it." << std::endl;
+            delete reader;
+            continue;
+        }
+
+        inputs.emplace_back();
+        Input &input = inputs.back();
+        input.reader = reader;
+        input.epics.resize(reader->GetEPICSCount());
+        for(size_t i = 0; i < input.epics.size(); ++i)
+            reader->GetEPICS(i, input.epics[i]);
+        std::stable_sort(input.epics.begin(), input.epics.end(),
+                         [] (const EpicsData &a, const EpicsData &b)
+                         {
+                             return a.event_number < b.event_number;
+                         });
+
+        int file = inputs.size() - 1;
+        if(reader->IsChunked()) {
+            // the units are on the chunk boundaries
+            size_t nchunks = reader->GetChunkCount(), beg = 0;
+            for(size_t c = 1; c <= nchunks; ++c)
+            {
+                if(c == nchunks ||
+                   reader->GetChunkFirst(c) - reader->GetChunkFirst(beg) >= unit_events) {
+                    units.push_back(Unit{file, beg, c});
+                    beg = c;
+                }
+            }
+        } else {
+            size_t nevents = reader->GetEventCount();
+            for(size_t beg = 0; beg < nevents; beg += unit_events)
+                units.push_back(Unit{file, beg, std::min(beg + unit_events, nevents)});
+        }
+    }
+
+    if(units.empty()) {
+        std::cerr << "Calib Pipeline Error: No events to process." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void PRadCalibPipeline::closeInputs()
+{
+    for(auto &input : inputs)
+        delete input.reader;
+    inputs.clear();
+    units.clear();
+}
+
+// take the units one by one until all of them are taken
+void PRadCalibPipeline::work(Worker *worker)
+{
+    while(true)
+    {
+        size_t u = next_unit.fetch_add(1);
+        if(u >= units.size())
+            break;
+
+        const Unit &unit = units[u];
+        const Input &input = inputs[unit.file];
+        chooseFile(worker, unit.file);
+
+        if(input.reader->IsChunked()) {
+            for(size_t c = unit.begin; c < unit.end; ++c)
+                analyze(worker, input, readChunk(worker, input, c));
+        } else {
+            for(size_t beg = unit.begin; beg < unit.end; beg += CALIB_BATCH_EVENTS)
+            {
+                size_t end = std::min<size_t>(beg + CALIB_BATCH_EVENTS, unit.end);
+                analyze(worker, input, readEvents(worker, input, beg, end));
+            }
+        }
+
+        report(worker->count);
+    }
+}
+
+// update the run dependent constants and coordinates of the worker
+void PRadCalibPipeline::chooseFile(Worker *worker, int file)
+{
+    if(worker->file == file)
+        return;
+
+    worker->file = file;
+    worker->hycal->ChooseRun(inputs[file].reader->GetPath(), false);
+    if(coord_sys)
+        worker->coord.ChooseCoord(worker->info.RunNumber());
+    worker->event.run = worker->info.RunNumber();
+}
+
+// read the accepted events to the beginning of the worker buffer, the memory
+// of events is reused, return the number of accepted events
+size_t PRadCalibPipeline::readEvents(Worker *worker, const Input &input, size_t begin, size_t end)
+{
+    auto &events = worker->events;
+    if(events.size() < end - begin)
+        events.resize(end - begin);
+
+    size_t n = 0;
+    for(size_t i = begin; i < end; ++i)
+    {
+        if(input.reader->GetEvent(i, events[n]) && accept(events[n]))
+            n++;
+    }
+    return n;
+}
+
+size_t PRadCalibPipeline::readChunk(Worker *worker, const Input &input, size_t chunk)
+{
+    auto &events = worker->events;
+    if(!input.reader->GetChunk(chunk, events))
+        return 0;
+
+    size_t n = 0;
+    for(size_t i = 0; i < events.size(); ++i)
+    {
+        if(!accept(events[i]))
+            continue;
+        if(i != n)
+            std::swap(events[n], events[i]);
+        n++;
+    }
+    return n;
+}
+
+// reconstruct the events in batch, and hand them to the analyzer one by one
+void PRadCalibPipeline::analyze(Worker *worker, const Input &input, size_t n)
+{
+    PRAD_PROFILE_SCOPE("CalibPipeline::Analyze");
+
+    if(!n)
+        return;
+
+    if(worker->hycal_hits.size() < n)
+        worker->hycal_hits.resize(n);
+    if(worker->gem_hits.size() < n)
+        worker->gem_hits.resize(n);
+
+    // the workers are already in parallel
+    worker->hycal->ReconstructBatch(&worker->events[0], n, &worker->hycal_hits[0], 1);
+    if(worker->gem)
+        worker->gem->ReconstructBatch(&worker->events[0], n, &worker->gem_hits[0], 1);
+
+    CalibEvent &event = worker->event;
+    const PRadCoordSystem &coord = worker->coord;
+    for(size_t i = 0; i < n; ++i)
+    {
+        event.event = &worker->events[i];
+        event.epics = input.FindEPICS(event.event->event_number);
+
+        // the containers are swapped so their memory goes around
+        auto &hycal_hits = event.hycal_hits;
+        hycal_hits.swap(worker->hycal_hits[i]);
+
+        event.gem1_hits.clear();
+        event.gem2_hits.clear();
+        for(auto &hit : worker->gem_hits[i])
+        {
+            if(hit.det_id == PRadDetector::PRadGEM1)
+                event.gem1_hits.push_back(hit);
+            else if(hit.det_id == PRadDetector::PRadGEM2)
+                event.gem2_hits.push_back(hit);
+        }
+
+        // transform coordinates to beam frame
+        coord.Transform(PRadDetector::HyCal, hycal_hits.begin(), hycal_hits.end());
+        coord.Transform(PRadDetector::PRadGEM1, event.gem1_hits.begin(), event.gem1_hits.end());
+        coord.Transform(PRadDetector::PRadGEM2, event.gem2_hits.begin(), event.gem2_hits.end());
+
+        // projection from target to hycal surface
+        coord.Projection(hycal_hits.begin(), hycal_hits.end());
+        coord.Projection(event.gem1_hits.begin(), event.gem1_hits.end());
+        coord.Projection(event.gem2_hits.begin(), event.gem2_hits.end());
+
+        if(det_match)
+            event.matched = det_match->Match(hycal_hits, event.gem1_hits, event.gem2_hits);
+        else
+            event.matched.clear();
+
+        worker->analyzer->Process(event);
+        worker->count++;
+    }
+}
+
+bool PRadCalibPipeline::accept(const EventData &event)
+const
+{
+    if(!event.is_physics_event())
+        return false;
+    return !trigger_mask || (trigger_mask & PRadEvioParser::trigger_to_bit((PRadTriggerType)event.trigger));
+}
+
+// progress of the units
+void PRadCalibPipeline::report(int count)
+{
+    size_t done = ++done_units;
+
+    std::lock_guard<std::mutex> lock(print_locker);
+    std::cout << "------[ unit " << done << "/" << units.size() << " ]---"
+              << "---[ worker ev " << count << " ]------"
+              << "\r" << std::flush;
+}
@@ -0,0 +1,89 @@
+//============================================================================//
+// Calibration snapshot, an immutable copy of the run dependent calibration   //
+// of HyCal system, it can be shared by the threads reconstructing the events //
+// while the system is switching runs                                         //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadCalibSnapshot.h"
+#include "PRadHyCalSystem.h"
+#include "PRadInfoCenter.h"
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+// copy the calibration of the current run from system
+PRadCalibSnapshot::PRadCalibSnapshot(const PRadHyCalSystem &sys)
+: run(sys.GetInfoCenter()->RunNumber()),
+  density_set(sys.GetReconstructor()->GetDensitySet()), detector(sys.GetDetector())
+{
+    // modules
+    auto det = sys.GetDetector();
+    if(det) {
+        auto &modules = det->GetModuleList();
+        factor.reserve(modules.size());
+        base_energy.reserve(modules.size());
+        non_linear.reserve(modules.size());
+        trg_const.reserve(modules.size());
+        for(auto module : modules)
+        {
+            auto &cal = module->GetCalibConst();
+            factor.push_back(cal.GetCalibConst());
+            base_energy.push_back(cal.GetCalibEnergy());
+            non_linear.push_back(cal.GetNonLinearFactor());
+            trg_const.push_back(module->GetTriggerConst());
+        }
+    }
+
+    // adc channels, the list is indexed by channel id, the flat arrays have
+    // an extra entry for the channels out of range
+    auto &adcs = sys.GetADCList();
+    ch_module.assign(adcs.size(), nullptr);
+    ch_index.assign(adcs.size(), -1);
+    ped_mean.assign(adcs.size() + 1, 0.);
+    ped_sigma.assign(adcs.size(), 0.);
+    ch_dead.assign(adcs.size(), 0);
+    ch_factor.assign(adcs.size() + 1, 0.);
+    ch_type.assign(adcs.size() + 1, PRadHyCalModule::Max_Types);
+    ch_id.assign(adcs.size() + 1, 0);
+    for(size_t i = 0; i < adcs.size(); ++i)
+    {
+        auto adc = adcs[i];
+        ped_mean[i] = adc->GetPedestal().mean;
+        ped_sigma[i] = adc->GetPedestal().sigma;
+        ch_dead[i] = adc->IsDead();
+
+        // only the modules belong to the detector have calibration constants
+        auto module = adc->GetModule();
+        if(module && module->GetDetector() == det && module->GetIndex() >= 0) {
+            ch_module[i] = module;
+            ch_index[i] = module->GetIndex();
+            ch_factor[i] = factor[ch_index[i]];
+            ch_id[i] = module->GetID();
+            if(module->GetType() >= 0 && module->GetType() < PRadHyCalModule::Max_Types)
+                ch_type[i] = module->GetType();
+        }
+    }
+}
+
+PRadCalibSnapshot::~PRadCalibSnapshot()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// take a snapshot of the system
+PRadCalibSnapshot::Ptr PRadCalibSnapshot::Take(const PRadHyCalSystem &sys)
+{
+    return Ptr(new PRadCalibSnapshot(sys));
+}
@@ -15,6 +15,16 @@
 #include "PRadCoordSystem.h"
 #include "ConfigObject.h"
 #include "canalib.h"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+static const char density_magic[8] = {'P', 'R', 'A', 'D', 'D', 'E', 'N', '\0'};
 
 
 // constructor
@@ -41,6 +51,14 @@ bool PRadClusterDensity::Load(int is, const std::string &p_path, const std::stri
 
     auto &pset = psets[is];
 
+    // the binary file is loaded directly, 0 means it is a text file
+    int bin_res = loadBinary(pset, p_path);
+    if(bin_res != 0) {
+        if(bin_res > 0)
+            buildEneTables(pset);
+        return bin_res > 0;
+    }
+
     // position density part
     ConfigParser c_parser;
     if(!c_parser.ReadFile(p_path)) {
@@ -60,26 +78,124 @@ bool PRadClusterDensity::Load(int is, const std::string &p_path, const std::stri
 
     bool ene_success = processEnePars(c_parser, pset);
 
+    buildEneTables(pset);
+
     return pos_success&ene_success;
 }
 
+// save the parameter set in the binary format
+bool PRadClusterDensity::SaveBinary(int is, const std::string &path)
+const
+{
+    if(is < 0 || is >= static_cast<int>(Max_SetEnums)) {
+        std::cerr << "PRad Cluster Density Error: Invalid parameter set enum = " << is
+                  << ", cannot save it." << std::endl;
+        return false;
+    }
+
+    auto &pset = psets[is];
+    uint32_t npars = pset.ppars.empty() ? 0 : pset.ppars.front().x.size();
+
+    // the energy parameters are sorted by module id
+    auto entries = [] (const std::unordered_map<int, Params> &pmap)
+                   {
+                       std::vector<EneEntry> res;
+                       for(auto &it : pmap)
+                       {
+                           EneEntry entry;
+                           memset(&entry, 0, sizeof(entry));
+                           entry.id = it.first;
+                           for(size_t i = 0; i < NB_ECORR_PARS && i < it.second.x.size(); ++i)
+                               entry.pars[i] = it.second.x[i];
+                           res.push_back(entry);
+                       }
+                       std::sort(res.begin(), res.end(),
+                                 [] (const EneEntry &a, const EneEntry &b) {return a.id < b.id;});
+                       return res;
+                   };
+    auto ep_entries = entries(pset.epars_ep);
+    auto ee_entries = entries(pset.epars_ee);
+
+    // data after the header
+    std::vector<char> data;
+    auto add = [&data] (const void *ptr, size_t bytes)
+               {
+                   data.insert(data.end(), (const char*) ptr, (const char*) ptr + bytes);
+               };
+    add(pset.energy_range.data(), pset.energy_range.size()*sizeof(float));
+    for(auto &par : pset.ppars)
+    {
+        add(par.x.data(), npars*sizeof(float));
+        add(par.y.data(), npars*sizeof(float));
+    }
+    add(ep_entries.data(), ep_entries.size()*sizeof(EneEntry));
+    add(ee_entries.data(), ee_entries.size()*sizeof(EneEntry));
+
+    BinHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, density_magic, sizeof(density_magic));
+    header.version = DENSITY_BIN_VERSION;
+    header.beam_energy = pset.beam_energy;
+    header.nrange = pset.energy_range.size();
+    header.ngroups = pset.ppars.size();
+    header.npars = npars;
+    header.nep = ep_entries.size();
+    header.nee = ee_entries.size();
+    header.hash = ConfigParser::hash_bytes(data.data(), data.size());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << "PRad Cluster Density Error: Cannot write file "
+                  << "\"" << path << "\"." << std::endl;
+        return false;
+    }
+
+    out.write((const char*) &header, sizeof(header));
+    out.write(data.data(), data.size());
+    return out.good();
+}
+
+// build the geometry index of every module from the detector layout
+void PRadClusterDensity::UpdateLayout(const PRadHyCalDetector *det)
+{
+    geo_index.clear();
+    if(!det)
+        return;
+
+    int max_id = -1;
+    for(auto module : det->GetModuleList())
+        max_id = std::max<int>(max_id, module->GetID());
+
+    geo_index.assign(max_id + 1, GEO_INDEX_UNKNOWN);
+    for(auto module : det->GetModuleList())
+        geo_index[module->GetID()] = getGeometryIndex(ModuleHit(module, module->GetID(), 0.));
+}
+
 // correct S shape position reconstruction
 void PRadClusterDensity::CorrectBias(const ModuleHit &ctr, HyCalHit &hit, bool pos_corr, bool ene_corr)
 const
+{
+    CorrectBias(ctr, hit, pos_corr, ene_corr, cur_set);
+}
+
+// correct with the given parameter set instead of the chosen one
+void PRadClusterDensity::CorrectBias(const ModuleHit &ctr, HyCalHit &hit, bool pos_corr, bool ene_corr,
+                                     SetEnum iset)
+const
 {
     if(!pos_corr && !ene_corr) return;
 
     // required infromation
-    auto &pset = psets[static_cast<int>(cur_set)];
+    auto &pset = psets[static_cast<int>(iset)];
 
     // energy index
     float angle = PRadCoordSystem::GetPolarAngle(Point(hit.x, hit.y, PRadCoordSystem::hycal_z() + hit.z));
-    int ie = getEnergyIndex(hit.E, angle*cana::deg2rad, 6.*hit.sig_ene);
+    int ie = getEnergyIndex(pset, hit.E, angle*cana::deg2rad, 6.*hit.sig_ene);
 
     // position correction
     if(pos_corr && !TEST_BIT(hit.flag, kDenCorr)) {
         // geometrical index
-        int ig = getGeometryIndex(ctr);
+        int ig = geometryIndex(ctr);
         int idx = ie + ig*5;
         if(ie >= 0 && ig >= 0 && idx < (int) pset.ppars.size()) {
             float dx = (hit.x - ctr->GetX())/ctr->GetSizeX();
@@ -99,22 +215,17 @@ const
         float dx = (hit.x - ctr->GetX())/ctr->GetSizeX();
         float dy = (hit.y - ctr->GetY())/ctr->GetSizeY();
 
-        // ep index
-        if(ie == ep_set) {
-            auto pit = pset.epars_ep.find(ctr.id);
-            if(pit != pset.epars_ep.end()) {
-                hit.E_Scorr = GetEneBias(pit->second.x, dx, dy, hit.E);
-                SET_BIT(hit.flag, kSEneCorr);
-                hit.E += hit.E_Scorr;
-            }
-        // ee index
-        } else if(ie == ee_set) {
-            auto pit = pset.epars_ee.find(ctr.id);
-            if(pit != pset.epars_ee.end()) {
-                hit.E_Scorr = GetEneBias(pit->second.x, dx, dy, hit.E);
-                SET_BIT(hit.flag, kSEneCorr);
-                hit.E += hit.E_Scorr;
-            }
+        // ep index or ee index
+        const float *pars = nullptr;
+        if(ie == ep_set)
+            pars = eneParams(pset.ep_table, pset.ep_valid, ctr.id);
+        else if(ie == ee_set)
+            pars = eneParams(pset.ee_table, pset.ee_valid, ctr.id);
+
+        if(pars) {
+            hit.E_Scorr = GetEneBias(pars, dx, dy, hit.E);
+            SET_BIT(hit.flag, kSEneCorr);
+            hit.E += hit.E_Scorr;
         }
     }
 
@@ -134,6 +245,13 @@ const
 float PRadClusterDensity::GetEneBias(const std::vector<float> &pars, const float &dx,
                                      const float &dy, const float &E0)
 const
+{
+    return GetEneBias(&pars[0], dx, dy, E0);
+}
+
+float PRadClusterDensity::GetEneBias(const float *pars, const float &dx,
+                                     const float &dy, const float &E0)
+const
 {
     // formula is
     // E0/c0/(1 + c1*dx^2 + c2*dy^2 + c3*dx^2*dy^2 + c4*dx^4 + c5*dy^4 + c6*dx + c7 * dy) - E0
@@ -160,11 +278,9 @@ inline float mott_energy(float E, float theta)
 
 // return energy index for searching parameters
 // priority for ep or moller energy range
-int PRadClusterDensity::getEnergyIndex(float energy, float theta, float res)
+int PRadClusterDensity::getEnergyIndex(const ParamsSet &pset, float energy, float theta, float res)
 const
-{
-    auto &pset = psets[static_cast<int>(cur_set)];
-    // ep energy
+{    // ep energy
     float Eep = mott_energy(pset.beam_energy, theta);
     if(std::abs(energy/Eep - 1.) < res) return pset.energy_range.size() - 1;
 
@@ -209,6 +325,52 @@ const
     return -1;
 }
 
+// geometry index from the table, or from the module if it is not in the table
+inline int PRadClusterDensity::geometryIndex(const ModuleHit &center)
+const
+{
+    if(center.id >= 0 && (size_t)center.id < geo_index.size() &&
+       geo_index[center.id] != GEO_INDEX_UNKNOWN)
+        return geo_index[center.id];
+    return getGeometryIndex(center);
+}
+
+// energy parameters of the module, nullptr if there are no parameters for it
+inline const float *PRadClusterDensity::eneParams(const std::vector<float> &table,
+                                                  const std::vector<uint8_t> &valid, int id)
+const
+{
+    if(id < 0 || (size_t)id >= valid.size() || !valid[id])
+        return nullptr;
+    return &table[id*NB_ECORR_PARS];
+}
+
+// fill the dense tables from the parameter maps of the set
+void PRadClusterDensity::buildEneTables(ParamsSet &pset)
+{
+    auto build = [] (const std::unordered_map<int, Params> &pmap,
+                     std::vector<float> &table, std::vector<uint8_t> &valid)
+                 {
+                     int max_id = -1;
+                     for(auto &it : pmap)
+                         max_id = std::max(max_id, it.first);
+
+                     table.assign((max_id + 1)*NB_ECORR_PARS, 0.);
+                     valid.assign(max_id + 1, 0);
+                     for(auto &it : pmap)
+                     {
+                         if(it.first < 0 || it.second.x.size() < NB_ECORR_PARS)
+                             continue;
+                         std::copy(it.second.x.begin(), it.second.x.begin() + NB_ECORR_PARS,
+                                   table.begin() + it.first*NB_ECORR_PARS);
+                         valid[it.first] = 1;
+                     }
+                 };
+
+    build(pset.epars_ep, pset.ep_table, pset.ep_valid);
+    build(pset.epars_ee, pset.ee_table, pset.ee_valid);
+}
+
 // helper function to process position density file
 bool PRadClusterDensity::processPosPars(ConfigParser &c_parser, ParamsSet &pset)
 {
@@ -312,3 +474,83 @@ bool PRadClusterDensity::processEnePars(ConfigParser &c_parser, ParamsSet &pset)
     return true;
 }
 
+// load the binary parameter file, return 1 if it is loaded, 0 if it is not a
+// binary file and -1 if it is a broken one
+int PRadClusterDensity::loadBinary(ParamsSet &pset, const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    struct stat fs;
+    if(fstat(fd, &fs) < 0 || (size_t)fs.st_size < sizeof(BinHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = fs.st_size;
+    void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED)
+        return 0;
+
+    const char *addr = (const char*) ptr;
+    BinHeader header;
+    memcpy(&header, addr, sizeof(header));
+    if(memcmp(header.magic, density_magic, sizeof(density_magic))) {
+        munmap(ptr, size);
+        return 0;
+    }
+
+    const char *data = addr + sizeof(header);
+    size_t bytes = (header.nrange + 2*header.ngroups*header.npars)*sizeof(float)
+                   + (header.nep + header.nee)*sizeof(EneEntry);
+    bool valid = (header.version == DENSITY_BIN_VERSION) &&
+                 (size == sizeof(header) + bytes) &&
+                 (ConfigParser::hash_bytes(data, bytes) == header.hash);
+
+    if(!valid) {
+        std::cerr << "PRad Cluster Density Error: Binary parameter file \"" << path << "\" "
+                  << "has a different version or is corrupted, it needs to be converted again."
+                  << std::endl;
+        munmap(ptr, size);
+        return -1;
+    }
+
+    // copy the data in the same order as they are saved
+    auto take = [&data] (void *dst, size_t n)
+                {
+                    memcpy(dst, data, n);
+                    data += n;
+                };
+
+    pset.beam_energy = header.beam_energy;
+    pset.energy_range.resize(header.nrange);
+    take(pset.energy_range.data(), header.nrange*sizeof(float));
+
+    pset.ppars.resize(header.ngroups);
+    for(auto &par : pset.ppars)
+    {
+        par.x.resize(header.npars);
+        par.y.resize(header.npars);
+        take(par.x.data(), header.npars*sizeof(float));
+        take(par.y.data(), header.npars*sizeof(float));
+    }
+
+    auto fill = [&take] (std::unordered_map<int, Params> &pmap, uint32_t n)
+                {
+                    pmap.clear();
+                    for(uint32_t i = 0; i < n; ++i)
+                    {
+                        EneEntry entry;
+                        take(&entry, sizeof(entry));
+                        auto &par = pmap[entry.id];
+                        par.x.assign(entry.pars, entry.pars + NB_ECORR_PARS);
+                    }
+                };
+    fill(pset.epars_ep, header.nep);
+    fill(pset.epars_ee, header.nee);
+
+    munmap(ptr, size);
+    return 1;
+}
@@ -14,7 +14,16 @@
 #include "PRadClusterProfile.h"
 #include "PRadHyCalModule.h"
 #include "ConfigParser.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
 #include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+static const char profile_magic[8] = {'P', 'R', 'A', 'D', 'P', 'R', 'F', '\0'};
 
 
 
@@ -37,6 +46,17 @@ void PRadClusterProfile::Load(int type, const std::string &path)
         return;
     }
 
+    auto &profile = profiles[type];
+
+    // the binary profile is loaded directly, 0 means it is a text file
+    int bin_res = loadBinary(profile, path);
+    if(bin_res > 0) {
+        profile.Flatten();
+        return;
+    } else if(bin_res < 0) {
+        return;
+    }
+
     ConfigParser parser;
     if(!parser.OpenFile(path)) {
         std::cerr << "PRad Cluster Profile Error: File"
@@ -46,7 +66,6 @@ void PRadClusterProfile::Load(int type, const std::string &path)
         return;
     }
 
-    auto &profile = profiles[type];
     // read configurations
     if(parser.ParseLine() && parser.NbofElements() == 5) {
         parser >> profile.min_ene >> profile.max_ene >> profile.step_ene
@@ -81,6 +100,49 @@ void PRadClusterProfile::Load(int type, const std::string &path)
                       << std::endl;
         }
     }
+
+    profile.Flatten();
+}
+
+// save the profile in the binary format
+bool PRadClusterProfile::SaveBinary(int type, const std::string &path)
+const
+{
+    if((size_t)type >= profiles.size() || profiles[type].values.empty()) {
+        std::cerr << "PRad Cluster Profile Error: No profile loaded for type "
+                  << type << ", cannot save it." << std::endl;
+        return false;
+    }
+
+    auto &profile = profiles[type];
+
+    BinHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, profile_magic, sizeof(profile_magic));
+    header.version = PROFILE_BIN_VERSION;
+    header.ne = profile.values.size();
+    header.nd = profile.values.front().size();
+    header.min_ene = profile.min_ene;
+    header.max_ene = profile.max_ene;
+    header.step_ene = profile.step_ene;
+    header.max_dist = profile.max_dist;
+    header.step_dist = profile.step_dist;
+    header.hash = CONFIG_HASH_SEED;
+    for(auto &e_prof : profile.values)
+        header.hash = ConfigParser::hash_bytes(&e_prof[0], header.nd*sizeof(Value), header.hash);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << "PRad Cluster Profile Error: Cannot write file "
+                  << "\"" << path << "\"." << std::endl;
+        return false;
+    }
+
+    out.write((const char*) &header, sizeof(header));
+    for(auto &e_prof : profile.values)
+        out.write((const char*) &e_prof[0], header.nd*sizeof(Value));
+
+    return out.good();
 }
 
 // get the profile value by distance and energy
@@ -123,3 +185,179 @@ const
 
     return Value(res*val2.frac + res2*val1.frac, res*val2.err + res2*val1.err);
 }
+
+// get the profile values of several distances at the same energy
+void PRadClusterProfile::GetBatch(int type, const float *dist, float energy,
+                                  float *frac, float *err, size_t n)
+const
+{
+    GetRow(type, energy).Get(dist, frac, err, n);
+}
+
+// get the distance profile at the energy, it is interpolated between the two
+// energy rows of the flattened table in the same way as Get
+PRadClusterProfile::Row PRadClusterProfile::GetRow(int type, float energy)
+const
+{
+    Row row;
+    row.type = type;
+    row.energy = energy;
+
+    if((size_t)type >= profiles.size() || profiles[type].values.empty())
+        return row;
+
+    auto &profile = profiles[type];
+
+    // two energy rows and their weights
+    size_t Ne = profile.values.size(), ie1, ie2;
+    double norm_e = (energy - profile.min_ene)/profile.step_ene;
+    int ie = int(norm_e);
+    if(ie < 0) {
+        ie1 = ie2 = 0;
+    } else if(ie + 1 >= (int)Ne) {
+        ie1 = ie2 = Ne - 1;
+    } else {
+        double res = norm_e - ie, res2 = 1. - res;
+        ie1 = ie, ie2 = ie + 1;
+        if(res < 0.05) {
+            ie2 = ie1;
+        } else if(res2 < 0.05) {
+            ie1 = ie2;
+        } else {
+            row.w1 = res2, row.w2 = res;
+        }
+    }
+
+    row.max_dist = profile.max_dist_f;
+    row.step = profile.step_dist;
+    row.frac1 = &profile.frac_table[ie1*profile.row_size];
+    row.frac2 = &profile.frac_table[ie2*profile.row_size];
+    row.err1 = &profile.err_table[ie1*profile.row_size];
+    row.err2 = &profile.err_table[ie2*profile.row_size];
+    return row;
+}
+
+// update the cached row if it is not for the type and energy
+const PRadClusterProfile::Row &PRadClusterProfile::GetRow(int type, float energy, Row &cache)
+const
+{
+    if(cache.type != type || cache.energy != energy || !cache.frac1)
+        cache = GetRow(type, energy);
+    return cache;
+}
+
+// interpolate one column at the distance bins, no need to read the second
+// energy row if the profile is not interpolated
+inline void get_column(const float *dist, float *vals, size_t n, float max_dist,
+                       double step, const float *v1, const float *v2, float w1, float w2)
+{
+    // out of range should be 0, read the first bin and discard it
+    // the distance bin is rounded in double precision to be the same as Get
+    if(w2 == 0.) {
+        for(size_t i = 0; i < n; ++i)
+        {
+            bool inside = dist[i] < max_dist;
+            int id = inside ? int(dist[i]/step + 0.5) : 0;
+            vals[i] = inside ? v1[id] : 0.f;
+        }
+    } else {
+        for(size_t i = 0; i < n; ++i)
+        {
+            bool inside = dist[i] < max_dist;
+            int id = inside ? int(dist[i]/step + 0.5) : 0;
+            float val = w1*v1[id] + w2*v2[id];
+            vals[i] = inside ? val : 0.f;
+        }
+    }
+}
+
+// get the profile values of several distances, err can be nullptr
+// the loops over distances do not branch, so they can be vectorized
+void PRadClusterProfile::Row::Get(const float *dist, float *frac, float *err, size_t n)
+const
+{
+    if(!frac1) {
+        for(size_t i = 0; i < n; ++i)
+        {
+            frac[i] = 0.;
+            if(err) err[i] = 0.;
+        }
+        return;
+    }
+
+    get_column(dist, frac, n, max_dist, step, frac1, frac2, w1, w2);
+    if(err)
+        get_column(dist, err, n, max_dist, step, err1, err2, w1, w2);
+}
+
+// build the flattened float tables from the loaded values
+void PRadClusterProfile::Profile::Flatten()
+{
+    size_t Nd = values.empty() ? 0 : values.front().size();
+    row_size = (Nd + PROFILE_ROW_ALIGN - 1)/PROFILE_ROW_ALIGN*PROFILE_ROW_ALIGN;
+    max_dist_f = max_dist;
+
+    frac_table.assign(values.size()*row_size, 0.);
+    err_table.assign(values.size()*row_size, 0.);
+    for(size_t ie = 0; ie < values.size(); ++ie)
+    {
+        for(size_t id = 0; id < Nd; ++id)
+        {
+            frac_table[ie*row_size + id] = values[ie][id].frac;
+            err_table[ie*row_size + id] = values[ie][id].err;
+        }
+    }
+}
+
+// load the binary profile file, return 1 if it is loaded, 0 if it is not a
+// binary profile and -1 if it is a broken one
+int PRadClusterProfile::loadBinary(Profile &profile, const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    struct stat fs;
+    if(fstat(fd, &fs) < 0 || (size_t)fs.st_size < sizeof(BinHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = fs.st_size;
+    void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED)
+        return 0;
+
+    const char *addr = (const char*) ptr;
+    BinHeader header;
+    memcpy(&header, addr, sizeof(header));
+    if(memcmp(header.magic, profile_magic, sizeof(profile_magic))) {
+        munmap(ptr, size);
+        return 0;
+    }
+
+    const char *data = addr + sizeof(header);
+    size_t row_bytes = header.nd*sizeof(Value);
+    bool valid = (header.version == PROFILE_BIN_VERSION) &&
+                 (size == sizeof(header) + header.ne*row_bytes) &&
+                 (ConfigParser::hash_bytes(data, header.ne*row_bytes) == header.hash);
+
+    if(valid) {
+        profile.min_ene = header.min_ene;
+        profile.max_ene = header.max_ene;
+        profile.step_ene = header.step_ene;
+        profile.max_dist = header.max_dist;
+        profile.step_dist = header.step_dist;
+        profile.Resize(header.ne, header.nd);
+        for(size_t ie = 0; ie < header.ne; ++ie)
+            memcpy(&profile.values[ie][0], data + ie*row_bytes, row_bytes);
+    } else {
+        std::cerr << "PRad Cluster Profile Error: Binary profile \"" << path << "\" "
+                  << "has a different version or is corrupted, it needs to be converted again."
+                  << std::endl;
+    }
+
+    munmap(ptr, size);
+    return valid ? 1 : -1;
+}
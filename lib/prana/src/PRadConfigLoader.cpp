@@ -0,0 +1,114 @@
+//============================================================================//
+// A loader for the configuration resources at start-up                       //
+// The independent resources are loaded by a thread pool and joined before    //
+// use, the loading time of every resource is recorded                        //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadConfigLoader.h"
+#include "PRadTaskPool.h"
+#include "PRadException.h"
+#include "ConfigParser.h"
+#include <iomanip>
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+// constructor, 0 means using all the hardware threads
+PRadConfigLoader::PRadConfigLoader(unsigned int nthreads)
+: pool(nullptr), total_time(0)
+{
+#ifdef MULTI_THREAD
+    pool = new PRadTaskPool(nthreads);
+#else
+    (void) nthreads;
+#endif
+}
+
+// destructor, the resources are always joined
+PRadConfigLoader::~PRadConfigLoader()
+{
+    Wait();
+    delete pool;
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// add a resource, it is loaded immediately without multi-threading
+void PRadConfigLoader::Add(const std::string &name, Task &&task)
+{
+    if(pool) {
+        Task t(std::move(task));
+        pool->Submit([this, name, t] () {load(name, t);});
+    } else {
+        load(name, task);
+    }
+}
+
+// wait for all the resources to be loaded
+void PRadConfigLoader::Wait()
+{
+    if(pool)
+        pool->Wait();
+
+    total_time = timer.GetElapsedTime();
+}
+
+// print the loading time of every resource
+void PRadConfigLoader::Report(std::ostream &os)
+const
+{
+    for(auto &res : resources)
+    {
+        os << "PRad Config Loader: " << std::setw(24) << std::left << res.name
+           << std::right << std::setw(8) << res.time << " ms";
+        if(!res.success)
+            os << " (failed: " << res.error << ")";
+        os << std::endl;
+    }
+
+    os << "PRad Config Loader: " << resources.size() << " resources loaded in "
+       << total_time << " ms." << std::endl;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// load a resource and record its time, exceptions do not escape the threads
+void PRadConfigLoader::load(const std::string &name, const Task &task)
+{
+    Resource res {name, 0, true, ""};
+    PRadBenchMark bench;
+
+    try {
+        task();
+    } catch(PRadException &e) {
+        res.success = false;
+        res.error = ConfigParser::trim(e.FailureType() + ": " + e.FailureDesc(), " \t\n");
+    } catch(std::exception &e) {
+        res.success = false;
+        res.error = e.what();
+    }
+
+    res.time = bench.GetElapsedTime();
+
+    if(!res.success) {
+        std::cerr << "PRad Config Loader Error: Failed to load " << name
+                  << ", " << res.error << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(locker);
+    resources.emplace_back(std::move(res));
+}
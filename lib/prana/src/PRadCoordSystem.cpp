@@ -38,6 +38,7 @@
 
 // constructor
 PRadCoordSystem::PRadCoordSystem(const std::string &path, const int &run)
+: table(std::make_shared<const PRadCoordTable>()), current(&defaultEntry())
 {
     if(!path.empty())
         LoadCoordData(path, run);
@@ -202,10 +203,6 @@ void PRadCoordSystem::LoadCoordData(const std::string &path, const int &chosen_r
     // get content blocks
     auto text = ConfigParser::break_into_blocks(buffer, "{", "}");
 
-    // clear containers
-    coords_data.clear();
-    current_coord.Clear();
-
     // retrieve detector setups
     std::vector<det_setup> setups;
     for(auto &block : text.blocks)
@@ -216,13 +213,17 @@ void PRadCoordSystem::LoadCoordData(const std::string &path, const int &chosen_r
     }
 
     // process beam positions, this should be done after detector setup
+    std::vector<RunCoord> coords;
     for(auto &block : text.blocks)
     {
         if(ConfigParser::case_ins_equal(block.label, "BeamPosition")) {
-            process_beam_position(block.content, setups, coords_data);
+            process_beam_position(block.content, setups, coords);
         }
     }
 
+    // the matrices of all runs are calculated once here
+    table = std::make_shared<const PRadCoordTable>(coords);
+    current = &defaultEntry();
     ChooseCoord(chosen_run);
 }
 
@@ -246,7 +247,7 @@ void PRadCoordSystem::SaveCoordData(const std::string &path)
            << std::setw(12) << "z_tilt"
            << std::endl;
 
-    for(auto &coord : coords_data)
+    for(auto &coord : GetCoordsData())
     {
         output << coord << std::endl;
     }
@@ -254,10 +255,11 @@ void PRadCoordSystem::SaveCoordData(const std::string &path)
     output.close();
 }
 
-// choose the coordinate offsets from the database
+// choose the coordinate offsets from the database, it only changes the entry
+// of the current run in the table
 void PRadCoordSystem::ChooseCoord(int run, bool warn_not_found)
 {
-    if(coords_data.empty()) {
+    if(table->empty()) {
         std::cerr << "PRad Coord System Error: Database is empty, make sure you "
                   << "have loaded the correct coordinates data."
                   << std::endl;
@@ -266,28 +268,18 @@ void PRadCoordSystem::ChooseCoord(int run, bool warn_not_found)
 
     // choose default run
     if(run <= 0) {
-        current_coord = coords_data.front();
+        current = table->At(0);
         return;
     }
 
-    // exceeds the lower bound
-    if(run <= coords_data.front().run_number) {
-        current_coord = coords_data.front();
-    // exceeds the upper bound
-    } else if (run >= coords_data.back().run_number) {
-        current_coord = coords_data.back();
-    // find interval that the run sits in
-    } else {
-        auto it_pair = cana::binary_search_interval(coords_data.begin(), coords_data.end(), run);
-        // always choose the nearest previous run
-        current_coord = *it_pair.first;
-    }
+    // always choose the nearest previous run
+    current = table->Find(run);
 
     // warn not exact
-    if(warn_not_found && run != current_coord.run_number) {
+    if(warn_not_found && run != current->coord.run_number) {
         std::cout << "PRad Coord System: Cannot find run <" << run
                   << "> in the current database, choose run <"
-                  << current_coord.run_number << "> instead."
+                  << current->coord.run_number << "> instead."
                   << std::endl;
     }
 }
@@ -295,61 +287,93 @@ void PRadCoordSystem::ChooseCoord(int run, bool warn_not_found)
 // choose coordinates by index in the data container
 void PRadCoordSystem::ChooseCoordAt(int idx)
 {
-    if(idx < 0 || idx >= (int)coords_data.size())
+    if(idx < 0 || idx >= (int)table->size())
         return;
 
-    current_coord = coords_data.at(idx);
+    current = table->At(idx);
 }
 
 // set and update the current coordinates
+// the table may be shared, so a new table is built with the coordinates
 bool PRadCoordSystem::SetCurrentCoord(const RunCoord &coords)
 {
     if(coords.dets.size() != static_cast<size_t>(PRadDetector::Max_Dets))
         return false;
 
-    current_coord = coords;
-
+    std::vector<RunCoord> coords_data = table->GetCoords();
     auto itp = cana::binary_search_interval(coords_data.begin(), coords_data.end(), coords.run_number);
     // add a new entry
     if(itp.second == coords_data.end() || itp.first != itp.second) {
-        coords_data.insert(itp.second, coords);
+        itp.first = coords_data.insert(itp.second, coords);
     // exact match
     } else {
         *itp.first = coords;
     }
 
+    size_t idx = itp.first - coords_data.begin();
+    table = std::make_shared<const PRadCoordTable>(coords_data);
+    current = table->At(idx);
     return true;
 }
 
+// use a table built elsewhere, the table is shared without copying
+void PRadCoordSystem::SetCoordTable(std::shared_ptr<const PRadCoordTable> tab, int run)
+{
+    if(!tab)
+        return;
+
+    table = tab;
+    current = &defaultEntry();
+    if(!table->empty())
+        ChooseCoord(run, false);
+}
+
 // Transform the detector frame to beam frame
 // it corrects the tilting angle first, and then correct origin
 void PRadCoordSystem::Transform(int det_id, float &x, float &y, float &z)
 const
 {
-    const DetCoord &coord = current_coord.dets.at(det_id);
-
-    // firstly rotate in the detector frame
-    auto p = Point(x, y, z).rotate(coord.rot);
-
-    // then transform to beam frame
-    p += coord.trans + current_coord.target_center;
-
-    x = p.x, y = p.y, z = p.z;
+    current->trans_mat.at(det_id).Apply(x, y, z);
 }
 
 // Reversely transform the beam frame to detector frame
 void PRadCoordSystem::InvTransform(int det_id, float &x, float &y, float &z)
 const
 {
-    const DetCoord &coord = current_coord.dets.at(det_id);
+    current->inv_mat.at(det_id).Apply(x, y, z);
+}
 
-    // firstly transform back to detector frame
-    auto p = Point(x, y, z) - current_coord.target_center - coord.trans;
+// transform the arrays of coordinates
+void PRadCoordSystem::TransformBatch(int det_id, float *x, float *y, float *z, size_t n)
+const
+{
+    current->trans_mat.at(det_id).Apply(x, y, z, n);
+}
 
-    // then rotate back
-    p = p.rotate_inv(coord.rot);
+void PRadCoordSystem::InvTransformBatch(int det_id, float *x, float *y, float *z, size_t n)
+const
+{
+    current->inv_mat.at(det_id).Apply(x, y, z, n);
+}
 
-    x = p.x, y = p.y, z = p.z;
+void PRadCoordSystem::Transform(int det_id, HyCalHitSoA &hits)
+const
+{
+    TransformBatch(det_id, hits.x.data(), hits.y.data(), hits.z.data(), hits.size());
+}
+
+void PRadCoordSystem::Transform(GEMHitSoA &hits)
+const
+{
+    size_t beg = 0, n = hits.size();
+    while(beg < n)
+    {
+        size_t end = beg + 1;
+        while(end < n && hits.det_id[end] == hits.det_id[beg])
+            ++end;
+        TransformBatch(hits.det_id[beg], &hits.x[beg], &hits.y[beg], &hits.z[beg], end - beg);
+        beg = end;
+    }
 }
 
 // projection from (xi, yi, zi) to zf
@@ -400,6 +424,142 @@ Point PRadCoordSystem::ProjectionCoordDiff(Point p1, Point p2, Point ori, float
     return Point(p1.x - p2.x, p1.y - p2.y, p1.z - p2.z);
 }
 
+// same as Projection for each point, written without branches
+void PRadCoordSystem::ProjectionBatch(const float *x, const float *y, const float *z, size_t n,
+                                      const Point &pi, float zf, float *px, float *py)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        float dz = zf - z[i], dzi = pi.z - z[i];
+        float kx = (pi.x - x[i])/dzi;
+        float ky = (pi.y - y[i])/dzi;
+        px[i] = (dz == 0.f) ? x[i] : x[i] + kx*dz;
+        py[i] = (dz == 0.f) ? y[i] : y[i] + ky*dz;
+    }
+}
+
+// the batch projection reads the point before writing it, so it works in place
+void PRadCoordSystem::Projection(HyCalHitSoA &hits, const Point &pi, float zf)
+{
+    float *x = hits.x.data(), *y = hits.y.data();
+    ProjectionBatch(x, y, hits.z.data(), hits.size(), pi, zf, x, y);
+    hits.z.assign(hits.size(), zf);
+}
+
+void PRadCoordSystem::Projection(GEMHitSoA &hits, const Point &pi, float zf)
+{
+    float *x = hits.x.data(), *y = hits.y.data();
+    ProjectionBatch(x, y, hits.z.data(), hits.size(), pi, zf, x, y);
+    hits.z.assign(hits.size(), zf);
+}
+
+
+
+
+//============================================================================//
+// Protected Member Functions                                                 //
+//============================================================================//
+
+const RunCoordEntry &PRadCoordSystem::defaultEntry()
+{
+    static const RunCoordEntry entry;
+    return entry;
+}
+
+
+
+//============================================================================//
+// Coordinate Table                                                           //
+//============================================================================//
+
+// calculate the matrices from the coordinates, the rotation is the same as
+// Point3D::rotate, then it is translated to the beam frame
+RunCoordEntry::RunCoordEntry(const RunCoord &c)
+: coord(c)
+{
+    trans_mat.resize(coord.dets.size());
+    inv_mat.resize(coord.dets.size());
+
+    for(size_t i = 0; i < coord.dets.size(); ++i)
+    {
+        const DetCoord &det = coord.dets[i];
+        Point t = det.trans + coord.target_center;
+
+        double cx = std::cos(det.rot.x), sx = std::sin(det.rot.x);
+        double cy = std::cos(det.rot.y), sy = std::sin(det.rot.y);
+        double cz = std::cos(det.rot.z), sz = std::sin(det.rot.z);
+
+        // Rxyz = RxRyRz
+        double r[3][3] = {{cy*cz, -cy*sz, sy},
+                          {cx*sz + sx*sy*cz, cx*cz - sx*sy*sz, -sx*cy},
+                          {sx*sz - cx*sy*cz, sx*cz + cx*sy*sz, cx*cy}};
+        double tr[3] = {t.x, t.y, t.z};
+
+        // forward: R*p + t, inverse: R^T*(p - t)
+        float *fm = trans_mat[i].m, *im = inv_mat[i].m;
+        for(int row = 0; row < 3; ++row)
+        {
+            double inv_t = 0.;
+            for(int col = 0; col < 3; ++col)
+            {
+                fm[row*4 + col] = r[row][col];
+                im[row*4 + col] = r[col][row];
+                inv_t -= r[col][row]*tr[col];
+            }
+            fm[row*4 + 3] = tr[row];
+            im[row*4 + 3] = inv_t;
+        }
+    }
+}
+
+PRadCoordTable::PRadCoordTable(const std::vector<RunCoord> &c)
+: coords(c)
+{
+    entries.reserve(coords.size());
+    for(auto &coord : coords)
+        entries.emplace_back(coord);
+}
+
+const RunCoordEntry *PRadCoordTable::Find(int run)
+const
+{
+    if(entries.empty())
+        return nullptr;
+
+    // exceeds the bounds
+    if(run <= coords.front().run_number)
+        return &entries.front();
+    if(run >= coords.back().run_number)
+        return &entries.back();
+
+    // find interval that the run sits in
+    auto it_pair = cana::binary_search_interval(coords.begin(), coords.end(), run);
+    return &entries[it_pair.first - coords.begin()];
+}
+
+
+
+//============================================================================//
+// Other Functions                                                            //
+//============================================================================//
+
+// apply the matrix on the coordinate arrays
+void AffineMatrix::Apply(float *x, float *y, float *z, size_t n)
+const
+{
+    const float m0 = m[0], m1 = m[1], m2 = m[2], m3 = m[3];
+    const float m4 = m[4], m5 = m[5], m6 = m[6], m7 = m[7];
+    const float m8 = m[8], m9 = m[9], m10 = m[10], m11 = m[11];
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        float xi = x[i], yi = y[i], zi = z[i];
+        x[i] = m0*xi + m1*yi + m2*zi + m3;
+        y[i] = m4*xi + m5*yi + m6*zi + m7;
+        z[i] = m8*xi + m9*yi + m10*zi + m11;
+    }
+}
+
 std::ostream &operator <<(std::ostream &os, const RunCoord &coord)
 {
     for(size_t i = 0; i < coord.dets.size(); ++i)
@@ -1,7 +1,8 @@
 //============================================================================//
 // A singleton class that stores and manages the database                     //
-// Now support text data files                                                //
-// TODO support sql                                                           //
+// It keeps the run dependent constants of HyCal in an in-process cache, the  //
+// runs are from an sqlite database or the text data files, and the next     //
+// runs of a job are read ahead on a background thread                        //
 //                                                                            //
 // Chao Peng                                                                  //
 // 12/11/2016                                                                 //
@@ -9,11 +10,592 @@
 
 #include "PRadDBManager.h"
 #include "ConfigParser.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#ifdef USE_SQLITE
+#include <sqlite3.h>
+#endif
 
 
 
-// add the trigger channels
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
 PRadDBManager::PRadDBManager()
+: enabled(false), max_runs(DB_CACHE_RUNS), use_count(0), db(nullptr)
+#ifdef MULTI_THREAD
+, stop(false)
+#endif
 {
     // place holder
 }
+
+PRadDBManager::~PRadDBManager()
+{
+#ifdef MULTI_THREAD
+    {
+        std::lock_guard<std::mutex> lock(locker);
+        stop = true;
+    }
+    cond.notify_all();
+    if(worker.joinable())
+        worker.join();
+#endif
+    CloseDatabase();
+}
+
+PRadDBManager &PRadDBManager::Instance()
+{
+    static PRadDBManager instance;
+    return instance;
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+#ifdef USE_SQLITE
+// tables of the runs, one row for a run and one row for a module
+static const char *db_schema =
+    "CREATE TABLE IF NOT EXISTS hycal_runs ("
+    "run INTEGER PRIMARY KEY, calib_path TEXT, info_path TEXT,"
+    "calib_stamp BLOB, info_stamp BLOB, calib_read INTEGER, info_read INTEGER,"
+    "ref INTEGER, ref_gains BLOB);"
+    "CREATE TABLE IF NOT EXISTS hycal_calib ("
+    "run INTEGER, name TEXT, factor REAL, energy REAL, non_linear REAL, gains BLOB);"
+    "CREATE INDEX IF NOT EXISTS hycal_calib_run ON hycal_calib (run);"
+    "CREATE TABLE IF NOT EXISTS hycal_status ("
+    "run INTEGER, name TEXT, status INTEGER, ped_mean REAL, ped_sigma REAL,"
+    "lms_mean REAL, lms_sigma REAL);"
+    "CREATE INDEX IF NOT EXISTS hycal_status_run ON hycal_status (run);";
+#endif
+
+// open or create the database, the cache is enabled with it
+bool PRadDBManager::OpenDatabase(const std::string &path)
+{
+    CloseDatabase();
+
+#ifdef USE_SQLITE
+    std::lock_guard<std::mutex> lock(db_locker);
+
+    sqlite3 *handle = nullptr;
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+    if(sqlite3_open_v2(path.c_str(), &handle, flags, nullptr) != SQLITE_OK) {
+        std::cerr << "PRad DB Manager Error: Failed to open database "
+                  << "\"" << path << "\", "
+                  << sqlite3_errmsg(handle) << "." << std::endl;
+        sqlite3_close(handle);
+        return false;
+    }
+
+    // the database may be shared by the jobs of a farm
+    sqlite3_busy_timeout(handle, 10000);
+
+    char *err = nullptr;
+    if(sqlite3_exec(handle, db_schema, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "PRad DB Manager Error: Failed to create the tables in "
+                  << "\"" << path << "\", " << err << "." << std::endl;
+        sqlite3_free(err);
+        sqlite3_close(handle);
+        return false;
+    }
+
+    db = handle;
+    enabled = true;
+    return true;
+#else
+    std::cerr << "PRad DB Manager Error: Cannot open database "
+              << "\"" << path << "\", the library is built without sqlite "
+              << "(LIB_OPTION SQLITE)." << std::endl;
+    return false;
+#endif
+}
+
+void PRadDBManager::CloseDatabase()
+{
+    std::lock_guard<std::mutex> lock(db_locker);
+#ifdef USE_SQLITE
+    if(db)
+        sqlite3_close(static_cast<sqlite3*>(db));
+#endif
+    db = nullptr;
+}
+
+bool PRadDBManager::IsDatabaseOpen()
+const
+{
+    std::lock_guard<std::mutex> lock(db_locker);
+    return db != nullptr;
+}
+
+void PRadDBManager::SetCacheRuns(size_t n)
+{
+    std::lock_guard<std::mutex> lock(locker);
+    max_runs = std::max(n, (size_t)1);
+    evict();
+}
+
+// the runs being read are kept, they are going to be used
+void PRadDBManager::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(locker);
+    queue.clear();
+    for(auto it = cache.begin(); it != cache.end();)
+    {
+        if(it->second.loading)
+            ++it;
+        else
+            it = cache.erase(it);
+    }
+}
+
+PRadDBManager::Record PRadDBManager::GetRun(const RunFiles &files)
+{
+    std::unique_lock<std::mutex> lock(locker);
+
+    auto it = cache.find(files.run);
+#ifdef MULTI_THREAD
+    // being read by the prefetch thread or another system
+    while(it != cache.end() && it->second.loading)
+    {
+        cond.wait(lock);
+        it = cache.find(files.run);
+    }
+#endif
+
+    if(it != cache.end() && it->second.files == files) {
+        stats.hits++;
+        it->second.used = ++use_count;
+        return it->second.rec;
+    }
+
+    stats.misses++;
+    cache[files.run] = Entry{files, nullptr, true, ++use_count};
+    lock.unlock();
+
+    Record rec = load(files);
+
+    lock.lock();
+    store(files, rec);
+#ifdef MULTI_THREAD
+    cond.notify_all();
+#endif
+    return rec;
+}
+
+// the queue is limited by the cache size, the later runs would evict the
+// first ones before they are used
+void PRadDBManager::Prefetch(const std::vector<RunFiles> &runs)
+{
+    std::unique_lock<std::mutex> lock(locker);
+    enabled = true;
+
+    for(auto &files : runs)
+    {
+        if(queue.size() >= max_runs)
+            break;
+
+        auto it = cache.find(files.run);
+        if(it != cache.end() && it->second.files == files)
+            continue;
+        if(std::find(queue.begin(), queue.end(), files) != queue.end())
+            continue;
+        queue.push_back(files);
+    }
+
+#ifdef MULTI_THREAD
+    if(!worker.joinable())
+        worker = std::thread(&PRadDBManager::prefetch, this);
+    lock.unlock();
+    cond.notify_all();
+#else
+    lock.unlock();
+    prefetch();
+#endif
+}
+
+PRadDBManager::Stats PRadDBManager::GetStats()
+const
+{
+    std::lock_guard<std::mutex> lock(locker);
+    return stats;
+}
+
+// calibration constants, the lines are
+// name factor energy non_linear gains...
+bool PRadDBManager::ReadCalibFile(const std::string &path, PRadCalibCache &rec)
+{
+    ConfigParser c_parser;
+    if(path.empty() || !c_parser.ReadFile(path))
+        return false;
+
+    std::string name;
+    double factor, Ecal, nl;
+
+    while(c_parser.ParseLine())
+    {
+        if(!c_parser.CheckElements(4, -1))
+            continue;
+
+        c_parser >> name >> factor >> Ecal >> nl;
+        std::vector<double> gains;
+        while(c_parser.NbofElements())
+            gains.push_back(c_parser.TakeFirst<double>());
+
+        rec.AddCalib(name, factor, Ecal, nl, gains);
+    }
+
+    rec.SetCalibRead(true);
+    return true;
+}
+
+// run information, the first line is
+// REF_GAIN gains... ref
+// and the modules follow as
+// name ped_mean ped_sigma lms_mean lms_sigma status
+bool PRadDBManager::ReadRunInfoFile(const std::string &path, PRadCalibCache &rec)
+{
+    ConfigParser c_parser;
+    if(path.empty() || !c_parser.ReadFile(path))
+        return false;
+
+    std::string name;
+    std::vector<double> ref_gain;
+    unsigned int ref = 0;
+
+    if(c_parser.ParseLine()) {
+        c_parser >> name;
+
+        if(!ConfigParser::case_ins_equal(name, "REF_GAIN")) {
+            std::cerr << "PRad DB Manager Error: Expected Reference PMT info "
+                      << "(started by REF_GAIN) as the first input in "
+                      << "\"" << path << "\"." << std::endl;
+            return false;
+        }
+
+        while(c_parser.NbofElements() > 1)
+            ref_gain.push_back(c_parser.TakeFirst().Double());
+
+        c_parser >> ref;
+        ref--;
+
+        if(ref >= ref_gain.size()) {
+            std::cerr << "PRad DB Manager Error: Unknown Reference PMT " << ref + 1
+                      << ", only has " << ref_gain.size() << " Ref. PMTs in "
+                      << "\"" << path << "\"." << std::endl;
+            return false;
+        }
+    }
+
+    double lms_mean, lms_sig, ped_mean, ped_sig;
+    unsigned int status;
+    while(c_parser.ParseLine())
+    {
+        if(!c_parser.CheckElements(6))
+            continue;
+
+        c_parser >> name >> ped_mean >> ped_sig >> lms_mean >> lms_sig >> status;
+        rec.AddStatus(name, ped_mean, ped_sig, lms_mean, lms_sig, status);
+    }
+
+    rec.SetRefGains(ref, ref_gain);
+    rec.SetInfoRead(true);
+    return true;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// read a run from the database, or from the text files
+PRadDBManager::Record PRadDBManager::load(const RunFiles &files)
+{
+    Record rec = readDatabase(files);
+    if(rec)
+        return rec;
+
+    std::shared_ptr<PRadCalibCache> text = std::make_shared<PRadCalibCache>(files.run);
+    bool calib_ok = ReadCalibFile(files.calib, *text);
+    bool info_ok = ReadRunInfoFile(files.info, *text);
+    if((!calib_ok && !info_ok) || !text->IsValid())
+        return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(locker);
+        stats.file_reads++;
+    }
+
+    writeDatabase(files, *text);
+    return text;
+}
+
+// the record is used if its text files are unchanged, or not available
+PRadDBManager::Record PRadDBManager::readDatabase(const RunFiles &files)
+{
+#ifdef USE_SQLITE
+    std::lock_guard<std::mutex> db_lock(db_locker);
+    if(!db)
+        return nullptr;
+
+    sqlite3 *handle = static_cast<sqlite3*>(db);
+    sqlite3_stmt *stmt = nullptr;
+
+    // a blob of a fixed size structure
+    auto blob = [&stmt](int col, void *dest, size_t bytes)
+                {
+                    size_t size = sqlite3_column_bytes(stmt, col);
+                    const void *data = sqlite3_column_blob(stmt, col);
+                    if(size > bytes || (size && !data))
+                        return (size_t)0;
+                    if(size)
+                        memcpy(dest, data, size);
+                    return size;
+                };
+    auto text = [&stmt](int col)
+                {
+                    const unsigned char *str = sqlite3_column_text(stmt, col);
+                    return str ? std::string(reinterpret_cast<const char*>(str)) : std::string();
+                };
+    auto matched = [](const std::string &path, const PRadCalibCache::Stamp &stored)
+                   {
+                       auto stamp = PRadCalibCache::GetStamp(path);
+                       return stamp.size < 0 || stamp == stored;
+                   };
+
+    std::shared_ptr<PRadCalibCache> rec = std::make_shared<PRadCalibCache>(files.run);
+
+    sqlite3_prepare_v2(handle, "SELECT calib_path, info_path, calib_stamp, info_stamp, "
+                               "calib_read, info_read, ref, ref_gains FROM hycal_runs "
+                               "WHERE run = ?;", -1, &stmt, nullptr);
+    sqlite3_bind_int(stmt, 1, files.run);
+    if(sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+
+    PRadCalibCache::Stamp calib_stamp, info_stamp;
+    double ref_gains[CALIB_CACHE_GAINS];
+    bool ok = text(0) == files.calib && text(1) == files.info
+              && blob(2, &calib_stamp, sizeof(calib_stamp)) == sizeof(calib_stamp)
+              && blob(3, &info_stamp, sizeof(info_stamp)) == sizeof(info_stamp)
+              && matched(files.calib, calib_stamp) && matched(files.info, info_stamp);
+    bool calib_read = sqlite3_column_int(stmt, 4);
+    bool info_read = sqlite3_column_int(stmt, 5);
+    unsigned int ref = sqlite3_column_int(stmt, 6);
+    size_t ngains = blob(7, ref_gains, sizeof(ref_gains))/sizeof(double);
+    sqlite3_finalize(stmt);
+
+    if(!ok)
+        return nullptr;
+
+    sqlite3_prepare_v2(handle, "SELECT name, factor, energy, non_linear, gains "
+                               "FROM hycal_calib WHERE run = ? ORDER BY rowid;",
+                       -1, &stmt, nullptr);
+    sqlite3_bind_int(stmt, 1, files.run);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        double gains[CALIB_CACHE_GAINS];
+        size_t n = blob(4, gains, sizeof(gains))/sizeof(double);
+        rec->AddCalib(text(0), sqlite3_column_double(stmt, 1), sqlite3_column_double(stmt, 2),
+                      sqlite3_column_double(stmt, 3), std::vector<double>(gains, gains + n));
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(handle, "SELECT name, ped_mean, ped_sigma, lms_mean, lms_sigma, status "
+                               "FROM hycal_status WHERE run = ? ORDER BY rowid;",
+                       -1, &stmt, nullptr);
+    sqlite3_bind_int(stmt, 1, files.run);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        rec->AddStatus(text(0), sqlite3_column_double(stmt, 1), sqlite3_column_double(stmt, 2),
+                       sqlite3_column_double(stmt, 3), sqlite3_column_double(stmt, 4),
+                       sqlite3_column_int(stmt, 5));
+    }
+    sqlite3_finalize(stmt);
+
+    if(info_read)
+        rec->SetRefGains(ref, std::vector<double>(ref_gains, ref_gains + ngains));
+    rec->SetCalibRead(calib_read);
+    rec->SetInfoRead(info_read);
+    if(!rec->IsValid())
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(locker);
+    stats.db_reads++;
+    return rec;
+#else
+    (void) files;
+    return nullptr;
+#endif
+}
+
+// replace the records of the run
+void PRadDBManager::writeDatabase(const RunFiles &files, const PRadCalibCache &rec)
+{
+#ifdef USE_SQLITE
+    std::lock_guard<std::mutex> db_lock(db_locker);
+    if(!db)
+        return;
+
+    sqlite3 *handle = static_cast<sqlite3*>(db);
+    sqlite3_stmt *stmt = nullptr;
+    bool ok = true;
+
+    // run a prepared statement to its end
+    auto finish = [&stmt, &ok]()
+                  {
+                      if(sqlite3_step(stmt) != SQLITE_DONE)
+                          ok = false;
+                      sqlite3_finalize(stmt);
+                  };
+    auto exec = [&](const char *sql)
+                {
+                    sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr);
+                    sqlite3_bind_int(stmt, 1, files.run);
+                    finish();
+                };
+
+    sqlite3_exec(handle, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    exec("DELETE FROM hycal_runs WHERE run = ?;");
+    exec("DELETE FROM hycal_calib WHERE run = ?;");
+    exec("DELETE FROM hycal_status WHERE run = ?;");
+
+    auto calib_stamp = PRadCalibCache::GetStamp(files.calib);
+    auto info_stamp = PRadCalibCache::GetStamp(files.info);
+    auto &ref_gains = rec.GetRefGains();
+    sqlite3_prepare_v2(handle, "INSERT INTO hycal_runs VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);",
+                       -1, &stmt, nullptr);
+    sqlite3_bind_int(stmt, 1, files.run);
+    sqlite3_bind_text(stmt, 2, files.calib.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, files.info.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 4, &calib_stamp, sizeof(calib_stamp), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 5, &info_stamp, sizeof(info_stamp), SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 6, rec.IsCalibRead());
+    sqlite3_bind_int(stmt, 7, rec.IsInfoRead());
+    sqlite3_bind_int(stmt, 8, ref_gains.ref);
+    sqlite3_bind_blob(stmt, 9, ref_gains.gains, ref_gains.ngains*sizeof(double), SQLITE_TRANSIENT);
+    finish();
+
+    sqlite3_prepare_v2(handle, "INSERT INTO hycal_calib VALUES (?, ?, ?, ?, ?, ?);",
+                       -1, &stmt, nullptr);
+    for(size_t i = 0; i < rec.GetCalibCount() && ok; ++i)
+    {
+        auto &entry = rec.GetCalib()[i];
+        std::string name = PRadCalibCache::GetName(entry.name);
+        sqlite3_bind_int(stmt, 1, files.run);
+        sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 3, entry.factor);
+        sqlite3_bind_double(stmt, 4, entry.energy);
+        sqlite3_bind_double(stmt, 5, entry.non_linear);
+        sqlite3_bind_blob(stmt, 6, entry.gains, entry.ngains*sizeof(double), SQLITE_TRANSIENT);
+        if(sqlite3_step(stmt) != SQLITE_DONE)
+            ok = false;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(handle, "INSERT INTO hycal_status VALUES (?, ?, ?, ?, ?, ?, ?);",
+                       -1, &stmt, nullptr);
+    for(size_t i = 0; i < rec.GetStatusCount() && ok; ++i)
+    {
+        auto &entry = rec.GetStatus()[i];
+        std::string name = PRadCalibCache::GetName(entry.name);
+        sqlite3_bind_int(stmt, 1, files.run);
+        sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 3, entry.status);
+        sqlite3_bind_double(stmt, 4, entry.ped_mean);
+        sqlite3_bind_double(stmt, 5, entry.ped_sigma);
+        sqlite3_bind_double(stmt, 6, entry.lms_mean);
+        sqlite3_bind_double(stmt, 7, entry.lms_sigma);
+        if(sqlite3_step(stmt) != SQLITE_DONE)
+            ok = false;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if(ok) {
+        sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, nullptr);
+    } else {
+        std::cerr << "PRad DB Manager Error: Failed to write run " << files.run
+                  << " to the database, " << sqlite3_errmsg(handle) << "." << std::endl;
+        sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+#else
+    (void) files;
+    (void) rec;
+#endif
+}
+
+// called with the lock, a run that cannot be read is not kept
+void PRadDBManager::store(const RunFiles &files, const Record &rec)
+{
+    if(rec) {
+        cache[files.run] = Entry{files, rec, false, ++use_count};
+        evict();
+    } else {
+        cache.erase(files.run);
+    }
+}
+
+// called with the lock, the least recently used runs are removed
+void PRadDBManager::evict()
+{
+    while(cache.size() > max_runs)
+    {
+        auto oldest = cache.end();
+        for(auto it = cache.begin(); it != cache.end(); ++it)
+        {
+            if(!it->second.loading && (oldest == cache.end() || it->second.used < oldest->second.used))
+                oldest = it;
+        }
+
+        if(oldest == cache.end())
+            break;
+        cache.erase(oldest);
+    }
+}
+
+// read the queued runs, it is the loop of the background thread
+void PRadDBManager::prefetch()
+{
+    std::unique_lock<std::mutex> lock(locker);
+
+    while(true)
+    {
+#ifdef MULTI_THREAD
+        cond.wait(lock, [this] () {return stop || !queue.empty();});
+        if(stop)
+            break;
+#else
+        if(queue.empty())
+            break;
+#endif
+
+        RunFiles files = queue.front();
+        queue.pop_front();
+
+        // it may be read by a system already
+        auto it = cache.find(files.run);
+        if(it != cache.end() && (it->second.loading || it->second.files == files))
+            continue;
+
+        cache[files.run] = Entry{files, nullptr, true, ++use_count};
+        lock.unlock();
+
+        Record rec = load(files);
+
+        lock.lock();
+        store(files, rec);
+        if(rec)
+            stats.prefetched++;
+#ifdef MULTI_THREAD
+        cond.notify_all();
+#endif
+    }
+}
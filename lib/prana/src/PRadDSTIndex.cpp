@@ -0,0 +1,275 @@
+//============================================================================//
+// Event index of a DST dataset with multiple runs                            //
+// The events of every file are listed with its event map, sorted by run and  //
+// event number, so an event in any run can be located by binary search, and  //
+// decoded from its file without reading the other events                     //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDSTIndex.h"
+#include "PRadDSTReader.h"
+#include "ConfigParser.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadDSTIndex::PRadDSTIndex()
+{
+    // place holder
+}
+
+PRadDSTIndex::~PRadDSTIndex()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// add all the events in a DST file
+bool PRadDSTIndex::AddFile(const std::string &path, int run)
+{
+    PRadDSTReader reader;
+    if(!reader.Open(path)) {
+        std::cerr << "PRad DST Index Error: Cannot open DST file "
+                  << "\"" << path << "\"."
+                  << std::endl;
+        return false;
+    }
+
+    if(run <= 0)
+        run = ConfigParser::find_integer(ConfigParser::decompose_path(path).name);
+
+    // only the event information is needed
+    reader.SetBankMask(0);
+
+    uint32_t file = files.size();
+    size_t count = 0;
+    auto add_event = [&] (const EventData &event)
+                     {
+                         Entry entry;
+                         entry.run = run;
+                         entry.event_number = event.event_number;
+                         entry.timestamp = event.timestamp;
+                         entry.file = file;
+                         entry.index = count++;
+                         entries.push_back(entry);
+                     };
+
+    if(reader.IsChunked()) {
+        std::vector<EventData> events;
+        for(size_t c = 0; c < reader.GetChunkCount(); ++c)
+        {
+            reader.GetChunk(c, events);
+            for(auto &event : events)
+                add_event(event);
+        }
+    } else {
+        EventData event;
+        for(size_t i = 0; i < reader.GetEventCount(); ++i)
+        {
+            reader.GetEvent(i, event);
+            add_event(event);
+        }
+    }
+
+    files.push_back(path);
+    readers.emplace_back(nullptr);
+    sortEntries();
+    return true;
+}
+
+void PRadDSTIndex::Clear()
+{
+    files.clear();
+    entries.clear();
+    time_order.clear();
+    readers.clear();
+}
+
+// save the index in binary
+bool PRadDSTIndex::Save(const std::string &path)
+const
+{
+    std::ofstream out(path, std::ios::binary);
+    if(!out.is_open()) {
+        std::cerr << "PRad DST Index Error: Cannot open file "
+                  << "\"" << path << "\" to save the index."
+                  << std::endl;
+        return false;
+    }
+
+    uint32_t header[3] = {DST_INDEX_MAGIC, DST_INDEX_VERSION, (uint32_t)files.size()};
+    out.write((const char*)header, sizeof(header));
+    for(auto &file : files)
+    {
+        uint32_t len = file.size();
+        out.write((const char*)&len, sizeof(len));
+        out.write(file.data(), len);
+    }
+
+    uint64_t nentries = entries.size();
+    out.write((const char*)&nentries, sizeof(nentries));
+    out.write((const char*)entries.data(), nentries*sizeof(Entry));
+    return out.good();
+}
+
+// load the index saved before, the files are not checked
+bool PRadDSTIndex::Load(const std::string &path)
+{
+    Clear();
+
+    std::ifstream in(path, std::ios::binary);
+    uint32_t header[3];
+    if(!in.read((char*)header, sizeof(header)) ||
+       header[0] != DST_INDEX_MAGIC || header[1] != DST_INDEX_VERSION) {
+        std::cerr << "PRad DST Index Error: "
+                  << "\"" << path << "\" is not a valid index file."
+                  << std::endl;
+        return false;
+    }
+
+    for(uint32_t i = 0; i < header[2]; ++i)
+    {
+        uint32_t len;
+        if(!in.read((char*)&len, sizeof(len)))
+            break;
+        std::string file(len, '\0');
+        in.read(&file[0], len);
+        files.push_back(file);
+    }
+
+    uint64_t nentries = 0;
+    in.read((char*)&nentries, sizeof(nentries));
+    entries.resize(nentries);
+    in.read((char*)entries.data(), nentries*sizeof(Entry));
+
+    if(!in || files.size() != header[2]) {
+        std::cerr << "PRad DST Index Error: Incomplete index file "
+                  << "\"" << path << "\"."
+                  << std::endl;
+        Clear();
+        return false;
+    }
+
+    readers.resize(files.size());
+    sortEntries();
+    return true;
+}
+
+int PRadDSTIndex::Find(int run, int event_number)
+const
+{
+    Entry key;
+    key.run = run;
+    key.event_number = event_number;
+    auto it = std::lower_bound(entries.begin(), entries.end(), key);
+    if(it == entries.end() || it->run != run || it->event_number != event_number)
+        return -1;
+
+    return it - entries.begin();
+}
+
+int PRadDSTIndex::FindTime(int run, uint64_t timestamp)
+const
+{
+    auto it = std::lower_bound(time_order.begin(), time_order.end(), 0,
+                               [this, run, timestamp] (uint32_t i, int)
+                               {
+                                   const Entry &e = entries[i];
+                                   return (e.run < run) ||
+                                          (e.run == run && e.timestamp < timestamp);
+                               });
+    if(it == time_order.end() || entries[*it].run != run)
+        return -1;
+
+    return *it;
+}
+
+std::pair<size_t, size_t> PRadDSTIndex::GetRunRange(int run)
+const
+{
+    auto first = std::lower_bound(entries.begin(), entries.end(), run,
+                                  [] (const Entry &e, int r) {return e.run < r;});
+    auto last = std::upper_bound(first, entries.end(), run,
+                                 [] (int r, const Entry &e) {return r < e.run;});
+    return std::make_pair(first - entries.begin(), last - entries.begin());
+}
+
+std::vector<int> PRadDSTIndex::GetRuns()
+const
+{
+    std::vector<int> runs;
+    for(auto &entry : entries)
+    {
+        if(runs.empty() || runs.back() != entry.run)
+            runs.push_back(entry.run);
+    }
+    return runs;
+}
+
+bool PRadDSTIndex::ReadEvent(size_t i, EventData &event)
+{
+    if(i >= entries.size())
+        return false;
+
+    PRadDSTReader *reader = getReader(entries[i].file);
+    if(!reader)
+        return false;
+
+    return reader->GetEvent(entries[i].index, event);
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+void PRadDSTIndex::sortEntries()
+{
+    std::stable_sort(entries.begin(), entries.end());
+
+    time_order.resize(entries.size());
+    for(size_t i = 0; i < time_order.size(); ++i)
+        time_order[i] = i;
+
+    std::stable_sort(time_order.begin(), time_order.end(),
+                     [this] (uint32_t a, uint32_t b)
+                     {
+                         const Entry &ea = entries[a], &eb = entries[b];
+                         return (ea.run < eb.run) ||
+                                (ea.run == eb.run && ea.timestamp < eb.timestamp);
+                     });
+}
+
+// open the file on the first reading
+PRadDSTReader *PRadDSTIndex::getReader(uint32_t file)
+{
+    if(file >= files.size())
+        return nullptr;
+
+    if(!readers[file]) {
+        readers[file].reset(new PRadDSTReader());
+        if(!readers[file]->Open(files[file])) {
+            std::cerr << "PRad DST Index Error: Cannot open DST file "
+                      << "\"" << files[file] << "\"."
+                      << std::endl;
+            readers[file].reset();
+            return nullptr;
+        }
+    }
+
+    return readers[file].get();
+}
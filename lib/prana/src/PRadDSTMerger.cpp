@@ -0,0 +1,298 @@
+//============================================================================//
+// Merge DST files into one                                                   //
+// The records of every input are copied in one piece to the output, their    //
+// positions are shifted in the combined event map, so merging is limited by  //
+// the file I/O only, and different inputs are copied by different threads    //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDSTMerger.h"
+#include "PRadDSTParser.h"
+#include "PRadDSTReader.h"
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef MULTI_THREAD
+#include <thread>
+#endif
+
+typedef PRadDSTParser::Header Header;
+typedef PRadDSTParser::Type Type;
+
+// write the whole buffer at the position
+inline bool write_at(int fd, const char *buf, size_t size, int64_t pos)
+{
+    while(size > 0)
+    {
+        ssize_t res = pwrite(fd, buf, std::min<size_t>(size, DST_MERGE_BLOCK), pos);
+        if(res < 0) {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        buf += res;
+        pos += res;
+        size -= res;
+    }
+    return true;
+}
+
+// end of the last record in the index, it is the content length for a closed
+// file and excludes the incomplete record for a file not closed properly
+inline int64_t content_end(const PRadDSTReader &reader)
+{
+    int64_t end = DST_CONTENT_BEGIN;
+    int64_t crc_size = PRadDSTParser::ChecksumSize(reader.GetVersion());
+    for(uint16_t t = 0; t < static_cast<uint16_t>(Type::max_type); ++t)
+    {
+        for(auto &off : reader.GetOffsets(static_cast<Type>(t)))
+        {
+            Header header;
+            memcpy(&header, reader.GetData() + off, sizeof(header));
+            end = std::max<int64_t>(end, off + sizeof(Header) + header.length + crc_size);
+        }
+    }
+    return end;
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadDSTMerger::PRadDSTMerger(unsigned int nthreads)
+: merged_bytes(0), merged_records(0)
+{
+    SetThreads(nthreads);
+}
+
+PRadDSTMerger::~PRadDSTMerger()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// number of threads to copy the inputs
+void PRadDSTMerger::SetThreads(unsigned int n)
+{
+#ifdef MULTI_THREAD
+    threads = (n > 0) ? n : 1;
+#else
+    // no threads at all, the inputs are copied one by one
+    (void) n;
+    threads = 1;
+#endif
+}
+
+// merge the inputs into output in the given order
+bool PRadDSTMerger::Merge(const std::vector<std::string> &inputs, const std::string &output)
+{
+    merged_bytes = 0;
+    merged_records = 0;
+
+    if(std::find(inputs.begin(), inputs.end(), output) != inputs.end()) {
+        std::cerr << "DST Merger: Output \"" << output << "\" is one of the inputs."
+                  << std::endl;
+        return false;
+    }
+
+    std::vector<std::unique_ptr<PRadDSTReader>> readers;
+    for(auto &path : inputs)
+    {
+        readers.emplace_back(new PRadDSTReader());
+        if(!readers.back()->Open(path))
+            return false;
+    }
+
+    if(readers.empty())
+        return false;
+
+    // the contents can only be copied if they have the same layout
+    uint16_t version = readers.front()->GetVersion();
+    for(auto &reader : readers)
+    {
+        if(reader->GetVersion() != version) {
+            std::cerr << "DST Merger: Inputs have different versions, "
+                      << "merging them record by record."
+                      << std::endl;
+            readers.clear();
+            return mergeRecords(inputs, output);
+        }
+    }
+
+    // place of every input in the output
+    std::vector<int64_t> begins, ends, places;
+    int64_t pos = DST_CONTENT_BEGIN;
+    for(auto &reader : readers)
+    {
+        begins.push_back(DST_CONTENT_BEGIN);
+        ends.push_back(content_end(*reader));
+        places.push_back(pos);
+        pos += ends.back() - begins.back();
+    }
+    int64_t content_length = pos;
+
+    // combined map with the shifted positions
+    PRadDSTParser::Map out_map;
+    for(size_t i = 0; i < readers.size(); ++i)
+    {
+        for(uint16_t t = 0; t < static_cast<uint16_t>(Type::max_type); ++t)
+        {
+            Type type = static_cast<Type>(t);
+            auto &offsets = out_map.GetType(type);
+            for(auto &off : readers[i]->GetOffsets(type))
+                offsets.push_back(off - begins[i] + places[i]);
+        }
+        merged_records += readers[i]->GetEventCount() + readers[i]->GetEPICSCount()
+                          + readers[i]->GetReconCount();
+    }
+
+    int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        std::cerr << "DST Merger: Cannot open output file "
+                  << "\"" << output << "\" (" << strerror(errno) << ")."
+                  << std::endl;
+        return false;
+    }
+
+    // file header and content length
+    char head[DST_CONTENT_BEGIN];
+    Header file_header(PRadDSTParser::FileHeader, version, sizeof(int64_t));
+    memcpy(head, &file_header, sizeof(file_header));
+    memcpy(head + sizeof(file_header), &content_length, sizeof(content_length));
+    bool success = write_at(fd, head, sizeof(head), 0);
+
+    // copy the contents, every thread takes the next input
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto copy_inputs = [&] ()
+                       {
+                           size_t i;
+                           while((i = next++) < readers.size())
+                           {
+                               const char *data = readers[i]->GetData() + begins[i];
+                               if(!write_at(fd, data, ends[i] - begins[i], places[i])) {
+                                   std::cerr << "DST Merger: Failed to copy \"" << inputs[i]
+                                             << "\" (" << strerror(errno) << ")."
+                                             << std::endl;
+                                   failed = true;
+                               }
+                           }
+                       };
+
+#ifdef MULTI_THREAD
+    std::vector<std::thread> workers;
+    unsigned int nthreads = std::min<size_t>(threads, readers.size());
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(copy_inputs);
+    copy_inputs();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    copy_inputs();
+#endif
+    success = success && !failed;
+
+    // event map after the contents, in the same format as the parser
+    for(uint16_t t = 0; success && t < out_map.maps.size(); ++t)
+    {
+        const auto &cur_map = out_map.GetType(static_cast<Type>(t));
+        uint32_t size = cur_map.size();
+        Header map_header(PRadDSTParser::MapHeader, t, size*sizeof(int64_t) + sizeof(size));
+
+        char map_head[sizeof(Header) + sizeof(uint32_t)];
+        memcpy(map_head, &map_header, sizeof(map_header));
+        memcpy(map_head + sizeof(map_header), &size, sizeof(size));
+        success = write_at(fd, map_head, sizeof(map_head), pos) &&
+                  write_at(fd, (const char*) cur_map.data(), size*sizeof(int64_t),
+                           pos + sizeof(map_head));
+        pos += sizeof(map_head) + size*sizeof(int64_t);
+    }
+
+    // summary of the inputs after the map
+    PRadRunSummary summary, input_summary;
+    for(auto &reader : readers)
+    {
+        if(reader->GetSummary(input_summary))
+            summary.Merge(input_summary);
+        else
+            summary.SetComplete(false);
+    }
+    std::vector<char> sum_rec;
+    PRadDSTParser::EncodeSummary(summary, sum_rec);
+    success = success && write_at(fd, sum_rec.data(), sum_rec.size(), pos);
+
+    if(close(fd) < 0)
+        success = false;
+
+    if(success)
+        merged_bytes = content_length - DST_CONTENT_BEGIN;
+    return success;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// merge through the parser, the records are converted to the current version
+bool PRadDSTMerger::mergeRecords(const std::vector<std::string> &inputs, const std::string &output)
+{
+    PRadDSTParser dst_parser;
+    dst_parser.SetAsyncOutput(true);
+    dst_parser.OpenOutput(output);
+
+    bool success = true;
+    for(auto &path : inputs)
+    {
+        dst_parser.OpenInput(path);
+        // the copied records are not in the output summary
+        if(dst_parser.HasInputSummary())
+            dst_parser.GetOutputSummary().Merge(dst_parser.GetInputSummary());
+
+        try {
+            while(dst_parser.Read())
+            {
+                switch(dst_parser.EventType())
+                {
+                case Type::event:
+                    dst_parser.WriteEvent();
+                    break;
+                case Type::epics:
+                    dst_parser.WriteEPICS();
+                    break;
+                case Type::recon:
+                    dst_parser.WriteRecon();
+                    break;
+                default:
+                    break;
+                }
+                merged_records++;
+            }
+        } catch(PRadException &e) {
+            std::cerr << e.FailureType() << ": "
+                      << e.FailureDesc() << std::endl;
+            success = false;
+        }
+
+        dst_parser.CloseInput();
+    }
+
+    dst_parser.CloseOutput();
+    merged_bytes = dst_parser.GetWriteStats().bytes;
+    return success;
+}
@@ -7,9 +7,45 @@
 
 #include <iostream>
 #include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
 #include "PRadDSTParser.h"
-
-#define DST_FILE_VERSION 0x22  // current version
+#include "PRadProfiler.h"
+#include "PRadMetrics.h"
+#include "PRadDSTReader.h"
+#include "PRadAsyncIO.h"
+
+#define DST_FILE_VERSION 0x40  // current version
+#define DST_FILE_VERSION_CHUNK 0x41  // chunked version
+// old versions without the record checksums
+#define DST_FILE_VERSION_V30 0x30
+#define DST_FILE_VERSION_V31 0x31
+// old versions without the bank lengths, they can still be read
+#define DST_FILE_VERSION_V22 0x22
+#define DST_FILE_VERSION_V23 0x23
+
+// chunk codecs
+#define DST_CODEC_NONE 0
+#define DST_CODEC_ZSTD 1
+#define DST_CHUNK_HEAD 12    // nevents (4), codec (1), reserved (3), raw size (4)
+
+// delta epics record, the mark is in place of the number of values, followed
+// by the number of channels, the number of changed ones, their ids and values
+#define DST_EPICS_DELTA 0xffffffff
+#define DST_EPICS_DELTA_HEAD 16  // event number (4), mark (4), nchannels (4), nchanged (4)
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+// crc32c instruction of sse4.2, it is checked at runtime
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define DST_CRC32C_SSE42
+#endif
 
 
 
@@ -65,12 +101,8 @@ inline T buf_read(const char *buf, uint32_t max_size, uint32_t &idx)
     }
 
     T result;
-    char *ptr = (char*) &result;
-    for(uint32_t i = 0; i < size; ++i, ++idx, ++ptr)
-    {
-        *ptr = buf[idx];
-    }
-
+    memcpy(&result, buf + idx, size);
+    idx += size;
     return result;
 }
 
@@ -81,23 +113,51 @@ inline void buf_read(const char *buf, uint32_t max_size, uint32_t &idx, T &val)
     val = buf_read<T>(buf, max_size, idx);
 }
 
-// write to char array
+// write to char array, the range is checked for the whole record by caller
 template<typename T>
-inline void buf_write(char *buf, uint32_t max_size, uint32_t &idx, T val)
+inline void buf_write(char *buf, uint32_t &idx, const T &val)
 {
-    uint32_t size = sizeof(T);
-    if(idx + size >= max_size) {
-        std::cerr << "exceeds buffer size limit! "
-                  << idx + size << " > " << max_size
+    memcpy(buf + idx, &val, sizeof(T));
+    idx += sizeof(T);
+}
+
+// write an array of values to char array
+template<typename T>
+inline void buf_write(char *buf, uint32_t &idx, const T *vals, uint32_t n)
+{
+    if(!n) return;
+    memcpy(buf + idx, vals, n*sizeof(T));
+    idx += n*sizeof(T);
+}
+
+// size of vector in buffer, size followed by the elements
+template<typename T>
+inline uint32_t vec_write_size(const std::vector<T> &vec)
+{
+    return sizeof(uint32_t) + vec.size()*sizeof(T);
+}
+
+// read vector from char array, auto determine type
+// the elements are copied in one block, the memory of vector is reused
+template<typename T>
+inline void read_vector(const char *buf, uint32_t max_size, uint32_t &idx, std::vector<T> &vec)
+{
+    uint32_t size = buf_read<uint32_t>(buf, max_size, idx);
+    vec.clear();
+
+    uint64_t bytes = (uint64_t)size*sizeof(T);
+    if(idx + bytes > max_size) {
+        std::cerr << "exceeds read-in buffer range! "
+                  << idx + bytes << " > " << max_size
                   << std::endl;
+        idx = max_size;
         return;
     }
 
-    char *ptr = (char*) &val;
-    for(uint32_t i = 0; i < size; ++i, ++idx, ++ptr)
-    {
-        buf[idx] = *ptr;
-    }
+    if(!size) return;
+    vec.resize(size);
+    memcpy(&vec[0], buf + idx, bytes);
+    idx += bytes;
 }
 
 // read vector from char array
@@ -105,29 +165,475 @@ template<typename T>
 inline std::vector<T> read_vector(const char *buf, uint32_t max_size, uint32_t &idx)
 {
     std::vector<T> res;
-    uint32_t size = buf_read<uint32_t>(buf, max_size, idx);
-    res.reserve(size);
+    read_vector(buf, max_size, idx, res);
+    return res;
+}
+
+// write vector to char array
+template<typename T>
+inline void write_vector(char *buf, uint32_t &idx, const std::vector<T> &vec)
+{
+    buf_write(buf, idx, (uint32_t)vec.size());
+    buf_write(buf, idx, vec.data(), vec.size());
+}
 
-    for(uint32_t i = 0; i < size; ++i)
-        res.push_back(buf_read<T>(buf, max_size, idx));
+// variable length integer, 7 bits per byte
+inline void var_write(std::vector<char> &buf, uint32_t val)
+{
+    while(val >= 0x80)
+    {
+        buf.push_back((char)(val | 0x80));
+        val >>= 7;
+    }
+    buf.push_back((char)val);
+}
 
-    return res;
+inline bool var_read(const char *buf, size_t max_size, size_t &idx, uint32_t &val)
+{
+    val = 0;
+    for(int shift = 0; shift < 35; shift += 7)
+    {
+        if(idx >= max_size)
+            return false;
+        uint8_t byte = buf[idx++];
+        val |= (uint32_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
 }
 
-// read vector from char array, auto determine type
+// signed difference to unsigned, small differences have small values
+inline uint32_t zigzag_encode(int32_t val)
+{
+    return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+}
+
+inline int32_t zigzag_decode(uint32_t val)
+{
+    return (int32_t)(val >> 1) ^ -(int32_t)(val & 1);
+}
+
+// append values to a growing buffer
 template<typename T>
-inline void read_vector(const char *buf, uint32_t max_size, uint32_t &idx, std::vector<T> &vec)
+inline void vec_append(std::vector<char> &buf, const T *vals, size_t n)
 {
-    vec = read_vector<T>(buf, max_size, idx);
+    const char *ptr = (const char*) vals;
+    buf.insert(buf.end(), ptr, ptr + n*sizeof(T));
 }
 
-// write vector to char array
 template<typename T>
-inline void write_vector(char *buf, uint32_t max_size, uint32_t &idx, const std::vector<T> &vec)
+inline void vec_append(std::vector<char> &buf, const T &val)
+{
+    vec_append(buf, &val, 1);
+}
+
+template<typename T>
+inline bool raw_read(const char *buf, size_t max_size, size_t &idx, T *vals, size_t n)
+{
+    if(idx + n*sizeof(T) > max_size)
+        return false;
+    memcpy(vals, buf + idx, n*sizeof(T));
+    idx += n*sizeof(T);
+    return true;
+}
+
+// channel data in chunk, the delta of channel ids followed by the 16-bit
+// values, the ids are usually sorted so that the deltas are small
+inline void write_channels(std::vector<char> &buf, const std::vector<ChannelData> &data)
+{
+    var_write(buf, data.size());
+    int32_t prev = 0;
+    for(auto &ch : data)
+    {
+        var_write(buf, zigzag_encode((int32_t)ch.channel_id - prev));
+        prev = ch.channel_id;
+    }
+    for(auto &ch : data)
+        vec_append(buf, ch.value);
+}
+
+inline bool read_channels(const char *buf, size_t max_size, size_t &idx,
+                          std::vector<ChannelData> &data)
+{
+    uint32_t size;
+    // every channel takes at least 3 bytes
+    if(!var_read(buf, max_size, idx, size) || (uint64_t)size*3 > max_size - idx)
+        return false;
+
+    data.resize(size);
+    int32_t prev = 0;
+    for(auto &ch : data)
+    {
+        uint32_t delta;
+        if(!var_read(buf, max_size, idx, delta))
+            return false;
+        prev += zigzag_decode(delta);
+        ch.channel_id = prev;
+    }
+    for(auto &ch : data)
+    {
+        if(!raw_read(buf, max_size, idx, &ch.value, 1))
+            return false;
+    }
+    return true;
+}
+
+// the bank lengths are saved before the banks since version 3.0
+inline bool has_bank_lengths(uint16_t ver)
+{
+    return ver >= DST_FILE_VERSION_V30;
+}
+
+// the records are copied as they are between these versions, only the
+// checksums are different
+inline bool plain_layout(uint16_t ver)
+{
+    return (ver == DST_FILE_VERSION) || (ver == DST_FILE_VERSION_V30);
+}
+
+inline bool chunk_layout(uint16_t ver)
+{
+    return (ver == DST_FILE_VERSION_CHUNK) || (ver == DST_FILE_VERSION_V31);
+}
+
+// crc32c (Castagnoli) table, reflected polynomial 0x82f63b78
+struct crc32c_table
+{
+    uint32_t vals[256];
+
+    crc32c_table()
+    {
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for(int k = 0; k < 8; ++k)
+                crc = (crc & 1) ? (crc >> 1) ^ 0x82f63b78 : (crc >> 1);
+            vals[i] = crc;
+        }
+    }
+};
+
+inline uint32_t crc32c_soft(uint32_t crc, const unsigned char *buf, size_t size)
+{
+    static const crc32c_table table;
+    for(size_t i = 0; i < size; ++i)
+        crc = table.vals[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef DST_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+inline uint32_t crc32c_sse42(uint32_t crc, const unsigned char *buf, size_t size)
+{
+    uint64_t crc64 = crc;
+    for(; size >= sizeof(uint64_t); size -= sizeof(uint64_t), buf += sizeof(uint64_t))
+    {
+        uint64_t val;
+        memcpy(&val, buf, sizeof(val));
+        crc64 = _mm_crc32_u64(crc64, val);
+    }
+
+    crc = static_cast<uint32_t>(crc64);
+    for(; size > 0; --size, ++buf)
+        crc = _mm_crc32_u8(crc, *buf);
+    return crc;
+}
+#endif
+
+// one map for each type, directly written to the stream since it can be huge
+inline void write_map(std::ostream &os, const PRadDSTParser::Map &map)
+{
+    typedef PRadDSTParser::Type Type;
+    for(uint16_t i = 0; i < map.maps.size(); ++i)
+    {
+        const auto &cur_map = map.GetType(static_cast<Type>(i));
+        uint32_t size = cur_map.size();
+        ost_write(os, PRadDSTParser::Header(PRadDSTParser::MapHeader, i,
+                                            vec_buf_size(cur_map) + sizeof(size)));
+        ost_write(os, size);
+        os.write((const char*) cur_map.data(), vec_buf_size(cur_map));
+    }
+}
+
+// the summary record follows the maps, they are skipped by their lengths
+inline bool read_summary(std::istream &is, int64_t pos, PRadRunSummary &sum)
+{
+    is.clear();
+    is.seekg(pos);
+    while(is.good())
+    {
+        PRadDSTParser::Header header = ist_read<PRadDSTParser::Header>(is);
+        if(!is.good())
+            break;
+
+        if(header.htype == PRadDSTParser::MapHeader) {
+            is.seekg(header.length, is.cur);
+            continue;
+        }
+
+        if(header.htype != PRadDSTParser::SummaryHeader)
+            break;
+
+        std::vector<char> rec(sizeof(header) + header.length + sizeof(uint32_t));
+        memcpy(&rec[0], &header, sizeof(header));
+        is.read(&rec[sizeof(header)], rec.size() - sizeof(header));
+        if(!is.good())
+            break;
+        return PRadDSTParser::DecodeSummary(rec.data(), rec.size(), sum);
+    }
+
+    is.clear();
+    return false;
+}
+
+// size of a checkpoint record with n positions
+inline uint64_t checkpoint_size(uint64_t n)
+{
+    return 2*sizeof(int64_t) + 3*sizeof(uint64_t) + sizeof(uint32_t)
+           + static_cast<size_t>(PRadDSTParser::Type::max_type)*sizeof(uint32_t)
+           + n*sizeof(int64_t);
+}
+
+// reserve the bank length, return the position of it
+inline uint32_t open_bank(uint32_t &idx)
+{
+    uint32_t pos = idx;
+    idx += sizeof(uint32_t);
+    return pos;
+}
+
+inline void close_bank(char *buf, uint32_t idx, uint32_t pos)
+{
+    uint32_t bytes = idx - pos - sizeof(uint32_t);
+    memcpy(buf + pos, &bytes, sizeof(bytes));
+}
+
+inline size_t open_bank(std::vector<char> &buf)
+{
+    size_t pos = buf.size();
+    buf.resize(pos + sizeof(uint32_t));
+    return pos;
+}
+
+inline void close_bank(std::vector<char> &buf, size_t pos)
+{
+    uint32_t bytes = buf.size() - pos - sizeof(uint32_t);
+    memcpy(&buf[pos], &bytes, sizeof(bytes));
+}
+
+// maximum size of an event encoded in chunk
+inline uint64_t chunk_event_bound(const EventData &ev)
+{
+    return sizeof(ev.event_number) + sizeof(ev.type) + sizeof(ev.trigger)
+           + sizeof(ev.timestamp) + 4*5 + 4*sizeof(uint32_t)
+           + (ev.adc_data.size() + ev.tdc_data.size())*(5 + sizeof(uint16_t))
+           + ev.gem_data.size()*(sizeof(GEMChannelAddress) + 1 + GEM_MAX_TIME_SAMPLES*sizeof(float))
+           + ev.dsc_data.size()*10;
+}
+
+// encode an event in chunk
+inline void write_chunk_event(std::vector<char> &buf, const EventData &ev)
+{
+    vec_append(buf, ev.event_number);
+    vec_append(buf, ev.type);
+    vec_append(buf, ev.trigger);
+    vec_append(buf, ev.timestamp);
+
+    size_t pos = open_bank(buf);
+    write_channels(buf, ev.adc_data);
+    close_bank(buf, pos);
+
+    pos = open_bank(buf);
+    write_channels(buf, ev.tdc_data);
+    close_bank(buf, pos);
+
+    pos = open_bank(buf);
+    var_write(buf, ev.gem_data.size());
+    for(auto &gem : ev.gem_data)
+    {
+        vec_append(buf, gem.addr);
+        vec_append(buf, gem.nvalues);
+        vec_append(buf, gem.values, gem.nvalues);
+    }
+    close_bank(buf, pos);
+
+    pos = open_bank(buf);
+    var_write(buf, ev.dsc_data.size());
+    for(auto &dsc : ev.dsc_data)
+    {
+        var_write(buf, dsc.gated_count);
+        var_write(buf, dsc.ungated_count);
+    }
+    close_bank(buf, pos);
+}
+
+// gem hits in chunk
+inline bool read_chunk_gem(const char *buf, size_t max_size, size_t &idx,
+                           std::vector<GEM_Data> &data)
+{
+    uint32_t size;
+    if(!var_read(buf, max_size, idx, size) || (uint64_t)size*4 > max_size - idx)
+        return false;
+
+    data.resize(size);
+    for(auto &gem : data)
+    {
+        if(!raw_read(buf, max_size, idx, &gem.addr, 1) ||
+           !raw_read(buf, max_size, idx, &gem.nvalues, 1) ||
+           gem.nvalues > GEM_MAX_TIME_SAMPLES ||
+           !raw_read(buf, max_size, idx, gem.values, gem.nvalues))
+            return false;
+    }
+    return true;
+}
+
+// dsc data in chunk
+inline bool read_chunk_dsc(const char *buf, size_t max_size, size_t &idx,
+                           std::vector<DSC_Data> &data)
+{
+    uint32_t size;
+    if(!var_read(buf, max_size, idx, size) || (uint64_t)size*2 > max_size - idx)
+        return false;
+
+    data.resize(size);
+    for(auto &dsc : data)
+    {
+        if(!var_read(buf, max_size, idx, dsc.gated_count) ||
+           !var_read(buf, max_size, idx, dsc.ungated_count))
+            return false;
+    }
+    return true;
+}
+
+// decode an event in chunk, the banks not in mask are skipped with their
+// lengths, or decoded and cleared for the old version without lengths
+inline bool read_chunk_event(const char *buf, size_t max_size, EventData &ev,
+                             uint32_t mask, bool lengths)
+{
+    size_t idx = 0;
+    if(!raw_read(buf, max_size, idx, &ev.event_number, 1) ||
+       !raw_read(buf, max_size, idx, &ev.type, 1) ||
+       !raw_read(buf, max_size, idx, &ev.trigger, 1) ||
+       !raw_read(buf, max_size, idx, &ev.timestamp, 1))
+        return false;
+
+    for(uint32_t bank = PRadDSTParser::ADC_Bank; bank <= PRadDSTParser::DSC_Bank; bank <<= 1)
+    {
+        size_t end = max_size;
+        if(lengths) {
+            uint32_t bytes;
+            if(!raw_read(buf, max_size, idx, &bytes, 1) || idx + bytes > max_size)
+                return false;
+            end = idx + bytes;
+        }
+
+        bool skip = lengths && !(mask & bank);
+        bool success = true;
+        switch(bank)
+        {
+        case PRadDSTParser::ADC_Bank:
+            if(skip) ev.adc_data.clear();
+            else success = read_channels(buf, end, idx, ev.adc_data);
+            break;
+        case PRadDSTParser::TDC_Bank:
+            if(skip) ev.tdc_data.clear();
+            else success = read_channels(buf, end, idx, ev.tdc_data);
+            break;
+        case PRadDSTParser::GEM_Bank:
+            if(skip) ev.gem_data.clear();
+            else success = read_chunk_gem(buf, end, idx, ev.gem_data);
+            break;
+        case PRadDSTParser::DSC_Bank:
+            if(skip) ev.dsc_data.clear();
+            else success = read_chunk_dsc(buf, end, idx, ev.dsc_data);
+            break;
+        default:
+            break;
+        }
+
+        if(!success)
+            return false;
+        if(lengths)
+            idx = end;
+    }
+
+    // old version, the banks are decoded anyway
+    if(!(mask & PRadDSTParser::ADC_Bank)) ev.adc_data.clear();
+    if(!(mask & PRadDSTParser::TDC_Bank)) ev.tdc_data.clear();
+    if(!(mask & PRadDSTParser::GEM_Bank)) ev.gem_data.clear();
+    if(!(mask & PRadDSTParser::DSC_Bank)) ev.dsc_data.clear();
+
+    return true;
+}
+
+// skip a vector in char array
+template<typename T>
+inline void skip_vector(const char *buf, uint32_t max_size, uint32_t &idx)
+{
+    uint32_t size = buf_read<uint32_t>(buf, max_size, idx);
+    uint64_t end = idx + (uint64_t)size*sizeof(T);
+    idx = (end > max_size) ? max_size : end;
+}
+
+// gem hits in char array, every hit has a vector of time samples
+inline void read_gem_bank(const char *buf, uint32_t max_size, uint32_t &idx,
+                          std::vector<GEM_Data> &data, bool skip)
+{
+    uint32_t gem_size = buf_read<uint32_t>(buf, max_size, idx);
+
+    // resize to keep the memory of existing hits
+    if(skip)
+        data.clear();
+    else
+        data.resize(gem_size);
+
+    for(uint32_t i = 0; i < gem_size && idx < max_size; ++i)
+    {
+        GEMChannelAddress addr = buf_read<GEMChannelAddress>(buf, max_size, idx);
+        uint32_t nvals = buf_read<uint32_t>(buf, max_size, idx);
+        if(idx + (uint64_t)nvals*sizeof(float) > max_size) {
+            std::cerr << "exceeds read-in buffer range! "
+                      << idx + (uint64_t)nvals*sizeof(float) << " > "
+                      << max_size << std::endl;
+            idx = max_size;
+            break;
+        }
+
+        if(!skip) {
+            // samples beyond the maximum are read but discarded
+            auto &gemhit = data[i];
+            uint32_t nkeep = std::min<uint32_t>(nvals, GEM_MAX_TIME_SAMPLES);
+            gemhit.addr = addr;
+            memcpy(gemhit.values, buf + idx, nkeep*sizeof(float));
+            gemhit.nvalues = nkeep;
+        }
+        idx += nvals*sizeof(float);
+    }
+}
+
+// the range of i-th event in a raw chunk, false if it is invalid
+inline bool chunk_event_range(const std::vector<char> &raw, uint32_t i,
+                              uint32_t &begin, uint32_t &end)
+{
+    uint32_t nevents = PRadDSTParser::ChunkEventCount(raw);
+    if(i >= nevents)
+        return false;
+
+    size_t table = raw.size() - (nevents + 2)*sizeof(uint32_t);
+    memcpy(&begin, &raw[table + i*sizeof(uint32_t)], sizeof(begin));
+    memcpy(&end, &raw[table + (i + 1)*sizeof(uint32_t)], sizeof(end));
+    return begin <= end && end <= table;
+}
+
+// check the record size against the buffer
+inline void check_write_size(uint64_t size, uint32_t max_size)
+throw(PRadException)
 {
-    buf_write(buf, max_size, idx, (uint32_t)vec.size());
-    for(auto &ele : vec)
-        buf_write(buf, max_size, idx, ele);
+    if(size > max_size) {
+        throw PRadException("WRITE DST", "record size (" + std::to_string(size)
+                            + ") exceeds buffer size (" + std::to_string(max_size) + ")!");
+    }
 }
 
 
@@ -138,10 +644,18 @@ inline void write_vector(char *buf, uint32_t max_size, uint32_t &idx, const std:
 
 // constructor
 PRadDSTParser::PRadDSTParser(uint32_t size)
-: content_length(0), buf_size(size)
+: content_length(0), buf_size(size), in_recovered(false), in_updated(false), in_has_summary(false),
+  async_out(false), writer_stop(false), out_pos(0), chunk_size(0), chunk_level(DST_CHUNK_LEVEL),
+  chunk_count(0), chunk_index(0), ckpt_interval(DST_CHECKPOINT_RECORDS), ckpt_records(0),
+  ckpt_last(-1), out_events(0), out_epics(0), out_recons(0), epics_keyframe(0), epics_since(0),
+  epics_index(-1), epics_applied(0), upd_active(false), upd_base(0), upd_records(0)
 {
+    in_version = DST_FILE_VERSION;
+    bank_mask = All_Banks;
     in_buf = new char[size];
     out_buf = new char[size];
+    // chunks are allocated on their first use
+    free_chunks.resize(DST_WRITE_QUEUE - 1);
 }
 
 PRadDSTParser::~PRadDSTParser()
@@ -165,6 +679,7 @@ void PRadDSTParser::OpenOutput(const std::string &path, std::ios::openmode mode)
     CloseOutput();
 
     dst_out.open(path, mode);
+    out_path = path;
 
     if(!dst_out.is_open()) {
         std::cerr << "DST Parser: Cannot open output file "
@@ -174,10 +689,120 @@ void PRadDSTParser::OpenOutput(const std::string &path, std::ios::openmode mode)
     }
 
     // save header information
-    ost_write(dst_out, Header(FileHeader, DST_FILE_VERSION, sizeof(int64_t)));
+    uint16_t version = chunk_size ? DST_FILE_VERSION_CHUNK : DST_FILE_VERSION;
+    ost_write(dst_out, Header(FileHeader, version, sizeof(int64_t)));
 
     // save content length
     ost_write(dst_out, (int64_t)dst_out.tellp());
+
+    out_pos = dst_out.tellp();
+    write_stats.Reset();
+    chunk_data.clear();
+    chunk_offsets.clear();
+
+    // no checkpoint yet
+    out_map.Clear();
+    ckpt_marks.assign(out_map.maps.size(), 0);
+    ckpt_records = 0;
+    ckpt_last = -1;
+    out_events = out_epics = out_recons = 0;
+    out_summary.Clear();
+
+    // the first epics record is a keyframe
+    epics_since = 0;
+    epics_last.clear();
+}
+
+// continue writing an output file from its last checkpoint, the records after
+// the checkpoint are discarded, and the map is restored from the file
+// it returns false if the file cannot be resumed, the file is unchanged then
+bool PRadDSTParser::ResumeOutput(const std::string &path, Checkpoint &ckpt)
+{
+    CloseOutput();
+
+    uint16_t version = chunk_size ? DST_FILE_VERSION_CHUNK : DST_FILE_VERSION;
+    int64_t resume_end;
+    {
+        PRadDSTReader reader;
+        if(!reader.Open(path))
+            return false;
+
+        if(reader.GetVersion() != version) {
+            std::cerr << "DST Parser: Cannot resume \"" << path << "\" of version "
+                      << dst_ver_str(reader.GetVersion()) << ", the output version is "
+                      << dst_ver_str(version) << "."
+                      << std::endl;
+            return false;
+        }
+
+        size_t nckpt = reader.GetCount(Type::checkpoint);
+        PRadDSTReader::Record rec;
+        if(nckpt)
+            rec = reader.GetRecord(Type::checkpoint, nckpt - 1);
+        if(!rec.Valid() || !DecodeCheckpoint(rec.data, rec.Length(), ckpt) ||
+           ckpt.position != reader.GetOffsets(Type::checkpoint).back()) {
+            std::cerr << "DST Parser: No valid checkpoint in \"" << path << "\" to resume."
+                      << std::endl;
+            return false;
+        }
+
+        // the records before the checkpoint and itself
+        resume_end = ckpt.position + sizeof(Header) + rec.Length() + ChecksumSize(version);
+        out_map.Clear();
+        for(size_t t = 0; t < out_map.maps.size(); ++t)
+        {
+            Type type = static_cast<Type>(t);
+            for(auto &off : reader.GetOffsets(type))
+            {
+                if(off < resume_end)
+                    out_map.Add(type, off);
+            }
+        }
+    }
+
+    if(truncate(path.c_str(), resume_end) < 0) {
+        std::cerr << "DST Parser: Cannot truncate \"" << path << "\" to resume ("
+                  << strerror(errno) << ")."
+                  << std::endl;
+        out_map.Clear();
+        return false;
+    }
+
+    dst_out.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    out_path = path;
+    if(!dst_out.is_open()) {
+        std::cerr << "DST Parser: Cannot open output file "
+                  << "\"" << path << "\"!"
+                  << std::endl;
+        out_map.Clear();
+        return false;
+    }
+
+    // the content length is reset, so the file is still recognized as not
+    // closed until it is closed
+    dst_out.seekp(sizeof(Header));
+    ost_write(dst_out, (int64_t)DST_CONTENT_BEGIN);
+    dst_out.seekp(resume_end);
+
+    out_pos = resume_end;
+    write_stats.Reset();
+    chunk_data.clear();
+    chunk_offsets.clear();
+
+    // continue from the checkpoint
+    ckpt_marks.clear();
+    for(auto &m : out_map.maps)
+        ckpt_marks.push_back(m.size());
+    ckpt_records = 0;
+    ckpt_last = ckpt.position;
+    out_events = ckpt.events;
+    out_epics = ckpt.epics;
+    out_recons = ckpt.recons;
+
+    // the values before the checkpoint are not known, start with a keyframe
+    epics_since = 0;
+    epics_last.clear();
+    return true;
 }
 
 // close output file, save file related information (length, map)
@@ -186,6 +811,17 @@ void PRadDSTParser::CloseOutput()
     if(!dst_out.is_open())
         return;
 
+    // the last chunk
+    try {
+        saveChunk();
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": "
+                  << e.FailureDesc() << std::endl;
+    }
+
+    // finish the asynchronous output
+    flushOutput();
+
     // write content length
     int64_t content_end = dst_out.tellp();
     // skip header
@@ -195,21 +831,223 @@ void PRadDSTParser::CloseOutput()
     // back to the position
     dst_out.seekp(content_end);
 
-    // write event map
+    // write event map and the summary after it
     writeMap();
+    writeSummary();
     dst_out.close();
 }
 
-// open input file
-void PRadDSTParser::OpenInput(const std::string &path, std::ios::openmode mode)
+// open a closed file for the in-place update, the records are replaced by
+// the ones of the same type, and the replacements are appended on commit
+bool PRadDSTParser::OpenUpdate(const std::string &path)
 {
-    CloseInput();
-    dst_in.open(path, mode);
+    CloseUpdate();
+    CloseOutput();
 
-    if(!dst_in.is_open()) {
-        std::cerr << "DST Parser: Cannot open input file "
-                  << "\"" << path << "\"!"
-                  << std::endl;
+    OpenInput(path);
+    if(!dst_in.is_open())
+        return false;
+
+    // the replacements are encoded in the current layouts
+    if(in_version != DST_FILE_VERSION && in_version != DST_FILE_VERSION_CHUNK) {
+        std::cerr << "DST Parser: Cannot update \"" << path << "\" of version "
+                  << dst_ver_str(in_version) << ", copy it to the current version first."
+                  << std::endl;
+        CloseInput();
+        return false;
+    }
+
+    if(in_recovered || !ReadMap()) {
+        std::cerr << "DST Parser: Cannot update \"" << path << "\", it was not "
+                  << "closed properly or has no map."
+                  << std::endl;
+        CloseInput();
+        return false;
+    }
+
+    // the update record is appended after the map
+    int64_t cur_pos = dst_in.tellg();
+    dst_in.seekg(0, dst_in.end);
+    upd_base = dst_in.tellg();
+    dst_in.seekg(cur_pos);
+
+    upd_types.clear();
+    for(size_t t = 0; t < in_map.maps.size(); ++t)
+    {
+        for(auto &pos : in_map.maps[t])
+            upd_types[pos] = static_cast<Type>(t);
+    }
+
+    upd_path = path;
+    upd_buf.clear();
+    upd_pairs.clear();
+    upd_active = true;
+    return true;
+}
+
+bool PRadDSTParser::Replace(int64_t pos, const EventData &ev)
+{
+    // a plain event record, the chunk size is restored after writing
+    uint32_t csize = chunk_size;
+    chunk_size = 0;
+    bool res = replace(pos, Type::event, [this, &ev] () {Write(ev);});
+    chunk_size = csize;
+    return res;
+}
+
+bool PRadDSTParser::Replace(int64_t pos, const EpicsData &ep)
+{
+    return replace(pos, Type::epics, [this, &ep] () {Write(ep);});
+}
+
+bool PRadDSTParser::Replace(int64_t pos, const ReconData &rec)
+{
+    return replace(pos, Type::recon, [this, &rec] () {Write(rec);});
+}
+
+// the events are packed into one chunk, it fails if they do not fit in the
+// buffer size
+bool PRadDSTParser::ReplaceChunk(int64_t pos, const std::vector<EventData> &events)
+{
+    uint32_t csize = chunk_size;
+    chunk_size = events.size() + 1;
+    bool res = replace(pos, Type::chunk, [this, &events] ()
+                                         {
+                                             for(auto &ev : events)
+                                                 Write(ev);
+                                             saveChunk();
+                                         });
+    chunk_size = csize;
+    return res;
+}
+
+// the update record has the replacements, followed by the positions of the
+// replaced records and the replacements relative to the update record, so
+// the positions are kept if the content is moved (such as by PRadDSTMerger)
+// the content length is moved to the new map first, the old map is then
+// overwritten to an empty update record, so it is skipped by the readers
+bool PRadDSTParser::CommitUpdate()
+{
+    if(!upd_active)
+        return false;
+    if(upd_pairs.empty())
+        return true;
+
+    std::vector<char> rec(upd_buf);
+    for(auto &p : upd_pairs)
+    {
+        vec_append(rec, (int64_t)(upd_base - p.first));
+        vec_append(rec, (int64_t)(p.second - upd_base));
+    }
+    vec_append(rec, (uint32_t)upd_pairs.size());
+
+    Header evh(EventHeader, Type::update, rec.size());
+    uint32_t crc = Checksum(rec.data(), rec.size(), Checksum(&evh, sizeof(evh)));
+    int64_t map_pos = upd_base + sizeof(evh) + rec.size() + sizeof(crc);
+
+    // the map with the replacements
+    Map map = in_map;
+    std::unordered_map<int64_t, int64_t> moved(upd_pairs.begin(), upd_pairs.end());
+    for(auto &m : map.maps)
+    {
+        for(auto &off : m)
+        {
+            auto it = moved.find(off);
+            if(it != moved.end())
+                off = it->second;
+        }
+    }
+    map.Add(Type::update, content_length);
+    map.Add(Type::update, upd_base);
+
+    // the old map becomes an empty update record
+    int64_t old_size = upd_base - content_length;
+    if(old_size < (int64_t)(sizeof(Header) + 2*sizeof(uint32_t))) {
+        std::cerr << "DST Parser: Unexpected map size of \"" << upd_path << "\"."
+                  << std::endl;
+        return false;
+    }
+    std::vector<char> old_map(old_size);
+    dst_in.clear();
+    dst_in.seekg(content_length);
+    dst_in.read(old_map.data(), old_size);
+    if(!dst_in.good()) {
+        std::cerr << "DST Parser: Cannot read the map of \"" << upd_path << "\"."
+                  << std::endl;
+        return false;
+    }
+    Header old_evh(EventHeader, Type::update, old_size - sizeof(Header) - sizeof(crc));
+    uint32_t nreplaced = 0;
+    memcpy(&old_map[0], &old_evh, sizeof(old_evh));
+    memcpy(&old_map[old_size - sizeof(crc) - sizeof(nreplaced)], &nreplaced, sizeof(nreplaced));
+    uint32_t old_crc = Checksum(&old_map[sizeof(old_evh)], old_evh.length,
+                                Checksum(&old_evh, sizeof(old_evh)));
+    memcpy(&old_map[old_size - sizeof(crc)], &old_crc, sizeof(old_crc));
+
+    std::fstream f(upd_path, std::ios::in | std::ios::out | std::ios::binary);
+    if(!f.is_open()) {
+        std::cerr << "DST Parser: Cannot open \"" << upd_path << "\" to update."
+                  << std::endl;
+        return false;
+    }
+
+    f.seekp(upd_base);
+    ost_write(f, evh);
+    f.write(rec.data(), rec.size());
+    ost_write(f, crc);
+    write_map(f, map);
+    // the summary is not accumulated from the replacements
+    if(in_has_summary) {
+        PRadRunSummary sum(in_summary);
+        sum.SetComplete(false);
+        std::vector<char> sum_rec;
+        EncodeSummary(sum, sum_rec);
+        f.write(sum_rec.data(), sum_rec.size());
+    }
+    f.flush();
+
+    f.seekp(sizeof(Header));
+    ost_write(f, map_pos);
+    f.flush();
+
+    f.seekp(content_length);
+    f.write(old_map.data(), old_map.size());
+    f.close();
+
+    if(!f.good()) {
+        std::cerr << "DST Parser: Failed to write the update to \"" << upd_path << "\"."
+                  << std::endl;
+        return false;
+    }
+
+    std::string path = upd_path;
+    return OpenUpdate(path);
+}
+
+void PRadDSTParser::CloseUpdate()
+{
+    if(!upd_active)
+        return;
+
+    upd_active = false;
+    upd_buf.clear();
+    upd_pairs.clear();
+    upd_types.clear();
+    chunk_data.clear();
+    chunk_offsets.clear();
+    CloseInput();
+}
+
+// open input file
+void PRadDSTParser::OpenInput(const std::string &path, std::ios::openmode mode)
+{
+    CloseInput();
+    dst_in.open(path, mode);
+
+    if(!dst_in.is_open()) {
+        std::cerr << "DST Parser: Cannot open input file "
+                  << "\"" << path << "\"!"
+                  << std::endl;
         return;
     }
 
@@ -220,7 +1058,7 @@ void PRadDSTParser::OpenInput(const std::string &path, std::ios::openmode mode)
     // read file header
     Header header = ist_read<Header>(dst_in);
 
-    if(!header.Check(FileHeader, DST_FILE_VERSION)) {
+    if(header.htype != FileHeader || !CheckVersion(header.etype)) {
         std::cerr << "DST Parser: Unsupported format from \"" << path << "\".\n"
                   << "Expected version " << dst_ver_str(DST_FILE_VERSION)
                   << ", the file version is " << dst_ver_str(header.etype) << "."
@@ -228,6 +1066,8 @@ void PRadDSTParser::OpenInput(const std::string &path, std::ios::openmode mode)
         dst_in.close();
     }
 
+    in_version = header.etype;
+
     // check length
     content_length = ist_read<int64_t>(dst_in);
     if(content_length > file_length) {
@@ -235,6 +1075,24 @@ void PRadDSTParser::OpenInput(const std::string &path, std::ios::openmode mode)
                   << ">, it exceeds file length <" << file_length << ">."
                   << std::endl;
         dst_in.close();
+        return;
+    }
+
+    // the content length is not updated if the file was not closed properly,
+    // the records are located from the checkpoints and checksums
+    if(content_length == DST_CONTENT_BEGIN && file_length > content_length) {
+        PRadDSTReader reader;
+        if(reader.Open(path)) {
+            content_length = reader.GetContentLength();
+            for(size_t t = 0; t < in_map.maps.size(); ++t)
+                in_map.maps[t] = reader.GetOffsets(static_cast<Type>(t));
+            in_recovered = true;
+        }
+    } else {
+        readUpdates();
+        int64_t cur_pos = dst_in.tellg();
+        in_has_summary = read_summary(dst_in, content_length, in_summary);
+        dst_in.seekg(cur_pos);
     }
 }
 
@@ -242,6 +1100,15 @@ void PRadDSTParser::OpenInput(const std::string &path, std::ios::openmode mode)
 void PRadDSTParser::CloseInput()
 {
     in_map.Clear();
+    in_recovered = false;
+    in_updated = false;
+    in_redirect.clear();
+    in_has_summary = false;
+    in_summary.Clear();
+    chunk_count = chunk_index = 0;
+    epics_chain.clear();
+    epics_index = -1;
+    epics_applied = 0;
     dst_in.close();
 }
 
@@ -250,19 +1117,56 @@ void PRadDSTParser::CloseInput()
 //               true. successfully read
 bool PRadDSTParser::Read(int64_t pos)
 {
-    if(pos > 0) dst_in.seekg(pos);
+    PRAD_PROFILE_SCOPE("DSTParser::Read");
+
+    if(pos > 0) {
+        dst_in.seekg(pos);
+        chunk_count = chunk_index = 0;
+        // the epics records are not followed without the map
+        if(in_map.GetType(Type::epics).empty()) {
+            epics_chain.clear();
+            epics_applied = 0;
+        }
+    } else if(nextChunkEvent()) {
+        // the next event in the current chunk
+        return true;
+    }
+
     if(dst_in.eof() || dst_in.tellg() >= content_length) return false;
 
     try {
+        // the replaced records are read from their updates
+        int64_t resume = -1;
+        if(in_updated && !seekUpdated(resume))
+            return false;
+
+        int64_t rec_pos = dst_in.tellg();
         cur_evh = getBuffer(dst_in);
+        if(resume >= 0)
+            dst_in.seekg(resume);
         Type ev_type = cur_evh.GetType(EventHeader);
 
         // reset in_buf index
         switch(ev_type)
         {
         case Type::event:
+        case Type::recon:
+            return true;
         case Type::epics:
+            trackEPICS(rec_pos);
             return true;
+        case Type::checkpoint:
+            // only used to locate the records
+            return Read();
+        case Type::chunk:
+            if(!UnpackChunk(in_buf, cur_evh.length, chunk_in)) {
+                std::cerr << "READ DST ERROR: Corrupted event chunk." << std::endl;
+                return false;
+            }
+            chunk_count = ChunkEventCount(chunk_in);
+            chunk_index = 0;
+            // an empty chunk is skipped
+            return nextChunkEvent() || Read();
         default:
             std::cerr << "READ DST ERROR: Undefined buffer type = 0x"
                       << std::hex << std::setw(8) << std::setfill('0') << static_cast<int>(ev_type)
@@ -285,6 +1189,18 @@ bool PRadDSTParser::Read(int64_t pos)
     }
 }
 
+// the epics records of the output are delta records between the keyframes
+void PRadDSTParser::SetEPICSDelta(uint32_t nrecords)
+{
+    if(dst_out.is_open()) {
+        std::cerr << "DST Parser: Cannot change the delta EPICS output for an opened file."
+                  << std::endl;
+        return;
+    }
+
+    epics_keyframe = nrecords;
+}
+
 // resize buffer
 void PRadDSTParser::ResizeBuffer(uint32_t size)
 {
@@ -295,53 +1211,133 @@ void PRadDSTParser::ResizeBuffer(uint32_t size)
     buf_size = size;
 }
 
+// write the events in chunks of nevents, 0 disables it, the events in a chunk
+// are encoded together and compressed if the library is built with zstd
+// it should be set before opening the output file
+void PRadDSTParser::SetChunkedOutput(uint32_t nevents, int level)
+{
+    if(dst_out.is_open()) {
+        std::cerr << "DST Parser: Cannot change the chunked output for an opened file."
+                  << std::endl;
+        return;
+    }
+
+    chunk_size = nevents;
+    chunk_level = level;
+}
+
+// the events are serialized on the calling thread, and written in large
+// chunks by a writer thread, so the caller is not blocked by the file output
+void PRadDSTParser::SetAsyncOutput(bool async)
+{
+    if(async == async_out)
+        return;
+
+    if(async_out)
+        flushOutput();
+    else if(dst_out.is_open())
+        out_pos = dst_out.tellp();
+
+    async_out = async;
+}
+
 
 //============================================================================//
 // Read and write data structures                                             //
 //============================================================================//
 
-// write current event
+// write current event, the record is copied without re-encoding if it has the
+// same layout as the output
 void PRadDSTParser::WriteEvent()
 throw(PRadException)
 {
-    try {
-        if(cur_evh.Check(EventHeader, Type::event)) {
-            Write(GetEvent());
-        } else {
-            throw PRadException("WRITE DST", "Current buffer has no event.");
-        }
-    } catch(...) {
-        throw;
-    }
+    const char *buf;
+    uint32_t length;
+    if(!cur_evh.Check(EventHeader, Type::event) || !currentRaw(buf, length))
+        throw PRadException("WRITE DST", "Current buffer has no event.");
+
+    writeRaw(Header(EventHeader, Type::event, length), in_version, chunk_count > 0, buf);
 }
 
 // write given event
 void PRadDSTParser::Write(const EventData &ev)
 throw(PRadException)
 {
-    uint32_t out_idx = 0;
-    // event information
-    buf_write(out_buf, buf_size, out_idx, ev.event_number);
-    buf_write(out_buf, buf_size, out_idx, ev.type);
-    buf_write(out_buf, buf_size, out_idx, ev.trigger);
-    buf_write(out_buf, buf_size, out_idx, ev.timestamp);
+    if(!upd_active)
+        out_summary.Add(ev);
+
+    writeEventData(ev);
+}
+
+// encode the event to the output, it is not added to the summary
+void PRadDSTParser::writeEventData(const EventData &ev)
+throw(PRadException)
+{
+    PRAD_PROFILE_SCOPE("DSTParser::WriteEvent");
+
+    if(chunk_size) {
+        if(!dst_out.is_open() && !upd_active)
+            throw PRadException("WRITE DST", "output file is not opened!");
+
+        // check the size for the whole chunk record
+        uint64_t size = chunk_event_bound(ev);
+        check_write_size(size + DST_CHUNK_HEAD + 3*sizeof(uint32_t), buf_size);
+        if(!chunk_offsets.empty() &&
+           DST_CHUNK_HEAD + chunk_data.size() + size
+           + (chunk_offsets.size() + 3)*sizeof(uint32_t) > buf_size)
+            saveChunk();
+
+        chunk_offsets.push_back(chunk_data.size());
+        write_chunk_event(chunk_data, ev);
+
+        if(chunk_offsets.size() >= chunk_size)
+            saveChunk();
+        return;
+    }
 
-    // data
-    write_vector(out_buf, buf_size, out_idx, ev.adc_data);
-    write_vector(out_buf, buf_size, out_idx, ev.tdc_data);
+    // check the size once for the whole event
+    uint64_t size = sizeof(ev.event_number) + sizeof(ev.type) + sizeof(ev.trigger)
+                    + sizeof(ev.timestamp) + vec_write_size(ev.adc_data)
+                    + vec_write_size(ev.tdc_data) + vec_write_size(ev.dsc_data)
+                    + sizeof(uint32_t) + 4*sizeof(uint32_t);
+    for(auto &gem : ev.gem_data)
+        size += sizeof(gem.addr) + sizeof(uint32_t) + gem.nvalues*sizeof(float);
+    check_write_size(size, buf_size);
 
-    buf_write(out_buf, buf_size, out_idx, (uint32_t)ev.gem_data.size());
+    uint32_t out_idx = 0;
+    // event information
+    buf_write(out_buf, out_idx, ev.event_number);
+    buf_write(out_buf, out_idx, ev.type);
+    buf_write(out_buf, out_idx, ev.trigger);
+    buf_write(out_buf, out_idx, ev.timestamp);
+
+    // data banks, every bank starts with its length so it can be skipped
+    uint32_t pos = open_bank(out_idx);
+    write_vector(out_buf, out_idx, ev.adc_data);
+    close_bank(out_buf, out_idx, pos);
+
+    pos = open_bank(out_idx);
+    write_vector(out_buf, out_idx, ev.tdc_data);
+    close_bank(out_buf, out_idx, pos);
+
+    pos = open_bank(out_idx);
+    buf_write(out_buf, out_idx, (uint32_t)ev.gem_data.size());
     for(auto &gem : ev.gem_data)
     {
-        buf_write(out_buf, buf_size, out_idx, gem.addr);
-        write_vector(out_buf, buf_size, out_idx, gem.values);
+        // same format as a vector, size followed by the values
+        buf_write(out_buf, out_idx, gem.addr);
+        buf_write(out_buf, out_idx, (uint32_t)gem.nvalues);
+        buf_write(out_buf, out_idx, gem.values, gem.nvalues);
     }
+    close_bank(out_buf, out_idx, pos);
 
-    write_vector(out_buf, buf_size, out_idx, ev.dsc_data);
+    pos = open_bank(out_idx);
+    write_vector(out_buf, out_idx, ev.dsc_data);
+    close_bank(out_buf, out_idx, pos);
 
     // save buffer to file
     try {
-        saveBuffer(dst_out, Header(EventHeader, Type::event, out_idx));
+        saveBuffer(dst_out, Header(EventHeader, Type::event, out_idx), out_buf);
     } catch(...) {
         throw;
     }
@@ -352,68 +1348,104 @@ EventData PRadDSTParser::GetEvent()
 const
 {
     EventData ev;
+    GetEvent(ev);
+    return ev;
+}
+
+// read event into an existing event, its memory is reused
+bool PRadDSTParser::GetEvent(EventData &ev)
+const
+{
     if(!cur_evh.Check(EventHeader, Type::event)) {
         std::cerr << "DST Parser: Current buffer has no event." << std::endl;
-        return ev;
-    }
-
-    uint32_t in_idx = 0;
-    // event information
-    buf_read(in_buf, cur_evh.length, in_idx, ev.event_number);
-    buf_read(in_buf, cur_evh.length, in_idx, ev.type);
-    buf_read(in_buf, cur_evh.length, in_idx, ev.trigger);
-    buf_read(in_buf, cur_evh.length, in_idx, ev.timestamp);
-
-    // read all data
-    read_vector(in_buf, cur_evh.length, in_idx, ev.adc_data);
-    read_vector(in_buf, cur_evh.length, in_idx, ev.tdc_data);
-
-    // gem data structure is more complicated, it has a vector inside
-    uint32_t gem_size = buf_read<uint32_t>(in_buf, cur_evh.length, in_idx);
-    for(uint32_t i = 0; i < gem_size; ++i)
-    {
-        GEM_Data gemhit;
-        buf_read(in_buf, cur_evh.length, in_idx, gemhit.addr);
-        read_vector(in_buf, cur_evh.length, in_idx, gemhit.values);
-        ev.add_gemhit(gemhit);
+        ev.clear();
+        return false;
     }
 
-    read_vector(in_buf, cur_evh.length, in_idx, ev.dsc_data);
+    // event from the current chunk
+    if(chunk_count)
+        return DecodeChunkEvent(chunk_in, chunk_index - 1, ev, bank_mask, in_version);
 
-    return ev;
+    return DecodeEvent(in_buf, cur_evh.length, ev, bank_mask, in_version);
 }
 
-// write current epics event
+// write current epics event, a delta record is written with its values, and
+// so are all the records to a delta output, to keep the deltas of the output
 void PRadDSTParser::WriteEPICS()
 throw(PRadException)
 {
-    try {
-        if(cur_evh.Check(EventHeader, Type::epics)) {
-            Write(GetEPICS());
-        } else {
-            throw PRadException("WRITE DST", "Current buffer has no EPICS event.");
-        }
-    } catch(...) {
-        throw;
+    if(!cur_evh.Check(EventHeader, Type::epics))
+        throw PRadException("WRITE DST", "Current buffer has no EPICS event.");
+
+    if(epics_keyframe || IsEPICSDelta(in_buf, cur_evh.length)) {
+        if(!GetEPICS(epics_cache))
+            throw PRadException("WRITE DST", "Cannot reconstruct the EPICS event.");
+        writeEPICSData(epics_cache);
+        return;
     }
+
+    writeRaw(cur_evh, in_version, false, in_buf);
 }
 
 // write given epics event
 void PRadDSTParser::Write(const EpicsData &ep)
 throw(PRadException)
 {
-    uint32_t out_idx = 0;
+    if(!upd_active)
+        out_summary.Add(ep);
 
-    buf_write(out_buf, buf_size, out_idx, ep.event_number);
-    write_vector(out_buf, buf_size, out_idx, ep.values);
+    writeEPICSData(ep);
+}
 
-    // save buffer to file
-    try {
-        saveBuffer(dst_out, Header(EventHeader, Type::epics, out_idx));
-    } catch(...) {
-        throw;
+// the bits are compared, so a channel with nan is not always changed
+inline bool same_value(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// encode the epics event to the output, it is not added to the summary
+// it is a delta record of the changed channels if the delta output is enabled,
+// unless it is time for a keyframe or the delta is not smaller
+void PRadDSTParser::writeEPICSData(const EpicsData &ep)
+throw(PRadException)
+{
+    check_write_size(sizeof(ep.event_number) + vec_write_size(ep.values), buf_size);
+
+    // keep the order of events and epics events
+    saveChunk();
+
+    // the replacements of an update are always keyframes
+    bool delta = epics_keyframe && !upd_active && epics_since > 0 && epics_since < epics_keyframe;
+    if(delta) {
+        epics_ids.clear();
+        for(uint32_t i = 0; i < ep.values.size(); ++i)
+        {
+            if(i >= epics_last.size() || !same_value(ep.values[i], epics_last[i]))
+                epics_ids.push_back(i);
+        }
+        delta = DST_EPICS_DELTA_HEAD + epics_ids.size()*(sizeof(uint32_t) + sizeof(float))
+                < sizeof(ep.event_number) + vec_write_size(ep.values);
     }
 
+    uint32_t out_idx = 0;
+    buf_write(out_buf, out_idx, ep.event_number);
+    if(delta) {
+        buf_write(out_buf, out_idx, (uint32_t)DST_EPICS_DELTA);
+        buf_write(out_buf, out_idx, (uint32_t)ep.values.size());
+        buf_write(out_buf, out_idx, (uint32_t)epics_ids.size());
+        buf_write(out_buf, out_idx, epics_ids.data(), epics_ids.size());
+        for(auto &id : epics_ids)
+            buf_write(out_buf, out_idx, ep.values[id]);
+    } else {
+        write_vector(out_buf, out_idx, ep.values);
+    }
+
+    saveBuffer(dst_out, Header(EventHeader, Type::epics, out_idx), out_buf);
+
+    if(epics_keyframe && !upd_active) {
+        epics_since = delta ? epics_since + 1 : 1;
+        epics_last = ep.values;
+    }
 }
 
 // read epics event
@@ -421,74 +1453,587 @@ EpicsData PRadDSTParser::GetEPICS()
 const
 {
     EpicsData ep;
+    GetEPICS(ep);
+    return ep;
+}
+
+// read epics event into an existing one, its memory is reused
+bool PRadDSTParser::GetEPICS(EpicsData &ep)
+const
+{
     if(!cur_evh.Check(EventHeader, Type::epics)) {
         std::cerr << "DST Parser: Current buffer has no EPICS event." << std::endl;
-        return ep;
+        ep.clear();
+        return false;
     }
 
-    uint32_t in_idx = 0;
-    buf_read(in_buf, cur_evh.length, in_idx, ep.event_number);
-    read_vector(in_buf, cur_evh.length, in_idx, ep.values);
+    if(!IsEPICSDelta(in_buf, cur_evh.length))
+        return DecodeEPICS(in_buf, cur_evh.length, ep);
 
-    return ep;
+    // the records since the keyframe are applied when the values are needed
+    if(epics_chain.empty()) {
+        std::cerr << "DST Parser: No keyframe for the delta EPICS event." << std::endl;
+        ep.clear();
+        return false;
+    }
+
+    while(epics_applied < epics_chain.size())
+    {
+        uint32_t length;
+        memcpy(&length, &epics_chain[epics_applied], sizeof(length));
+        const char *buf = &epics_chain[epics_applied + sizeof(length)];
+        epics_applied += sizeof(length) + length;
+        if(!DecodeEPICS(buf, length, epics_values)) {
+            epics_applied = epics_chain.size();
+            ep.clear();
+            return false;
+        }
+    }
+
+    ep = epics_values;
+    return true;
 }
 
-// write file map
-void PRadDSTParser::writeMap()
+// write current record of reconstructed hits
+void PRadDSTParser::WriteRecon()
 throw(PRadException)
 {
-    // directly write to ofstream since map can be huge
-    try {
-        for(uint16_t i = 0; i < out_map.maps.size(); ++i)
-        {
-            const auto &cur_map = out_map.GetType(static_cast<Type>(i));
-            uint32_t size = cur_map.size();
-            ost_write(dst_out, Header(MapHeader, i, vec_buf_size(cur_map) + sizeof(size)));
-            ost_write(dst_out, size);
-            dst_out.write((char*) &cur_map[0], vec_buf_size(cur_map));
-        }
+    if(!cur_evh.Check(EventHeader, Type::recon))
+        throw PRadException("WRITE DST", "Current buffer has no reconstructed hits.");
 
-        out_map.Clear();
+    writeRaw(cur_evh, in_version, false, in_buf);
+}
+
+// write the reconstructed hits of an event
+// in the chunked output, the record does not flush the current chunk, so it
+// may precede the chunk containing its event, use the event number to match
+void PRadDSTParser::Write(const ReconData &rec)
+throw(PRadException)
+{
+    uint64_t size = sizeof(rec.event_number) + sizeof(rec.config_hash)
+                    + vec_write_size(rec.hycal_hits) + vec_write_size(rec.gem_hits)
+                    + sizeof(uint32_t);
+    for(auto &m : rec.match_hits)
+        size += sizeof(BaseHit) + sizeof(m.hycal) + sizeof(m.gem) + sizeof(m.mflag)
+                + sizeof(m.hycal_idx) + vec_write_size(m.gem1) + vec_write_size(m.gem2);
+    check_write_size(size, buf_size);
+
+    uint32_t out_idx = 0;
+    buf_write(out_buf, out_idx, rec.event_number);
+    buf_write(out_buf, out_idx, rec.config_hash);
+    write_vector(out_buf, out_idx, rec.hycal_hits);
+    write_vector(out_buf, out_idx, rec.gem_hits);
+
+    buf_write(out_buf, out_idx, (uint32_t)rec.match_hits.size());
+    for(auto &m : rec.match_hits)
+    {
+        // the matched coordinates may be substituted by gem
+        buf_write(out_buf, out_idx, static_cast<const BaseHit&>(m));
+        buf_write(out_buf, out_idx, m.hycal);
+        buf_write(out_buf, out_idx, m.gem);
+        buf_write(out_buf, out_idx, m.mflag);
+        buf_write(out_buf, out_idx, m.hycal_idx);
+        write_vector(out_buf, out_idx, m.gem1);
+        write_vector(out_buf, out_idx, m.gem2);
+    }
+
+    try {
+        saveBuffer(dst_out, Header(EventHeader, Type::recon, out_idx), out_buf);
     } catch(...) {
-        out_map.Clear();
         throw;
     }
 }
 
-// read file map
-bool PRadDSTParser::ReadMap()
+// read reconstructed hits
+ReconData PRadDSTParser::GetRecon()
+const
 {
-    if(!dst_in.is_open())
+    ReconData rec;
+    GetRecon(rec);
+    return rec;
+}
+
+// read reconstructed hits into an existing one, its memory is reused
+bool PRadDSTParser::GetRecon(ReconData &rec)
+const
+{
+    if(!cur_evh.Check(EventHeader, Type::recon)) {
+        std::cerr << "DST Parser: Current buffer has no reconstructed hits." << std::endl;
+        rec.clear();
         return false;
+    }
 
-    in_map.Clear();
+    return DecodeRecon(in_buf, cur_evh.length, rec);
+}
 
-    // remember current position
-    int64_t cur_pos = dst_in.tellg();
+// write a record copied from an input
+void PRadDSTParser::WriteRecord(const RawRecord &rec)
+throw(PRadException)
+{
+    if(rec.header.htype != EventHeader || rec.header.length > rec.data.size())
+        throw PRadException("WRITE DST", "Invalid raw record.");
 
-    // to content end, where the map is supposed to be
-    dst_in.seekg(content_length);
+    writeRaw(rec.header, rec.version, rec.in_chunk, rec.data.data());
+}
 
-    Header header = ist_read<Header>(dst_in);
-    Type map_type = header.GetType(MapHeader);
+// copy the bytes of current record, an event from a chunk is copied alone
+bool PRadDSTParser::GetRecord(RawRecord &rec)
+const
+{
+    const char *buf;
+    uint32_t length;
+    if(!currentRaw(buf, length)) {
+        std::cerr << "DST Parser: Current buffer has no record to copy." << std::endl;
+        rec.data.clear();
+        rec.header = Header();
+        return false;
+    }
 
-    switch(map_type)
-    {
-    case Type::event:
-    case Type::epics:
-        {
-            auto &this_map = in_map.GetType(map_type);
-            uint32_t size = ist_read<uint32_t>(dst_in);
-            this_map.resize(size);
-            dst_in.read((char*) &this_map[0], vec_buf_size(this_map));
+    rec.version = in_version;
+    rec.in_chunk = (chunk_count > 0);
+
+    // a delta epics record is copied as a keyframe of its values
+    if(cur_evh.Check(EventHeader, Type::epics) && IsEPICSDelta(buf, length)) {
+        rec.data.clear();
+        if(!GetEPICS(epics_cache)) {
+            rec.header = Header();
+            return false;
         }
-        break;
-    default:
-        dst_in.seekg(cur_pos);
-        return false;
+        vec_append(rec.data, epics_cache.event_number);
+        vec_append(rec.data, (uint32_t)epics_cache.values.size());
+        vec_append(rec.data, epics_cache.values.data(), epics_cache.values.size());
+        rec.header = Header(EventHeader, Type::epics, rec.data.size());
+        return true;
     }
 
-    dst_in.seekg(cur_pos);
+    rec.header = Header(cur_evh.htype, cur_evh.etype, length);
+    rec.data.assign(buf, buf + length);
+    return true;
+}
+
+// read event into the parser's memory, no allocation once it is large enough
+const EventData &PRadDSTParser::GetCurrentEvent()
+const
+{
+    GetEvent(event_cache);
+    return event_cache;
+}
+
+const EpicsData &PRadDSTParser::GetCurrentEPICS()
+const
+{
+    GetEPICS(epics_cache);
+    return epics_cache;
+}
+
+const ReconData &PRadDSTParser::GetCurrentRecon()
+const
+{
+    GetRecon(recon_cache);
+    return recon_cache;
+}
+
+// decode an event from the record buffer (without header)
+// the banks not in mask are skipped and left empty
+bool PRadDSTParser::DecodeEvent(const char *buf, uint32_t length, EventData &ev,
+                                uint32_t mask, uint16_t version)
+{
+    bool lengths = has_bank_lengths(version);
+
+    uint32_t in_idx = 0;
+    // event information
+    buf_read(buf, length, in_idx, ev.event_number);
+    buf_read(buf, length, in_idx, ev.type);
+    buf_read(buf, length, in_idx, ev.trigger);
+    buf_read(buf, length, in_idx, ev.timestamp);
+
+    for(uint32_t bank = ADC_Bank; bank <= DSC_Bank; bank <<= 1)
+    {
+        // the end of this bank
+        uint32_t end = length;
+        if(lengths) {
+            uint64_t bytes = buf_read<uint32_t>(buf, length, in_idx);
+            if(in_idx + bytes < length)
+                end = in_idx + bytes;
+        }
+
+        bool skip = !(mask & bank);
+        switch(bank)
+        {
+        case ADC_Bank:
+            if(skip) {
+                ev.adc_data.clear();
+                skip_vector<ADC_Data>(buf, end, in_idx);
+            } else {
+                read_vector(buf, end, in_idx, ev.adc_data);
+            }
+            break;
+        case TDC_Bank:
+            if(skip) {
+                ev.tdc_data.clear();
+                skip_vector<TDC_Data>(buf, end, in_idx);
+            } else {
+                read_vector(buf, end, in_idx, ev.tdc_data);
+            }
+            break;
+        case GEM_Bank:
+            // walk through the hits if the bank length is not available
+            if(!skip || !lengths)
+                read_gem_bank(buf, end, in_idx, ev.gem_data, skip);
+            else
+                ev.gem_data.clear();
+            break;
+        case DSC_Bank:
+            if(skip) {
+                ev.dsc_data.clear();
+                skip_vector<DSC_Data>(buf, end, in_idx);
+            } else {
+                read_vector(buf, end, in_idx, ev.dsc_data);
+            }
+            break;
+        default:
+            break;
+        }
+
+        if(lengths)
+            in_idx = end;
+    }
+
+    return true;
+}
+
+// decode an epics event from the record buffer (without header)
+// the changed channels of a delta record are applied to the values of ep
+bool PRadDSTParser::DecodeEPICS(const char *buf, uint32_t length, EpicsData &ep)
+{
+    uint32_t in_idx = 0;
+    buf_read(buf, length, in_idx, ep.event_number);
+    if(!IsEPICSDelta(buf, length)) {
+        read_vector(buf, length, in_idx, ep.values);
+        return true;
+    }
+
+    in_idx += sizeof(uint32_t);
+    uint32_t nchannels = buf_read<uint32_t>(buf, length, in_idx);
+    uint32_t nchanged = buf_read<uint32_t>(buf, length, in_idx);
+    if(in_idx + (uint64_t)nchanged*(sizeof(uint32_t) + sizeof(float)) > length) {
+        std::cerr << "DST Parser: Corrupted delta EPICS event." << std::endl;
+        return false;
+    }
+
+    ep.values.resize(nchannels, 0.);
+    const char *ids = buf + in_idx, *vals = ids + nchanged*sizeof(uint32_t);
+    for(uint32_t i = 0; i < nchanged; ++i)
+    {
+        uint32_t id;
+        memcpy(&id, ids + i*sizeof(uint32_t), sizeof(id));
+        if(id >= nchannels) {
+            std::cerr << "DST Parser: Corrupted delta EPICS event." << std::endl;
+            return false;
+        }
+        memcpy(&ep.values[id], vals + i*sizeof(float), sizeof(float));
+    }
+    return true;
+}
+
+// the record buffer (without header) is a delta epics record
+bool PRadDSTParser::IsEPICSDelta(const char *buf, uint32_t length)
+{
+    uint32_t mark;
+    if(length < DST_EPICS_DELTA_HEAD)
+        return false;
+    memcpy(&mark, buf + sizeof(int32_t), sizeof(mark));
+    return mark == DST_EPICS_DELTA;
+}
+
+// decode the reconstructed hits from the record buffer (without header)
+bool PRadDSTParser::DecodeRecon(const char *buf, uint32_t length, ReconData &rec)
+{
+    uint32_t in_idx = 0;
+    buf_read(buf, length, in_idx, rec.event_number);
+    buf_read(buf, length, in_idx, rec.config_hash);
+    read_vector(buf, length, in_idx, rec.hycal_hits);
+    read_vector(buf, length, in_idx, rec.gem_hits);
+
+    rec.match_hits.clear();
+    uint32_t nmatch = buf_read<uint32_t>(buf, length, in_idx);
+    for(uint32_t i = 0; i < nmatch; ++i)
+    {
+        if(in_idx >= length) {
+            std::cerr << "DST Parser: Corrupted record of reconstructed hits." << std::endl;
+            return false;
+        }
+
+        BaseHit base = buf_read<BaseHit>(buf, length, in_idx);
+        rec.match_hits.emplace_back(buf_read<HyCalHit>(buf, length, in_idx));
+        MatchHit &m = rec.match_hits.back();
+        static_cast<BaseHit&>(m) = base;
+        buf_read(buf, length, in_idx, m.gem);
+        buf_read(buf, length, in_idx, m.mflag);
+        buf_read(buf, length, in_idx, m.hycal_idx);
+        read_vector(buf, length, in_idx, m.gem1);
+        read_vector(buf, length, in_idx, m.gem2);
+    }
+    return true;
+}
+
+void PRadDSTParser::EncodeSummary(const PRadRunSummary &sum, std::vector<char> &rec)
+{
+    std::vector<char> buf;
+    sum.Encode(buf);
+
+    Header evh(SummaryHeader, RUN_SUMMARY_VERSION, buf.size());
+    uint32_t crc = Checksum(buf.data(), buf.size(), Checksum(&evh, sizeof(evh)));
+    vec_append(rec, evh);
+    vec_append(rec, buf.data(), buf.size());
+    vec_append(rec, crc);
+}
+
+bool PRadDSTParser::DecodeSummary(const char *rec, size_t size, PRadRunSummary &sum)
+{
+    Header evh;
+    if(size < sizeof(evh))
+        return false;
+    memcpy(&evh, rec, sizeof(evh));
+
+    if(evh.htype != SummaryHeader || evh.etype != RUN_SUMMARY_VERSION ||
+       sizeof(evh) + (uint64_t)evh.length + sizeof(uint32_t) > size)
+        return false;
+
+    uint32_t crc;
+    memcpy(&crc, rec + sizeof(evh) + evh.length, sizeof(crc));
+    if(crc != Checksum(rec + sizeof(evh), evh.length, Checksum(&evh, sizeof(evh)))) {
+        std::cerr << "DST Parser: Corrupted run summary." << std::endl;
+        return false;
+    }
+
+    return sum.Decode(rec + sizeof(evh), evh.length);
+}
+
+// the file header, content length, maps and the summary are read
+bool PRadDSTParser::ReadSummary(const std::string &path, PRadRunSummary &sum)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if(!in.is_open()) {
+        std::cerr << "DST Parser: Cannot open input file "
+                  << "\"" << path << "\"!"
+                  << std::endl;
+        return false;
+    }
+
+    Header header = ist_read<Header>(in);
+    int64_t length = ist_read<int64_t>(in);
+    if(!in.good() || header.htype != FileHeader || !CheckVersion(header.etype) ||
+       length <= DST_CONTENT_BEGIN)
+        return false;
+
+    return read_summary(in, length, sum);
+}
+
+// decode a checkpoint record from the record buffer (without header)
+bool PRadDSTParser::DecodeCheckpoint(const char *buf, uint32_t length, Checkpoint &ckpt)
+{
+    uint32_t in_idx = 0;
+    buf_read(buf, length, in_idx, ckpt.position);
+    buf_read(buf, length, in_idx, ckpt.previous);
+    buf_read(buf, length, in_idx, ckpt.events);
+    buf_read(buf, length, in_idx, ckpt.epics);
+    buf_read(buf, length, in_idx, ckpt.recons);
+
+    // the types unknown to this version are discarded
+    ckpt.map.Clear();
+    std::vector<int64_t> offsets;
+    uint32_t ntypes = buf_read<uint32_t>(buf, length, in_idx);
+    for(uint32_t t = 0; t < ntypes && in_idx < length; ++t)
+    {
+        read_vector(buf, length, in_idx, offsets);
+        if(t < ckpt.map.maps.size())
+            ckpt.map.maps[t].swap(offsets);
+    }
+    return in_idx == length;
+}
+
+// the DST format version written by this parser
+uint16_t PRadDSTParser::Version()
+{
+    return DST_FILE_VERSION;
+}
+
+// supported versions, the chunked version is compatible with the current one
+bool PRadDSTParser::CheckVersion(uint16_t ver)
+{
+    return plain_layout(ver) || chunk_layout(ver) ||
+           (ver == DST_FILE_VERSION_V22) || (ver == DST_FILE_VERSION_V23);
+}
+
+// crc32c of the buffer, continued from the crc of the previous buffers
+uint32_t PRadDSTParser::Checksum(const void *buf, size_t size, uint32_t crc)
+{
+    const unsigned char *ptr = (const unsigned char*) buf;
+#ifdef DST_CRC32C_SSE42
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+    if(sse42)
+        return ~crc32c_sse42(~crc, ptr, size);
+#endif
+    return ~crc32c_soft(~crc, ptr, size);
+}
+
+// bytes of the checksum after every record
+uint32_t PRadDSTParser::ChecksumSize(uint16_t ver)
+{
+    return (ver >= DST_FILE_VERSION) ? sizeof(uint32_t) : 0;
+}
+
+// unpack a chunk record to the raw chunk, the raw chunk is the encoded events
+// followed by their offsets and the number of events
+bool PRadDSTParser::UnpackChunk(const char *buf, uint32_t length, std::vector<char> &raw)
+{
+    if(length < DST_CHUNK_HEAD)
+        return false;
+
+    uint32_t nevents, raw_size;
+    uint8_t codec = buf[4];
+    memcpy(&nevents, buf, sizeof(nevents));
+    memcpy(&raw_size, buf + 8, sizeof(raw_size));
+    const char *data = buf + DST_CHUNK_HEAD;
+    size_t data_size = length - DST_CHUNK_HEAD;
+
+    switch(codec)
+    {
+    case DST_CODEC_NONE:
+        if(data_size != raw_size)
+            return false;
+        raw.assign(data, data + data_size);
+        break;
+    case DST_CODEC_ZSTD:
+#ifdef USE_ZSTD
+        {
+            raw.resize(raw_size);
+            size_t res = ZSTD_decompress(&raw[0], raw_size, data, data_size);
+            if(ZSTD_isError(res) || res != raw_size) {
+                raw.clear();
+                return false;
+            }
+        }
+        break;
+#else
+        std::cerr << "DST Parser: The chunk is compressed by zstd, but the "
+                  << "library is built without ZSTD_COMPRESS."
+                  << std::endl;
+        return false;
+#endif
+    default:
+        return false;
+    }
+
+    return ChunkEventCount(raw) == nevents;
+}
+
+// number of events from a chunk record
+uint32_t PRadDSTParser::ChunkEventCount(const char *buf, uint32_t length)
+{
+    uint32_t nevents = 0;
+    if(length >= DST_CHUNK_HEAD)
+        memcpy(&nevents, buf, sizeof(nevents));
+    return nevents;
+}
+
+// number of events from a raw chunk, 0 if the chunk is invalid
+uint32_t PRadDSTParser::ChunkEventCount(const std::vector<char> &raw)
+{
+    if(raw.size() < sizeof(uint32_t))
+        return 0;
+
+    uint32_t nevents;
+    memcpy(&nevents, &raw[raw.size() - sizeof(uint32_t)], sizeof(nevents));
+    if((uint64_t)(nevents + 2)*sizeof(uint32_t) > raw.size())
+        return 0;
+    return nevents;
+}
+
+// decode the i-th event from a raw chunk
+bool PRadDSTParser::DecodeChunkEvent(const std::vector<char> &raw, uint32_t i, EventData &ev,
+                                     uint32_t mask, uint16_t version)
+{
+    uint32_t begin, end;
+    if(i >= ChunkEventCount(raw)) {
+        ev.clear();
+        return false;
+    }
+
+    if(!chunk_event_range(raw, i, begin, end) ||
+       !read_chunk_event(&raw[begin], end - begin, ev, mask, has_bank_lengths(version))) {
+        std::cerr << "DST Parser: Corrupted event " << i << " in chunk." << std::endl;
+        ev.clear();
+        return false;
+    }
+
+    return true;
+}
+
+// the summary is only complete if all the written records are in it
+void PRadDSTParser::writeSummary()
+{
+    if(out_summary.GetEventCount() != out_events || out_summary.GetEPICSCount() != out_epics)
+        out_summary.SetComplete(false);
+
+    std::vector<char> rec;
+    EncodeSummary(out_summary, rec);
+    dst_out.write(rec.data(), rec.size());
+}
+
+// write file map
+void PRadDSTParser::writeMap()
+throw(PRadException)
+{
+    try {
+        write_map(dst_out, out_map);
+        out_map.Clear();
+    } catch(...) {
+        out_map.Clear();
+        throw;
+    }
+}
+
+// read file map
+bool PRadDSTParser::ReadMap()
+{
+    if(!dst_in.is_open())
+        return false;
+
+    // already recovered from the records
+    if(in_recovered)
+        return !in_map.Empty();
+
+    in_map.Clear();
+
+    // remember current position
+    int64_t cur_pos = dst_in.tellg();
+
+    // to content end, where the map is supposed to be
+    dst_in.seekg(content_length);
+
+    // one map for each type
+    while(dst_in.good())
+    {
+        Header header = ist_read<Header>(dst_in);
+        Type map_type = header.GetType(MapHeader);
+        if(!dst_in.good() || map_type == Type::max_type)
+            break;
+
+        auto &this_map = in_map.GetType(map_type);
+        uint32_t size = ist_read<uint32_t>(dst_in);
+        this_map.resize(size);
+        dst_in.read((char*) &this_map[0], vec_buf_size(this_map));
+    }
+
+    dst_in.clear();
+    if(in_map.Empty()) {
+        dst_in.seekg(cur_pos);
+        return false;
+    }
+
+    dst_in.seekg(cur_pos);
     return true;
 }
 
@@ -498,20 +2043,499 @@ bool PRadDSTParser::ReadMap()
 // Private member functions                                                   //
 //============================================================================//
 
-inline void PRadDSTParser::saveBuffer(std::ofstream &ofs, Header evh)
+inline void PRadDSTParser::saveBuffer(std::ofstream &ofs, Header evh, const char *buf)
 throw (PRadException)
 {
+    // the checksum of header and buffer follows the record
+    uint32_t crc = Checksum(buf, evh.length, Checksum(&evh, sizeof(evh)));
+
+    // a replacement of the update, it is not counted as an output record
+    if(upd_active) {
+        vec_append(upd_buf, evh);
+        vec_append(upd_buf, buf, evh.length);
+        vec_append(upd_buf, crc);
+        upd_records++;
+        return;
+    }
+
     if(!ofs.is_open())
         throw PRadException("WRITE DST", "output file is not opened!");
 
-    // save current event position
-    out_map.Add(static_cast<Type>(evh.etype), ofs.tellp());
+    // coalesced into the chunk for the writer thread
+    if(async_out) {
+        out_map.Add(static_cast<Type>(evh.etype), out_pos);
+        pushOutput((char*) &evh, sizeof(evh));
+        pushOutput(buf, evh.length);
+        pushOutput((char*) &crc, sizeof(crc));
+    } else {
+        // save current event position
+        out_map.Add(static_cast<Type>(evh.etype), ofs.tellp());
 
-    // write header
-    ost_write(ofs, evh);
+        // write header
+        ost_write(ofs, evh);
 
-    // write buffer
-    ofs.write(out_buf, evh.length);
+        // write buffer
+        ofs.write(buf, evh.length);
+
+        // write checksum
+        ost_write(ofs, crc);
+    }
+
+    static PRadMetricCounter *written = PRadMetrics::Instance()
+        .GetCounter("prad_dst_written_bytes_total", "bytes of the records written to the DST files");
+    written->Add(sizeof(evh) + evh.length + sizeof(crc));
+
+    countRecord(evh, buf);
+}
+
+// count the written record, a checkpoint is written every ckpt_interval
+// records, or earlier if its positions would not fit in the buffer
+void PRadDSTParser::countRecord(const Header &evh, const char *buf)
+throw (PRadException)
+{
+    switch(evh.GetType(EventHeader))
+    {
+    case Type::event:
+        out_events++;
+        break;
+    case Type::chunk:
+        out_events += ChunkEventCount(buf, evh.length);
+        break;
+    case Type::epics:
+        out_epics++;
+        break;
+    case Type::recon:
+        out_recons++;
+        break;
+    default:
+        // the checkpoints are not counted
+        return;
+    }
+
+    if(ckpt_interval &&
+       (++ckpt_records >= ckpt_interval || checkpoint_size(ckpt_records + 1) > buf_size))
+        saveCheckpoint();
+}
+
+// save the positions of the records since the last checkpoint, and the number
+// of written events, they are enough to index or resume the file up to here
+void PRadDSTParser::saveCheckpoint()
+throw (PRadException)
+{
+    ckpt_marks.resize(out_map.maps.size(), 0);
+    uint64_t nrecords = 0;
+    for(size_t t = 0; t < out_map.maps.size(); ++t)
+        nrecords += out_map.maps[t].size() - ckpt_marks[t];
+    check_write_size(checkpoint_size(nrecords), buf_size);
+
+    int64_t pos = async_out ? out_pos : (int64_t)dst_out.tellp();
+
+    uint32_t out_idx = 0;
+    buf_write(out_buf, out_idx, pos);
+    buf_write(out_buf, out_idx, ckpt_last);
+    buf_write(out_buf, out_idx, out_events);
+    buf_write(out_buf, out_idx, out_epics);
+    buf_write(out_buf, out_idx, out_recons);
+    buf_write(out_buf, out_idx, (uint32_t)out_map.maps.size());
+    for(size_t t = 0; t < out_map.maps.size(); ++t)
+    {
+        const auto &cur_map = out_map.maps[t];
+        uint32_t n = cur_map.size() - ckpt_marks[t];
+        buf_write(out_buf, out_idx, n);
+        buf_write(out_buf, out_idx, cur_map.data() + ckpt_marks[t], n);
+    }
+
+    saveBuffer(dst_out, Header(EventHeader, Type::checkpoint, out_idx), out_buf);
+
+    // the next checkpoint starts after this one
+    for(size_t t = 0; t < out_map.maps.size(); ++t)
+        ckpt_marks[t] = out_map.maps[t].size();
+    ckpt_records = 0;
+    ckpt_last = pos;
+}
+
+// pack the events in the current chunk and save it
+void PRadDSTParser::saveChunk()
+throw (PRadException)
+{
+    if(chunk_offsets.empty())
+        return;
+
+    // raw chunk, events followed by offsets and number of events
+    uint32_t nevents = chunk_offsets.size();
+    chunk_offsets.push_back(chunk_data.size());
+    vec_append(chunk_data, chunk_offsets.data(), chunk_offsets.size());
+    vec_append(chunk_data, nevents);
+    uint32_t raw_size = chunk_data.size();
+
+    uint8_t codec = DST_CODEC_NONE;
+    size_t data_size = raw_size;
+#ifdef USE_ZSTD
+    if(chunk_level > 0) {
+        size_t bound = ZSTD_compressBound(raw_size);
+        chunk_pack.resize(DST_CHUNK_HEAD + bound);
+        size_t res = ZSTD_compress(&chunk_pack[DST_CHUNK_HEAD], bound,
+                                   &chunk_data[0], raw_size, chunk_level);
+        // keep it uncompressed if it does not help
+        if(!ZSTD_isError(res) && res < raw_size) {
+            codec = DST_CODEC_ZSTD;
+            data_size = res;
+        }
+    }
+#endif
+
+    chunk_pack.resize(DST_CHUNK_HEAD + data_size);
+    if(codec == DST_CODEC_NONE)
+        memcpy(&chunk_pack[DST_CHUNK_HEAD], &chunk_data[0], raw_size);
+
+    memset(&chunk_pack[0], 0, DST_CHUNK_HEAD);
+    memcpy(&chunk_pack[0], &nevents, sizeof(nevents));
+    chunk_pack[4] = codec;
+    memcpy(&chunk_pack[8], &raw_size, sizeof(raw_size));
+
+    chunk_data.clear();
+    chunk_offsets.clear();
+
+    saveBuffer(dst_out, Header(EventHeader, Type::chunk, chunk_pack.size()), &chunk_pack[0]);
+}
+
+// move to the next event in the current chunk
+bool PRadDSTParser::nextChunkEvent()
+{
+    if(chunk_index >= chunk_count) {
+        chunk_count = chunk_index = 0;
+        return false;
+    }
+
+    chunk_index++;
+    cur_evh = Header(EventHeader, Type::event);
+    return true;
+}
+
+// the update records are listed in the map, the positions of the replaced
+// records and their replacements are at the end of every update record
+void PRadDSTParser::readUpdates()
+{
+    in_updated = false;
+    in_redirect.clear();
+
+    int64_t cur_pos = dst_in.tellg();
+    dst_in.seekg(content_length);
+
+    std::vector<int64_t> updates;
+    while(dst_in.good())
+    {
+        Header header = ist_read<Header>(dst_in);
+        Type map_type = header.GetType(MapHeader);
+        if(!dst_in.good() || map_type == Type::max_type)
+            break;
+
+        // only the updates are needed here
+        if(map_type != Type::update) {
+            dst_in.seekg(header.length, dst_in.cur);
+            continue;
+        }
+
+        uint32_t size = ist_read<uint32_t>(dst_in);
+        updates.resize(size);
+        dst_in.read((char*) updates.data(), vec_buf_size(updates));
+        break;
+    }
+    dst_in.clear();
+
+    for(auto &pos : updates)
+    {
+        dst_in.seekg(pos);
+        Header header = ist_read<Header>(dst_in);
+        if(!dst_in.good() || !header.Check(EventHeader, Type::update) ||
+           header.length < sizeof(uint32_t))
+            break;
+
+        int64_t end = pos + sizeof(Header) + header.length - sizeof(uint32_t);
+        dst_in.seekg(end);
+        uint32_t n = ist_read<uint32_t>(dst_in);
+        if(!dst_in.good() || (uint64_t)n*2*sizeof(int64_t) + sizeof(uint32_t) > header.length)
+            break;
+
+        dst_in.seekg(end - n*2*sizeof(int64_t));
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            int64_t old_pos = ist_read<int64_t>(dst_in);
+            int64_t new_pos = ist_read<int64_t>(dst_in);
+            in_redirect[pos - old_pos] = pos + new_pos;
+        }
+    }
+
+    in_updated = !updates.empty();
+    dst_in.clear();
+    dst_in.seekg(cur_pos);
+}
+
+// the update records are skipped, and a replaced record is read from its
+// latest replacement, resume is the position after the replaced record
+bool PRadDSTParser::seekUpdated(int64_t &resume)
+{
+    resume = -1;
+    uint32_t crc_size = ChecksumSize(in_version);
+
+    while(true)
+    {
+        int64_t pos = dst_in.tellg();
+        if(pos < 0 || pos >= content_length)
+            return false;
+
+        Header header = ist_read<Header>(dst_in);
+        if(!dst_in.good())
+            return false;
+
+        int64_t next = pos + sizeof(Header) + header.length + crc_size;
+        if(header.Check(EventHeader, Type::update)) {
+            dst_in.seekg(next);
+            continue;
+        }
+
+        auto it = in_redirect.find(pos);
+        if(it == in_redirect.end()) {
+            dst_in.seekg(pos);
+            return true;
+        }
+
+        int64_t target = it->second;
+        for(it = in_redirect.find(target); it != in_redirect.end(); it = in_redirect.find(target))
+            target = it->second;
+
+        dst_in.seekg(target);
+        resume = next;
+        return true;
+    }
+}
+
+// write the replacement of a record, it should be one record of the type
+bool PRadDSTParser::replace(int64_t pos, Type type, const std::function<void()> &write)
+{
+    if(!upd_active) {
+        std::cerr << "DST Parser: No file is opened for update." << std::endl;
+        return false;
+    }
+
+    auto it = upd_types.find(pos);
+    if(it == upd_types.end() || it->second != type) {
+        std::cerr << "DST Parser: No record of type " << static_cast<int>(type)
+                  << " at position " << pos << " to replace." << std::endl;
+        return false;
+    }
+
+    size_t begin = upd_buf.size();
+    upd_records = 0;
+    try {
+        write();
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": " << e.FailureDesc() << std::endl;
+        upd_records = 0;
+    }
+
+    chunk_data.clear();
+    chunk_offsets.clear();
+    if(upd_records != 1) {
+        std::cerr << "DST Parser: The replacement at position " << pos
+                  << " does not fit in one record." << std::endl;
+        upd_buf.resize(begin);
+        return false;
+    }
+
+    // the last replacement of a record is kept
+    int64_t new_pos = upd_base + sizeof(Header) + begin;
+    for(auto &p : upd_pairs)
+    {
+        if(p.first == pos) {
+            p.second = new_pos;
+            return true;
+        }
+    }
+    upd_pairs.emplace_back(pos, new_pos);
+    return true;
+}
+
+// the bytes of current record, the event in a chunk is located by its offsets
+bool PRadDSTParser::currentRaw(const char *&buf, uint32_t &length)
+const
+{
+    switch(cur_evh.GetType(EventHeader))
+    {
+    case Type::event:
+        if(chunk_count) {
+            uint32_t begin, end;
+            if(!chunk_event_range(chunk_in, chunk_index - 1, begin, end))
+                return false;
+            buf = &chunk_in[begin];
+            length = end - begin;
+            return true;
+        }
+        // fall through
+    case Type::epics:
+    case Type::recon:
+        buf = in_buf;
+        length = cur_evh.length;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// write a record from an input of the given version, it is copied if it has
+// the same layout as the output, otherwise it is decoded and re-encoded
+void PRadDSTParser::writeRaw(const Header &evh, uint16_t version, bool in_chunk, const char *buf)
+throw (PRadException)
+{
+    if(!dst_out.is_open())
+        throw PRadException("WRITE DST", "output file is not opened!");
+
+    Type type = evh.GetType(EventHeader);
+
+    // epics events have the same layout in all versions
+    if(type == Type::epics) {
+        // a delta record depends on the records before it in its input
+        if(IsEPICSDelta(buf, evh.length))
+            throw PRadException("WRITE DST", "Cannot copy a delta EPICS record alone.");
+        // encoded again to keep the deltas of the output
+        if(epics_keyframe) {
+            EpicsData ep;
+            DecodeEPICS(buf, evh.length, ep);
+            writeEPICSData(ep);
+            return;
+        }
+        check_write_size(evh.length, buf_size);
+        saveChunk();
+        saveBuffer(dst_out, evh, buf);
+        return;
+    }
+
+    // reconstructed hits are not kept in order with the chunked events
+    if(type == Type::recon) {
+        check_write_size(evh.length, buf_size);
+        saveBuffer(dst_out, evh, buf);
+        return;
+    }
+
+    if(type != Type::event)
+        throw PRadException("WRITE DST", "Unsupported record type for copying.");
+
+    // an event in chunk to the chunked output
+    if(chunk_size && in_chunk && chunk_layout(version)) {
+        check_write_size(evh.length + DST_CHUNK_HEAD + 3*sizeof(uint32_t), buf_size);
+        if(!chunk_offsets.empty() &&
+           DST_CHUNK_HEAD + chunk_data.size() + evh.length
+           + (chunk_offsets.size() + 3)*sizeof(uint32_t) > buf_size)
+            saveChunk();
+
+        chunk_offsets.push_back(chunk_data.size());
+        chunk_data.insert(chunk_data.end(), buf, buf + evh.length);
+
+        if(chunk_offsets.size() >= chunk_size)
+            saveChunk();
+        return;
+    }
+
+    // a plain event to the plain output
+    if(!chunk_size && !in_chunk && plain_layout(version)) {
+        check_write_size(evh.length, buf_size);
+        saveBuffer(dst_out, evh, buf);
+        return;
+    }
+
+    // different layouts
+    EventData ev;
+    bool success = in_chunk ? read_chunk_event(buf, evh.length, ev, All_Banks, has_bank_lengths(version))
+                            : DecodeEvent(buf, evh.length, ev, All_Banks, version);
+    if(!success)
+        throw PRadException("WRITE DST", "Cannot decode the record for copying.");
+    writeEventData(ev);
+}
+
+// keep the epics records of the input since the last keyframe, they are
+// followed in the order of the map, the chain is rebuilt from the map if the
+// previous epics record was not the last one read (random access)
+void PRadDSTParser::trackEPICS(int64_t pos)
+{
+    bool delta = IsEPICSDelta(in_buf, cur_evh.length);
+    const auto &offsets = in_map.GetType(Type::epics);
+    // the map is needed to find the keyframe
+    if(delta && epics_chain.empty() && offsets.empty())
+        ReadMap();
+
+    int64_t index = -1;
+    if(epics_index + 1 < (int64_t)offsets.size() && offsets[epics_index + 1] == pos) {
+        index = epics_index + 1;
+    } else {
+        auto it = std::find(offsets.begin(), offsets.end(), pos);
+        if(it != offsets.end())
+            index = it - offsets.begin();
+    }
+
+    bool next = (index < 0) || (index == epics_index + 1);
+    epics_index = index;
+
+    if(!delta) {
+        epics_chain.clear();
+        epics_applied = 0;
+    } else if(epics_chain.empty() || !next) {
+        epics_chain.clear();
+        epics_applied = 0;
+        // the values cannot be reconstructed without the keyframe
+        if(index < 0 || !rebuildEPICS(index))
+            return;
+    }
+
+    vec_append(epics_chain, cur_evh.length);
+    vec_append(epics_chain, in_buf, cur_evh.length);
+}
+
+// read the epics records from the last keyframe before the index-th one in the
+// input map to the chain
+bool PRadDSTParser::rebuildEPICS(size_t index)
+{
+    const auto &offsets = in_map.GetType(Type::epics);
+    uint32_t crc_size = ChecksumSize(in_version);
+    int64_t cur_pos = dst_in.tellg();
+
+    // backwards to the keyframe
+    std::vector<std::vector<char>> records;
+    bool keyframe = false;
+    for(size_t i = index; i-- > 0 && !keyframe;)
+    {
+        dst_in.seekg(offsets[i]);
+        Header evh = ist_read<Header>(dst_in);
+        if(!dst_in.good() || !evh.Check(EventHeader, Type::epics) || evh.length > buf_size)
+            break;
+
+        records.emplace_back(evh.length);
+        auto &rec = records.back();
+        dst_in.read(rec.data(), evh.length);
+        if(crc_size) {
+            uint32_t crc = ist_read<uint32_t>(dst_in);
+            if(crc != Checksum(rec.data(), evh.length, Checksum(&evh, sizeof(evh))))
+                break;
+        }
+        if(!dst_in.good())
+            break;
+        keyframe = !IsEPICSDelta(rec.data(), evh.length);
+    }
+
+    dst_in.clear();
+    dst_in.seekg(cur_pos);
+
+    if(!keyframe) {
+        std::cerr << "DST Parser: Cannot find the keyframe of the delta EPICS record at "
+                  << offsets[index] << "." << std::endl;
+        return false;
+    }
+
+    for(auto it = records.rbegin(); it != records.rend(); ++it)
+    {
+        vec_append(epics_chain, (uint32_t)it->size());
+        vec_append(epics_chain, it->data(), it->size());
+    }
+    return true;
 }
 
 inline PRadDSTParser::Header PRadDSTParser::getBuffer(std::ifstream &ifs)
@@ -530,6 +2554,143 @@ throw (PRadException)
     // read the whole buffer
     ifs.read(in_buf, eh.length);
 
+    // verify the record with its checksum
+    if(ChecksumSize(in_version)) {
+        uint32_t crc = ist_read<uint32_t>(ifs);
+        if(!ifs.good() || crc != Checksum(in_buf, eh.length, Checksum(&eh, sizeof(eh))))
+            throw PRadException("READ DST", "checksum mismatch, the record is incomplete or corrupted!");
+    }
+
     // return buffer type
     return eh;
 }
+
+// append bytes to the output chunk, the chunk is submitted when it is full
+void PRadDSTParser::pushOutput(const char *buf, size_t size)
+{
+    if(!out_chunk.empty() && out_chunk.size() + size > DST_WRITE_CHUNK)
+        submitChunk();
+
+    if(out_chunk.capacity() < DST_WRITE_CHUNK)
+        out_chunk.reserve(DST_WRITE_CHUNK);
+
+    out_chunk.insert(out_chunk.end(), buf, buf + size);
+    out_pos += size;
+}
+
+// give the output chunk to the writer, and take a free one
+void PRadDSTParser::submitChunk()
+{
+    if(out_chunk.empty())
+        return;
+
+#ifdef MULTI_THREAD
+    if(!writer.joinable()) {
+        writer_stop = false;
+        writer = std::thread(&PRadDSTParser::writeChunks, this);
+    }
+
+    std::unique_lock<std::mutex> lock(writer_locker);
+    if(free_chunks.empty()) {
+        auto start = std::chrono::high_resolution_clock::now();
+        writer_cond.wait(lock, [this] {return !free_chunks.empty();});
+        std::chrono::duration<double, std::milli> waited
+            = std::chrono::high_resolution_clock::now() - start;
+        write_stats.wait_time += waited.count();
+    }
+
+    full_chunks.emplace_back(std::move(out_chunk));
+    out_chunk = std::move(free_chunks.front());
+    free_chunks.pop_front();
+
+    write_stats.submits++;
+    write_stats.depth_sum += full_chunks.size();
+    if(full_chunks.size() > write_stats.max_depth)
+        write_stats.max_depth = full_chunks.size();
+
+    lock.unlock();
+    writer_cond.notify_all();
+#else
+    // no writer thread, still write in chunks
+    auto start = std::chrono::high_resolution_clock::now();
+    dst_out.write(&out_chunk[0], out_chunk.size());
+    std::chrono::duration<double, std::milli> spent
+        = std::chrono::high_resolution_clock::now() - start;
+
+    write_stats.submits++;
+    write_stats.depth_sum += 1;
+    write_stats.max_depth = 1;
+    write_stats.writes++;
+    write_stats.bytes += out_chunk.size();
+    write_stats.write_time += spent.count();
+    out_chunk.clear();
+#endif
+}
+
+// write all the pending chunks, and stop the writer thread
+void PRadDSTParser::flushOutput()
+{
+    submitChunk();
+
+    if(!writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(writer_locker);
+        writer_stop = true;
+    }
+    writer_cond.notify_all();
+    writer.join();
+}
+
+// writer thread, it writes the chunks in order
+// the chunks go to the asynchronous backend from the stream position, so
+// several of them are written at the same time, and the stream is moved to
+// their end when the writer stops
+void PRadDSTParser::writeChunks()
+{
+    dst_out.flush();
+    int64_t begin = dst_out.tellp();
+    PRadAsyncWriter async_writer;
+    bool direct = begin >= 0 && async_writer.Open(out_path, false, begin);
+
+    while(true)
+    {
+        std::vector<char> chunk;
+        {
+            std::unique_lock<std::mutex> lock(writer_locker);
+            writer_cond.wait(lock, [this] {return writer_stop || !full_chunks.empty();});
+            if(full_chunks.empty())
+                break;
+            chunk = std::move(full_chunks.front());
+            full_chunks.pop_front();
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if(direct) {
+            if(!async_writer.Write(&chunk[0], chunk.size()))
+                dst_out.setstate(std::ios::badbit);
+        } else {
+            dst_out.write(&chunk[0], chunk.size());
+        }
+        std::chrono::duration<double, std::milli> spent
+            = std::chrono::high_resolution_clock::now() - start;
+
+        {
+            std::lock_guard<std::mutex> lock(writer_locker);
+            write_stats.writes++;
+            write_stats.bytes += chunk.size();
+            write_stats.write_time += spent.count();
+            chunk.clear();
+            free_chunks.emplace_back(std::move(chunk));
+        }
+        writer_cond.notify_all();
+    }
+
+    if(direct) {
+        int64_t end = async_writer.Tell();
+        if(!async_writer.Close())
+            dst_out.setstate(std::ios::badbit);
+        dst_out.seekp(end);
+    }
+}
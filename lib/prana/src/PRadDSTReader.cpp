@@ -0,0 +1,496 @@
+//============================================================================//
+// Memory-mapped DST reader                                                   //
+// The whole DST file is mapped read-only, and the records are located by the //
+// event map saved at the end of file, so the events can be decoded directly  //
+// from the mapped memory in any order and by several threads at once         //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadDSTReader.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+// read a value from the mapped memory, it may be unaligned
+template<typename T>
+inline T map_read(const char *ptr)
+{
+    T val;
+    memcpy(&val, ptr, sizeof(T));
+    return val;
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadDSTReader::PRadDSTReader(const std::string &path)
+: addr(nullptr), length(0), content_length(0), version(PRadDSTParser::Version()),
+  bank_mask(PRadDSTParser::All_Banks), chunk_events(0), summary_pos(0)
+{
+    if(!path.empty())
+        Open(path);
+}
+
+PRadDSTReader::~PRadDSTReader()
+{
+    Close();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// map the file and build the record index
+bool PRadDSTReader::Open(const std::string &path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "DST Reader: Cannot open file "
+                  << "\"" << path << "\"!"
+                  << std::endl;
+        return false;
+    }
+
+    struct stat fs;
+    if(fstat(fd, &fs) < 0 || (size_t)fs.st_size < sizeof(Header) + sizeof(int64_t)) {
+        std::cerr << "DST Reader: Cannot get a valid size of file "
+                  << "\"" << path << "\"!"
+                  << std::endl;
+        close(fd);
+        return false;
+    }
+
+    length = fs.st_size;
+    void *ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(ptr == MAP_FAILED) {
+        std::cerr << "DST Reader: Cannot map file "
+                  << "\"" << path << "\"" << " into memory ("
+                  << strerror(errno) << ")."
+                  << std::endl;
+        length = 0;
+        return false;
+    }
+    addr = (const char*) ptr;
+
+    // file header and content length
+    Header header = map_read<Header>(addr);
+    if(header.htype != PRadDSTParser::FileHeader || !PRadDSTParser::CheckVersion(header.etype)) {
+        std::cerr << "DST Reader: Unsupported format from \"" << path << "\", "
+                  << "version 0x" << std::hex << header.etype << std::dec
+                  << std::endl;
+        Close();
+        return false;
+    }
+
+    version = header.etype;
+    content_length = map_read<int64_t>(addr + sizeof(Header));
+    if(content_length < (int64_t)(sizeof(Header) + sizeof(int64_t)) ||
+       content_length > (int64_t)length) {
+        std::cerr << "DST Reader: Incorrect content length <" << content_length
+                  << ">, file length is <" << length << ">."
+                  << std::endl;
+        Close();
+        return false;
+    }
+
+    file_path = path;
+
+    // the map may be missing if the file was not closed properly
+    if(!readMap()) {
+        std::cerr << "DST Reader: No valid event map in \"" << path << "\", "
+                  << "recovering the records."
+                  << std::endl;
+        recoverRecords();
+    }
+
+    indexChunks();
+    return true;
+}
+
+// unmap the file
+void PRadDSTReader::Close()
+{
+    if(addr)
+        munmap((void*) addr, length);
+
+    addr = nullptr;
+    length = 0;
+    content_length = 0;
+    file_path.clear();
+    index.Clear();
+    chunk_first.clear();
+    chunk_events = 0;
+    summary_pos = 0;
+}
+
+// get the i-th record of a type, an invalid record is returned if it does
+// not exist
+PRadDSTReader::Record PRadDSTReader::GetRecord(Type t, size_t i)
+const
+{
+    const auto &offsets = index.GetType(t);
+    if(i >= offsets.size())
+        return Record();
+
+    // the offsets are validated when building the index
+    int64_t pos = offsets[i];
+    return Record(map_read<Header>(addr + pos), addr + pos + sizeof(Header));
+}
+
+// get the i-th event, the chunk is unpacked for an event in chunked format,
+// use GetChunk to go through the events
+bool PRadDSTReader::GetEvent(size_t i, EventData &ev)
+const
+{
+    if(IsChunked()) {
+        if(i >= chunk_events) {
+            ev.clear();
+            return false;
+        }
+
+        size_t c = std::upper_bound(chunk_first.begin(), chunk_first.end(), i)
+                   - chunk_first.begin() - 1;
+        Record rec = GetRecord(Type::chunk, c);
+        std::vector<char> raw;
+        if(!PRadDSTParser::UnpackChunk(rec.data, rec.Length(), raw)) {
+            ev.clear();
+            return false;
+        }
+        return PRadDSTParser::DecodeChunkEvent(raw, i - chunk_first[c], ev, bank_mask, version);
+    }
+
+    Record rec = GetRecord(Type::event, i);
+    if(!rec.Valid()) {
+        ev.clear();
+        return false;
+    }
+
+    return PRadDSTParser::DecodeEvent(rec.data, rec.Length(), ev, bank_mask, version);
+}
+
+EventData PRadDSTReader::GetEvent(size_t i)
+const
+{
+    EventData ev;
+    GetEvent(i, ev);
+    return ev;
+}
+
+bool PRadDSTReader::GetEPICS(size_t i, EpicsData &ep)
+const
+{
+    Record rec = GetRecord(Type::epics, i);
+    if(!rec.Valid()) {
+        ep.clear();
+        return false;
+    }
+
+    if(!PRadDSTParser::IsEPICSDelta(rec.data, rec.Length()))
+        return PRadDSTParser::DecodeEPICS(rec.data, rec.Length(), ep);
+
+    // a delta record, the records are applied from the last keyframe
+    size_t key = i;
+    do {
+        if(key == 0) {
+            std::cerr << "DST Reader: No keyframe for the delta EPICS event "
+                      << i << "." << std::endl;
+            ep.clear();
+            return false;
+        }
+        rec = GetRecord(Type::epics, --key);
+    } while(rec.Valid() && PRadDSTParser::IsEPICSDelta(rec.data, rec.Length()));
+
+    for(size_t k = key; k <= i; ++k)
+    {
+        rec = GetRecord(Type::epics, k);
+        if(!rec.Valid() || !PRadDSTParser::DecodeEPICS(rec.data, rec.Length(), ep)) {
+            ep.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+EpicsData PRadDSTReader::GetEPICS(size_t i)
+const
+{
+    EpicsData ep;
+    GetEPICS(i, ep);
+    return ep;
+}
+
+bool PRadDSTReader::GetRecon(size_t i, ReconData &rec)
+const
+{
+    Record rec_buf = GetRecord(Type::recon, i);
+    if(!rec_buf.Valid()) {
+        rec.clear();
+        return false;
+    }
+
+    return PRadDSTParser::DecodeRecon(rec_buf.data, rec_buf.Length(), rec);
+}
+
+ReconData PRadDSTReader::GetRecon(size_t i)
+const
+{
+    ReconData rec;
+    GetRecon(i, rec);
+    return rec;
+}
+
+
+
+// the checksum is verified on request, the index is only validated by the
+// record lengths when the map is available
+bool PRadDSTReader::CheckRecord(Type t, size_t i)
+const
+{
+    const auto &offsets = index.GetType(t);
+    return (i < offsets.size()) && checkRecord(offsets[i], content_length);
+}
+
+// index of the first event in a chunk
+size_t PRadDSTReader::GetChunkFirst(size_t c)
+const
+{
+    return (c < chunk_first.size()) ? chunk_first[c] : chunk_events;
+}
+
+// unpack a chunk and decode all its events, the memory of events is reused
+bool PRadDSTReader::GetChunk(size_t c, std::vector<EventData> &events)
+const
+{
+    Record rec = GetRecord(Type::chunk, c);
+    std::vector<char> raw;
+    if(!rec.Valid() || !PRadDSTParser::UnpackChunk(rec.data, rec.Length(), raw)) {
+        events.clear();
+        return false;
+    }
+
+    uint32_t nevents = PRadDSTParser::ChunkEventCount(raw);
+    events.resize(nevents);
+    for(uint32_t i = 0; i < nevents; ++i)
+    {
+        if(!PRadDSTParser::DecodeChunkEvent(raw, i, events[i], bank_mask, version))
+            return false;
+    }
+    return true;
+}
+
+bool PRadDSTReader::GetSummary(PRadRunSummary &sum)
+const
+{
+    if(!summary_pos)
+        return false;
+
+    return PRadDSTParser::DecodeSummary(addr + summary_pos, length - summary_pos, sum);
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// read the maps after the content, one map for each record type
+bool PRadDSTReader::readMap()
+{
+    size_t pos = content_length;
+
+    while(pos + sizeof(Header) + sizeof(uint32_t) <= length)
+    {
+        Header header = map_read<Header>(addr + pos);
+        Type type = header.GetType(PRadDSTParser::MapHeader);
+        if(type == Type::max_type)
+            break;
+
+        uint32_t size = map_read<uint32_t>(addr + pos + sizeof(Header));
+        size_t begin = pos + sizeof(Header) + sizeof(uint32_t);
+        if(begin + (uint64_t)size*sizeof(int64_t) > length)
+            break;
+
+        auto &offsets = index.GetType(type);
+        offsets.resize(size);
+        if(size)
+            memcpy(&offsets[0], addr + begin, size*sizeof(int64_t));
+
+        pos = begin + size*sizeof(int64_t);
+    }
+
+    // the summary follows the maps
+    if(pos + sizeof(Header) <= length &&
+       map_read<Header>(addr + pos).htype == PRadDSTParser::SummaryHeader)
+        summary_pos = pos;
+
+    // check all the records in the map
+    int64_t crc_size = PRadDSTParser::ChecksumSize(version);
+    for(auto &offsets : index.maps)
+    {
+        for(auto &off : offsets)
+        {
+            if(off < 0 || off + (int64_t)sizeof(Header) > content_length ||
+               off + (int64_t)sizeof(Header) + crc_size
+                   + map_read<Header>(addr + off).length > content_length) {
+                index.Clear();
+                return false;
+            }
+        }
+    }
+
+    return !index.Empty();
+}
+
+// count the events in chunks from the chunk headers
+void PRadDSTReader::indexChunks()
+{
+    chunk_first.clear();
+    chunk_events = 0;
+
+    for(size_t c = 0; c < GetCount(Type::chunk); ++c)
+    {
+        Record rec = GetRecord(Type::chunk, c);
+        chunk_first.push_back(chunk_events);
+        chunk_events += PRadDSTParser::ChunkEventCount(rec.data, rec.Length());
+    }
+}
+
+// build the index for a file without map, the content length is not saved
+// if the file was not closed properly, so the records are searched to the end
+// the positions are taken from the checkpoints, and only the records after the
+// last checkpoint are scanned
+void PRadDSTReader::recoverRecords()
+{
+    index.Clear();
+    int64_t end = (content_length > DST_CONTENT_BEGIN) ? content_length : length;
+    int64_t pos = DST_CONTENT_BEGIN;
+
+    std::vector<PRadDSTParser::Checkpoint> chain;
+    if(PRadDSTParser::ChecksumSize(version) && findCheckpoints(end, chain)) {
+        // the chain is from the last checkpoint
+        for(auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            for(size_t t = 0; t < index.maps.size(); ++t)
+            {
+                auto &offsets = index.maps[t];
+                offsets.insert(offsets.end(), it->map.maps[t].begin(), it->map.maps[t].end());
+            }
+            index.Add(Type::checkpoint, it->position);
+        }
+        pos = chain.front().position + sizeof(Header) + PRadDSTParser::ChecksumSize(version)
+              + map_read<Header>(addr + chain.front().position).length;
+    }
+
+    content_length = scanRecords(pos, end);
+}
+
+// index the complete records from pos to end, return the end of the last one
+int64_t PRadDSTReader::scanRecords(int64_t pos, int64_t end)
+{
+    int64_t crc_size = PRadDSTParser::ChecksumSize(version);
+
+    while(checkRecord(pos, end))
+    {
+        Header header = map_read<Header>(addr + pos);
+        index.Add(header.GetType(PRadDSTParser::EventHeader), pos);
+        pos += sizeof(Header) + header.length + crc_size;
+    }
+
+    return pos;
+}
+
+// search the last valid checkpoint backward from the end, and follow the
+// chain to the first one, false if no complete chain is found
+bool PRadDSTReader::findCheckpoints(int64_t end, std::vector<PRadDSTParser::Checkpoint> &chain)
+const
+{
+    chain.clear();
+    Header key(PRadDSTParser::EventHeader, Type::checkpoint);
+    PRadDSTParser::Checkpoint ckpt;
+
+    int64_t pos = end - sizeof(Header) - sizeof(uint32_t);
+    for(; pos >= DST_CONTENT_BEGIN; --pos)
+    {
+        // the header type and record type
+        if(memcmp(addr + pos, &key, sizeof(key.htype) + sizeof(key.etype)) == 0 &&
+           readCheckpoint(pos, end, ckpt))
+            break;
+    }
+
+    if(pos < DST_CONTENT_BEGIN)
+        return false;
+
+    chain.push_back(ckpt);
+    while(chain.back().previous >= 0)
+    {
+        if(!readCheckpoint(chain.back().previous, chain.back().position, ckpt)) {
+            std::cerr << "DST Reader: Broken checkpoint at " << chain.back().previous
+                      << ", scanning all the records."
+                      << std::endl;
+            chain.clear();
+            return false;
+        }
+        chain.push_back(ckpt);
+    }
+
+    return true;
+}
+
+// read a checkpoint at pos, it should be complete before end, and all its
+// positions are between the previous checkpoint and itself
+bool PRadDSTReader::readCheckpoint(int64_t pos, int64_t end, PRadDSTParser::Checkpoint &ckpt)
+const
+{
+    if(!checkRecord(pos, end))
+        return false;
+
+    Header header = map_read<Header>(addr + pos);
+    if(!header.Check(PRadDSTParser::EventHeader, Type::checkpoint) ||
+       !PRadDSTParser::DecodeCheckpoint(addr + pos + sizeof(Header), header.length, ckpt) ||
+       ckpt.position != pos || ckpt.previous >= pos)
+        return false;
+
+    int64_t begin = std::max<int64_t>(ckpt.previous, DST_CONTENT_BEGIN);
+    for(auto &offsets : ckpt.map.maps)
+    {
+        for(auto &off : offsets)
+        {
+            if(off < begin || off >= pos)
+                return false;
+        }
+    }
+    return true;
+}
+
+// check the record at pos is complete before end, and matches its checksum
+bool PRadDSTReader::checkRecord(int64_t pos, int64_t end)
+const
+{
+    if(pos < DST_CONTENT_BEGIN || pos + (int64_t)sizeof(Header) > end)
+        return false;
+
+    Header header = map_read<Header>(addr + pos);
+    int64_t crc_size = PRadDSTParser::ChecksumSize(version);
+    int64_t data_end = pos + sizeof(Header) + header.length;
+    if(header.htype != PRadDSTParser::EventHeader || data_end + crc_size > end)
+        return false;
+
+    return !crc_size ||
+           map_read<uint32_t>(addr + data_end) == PRadDSTParser::Checksum(addr + pos, data_end - pos);
+}
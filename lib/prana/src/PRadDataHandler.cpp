@@ -10,15 +10,17 @@
 #include <iomanip>
 #include <algorithm>
 #include "PRadDataHandler.h"
+#include "PRadProfiler.h"
 #include "PRadInfoCenter.h"
 #include "PRadEPICSystem.h"
 #include "PRadTaggerSystem.h"
 #include "PRadHyCalSystem.h"
 #include "PRadGEMSystem.h"
 #include "PRadBenchMark.h"
+#include "PRadDSTReader.h"
+#include "PRadInitSnapshot.h"
+#include "PRadThreadTopology.h"
 #include "ConfigParser.h"
-#include "canalib.h"
-#include "TH2.h"
 
 
 
@@ -30,36 +32,57 @@
 PRadDataHandler::PRadDataHandler()
 : parser(this),
   epic_sys(nullptr), tagger_sys(nullptr), hycal_sys(nullptr), gem_sys(nullptr),
-  onlineMode(false), replayMode(false), new_event(new EventData), proc_event(new EventData)
+  info_center(&PRadInfoCenter::Instance()),
+  onlineMode(false), replayMode(false), scaler_only(false), read_stop(false),
+  replay_skip_events(0), replay_skip_epics(0), use_init_snapshot(true), memory_budget(0),
+  event_ring(new EventData[EVENT_RING_SIZE]),
+  ring_head(0), ring_tail(0), producer_wait(false), consumer_wait(false), end_stop(false)
 {
-    // place holder
+    parser.SetEventBuilder(&event_ring[0]);
 }
 
 // copy/move constructors
+// the events in the processing ring are not copied or moved, and the spilled
+// events are not copied
 PRadDataHandler::PRadDataHandler(const PRadDataHandler &that)
 : parser(this),
   epic_sys(nullptr), tagger_sys(nullptr), hycal_sys(nullptr), gem_sys(nullptr),
-  onlineMode(that.onlineMode), replayMode(that.replayMode), event_data(that.event_data),
-  new_event(new EventData(*that.new_event)), proc_event(new EventData(*that.proc_event))
+  info_center(&PRadInfoCenter::Instance()),
+  onlineMode(that.onlineMode), replayMode(that.replayMode), scaler_only(false), read_stop(false),
+  replay_skip_events(0), replay_skip_epics(0), use_init_snapshot(that.use_init_snapshot),
+  init_snapshot_dir(that.init_snapshot_dir), event_data(that.event_data),
+  memory_budget(that.memory_budget), event_ring(new EventData[EVENT_RING_SIZE]),
+  ring_head(0), ring_tail(0), producer_wait(false), consumer_wait(false), end_stop(false)
 {
-    // place holder
+    parser.SetEventBuilder(&event_ring[0]);
+    // the recent events are not copied
+    if(onlineMode)
+        online_buffer.Resize(that.online_buffer.Capacity());
 }
 
 PRadDataHandler::PRadDataHandler(PRadDataHandler &&that)
 : parser(this),
   epic_sys(nullptr), tagger_sys(nullptr), hycal_sys(nullptr), gem_sys(nullptr),
-  onlineMode(that.onlineMode), replayMode(that.replayMode), event_data(std::move(that.event_data)),
-  new_event(new EventData(std::move(*that.new_event))),
-  proc_event(new EventData(std::move(*that.proc_event)))
+  info_center(&PRadInfoCenter::Instance()),
+  onlineMode(that.onlineMode), replayMode(that.replayMode), scaler_only(false), read_stop(false),
+  replay_skip_events(0), replay_skip_epics(0), use_init_snapshot(that.use_init_snapshot),
+  init_snapshot_dir(std::move(that.init_snapshot_dir)), memory_budget(that.memory_budget),
+  event_ring(new EventData[EVENT_RING_SIZE]),
+  ring_head(0), ring_tail(0), producer_wait(false), consumer_wait(false), end_stop(false)
 {
-    // place holder
+    that.waitEventProcess();
+    event_data = std::move(that.event_data);
+    event_spill = std::move(that.event_spill);
+    parser.SetEventBuilder(&event_ring[0]);
+    if(onlineMode)
+        online_buffer.Resize(that.online_buffer.Capacity());
 }
 
 // destructor
 PRadDataHandler::~PRadDataHandler()
 {
-    delete new_event;
-    delete proc_event;
+    stopEventProcess();
+    delete [] event_ring;
 }
 
 // copy/move assignment operators
@@ -78,16 +101,18 @@ PRadDataHandler &PRadDataHandler::operator =(PRadDataHandler &&rhs)
     if(this == &rhs)
         return *this;
 
-    delete new_event;
-    delete proc_event;
+    waitEventProcess();
+    rhs.waitEventProcess();
 
-    new_event = rhs.new_event;
-    rhs.new_event = nullptr;
-    proc_event = rhs.proc_event;
-    rhs.proc_event = nullptr;
     onlineMode = rhs.onlineMode;
     replayMode = rhs.replayMode;
+    use_init_snapshot = rhs.use_init_snapshot;
+    init_snapshot_dir = std::move(rhs.init_snapshot_dir);
     event_data = std::move(rhs.event_data);
+    memory_budget = rhs.memory_budget;
+    event_spill = std::move(rhs.event_spill);
+    energy_cache.Clear();
+    online_buffer.Resize(rhs.online_buffer.Capacity());
 
     return *this;
 }
@@ -101,19 +126,151 @@ void PRadDataHandler::SetOnlineMode(const bool &mode)
 {
     onlineMode = mode;
     Clear();
+
+    // allocate the recent events buffer for the first time
+    if(onlineMode && !online_buffer.Capacity())
+        online_buffer.Resize(ONLINE_BUFFER_SIZE);
+}
+
+// change the number of recent events kept in online mode, the kept events
+// are removed, it should not be called while the events are being viewed
+void PRadDataHandler::SetOnlineBufferSize(size_t size)
+{
+    waitEventProcess();
+    online_buffer.Resize(size);
+}
+
+// the recent events of online mode are written to the shared memory /name,
+// the monitors on the same node attach to it instead of decoding the events
+bool PRadDataHandler::PublishOnline(const std::string &name, size_t size)
+{
+    waitEventProcess();
+    return online_buffer.CreateShared(name, size);
+}
+
+// read the events published by another process, they are available with
+// GetEvent in online mode, the events fed to this handler are not kept
+bool PRadDataHandler::AttachOnline(const std::string &name)
+{
+    waitEventProcess();
+    if(!online_buffer.OpenShared(name))
+        return false;
+
+    onlineMode = true;
+    return true;
+}
+
+// the budget is checked after the events are stored, so the events in memory
+// go beyond it by the events of one store at most
+void PRadDataHandler::SetMemoryBudget(size_t bytes, const std::string &dir)
+{
+    waitEventProcess();
+    std::lock_guard<std::recursive_mutex> lock(data_locker);
+    memory_budget = bytes;
+    event_spill.SetDirectory(dir);
+    checkMemoryBudget();
+}
+
+// spill the stored events if they are over the budget, the memory of the
+// store is kept for the next events
+void PRadDataHandler::checkMemoryBudget()
+{
+    if(!memory_budget || event_data.DataSize() <= memory_budget)
+        return;
+
+    if(!event_spill.Spill(event_data)) {
+        std::cerr << "PRad Data Handler Error: Failed to spill the events, "
+                  << "the memory budget is disabled." << std::endl;
+        memory_budget = 0;
+        return;
+    }
+
+    event_data.ClearEvents();
+    energy_cache.Clear();
+}
+
+// path of the initialization snapshot, empty if it is not used
+std::string PRadDataHandler::initSnapshotPath(int run)
+{
+    if(!use_init_snapshot || run <= 0)
+        return "";
+
+    std::string dir = init_snapshot_dir;
+    if(dir.empty() && hycal_sys)
+        dir = hycal_sys->GetConfig<std::string>("Calibration Cache Folder");
+    if(dir.empty())
+        return "";
+
+    return ConfigParser::form_path(dir, "init_snapshot_" + std::to_string(run) + ".bin");
+}
+
+// set the run information context, nullptr goes back to the global one
+void PRadDataHandler::SetInfoCenter(PRadInfoCenter *info)
+{
+    // the counters belong to the previous context
+    waitEventProcess();
+    info_center = (info) ? info : &PRadInfoCenter::Instance();
+}
+
+// add a processing stage, new_thread makes it run on its own thread
+// once there is any stage, events are only processed by the stages
+void PRadDataHandler::AddSink(PRadEventSink *sink, bool new_thread)
+{
+    waitEventProcess();
+    pipeline.AddSink(sink, new_thread);
+}
+
+// remove a stage, the default processing is back if it is the last one
+void PRadDataHandler::RemoveSink(PRadEventSink *sink)
+{
+    waitEventProcess();
+    pipeline.RemoveSink(sink);
+}
+
+// remove all the stages and go back to the default processing
+void PRadDataHandler::ClearSinks()
+{
+    waitEventProcess();
+    pipeline.Clear();
 }
 
 // decode an event buffer
 void PRadDataHandler::Decode(const void *buffer)
 {
+    parser.SetPartialParse(false);
+    parser.ReadEventBuffer(buffer);
+
+    waitEventProcess();
+}
+
+// decode only the trigger, scaler and EPICS information of an event buffer
+// the event updates the online information and run counters, but it is not
+// filled to histograms or kept
+void PRadDataHandler::DecodeScalers(const void *buffer)
+{
+    scaler_only = true;
+    parser.SetPartialParse(true);
     parser.ReadEventBuffer(buffer);
 
     waitEventProcess();
+    parser.SetPartialParse(false);
+    scaler_only = false;
 }
 
 // read from DST format file
-void PRadDataHandler::ReadFromDST(const std::string &path)
+// the file is read by multiple threads if there are more decode threads
+// the occupancy is counted by flat counters while reading, and added to the
+// channels at the end
+void PRadDataHandler::ReadFromDST(const std::string &path, uint32_t options)
 {
+#ifdef MULTI_THREAD
+    if(parser.GetDecodeThreads() > 1 && readDSTParallel(path, parser.GetDecodeThreads(), options))
+        return;
+#endif
+
+    std::vector<uint32_t> occupancy;
+    bool count_occupancy = hycal_sys && (options & Read_Occupancy);
+
     try {
         dst_parser.OpenInput(path);
 
@@ -121,17 +278,26 @@ void PRadDataHandler::ReadFromDST(const std::string &path)
                   << "\"" << path << "\""
                   << std::endl;
 
-        while(dst_parser.Read())
+        // the event is reused for reading
+        EventData event;
+        while(!read_stop && dst_parser.Read())
         {
             switch(dst_parser.EventType())
             {
             case PRadDSTParser::Type::event:
+              {
+                dst_parser.GetEvent(event);
+                std::lock_guard<std::recursive_mutex> lock(data_locker);
+                // the epics events before it are already read
+                if(epic_sys) event.epics_index = epic_sys->GetEpoch();
                 // save data
-                event_data.emplace_back(dst_parser.GetEvent());
+                event_data.Append(event);
+                checkMemoryBudget();
                 // fill histogram
-                 FillHistograms(event_data.back());
+                if(options & Read_Hists) FillHistograms(event);
                 // count occupancy
-                if(hycal_sys) hycal_sys->Sparsify(event_data.back());
+                if(count_occupancy) hycal_sys->CountOccupancy(event, occupancy);
+              }
                 break;
             case PRadDSTParser::Type::epics:
                 if(epic_sys) epic_sys->AddEvent(std::move(dst_parser.GetEPICS()));
@@ -150,8 +316,163 @@ void PRadDataHandler::ReadFromDST(const std::string &path)
                   << "Read from DST Aborted!" << std::endl;
     }
     dst_parser.CloseInput();
- }
 
+    if(count_occupancy) {
+        std::lock_guard<std::recursive_mutex> lock(data_locker);
+        hycal_sys->AddOccupancy(occupancy);
+    }
+}
+
+
+// open a DST file in index-only mode, only the EPICS events are read, the
+// events are decoded when they are accessed, and they are not filled to the
+// histograms
+bool PRadDataHandler::OpenDST(const std::string &path)
+{
+    Clear();
+
+    if(!dst_events.Open(path))
+        return false;
+
+    std::cout << "Data Handler: Opened DST file "
+              << "\"" << path << "\" in index-only mode, "
+              << dst_events.GetEventCount() << " events."
+              << std::endl;
+
+    if(epic_sys) {
+        auto &reader = dst_events.GetReader();
+        for(size_t i = 0; i < reader.GetEPICSCount(); ++i)
+            epic_sys->AddEvent(reader.GetEPICS(i));
+    }
+
+    return true;
+}
+
+// close the DST file opened in index-only mode
+void PRadDataHandler::CloseDST()
+{
+    dst_events.Close();
+}
+
+// read a DST file by splitting it into ranges with its event map, every
+// range is decoded on its own thread with its own histogram buffers, the
+// events and histograms are merged in order afterwards
+// the threads are placed by the thread topology, a range store is only filled
+// by its thread, so its memory is on the node of the thread
+// return false if the file cannot be read in this way
+bool PRadDataHandler::readDSTParallel(const std::string &path, unsigned int nthreads,
+                                      uint32_t options)
+{
+    PRadDSTReader reader;
+    if(!reader.Open(path))
+        return false;
+
+    std::cout << "Data Handler: Reading events from DST file "
+              << "\"" << path << "\" with " << nthreads << " threads"
+              << std::endl;
+
+    if(epic_sys) {
+        for(size_t i = 0; i < reader.GetEPICSCount(); ++i)
+            epic_sys->AddEvent(reader.GetEPICS(i));
+    }
+
+    // split by chunks for the chunked format
+    size_t units = reader.IsChunked() ? reader.GetChunkCount() : reader.GetEventCount();
+    nthreads = std::min<size_t>(nthreads, units);
+    if(!nthreads)
+        return true;
+
+    struct Range
+    {
+        size_t begin, end;
+        PRadEventStore store;
+        PRadHistBuffer hycal_hists;
+        PRadTaggerSystem *tagger;
+        std::vector<uint32_t> occupancy;
+    };
+
+    std::vector<Range> ranges(nthreads);
+    for(unsigned int t = 0; t < nthreads; ++t)
+    {
+        auto &range = ranges[t];
+        range.begin = units*t/nthreads;
+        range.end = units*(t + 1)/nthreads;
+        range.tagger = nullptr;
+
+        // hycal histograms are filled through the buffers of the threads,
+        // and the other systems are copied with empty histograms
+        if(tagger_sys && (options & Read_Hists)) {
+            range.tagger = new PRadTaggerSystem(*tagger_sys);
+            range.tagger->Reset();
+        }
+    }
+
+    bool fill_hists = hycal_sys && (options & Read_Hists);
+    bool count_occupancy = hycal_sys && (options & Read_Occupancy);
+    auto process = [this, &reader, fill_hists, count_occupancy] (Range &range, unsigned int id)
+                   {
+                       PRadThreadTopology::Instance().PinWorker(id);
+                       // the buffer counts are allocated by the thread
+                       if(fill_hists)
+                           range.hycal_hists = hycal_sys->CreateHistBuffer();
+
+                       auto take = [&] (EventData &event)
+                                   {
+                                       // all the epics events are read
+                                       if(epic_sys)
+                                           event.epics_index = epic_sys->FindEpoch(event.event_number);
+                                       range.store.Append(event);
+                                       if(fill_hists)
+                                           range.hycal_hists.Fill(event);
+                                       // the counters of the thread are merged later
+                                       if(count_occupancy)
+                                           hycal_sys->CountOccupancy(event, range.occupancy);
+                                       if(range.tagger)
+                                           range.tagger->FillHists(event);
+                                   };
+
+                       if(reader.IsChunked()) {
+                           std::vector<EventData> events;
+                           for(size_t c = range.begin; c < range.end && !read_stop; ++c)
+                           {
+                               reader.GetChunk(c, events);
+                               for(auto &event : events)
+                                   take(event);
+                           }
+                       } else {
+                           EventData event;
+                           for(size_t i = range.begin; i < range.end && !read_stop; ++i)
+                           {
+                               reader.GetEvent(i, event);
+                               take(event);
+                           }
+                       }
+                   };
+
+    std::vector<std::thread> threads;
+    for(unsigned int t = 0; t < nthreads; ++t)
+        threads.emplace_back(process, std::ref(ranges[t]), t);
+    for(auto &thread : threads)
+        thread.join();
+
+    // merge in order
+    std::lock_guard<std::recursive_mutex> lock(data_locker);
+    for(auto &range : ranges)
+    {
+        event_data.Append(range.store);
+        checkMemoryBudget();
+        if(fill_hists)
+            hycal_sys->MergeHists(range.hycal_hists);
+        if(count_occupancy)
+            hycal_sys->AddOccupancy(range.occupancy);
+        if(range.tagger) {
+            tagger_sys->MergeHists(*range.tagger);
+            delete range.tagger;
+        }
+    }
+
+    return true;
+}
 
 // read fro evio file
 int PRadDataHandler::ReadFromEvio(const std::string &path, int evt, bool verbose)
@@ -171,8 +492,12 @@ int PRadDataHandler::ReadFromSplitEvio(const std::string &path, int split, bool
         for(int i = 0; i <= split; ++i)
         {
             std::string split_path = path + "." + std::to_string(i);
+            // read the next segment in background
+            if(i < split)
+                parser.PrefetchFile((path + "." + std::to_string(i + 1)).c_str());
             count += ReadFromEvio(split_path.c_str(), -1, verbose);
         }
+        parser.StopPrefetch();
         return count;
     }
 }
@@ -180,11 +505,18 @@ int PRadDataHandler::ReadFromSplitEvio(const std::string &path, int split, bool
 // erase the data container and all the connected systems
 void PRadDataHandler::Clear()
 {
+    // events in processing may still fill the containers
+    waitEventProcess();
+
     // used memory won't be released, but it can be used again for new data file
-    event_data = std::deque<EventData>();
+    event_data.Clear();
+    event_spill.Clear();
+    dst_events.Close();
+    energy_cache.Clear();
+    online_buffer.Clear();
     parser.SetEventNumber(0);
 
-    PRadInfoCenter::Instance().Reset();
+    info_center->Reset();
 
     if(epic_sys)
         epic_sys->Reset();
@@ -200,44 +532,46 @@ void PRadDataHandler::Clear()
 }
 
 // signal of new event
-void PRadDataHandler::StartofNewEvent(const unsigned char &tag)
+void PRadDataHandler::StartofNewEvent(const unsigned char &tag, EventData &event)
 {
-    new_event->update_type(tag);
+    event.update_type(tag);
 }
 
 // update trigger type
-void PRadDataHandler::UpdateTrgType(const unsigned char &trg)
+void PRadDataHandler::UpdateTrgType(const unsigned char &trg, EventData &event)
 {
-    if(new_event->trigger && (new_event->trigger != trg)) {
+    if(event.trigger && (event.trigger != trg)) {
         std::cerr << "ERROR: Trigger type mismatch at event "
                   << parser.GetEventNumber()
-                  << ", was " << (int) new_event->trigger
+                  << ", was " << (int) event.trigger
                   << " now " << (int) trg
                   << std::endl;
     }
-    new_event->trigger = trg;
+    event.trigger = trg;
 }
 
 // feed JLab TI Data
-void PRadDataHandler::FeedData(const JLabTIData &tiData)
+void PRadDataHandler::FeedData(const JLabTIData &tiData, EventData &event)
 {
-    new_event->timestamp = tiData.time_high;
-    new_event->timestamp <<= 32;
-    new_event->timestamp |= tiData.time_low;
+    event.timestamp = tiData.time_high;
+    event.timestamp <<= 32;
+    event.timestamp |= tiData.time_low;
 }
 
 // feed JLab discriminator data
-void PRadDataHandler::FeedData(const JLabDSCData &dscData)
+void PRadDataHandler::FeedData(const JLabDSCData &dscData, EventData &event)
 {
     for(uint32_t i = 0; i < dscData.size; ++i)
     {
-        new_event->dsc_data.emplace_back(dscData.gated_buf[i], dscData.ungated_buf[i]);
+        event.dsc_data.emplace_back(dscData.gated_buf[i], dscData.ungated_buf[i]);
     }
 }
 
 // feed ADC1881M data
-void PRadDataHandler::FeedData(const ADC1881MData &adcData)
+void PRadDataHandler::FeedData(const ADC1881MData &adcData, EventData &event)
 {
+    PRAD_PROFILE_SCOPE("DataHandler::FeedADC");
+
     if(!hycal_sys)
         return;
 
@@ -247,18 +581,18 @@ void PRadDataHandler::FeedData(const ADC1881MData &adcData)
     if(!channel)
         return;
 
-    if(new_event->is_physics_event()) {
+    if(event.is_physics_event()) {
         if(channel->Sparsify(adcData.val)) {
-            new_event->add_adc(ADC_Data(channel->GetID(), adcData.val)); // store this data word
+            event.add_adc(ADC_Data(channel->GetID(), adcData.val)); // store this data word
         }
-    } else if (new_event->is_monitor_event()) {
-        new_event->add_adc(ADC_Data(channel->GetID(), adcData.val));
+    } else if (event.is_monitor_event()) {
+        event.add_adc(ADC_Data(channel->GetID(), adcData.val));
     }
 
 }
 
 // feed TDC CAEN v767 data
-void PRadDataHandler::FeedData(const TDCV767Data &tdcData)
+void PRadDataHandler::FeedData(const TDCV767Data &tdcData, EventData &event)
 {
     if(!hycal_sys)
         return;
@@ -268,11 +602,11 @@ void PRadDataHandler::FeedData(const TDCV767Data &tdcData)
     if(!tdc)
         return;
 
-    new_event->tdc_data.push_back(TDC_Data(tdc->GetID(), tdcData.val));
+    event.tdc_data.push_back(TDC_Data(tdc->GetID(), tdcData.val));
 }
 
 // feed TDC CAEN v1190 data
-void PRadDataHandler::FeedData(const TDCV1190Data &tdcData)
+void PRadDataHandler::FeedData(const TDCV1190Data &tdcData, EventData &event)
 {
     if(!hycal_sys)
         return;
@@ -280,7 +614,7 @@ void PRadDataHandler::FeedData(const TDCV1190Data &tdcData)
     // tagger hits
     if(tdcData.addr.crate == PRadTagE) {
         if(tagger_sys)
-            tagger_sys->FeedTaggerHits(tdcData, *new_event);
+            tagger_sys->FeedTaggerHits(tdcData, event);
         return;
     }
 
@@ -289,25 +623,201 @@ void PRadDataHandler::FeedData(const TDCV1190Data &tdcData)
     if(!tdc)
         return;
 
-    new_event->add_tdc(TDC_Data(tdc->GetID(), tdcData.val));
+    event.add_tdc(TDC_Data(tdc->GetID(), tdcData.val));
+}
+
+// feed the data words of a ADC1881M slot in one loop, the checks on system
+// and event type are done once for the whole slot
+// return the number of words taken, it stops at a word from the other slot
+uint32_t PRadDataHandler::FeedADCBank(const unsigned int &crate,
+                                      const unsigned int &slot,
+                                      const uint32_t *words,
+                                      const uint32_t &n,
+                                      EventData &event)
+{
+    bool physics = event.is_physics_event();
+    bool monitor = event.is_monitor_event();
+    bool feed = hycal_sys && (physics || monitor);
+
+    if(feed && event.adc_data.capacity() < event.adc_data.size() + n)
+        event.adc_data.reserve(std::max(event.adc_data.size() + n, hycal_sys->GetADCList().size()));
+
+    // append all the words and then apply zero suppression on them together
+    // the words are unpacked block by block until a word from another slot
+    size_t begin = event.adc_data.size();
+    ChannelAddress addr(crate, slot, 0);
+    PRadADCUnpacker::Staging staging;
+    uint32_t i = 0;
+    while(i < n)
+    {
+        size_t nblock = std::min<size_t>(n - i, ADC_UNPACK_BLOCK);
+        size_t nwords = adc_unpacker.Unpack(&words[i], nblock, slot, staging);
+
+        for(size_t k = 0; feed && k < nwords; ++k)
+        {
+            addr.channel = staging.channel[k];
+            PRadADCChannel *channel = hycal_sys->GetADCChannel(addr);
+            if(!channel)
+                continue;
+
+            event.add_adc(ADC_Data(channel->GetID(), staging.value[k]));
+        }
+
+        i += nwords;
+        if(nwords < nblock)
+            break;
+    }
+
+    // monitor events store all the data words
+    if(physics && event.adc_data.size() > begin) {
+        size_t np = hycal_sys->Sparsify(&event.adc_data[begin], event.adc_data.size() - begin);
+        event.adc_data.resize(begin + np);
+    }
+
+    return i;
+}
+
+// feed decoded TDC CAEN v1190 data from one bank
+void PRadDataHandler::FeedTDCBank(const TDCV1190Data *tdcData,
+                                  const uint32_t &n,
+                                  EventData &event)
+{
+    if(!hycal_sys || !n)
+        return;
+
+    if(event.tdc_data.capacity() < event.tdc_data.size() + n)
+        event.tdc_data.reserve(std::max(event.tdc_data.size() + n, 2*event.tdc_data.capacity()));
+
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        // tagger hits, feed the consecutive words from tagger crate together
+        if(tdcData[i].addr.crate == PRadTagE) {
+            uint32_t j = i + 1;
+            while(j < n && tdcData[j].addr.crate == PRadTagE) ++j;
+            if(tagger_sys)
+                tagger_sys->FeedTaggerHits(&tdcData[i], j - i, event);
+            i = j - 1;
+            continue;
+        }
+
+        PRadTDCChannel *tdc = hycal_sys->GetTDCChannel(tdcData[i].addr);
+        if(tdc)
+            event.add_tdc(TDC_Data(tdc->GetID(), tdcData[i].val));
+    }
+}
+
+// feed the words of a V1190 bank in one pass, the word types are classified
+// block by block and only the measurement words are resolved to channels
+// return the number of measurement words
+uint32_t PRadDataHandler::FeedTDCV1190Bank(const unsigned int &crate,
+                                           const uint32_t *words,
+                                           const uint32_t &n,
+                                           EventData &event)
+{
+    if(hycal_sys && event.tdc_data.capacity() < event.tdc_data.size() + n)
+        event.tdc_data.reserve(std::max(event.tdc_data.size() + n, 2*event.tdc_data.capacity()));
+
+    // geo address not supported in the TS crate
+    bool geo = (crate != PRadTS);
+    uint32_t slot = 0, nhits = 0;
+    PRadTDCUnpacker::Staging staging;
+    for(uint32_t i = 0; i < n; i += TDC_UNPACK_BLOCK)
+    {
+        size_t nh = tdc_unpacker.UnpackV1190(&words[i], n - i, slot, geo, staging);
+        feedTDCHits(crate, staging, nh, event);
+        nhits += nh;
+    }
+
+    return nhits;
+}
+
+// feed the data words of a V767 bank in one pass, the header and end of block
+// words should not be included, return the number of valid words
+uint32_t PRadDataHandler::FeedTDCV767Bank(const unsigned int &crate,
+                                          const unsigned int &slot,
+                                          const uint32_t *words,
+                                          const uint32_t &n,
+                                          EventData &event)
+{
+    if(hycal_sys && event.tdc_data.capacity() < event.tdc_data.size() + n)
+        event.tdc_data.reserve(std::max(event.tdc_data.size() + n, 2*event.tdc_data.capacity()));
+
+    uint32_t nhits = 0;
+    PRadTDCUnpacker::Staging staging;
+    for(uint32_t i = 0; i < n; i += TDC_UNPACK_BLOCK)
+    {
+        size_t nh = tdc_unpacker.UnpackV767(&words[i], n - i, slot, staging);
+        feedTDCHits(crate, staging, nh, event);
+        nhits += nh;
+    }
+
+    return nhits;
+}
+
+// resolve the unpacked tdc hits of a crate to channels, the crate is checked
+// once for the staged hits
+void PRadDataHandler::feedTDCHits(const unsigned int &crate,
+                                  const PRadTDCUnpacker::Staging &staging,
+                                  size_t nhits,
+                                  EventData &event)
+{
+    if(!hycal_sys || !nhits)
+        return;
+
+    // tagger hits
+    if(crate == PRadTagE) {
+        if(tagger_sys)
+            tagger_sys->FeedTaggerHits(staging.key, staging.value, nhits, event);
+        return;
+    }
+
+    ChannelAddress addr(crate, 0, 0);
+    for(size_t k = 0; k < nhits; ++k)
+    {
+        addr.slot = TDC_KEY_SLOT(staging.key[k]);
+        addr.channel = TDC_KEY_CHANNEL(staging.key[k]);
+        PRadTDCChannel *tdc = hycal_sys->GetTDCChannel(addr);
+        if(tdc)
+            event.add_tdc(TDC_Data(tdc->GetID(), staging.value[k]));
+    }
 }
 
 // feed GEM data
-void PRadDataHandler::FeedData(const GEMRawData &gemData)
+void PRadDataHandler::FeedData(const GEMRawData &gemData, EventData &event)
 {
+    PRAD_PROFILE_SCOPE("DataHandler::FeedGEM");
+
     if(gem_sys)
-        gem_sys->FillRawData(gemData, *new_event);
+        gem_sys->FillRawData(gemData, event);
+}
+
+// feed the staged GEM data of an event, the APVs may be processed in parallel
+void PRadDataHandler::FeedGEMBanks(const GEMRawData *gemData, const uint32_t &n, EventData &event)
+{
+    if(gem_sys)
+        gem_sys->FillRawData(gemData, n, event);
 }
 
 // feed GEM data which has been zero-suppressed
-void PRadDataHandler::FeedData(const std::vector<GEMZeroSupData> &gemData)
+void PRadDataHandler::FeedData(const std::vector<GEMZeroSupData> &gemData, EventData &event)
 {
+    PRAD_PROFILE_SCOPE("DataHandler::FeedGEMZeroSup");
+
+    if(gem_sys)
+        gem_sys->FillZeroSupData(gemData, event);
+}
+
+// feed the decoded zero-suppressed GEM words of a bank
+void PRadDataHandler::FeedGEMZeroSup(const GEMZeroSupData *gemData, const uint32_t &n, EventData &event)
+{
+    PRAD_PROFILE_SCOPE("DataHandler::FeedGEMZeroSup");
+
     if(gem_sys)
-        gem_sys->FillZeroSupData(gemData, *new_event);
+        gem_sys->FillZeroSupData(gemData, n, event);
 }
 
-// feed EPICS data
-void PRadDataHandler::FeedData(const EPICSRawData &epicsData)
+// feed EPICS data, it updates the current values in EPICS system
+void PRadDataHandler::FeedData(const EPICSRawData &epicsData, EventData &)
 {
     if(epic_sys)
         epic_sys->FillRawData(epicsData.buf);
@@ -323,34 +833,164 @@ void PRadDataHandler::FillHistograms(const EventData &data)
         tagger_sys->FillHists(data);
 }
 
-// signal of event end, save event or discard event in online mode
+// signal of event end, pass the event to the processing thread
 void PRadDataHandler::EndofThisEvent(const unsigned int &ev)
 {
-    new_event->event_number = ev;
-    // wait for the process thread
-    waitEventProcess();
+    static PRadMetricCounter *decoded = PRadMetrics::Instance()
+        .GetCounter("prad_events_decoded_total", "events decoded and passed to the end process");
+    decoded->Add();
+
+    size_t head = ring_head.load(std::memory_order_relaxed);
+    event_ring[head%EVENT_RING_SIZE].event_number = ev;
+
+    // publish the event
+    ring_head.store(head + 1);
+    if(!end_thread.joinable()) {
+        startEventProcess();
+    } else if(consumer_wait.load()) {
+        std::lock_guard<std::mutex> lock(ring_locker);
+        ring_cond.notify_all();
+    }
+
+    // wait for a free slot to build the next event
+    waitRingSlot(head + 1);
+    parser.SetEventBuilder(&event_ring[(head + 1)%EVENT_RING_SIZE]);
+}
+
+// wait for the end process to finish all the events in ring
+void PRadDataHandler::waitEventProcess()
+{
+    size_t head = ring_head.load(std::memory_order_relaxed);
+    if(ring_tail.load() != head) {
+        std::unique_lock<std::mutex> lock(ring_locker);
+        producer_wait.store(true);
+        ring_cond.wait(lock, [this, head] {return ring_tail.load() == head;});
+        producer_wait.store(false);
+    }
+
+    // the stages may still have events in their threads
+    pipeline.Flush();
 
-    // swap the pointers
-    EventData *tmp = new_event;
-    new_event = proc_event;
-    proc_event = tmp;
+    // no event in processing, the counters can be merged to the context
+    if(!run_counter.empty()) {
+        info_center->Merge(run_counter);
+        run_counter.reset();
+    }
+}
+
+// wait until the slot for the given head position is released
+void PRadDataHandler::waitRingSlot(size_t head)
+{
+    if(head - ring_tail.load() < EVENT_RING_SIZE)
+        return;
+
+    // the decoder waits for the end process
+    static PRadMetricCounter *wait_ns = PRadMetrics::Instance()
+        .GetCounter("prad_decoder_wait_seconds_total", "time the decoder waited for a free ring slot", 1e-9);
+    PRadMetricTimer timer(wait_ns);
 
-    end_thread = std::thread(&PRadDataHandler::EndProcess, this, proc_event);
+    std::unique_lock<std::mutex> lock(ring_locker);
+    producer_wait.store(true);
+    ring_cond.wait(lock, [this, head] {return head - ring_tail.load() < EVENT_RING_SIZE;});
+    producer_wait.store(false);
 }
 
-// wait for the end process to finish
-inline void PRadDataHandler::waitEventProcess()
+// start the long-lived processing thread
+void PRadDataHandler::startEventProcess()
 {
-    if(end_thread.joinable())
-        end_thread.join();
+    end_stop = false;
+    end_thread = std::thread(&PRadDataHandler::processEvents, this);
+
+    PRadMetrics::Instance().AddGauge("prad_event_ring_depth",
+                                     [this] () {return (double)(ring_head.load() - ring_tail.load());},
+                                     "decoded events waiting for the end process");
+}
+
+// process all the events left in ring and stop the thread
+void PRadDataHandler::stopEventProcess()
+{
+    if(!end_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(ring_locker);
+        end_stop = true;
+    }
+    ring_cond.notify_all();
+    end_thread.join();
+
+    PRadMetrics::Instance().RemoveGauge("prad_event_ring_depth");
+}
+
+// consumer of the event ring
+void PRadDataHandler::processEvents()
+{
+    auto &metrics = PRadMetrics::Instance();
+    PRadMetricCounter *busy_ns = metrics.GetCounter("prad_end_process_busy_seconds_total",
+                                                    "time the end process spent on the events", 1e-9);
+    PRadMetricCounter *wait_ns = metrics.GetCounter("prad_end_process_wait_seconds_total",
+                                                    "time the end process waited for the decoder", 1e-9);
+    PRadMetricCounter *processed = metrics.GetCounter("prad_events_processed_total",
+                                                      "events finished by the end process");
+
+    while(true)
+    {
+        size_t tail = ring_tail.load(std::memory_order_relaxed);
+
+        // no event to process, sleep until there is
+        if(tail == ring_head.load()) {
+            PRadMetricTimer timer(wait_ns);
+            std::unique_lock<std::mutex> lock(ring_locker);
+            consumer_wait.store(true);
+            ring_cond.wait(lock, [this, tail] {return end_stop || tail != ring_head.load();});
+            consumer_wait.store(false);
+            if(tail == ring_head.load())
+                return;
+            continue;
+        }
+
+        {
+            PRadMetricTimer timer(busy_ns);
+            EndProcess(&event_ring[tail%EVENT_RING_SIZE]);
+        }
+        processed->Add();
+
+        // release the slot
+        ring_tail.store(tail + 1);
+        if(producer_wait.load()) {
+            std::lock_guard<std::mutex> lock(ring_locker);
+            ring_cond.notify_all();
+        }
+    }
 }
 
 void PRadDataHandler::EndProcess(EventData *ev)
 {
-    if(ev->get_type() == EPICS_Info) {
+    PRAD_PROFILE_SCOPE("DataHandler::EndProcess");
+
+    if(!pipeline.Empty()) {
+
+        // the configured stages replace the default processing
+        if(ev->get_type() == EPICS_Info) {
+            if(epic_sys) {
+                epic_sys->SaveData(ev->event_number, onlineMode);
+                pipeline.ProcessEPICS(epic_sys->GetEventData().back());
+            }
+        } else {
+            if(epic_sys)
+                ev->epics_index = epic_sys->GetEpoch();
+            info_center->UpdateOnlineInfo(*ev);
+            run_counter.Add(*ev);
+            if(!scaler_only)
+                pipeline.Process(*ev);
+        }
+
+    } else if(ev->get_type() == EPICS_Info) {
 
         if(epic_sys) {
-            if(replayMode)
+            if(replayMode && replay_skip_epics)
+                replay_skip_epics--;
+            else if(replayMode)
                 dst_parser.Write(EpicsData(ev->event_number, epic_sys->GetCurrentValues()));
             else
                 epic_sys->SaveData(ev->event_number, onlineMode);
@@ -358,17 +998,35 @@ void PRadDataHandler::EndProcess(EventData *ev)
 
     } else { // event or sync event
 
-        FillHistograms(*ev);
-        PRadInfoCenter::Instance().UpdateInfo(*ev);
+        // the epics events are processed in order with the events
+        if(epic_sys)
+            ev->epics_index = epic_sys->GetEpoch();
+        info_center->UpdateOnlineInfo(*ev);
+        run_counter.Add(*ev);
+
+        // the partially decoded event only updates the counters
+        if(scaler_only) {
+            ev->clear();
+            return;
+        }
 
-        // online mode only saves the last event, to reduce usage of memory
-        if(onlineMode && event_data.size())
-            event_data.pop_front();
+        // the reading thread may run with the viewer
+        std::lock_guard<std::recursive_mutex> lock(data_locker);
+        FillHistograms(*ev);
 
-        if(replayMode)
+        // online mode only keeps the recent events in a bounded buffer, the
+        // viewer can read them while the new events are coming
+        if(replayMode && replay_skip_events)
+            replay_skip_events--;
+        else if(replayMode)
             dst_parser.Write(*ev);
+        else if(onlineMode)
+            online_buffer.Push(*ev);
         else
-            event_data.emplace_back(std::move(*ev)); // save event
+        {
+            event_data.Append(*ev); // save event
+            checkMemoryBudget();
+        }
 
     }
 
@@ -376,36 +1034,111 @@ void PRadDataHandler::EndProcess(EventData *ev)
     ev->clear();
 }
 
+// number of the events kept
+unsigned int PRadDataHandler::GetEventCount()
+const
+{
+    if(onlineMode)
+        return online_buffer.Size();
+    if(dst_events.IsOpen())
+        return dst_events.GetEventCount();
+    return event_spill.size() + event_data.size();
+}
+
+// memory held by the events, the ring between the decoder and the end
+// process is only counted by its slots since it is in use by the threads
+MemoryUsage PRadDataHandler::GetMemoryUsage()
+const
+{
+    std::lock_guard<std::recursive_mutex> lock(data_locker);
+
+    MemoryUsage res(event_data.MemoryUsage(), 8);
+    res += MemoryUsage(energy_cache.MemoryUsage(), 3);
+    res += MemoryUsage(event_spill.MemoryUsage(), event_spill.GetSegmentCount() + 2);
+    res.Add(event_ring, EVENT_RING_SIZE*sizeof(EventData));
+    res.Add(event_cache);
+    return res;
+}
+
 // get the event by index
+// in online mode, index counts back from the latest event
 const EventData &PRadDataHandler::GetEvent(const unsigned int &index)
 const
 throw (PRadException)
+{
+    if(onlineMode) {
+        size_t size = online_buffer.Size();
+        if(!size)
+            throw PRadException("PRad Data Handler Error", "Empty data bank!");
+
+        // the oldest events may be overwritten during reading
+        size_t back = std::min<size_t>(index, size - 1);
+        while(!online_buffer.Read(back, event_cache) && back > 0)
+            back = std::min<size_t>(back, online_buffer.Size()) - 1;
+        return event_cache;
+    }
+
+    // decode on demand, the index beyond range is the last event
+    if(dst_events.IsOpen()) {
+        size_t size = dst_events.GetEventCount();
+        if(!size || !dst_events.GetEvent(std::min<size_t>(index, size - 1), event_cache))
+            throw PRadException("PRad Data Handler Error", "Failed to decode event from DST file!");
+        if(epic_sys)
+            event_cache.epics_index = epic_sys->FindEpoch(event_cache.event_number);
+        return event_cache;
+    }
+
+    // the spilled events are before the ones in memory
+    size_t nspill = event_spill.size();
+    if(nspill && (index < nspill || event_data.empty())) {
+        if(!event_spill.GetEvent(std::min<size_t>(index, nspill - 1), event_cache))
+            throw PRadException("PRad Data Handler Error", "Failed to read the spilled event!");
+        if(epic_sys)
+            event_cache.epics_index = epic_sys->FindEpoch(event_cache.event_number);
+        return event_cache;
+    }
+
+    GetEventView(index).Fill(event_cache);
+    return event_cache;
+}
+
+// get the view of event by index, it does not build the event
+// it is not available for the events kept in online mode or spilled to disk
+EventView PRadDataHandler::GetEventView(const unsigned int &index)
+const
+throw (PRadException)
 {
     if(!event_data.size())
         throw PRadException("PRad Data Handler Error", "Empty data bank!");
 
-    if(index >= event_data.size()) {
+    size_t nspill = event_spill.size();
+    if(index < nspill)
+        throw PRadException("PRad Data Handler Error", "The event is spilled to disk!");
+
+    if(index - nspill >= event_data.size()) {
         return event_data.back();
     } else {
-        return event_data.at(index);
+        return event_data[index - nspill];
     }
 }
 
 // Refill energy hist after correct gain factos
-void PRadDataHandler::RefillEnergyHist()
+// the adc sums are only read from the events again when the events or the
+// pedestals changed
+void PRadDataHandler::RefillEnergyHist(unsigned int nthreads)
 {
     if(!hycal_sys)
         return;
 
     hycal_sys->ResetEnergyHist();
 
-    for(auto &event : event_data)
-    {
-        if(!event.is_physics_event())
-            continue;
+    energy_cache.Update(event_data, *hycal_sys);
 
-        hycal_sys->FillEnergyHist(event);
-    }
+    std::vector<double> energies;
+    energy_cache.GetEnergies(energies, nthreads);
+
+    for(auto &energy : energies)
+        hycal_sys->FillEnergyHist(energy);
 }
 
 // try to get all the needed information from monitor events
@@ -424,8 +1157,26 @@ void PRadDataHandler::InitializeByData(const std::string &path, int ref)
               << "\"" << path << "\"."
               << std::endl;
 
+    // restore the results from the snapshot of the same data file
+    PRadInitSnapshot snapshot;
+    PRadInitSnapshot::Source src;
+    std::string snapshot_path;
+    if(!path.empty()) {
+        info_center->ChangeRunNumber(path);
+        snapshot_path = initSnapshotPath(info_center->RunNumber());
+        src = PRadInitSnapshot::file_source(path, info_center->RunNumber(), ref);
+    }
+
+    if(!snapshot_path.empty() && src.size >= 0 && snapshot.Load(snapshot_path, src)) {
+        snapshot.Apply(hycal_sys, gem_sys);
+        std::cout << "Data Handler: Restored initialization from "
+                  << "\"" << snapshot_path << "\", took "
+                  << timer.GetElapsedTime() << " ms"
+                  << std::endl;
+        return;
+    }
+
     if(!path.empty()) {
-        PRadInfoCenter::SetRunNumber(path);
         gem_sys->SetPedestalMode(true);
         parser.ReadEvioFile(path.c_str(), 20000);
     }
@@ -442,10 +1193,19 @@ void PRadDataHandler::InitializeByData(const std::string &path, int ref)
     std::cout << "Data Handler: Releasing Memeory." << std::endl;
     gem_sys->SetPedestalMode(false);
 
+    if(!snapshot_path.empty() && src.size >= 0) {
+        snapshot.Take(src, hycal_sys, gem_sys);
+        if(snapshot.Save(snapshot_path)) {
+            std::cout << "Data Handler: Saved initialization to "
+                      << "\"" << snapshot_path << "\"."
+                      << std::endl;
+        }
+    }
+
     // save run number
-    int run_number = PRadInfoCenter::GetRunNumber();
+    int run_number = info_center->RunNumber();
     Clear();
-    PRadInfoCenter::SetRunNumber(run_number);
+    info_center->ChangeRunNumber(run_number);
 
     std::cout << "Data Handler: Done initialization, took "
               << timer.GetElapsedTime()/1000. << " s"
@@ -458,22 +1218,40 @@ void PRadDataHandler::InitializeByData(const std::string &path, int ref)
 int PRadDataHandler::FindEvent(int evt)
 const
 {
-    auto it = cana::binary_search(event_data.begin(), event_data.end(), evt);
+    int index = event_spill.Find(evt);
+    if(index >= 0)
+        return index;
 
-    if(it == event_data.end())
-        return -1;
-
-    return it - event_data.begin();
+    index = event_data.Find(evt);
+    return (index < 0) ? index : index + event_spill.size();
 }
 
 // replay the raw data file, do zero suppression and save it in DST format
-void PRadDataHandler::Replay(const std::string &r_path, int split, const std::string &w_path)
+// in resume mode, the output is continued from its last checkpoint if it
+// exists, the raw data are still decoded from the beginning, but the events
+// already in the output are not written again
+// return the number of replayed events
+int PRadDataHandler::Replay(const std::string &r_path, int split, const std::string &w_path,
+                            bool resume)
 {
-    if(w_path.empty()) {
-        std::string file = "prad_" + std::to_string(PRadInfoCenter::GetRunNumber()) + ".dst";
-        dst_parser.OpenOutput(file);
+    // the DST output does not block the end process
+    dst_parser.SetAsyncOutput(true);
+
+    std::string file = w_path;
+    if(file.empty())
+        file = "prad_" + std::to_string(info_center->RunNumber()) + ".dst";
+
+    PRadDSTParser::Checkpoint ckpt;
+    replay_skip_events = replay_skip_epics = 0;
+    if(resume && std::ifstream(file).good() && dst_parser.ResumeOutput(file, ckpt)) {
+        replay_skip_events = ckpt.events;
+        replay_skip_epics = ckpt.epics;
+        std::cout << "Replay resumed from the checkpoint at " << ckpt.position
+                  << ", " << ckpt.events << " events and " << ckpt.epics
+                  << " EPICS events are already in \"" << file << "\"."
+                  << std::endl;
     } else {
-        dst_parser.OpenOutput(w_path);
+        dst_parser.OpenOutput(file);
     }
 
     std::cout << "Replay started!" << std::endl;
@@ -489,7 +1267,19 @@ void PRadDataHandler::Replay(const std::string &r_path, int split, const std::st
               << timer.GetElapsedTime()/1000. << " s! "
               << "Replayed " << count << " events."
               << std::endl;
+    dst_parser.GetOutputSummary().SetRunNumber(info_center->RunNumber());
     dst_parser.CloseOutput();
+
+    auto &stats = dst_parser.GetWriteStats();
+    std::cout << "DST output: " << stats.bytes/1e6 << " MB in "
+              << stats.writes << " writes, " << stats.Throughput() << " MB/s, "
+              << "queue depth " << stats.AvgDepth() << " (avg) "
+              << stats.max_depth << " (max), "
+              << "waited " << stats.wait_time << " ms for free buffers."
+              << std::endl;
+    dst_parser.SetAsyncOutput(false);
+
+    return count;
 }
 
 // write the current data bank to DST file
@@ -509,8 +1299,16 @@ void PRadDataHandler::WriteToDST(const std::string &path)
             }
         }
 
-        for(auto &event : event_data)
+        EventData event;
+        for(size_t i = 0; i < event_spill.size(); ++i)
+        {
+            if(event_spill.GetEvent(i, event))
+                dst_parser.Write(event);
+        }
+
+        for(auto view : event_data)
         {
+            view.Fill(event);
             dst_parser.Write(event);
         }
 
@@ -523,5 +1321,6 @@ void PRadDataHandler::WriteToDST(const std::string &path)
                   << "Write to DST Aborted!" << std::endl;
     }
 
+    dst_parser.GetOutputSummary().SetRunNumber(info_center->RunNumber());
     dst_parser.CloseOutput();
 }
@@ -18,9 +18,10 @@
 //============================================================================//
 
 #include "PRadDetMatch.h"
+#include "PRadProfiler.h"
 #include "PRadCoordSystem.h"
 #include <algorithm>
-#include <set>
+#include <iostream>
 
 // constructor
 PRadDetMatch::PRadDetMatch(const std::string &path)
@@ -49,34 +50,285 @@ void PRadDetMatch::Configure(const std::string &path)
     CONF_CONN(squareSel, "Square_Selection", true, verbose);
 }
 
-template<typename T>
-inline bool is_in(const std::set<T> &s, const T &i)
+// uniform grid of the projected gem hits on HyCal plane, the hit indices are
+// sorted by their cells, so a cell is a range of the indices
+class HitGrid
 {
-    return s.find(i) != s.end();
-}
+public:
+    // the bounding box of all the hits is divided into cells
+    // the hits are projected from their columns
+    void Fill(const GEMHitSoA &hits, float min_cell)
+    {
+        size_t n = hits.size();
+        px.resize(n);
+        py.resize(n);
+        PRadCoordSystem::ProjectionBatch(hits.x.data(), hits.y.data(), hits.z.data(), n,
+                                         PRadCoordSystem::target(),
+                                         PRadCoordSystem::hycal_z(),
+                                         px.data(), py.data());
+
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(!i || px[i] < xmin) xmin = px[i];
+            if(!i || px[i] > xmax) xmax = px[i];
+            if(!i || py[i] < ymin) ymin = py[i];
+            if(!i || py[i] > ymax) ymax = py[i];
+        }
 
-// define operator for set
-// in this definition, if two gem hits are from the same gem detector and have
-// the same reconstructed x, y, then they are the same hits
-bool operator <(const GEMHit &lhs, const GEMHit &rhs)
+        if(!n) {
+            nx = ny = 0;
+            return;
+        }
+
+        cell = min_cell;
+        while(true)
+        {
+            nx = static_cast<int>((xmax - xmin)/cell) + 1;
+            ny = static_cast<int>((ymax - ymin)/cell) + 1;
+            if((size_t)nx*ny <= DET_MATCH_GRID_MAX)
+                break;
+            cell *= 2.;
+        }
+
+        // counting sort of the indices by cells
+        start.assign(nx*ny + 1, 0);
+        cells.resize(n);
+        for(size_t i = 0; i < n; ++i)
+        {
+            cells[i] = cellIndex(py[i], ny, ymin)*nx + cellIndex(px[i], nx, xmin);
+            start[cells[i] + 1]++;
+        }
+        for(int c = 0; c < nx*ny; ++c)
+            start[c + 1] += start[c];
+
+        index.resize(n);
+        fill = start;
+        for(size_t i = 0; i < n; ++i)
+            index[fill[cells[i]]++] = i;
+    }
+
+    // collect the hit indices in the cells overlapping the square, in the
+    // original order of the hits
+    void Query(float x, float y, float range, std::vector<uint32_t> &result) const
+    {
+        result.clear();
+        if(!nx || !(range >= 0.))
+            return;
+
+        // a small margin for the rounding of the projections
+        range = range*1.001 + 1e-3;
+        if(x + range < xmin || x - range > xmax || y + range < ymin || y - range > ymax)
+            return;
+
+        int ix0 = cellIndex(x - range, nx, xmin), ix1 = cellIndex(x + range, nx, xmin);
+        int iy0 = cellIndex(y - range, ny, ymin), iy1 = cellIndex(y + range, ny, ymin);
+
+        for(int iy = iy0; iy <= iy1; ++iy)
+        {
+            for(int ix = ix0; ix <= ix1; ++ix)
+            {
+                int c = iy*nx + ix;
+                result.insert(result.end(), index.begin() + start[c], index.begin() + start[c + 1]);
+            }
+        }
+
+        std::sort(result.begin(), result.end());
+    }
+
+    // projected coordinates of the hits
+    const std::vector<float> &GetX() const {return px;}
+    const std::vector<float> &GetY() const {return py;}
+
+private:
+    int cellIndex(float v, int n, float vmin) const
+    {
+        float i = std::min<float>(n - 1, std::max<float>(0., (v - vmin)/cell));
+        return static_cast<int>(i);
+    }
+
+private:
+    float xmin, xmax, ymin, ymax, cell;
+    int nx, ny;
+    std::vector<float> px, py;
+    std::vector<uint32_t> start, fill, cells, index;
+};
+
+// buffers for the candidates from the grid query
+struct CandBuffer
 {
-    if(lhs.det_id != rhs.det_id)
-        return lhs.det_id < rhs.det_id;
+    std::vector<float> x, y;
+    std::vector<char> pass;
+};
+
+// check the candidates from the grid query, the projected coordinates from the
+// grid are used for the pre match
+// the passed indices are kept in idx
+inline void get_candidates(const PRadDetMatch *m, const HyCalHit &hit, const HitGrid &grid,
+                           const std::vector<char> &matched,
+                           const std::vector<uint32_t> &query, CandBuffer &buf,
+                           std::vector<uint32_t> &idx)
+{
+    idx.clear();
+    size_t n = 0;
+    buf.x.resize(query.size());
+    buf.y.resize(query.size());
+    buf.pass.resize(query.size());
+    for(auto i : query)
+    {
+        if(matched[i])
+            continue;
+        idx.push_back(i);
+        buf.x[n] = grid.GetX()[i];
+        buf.y[n] = grid.GetY()[i];
+        ++n;
+    }
+
+    if(!m->PreMatch(hit, buf.x.data(), buf.y.data(), n, buf.pass.data())) {
+        idx.clear();
+        return;
+    }
+
+    size_t np = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(buf.pass[i])
+            idx[np++] = idx[i];
+    }
+    idx.resize(np);
+}
 
-    if(lhs.x != rhs.x)
-        return lhs.x < rhs.x;
+// mark the rest of the hits at the same position of the matched one, they are
+// regarded as the same hit
+inline void mark_matched(const GEMHit &best, const std::vector<GEMHit> &gem,
+                         const std::vector<uint32_t> &idx, std::vector<char> &matched)
+{
+    for(auto i : idx)
+    {
+        if(gem[i].det_id == best.det_id && gem[i].x == best.x && gem[i].y == best.y)
+            matched[i] = 1;
+    }
+}
 
-    return lhs.y < rhs.y;
+// the buffers of a result for the next events
+struct PRadDetMatch::Result::Scratch
+{
+    GEMHitSoA cols1, cols2;
+    HitGrid grid1, grid2;
+    std::vector<char> matched1, matched2;
+    std::vector<uint32_t> query, idx1, idx2;
+    CandBuffer buf;
 };
 
+PRadDetMatch::Result::Result()
+{
+    // place holder
+}
+
+PRadDetMatch::Result::Result(Result &&that)
+: hits(std::move(that.hits)), cands(std::move(that.cands)), scratch(std::move(that.scratch))
+{
+    // place holder
+}
+
+PRadDetMatch::Result::~Result()
+{
+    // place holder
+}
+
+PRadDetMatch::Result &PRadDetMatch::Result::operator =(Result &&rhs)
+{
+    hits = std::move(rhs.hits);
+    cands = std::move(rhs.cands);
+    scratch = std::move(rhs.scratch);
+    return *this;
+}
+
+MatchHit PRadDetMatch::Result::ToMatchHit(size_t i, const std::vector<HyCalHit> &hycal,
+                                          const std::vector<GEMHit> &gem1,
+                                          const std::vector<GEMHit> &gem2)
+const
+{
+    const Hit &h = hits[i];
+    MatchHit mhit(hycal[h.hycal_idx]);
+    mhit.gem1.reserve(h.gem1_end - h.gem1_begin);
+    for(uint32_t k = h.gem1_begin; k < h.gem1_end; ++k)
+        mhit.gem1.push_back(gem1[cands[k]]);
+    mhit.gem2.reserve(h.gem2_end - h.gem2_begin);
+    for(uint32_t k = h.gem2_begin; k < h.gem2_end; ++k)
+        mhit.gem2.push_back(gem2[cands[k]]);
+
+    mhit.mflag = h.mflag;
+    mhit.hycal_idx = h.hycal_idx;
+    mhit.gem = TEST_BIT(h.mflag, kGEM1Match) ? gem1[h.gem_idx] : gem2[h.gem_idx];
+    mhit.SubstituteCoord(h);
+    return mhit;
+}
+
 std::vector<MatchHit> PRadDetMatch::Match(std::vector<HyCalHit> &hycal,
                                           const std::vector<GEMHit> &gem1,
                                           const std::vector<GEMHit> &gem2)
 const
 {
+    GEMHitSoA cols1, cols2;
+    cols1.Assign(gem1);
+    cols2.Assign(gem2);
+    return Match(hycal, gem1, gem2, cols1, cols2);
+}
+
+std::vector<MatchHit> PRadDetMatch::Match(std::vector<HyCalHit> &hycal,
+                                          const std::vector<GEMHit> &gem1,
+                                          const std::vector<GEMHit> &gem2,
+                                          const GEMHitSoA &cols1,
+                                          const GEMHitSoA &cols2)
+const
+{
+    Result res;
+    Match(hycal, gem1, gem2, cols1, cols2, res);
+
     std::vector<MatchHit> result;
-    std::set<GEMHit> matched1, matched2;
-    std::vector<GEMHit> cand1, cand2;
+    result.reserve(res.size());
+    for(size_t i = 0; i < res.size(); ++i)
+        result.emplace_back(res.ToMatchHit(i, hycal, gem1, gem2));
+    return result;
+}
+
+// the columns are built in the scratch of the result
+void PRadDetMatch::Match(std::vector<HyCalHit> &hycal,
+                         const std::vector<GEMHit> &gem1,
+                         const std::vector<GEMHit> &gem2,
+                         Result &res)
+const
+{
+    if(!res.scratch)
+        res.scratch.reset(new Result::Scratch());
+
+    res.scratch->cols1.Assign(gem1);
+    res.scratch->cols2.Assign(gem2);
+    Match(hycal, gem1, gem2, res.scratch->cols1, res.scratch->cols2, res);
+}
+
+void PRadDetMatch::Match(std::vector<HyCalHit> &hycal,
+                         const std::vector<GEMHit> &gem1,
+                         const std::vector<GEMHit> &gem2,
+                         const GEMHitSoA &cols1,
+                         const GEMHitSoA &cols2,
+                         Result &res)
+const
+{
+    PRAD_PROFILE_SCOPE("DetMatch::Match");
+
+    res.clear();
+    if(cols1.size() != gem1.size() || cols2.size() != gem2.size()) {
+        std::cerr << "PRadDetMatch Error: The hit columns do not match the gem hits."
+                  << std::endl;
+        return;
+    }
+
+    if(!res.scratch)
+        res.scratch.reset(new Result::Scratch());
+    auto &sc = *res.scratch;
+    sc.matched1.assign(gem1.size(), 0);
+    sc.matched2.assign(gem2.size(), 0);
 
     // sort in energy descendant order
     std::sort(hycal.begin(), hycal.end(), [] (const HyCalHit &h1, const HyCalHit &h2)
@@ -84,52 +336,59 @@ const
                                               return h2.E < h1.E;
                                           });
 
+    // the cells are large enough for the largest matching range
+    float max_range = 1.;
+    for(auto &hit : hycal)
+        max_range = std::max(max_range, hit.sig_pos*matchSigma);
+
+    // project the gem hits once for this event
+    sc.grid1.Fill(cols1, max_range);
+    sc.grid2.Fill(cols2, max_range);
+
     for(size_t i = 0; i < hycal.size(); ++i)
     {
         const auto &hit = hycal.at(i);
 
-        // clean up cand1 and cand2 first
-        cand1.clear();
-        cand2.clear();
-
         // pre match, only check if distance is within the range
         // fill in hits as candidates
-        for(auto &ghit : gem1)
-        {
-            if(PreMatch(hit, ghit) && !is_in(matched1, ghit))
-                cand1.push_back(ghit);
-        }
-        for(auto &ghit : gem2)
-        {
-            if(PreMatch(hit, ghit) && !is_in(matched2, ghit))
-                cand2.push_back(ghit);
-        }
+        Point p(hit.x, hit.y, hit.z);
+        PRadCoordSystem::Projection(p, PRadCoordSystem::target(), PRadCoordSystem::hycal_z());
+        float range = hit.sig_pos*matchSigma;
+
+        sc.grid1.Query(p.x, p.y, range, sc.query);
+        get_candidates(this, hit, sc.grid1, sc.matched1, sc.query, sc.buf, sc.idx1);
+        sc.grid2.Query(p.x, p.y, range, sc.query);
+        get_candidates(this, hit, sc.grid2, sc.matched2, sc.query, sc.buf, sc.idx2);
 
         // no candidates
-        if(cand1.empty() && cand2.empty())
+        if(sc.idx1.empty() && sc.idx2.empty())
             continue;
 
-        // create a new MatchHit
-        result.emplace_back(hit, std::move(cand1), std::move(cand2));
-        MatchHit &mhit = result.back();
-
-        // TODO remove it in PRadEventStruct.h
+        // create a new matched hit, the candidates are appended
+        Result::Hit mhit;
+        static_cast<BaseHit&>(mhit) = BaseHit(hit.x, hit.y, hit.z, hit.E);
         mhit.hycal_idx = i;
+        mhit.mflag = 0;
+        mhit.gem1_begin = res.cands.size();
+        res.cands.insert(res.cands.end(), sc.idx1.begin(), sc.idx1.end());
+        mhit.gem1_end = mhit.gem2_begin = res.cands.size();
+        res.cands.insert(res.cands.end(), sc.idx2.begin(), sc.idx2.end());
+        mhit.gem2_end = res.cands.size();
 
         // find the matching status between HyCal and 2 GEMs
-        PostMatch(mhit);
+        PostMatch(hit, gem1, gem2, res, mhit);
 
         // matched with gem1
         if(TEST_BIT(mhit.mflag, kGEM1Match)) {
-            matched1.insert(mhit.gem1.front());
+            mark_matched(gem1[res.cands[mhit.gem1_begin]], gem1, sc.idx1, sc.matched1);
         }
         // matched with gem2
         if(TEST_BIT(mhit.mflag, kGEM2Match)) {
-            matched2.insert(mhit.gem2.front());
+            mark_matched(gem2[res.cands[mhit.gem2_begin]], gem2, sc.idx2, sc.matched2);
         }
-    }
 
-    return result;
+        res.hits.push_back(mhit);
+    }
 }
 
 // project 1 HyCal cluster and 1 GEM cluster to HyCal Plane.
@@ -159,6 +418,71 @@ const
     }
 }
 
+// the gem hits are already projected so only the hycal hit is projected here
+size_t PRadDetMatch::PreMatch(const HyCalHit &hycal, const float *px, const float *py,
+                              size_t n, char *pass)
+const
+{
+    float range = hycal.sig_pos*matchSigma;
+    Point p(hycal.x, hycal.y, hycal.z);
+    PRadCoordSystem::Projection(p, PRadCoordSystem::target(), PRadCoordSystem::hycal_z());
+
+    size_t count = 0;
+    if(squareSel) {
+        for(size_t i = 0; i < n; ++i)
+        {
+            pass[i] = (fabs(p.x - px[i]) <= range) && (fabs(p.y - py[i]) <= range);
+            count += pass[i];
+        }
+    } else {
+        // distances are compared in squares
+        float range2 = range*range;
+        for(size_t i = 0; i < n; ++i)
+        {
+            float dx = p.x - px[i], dy = p.y - py[i];
+            pass[i] = (dx*dx + dy*dy <= range2);
+            count += pass[i];
+        }
+    }
+    return count;
+}
+
+// pre match the hycal hits with the gem hits from the same events, both are
+// columns and the gem hits are projected to HyCal plane in advance, the pairs
+// of indices within the range are appended, the events should be in the same
+// order in both columns
+size_t PRadDetMatch::PreMatch(const HyCalHitSoA &hycal, const float *px, const float *py,
+                              const GEMHitSoA &gem,
+                              std::vector<std::pair<uint32_t, uint32_t>> &pairs)
+const
+{
+    size_t count = 0, gbeg = 0;
+    std::vector<char> pass;
+    for(size_t i = 0; i < hycal.size(); ++i)
+    {
+        uint32_t ev = hycal.event[i];
+        while(gbeg < gem.size() && gem.event[gbeg] < ev)
+            ++gbeg;
+        size_t gend = gbeg;
+        while(gend < gem.size() && gem.event[gend] == ev)
+            ++gend;
+        if(gend == gbeg)
+            continue;
+
+        pass.resize(gend - gbeg);
+        if(!PreMatch(hycal.at(i), px + gbeg, py + gbeg, gend - gbeg, pass.data()))
+            continue;
+        for(size_t j = gbeg; j < gend; ++j)
+        {
+            if(pass[j - gbeg]) {
+                pairs.emplace_back(i, j);
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
 void PRadDetMatch::PostMatch(MatchHit &h)
 const
 {
@@ -218,3 +542,67 @@ const
         h.SubstituteCoord(h.gem2.front());
     }
 }
+
+// the candidates are sorted in their ranges, and the coordinates of the best
+// matched gem hit are copied to h
+void PRadDetMatch::PostMatch(const HyCalHit &hycal, const std::vector<GEMHit> &gem1,
+                             const std::vector<GEMHit> &gem2, Result &res, Result::Hit &h)
+const
+{
+    uint32_t *c1 = res.cands.data() + h.gem1_begin, *c1_end = res.cands.data() + h.gem1_end;
+    uint32_t *c2 = res.cands.data() + h.gem2_begin, *c2_end = res.cands.data() + h.gem2_end;
+
+    // sanity check, it should be rejected before calling the function
+    if(c1 == c1_end && c2 == c2_end) {
+        return;
+    }
+
+    // sort the candidates by delta_r between HyCal hit and GEM hits
+    std::sort(c1, c1_end, [&] (uint32_t i1, uint32_t i2)
+                          {
+                              return   PRadCoordSystem::ProjectionDistance(hycal, gem1[i1])
+                                     < PRadCoordSystem::ProjectionDistance(hycal, gem1[i2]);
+                          });
+    std::sort(c2, c2_end, [&] (uint32_t i1, uint32_t i2)
+                          {
+                              return   PRadCoordSystem::ProjectionDistance(hycal, gem2[i1])
+                                     < PRadCoordSystem::ProjectionDistance(hycal, gem2[i2]);
+                          });
+
+    if(c1 != c1_end) {
+        SET_BIT(h.mflag, kGEM1Match);
+    }
+
+    if(c2 != c2_end) {
+        SET_BIT(h.mflag, kGEM2Match);
+    }
+
+    // have candidates from both gem, check which one matches better
+    if(c1 != c1_end && c2 != c2_end) {
+        const GEMHit &hit1 = gem1[*c1], &hit2 = gem2[*c2];
+        float gem_dist = PRadCoordSystem::ProjectionDistance(hit1, hit2, PRadCoordSystem::target(), hit1.z);
+        // not overlapping match
+        if(gem_dist > overlapSigma * hit1.sig_pos) {
+            float dist1 = PRadCoordSystem::ProjectionDistance(h, hit1);
+            float dist2 = PRadCoordSystem::ProjectionDistance(h, hit2);
+            if(dist1 < dist2) {
+                CLEAR_BIT(h.mflag, kGEM2Match);
+            } else {
+                CLEAR_BIT(h.mflag, kGEM1Match);
+            }
+        }
+    }
+
+    // gem1 will always be used in overlapping match
+    const GEMHit *best;
+    if(TEST_BIT(h.mflag, kGEM1Match)) {
+        h.gem_idx = *c1;
+        best = &gem1[*c1];
+    } else {
+        h.gem_idx = *c2;
+        best = &gem2[*c2];
+    }
+    h.x = best->x;
+    h.y = best->y;
+    h.z = best->z;
+}
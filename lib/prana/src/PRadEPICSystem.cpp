@@ -18,6 +18,7 @@
 #define EPICS_UNDEFINED_VALUE -9999.9
 
 PRadEPICSystem::PRadEPICSystem(const std::string &path)
+: epics_base(0), online_window(EPICS_ONLINE_WINDOW), history_base(0)
 {
     ReadMap(path);
 }
@@ -30,6 +31,14 @@ PRadEPICSystem::~PRadEPICSystem()
 void PRadEPICSystem::Reset()
 {
     epics_data = std::deque<EpicsData>();
+    epics_evnums = std::vector<int32_t>();
+    epics_columns = std::vector<std::vector<float>>();
+    epics_base = 0;
+
+    history = std::deque<EpicsDelta>();
+    history_front.clear();
+    history_last.clear();
+    history_base = 0;
 
     for(auto &value : epics_values)
     {
@@ -115,20 +124,49 @@ void PRadEPICSystem::FillRawData(const char *data)
 
 void PRadEPICSystem::AddEvent(EpicsData &&data)
 {
+    addColumns(data);
     epics_data.emplace_back(data);
 }
 
 void PRadEPICSystem::AddEvent(const EpicsData &data)
 {
+    addColumns(data);
     epics_data.push_back(data);
 }
 
 void PRadEPICSystem::SaveData(const int &event_number, bool online)
 {
-    if(online && epics_data.size())
+    if(online && epics_data.size()) {
         epics_data.pop_front();
+        epics_evnums.erase(epics_evnums.begin());
+        epics_base++;
+        for(auto &column : epics_columns)
+            column.erase(column.begin());
+    }
 
     epics_data.emplace_back(event_number, epics_values);
+    addColumns(epics_data.back());
+
+    if(online)
+        addHistory(epics_data.back());
+}
+
+// append the event to the columns, the channels that are not in the event are
+// undefined
+void PRadEPICSystem::addColumns(const EpicsData &data)
+{
+    if(data.values.size() > epics_columns.size())
+        epics_columns.resize(data.values.size(),
+                             std::vector<float>(epics_evnums.size(), EPICS_UNDEFINED_VALUE));
+
+    epics_evnums.push_back(data.event_number);
+    for(size_t i = 0; i < epics_columns.size(); ++i)
+    {
+        if(i < data.values.size())
+            epics_columns[i].push_back(data.values[i]);
+        else
+            epics_columns[i].push_back(EPICS_UNDEFINED_VALUE);
+    }
 }
 
 float PRadEPICSystem::GetValue(const std::string &name)
@@ -168,8 +206,6 @@ const
 float PRadEPICSystem::FindValue(int evt, const std::string &name)
 const
 {
-    float result = EPICS_UNDEFINED_VALUE;
-
     auto it = epics_map.find(name);
     if(it == epics_map.end()) {
         std::cerr << "PRad EPICS Warning: Did not find EPICS channel "
@@ -178,19 +214,173 @@ const
         return EPICS_UNDEFINED_VALUE;
     }
 
-    uint32_t channel_id = it->second;
+    return FindValue(evt, it->second);
+}
+
+// value of the channel from the epics event that just before evt
+float PRadEPICSystem::FindValue(int evt, int channel)
+const
+{
+    if(channel < 0 || channel >= (int)epics_columns.size())
+        return EPICS_UNDEFINED_VALUE;
 
-    auto ev_it = cana::binary_search_close_less(epics_data.begin(), epics_data.end(), evt);
+    auto it = cana::branchless_upper_bound(epics_evnums.begin(), epics_evnums.end(), evt);
+    if(it == epics_evnums.begin())
+        return EPICS_UNDEFINED_VALUE;
 
-    // found the epics event that just before evt, and it has that channel
-    if((ev_it != epics_data.end()) &&
-       (ev_it->values.size() > channel_id)) {
-        result = ev_it->values.at(channel_id);
+    return epics_columns[channel][it - epics_evnums.begin() - 1];
+}
+
+// epoch of the epics event that just before evt, -1 if there is none
+int PRadEPICSystem::FindEpoch(int evt)
+const
+{
+    auto it = cana::branchless_upper_bound(epics_evnums.begin(), epics_evnums.end(), evt);
+    if(it == epics_evnums.begin())
+        return -1;
+
+    return epics_base + (it - epics_evnums.begin() - 1);
+}
+
+// value of the channel at the epoch, the removed epochs are searched in the
+// online history, it is undefined if the epoch is not in the history either
+float PRadEPICSystem::GetEpochValue(int epoch, int channel)
+const
+{
+    int idx = epoch - epics_base;
+    if(epoch < 0 || channel < 0 || idx >= (int)epics_evnums.size())
+        return EPICS_UNDEFINED_VALUE;
+
+    if(idx < 0)
+        return getHistoryValue(epoch, channel);
+
+    if(channel >= (int)epics_columns.size())
+        return EPICS_UNDEFINED_VALUE;
+
+    return epics_columns[channel][idx];
+}
+
+// change the size of the history, the oldest ones are removed
+void PRadEPICSystem::SetOnlineWindow(size_t n)
+{
+    online_window = n;
+
+    while(history.size() > online_window)
+    {
+        for(auto &change : history.front().changes)
+            history_front[change.first] = change.second;
+        history.pop_front();
+        history_base++;
+    }
+}
+
+// the values of the channel in the history
+std::vector<std::pair<int, float>> PRadEPICSystem::GetHistory(int channel)
+const
+{
+    std::vector<std::pair<int, float>> result;
+    if(channel < 0)
+        return result;
+
+    result.reserve(history.size());
+    float value = (channel < (int)history_front.size()) ?
+                  history_front[channel] : EPICS_UNDEFINED_VALUE;
+    for(auto &delta : history)
+    {
+        for(auto &change : delta.changes)
+        {
+            if((int)change.first == channel)
+                value = change.second;
+        }
+        result.emplace_back(delta.event_number, value);
     }
 
     return result;
 }
 
+const std::vector<float> &PRadEPICSystem::GetChannelValues(int channel)
+const
+{
+    static const std::vector<float> empty;
+
+    if(channel < 0 || channel >= (int)epics_columns.size())
+        return empty;
+
+    return epics_columns[channel];
+}
+
+// memory held by the epics events, the columns and the online history
+MemoryUsage PRadEPICSystem::GetMemoryUsage()
+const
+{
+    MemoryUsage res;
+    res.Add(epics_data);
+    for(auto &data : epics_data)
+        res.Add(data.values);
+
+    res.Add(epics_evnums);
+    res.Add(epics_columns);
+    for(auto &column : epics_columns)
+        res.Add(column);
+
+    res.Add(history);
+    for(auto &delta : history)
+        res.Add(delta.changes);
+    return res;
+}
+
+// add the changed channels of the latest event to the online history
+void PRadEPICSystem::addHistory(const EpicsData &data)
+{
+    if(!online_window)
+        return;
+
+    if(history.empty()) {
+        history_front = history_last;
+        history_base = GetEpoch();
+    }
+
+    EpicsDelta delta;
+    delta.event_number = data.event_number;
+    if(history_last.size() < data.values.size())
+        history_last.resize(data.values.size(), EPICS_UNDEFINED_VALUE);
+    for(size_t i = 0; i < data.values.size(); ++i)
+    {
+        if(data.values[i] != history_last[i]) {
+            delta.changes.emplace_back(i, data.values[i]);
+            history_last[i] = data.values[i];
+        }
+    }
+
+    // the new channels in the front are undefined
+    if(history_front.size() < history_last.size())
+        history_front.resize(history_last.size(), EPICS_UNDEFINED_VALUE);
+
+    history.emplace_back(std::move(delta));
+    SetOnlineWindow(online_window);
+}
+
+// apply the changes from the front to the epoch
+float PRadEPICSystem::getHistoryValue(int epoch, int channel)
+const
+{
+    int idx = epoch - history_base;
+    if(idx < 0 || idx >= (int)history.size() || channel >= (int)history_front.size())
+        return EPICS_UNDEFINED_VALUE;
+
+    float value = history_front[channel];
+    for(int i = 0; i <= idx; ++i)
+    {
+        for(auto &change : history[i].changes)
+        {
+            if((int)change.first == channel)
+                value = change.second;
+        }
+    }
+
+    return value;
+}
+
 std::vector<EPICSChannel> PRadEPICSystem::GetSortedList()
 const
 {
@@ -248,7 +438,7 @@ throw(PRadException)
 int PRadEPICSystem::FindEvent(int evt)
 const
 {
-    auto it = cana::binary_search_close_less(epics_data.begin(), epics_data.end(), evt);
+    auto it = cana::fast_binary_search_close_less(epics_data.begin(), epics_data.end(), evt);
 
     // found the epics event that just before evt, and it has that channel
     if(it != epics_data.end())
@@ -256,3 +446,33 @@ const
 
     return -1;
 }
+
+// advance to the epics event that just before evt
+float PRadEPICSystem::Cursor::Value(int evt)
+{
+    if(!sys || channel < 0 || channel >= (int)sys->epics_columns.size())
+        return EPICS_UNDEFINED_VALUE;
+
+    const auto &evnums = sys->epics_evnums;
+    int size = evnums.size();
+
+    // the data has been changed
+    if(index >= size)
+        index = -1;
+
+    if(index >= 0 && evnums[index] > evt) {
+        // backward, search from the beginning
+        index = std::upper_bound(evnums.begin(), evnums.begin() + index, evt) - evnums.begin() - 1;
+    } else if(index + 1 < size && evnums[index + 1] <= evt) {
+        // forward, the next one is the most common case
+        if(index + 2 >= size || evnums[index + 2] > evt)
+            ++index;
+        else
+            index = std::upper_bound(evnums.begin() + index + 2, evnums.end(), evt) - evnums.begin() - 1;
+    }
+
+    if(index < 0)
+        return EPICS_UNDEFINED_VALUE;
+
+    return sys->epics_columns[channel][index];
+}
@@ -0,0 +1,196 @@
+//============================================================================//
+// Energy cache, the pedestal subtracted adc sums of the physics events       //
+// It is used to refill the energy histogram after the gain correction        //
+// without re-reading adc values from all the events                          //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEnergyCache.h"
+#include "PRadEventStore.h"
+#include "PRadHyCalSystem.h"
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#ifdef MULTI_THREAD
+#include <thread>
+#endif
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadEnergyCache::PRadEnergyCache()
+{
+    Clear();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// remove all the cached events
+void PRadEnergyCache::Clear()
+{
+    nevents = 0;
+    channels.clear();
+    ch_module.clear();
+    ped_mean.clear();
+    groups.clear();
+    offsets.assign(1, 0);
+    group_index.clear();
+    sums.clear();
+}
+
+bool PRadEnergyCache::Update(const PRadEventStore &store, const PRadHyCalSystem &sys)
+{
+    if(isValid(store, sys))
+        return false;
+
+    Clear();
+
+    // group index of the channels, channels without module have no energy
+    auto &adcs = sys.GetADCList();
+    std::vector<int> ch_group(adcs.size(), -1);
+    std::unordered_map<const PRadHyCalModule*, int> module_group;
+    for(size_t i = 0; i < adcs.size(); ++i)
+    {
+        channels.push_back(adcs[i]);
+        ch_module.push_back(adcs[i]->GetModule());
+        ped_mean.push_back(adcs[i]->GetPedestal().mean);
+
+        if(!ch_module.back())
+            continue;
+
+        auto it = module_group.find(ch_module.back());
+        if(it == module_group.end()) {
+            it = module_group.emplace(ch_module.back(), groups.size()).first;
+            groups.push_back(ch_module.back());
+        }
+        ch_group[i] = it->second;
+    }
+
+    // sums of the groups in one event
+    std::vector<double> event_sums(groups.size(), 0.);
+    std::vector<uint16_t> event_groups;
+
+    nevents = store.size();
+    for(auto event : store)
+    {
+        if(!event.is_physics_event())
+            continue;
+
+        for(auto &adc : event.adc_data())
+        {
+            if(adc.channel_id >= ch_group.size() || ch_group[adc.channel_id] < 0)
+                continue;
+
+            // negative values have no energy for any positive calibration factor
+            double value = (double)adc.value - ped_mean[adc.channel_id];
+            if(value <= 0.)
+                continue;
+
+            int g = ch_group[adc.channel_id];
+            if(event_sums[g] == 0.)
+                event_groups.push_back(g);
+            event_sums[g] += value;
+        }
+
+        for(auto g : event_groups)
+        {
+            group_index.push_back(g);
+            sums.push_back(event_sums[g]);
+            event_sums[g] = 0.;
+        }
+        event_groups.clear();
+        offsets.push_back(sums.size());
+    }
+
+    return true;
+}
+
+// the events are divided into blocks for the threads
+void PRadEnergyCache::GetEnergies(std::vector<double> &energies, unsigned int nthreads)
+const
+{
+    std::vector<double> factors;
+    factors.reserve(groups.size());
+    for(auto module : groups)
+        factors.push_back(module->GetCalibConst().GetCalibConst());
+
+    size_t nrows = GetEventCount();
+    energies.resize(nrows);
+
+    std::atomic<size_t> next(0);
+    auto work = [&] ()
+                {
+                    size_t beg;
+                    while((beg = next.fetch_add(ENERGY_CACHE_BLOCK)) < nrows)
+                    {
+                        size_t end = std::min(nrows, beg + ENERGY_CACHE_BLOCK);
+                        for(size_t i = beg; i < end; ++i)
+                        {
+                            double energy = 0.;
+                            for(size_t j = offsets[i]; j < offsets[i + 1]; ++j)
+                                energy += factors[group_index[j]]*sums[j];
+                            energies[i] = energy;
+                        }
+                    }
+                };
+
+#ifdef MULTI_THREAD
+    size_t nblocks = (nrows + ENERGY_CACHE_BLOCK - 1)/ENERGY_CACHE_BLOCK;
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, nblocks));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(work);
+    work();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    (void) nthreads;
+    work();
+#endif
+}
+
+size_t PRadEnergyCache::MemoryUsage()
+const
+{
+    return offsets.capacity()*sizeof(size_t)
+           + group_index.capacity()*sizeof(uint16_t)
+           + sums.capacity()*sizeof(float);
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// the cache is valid if the events are not changed, and the channels are
+// connected to the same modules with the same pedestals
+bool PRadEnergyCache::isValid(const PRadEventStore &store, const PRadHyCalSystem &sys)
+const
+{
+    auto &adcs = sys.GetADCList();
+    if(store.size() != nevents || adcs.size() != channels.size())
+        return false;
+
+    for(size_t i = 0; i < adcs.size(); ++i)
+    {
+        if(adcs[i] != channels[i] ||
+           adcs[i]->GetModule() != ch_module[i] ||
+           adcs[i]->GetPedestal().mean != ped_mean[i])
+            return false;
+    }
+
+    return true;
+}
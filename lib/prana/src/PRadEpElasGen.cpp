@@ -23,10 +23,15 @@
 #include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 #include "PRadBenchMark.h"
 
 #define PROGRESS_EVENT_COUNT 1000
 #define PROGRESS_BIN_COUNT 10
+// maximum levels of the v binning divided before the threads take the bins
+#define V_SPLIT_LEVELS 16
 
 //============================================================================//
 // Helper constants, structures and functions                                 //
@@ -45,9 +50,6 @@ const double alp3 = alp2*cana::alpha;
 // convert MeV^-2 to nbarn
 const double unit = cana::hbarc2*1e7;
 
-// random number generator
-static cana::rand_gen<> rng;
-
 // some inlines
 // square
 inline double pow2(double val) {return val*val;}
@@ -67,13 +69,123 @@ inline double tau_ext2(double v, double S, double Q2)
     return 1./(8.*m2*M2 + 2.*X*X)*(4.*m2*(Q2 + 1.) + 2.*X*Q2);
 }
 
+// call func(i) for i from 0 to n - 1 by several threads
+template<class Func>
+inline void parallel_for(size_t n, unsigned int nthreads, Func func)
+{
+    std::atomic<size_t> next(0);
+    auto work = [&] ()
+                {
+                    size_t i;
+                    while((i = next++) < n)
+                        func(i);
+                };
+
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, n));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(work);
+    work();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    (void) nthreads;
+    work();
+#endif
+}
+
+// number of threads to be used, 0 means the number of cores
+inline unsigned int get_threads(unsigned int nthreads)
+{
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    return std::max(1u, nthreads);
+#else
+    (void) nthreads;
+    return 1;
+#endif
+}
+
+// same integration as cana::simpson_prec, the first levels of the binning are
+// divided with the mid points calculated by several threads, then the bins are
+// integrated by the threads, the bins are summed by the same binary tree so the
+// result does not depend on the number of threads
+template<class Func>
+double simpson_prec_threads(Func &&f, double a, double b, double prec, unsigned int nthreads)
+{
+    if(nthreads <= 1)
+        return cana::simpson_prec(f, a, b, prec);
+
+    struct Bin {double a, f_a, b, f_b, f_c, value; int left, right;};
+    std::vector<Bin> bins;
+    bins.push_back(Bin{a, f(a), b, f(b), 0., 0., -1, -1});
+
+    std::vector<int> front(1, 0), next;
+    size_t ntasks = EP_V_TASKS_PER_THREAD*nthreads;
+    int count = 0;
+    for(int level = 0; level < V_SPLIT_LEVELS && !front.empty() && front.size() < ntasks; ++level)
+    {
+        parallel_for(front.size(), nthreads,
+                     [&] (size_t i)
+                     {
+                         Bin &bin = bins[front[i]];
+                         bin.f_c = f((bin.a + bin.b)/2.);
+                     });
+
+        // the same conditions as cana::simpson_prec_helper
+        next.clear();
+        for(int idx : front)
+        {
+            Bin bin = bins[idx];
+            double c = (bin.a + bin.b)/2.;
+            if((++count < MAX_SIMPSON_BINS) &&
+               (bin.f_c != 0.) &&
+               (std::abs(bin.a/c - 1.) > MIN_SIMPSON_SIZE) &&
+               (std::abs(1. - (bin.f_a + bin.f_b)/2./bin.f_c) > prec)) {
+                bins[idx].left = bins.size();
+                next.push_back(bins.size());
+                bins.push_back(Bin{bin.a, bin.f_a, c, bin.f_c, 0., 0., -1, -1});
+                bins[idx].right = bins.size();
+                next.push_back(bins.size());
+                bins.push_back(Bin{c, bin.f_c, bin.b, bin.f_b, 0., 0., -1, -1});
+            } else {
+                bins[idx].value = (bin.b - bin.a)*(bin.f_a + bin.f_b + bin.f_c*4.)/6.;
+            }
+        }
+        front.swap(next);
+    }
+
+    parallel_for(front.size(), nthreads,
+                 [&] (size_t i)
+                 {
+                     Bin &bin = bins[front[i]];
+                     int bin_count = count;
+                     bin.value = cana::simpson_prec_helper(f, bin.a, bin.f_a, bin.b, bin.f_b,
+                                                           prec, bin_count);
+                 });
+
+    // the children are always after their parent
+    for(size_t i = bins.size(); i-- > 0;)
+    {
+        if(bins[i].left >= 0)
+            bins[i].value = bins[bins[i].left].value + bins[bins[i].right].value;
+    }
+    return bins.front().value;
+}
+
 //============================================================================//
 // Constructor, destructor                                                    //
 //============================================================================//
 
 // constructor
 PRadEpElasGen::PRadEpElasGen(double vmin, double vmax, int nbins, double q2_res, double v_res)
-: v_min(vmin), v_cut(vmax), min_bins(nbins), q2_prec(q2_res), v_prec(v_res)
+: v_min(vmin), v_cut(vmax), min_bins(nbins), q2_prec(q2_res), v_prec(v_res),
+  nthreads(0), ff_min(0.), ff_step(0.)
 {
     // place holder
 }
@@ -118,9 +230,26 @@ const
     GM = 2.792782*GMp_nu/GMp_de;
 }
 
-// translate EM form factors to hadronic structure functions
+// hadronic structure functions from the table if it covers Q2
 void PRadEpElasGen::GetHadStrFunc(double Q2, double &F1, double &F2)
 const
+{
+    double x = (Q2 - ff_min)/ff_step;
+    if(ff_q2.size() < 2 || !(x >= 0.) || x > ff_q2.size() - 1) {
+        GetHadStrFuncAnalytic(Q2, F1, F2);
+        return;
+    }
+
+    size_t i = std::min<size_t>(x, ff_q2.size() - 2);
+    double b = x - i, a = 1. - b;
+    double ca = (a*a*a - a)*ff_step*ff_step/6., cb = (b*b*b - b)*ff_step*ff_step/6.;
+    F1 = a*ff_f1[i] + b*ff_f1[i + 1] + ca*ff_d1[i] + cb*ff_d1[i + 1];
+    F2 = a*ff_f2[i] + b*ff_f2[i + 1] + ca*ff_d2[i] + cb*ff_d2[i + 1];
+}
+
+// translate EM form factors to hadronic structure functions
+void PRadEpElasGen::GetHadStrFuncAnalytic(double Q2, double &F1, double &F2)
+const
 {
     double GE, GM;
     GetEMFF(Q2, GE, GM);
@@ -130,27 +259,85 @@ const
     F2 = 4.*M2*(GE*GE + tau*GM*GM)/(1. + tau);
 }
 
+// tabulate the structure functions with natural cubic splines on uniform bins
+void PRadEpElasGen::SetFFTable(double q2_min, double q2_max, unsigned int nbins)
+{
+    ClearFFTable();
+    if(nbins < 2 || !(q2_max > q2_min))
+        return;
+
+    ff_min = q2_min;
+    ff_step = (q2_max - q2_min)/nbins;
+    for(unsigned int i = 0; i <= nbins; ++i)
+    {
+        double f1, f2;
+        ff_q2.push_back(q2_min + i*ff_step);
+        GetHadStrFuncAnalytic(ff_q2.back(), f1, f2);
+        ff_f1.push_back(f1);
+        ff_f2.push_back(f2);
+    }
+
+    // second derivatives by the tridiagonal system of the uniform bins
+    auto second_deriv = [] (const std::vector<double> &y, double h)
+                        {
+                            size_t n = y.size();
+                            std::vector<double> d(n, 0.), u(n, 0.);
+                            for(size_t i = 1; i < n - 1; ++i)
+                            {
+                                double p = 0.5*d[i - 1] + 2.;
+                                d[i] = -0.5/p;
+                                u[i] = (3.*(y[i + 1] - 2.*y[i] + y[i - 1])/h/h - 0.5*u[i - 1])/p;
+                            }
+                            d[n - 1] = 0.;
+                            for(size_t i = n - 1; i-- > 0;)
+                                d[i] = d[i]*d[i + 1] + u[i];
+                            return d;
+                        };
+
+    ff_d1 = second_deriv(ff_f1, ff_step);
+    ff_d2 = second_deriv(ff_f2, ff_step);
+}
+
+void PRadEpElasGen::ClearFFTable()
+{
+    ff_min = ff_step = 0.;
+    ff_q2.clear();
+    ff_f1.clear();
+    ff_f2.clear();
+    ff_d1.clear();
+    ff_d2.clear();
+}
+
 // get differential cross section dsigma/dQ2
 // input variables S, Q^2 in MeV^2
 // output Born, non-radiative, radiative cross sections (MeV^-4)
+// the v integrations are divided by the threads set by SetThreads
 void PRadEpElasGen::GetXSdQsq(double S, double Q2, double &sig_born, double &sig_nrad, double &sig_rad)
 const
 {
-    // equation (12), limitation of photonic variable v, scaled by 0.99
-    // substitute Q2*(Q2 + 4m2) with lambda_m in equation (29)
-    double lambda_S = S*S - 4.*m2*M2, lambda_m = Q2*(Q2 + 4.*m2);
-    double v_limit = 0.99*2.*Q2*(lambda_S - Q2*(S + m2 + M2))/(Q2*(S + 2.*m2) + sqrt(lambda_S*lambda_m));
-
-    double v2 = cana::clamp(v_cut, v_cut, v_limit);
-    double v1 = cana::clamp(v_min, v_min, v2);
-
-    sig_born = SigmaBorn(S, Q2);
-
-    // equation (39) without hard photon emission part of sigmaF
-    sig_nrad = SigmaVphIR(S, Q2, v1) + SigmaFs(1e-6, v1, S, Q2);
+    getXSdQsq(S, Q2, sig_born, sig_nrad, sig_rad, get_threads(nthreads));
+}
 
-    // hard photon emission part
-    sig_rad = SigmaFh(v1, v2, S, Q2);
+// get differential cross sections dsigma/dQ2 for the Q^2 values (MeV^2) at the
+// same S, the values are calculated by several threads, the threads more than
+// the Q2 values divide the v integrations of every Q2
+void PRadEpElasGen::GetXSdQsq(double S, const std::vector<double> &Q2,
+                              std::vector<double> &sig_born, std::vector<double> &sig_nrad,
+                              std::vector<double> &sig_rad)
+const
+{
+    sig_born.resize(Q2.size());
+    sig_nrad.resize(Q2.size());
+    sig_rad.resize(Q2.size());
+
+    size_t n = Q2.size();
+    unsigned int threads = get_threads(nthreads);
+    parallel_for(n, threads,
+                 [&] (size_t i)
+                 {
+                     unsigned int sub = (threads > n) ? threads/n + (i < threads%n) : 1;
+                     getXSdQsq(S, Q2[i], sig_born[i], sig_nrad[i], sig_rad[i], sub);
+                 });
 }
 
 // Differential cross section dsigma/dQ^2 at Born level
@@ -344,69 +531,139 @@ const
 double PRadEpElasGen::SigmaBrem_phik(double v, double tau, double S, double Q2, bool finite)
 const
 {
-    // varibles to simplify equations
+    double res;
+    if(finite)
+        SigmaBrem_phik(v, &tau, 1, S, Q2, SigmaBorn(S, Q2), &res, nullptr);
+    else
+        SigmaBrem_phik(v, &tau, 1, S, Q2, 0., nullptr, &res);
+    return res;
+}
+
+// both terms of SigmaBrem_phik for the tau values at the same v, they share
+// everything but the structure functions of the first term
+// sig_born is the Born cross section at (S, Q2) for the second term
+void PRadEpElasGen::SigmaBrem_phik(double v, const double *tau_val, size_t n, double S, double Q2,
+                                   double sig_born, double *sig_fin, double *sig_inf)
+const
+{
     double lambda_S = S*S - 4.*m2*M2;
-    double R = v/(1. + tau);
-    double t = Q2 + tau*R;
-    double X = S - R - t;
-    double SmX = S - X; // R + t = Q2 + v
-    double SpX = S + X;
 
-    double lambda_Y = SmX*SmX + 4.*M2*Q2;
-    double sqrt_lY = sqrt(lambda_Y);
+    for(size_t i = 0; i < n; ++i)
+    {
+        // varibles to simplify equations
+        double tau = tau_val[i];
+        double R = v/(1. + tau);
+        double t = Q2 + tau*R;
+        double X = S - R - t;
+        double SmX = S - X; // R + t = Q2 + v
+        double SpX = S + X;
+
+        double lambda_Y = SmX*SmX + 4.*M2*Q2;
+        double sqrt_lY = sqrt(lambda_Y);
+
+        // according to ELRADGEN code
+        double b2 = (-lambda_Y*tau + SpX*SmX*tau + 2.*SpX*Q2)/2.;
+        double b1 = (-lambda_Y*tau - SpX*SmX*tau - 2.*SpX*Q2)/2.;
+        double c1 = -(4.*(M2*tau*tau - SmX*tau - Q2)*m2 - pow2(S*tau + Q2));
+        double c2 = -(4.*(M2*tau*tau - SmX*tau - Q2)*m2 - pow2(tau*X - Q2));
+        double sc1 = sqrt(c1);
+        double sc2 = sqrt(c2);
+
+        double F = 1./sqrt_lY;
+        double F_d = (SpX*(SmX*tau + 2.*Q2))/(sc1*sc2*(sc1 + sc2));
+        double F_1p = 1./sc1 + 1./sc2;
+        double F_2p = m2*(b2/sc2/c2 - b1/sc1/c1);
+        double F_2m = m2*(b2/sc2/c2 + b1/sc1/c1);
+
+        double F_IR = F_2p - (Q2 + 2.*m2)*F_d;
+
+        // equation (43)
+        // second term
+        if(sig_fin)
+            sig_fin[i] = alp_pi*F_IR/R*sig_born/(1. + tau);
+
+        // first term
+        if(sig_inf) {
+            // equation (16) ~ (21)
+            double theta_11 = 4.*(Q2 - 2.*m2)*F_IR;
+            double theta_12 = 4.*tau*F_IR;
+            double theta_13 = -4.*F - 2.*tau*tau*F_d;
+            double theta_21 = 2.*(S*X - M2*Q2)*F_IR/M2;
+            double theta_22 = (2.*SpX*F_2m + SpX*SmX*F_1p + 2.*(SmX - 2.*M2*tau)*F_IR - tau*SpX*SpX*F_d)/2./M2;
+            double theta_23 = (4.*M2*F + (4.*m2 + 2.*M2*tau*tau - SmX*tau)*F_d - SpX*F_1p)/2./M2;
+
+            // R^(j - 2)*theta_ij
+            double theta_1j = theta_11/R + theta_12 + theta_13*R;
+            double theta_2j = theta_21/R + theta_22 + theta_23*R;
+
+            double F01, F02;
+            GetHadStrFunc(t, F01, F02);
+
+            sig_inf[i] = -alp3/2./lambda_S*(theta_1j*F01 + theta_2j*F02)/t/t/(1. + tau);
+        }
+    }
+}
 
-    // according to ELRADGEN code
-    double b2 = (-lambda_Y*tau + SpX*SmX*tau + 2.*SpX*Q2)/2.;
-    double b1 = (-lambda_Y*tau - SpX*SmX*tau - 2.*SpX*Q2)/2.;
-    double c1 = -(4.*(M2*tau*tau - SmX*tau - Q2)*m2 - pow2(S*tau + Q2));
-    double c2 = -(4.*(M2*tau*tau - SmX*tau - Q2)*m2 - pow2(tau*X - Q2));
-    double sc1 = sqrt(c1);
-    double sc2 = sqrt(c2);
+// numerical integration of SigmaBrem_phik over tau, dsig/dQ2/dv
+// finite = true means the integration of the second term of equation (43)
+// prec is the relative error of the integration around the peak
+double PRadEpElasGen::SigmaBrem_phik_tau(double v, double S, double Q2, bool finite, double prec)
+const
+{
+    return sigmaBremTau(v, S, Q2, finite, !finite, prec);
+}
 
-    double F = 1./sqrt_lY;
-    double F_d = (SpX*(SmX*tau + 2.*Q2))/(sc1*sc2*(sc1 + sc2));
-    double F_1p = 1./sc1 + 1./sc2;
-    double F_2p = m2*(b2/sc2/c2 - b1/sc1/c1);
-    double F_2m = m2*(b2/sc2/c2 + b1/sc1/c1);
+// hard Bremsstrahlung part
+double PRadEpElasGen::SigmaFh(double v1, double v2, double S, double Q2)
+const
+{
+    return sigmaFh(v1, v2, S, Q2, get_threads(nthreads));
+}
 
-    double F_IR = F_2p - (Q2 + 2.*m2)*F_d;
+// soft Bremsstrahlung part
+double PRadEpElasGen::SigmaFs(double v1, double v2, double S, double Q2)
+const
+{
+    return sigmaFs(v1, v2, S, Q2, get_threads(nthreads));
+}
 
-    // equation (43)
-    double res;
-    // second term
-    if(finite) {
-        res = alp_pi*F_IR/R*SigmaBorn(S, Q2)/(1. + tau);
-    // first term
-    } else {
-        // equation (16) ~ (21)
-        double theta_11 = 4.*(Q2 - 2.*m2)*F_IR;
-        double theta_12 = 4.*tau*F_IR;
-        double theta_13 = -4.*F - 2.*tau*tau*F_d;
-        double theta_21 = 2.*(S*X - M2*Q2)*F_IR/M2;
-        double theta_22 = (2.*SpX*F_2m + SpX*SmX*F_1p + 2.*(SmX - 2.*M2*tau)*F_IR - tau*SpX*SpX*F_d)/2./M2;
-        double theta_23 = (4.*M2*F + (4.*m2 + 2.*M2*tau*tau - SmX*tau)*F_d - SpX*F_1p)/2./M2;
 
-        // R^(j - 2)*theta_ij
-        double theta_1j = theta_11/R + theta_12 + theta_13*R;
-        double theta_2j = theta_21/R + theta_22 + theta_23*R;
 
-        double F01, F02;
-        GetHadStrFunc(t, F01, F02);
+//============================================================================//
+// Private functions                                                          //
+//============================================================================//
 
-        res = -alp3/2./lambda_S*(theta_1j*F01 + theta_2j*F02)/t/t/(1. + tau);
-    }
+// cross sections at one Q2, the v integrations are divided by the threads
+void PRadEpElasGen::getXSdQsq(double S, double Q2, double &sig_born, double &sig_nrad,
+                              double &sig_rad, unsigned int threads)
+const
+{
+    // equation (12), limitation of photonic variable v, scaled by 0.99
+    // substitute Q2*(Q2 + 4m2) with lambda_m in equation (29)
+    double lambda_S = S*S - 4.*m2*M2, lambda_m = Q2*(Q2 + 4.*m2);
+    double v_limit = 0.99*2.*Q2*(lambda_S - Q2*(S + m2 + M2))/(Q2*(S + 2.*m2) + sqrt(lambda_S*lambda_m));
 
-    return res;
+    double v2 = cana::clamp(v_cut, v_cut, v_limit);
+    double v1 = cana::clamp(v_min, v_min, v2);
+
+    sig_born = SigmaBorn(S, Q2);
+
+    // equation (39) without hard photon emission part of sigmaF
+    sig_nrad = SigmaVphIR(S, Q2, v1) + sigmaFs(1e-6, v1, S, Q2, threads);
+
+    // hard photon emission part
+    sig_rad = sigmaFh(v1, v2, S, Q2, threads);
 }
 
-// numerical integration of SigmaBrem_phik over tau, dsig/dQ2/dv
-// finite = true means the integration of the second term of equation (43)
-double PRadEpElasGen::SigmaBrem_phik_tau(double v, double S, double Q2, bool finite, double prec)
+// integration of the terms of SigmaBrem_phik over tau, the smooth ranges out
+// of the peak are from the batch gauss-legendre quadrature of all the terms,
+// the peak is from the adaptive integration of every term, the first term
+// reuses the (v, tau) points already calculated for the second term
+double PRadEpElasGen::sigmaBremTau(double v, double S, double Q2, bool finite, bool infinite,
+                                   double prec)
 const
 {
-    // wrapper of member function
-    auto fn = [this] (double tau, double v, double S, double Q2, bool finite)
-              { return SigmaBrem_phik(v, tau, S, Q2, finite); };
+    double sig_born = finite ? SigmaBorn(S, Q2) : 0.;
 
     // equation (13), tau range
     double sqrt_lY = sqrt(pow2(Q2 + v) + 4.*M2*Q2);
@@ -416,30 +673,72 @@ const
     // high peak at the center
     double tau_step = (tau_max - tau_min)*0.01;
     double tau_left = tau_ext1(v, S, Q2) - tau_step, tau_right = tau_ext2(v, S, Q2) + tau_step;
-    double res1 = cana::simpson(fn, tau_min, tau_left, 200, v, S, Q2, finite);
-    double res2 = cana::simpson_prec(fn, tau_left, tau_right, prec, v, S, Q2, finite);
-    double res3 = cana::simpson(fn, tau_right, tau_max, 200, v, S, Q2, finite);
-    return res1 + res2 + res3;
+
+    auto fn_batch = [&] (const double *tau, double *y, size_t n)
+                    {
+                        if(finite && infinite) {
+                            std::vector<double> y_fin(n);
+                            SigmaBrem_phik(v, tau, n, S, Q2, sig_born, y_fin.data(), y);
+                            for(size_t i = 0; i < n; ++i)
+                                y[i] += y_fin[i];
+                        } else {
+                            SigmaBrem_phik(v, tau, n, S, Q2, sig_born,
+                                           finite ? y : nullptr, infinite ? y : nullptr);
+                        }
+                    };
+    const auto &rule = cana::get_legendre_rule(EP_TAU_GAUSS_ORDER);
+    double res = cana::gauss_quad_batch(rule, fn_batch, tau_min, tau_left, EP_TAU_GAUSS_STEPS)
+               + cana::gauss_quad_batch(rule, fn_batch, tau_right, tau_max, EP_TAU_GAUSS_STEPS);
+
+    // adaptive integration around the peak, the two terms are integrated
+    // separately because it helps the integration converge, the binning of
+    // both starts from the same range so most of the points are shared
+    cana::simpson_workspace ws;
+    std::unordered_map<double, double> inf_points;
+    if(finite) {
+        auto fn = [&] (double tau)
+                  {
+                      double fin, inf;
+                      SigmaBrem_phik(v, &tau, 1, S, Q2, sig_born, &fin, infinite ? &inf : nullptr);
+                      if(infinite)
+                          inf_points.emplace(tau, inf);
+                      return fin;
+                  };
+        res += cana::simpson_adaptive(fn, tau_left, tau_right, prec, ws).value;
+    }
+
+    if(infinite) {
+        auto fn = [&] (double tau)
+                  {
+                      auto it = inf_points.find(tau);
+                      if(it != inf_points.end())
+                          return it->second;
+                      double inf;
+                      SigmaBrem_phik(v, &tau, 1, S, Q2, sig_born, nullptr, &inf);
+                      return inf;
+                  };
+        res += cana::simpson_adaptive(fn, tau_left, tau_right, prec, ws).value;
+    }
+
+    return res;
 }
 
-// hard Bremsstrahlung part
-double PRadEpElasGen::SigmaFh(double v1, double v2, double S, double Q2)
+// hard Bremsstrahlung part with the v integration divided by the threads
+double PRadEpElasGen::sigmaFh(double v1, double v2, double S, double Q2, unsigned int threads)
 const
 {
-    auto fn = [this] (double v, double S, double Q2)
-              { return SigmaBrem_phik_tau(v, S, Q2, false, 1e-4); };
+    auto fn = [this, S, Q2] (double v)
+              { return sigmaBremTau(v, S, Q2, false, true, 1e-6); };
 
-    return cana::simpson_prec(fn, v1, v2, v_prec, S, Q2);
+    return simpson_prec_threads(fn, v1, v2, v_prec, threads);
 }
 
-// soft Bremsstrahlung part
-double PRadEpElasGen::SigmaFs(double v1, double v2, double S, double Q2)
+// soft Bremsstrahlung part with the v integration divided by the threads
+double PRadEpElasGen::sigmaFs(double v1, double v2, double S, double Q2, unsigned int threads)
 const
 {
-    // two terms are separated because it helps the integration converge
-    auto fn = [this] (double v, double S, double Q2)
-              { return SigmaBrem_phik_tau(v, S, Q2, true, 1e-4)
-                       + SigmaBrem_phik_tau(v, S, Q2, false, 1e-4);};
+    auto fn = [this, S, Q2] (double v)
+              { return sigmaBremTau(v, S, Q2, true, true, 1e-6); };
 
-    return cana::simpson_prec(fn, v1, v2, v_prec, S, Q2);
+    return simpson_prec_threads(fn, v1, v2, v_prec, threads);
 }
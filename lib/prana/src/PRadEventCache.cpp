@@ -0,0 +1,209 @@
+//============================================================================//
+// On-demand access to the events of a DST file                               //
+// The events are decoded from the mapped file when they are asked, a small   //
+// cache keeps the recently viewed events and the ones ahead of the viewing,  //
+// so a run larger than the memory can be browsed                             //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEventCache.h"
+#include <iostream>
+
+
+
+PRadEventCache::PRadEventCache(size_t cap, size_t ahead)
+: capacity(cap), prefetch_size(ahead), last(0), direction(1),
+  prefetch_stop(false), prefetch_pending(false)
+{
+    // place holder
+}
+
+PRadEventCache::~PRadEventCache()
+{
+    Close();
+}
+
+// map the file and read its event map, no event is decoded
+bool PRadEventCache::Open(const std::string &path)
+{
+    Close();
+
+    if(!reader.Open(path)) {
+        std::cerr << "PRad Event Cache Error: Cannot open DST file "
+                  << "\"" << path << "\"."
+                  << std::endl;
+        return false;
+    }
+
+    last = 0;
+    direction = 1;
+    startPrefetch();
+    return true;
+}
+
+void PRadEventCache::Close()
+{
+    stopPrefetch();
+    Clear();
+    reader.Close();
+}
+
+// remove all the cached events
+void PRadEventCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(locker);
+    items.clear();
+    index.clear();
+}
+
+void PRadEventCache::SetCapacity(size_t cap)
+{
+    std::lock_guard<std::mutex> lock(locker);
+    capacity = cap;
+    trim();
+}
+
+// get the event, it is decoded if it is not cached
+bool PRadEventCache::GetEvent(size_t i, EventData &ev)
+{
+    if(i >= GetEventCount())
+        return false;
+
+    std::unique_lock<std::mutex> lock(locker);
+
+    auto it = index.find(i);
+    if(it == index.end()) {
+        // decode without lock, so the prefetching can continue
+        lock.unlock();
+        if(!decode(i, &ev))
+            return false;
+        lock.lock();
+    } else {
+        // the most recently used one
+        items.splice(items.begin(), items, it->second);
+        ev = it->second->second;
+    }
+
+    // update the viewing direction and ask for the events ahead
+    if(i != last)
+        direction = (i > last) ? 1 : -1;
+    last = i;
+    prefetch_pending = true;
+    lock.unlock();
+    cond.notify_one();
+    return true;
+}
+
+// decode the event and copy it to ev if it is not nullptr, all the events in
+// its chunk are decoded for the chunked format since the chunk has to be
+// unpacked anyway
+bool PRadEventCache::decode(size_t i, EventData *ev)
+{
+    if(reader.IsChunked()) {
+        std::vector<EventData> events;
+        size_t c = 0;
+        while(c + 1 < reader.GetChunkCount() && reader.GetChunkFirst(c + 1) <= i)
+            ++c;
+        if(!reader.GetChunk(c, events))
+            return false;
+
+        // the asked event is inserted last, so it is not trimmed
+        size_t first = reader.GetChunkFirst(c);
+        if(i < first || i - first >= events.size())
+            return false;
+        if(ev)
+            *ev = events[i - first];
+        std::lock_guard<std::mutex> lock(locker);
+        for(size_t k = 0; k < events.size(); ++k)
+        {
+            if(first + k != i)
+                insert(first + k, std::move(events[k]));
+        }
+        insert(i, std::move(events[i - first]));
+        return true;
+    }
+
+    EventData event;
+    if(!reader.GetEvent(i, event))
+        return false;
+
+    if(ev)
+        *ev = event;
+    std::lock_guard<std::mutex> lock(locker);
+    insert(i, std::move(event));
+    return true;
+}
+
+// insert an event, it should be called with the lock
+void PRadEventCache::insert(size_t i, EventData &&ev)
+{
+    if(index.count(i))
+        return;
+
+    items.emplace_front(i, std::move(ev));
+    index.emplace(i, items.begin());
+    trim();
+}
+
+void PRadEventCache::trim()
+{
+    while(items.size() > capacity && !items.empty())
+    {
+        index.erase(items.back().first);
+        items.pop_back();
+    }
+}
+
+void PRadEventCache::startPrefetch()
+{
+#ifdef MULTI_THREAD
+    prefetch_stop = false;
+    prefetch_pending = false;
+    prefetch_thread = std::thread(&PRadEventCache::prefetch, this);
+#endif
+}
+
+void PRadEventCache::stopPrefetch()
+{
+    {
+        std::lock_guard<std::mutex> lock(locker);
+        prefetch_stop = true;
+    }
+    cond.notify_all();
+
+    if(prefetch_thread.joinable())
+        prefetch_thread.join();
+}
+
+// decode the events ahead of the last accessed one in background
+void PRadEventCache::prefetch()
+{
+    std::unique_lock<std::mutex> lock(locker);
+    while(true)
+    {
+        cond.wait(lock, [this] () {return prefetch_stop || prefetch_pending;});
+        if(prefetch_stop)
+            return;
+        prefetch_pending = false;
+
+        size_t from = last;
+        int dir = direction;
+        size_t total = GetEventCount();
+        for(size_t k = 1; k <= prefetch_size && !prefetch_pending && !prefetch_stop; ++k)
+        {
+            if(dir < 0 && from < k)
+                break;
+            size_t i = (dir > 0) ? from + k : from - k;
+            if(i >= total)
+                break;
+            if(index.count(i))
+                continue;
+
+            lock.unlock();
+            decode(i);
+            lock.lock();
+        }
+    }
+}
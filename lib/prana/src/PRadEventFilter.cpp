@@ -8,6 +8,7 @@
 
 #include "PRadEventFilter.h"
 #include "ConfigParser.h"
+#include <algorithm>
 
 PRadEventFilter::PRadEventFilter(const std::string &path)
 {
@@ -47,47 +48,100 @@ void PRadEventFilter::LoadBadEventsList(const std::string &path, bool clear_exis
         bad_events_list.emplace_back(val1, val2);
     }
 
+    mergeIntervals();
 }
 
 void PRadEventFilter::ClearBadEventsList()
 {
     bad_events_list.clear();
+    merged_list.clear();
 }
 
 bool PRadEventFilter::IsBadEvent(const EventData &event)
 const
 {
-    // loop the whole list
-    for(auto &interval : bad_events_list)
-    {
-        if((event.event_number >= interval.begin) &&
-           (event.event_number <= interval.end))
-        {
-            // found in the listed bad events intervals
-            return true;
-        }
-    }
+    return IsBadEvent(event.event_number);
+}
 
-    // not in the list
-    return false;
+bool PRadEventFilter::IsBadEvent(int ev)
+const
+{
+    size_t idx = findInterval(ev);
+    return (idx < merged_list.size()) && (ev >= merged_list[idx].begin);
 }
 
 bool PRadEventFilter::IsBadPeriod(const EventData &begin, const EventData &end)
 const
 {
-    // loop the whole list
+    return IsBadPeriod(begin.event_number, end.event_number);
+}
+
+// either begin or end itself is a bad event, or the whole period contains a
+// bad period, so it is bad if any bad interval overlaps with the period
+bool PRadEventFilter::IsBadPeriod(int begin, int end)
+const
+{
+    if(begin > end)
+        return IsBadEvent(begin) || IsBadEvent(end);
+
+    // the first interval that does not end before the period
+    size_t idx = findInterval(begin);
+    return (idx < merged_list.size()) && (merged_list[idx].begin <= end);
+}
+
+// sort the intervals and merge the overlapping or adjacent ones
+void PRadEventFilter::mergeIntervals()
+{
+    merged_list.clear();
     for(auto &interval : bad_events_list)
     {
-        // firstly, either begin or end itself is a bad event
-        if(IsBadEvent(begin) || IsBadEvent(end))
-            return true;
-
-        // secondly, if the whole period contains a bad period
-        if((begin.event_number < interval.begin) &&
-           (end.event_number > interval.end))
-            return true;
+        // it does not contain any event
+        if(interval.begin > interval.end)
+            continue;
+        merged_list.push_back(interval);
     }
 
-    return false;
+    std::sort(merged_list.begin(), merged_list.end(),
+              [] (const ev_interval &a, const ev_interval &b)
+              {
+                  return a.begin < b.begin;
+              });
+
+    size_t n = 0;
+    for(auto &interval : merged_list)
+    {
+        if(n && (long long)interval.begin <= (long long)merged_list[n - 1].end + 1)
+            merged_list[n - 1].end = std::max(merged_list[n - 1].end, interval.end);
+        else
+            merged_list[n++] = interval;
+    }
+    merged_list.resize(n);
 }
 
+// the first merged interval with end >= ev
+size_t PRadEventFilter::findInterval(int ev)
+const
+{
+    auto it = std::lower_bound(merged_list.begin(), merged_list.end(), ev,
+                               [] (const ev_interval &i, int val)
+                               {
+                                   return i.end < val;
+                               });
+    return it - merged_list.begin();
+}
+
+// advance to the first interval that does not end before the event
+bool PRadEventFilter::Cursor::IsBadEvent(int ev)
+{
+    if(!filter)
+        return false;
+
+    const auto &list = filter->merged_list;
+    if(index > list.size() || (index > 0 && list[index - 1].end >= ev))
+        index = filter->findInterval(ev);
+
+    while(index < list.size() && list[index].end < ev)
+        ++index;
+
+    return (index < list.size()) && (ev >= list[index].begin);
+}
@@ -0,0 +1,236 @@
+//============================================================================//
+// Combined HyCal and GEM reconstruction of events in parallel                //
+// Every thread has a stage with its own copies of the HyCal, GEM and         //
+// coordinate systems. The stages take slices of a batch, and the results go  //
+// to the slots of their events, so the output is in the input order and the  //
+// same as processing the events one by one                                   //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEventReconstructor.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadDetMatch.h"
+#include "PRadTaskPool.h"
+#include "PRadProfiler.h"
+#include <iostream>
+#include <algorithm>
+
+#ifdef MULTI_THREAD
+#include <thread>
+#endif
+
+
+
+//============================================================================//
+// Stage                                                                      //
+//============================================================================//
+
+// copy the systems, the copies start with empty histograms and data
+PRadEventReconstructor::Stage::Stage(const PRadEventReconstructor &rec)
+: hycal(nullptr), gem(nullptr), gem1(nullptr), gem2(nullptr), count(0)
+{
+    hycal = new PRadHyCalSystem(*rec.hycal_sys);
+    hycal->Reset();
+
+    if(rec.gem_sys) {
+        gem = new PRadGEMSystem(*rec.gem_sys);
+        gem->Reset();
+        // the stages are already in parallel
+        gem->SetAPVThreads(1);
+        gem1 = gem->GetDetector("PRadGEM1");
+        gem2 = gem->GetDetector("PRadGEM2");
+    }
+
+    if(rec.coord_sys)
+        coord = *rec.coord_sys;
+}
+
+PRadEventReconstructor::Stage::~Stage()
+{
+    delete hycal;
+    delete gem;
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadEventReconstructor::PRadEventReconstructor(unsigned int nthreads)
+: hycal_sys(nullptr), gem_sys(nullptr), coord_sys(nullptr), det_match(nullptr),
+  slice_events(EVENT_RECON_SLICE), pool(nullptr), next_event(0)
+{
+    SetThreads(nthreads);
+}
+
+PRadEventReconstructor::~PRadEventReconstructor()
+{
+    Clear();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// set number of stages, 0 means using all the hardware threads, it takes
+// effect at the next Init
+void PRadEventReconstructor::SetThreads(unsigned int n)
+{
+#ifdef MULTI_THREAD
+    if(n == 0)
+        n = std::thread::hardware_concurrency();
+    threads = (n > 0) ? n : 1;
+#else
+    // no threads at all, the events are processed one by one
+    (void) n;
+    threads = 1;
+#endif
+}
+
+// copy the systems to the stages
+bool PRadEventReconstructor::Init()
+{
+    Clear();
+
+    if(!hycal_sys) {
+        std::cerr << "PRad Event Reconstructor Error: HyCal system is required."
+                  << std::endl;
+        return false;
+    }
+
+    for(unsigned int i = 0; i < threads; ++i)
+    {
+        stages.push_back(new Stage(*this));
+    }
+
+#ifdef MULTI_THREAD
+    // the thread waiting for the batch runs one of the stages
+    if(threads > 1)
+        pool = new PRadTaskPool(threads - 1);
+#endif
+
+    return true;
+}
+
+void PRadEventReconstructor::Clear()
+{
+    delete pool;
+    pool = nullptr;
+
+    for(auto &stage : stages)
+        delete stage;
+    stages.clear();
+}
+
+// the serial path, it is the first stage on this thread
+void PRadEventReconstructor::Reconstruct(const EventData &event, ReconEvent &res)
+{
+    if(stages.empty() && !Init())
+        return;
+
+    process(*stages.front(), event, res);
+}
+
+// reconstruct the batch in parallel, res should have space for n events
+void PRadEventReconstructor::Reconstruct(const EventData *events, size_t n, ReconEvent *res)
+{
+    PRAD_PROFILE_SCOPE("EventReconstructor::Reconstruct");
+
+    if(!n || (stages.empty() && !Init()))
+        return;
+
+    next_event = 0;
+
+    if(!pool || n <= slice_events) {
+        work(*stages.front(), events, n, res);
+        return;
+    }
+
+    for(auto &stage : stages)
+    {
+        Stage *s = stage;
+        pool->Submit([this, s, events, n, res] () {work(*s, events, n, res);});
+    }
+    pool->Wait();
+}
+
+void PRadEventReconstructor::Reconstruct(const std::vector<EventData> &events,
+                                         std::vector<ReconEvent> &res)
+{
+    res.resize(events.size());
+    if(!events.empty())
+        Reconstruct(&events[0], events.size(), &res[0]);
+}
+
+int PRadEventReconstructor::GetCount()
+const
+{
+    int count = 0;
+    for(auto &stage : stages)
+        count += stage->count;
+    return count;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// one event through the stages of the production pass
+void PRadEventReconstructor::process(Stage &stage, const EventData &event, ReconEvent &res)
+const
+{
+    res.Clear();
+    res.event_number = event.event_number;
+
+    // the systems keep the hits of the last event for non-physics events, so
+    // they are skipped here, otherwise the results depend on the stage
+    if(!event.is_physics_event())
+        return;
+
+    stage.hycal->Reconstruct(event);
+    res.hycal_hits = stage.hycal->GetDetector()->GetHits();
+
+    if(stage.gem) {
+        stage.gem->Reconstruct(event);
+        if(stage.gem1)
+            res.gem1_hits = stage.gem1->GetHits();
+        if(stage.gem2)
+            res.gem2_hits = stage.gem2->GetHits();
+    }
+
+    // coordinates transform to beam frame
+    const PRadCoordSystem &coord = stage.coord;
+    coord.Transform(PRadDetector::HyCal, res.hycal_hits.begin(), res.hycal_hits.end());
+    coord.Transform(PRadDetector::PRadGEM1, res.gem1_hits.begin(), res.gem1_hits.end());
+    coord.Transform(PRadDetector::PRadGEM2, res.gem2_hits.begin(), res.gem2_hits.end());
+
+    // hits matching on the HyCal surface, the matched hits are projected
+    coord.Projection(res.hycal_hits.begin(), res.hycal_hits.end());
+    if(det_match) {
+        res.matched = det_match->Match(res.hycal_hits, res.gem1_hits, res.gem2_hits);
+        coord.Projection(res.matched.begin(), res.matched.end());
+    }
+
+    stage.count++;
+}
+
+// take slices of the batch until it is done
+void PRadEventReconstructor::work(Stage &stage, const EventData *events, size_t n,
+                                  ReconEvent *res)
+{
+    size_t begin;
+    while((begin = next_event.fetch_add(slice_events)) < n)
+    {
+        size_t end = std::min(begin + slice_events, n);
+        for(size_t i = begin; i < end; ++i)
+            process(stage, events[i], res[i]);
+    }
+}
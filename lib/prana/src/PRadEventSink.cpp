@@ -0,0 +1,631 @@
+//============================================================================//
+// Pipeline stages for the decoded events                                     //
+// The data handler passes every decoded event through a chain of sinks,     //
+// such as histogram filling, reconstruction, matching and DST writing, so    //
+// a run can be processed in one streaming pass without keeping its events   //
+// Consecutive sinks form a segment, a segment can run on its own thread      //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEventSink.h"
+#include "PRadDataHandler.h"
+#include "PRadEventStore.h"
+#include "PRadHyCalSystem.h"
+#include "PRadHyCalModule.h"
+#include "PRadGEMSystem.h"
+#include "PRadCoordSystem.h"
+#include "PRadDetMatch.h"
+#include <iostream>
+#include <algorithm>
+
+
+
+//============================================================================//
+// Sinks                                                                      //
+//============================================================================//
+
+bool PRadHistSink::Process(EventData &event)
+{
+    handler->FillHistograms(event);
+    return true;
+}
+
+bool PRadStoreSink::Process(EventData &event)
+{
+    store->Append(event);
+    return true;
+}
+
+PRadDSTSink::PRadDSTSink(const std::string &path)
+: PRadEventSink("DST Writer")
+{
+    if(!path.empty())
+        Open(path);
+}
+
+PRadDSTSink::~PRadDSTSink()
+{
+    Close();
+}
+
+void PRadDSTSink::Open(const std::string &path)
+{
+    dst_parser.OpenOutput(path);
+}
+
+void PRadDSTSink::Close()
+{
+    dst_parser.CloseOutput();
+}
+
+bool PRadDSTSink::Process(EventData &event)
+{
+    try {
+        dst_parser.Write(event);
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": "
+                  << e.FailureDesc() << std::endl;
+    }
+    return true;
+}
+
+void PRadDSTSink::ProcessEPICS(const EpicsData &epics)
+{
+    try {
+        dst_parser.Write(epics);
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": "
+                  << e.FailureDesc() << std::endl;
+    }
+}
+
+bool PRadReconSink::Process(EventData &event)
+{
+    // only reconstruct physics event
+    if(!event.is_physics_event())
+        return true;
+
+    if(hycal) {
+        hycal->ChooseEvent(event);
+        hycal->Reconstruct();
+        if(coord)
+            coord->TransformHits(hycal->GetDetector());
+    }
+
+    if(gem) {
+        gem->Reconstruct(event);
+        if(coord) {
+            for(auto &det : gem->GetDetectorList())
+                coord->TransformHits(det);
+        }
+    }
+
+    return true;
+}
+
+uint64_t PRadReconSink::GetConfigHash()
+const
+{
+    uint64_t hash = CONFIG_HASH_SEED;
+
+    if(hycal) {
+        PRadHyCalReconstructor *rec = hycal->GetReconstructor();
+        int method = rec->GetClusterMethodType();
+        hash = ConfigParser::hash_bytes(&method, sizeof(method), hash);
+        hash = rec->GetConfigHash(hash);
+        for(auto &module : hycal->GetModuleList())
+        {
+            double factor = module->GetCalibrationFactor();
+            hash = ConfigParser::hash_bytes(&factor, sizeof(factor), hash);
+        }
+    }
+
+    if(gem)
+        hash = gem->GetClusterMethod()->GetConfigHash(hash);
+
+    if(coord) {
+        RunCoord rc = coord->GetCurrentCoords();
+        hash = ConfigParser::hash_bytes(&rc.target_center, sizeof(rc.target_center), hash);
+        hash = ConfigParser::hash_bytes(rc.dets.data(), rc.dets.size()*sizeof(DetCoord), hash);
+    }
+
+    return hash;
+}
+
+bool PRadMatchSink::Process(EventData &event)
+{
+    if(!event.is_physics_event())
+        return true;
+
+    matched.clear();
+
+    PRadGEMDetector *gem1 = gem->GetDetector(PRadDetector::PRadGEM1);
+    PRadGEMDetector *gem2 = gem->GetDetector(PRadDetector::PRadGEM2);
+    if(!gem1 || !gem2)
+        return true;
+
+    // project HyCal hits to its surface, match and then project the matched
+    // hits to HyCal surface
+    auto &hycal_hits = hycal->GetDetector()->GetHits();
+    coord->Projection(hycal_hits.begin(), hycal_hits.end());
+    matched = matcher->Match(hycal_hits, gem1->GetHits(), gem2->GetHits());
+    coord->Projection(matched.begin(), matched.end());
+
+    return true;
+}
+
+
+uint64_t PRadMatchSink::GetConfigHash(uint64_t seed)
+const
+{
+    return matcher->GetConfigHash(seed);
+}
+
+PRadReconDSTSink::PRadReconDSTSink(PRadReconSink *r, PRadMatchSink *m, const std::string &path)
+: PRadEventSink("Recon DST Writer"), recon(r), match(m)
+{
+    if(!path.empty())
+        Open(path);
+}
+
+PRadReconDSTSink::~PRadReconDSTSink()
+{
+    Close();
+}
+
+// the configuration hash is determined when the file is opened
+void PRadReconDSTSink::Open(const std::string &path)
+{
+    recon_data.config_hash = recon->GetConfigHash();
+    if(match)
+        recon_data.config_hash = match->GetConfigHash(recon_data.config_hash);
+
+    dst_parser.SetAsyncOutput(true);
+    dst_parser.OpenOutput(path);
+}
+
+void PRadReconDSTSink::Close()
+{
+    dst_parser.CloseOutput();
+}
+
+bool PRadReconDSTSink::Process(EventData &event)
+{
+    if(!event.is_physics_event())
+        return true;
+
+    recon_data.event_number = event.event_number;
+    recon_data.hycal_hits.clear();
+    recon_data.gem_hits.clear();
+    recon_data.match_hits.clear();
+
+    PRadHyCalSystem *hycal = recon->GetHyCalSystem();
+    if(hycal) {
+        auto &hits = hycal->GetDetector()->GetHits();
+        recon_data.hycal_hits.assign(hits.begin(), hits.end());
+    }
+
+    PRadGEMSystem *gem = recon->GetGEMSystem();
+    if(gem) {
+        for(auto &det : gem->GetDetectorList())
+        {
+            auto &hits = det->GetHits();
+            recon_data.gem_hits.insert(recon_data.gem_hits.end(), hits.begin(), hits.end());
+        }
+    }
+
+    if(match)
+        recon_data.match_hits = match->GetMatched();
+
+    try {
+        dst_parser.Write(recon_data);
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": "
+                  << e.FailureDesc() << std::endl;
+    }
+    return true;
+}
+
+PRadReconDSTOutput::PRadReconDSTOutput(const std::string &path)
+{
+    if(!path.empty())
+        Open(path);
+}
+
+PRadReconDSTOutput::~PRadReconDSTOutput()
+{
+    Close();
+}
+
+void PRadReconDSTOutput::Open(const std::string &path)
+{
+    dst_parser.SetAsyncOutput(true);
+    dst_parser.OpenOutput(path);
+}
+
+void PRadReconDSTOutput::Close()
+{
+    dst_parser.CloseOutput();
+}
+
+void PRadReconDSTOutput::Write(const EventData &, const ReconData &recon)
+{
+    try {
+        dst_parser.Write(recon);
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": "
+                  << e.FailureDesc() << std::endl;
+    }
+}
+
+void PRadReconDSTOutput::WriteEPICS(const EpicsData &epics)
+{
+    try {
+        dst_parser.Write(epics);
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": "
+                  << e.FailureDesc() << std::endl;
+    }
+}
+
+PRadBatchReconSink::PRadBatchReconSink(PRadHyCalSystem *h, PRadGEMSystem *g, PRadCoordSystem *c,
+                                       PRadDetMatch *m, unsigned int nthreads)
+: PRadEventSink("Batch Reconstruct"), hycal(h), gem(g), coord(c), matcher(m),
+  threads(nthreads), batch_size(SINK_RECON_BATCH), count(0), nevents(0)
+{
+    // place holder
+}
+
+// the event is copied to the batch, the slot keeps its memory
+bool PRadBatchReconSink::Process(EventData &event)
+{
+    if(!event.is_physics_event())
+        return true;
+
+    if(events.size() <= nevents)
+        events.resize(nevents + 1);
+    events[nevents++] = event;
+
+    if(nevents >= batch_size)
+        reconstruct();
+
+    return true;
+}
+
+void PRadBatchReconSink::ProcessEPICS(const EpicsData &epics)
+{
+    reconstruct();
+
+    for(auto &out : outputs)
+        out->WriteEPICS(epics);
+}
+
+void PRadBatchReconSink::Flush()
+{
+    reconstruct();
+}
+
+uint64_t PRadBatchReconSink::GetConfigHash()
+const
+{
+    uint64_t hash = PRadReconSink(hycal, gem, coord).GetConfigHash();
+    if(matcher && coord && gem)
+        hash = matcher->GetConfigHash(hash);
+    return hash;
+}
+
+void PRadBatchReconSink::reconstruct()
+{
+    if(!nevents)
+        return;
+
+    if(hycal_hits.size() < nevents)
+        hycal_hits.resize(nevents);
+    if(gem_hits.size() < nevents)
+        gem_hits.resize(nevents);
+
+    // the calibration may be changed between the batches
+    recon_data.config_hash = GetConfigHash();
+
+    if(hycal)
+        hycal->ReconstructBatch(&events[0], nevents, &hycal_hits[0], threads);
+    if(gem)
+        gem->ReconstructBatch(&events[0], nevents, &gem_hits[0], threads);
+
+    for(size_t i = 0; i < nevents; ++i)
+    {
+        recon_data.event_number = events[i].event_number;
+        auto &hits = recon_data.hycal_hits;
+        hits.clear();
+        if(hycal)
+            hits.swap(hycal_hits[i]);
+
+        gem1_hits.clear();
+        gem2_hits.clear();
+        if(gem) {
+            for(auto &hit : gem_hits[i])
+            {
+                if(hit.det_id == PRadDetector::PRadGEM1)
+                    gem1_hits.push_back(hit);
+                else if(hit.det_id == PRadDetector::PRadGEM2)
+                    gem2_hits.push_back(hit);
+            }
+        }
+
+        if(coord) {
+            coord->Transform(PRadDetector::HyCal, hits.begin(), hits.end());
+            coord->Transform(PRadDetector::PRadGEM1, gem1_hits.begin(), gem1_hits.end());
+            coord->Transform(PRadDetector::PRadGEM2, gem2_hits.begin(), gem2_hits.end());
+        }
+
+        recon_data.gem_hits.assign(gem1_hits.begin(), gem1_hits.end());
+        recon_data.gem_hits.insert(recon_data.gem_hits.end(), gem2_hits.begin(), gem2_hits.end());
+
+        // same as the matching stage, project HyCal hits to its surface,
+        // match and then project the matched hits to HyCal surface
+        recon_data.match_hits.clear();
+        if(matcher && coord && gem) {
+            coord->Projection(hits.begin(), hits.end());
+            recon_data.match_hits = matcher->Match(hits, gem1_hits, gem2_hits);
+            coord->Projection(recon_data.match_hits.begin(), recon_data.match_hits.end());
+        }
+
+        for(auto &out : outputs)
+            out->Write(events[i], recon_data);
+
+        // give the memory back to the batch
+        if(hycal)
+            hits.swap(hycal_hits[i]);
+    }
+
+    count += nevents;
+    nevents = 0;
+}
+
+
+//============================================================================//
+// Pipeline Constructor, Destructor                                           //
+//============================================================================//
+
+PRadEventPipeline::PRadEventPipeline()
+{
+    // place holder
+}
+
+PRadEventPipeline::~PRadEventPipeline()
+{
+    Clear();
+}
+
+
+
+//============================================================================//
+// Pipeline Public Member Functions                                           //
+//============================================================================//
+
+// add a sink to the end, new_thread starts a new segment on its own thread
+void PRadEventPipeline::AddSink(PRadEventSink *sink, bool new_thread)
+{
+    if(!sink)
+        return;
+
+#ifndef MULTI_THREAD
+    // everything is on the calling thread
+    new_thread = false;
+#endif
+
+    // threads are restarted for the new chain
+    Stop();
+
+    if(new_thread || segments.empty())
+        segments.push_back(new Segment(new_thread));
+
+    segments.back()->sinks.push_back(sink);
+}
+
+void PRadEventPipeline::RemoveSink(PRadEventSink *sink)
+{
+    Stop();
+
+    for(auto it = segments.begin(); it != segments.end();)
+    {
+        auto &sinks = (*it)->sinks;
+        sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+        if(sinks.empty()) {
+            delete *it;
+            it = segments.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// remove all the sinks
+void PRadEventPipeline::Clear()
+{
+    Stop();
+
+    for(auto &seg : segments)
+        delete seg;
+    segments.clear();
+}
+
+// pass an event through the pipeline, the event memory may be exchanged
+// with a recycled one
+void PRadEventPipeline::Process(EventData &event)
+{
+    if(segments.empty())
+        return;
+
+    input.is_epics = false;
+    std::swap(input.event, event);
+    pass(0, input);
+    std::swap(input.event, event);
+}
+
+void PRadEventPipeline::ProcessEPICS(const EpicsData &epics)
+{
+    if(segments.empty())
+        return;
+
+    input.is_epics = true;
+    input.epics = epics;
+    pass(0, input);
+}
+
+// wait until all the given events are processed
+void PRadEventPipeline::Flush()
+{
+    // segments pass events to the later ones, so wait in order
+    for(auto &seg : segments)
+    {
+        if(!seg->thread.joinable())
+            continue;
+
+        std::unique_lock<std::mutex> lock(seg->locker);
+        seg->cond.wait(lock, [seg] {return seg->head == seg->tail;});
+    }
+
+    for(auto &seg : segments)
+    {
+        for(auto &sink : seg->sinks)
+            sink->Flush();
+    }
+}
+
+// finish the events and stop the segment threads
+void PRadEventPipeline::Stop()
+{
+    Flush();
+
+    for(auto &seg : segments)
+    {
+        if(!seg->thread.joinable())
+            continue;
+
+        {
+            std::lock_guard<std::mutex> lock(seg->locker);
+            seg->stop = true;
+        }
+        seg->cond.notify_all();
+        seg->thread.join();
+        seg->stop = false;
+        PRadMetrics::Instance().RemoveGauge("prad_pipeline_queue_depth" + seg->label);
+    }
+}
+
+std::vector<PRadEventSink*> PRadEventPipeline::GetSinks()
+const
+{
+    std::vector<PRadEventSink*> res;
+    for(auto &seg : segments)
+        res.insert(res.end(), seg->sinks.begin(), seg->sinks.end());
+    return res;
+}
+
+
+
+//============================================================================//
+// Pipeline Private Member Functions                                          //
+//============================================================================//
+
+// deliver the item to a segment
+void PRadEventPipeline::pass(size_t index, Item &item)
+{
+    if(index >= segments.size())
+        return;
+
+    Segment *seg = segments[index];
+    if(!seg->threaded) {
+        run(seg, item, index);
+        return;
+    }
+
+    // start the thread on the first event
+    if(!seg->thread.joinable()) {
+        seg->queue.resize(SINK_QUEUE_SIZE);
+        seg->head = seg->tail = 0;
+        startMetrics(seg);
+        seg->thread = std::thread(&PRadEventPipeline::work, this, index);
+    }
+
+    std::unique_lock<std::mutex> lock(seg->locker);
+    seg->cond.wait(lock, [seg] {return seg->head - seg->tail < SINK_QUEUE_SIZE;});
+
+    // the slot is not accessed by the segment thread until head moves
+    Item &slot = seg->queue[seg->head%SINK_QUEUE_SIZE];
+    slot.is_epics = item.is_epics;
+    std::swap(slot.event, item.event);
+    std::swap(slot.epics, item.epics);
+    seg->head++;
+    seg->cond.notify_all();
+}
+
+// run the sinks of a segment and pass the item to the next segment
+void PRadEventPipeline::run(Segment *seg, Item &item, size_t index)
+{
+    for(auto &sink : seg->sinks)
+    {
+        if(item.is_epics) {
+            sink->ProcessEPICS(item.epics);
+        } else if(!sink->Process(item.event)) {
+            return;
+        }
+    }
+
+    pass(index + 1, item);
+}
+
+// the segment is labeled by its first sink, the queue depth is a gauge until
+// the thread is stopped
+void PRadEventPipeline::startMetrics(Segment *seg)
+{
+    std::string name = seg->sinks.empty() ? "" : seg->sinks.front()->GetName();
+    seg->label = "{segment=\"" + name + "\"}";
+
+    auto &metrics = PRadMetrics::Instance();
+    seg->busy_ns = metrics.GetCounter("prad_pipeline_busy_seconds_total" + seg->label,
+                                      "time the segment threads spent on the events", 1e-9);
+    seg->wait_ns = metrics.GetCounter("prad_pipeline_wait_seconds_total" + seg->label,
+                                      "time the segment threads waited for the events", 1e-9);
+    metrics.AddGauge("prad_pipeline_queue_depth" + seg->label,
+                     [seg] ()
+                     {
+                         std::lock_guard<std::mutex> lock(seg->locker);
+                         return (double)(seg->head - seg->tail);
+                     },
+                     "events queued in front of the segment threads");
+}
+
+// segment thread
+void PRadEventPipeline::work(size_t index)
+{
+    Segment *seg = segments[index];
+
+    while(true)
+    {
+        size_t tail;
+        {
+            PRadMetricTimer wait_timer(seg->wait_ns);
+            std::unique_lock<std::mutex> lock(seg->locker);
+            seg->cond.wait(lock, [seg] {return seg->stop || seg->head != seg->tail;});
+            if(seg->head == seg->tail)
+                return;
+            tail = seg->tail;
+        }
+
+        // the producer does not touch this slot until tail moves
+        {
+            PRadMetricTimer busy_timer(seg->busy_ns);
+            run(seg, seg->queue[tail%SINK_QUEUE_SIZE], index);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(seg->locker);
+            seg->tail++;
+        }
+        seg->cond.notify_all();
+    }
+}
@@ -0,0 +1,298 @@
+//============================================================================//
+// Iterable events of a DST or EVIO file                                      //
+// The events are read and decoded ahead on a background thread into blocks  //
+// of columnar stores, the iteration gives views of the events in the blocks  //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEventSource.h"
+#include "PRadDataHandler.h"
+#include "PRadDSTParser.h"
+#include "PRadEventFilter.h"
+#include "PRadEventSink.h"
+#include <iostream>
+
+
+// the last stage of the handler pipeline while reading an evio file
+class PRadEventSource::SourceSink : public PRadEventSink
+{
+public:
+    SourceSink(PRadEventSource *s) : PRadEventSink("Event Source"), source(s) {}
+
+    bool Process(EventData &event)
+    {
+        if(!source->push(event))
+            source->handler->StopReading(true);
+        return true;
+    }
+
+private:
+    PRadEventSource *source;
+};
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadEventSource::PRadEventSource(const std::string &p, const Filter &f, PRadDataHandler *h)
+: path(p), filter(f), handler(h), evio(p.find(".evio") != std::string::npos),
+  block_events(EVENT_SOURCE_BLOCK), queue_blocks(EVENT_SOURCE_QUEUE),
+  filling(nullptr), current(nullptr), cur_index(0), epics_epoch(-1),
+  started(false), finished(false), stop(false), accepted(0), skipped(0)
+{
+    // place holder
+}
+
+PRadEventSource::~PRadEventSource()
+{
+    Stop();
+
+    if(reader.joinable())
+        reader.join();
+
+    // the handler can read again
+    if(evio && handler && started)
+        handler->StopReading(false);
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+PRadEventSource::iterator PRadEventSource::begin()
+{
+    if(!started) {
+        started = true;
+        if(!evio) {
+            dst.reset(new PRadDSTParser());
+            dst->OpenInput(path);
+        }
+#ifdef MULTI_THREAD
+        reader = std::thread(&PRadEventSource::produce, this);
+#endif
+    }
+
+    if(!current && !fetch())
+        return end();
+    return iterator(this);
+}
+
+void PRadEventSource::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(locker);
+        stop = true;
+    }
+    cond.notify_all();
+
+    if(evio && handler && started)
+        handler->StopReading(true);
+}
+
+PRadEventSource::Filter PRadEventSource::SkipBadEvents(const PRadEventFilter &f)
+{
+    // the events are in increasing order, the cursor follows them
+    PRadEventFilter::Cursor cursor = f.GetCursor();
+    return [cursor] (const EventData &event) mutable
+           {
+               return !cursor.IsBadEvent(event.event_number);
+           };
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// reader thread
+void PRadEventSource::produce()
+{
+    if(evio)
+        readEvio();
+    else
+        while(readDST()) {}
+
+    finish();
+}
+
+// read the dst events, return true if it pauses for the reading on the
+// calling thread, false at the end of the file
+bool PRadEventSource::readDST()
+{
+    while(!stop && dst->Read())
+    {
+        switch(dst->EventType())
+        {
+        case PRadDSTParser::Type::epics:
+            // the epics events are counted for the event epochs
+            epics_epoch++;
+            break;
+        case PRadDSTParser::Type::event:
+            dst->GetEvent(buffer);
+            buffer.epics_index = epics_epoch;
+            if(!push(buffer))
+                return !stop;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+void PRadEventSource::readEvio()
+{
+    if(!handler) {
+        std::cerr << "PRad Event Source Error: Data handler is required to decode "
+                  << "the evio file \"" << path << "\"." << std::endl;
+        return;
+    }
+
+    SourceSink sink(this);
+    handler->AddSink(&sink);
+    handler->ReadFromEvio(path);
+    handler->RemoveSink(&sink);
+}
+
+// the last block is given to the iteration
+void PRadEventSource::finish()
+{
+    commit();
+
+    {
+        std::lock_guard<std::mutex> lock(locker);
+        finished = true;
+    }
+    cond.notify_all();
+}
+
+// add an event to the filling block, return false if the reading should stop
+// or pause
+bool PRadEventSource::push(const EventData &event)
+{
+    if(filter && !filter(event)) {
+        skipped++;
+        return !stop;
+    }
+
+    if(!filling && !(filling = takeFree()))
+        return false;
+
+    filling->Append(event);
+    accepted++;
+
+    if(filling->size() >= block_events) {
+        commit();
+#ifndef MULTI_THREAD
+        // give the block to the iteration on the same thread
+        if(!evio)
+            return false;
+#endif
+    }
+
+    return !stop;
+}
+
+// move the filling block to the ready queue
+void PRadEventSource::commit()
+{
+    if(!filling)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(locker);
+        if(filling->empty())
+            free_blocks.push_back(filling);
+        else
+            ready_blocks.push_back(filling);
+        filling = nullptr;
+    }
+    cond.notify_all();
+}
+
+// a cleared block for filling, wait if the queue is full, nullptr if stopped
+PRadEventStore *PRadEventSource::takeFree()
+{
+    std::unique_lock<std::mutex> lock(locker);
+
+#ifdef MULTI_THREAD
+    // the filling and ready blocks are the read-ahead ones
+    cond.wait(lock, [this]
+                    {
+                        return stop || !free_blocks.empty()
+                               || blocks.size() < queue_blocks + 1;
+                    });
+#endif
+
+    if(stop)
+        return nullptr;
+
+    PRadEventStore *store;
+    if(free_blocks.empty()) {
+        blocks.emplace_back(new PRadEventStore());
+        store = blocks.back().get();
+    } else {
+        store = free_blocks.front();
+        free_blocks.pop_front();
+    }
+
+    lock.unlock();
+    store->Clear();
+    return store;
+}
+
+// take the next ready block for the iteration, false at the end
+bool PRadEventSource::fetch()
+{
+#ifndef MULTI_THREAD
+    // read on the calling thread
+    while(!finished && ready_blocks.empty())
+    {
+        if(evio) {
+            readEvio();
+            finish();
+        } else if(!readDST()) {
+            finish();
+        }
+    }
+#endif
+
+    std::unique_lock<std::mutex> lock(locker);
+    cond.wait(lock, [this] {return finished || !ready_blocks.empty();});
+
+    if(ready_blocks.empty()) {
+        current = nullptr;
+        return false;
+    }
+
+    current = ready_blocks.front();
+    ready_blocks.pop_front();
+    cur_index = 0;
+    return true;
+}
+
+// move to the next event, the finished block is recycled
+bool PRadEventSource::advance()
+{
+    if(current && ++cur_index < current->size())
+        return true;
+
+    if(current) {
+        {
+            std::lock_guard<std::mutex> lock(locker);
+            free_blocks.push_back(current);
+            current = nullptr;
+        }
+        cond.notify_all();
+    }
+
+    return fetch();
+}
@@ -0,0 +1,222 @@
+//============================================================================//
+// Events spilled to the temporary DST files                                  //
+// A store of events is written to a chunked DST file as one segment, so the  //
+// memory of the store can be used again, the events are decoded back from   //
+// the file of their segment when they are accessed                           //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEventSpill.h"
+#include "PRadEventStore.h"
+#include "PRadEventCache.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+
+
+
+//============================================================================//
+// Constructors, Destructor, Assignment Operators                             //
+//============================================================================//
+
+PRadEventSpill::PRadEventSpill(const std::string &dir)
+: chunk_events(DST_CHUNK_EVENTS), chunk_level(DST_CHUNK_LEVEL), total(0), current(-1)
+{
+    SetDirectory(dir);
+}
+
+PRadEventSpill::~PRadEventSpill()
+{
+    Clear();
+}
+
+PRadEventSpill::PRadEventSpill(PRadEventSpill &&that)
+: directory(std::move(that.directory)), chunk_events(that.chunk_events),
+  chunk_level(that.chunk_level), segments(std::move(that.segments)), total(that.total),
+  cache(std::move(that.cache)), current(that.current)
+{
+    that.segments.clear();
+    that.total = 0;
+    that.current = -1;
+}
+
+PRadEventSpill &PRadEventSpill::operator =(PRadEventSpill &&rhs)
+{
+    if(this == &rhs)
+        return *this;
+
+    Clear();
+    directory = std::move(rhs.directory);
+    chunk_events = rhs.chunk_events;
+    chunk_level = rhs.chunk_level;
+    segments = std::move(rhs.segments);
+    total = rhs.total;
+    cache = std::move(rhs.cache);
+    current = rhs.current;
+
+    rhs.segments.clear();
+    rhs.total = 0;
+    rhs.current = -1;
+    return *this;
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+void PRadEventSpill::SetDirectory(const std::string &dir)
+{
+    if(!dir.empty()) {
+        directory = dir;
+        return;
+    }
+
+    const char *tmp = getenv("TMPDIR");
+    directory = (tmp && *tmp) ? tmp : EVENT_SPILL_DIR;
+}
+
+void PRadEventSpill::SetChunkedOutput(uint32_t nevents, int level)
+{
+    chunk_events = (nevents > 0) ? nevents : DST_CHUNK_EVENTS;
+    chunk_level = level;
+}
+
+bool PRadEventSpill::Spill(const PRadEventStore &store)
+{
+    if(store.empty())
+        return true;
+
+    std::string path = directory + "/prad_spill_XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if(fd < 0) {
+        std::cerr << "PRad Event Spill Error: Cannot create a temporary file in "
+                  << "\"" << directory << "\"." << std::endl;
+        return false;
+    }
+    close(fd);
+
+    Segment seg;
+    seg.path = path;
+    seg.first = total;
+    seg.evnums.reserve(store.size());
+
+    PRadDSTParser writer;
+    writer.SetChunkedOutput(chunk_events, chunk_level);
+    try {
+        writer.OpenOutput(path);
+        EventData event;
+        for(auto view : store)
+        {
+            view.Fill(event);
+            writer.Write(event);
+            seg.evnums.push_back(event.event_number);
+        }
+        writer.CloseOutput();
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": "
+                  << e.FailureDesc() << std::endl
+                  << "PRad Event Spill Error: Failed to write "
+                  << "\"" << path << "\"." << std::endl;
+        writer.CloseOutput();
+        remove(path.c_str());
+        return false;
+    }
+
+    total += seg.evnums.size();
+    segments.emplace_back(std::move(seg));
+    return true;
+}
+
+// remove all the segments and their files
+void PRadEventSpill::Clear()
+{
+    if(cache)
+        cache->Close();
+    current = -1;
+
+    for(auto &seg : segments)
+        remove(seg.path.c_str());
+    segments.clear();
+    total = 0;
+}
+
+bool PRadEventSpill::GetEvent(size_t i, EventData &ev)
+{
+    int seg = findSegment(i);
+    if(seg < 0 || !openSegment(seg))
+        return false;
+
+    return cache->GetEvent(i - segments[seg].first, ev);
+}
+
+// the events are in the order of event numbers in every segment
+int PRadEventSpill::Find(int event_number)
+const
+{
+    for(auto &seg : segments)
+    {
+        if(seg.evnums.empty() || event_number < seg.evnums.front() ||
+           event_number > seg.evnums.back())
+            continue;
+
+        auto it = std::lower_bound(seg.evnums.begin(), seg.evnums.end(), event_number);
+        if(it != seg.evnums.end() && *it == event_number)
+            return seg.first + (it - seg.evnums.begin());
+    }
+    return -1;
+}
+
+// the event numbers and the cached events of the current segment
+size_t PRadEventSpill::MemoryUsage()
+const
+{
+    size_t res = segments.capacity()*sizeof(Segment);
+    for(auto &seg : segments)
+        res += seg.evnums.capacity()*sizeof(int32_t) + seg.path.capacity();
+    if(cache)
+        res += cache->Size()*sizeof(EventData);
+    return res;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+int PRadEventSpill::findSegment(size_t i)
+const
+{
+    if(i >= total)
+        return -1;
+
+    auto it = std::upper_bound(segments.begin(), segments.end(), i,
+                               [] (size_t idx, const Segment &seg)
+                               {
+                                   return idx < seg.first;
+                               });
+    return (int)(it - segments.begin()) - 1;
+}
+
+// the cache is moved to the file of the segment
+bool PRadEventSpill::openSegment(int seg)
+{
+    if(seg == current && cache && cache->IsOpen())
+        return true;
+
+    if(!cache)
+        cache.reset(new PRadEventCache(EVENT_SPILL_CACHE, EVENT_SPILL_PREFETCH));
+
+    current = -1;
+    if(!cache->Open(segments[seg].path))
+        return false;
+
+    current = seg;
+    return true;
+}
@@ -0,0 +1,297 @@
+//============================================================================//
+// An append-only columnar storage for the decoded events                     //
+// ADC, TDC, DSC and GEM data from all events are stored in contiguous arrays //
+// and each event only keeps its information and offsets in these arrays.     //
+// EventView provides the access to an event without building EventData.      //
+// The scalers are stored once per sync event in a time series of snapshots. //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEventStore.h"
+#include "canalib.h"
+#include <algorithm>
+
+
+
+//============================================================================//
+// Event View                                                                 //
+//============================================================================//
+
+// build a full event, the containers of event keep their capacities
+void EventView::Fill(EventData &event)
+const
+{
+    const auto &info = store->events[index];
+    event.event_number = info.event_number;
+    event.type = info.type;
+    event.trigger = info.trigger;
+    event.timestamp = info.timestamp;
+    event.epics_index = info.epics_index;
+    event.dsc_index = info.dsc_index;
+
+    auto adcs = adc_data();
+    event.adc_data.assign(adcs.begin(), adcs.end());
+    auto tdcs = tdc_data();
+    event.tdc_data.assign(tdcs.begin(), tdcs.end());
+    auto dscs = dsc_data();
+    event.dsc_data.assign(dscs.begin(), dscs.end());
+
+    // resize to keep the memory of existing hits
+    auto hits = gem_data();
+    event.gem_data.resize(hits.size());
+    for(size_t i = 0; i < hits.size(); ++i)
+    {
+        auto &hit = event.gem_data[i];
+        hit.addr = hits[i].addr;
+        hit.clear_values();
+        for(auto &val : gem_values(hits[i]))
+            hit.add_value(val);
+    }
+}
+
+
+
+//============================================================================//
+// Scaler Store                                                               //
+//============================================================================//
+
+PRadScalerStore::PRadScalerStore()
+: offsets(1, 0)
+{
+    // place holder
+}
+
+int PRadScalerStore::Add(int32_t event_number, const std::vector<DSC_Data> &dsc)
+{
+    evnums.push_back(event_number);
+    counts.insert(counts.end(), dsc.begin(), dsc.end());
+    offsets.push_back(counts.size());
+    return GetEpoch();
+}
+
+void PRadScalerStore::Append(const PRadScalerStore &that)
+{
+    uint32_t ncounts = counts.size();
+    evnums.insert(evnums.end(), that.evnums.begin(), that.evnums.end());
+    counts.insert(counts.end(), that.counts.begin(), that.counts.end());
+    for(size_t i = 1; i < that.offsets.size(); ++i)
+        offsets.push_back(that.offsets[i] + ncounts);
+}
+
+void PRadScalerStore::Clear()
+{
+    evnums.clear();
+    offsets.assign(1, 0);
+    counts.clear();
+}
+
+// the last snapshot up to the event, -1 if the event is before all of them
+int PRadScalerStore::FindEpoch(int event_number)
+const
+{
+    auto it = std::upper_bound(evnums.begin(), evnums.end(), event_number);
+    return (int)(it - evnums.begin()) - 1;
+}
+
+int PRadScalerStore::GetEventNumber(int epoch)
+const
+{
+    if(epoch < 0 || (size_t)epoch >= evnums.size())
+        return -1;
+    return evnums[epoch];
+}
+
+DataRange<DSC_Data> PRadScalerStore::GetSnapshot(int epoch)
+const
+{
+    if(epoch < 0 || (size_t)epoch >= evnums.size())
+        return DataRange<DSC_Data>();
+    return {counts.data() + offsets[epoch], counts.data() + offsets[epoch + 1]};
+}
+
+double PRadScalerStore::GetBeamTime(int epoch)
+const
+{
+    auto dsc = GetSnapshot(epoch);
+    if(dsc.size() <= REF_CHANNEL)
+        return 0.;
+    return (double)dsc[REF_CHANNEL].ungated_count/(double)REF_PULSER_FREQ;
+}
+
+double PRadScalerStore::GetLiveTime(int epoch)
+const
+{
+    auto dsc = GetSnapshot(epoch);
+    if(dsc.size() <= REF_CHANNEL)
+        return 1.;
+    return 1. - (double)dsc[REF_CHANNEL].gated_count/(double)dsc[REF_CHANNEL].ungated_count;
+}
+
+double PRadScalerStore::GetBeamCharge(int epoch)
+const
+{
+    auto dsc = GetSnapshot(epoch);
+    if(dsc.size() <= FCUP_CHANNEL)
+        return 0.;
+    return ((double)dsc[FCUP_CHANNEL].ungated_count - FCUP_OFFSET)/FCUP_SLOPE;
+}
+
+size_t PRadScalerStore::MemoryUsage()
+const
+{
+    return evnums.capacity()*sizeof(int32_t)
+         + offsets.capacity()*sizeof(uint32_t)
+         + counts.capacity()*sizeof(DSC_Data);
+}
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadEventStore::PRadEventStore()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// append an event to the end
+void PRadEventStore::Append(const EventData &event)
+{
+    EventInfo info;
+    info.event_number = event.event_number;
+    info.type = event.type;
+    info.trigger = event.trigger;
+    info.timestamp = event.timestamp;
+    info.epics_index = event.epics_index;
+    // only the events with scalers add a snapshot
+    info.dsc_index = event.dsc_data.empty() ? scalers.GetEpoch()
+                                            : scalers.Add(event.event_number, event.dsc_data);
+    info.adc_begin = adc.size();
+    info.tdc_begin = tdc.size();
+    info.gem_begin = gem.size();
+    events.push_back(info);
+
+    adc.insert(adc.end(), event.adc_data.begin(), event.adc_data.end());
+    tdc.insert(tdc.end(), event.tdc_data.begin(), event.tdc_data.end());
+
+    for(auto &hit : event.gem_data)
+    {
+        GEMHitRef ref;
+        ref.addr = hit.addr;
+        ref.nvalues = hit.nvalues;
+        ref.value_begin = gem_values.size();
+        gem.push_back(ref);
+        gem_values.insert(gem_values.end(), hit.begin(), hit.end());
+    }
+}
+
+// append all the events from another store
+void PRadEventStore::Append(const PRadEventStore &that)
+{
+    size_t nev = events.size(), nadc = adc.size(), ntdc = tdc.size();
+    size_t ngem = gem.size(), nval = gem_values.size();
+    int last_dsc = scalers.GetEpoch();
+
+    events.insert(events.end(), that.events.begin(), that.events.end());
+    adc.insert(adc.end(), that.adc.begin(), that.adc.end());
+    tdc.insert(tdc.end(), that.tdc.begin(), that.tdc.end());
+    gem.insert(gem.end(), that.gem.begin(), that.gem.end());
+    gem_values.insert(gem_values.end(), that.gem_values.begin(), that.gem_values.end());
+    scalers.Append(that.scalers);
+
+    // move the offsets after the existing data
+    for(size_t i = nev; i < events.size(); ++i)
+    {
+        events[i].adc_begin += nadc;
+        events[i].tdc_begin += ntdc;
+        // the events before the first snapshot of that store refer to the
+        // last one of this store
+        events[i].dsc_index += last_dsc + 1;
+        events[i].gem_begin += ngem;
+    }
+
+    for(size_t i = ngem; i < gem.size(); ++i)
+        gem[i].value_begin += nval;
+}
+
+// remove all the events, the memory is kept for the future usage
+void PRadEventStore::Clear()
+{
+    events.clear();
+    adc.clear();
+    tdc.clear();
+    gem.clear();
+    gem_values.clear();
+    scalers.Clear();
+}
+
+void PRadEventStore::ClearEvents()
+{
+    events.clear();
+    adc.clear();
+    tdc.clear();
+    gem.clear();
+    gem_values.clear();
+}
+
+// remove all the events and release the memory
+void PRadEventStore::Release()
+{
+    PRadEventStore empty;
+    std::swap(*this, empty);
+}
+
+// reserve space for the expected number of events
+void PRadEventStore::Reserve(size_t nevents, size_t adcs_per_event)
+{
+    events.reserve(nevents);
+    adc.reserve(nevents*adcs_per_event);
+}
+
+// find the event index by event number, the events are assumed to be in order
+// return -1 if it is not found
+int PRadEventStore::Find(int event_number)
+const
+{
+    auto it = cana::branchless_lower_bound(events.begin(), events.end(), event_number,
+                                           [] (const EventInfo &info, int ev)
+                                           {
+                                               return info.event_number < ev;
+                                           });
+
+    if(it == events.end() || it->event_number != event_number)
+        return -1;
+
+    return it - events.begin();
+}
+
+// memory used by the data in bytes
+size_t PRadEventStore::MemoryUsage()
+const
+{
+    return events.capacity()*sizeof(EventInfo)
+         + adc.capacity()*sizeof(ADC_Data)
+         + tdc.capacity()*sizeof(TDC_Data)
+         + gem.capacity()*sizeof(GEMHitRef)
+         + gem_values.capacity()*sizeof(float)
+         + scalers.MemoryUsage();
+}
+
+size_t PRadEventStore::DataSize()
+const
+{
+    return events.size()*sizeof(EventInfo)
+         + adc.size()*sizeof(ADC_Data)
+         + tdc.size()*sizeof(TDC_Data)
+         + gem.size()*sizeof(GEMHitRef)
+         + gem_values.size()*sizeof(float);
+}
@@ -7,18 +7,43 @@
 //============================================================================//
 
 #include "PRadEvioParser.h"
+#include "PRadProfiler.h"
+#include "PRadMetrics.h"
 #include "PRadDataHandler.h"
+#include "PRadTaskPool.h"
+#include "PRadThreadTopology.h"
+#include "PRadAsyncIO.h"
 #include <sstream>
 #include <iostream>
 #include <iomanip>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #ifdef MULTI_THREAD
 #include <thread>
-#define ROC_THREAD_THRES 5000     // open a new thread for large roc buffer size
+#include <mutex>
+#include <condition_variable>
+#define ROC_THREAD_THRES 5000     // use the task pool for large roc buffer size
+#define BLOCK_QUEUE_FACTOR 4      // decoded blocks allowed in queue per thread
+#define READ_AHEAD_BLOCKS 8       // blocks read ahead by the io thread in stream mode
 #endif
 
-#define MAX_BUFFER_SIZE 100000    // buffer to store a evio block
+#define INIT_BUFFER_SIZE 100000   // initial size of the evio block buffer
+#define BUFFER_GROW_FACTOR 2      // geometric growth of the block buffer
 #define BLOCK_HEADER_SIZE 8       // evio block header size
+#define ROC_POOL_SIZE 4           // number of threads in the roc task pool
+#define PREFETCH_BLOCKS 4         // number of blocks to be hinted ahead in mapping mode
+#define PREFETCH_CHUNK 4194304    // reading size of the file prefetching in bytes
+#define INDEX_MAGIC 0x58444945    // "EIDX", block index sidecar file
+#define INDEX_VERSION 1
+#define INDEX_SUFFIX ".idx"
+#define FILTERED_EVENT 0          // returned type for the events rejected by filter
 
 
 using namespace std;
@@ -31,15 +56,24 @@ using namespace std;
 
 // constructor
 PRadEvioParser::PRadEvioParser(PRadDataHandler *handler)
-: myHandler(handler), event_number(0)
+: myHandler(handler), builder(nullptr), output(nullptr),
+  event_number(0), decode_threads(1), use_mmap(true), presize_buffer(true),
+  gem_staging(false), partial_parse(false), read_stop(false),
+  trigger_mask(0), skipped_events(0), skipped_bytes(0),
+  use_index(false), seek_block(-1), skip_before(0), prefetch_stop(false),
+  block_buffer(nullptr), buffer_size(0), roc_pool(nullptr)
 {
-    // place holder
+    ResetDecoders();
 }
 
 // destructor
 PRadEvioParser::~PRadEvioParser()
 {
-    // place holder
+    StopPrefetch();
+    delete roc_pool;
+    for(auto &roc_parser : roc_parsers)
+        delete roc_parser;
+    ReleaseBuffer();
 }
 
 
@@ -48,13 +82,455 @@ PRadEvioParser::~PRadEvioParser()
 // Public Member Functions                                                    //
 //============================================================================//
 
-// simple binary reading for evio format files
+// read evio format files, use memory mapping by default
 int PRadEvioParser::ReadEvioFile(const char *filepath, int max_count, bool verbose)
 {
-    // evio file is written in binary
-    ifstream evio_in(filepath, ios::binary | ios::in);
+    // load the block index, or create it on the first reading
+    if(use_index)
+        prepareIndex(filepath);
+
+    uint64_t skipped = skipped_events, skipped_size = skipped_bytes;
+
+    int count;
+    if(use_mmap)
+        count = readEvioMapping(filepath, max_count, verbose);
+    else
+        count = readEvioStream(filepath, max_count, verbose);
+
+    if(verbose && trigger_mask) {
+        cout << "Trigger filter skipped " << skipped_events - skipped
+             << " events (" << (skipped_bytes - skipped_size)/1024/1024
+             << " MB) from " << filepath << endl;
+    }
+
+    // seeking only affects one reading
+    seek_block = -1;
+    skip_before = 0;
+    return count;
+}
+
+// make sure the block buffer can hold a block with the size of words
+// the buffer is kept and reused for the following files, it is from the
+// thread topology, so a large one can be on huge pages
+void PRadEvioParser::ReserveBuffer(size_t words)
+{
+    if(words <= buffer_size)
+        return;
+
+    ReleaseBuffer();
+    block_buffer = (uint32_t*) PRadThreadTopology::Instance().Allocate(words*sizeof(uint32_t));
+    if(!block_buffer)
+        throw std::bad_alloc();
+    buffer_size = words;
+}
+
+// release the block buffer
+void PRadEvioParser::ReleaseBuffer()
+{
+    PRadThreadTopology::Instance().Free(block_buffer, buffer_size*sizeof(uint32_t));
+    block_buffer = nullptr;
+    buffer_size = 0;
+}
 
-    if(!evio_in.is_open()) {
+// scan the block headers and event info banks of a evio file to build the
+// block index, it does not decode the events
+bool PRadEvioParser::BuildIndex(const char *filepath, bool save)
+{
+    ClearIndex();
+
+    int fd = open(filepath, O_RDONLY);
+    if(fd < 0) {
+        cerr << "Cannot open evio file "
+             << "\"" << filepath << "\""
+             << endl;
+        return false;
+    }
+
+    struct stat fs;
+    if(fstat(fd, &fs) < 0 || fs.st_size <= 0) {
+        cerr << "Cannot get the size of evio file "
+             << "\"" << filepath << "\""
+             << endl;
+        close(fd);
+        return false;
+    }
+
+    size_t length = fs.st_size;
+    void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(addr == MAP_FAILED) {
+        cerr << "Cannot map evio file "
+             << "\"" << filepath << "\"" << " into memory ("
+             << strerror(errno) << "), abort building block index."
+             << endl;
+        return false;
+    }
+
+    madvise(addr, length, MADV_SEQUENTIAL);
+    indexBlocks((const uint32_t*) addr, length/sizeof(uint32_t));
+    munmap(addr, length);
+
+    index_file = filepath;
+
+    if(save)
+        SaveIndex(filepath);
+
+    return !block_index.empty();
+}
+
+// load the block index from the sidecar file of a evio file
+bool PRadEvioParser::LoadIndex(const char *filepath)
+{
+    ClearIndex();
+
+    ifstream in(index_path(filepath), ios::binary | ios::in);
+    if(!in.is_open())
+        return false;
+
+    struct stat fs;
+    if(stat(filepath, &fs) < 0)
+        return false;
+
+    uint32_t magic = 0, version = 0;
+    uint64_t file_size = 0, nblocks = 0;
+    in.read((char*) &magic, sizeof(magic));
+    in.read((char*) &version, sizeof(version));
+    in.read((char*) &file_size, sizeof(file_size));
+    in.read((char*) &nblocks, sizeof(nblocks));
+
+    // the index is outdated or not for this file
+    if(!in || magic != INDEX_MAGIC || version != INDEX_VERSION ||
+       file_size != (uint64_t) fs.st_size)
+        return false;
+
+    block_index.resize(nblocks);
+    in.read((char*) block_index.data(), nblocks*sizeof(BlockIndex));
+
+    if(!in) {
+        cerr << "Incomplete block index file "
+             << "\"" << index_path(filepath) << "\""
+             << endl;
+        block_index.clear();
+        return false;
+    }
+
+    index_file = filepath;
+    return true;
+}
+
+// save the block index to the sidecar file of a evio file
+bool PRadEvioParser::SaveIndex(const char *filepath)
+const
+{
+    struct stat fs;
+    if(stat(filepath, &fs) < 0)
+        return false;
+
+    string path = index_path(filepath);
+    ofstream out(path, ios::binary | ios::out);
+    if(!out.is_open()) {
+        cerr << "Cannot write block index file "
+             << "\"" << path << "\""
+             << endl;
+        return false;
+    }
+
+    uint32_t magic = INDEX_MAGIC, version = INDEX_VERSION;
+    uint64_t file_size = fs.st_size, nblocks = block_index.size();
+    out.write((const char*) &magic, sizeof(magic));
+    out.write((const char*) &version, sizeof(version));
+    out.write((const char*) &file_size, sizeof(file_size));
+    out.write((const char*) &nblocks, sizeof(nblocks));
+    out.write((const char*) block_index.data(), nblocks*sizeof(BlockIndex));
+
+    return out.good();
+}
+
+void PRadEvioParser::ClearIndex()
+{
+    index_file.clear();
+    block_index.clear();
+    seek_block = -1;
+    skip_before = 0;
+}
+
+// let the next reading of the indexed file start from the event, the events
+// before it in the same block are skipped
+// return the block number or -1 if the event is not found
+int PRadEvioParser::SeekEvent(int ev)
+{
+    if(block_index.empty()) {
+        cerr << "Cannot seek event " << ev
+             << ", no block index is loaded." << endl;
+        return -1;
+    }
+
+    for(size_t i = 0; i < block_index.size(); ++i)
+    {
+        if(block_index[i].nevents && block_index[i].last >= (uint32_t) ev) {
+            seek_block = i;
+            skip_before = ev;
+            return seek_block;
+        }
+    }
+
+    cerr << "Cannot find event " << ev
+         << " in file " << index_file << endl;
+    return -1;
+}
+
+// read the file in background so it is in the page cache when it is going to
+// be parsed, it hides the latency of the network file systems
+void PRadEvioParser::PrefetchFile(const char *filepath)
+{
+    StopPrefetch();
+
+#ifdef MULTI_THREAD
+    prefetch_stop = false;
+    prefetch_thread = thread(&PRadEvioParser::prefetch, this, string(filepath));
+#else
+    // no background thread, only give the hint to kernel
+    int fd = open(filepath, O_RDONLY);
+    if(fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+#endif
+}
+
+// stop the background file reading
+void PRadEvioParser::StopPrefetch()
+{
+    prefetch_stop = true;
+    if(prefetch_thread.joinable())
+        prefetch_thread.join();
+}
+
+// read a event buffer, return its type
+int PRadEvioParser::ReadEventBuffer(const void *buf)
+{
+    return parseEvent((const PRadEventHeader *)buf);
+}
+
+// register the decoder of a bank, it replaces the decoder with the same roc
+// and bank, the roc is enabled if it is specified
+void PRadEvioParser::RegisterDecoder(int roc, int bank, const BankDecoder &func, bool trigger_info)
+{
+    if(bank < 0 || bank > 0xffff || roc < ANY_ROC || roc > 0xffff || !func) {
+        cerr << "PRad Evio Parser Error: Invalid decoder for roc " << roc
+             << ", bank " << bank << "." << endl;
+        return;
+    }
+
+    auto it = find_if(decoders.begin(), decoders.end(),
+                      [roc, bank] (const DecoderEntry &dec)
+                      {
+                          return dec.roc == roc && dec.bank == bank;
+                      });
+    if(it != decoders.end()) {
+        it->func = func;
+        it->trigger_info = trigger_info;
+    } else {
+        decoders.emplace_back(roc, bank, func, trigger_info);
+    }
+
+    if(roc != ANY_ROC && find(rocs.begin(), rocs.end(), roc) == rocs.end())
+        rocs.push_back(roc);
+
+    compileDecoders();
+}
+
+void PRadEvioParser::RemoveDecoder(int roc, int bank)
+{
+    decoders.erase(remove_if(decoders.begin(), decoders.end(),
+                             [roc, bank] (const DecoderEntry &dec)
+                             {
+                                 return dec.roc == roc && dec.bank == bank;
+                             }),
+                   decoders.end());
+    compileDecoders();
+}
+
+// the decoders of PRad data, the live time and configuration banks are not
+// decoded
+void PRadEvioParser::ResetDecoders()
+{
+    rocs = {PRadTS,     // VME, ROC id 1
+            PRadTagE,   // Tagger E, ROC id 2
+            PRadROC_1,  // Fastbus, ROC id 4
+            PRadROC_2,  // Fastbus, ROC id 5
+            PRadROC_3,  // Fastbus, ROC id 6
+            PRadSRS_1,  // SRS, ROC id 7
+            PRadSRS_2,  // SRS, ROC id 8
+            EPICS_IOC};
+    disabled_banks.clear();
+    decoders.clear();
+
+    // TI data, contains live time and event type information
+    decoders.emplace_back(ANY_ROC, TI_BANK,
+                          [] (PRadEvioParser &p, const PRadEventHeader *h)
+                          {
+                              p.parseTIData((const uint32_t*)&h[1], h->length - 1, h->num);
+                          }, true);
+    auto tdc = [] (PRadEvioParser &p, const PRadEventHeader *h)
+               {
+                   p.parseTDCV1190((const uint32_t*)&h[1], h->length - 1, h->num);
+               };
+    decoders.emplace_back(ANY_ROC, TDC_BANK, tdc, false);
+    decoders.emplace_back(ANY_ROC, TAG_BANK, tdc, false);
+    decoders.emplace_back(ANY_ROC, DSC_BANK,
+                          [] (PRadEvioParser &p, const PRadEventHeader *h)
+                          {
+                              p.parseDSCData((const uint32_t*)&h[1], h->length - 1);
+                          }, true);
+    // Fastbus data
+    decoders.emplace_back(ANY_ROC, FASTBUS_BANK,
+                          [] (PRadEvioParser &p, const PRadEventHeader *h)
+                          {
+                              p.parseADC1881M((const uint32_t*)&h[1]);
+                          }, false);
+    // gem data, single FEC right now
+    decoders.emplace_back(ANY_ROC, GEM_BANK,
+                          [] (PRadEvioParser &p, const PRadEventHeader *h)
+                          {
+                              p.parseGEMData((const uint32_t*)&h[1], h->length - 1, h->num);
+                          }, false);
+    decoders.emplace_back(ANY_ROC, EPICS_BANK,
+                          [] (PRadEvioParser &p, const PRadEventHeader *h)
+                          {
+                              p.parseEPICS((const uint32_t*)&h[1]);
+                          }, true);
+
+    compileDecoders();
+}
+
+void PRadEvioParser::EnableROC(int roc, bool e)
+{
+    auto it = find(rocs.begin(), rocs.end(), roc);
+    if(e && it == rocs.end() && roc >= 0 && roc <= 0xffff)
+        rocs.push_back(roc);
+    else if(!e && it != rocs.end())
+        rocs.erase(it);
+    compileDecoders();
+}
+
+// a bank disabled for ANY_ROC is skipped in all the rocs
+void PRadEvioParser::EnableBank(int bank, bool e, int roc)
+{
+    auto key = make_pair(roc, bank);
+    auto it = find(disabled_banks.begin(), disabled_banks.end(), key);
+    if(e && it != disabled_banks.end())
+        disabled_banks.erase(it);
+    else if(!e && it == disabled_banks.end())
+        disabled_banks.push_back(key);
+    compileDecoders();
+}
+
+bool PRadEvioParser::IsROCEnabled(int roc)
+const
+{
+    return dispatch->ROCSlot(roc) >= 0;
+}
+
+bool PRadEvioParser::IsBankEnabled(int roc, int bank)
+const
+{
+    int slot = dispatch->ROCSlot(roc);
+    return slot >= 0 && dispatch->Decoder(slot, bank) >= 0;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// index the blocks in memory
+void PRadEvioParser::indexBlocks(const uint32_t *buf, size_t total)
+{
+    block_index.clear();
+
+    size_t pos = 0;
+    while(pos + BLOCK_HEADER_SIZE <= total)
+    {
+        uint32_t block_size = buf[pos];
+        if(block_size < BLOCK_HEADER_SIZE || pos + block_size > total) {
+            cerr << "Index Evio Block: "
+                 << "invalid block size " << block_size
+                 << " at word " << pos
+                 << ", only index the blocks before it." << endl;
+            break;
+        }
+
+        BlockIndex block(pos, block_size);
+        uint32_t index = BLOCK_HEADER_SIZE;
+        while(index < block_size)
+        {
+            const PRadEventHeader *header = (const PRadEventHeader*) &buf[pos + index];
+            if(header->tag == CODA_Event || header->tag == CODA_Sync) {
+                block.nevents++;
+                uint32_t ev = peek_event_number(header);
+                if(ev) {
+                    if(!block.first) block.first = ev;
+                    block.last = ev;
+                }
+            }
+            index += header->length + 1;
+        }
+
+        block_index.push_back(block);
+        pos += block_size;
+    }
+}
+
+// load the block index of the file, build and save it if it does not exist
+void PRadEvioParser::prepareIndex(const char *filepath)
+{
+    if(index_file == filepath && !block_index.empty())
+        return;
+
+    if(!LoadIndex(filepath))
+        BuildIndex(filepath, true);
+}
+
+// the starting word of the reading, from the pending seek
+size_t PRadEvioParser::seekStart(const char *filepath)
+{
+    if(seek_block < 0 || index_file != filepath || (size_t) seek_block >= block_index.size())
+        return 0;
+
+    return block_index[seek_block].pos;
+}
+
+// read through the file to have it in the page cache
+void PRadEvioParser::prefetch(string filepath)
+{
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0)
+        return;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+    vector<char> chunk(PREFETCH_CHUNK);
+    while(!prefetch_stop)
+    {
+        ssize_t nbytes = read(fd, chunk.data(), chunk.size());
+        if(nbytes <= 0)
+            break;
+    }
+
+    close(fd);
+}
+
+// simple binary reading for evio format files
+int PRadEvioParser::readEvioStream(const char *filepath, int max_count, bool verbose)
+{
+    // the following segments of the file are read asynchronously while the
+    // blocks are copied out
+    PRadAsyncReader evio_in;
+
+    if(!evio_in.Open(filepath)) {
         cerr << "Cannot open evio file "
              << "\"" << filepath << "\""
              << endl;
@@ -62,24 +538,37 @@ int PRadEvioParser::ReadEvioFile(const char *filepath, int max_count, bool verbo
     }
 
     // get the total length of file
-    evio_in.seekg(0, evio_in.end);
-    int64_t length = evio_in.tellg();
-    evio_in.seekg(0, evio_in.beg);
+    int64_t length = evio_in.Size();
+
+    // buffer is to store current event block, it grows when a larger block
+    // comes, pre-size it from the first block header to avoid re-allocation
+    size_t init_size = INIT_BUFFER_SIZE;
+    if(presize_buffer && length >= (int64_t)sizeof(uint32_t)) {
+        uint32_t first_size = 0;
+        evio_in.Read(&first_size, sizeof(uint32_t));
+        init_size = max(init_size, (size_t)first_size*BUFFER_GROW_FACTOR);
+    }
+    ReserveBuffer(init_size);
 
-    // buffer is to store current event block, make sure it is large enough
-    uint32_t *buffer = new uint32_t[MAX_BUFFER_SIZE];
+    // start from the seeked block
+    evio_in.Seek(seekStart(filepath)*sizeof(uint32_t));
 
     if(verbose) {
-        cout << "Reading evio file " << filepath << endl;
+        cout << "Reading evio file " << filepath << " ("
+             << PRadAsyncIO::BackendName(evio_in.GetIO().GetBackend()) << ")" << endl;
     }
 
     // parse block, stop when read enough event
     // if max_count <= 0, it reads all events
+#ifdef MULTI_THREAD
+    // the blocks are read ahead by an io thread
+    int count = readStreamAhead(evio_in, max_count, filepath);
+#else
     int count = 0;
-    while(evio_in.tellg() < length && evio_in.tellg() != -1)
+    while(evio_in.Tell() < length)
     {
         try {
-            count += parseEvioBlock(evio_in, buffer, max_count-count);
+            count += parseEvioBlock(evio_in, max_count-count);
         } catch (PRadException &e) {
             cerr << e.FailureType() << ": "
                  << e.FailureDesc() << endl;
@@ -87,44 +576,286 @@ int PRadEvioParser::ReadEvioFile(const char *filepath, int max_count, bool verbo
             break;
         }
 
-        if(max_count > 0 && count >= max_count)
+        if(read_stop || (max_count > 0 && count >= max_count))
             break;
     }
+#endif
 
-    delete [] buffer;
-
-    evio_in.close();
+    evio_in.Close();
 
     return count;
 }
 
-// read a event buffer, return its type
-int PRadEvioParser::ReadEventBuffer(const void *buf)
+// map the evio file into memory and parse the blocks in place
+// it avoids copying the data into a user space buffer
+int PRadEvioParser::readEvioMapping(const char *filepath, int max_count, bool verbose)
 {
-    return parseEvent((const PRadEventHeader *)buf);
+    int fd = open(filepath, O_RDONLY);
+    if(fd < 0) {
+        cerr << "Cannot open evio file "
+             << "\"" << filepath << "\""
+             << endl;
+        return 0;
+    }
+
+    struct stat fs;
+    if(fstat(fd, &fs) < 0 || fs.st_size <= 0) {
+        cerr << "Cannot get the size of evio file "
+             << "\"" << filepath << "\""
+             << endl;
+        close(fd);
+        return 0;
+    }
+
+    size_t length = fs.st_size;
+    void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping is kept valid after closing the descriptor
+    close(fd);
+
+    if(addr == MAP_FAILED) {
+        cerr << "Cannot map evio file "
+             << "\"" << filepath << "\"" << " into memory ("
+             << strerror(errno) << "), fall back to stream reading."
+             << endl;
+        return readEvioStream(filepath, max_count, verbose);
+    }
+
+    // the file will be read through only once
+    madvise(addr, length, MADV_SEQUENTIAL);
+
+    if(verbose) {
+        cout << "Reading evio file " << filepath << " (mapped)" << endl;
+    }
+
+    const uint32_t *buf = (const uint32_t*) addr;
+    const size_t total = length/sizeof(uint32_t);
+
+    // parse block, stop when read enough event
+    // if max_count <= 0, it reads all events
+    int count = 0;
+
+    // start from the seeked block
+    const size_t start = seekStart(filepath);
+
+    // decode the blocks in parallel, index the block boundaries first
+    if(decode_threads > 1) {
+        std::vector<size_t> blocks;
+        size_t pos = start;
+
+        // use the block index if it is available
+        if(index_file == filepath && !block_index.empty()) {
+            for(auto &block : block_index)
+            {
+                if(block.pos >= start && block.pos + block.size <= total)
+                    blocks.push_back(block.pos);
+            }
+            pos = total;
+        }
+
+        while(pos + BLOCK_HEADER_SIZE <= total)
+        {
+            uint32_t block_size = buf[pos];
+            if(block_size < BLOCK_HEADER_SIZE || pos + block_size > total) {
+                cerr << "Read Evio Block: "
+                     << "invalid block size " << block_size
+                     << " at word " << pos << endl;
+                cerr << "Only decode the blocks before it from file "
+                     << filepath << endl;
+                break;
+            }
+            blocks.push_back(pos);
+            pos += block_size;
+        }
+
+        count = parseEvioBlocks(buf, blocks, max_count);
+        munmap(addr, length);
+        return count;
+    }
+
+    // page aligned hints for the following blocks
+    const uintptr_t page_mask = ~((uintptr_t) sysconf(_SC_PAGESIZE) - 1);
+
+    size_t pos = start;
+    while(pos + BLOCK_HEADER_SIZE <= total)
+    {
+        uint32_t block_size = buf[pos];
+
+        // corrupted block header or truncated file
+        if(block_size < BLOCK_HEADER_SIZE || pos + block_size > total) {
+            cerr << "Read Evio Block: "
+                 << "invalid block size " << block_size
+                 << " at word " << pos << endl;
+            cerr << "Abort reading from file " << filepath << endl;
+            break;
+        }
+
+        // ask kernel to read ahead the next few blocks
+        size_t ahead = pos + (size_t)block_size*PREFETCH_BLOCKS;
+        if(ahead > total) ahead = total;
+        uintptr_t hint_beg = ((uintptr_t) &buf[pos + block_size]) & page_mask;
+        uintptr_t hint_end = (uintptr_t) &buf[ahead];
+        if(hint_end > hint_beg)
+            madvise((void*) hint_beg, hint_end - hint_beg, MADV_WILLNEED);
+
+        // next block header will be touched right after this block
+        if(pos + block_size < total)
+            __builtin_prefetch(&buf[pos + block_size], 0, 0);
+
+        count += parseEvioBlock(&buf[pos], max_count-count);
+        pos += block_size;
+
+        if(read_stop || (max_count > 0 && count >= max_count))
+            break;
+    }
+
+    munmap(addr, length);
+
+    return count;
 }
 
+#ifdef MULTI_THREAD
+// read the blocks into a ring of buffers by an io thread, while the blocks
+// are parsed in this thread
+int PRadEvioParser::readStreamAhead(PRadAsyncReader &in, int max_evt, const char *filepath)
+{
+    // the buffers are kept and reused
+    vector<vector<uint32_t>> ring(READ_AHEAD_BLOCKS);
+    vector<bool> ready(READ_AHEAD_BLOCKS, false);
+    size_t produced = 0, consumed = 0;
+    bool stop = false, done = false;
+    string error;
+    mutex locker;
+    condition_variable cond;
+
+    thread reader([&] ()
+    {
+        while(true)
+        {
+            {
+                unique_lock<mutex> lock(locker);
+                cond.wait(lock, [&] {return stop || produced < consumed + READ_AHEAD_BLOCKS;});
+                if(stop)
+                    break;
+            }
 
-//============================================================================//
-// Private Member Functions                                                   //
-//============================================================================//
+            if(in.Tell() >= in.Size())
+                break;
+
+            // the slot is not used by the parsing now
+            auto &buf = ring[produced%READ_AHEAD_BLOCKS];
+            uint32_t block_size = 0;
+            in.Read(&block_size, sizeof(uint32_t));
+            if(block_size < BLOCK_HEADER_SIZE) {
+                error = "invalid block size " + to_string(block_size);
+                break;
+            }
+
+            if(buf.size() < block_size)
+                buf.resize(max((size_t)block_size, buf.size()*BUFFER_GROW_FACTOR));
+
+            buf[0] = block_size;
+            size_t nbytes = sizeof(uint32_t)*(block_size - 1);
+            if(in.Read(&buf[1], nbytes) != nbytes) {
+                error = "incomplete block (size " + to_string(block_size) + ")";
+                break;
+            }
+
+            {
+                lock_guard<mutex> lock(locker);
+                ready[produced%READ_AHEAD_BLOCKS] = true;
+                produced++;
+            }
+            cond.notify_all();
+        }
+
+        {
+            lock_guard<mutex> lock(locker);
+            done = true;
+        }
+        cond.notify_all();
+    });
+
+    int count = 0;
+    while(true)
+    {
+        size_t slot = consumed%READ_AHEAD_BLOCKS;
+        {
+            unique_lock<mutex> lock(locker);
+            cond.wait(lock, [&] {return ready[slot] || (done && produced == consumed);});
+            if(!ready[slot])
+                break;
+        }
+
+        count += parseEvioBlock(ring[slot].data(), max_evt - count);
+
+        {
+            lock_guard<mutex> lock(locker);
+            ready[slot] = false;
+            consumed++;
+        }
+        cond.notify_all();
+
+        if(read_stop || (max_evt > 0 && count >= max_evt))
+            break;
+    }
+
+    {
+        lock_guard<mutex> lock(locker);
+        stop = true;
+    }
+    cond.notify_all();
+    reader.join();
+
+    if(!error.empty()) {
+        cerr << "Read Evio Block: " << error << endl;
+        cerr << "Abort reading from file " << filepath << endl;
+    }
+
+    return count;
+}
+#endif
 
 // parse a evio block data
-int PRadEvioParser::parseEvioBlock(ifstream &in, uint32_t *buf, int max_evt)
+int PRadEvioParser::parseEvioBlock(PRadAsyncReader &in, int max_evt)
 throw(PRadException)
 {
-    streamsize buf_size = sizeof(uint32_t);
+    size_t word_size = sizeof(uint32_t);
 
     // read the block size
-    in.read((char*) &buf[0], buf_size);
+    uint32_t block_size = 0;
+    in.Read(&block_size, word_size);
 
-    if(buf[0] > MAX_BUFFER_SIZE)
+    if(block_size < BLOCK_HEADER_SIZE)
     {
-        throw PRadException("Read Evio Block", "buffer size is not enough for the block (size " + to_string(buf[0]) + ")");
+        throw PRadException("Read Evio Block", "invalid block size " + to_string(block_size));
+    }
+
+    // grow the buffer geometrically, so a few large blocks won't cause
+    // re-allocation for every block
+    if(block_size > buffer_size)
+    {
+        size_t new_size = max((size_t)INIT_BUFFER_SIZE, buffer_size);
+        while(new_size < block_size)
+            new_size *= BUFFER_GROW_FACTOR;
+        ReserveBuffer(new_size);
     }
 
     // read the whole block in
-    in.read((char*) &buf[1], buf_size*(buf[0] - 1));
+    block_buffer[0] = block_size;
+    if(in.Read(&block_buffer[1], word_size*(block_size - 1)) != word_size*(block_size - 1))
+    {
+        throw PRadException("Read Evio Block", "incomplete block (size " + to_string(block_size) + ")");
+    }
+
+    return parseEvioBlock(block_buffer, max_evt);
+}
+
+// parse a evio block that is already in memory
+int PRadEvioParser::parseEvioBlock(const uint32_t *buf, int max_evt)
+{
+    static PRadMetricCounter *read_bytes = PRadMetrics::Instance()
+        .GetCounter("prad_evio_read_bytes_total", "bytes of the evio blocks read for decoding");
+    read_bytes->Add(buf[0]*sizeof(uint32_t));
 
     // skip the block header
     uint32_t index = BLOCK_HEADER_SIZE;
@@ -133,6 +864,15 @@ throw(PRadException)
     // inside a block
     while(index < buf[0])
     {
+        // skip the events before the seeked one
+        if(skip_before) {
+            if(peek_event_number((const PRadEventHeader *) &buf[index]) < skip_before) {
+                index += buf[index] + 1;
+                continue;
+            }
+            skip_before = 0;
+        }
+
         int type = parseEvent((const PRadEventHeader *) &buf[index]);
 
         // only count physics event
@@ -150,9 +890,152 @@ throw(PRadException)
     return  buffer_cnt;
 }
 
+#ifdef MULTI_THREAD
+// decode the indexed blocks with a fixed number of workers, each worker has its
+// own parser and event builder, the decoded events are then passed to the
+// handler in the block order, which is also the event number order
+int PRadEvioParser::parseEvioBlocks(const uint32_t *buf, const vector<size_t> &blocks,
+                                    int max_evt)
+{
+    const size_t nblocks = blocks.size();
+    const size_t queue_size = decode_threads*BLOCK_QUEUE_FACTOR;
+
+    // decoded blocks waiting to be processed
+    vector<BlockEvents> queue(queue_size);
+    vector<bool> ready(queue_size, false);
+    size_t next = 0, consumed = 0;
+    bool stop = false;
+    mutex locker;
+    condition_variable cond;
+
+    // the worker is pinned before its parser and events are allocated, so
+    // they are on the memory of its node
+    auto decode = [&] (unsigned int id)
+    {
+        PRadThreadTopology::Instance().PinWorker(id);
+
+        BlockEvents result;
+        PRadEvioParser worker(myHandler);
+        worker.output = &result;
+        worker.trigger_mask = trigger_mask;
+        worker.gem_staging = gem_staging;
+        worker.dispatch = dispatch;
+
+        while(true)
+        {
+            size_t iblk;
+            {
+                unique_lock<mutex> lock(locker);
+                // do not run too far ahead of the processing
+                cond.wait(lock, [&] {return stop || next >= nblocks || next < consumed + queue_size;});
+                if(stop || next >= nblocks) {
+                    // collect the filter statistics
+                    skipped_events += worker.skipped_events;
+                    skipped_bytes += worker.skipped_bytes;
+                    return;
+                }
+                iblk = next++;
+            }
+
+            result.clear();
+            worker.parseEvioBlock(&buf[blocks[iblk]], -1);
+
+            {
+                lock_guard<mutex> lock(locker);
+                // swap to recycle the events memory
+                swap(queue[iblk%queue_size], result);
+                ready[iblk%queue_size] = true;
+            }
+            cond.notify_all();
+        }
+    };
+
+    vector<thread> workers;
+    for(unsigned int i = 0; i < decode_threads; ++i)
+        workers.emplace_back(decode, i);
+
+    int count = 0;
+    BlockEvents block;
+    for(size_t iblk = 0; iblk < nblocks; ++iblk)
+    {
+        {
+            unique_lock<mutex> lock(locker);
+            cond.wait(lock, [&] {return ready[iblk%queue_size];});
+            swap(block, queue[iblk%queue_size]);
+            ready[iblk%queue_size] = false;
+            consumed = iblk + 1;
+        }
+        cond.notify_all();
+
+        size_t idef = 0;
+        for(size_t iev = 0; iev < block.nevents; ++iev)
+        {
+            auto &event = block.events[iev];
+            // skip the events before the seeked one
+            if(skip_before) {
+                if(event.type == EPICS_Info) {
+                    idef++;
+                    continue;
+                }
+                if((uint32_t) event.event_number < skip_before)
+                    continue;
+                skip_before = 0;
+            }
+
+            // the deferred events are decoded here to keep their order
+            if(event.type == EPICS_Info) {
+                parseEvent(block.deferred[idef++]);
+                continue;
+            }
+
+            event_number = event.event_number;
+            // the builder is an empty event, swap to keep both memories
+            swap(*builder, event);
+            myHandler->EndofThisEvent(event_number);
+
+            if(max_evt > 0 && ++count >= max_evt)
+                break;
+        }
+
+        if(read_stop || (max_evt > 0 && count >= max_evt))
+            break;
+    }
+
+    // stop the workers
+    {
+        lock_guard<mutex> lock(locker);
+        stop = true;
+    }
+    cond.notify_all();
+
+    for(auto &worker : workers)
+    {
+        if(worker.joinable()) worker.join();
+    }
+
+    return count;
+}
+#else
+// no multi-threading support, decode the blocks one by one
+int PRadEvioParser::parseEvioBlocks(const uint32_t *buf, const vector<size_t> &blocks,
+                                    int max_evt)
+{
+    int count = 0;
+    for(auto &pos : blocks)
+    {
+        count += parseEvioBlock(&buf[pos], max_evt - count);
+        if(read_stop || (max_evt > 0 && count >= max_evt))
+            break;
+    }
+    return count;
+}
+#endif
+
 // parse an evio event
 int PRadEvioParser::parseEvent(const PRadEventHeader *header)
 {
+    PRAD_PROFILE_SCOPE("EvioParser::parseEvent");
+
     // first check event type
     switch(header->tag)
     {
@@ -170,18 +1053,36 @@ int PRadEvioParser::parseEvent(const PRadEventHeader *header)
         return header->tag;
     }
 
+    // trigger filter, only check the TI bank, sync events are always kept
+    // for the scalers
+    if(trigger_mask && header->tag == CODA_Event) {
+        PRadTriggerType trg = peek_trigger(header);
+        if((trg != NotFromTI) && !(trigger_mask & trigger_to_bit(trg))) {
+            skipped_events++;
+            skipped_bytes += (header->length + 1)*sizeof(uint32_t);
+            return FILTERED_EVENT;
+        }
+    }
+
+    // decoding by a worker, leave a place holder for the event that needs to
+    // be decoded in order
+    if(output) {
+        if(header->tag == EPICS_Info) {
+            output->next().update_type(EPICS_Info);
+            output->deferred.push_back(header);
+            return header->tag;
+        }
+        builder = &output->next();
+    }
+
     // inform handler the start of a new event
-    myHandler->StartofNewEvent(header->tag);
+    myHandler->StartofNewEvent(header->tag, *builder);
 
     // skip current header
     const uint32_t buf_size = header->length - 1;
     const uint32_t *buf = (const uint32_t*) &header[1];
     uint32_t index = 0;
 
-#ifdef MULTI_THREAD
-    vector<thread> roc_threads;
-#endif
-
     // parse ROC data
     while(index < buf_size)
     {
@@ -189,9 +1090,11 @@ int PRadEvioParser::parseEvent(const PRadEventHeader *header)
         // skip header size and data size 2 + (length - 1)
         index += roc_header->length + 1;
 #ifdef MULTI_THREAD
-        // open a new thread for large roc data bank
-        if(buf[index] > ROC_THREAD_THRES) {
-            roc_threads.emplace_back(&PRadEvioParser::parseROCBank, this, roc_header);
+        // large roc data banks are left for the task pool
+        // workers of block-parallel decoding do not need it
+        if(!output && !partial_parse && roc_header->length > ROC_THREAD_THRES &&
+           dispatch->ROCSlot(roc_header->tag) >= 0) {
+            roc_tasks.push_back(roc_header);
         } else {
             parseROCBank(roc_header);
         }
@@ -200,14 +1103,22 @@ int PRadEvioParser::parseEvent(const PRadEventHeader *header)
 #endif
     }
 
-#ifdef MULTI_THREAD
-    for(auto &roc : roc_threads)
-    {
-        if(roc.joinable()) roc.join();
+    // parse the large roc banks after the small ones, so the trigger type
+    // from TI is known
+    if(!roc_tasks.empty())
+        parseROCTasks();
+    // the staged gem data
+    if(!gem_banks.empty()) {
+        myHandler->FeedGEMBanks(gem_banks.data(), gem_banks.size(), *builder);
+        gem_banks.clear();
     }
-#endif
+    // save the event for a worker
+    if(output) {
+        builder->event_number = event_number;
     // inform handler the end of this event
-    myHandler->EndofThisEvent(event_number);
+    } else {
+        myHandler->EndofThisEvent(event_number);
+    }
 
     // return parsed event type
     return header->tag;
@@ -218,23 +1129,17 @@ void PRadEvioParser::parseROCBank(const PRadEventHeader *roc_header)
 {
     const uint32_t *buf = (const uint32_t*) &roc_header[1]; // skip current header
 
-    switch(roc_header->tag)
-    {
-    case PRadTagE:  // Tagger E, ROC id 2
-    case PRadSRS_2: // SRS, ROC id 8
-    case PRadSRS_1: // SRS, ROC id 7
-    case PRadROC_3: // Fastbus, ROC id 6
-    case PRadROC_2: // Fastbus, ROC id 5
-    case PRadROC_1: // Fastbus, ROC id 4
-    case PRadTS:    // VME, ROC id 1
-    case EPICS_IOC:
-        break; // Interested in ROCs, to next header
-    case EVINFO_BANK: // special bank
-        event_number = buf[0]; // then skip
-    default: // unrecognized ROC, skip
+    // special bank
+    if(roc_header->tag == EVINFO_BANK) {
+        event_number = buf[0];
         return;
     }
 
+    // unrecognized or disabled ROC, skip
+    const int roc_slot = dispatch->ROCSlot(roc_header->tag);
+    if(roc_slot < 0)
+        return;
+
     uint32_t roc_size = roc_header->length - 1;
     uint32_t index = 0;
 
@@ -245,48 +1150,163 @@ void PRadEvioParser::parseROCBank(const PRadEventHeader *roc_header)
         index += bank_header->length + 1;
 
         // parse bank
-        parseDataBank(bank_header);
+        parseDataBank(roc_slot, bank_header);
     }
 }
 
+// parse the collected roc banks in the task pool
+void PRadEvioParser::parseROCTasks()
+{
+    if(!roc_pool)
+        roc_pool = new PRadTaskPool(ROC_POOL_SIZE);
+
+    // staging events, they need to know the event type and trigger type
+    if(roc_staging.size() < roc_tasks.size())
+        roc_staging.resize(roc_tasks.size());
+
+    // the sub-parsers are kept for the next events
+    while(roc_parsers.size() < roc_tasks.size())
+        roc_parsers.push_back(new PRadEvioParser(myHandler));
+
+    for(size_t i = 0; i < roc_tasks.size(); ++i)
+    {
+        auto &stage = roc_staging[i];
+        stage.update_type(builder->type);
+        stage.update_trigger(builder->trigger);
+
+        PRadEvioParser *roc_parser = roc_parsers[i];
+        roc_parser->myHandler = myHandler;
+        roc_parser->builder = &stage;
+        roc_parser->event_number = event_number;
+        roc_parser->gem_staging = gem_staging;
+        roc_parser->dispatch = dispatch;
+
+        // small capture so the task does not allocate
+        roc_pool->Submit([this, i] ()
+                         {
+                             roc_parsers[i]->parseROCBank(roc_tasks[i]);
+                         });
+    }
+
+    roc_pool->Wait();
+
+    // merge the staging events in the roc order
+    for(size_t i = 0; i < roc_tasks.size(); ++i)
+    {
+        auto &stage = roc_staging[i];
+        if(stage.trigger != builder->trigger)
+            myHandler->UpdateTrgType(stage.trigger, *builder);
+        if(stage.timestamp)
+            builder->timestamp = stage.timestamp;
+
+        auto &ev = *builder;
+        ev.adc_data.insert(ev.adc_data.end(), stage.adc_data.begin(), stage.adc_data.end());
+        ev.tdc_data.insert(ev.tdc_data.end(), stage.tdc_data.begin(), stage.tdc_data.end());
+        ev.dsc_data.insert(ev.dsc_data.end(), stage.dsc_data.begin(), stage.dsc_data.end());
+        ev.gem_data.insert(ev.gem_data.end(),
+                           make_move_iterator(stage.gem_data.begin()),
+                           make_move_iterator(stage.gem_data.end()));
+        stage.clear();
+
+        // the staged gem data are fed with the main event
+        auto &banks = roc_parsers[i]->gem_banks;
+        gem_banks.insert(gem_banks.end(), banks.begin(), banks.end());
+        banks.clear();
+    }
+
+    roc_tasks.clear();
+}
+
 // parse data banks
-void PRadEvioParser::parseDataBank(const PRadEventHeader *data_header)
+// the decoder is found from the dispatch table, uninterested banks are skipped
+void PRadEvioParser::parseDataBank(int roc_slot, const PRadEventHeader *data_header)
+{
+    const int idx = dispatch->Decoder(roc_slot, data_header->tag);
+    if(idx < 0)
+        return;
+
+    // partial parse skips the detector data
+    if(partial_parse && !dispatch->trigger_info[idx])
+        return;
+
+    dispatch->funcs[idx](*this, data_header);
+}
+
+// compile the registry to a flat table, the other parsers keep the old table
+// until they are given the new one
+void PRadEvioParser::compileDecoders()
 {
-    const uint32_t *buffer = (const uint32_t*) &data_header[1]; // skip current header
-    uint32_t dataSize = data_header->length - 1;
+    auto table = make_shared<DispatchTable>();
+
+    // roc slots of the enabled rocs
+    int max_roc = -1;
+    for(auto roc : rocs)
+        max_roc = max(max_roc, roc);
+    table->roc_slots.assign(max_roc + 1, -1);
 
-    // check the header, skip uninterested ones
-    switch(data_header->tag)
+    int nslots = 0;
+    for(auto roc : rocs)
     {
-    default:
-    case LIVE_BANK: // bank contains the live time
-    case CONF_BANK: // configuration information
-        break;
-   case TI_BANK: // Bank 0x4, TI data, contains live time and event type information
-        parseTIData(buffer, dataSize, data_header->num);
-        break;
-    case TDC_BANK:
-    case TAG_BANK:
-        parseTDCV1190(buffer, dataSize, data_header->num);
-        break;
-    case DSC_BANK:
-        parseDSCData(buffer, dataSize);
-        break;
-    case FASTBUS_BANK: // Bank 0x7, Fastbus data
-        parseADC1881M(buffer);
-        break;
-    case GEM_BANK: // Bank 0x8, gem data, single FEC right now
-        parseGEMData(buffer, dataSize, data_header->num);
-        break;
-    case EPICS_BANK: // epics information
-        parseEPICS(buffer);
-        break;
+        if(roc >= 0 && table->roc_slots[roc] < 0)
+            table->roc_slots[roc] = nslots++;
     }
+
+    // range of the bank tags
+    int bank_min = 0xffff, bank_max = -1;
+    for(auto &dec : decoders)
+    {
+        bank_min = min(bank_min, dec.bank);
+        bank_max = max(bank_max, dec.bank);
+    }
+    if(bank_max >= bank_min) {
+        table->bank_min = bank_min;
+        table->bank_span = bank_max - bank_min + 1;
+    }
+    table->slots.assign(nslots*table->bank_span, -1);
+
+    // the decoders for any roc first, then the specific ones
+    auto fill = [&] (const DecoderEntry &dec, int16_t idx)
+    {
+        uint32_t offset = dec.bank - table->bank_min;
+        if(dec.roc == ANY_ROC) {
+            for(int i = 0; i < nslots; ++i)
+                table->slots[i*table->bank_span + offset] = idx;
+        } else {
+            int slot = table->ROCSlot(dec.roc);
+            if(slot >= 0)
+                table->slots[slot*table->bank_span + offset] = idx;
+        }
+    };
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(auto &dec : decoders)
+        {
+            if((dec.roc == ANY_ROC) != (pass == 0))
+                continue;
+            fill(dec, table->funcs.size());
+            table->funcs.push_back(dec.func);
+            table->trigger_info.push_back(dec.trigger_info);
+        }
+    }
+
+    // disabled banks
+    for(auto &bank : disabled_banks)
+    {
+        if(bank.second < (int)table->bank_min ||
+           bank.second >= (int)(table->bank_min + table->bank_span))
+            continue;
+        fill(DecoderEntry(bank.first, bank.second, nullptr, false), -1);
+    }
+
+    dispatch = table;
 }
 
 // Fastbus ADC1881M data
 void PRadEvioParser::parseADC1881M(const uint32_t *data)
 {
+    PRAD_PROFILE_SCOPE("EvioParser::parseADC1881M");
+
     // Self defined crate data header
     if((data[0]&0xff0fff00) != ADC1881M_DATABEG) {
         cerr << "Incorrect Fastbus bank header!"
@@ -298,9 +1318,7 @@ void PRadEvioParser::parseADC1881M(const uint32_t *data)
     // number of boards given by the self defined info word in CODA readout list
     const unsigned char boardNum = data[0]&0xFF;
     unsigned int index = 1, wordCount;
-    ADC1881MData adcData;
-
-    adcData.addr.crate = (data[0]>>20)&0xF;
+    unsigned int crate = (data[0]>>20)&0xF;
 
     // parse the data for all boards
     for(unsigned char i = 0; i < boardNum; ++i)
@@ -310,29 +1328,31 @@ void PRadEvioParser::parseADC1881M(const uint32_t *data)
         else if(data[index] == ADC1881M_DATAEND) // self defined, end of crate word
             break;
 
-        adcData.addr.slot = (data[index]>>27)&0x1F;
+        unsigned int slot = (data[index]>>27)&0x1F;
         wordCount = (data[index]&0x7F) + index;
-        while(++index < wordCount)
+        ++index;
+        while(index < wordCount)
         {
-            if(((data[index]>>27)&0x1F) == (unsigned int)adcData.addr.slot) {
-                adcData.addr.channel = (data[index]>>17)&0x3F;
-                adcData.val = data[index]&0x3FFF;
-                myHandler->FeedData(adcData); // feed data to handler
-            } else { // show the error message
-                cerr << "*** MISMATCHED CRATE ADDRESS ***" << endl;
-                cerr << "GEOGRAPHICAL ADDRESS = "
-                     << "0x" << hex << setw(8) << setfill('0') // formating
-                     << adcData.addr.slot
-                     << endl;
-                cerr << "BOARD ADDRESS = "
-                     << "0x" << hex << setw(8) << setfill('0')
-                     << ((data[index]&0xf8000000)>>27)
-                     << endl;
-                cerr << "DATA WORD = "
-                     << "0x" << hex << setw(8) << setfill('0')
-                     << data[index]
-                     << endl;
-            }
+            // feed the whole slot to handler
+            index += myHandler->FeedADCBank(crate, slot, &data[index], wordCount - index, *builder);
+            if(index >= wordCount)
+                break;
+
+            // show the error message
+            cerr << "*** MISMATCHED CRATE ADDRESS ***" << endl;
+            cerr << "GEOGRAPHICAL ADDRESS = "
+                 << "0x" << hex << setw(8) << setfill('0') // formating
+                 << slot
+                 << endl;
+            cerr << "BOARD ADDRESS = "
+                 << "0x" << hex << setw(8) << setfill('0')
+                 << ((data[index]&0xf8000000)>>27)
+                 << endl;
+            cerr << "DATA WORD = "
+                 << "0x" << hex << setw(8) << setfill('0')
+                 << data[index]
+                 << endl;
+            ++index;
         }
     }
 
@@ -341,6 +1361,8 @@ void PRadEvioParser::parseADC1881M(const uint32_t *data)
 // GEM data
 void PRadEvioParser::parseGEMData(const uint32_t *data, const uint32_t &size,  const int &fec_id)
 {
+    PRAD_PROFILE_SCOPE("EvioParser::parseGEMData");
+
     // pre-zero-suppressed GEM data are in bank 99
     if(fec_id == 99) {
         parseGEMZeroSupData(data, size);
@@ -359,7 +1381,10 @@ void PRadEvioParser::parseGEMData(const uint32_t *data, const uint32_t &size,  c
             gemData.buf = &data[i+2];
             gemData.size = getAPVDataSize(gemData.buf);
 
-            myHandler->FeedData(gemData);
+            if(gem_staging)
+                gem_banks.push_back(gemData);
+            else
+                myHandler->FeedData(gemData, *builder);
 
             i += gemData.size;
         } else {
@@ -371,6 +1396,8 @@ void PRadEvioParser::parseGEMData(const uint32_t *data, const uint32_t &size,  c
 // parse zero-suppressed GEM data
 void PRadEvioParser::parseGEMZeroSupData(const uint32_t *data, const uint32_t &size)
 {
+    PRAD_PROFILE_SCOPE("EvioParser::parseGEMZeroSupData");
+
     // data word structure (32 bit word)
     // detector: 1 bit
     // plane: 1 bit
@@ -381,26 +1408,34 @@ void PRadEvioParser::parseGEMZeroSupData(const uint32_t *data, const uint32_t &s
     // polarity: 1 bit
     // adc value: 11 bit
 
+    if(!size)
+        return;
+
     if((data[0]&0xffffff00) != GEMDATA_ZEROSUP) {
         cerr << "Unrecognized GEM zero suppressed data header word: "
              << "0x" << hex << setw(8) << setfill('0') << data[0]
              << endl;
     }
 
-    vector<GEMZeroSupData> gemDataPack;
-    for(uint32_t i = 1; i < size; ++i)
-    {
-        GEMZeroSupData gemData;
-        gemData.addr.fec_id = (data[i] >> 26)&0xf;
-        gemData.addr.adc_ch = (data[i] >> 22)&0xf;
-        gemData.channel = (data[i] >> 15)&0x7f;
-        gemData.time_sample = (data[i] >> 12)&0x7;
-        gemData.adc_value = data[i]&0x7ff;
+    uint32_t n = size - 1;
+    if(gem_zerosup.size() < n)
+        gem_zerosup.resize(n);
+    unpack_gem_zerosup(&data[1], n, gem_zerosup.data());
 
-        gemDataPack.push_back(gemData);
-    }
+    myHandler->FeedGEMZeroSup(gem_zerosup.data(), n, *builder);
+}
 
-    myHandler->FeedData(gemDataPack);
+void PRadEvioParser::unpack_gem_zerosup(const uint32_t *words, size_t n, GEMZeroSupData *out)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        uint32_t word = words[i];
+        out[i].addr.fec_id = (word >> 26)&0xf;
+        out[i].addr.adc_ch = (word >> 22)&0xf;
+        out[i].channel = (word >> 15)&0x7f;
+        out[i].time_sample = (word >> 12)&0x7;
+        out[i].adc_value = word&0x7ff;
+    }
 }
 
 // a helper function to determine the APV data size
@@ -422,6 +1457,8 @@ uint32_t PRadEvioParser::getAPVDataSize(const uint32_t *data)
 // parse CAEN V767 Data
 void PRadEvioParser::parseTDCV767(const uint32_t *data, const uint32_t &size, const int &roc_id)
 {
+    PRAD_PROFILE_SCOPE("EvioParser::parseTDCV767");
+
     if(!(data[0]&V767_HEADER_BIT)) {
         cerr << "Unrecognized V767 header word: "
              << "0x" << hex << setw(8) << setfill('0') << data[0]
@@ -435,9 +1472,12 @@ void PRadEvioParser::parseTDCV767(const uint32_t *data, const uint32_t &size, co
         return;
     }
 
-    TDCV767Data tdcData;
-    tdcData.addr.crate = roc_id;
-    tdcData.addr.slot = data[0]>>27;
+    // the data words are fed together, report the invalid ones if there is any
+    uint32_t nwords = (size > 2) ? size - 2 : 0;
+    uint32_t nhits = myHandler->FeedTDCV767Bank(roc_id, data[0]>>27, &data[1], nwords, *builder);
+    if(nhits == nwords)
+        return;
+
     for(uint32_t i = 1; i < size - 1; ++i)
     {
         if(data[i]&V767_INVALID_BIT) {
@@ -445,51 +1485,17 @@ void PRadEvioParser::parseTDCV767(const uint32_t *data, const uint32_t &size, co
                  << ", invalid data word: "
                  << "0x" << hex << setw(8) << setfill('0') << data[i]
                  << endl;
-            continue;
         }
-        tdcData.addr.channel = (data[i]>>24)&0x7f;
-        tdcData.val = data[i]&0xfffff;
-        myHandler->FeedData(tdcData);
     }
 }
 
 // parse CAEN V1190 Data
 void PRadEvioParser::parseTDCV1190(const uint32_t *data, const uint32_t &size, const int &roc_id)
 {
-    TDCV1190Data tdcData;
-    tdcData.addr.crate = roc_id;
+    PRAD_PROFILE_SCOPE("EvioParser::parseTDCV1190");
 
-    for(uint32_t i = 0; i < size; ++i)
-    {
-        // word type
-        switch(data[i]>>27)
-        {
-        case V1190_GLOBAL_HEADER:
-            if(roc_id == PRadTS) {
-                // geo address not supported in this crate
-                tdcData.addr.slot = 0;
-            } else {
-                tdcData.addr.slot = data[i]&0x1f;
-            }
-            break;
-        case V1190_TDC_MEASURE:
-            tdcData.addr.channel = (data[i]>>19)&0x7f;
-            tdcData.val = (data[i]&0x7ffff);
-            myHandler->FeedData(tdcData);
-            break;
-        case V1190_TDC_ERROR:
-/*
-            cerr << "V1190 Error Word: "
-                 << "0x" << hex << setw(8) << setfill('0') << data[i]
-                 << endl;
-            break;
-*/
-        case V1190_GLOBAL_TRAILER:
-        case V1190_FILLER_WORD:
-        default:
-            break;
-        }
-    }
+    // the words are classified and fed to handler in one pass
+    myHandler->FeedTDCV1190Bank(roc_id, data, size, *builder);
 }
 
 // parse JLab distriminator data
@@ -512,14 +1518,14 @@ void PRadEvioParser::parseDSCData(const uint32_t *data, const uint32_t &size)
     dscData.gated_buf = &data[GATED_TRG_GROUP];
     dscData.ungated_buf = &data[UNGATED_TRG_GROUP];
 
-    myHandler->FeedData(dscData);
+    myHandler->FeedData(dscData, *builder);
 }
 
 // parse JLab TI data
 void PRadEvioParser::parseTIData(const uint32_t *data, const uint32_t &size, const int &roc_id)
 {
     // update trigger type
-    myHandler->UpdateTrgType(bit_to_trigger(data[2]>>24));
+    myHandler->UpdateTrgType(bit_to_trigger(data[2]>>24), *builder);
 
     if(roc_id == PRadTS) {// we will be more interested in the TI-master
         // check block header first
@@ -540,17 +1546,19 @@ void PRadEvioParser::parseTIData(const uint32_t *data, const uint32_t &size, con
         tiData.time_high = data[5] & 0xffff;
         tiData.latch_word = data[6] & 0xff;
         tiData.lms_phase = (data[8] >> 16) & 0xff;
-        myHandler->FeedData(tiData);
+        myHandler->FeedData(tiData, *builder);
     }
 }
 
 // parse EPICS data (in textual format
 void PRadEvioParser::parseEPICS(const uint32_t *data)
 {
+    PRAD_PROFILE_SCOPE("EvioParser::parseEPICS");
+
     EPICSRawData epics_data;
     epics_data.buf = (const char*) data;
 
-    myHandler->FeedData(epics_data);
+    myHandler->FeedData(epics_data, *builder);
 }
 
 
@@ -580,3 +1588,71 @@ unsigned int PRadEvioParser::trigger_to_bit(const PRadTriggerType &trg)
         return 1 << (int) trg;
 }
 
+// path of the block index sidecar file
+string PRadEvioParser::index_path(const string &filepath)
+{
+    return filepath + INDEX_SUFFIX;
+}
+
+// get the event number from the event info bank without decoding the event
+// return 0 if it is not a physics event or has no event info bank
+uint32_t PRadEvioParser::peek_event_number(const PRadEventHeader *header)
+{
+    if(header->tag != CODA_Event && header->tag != CODA_Sync)
+        return 0;
+
+    const uint32_t buf_size = header->length - 1;
+    const uint32_t *buf = (const uint32_t*) &header[1];
+    uint32_t index = 0;
+
+    while(index < buf_size)
+    {
+        const PRadEventHeader *roc_header = (const PRadEventHeader*) &buf[index];
+        if(roc_header->tag == EVINFO_BANK)
+            return (index + 2 < buf_size) ? buf[index + 2] : 0;
+        index += roc_header->length + 1;
+    }
+
+    return 0;
+}
+
+// get the trigger type from the first TI bank without decoding the event
+// return NotFromTI if there is no TI bank
+PRadTriggerType PRadEvioParser::peek_trigger(const PRadEventHeader *header)
+{
+    const uint32_t buf_size = header->length - 1;
+    const uint32_t *buf = (const uint32_t*) &header[1];
+    uint32_t index = 0;
+
+    while(index < buf_size)
+    {
+        const PRadEventHeader *roc_header = (const PRadEventHeader*) &buf[index];
+        index += roc_header->length + 1;
+
+        // TI banks are in these crates
+        switch(roc_header->tag)
+        {
+        case PRadTS:
+        case PRadTagE:
+        case PRadROC_1:
+        case PRadROC_2:
+        case PRadROC_3:
+            break;
+        default:
+            continue;
+        }
+
+        const uint32_t roc_size = roc_header->length - 1;
+        const uint32_t *roc_buf = (const uint32_t*) &roc_header[1];
+        uint32_t roc_index = 0;
+        while(roc_index < roc_size)
+        {
+            const PRadEventHeader *bank_header = (const PRadEventHeader*) &roc_buf[roc_index];
+            if(bank_header->tag == TI_BANK && bank_header->length >= 4)
+                return bit_to_trigger(roc_buf[roc_index + 4]>>24);
+            roc_index += bank_header->length + 1;
+        }
+    }
+
+    return NotFromTI;
+}
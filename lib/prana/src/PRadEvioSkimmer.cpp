@@ -0,0 +1,250 @@
+//============================================================================//
+// Skim the raw evio files, the selected events are copied without decoding,  //
+// and packed into new blocks, so the raw GEM samples are kept in the output  //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadEvioSkimmer.h"
+#include "PRadEvioParser.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+// the fields of evio block header (version 4)
+#define BLOCK_LENGTH 0
+#define BLOCK_NUMBER 1
+#define BLOCK_HEADER_LENGTH 2
+#define BLOCK_EVENT_COUNT 3
+#define BLOCK_VERSION 5
+#define BLOCK_MAGIC 7
+#define LAST_BLOCK_BIT (1 << 9)
+#define EVIO_MAGIC 0xc0da0100
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadEvioSkimmer::PRadEvioSkimmer()
+: trigger_mask(0), max_events(0), keep_control(true), block_words(SKIM_BLOCK_WORDS),
+  has_tmpl(false), block_number(1), block_events(0), copied(0),
+  input_bytes(0), output_bytes(0), skipped_events(0)
+{
+    // place holder
+}
+
+PRadEvioSkimmer::~PRadEvioSkimmer()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+void PRadEvioSkimmer::AcceptTrigger(const PRadTriggerType &trg)
+{
+    trigger_mask |= PRadEvioParser::trigger_to_bit(trg);
+}
+
+int PRadEvioSkimmer::Skim(const std::string &input, const std::string &output)
+{
+    return Skim(std::vector<std::string>{input}, output);
+}
+
+int PRadEvioSkimmer::Skim(const std::vector<std::string> &inputs, const std::string &output)
+{
+    if(!out.Open(output)) {
+        std::cerr << "PRad Evio Skimmer Error: Cannot open output file "
+                  << "\"" << output << "\"" << std::endl;
+        return -1;
+    }
+
+    has_tmpl = false;
+    block_number = 1;
+    block_events = 0;
+    copied = 0;
+    input_bytes = output_bytes = skipped_events = 0;
+    out_block.clear();
+
+    for(auto &input : inputs)
+    {
+        if(!copyFile(input))
+            break;
+    }
+
+    // the last block is marked, it is only a header if no events are left
+    flushBlock(true);
+
+    if(!out.Close()) {
+        std::cerr << "PRad Evio Skimmer Error: Failed to write output file "
+                  << "\"" << output << "\"" << std::endl;
+        return -1;
+    }
+
+    return copied;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// copy the selected events of a file, return false if it reaches the maximum
+// number of events
+bool PRadEvioSkimmer::copyFile(const std::string &path)
+{
+    if(!in.Open(path)) {
+        std::cerr << "PRad Evio Skimmer Error: Cannot open evio file "
+                  << "\"" << path << "\", skipped it." << std::endl;
+        return true;
+    }
+
+    const size_t word = sizeof(uint32_t);
+    uint32_t block_size;
+    while(in.Read(&block_size, word) == word)
+    {
+        if(block_size < SKIM_HEADER_WORDS) {
+            std::cerr << "PRad Evio Skimmer Error: Invalid block size " << block_size
+                      << " in " << path << ", skipped the rest of file." << std::endl;
+            break;
+        }
+
+        if(in_block.size() < block_size)
+            in_block.resize(block_size);
+        in_block[0] = block_size;
+        if(in.Read(&in_block[1], word*(block_size - 1)) != word*(block_size - 1)) {
+            std::cerr << "PRad Evio Skimmer Error: Incomplete block in " << path
+                      << ", skipped the rest of file." << std::endl;
+            break;
+        }
+        input_bytes += block_size*word;
+
+        // the output headers follow the first input block
+        if(!has_tmpl) {
+            memcpy(header_tmpl, in_block.data(), sizeof(header_tmpl));
+            has_tmpl = true;
+        }
+
+        // walk through the event headers of the block
+        uint32_t index = in_block[BLOCK_HEADER_LENGTH];
+        if(index < SKIM_HEADER_WORDS || index > block_size)
+            index = SKIM_HEADER_WORDS;
+        while(index < block_size)
+        {
+            const PRadEventHeader *header = (const PRadEventHeader*) &in_block[index];
+            uint32_t size = header->length + 1;
+            if(index + size > block_size) {
+                std::cerr << "PRad Evio Skimmer Error: Event exceeds its block in "
+                          << path << ", skipped the rest of block." << std::endl;
+                break;
+            }
+
+            if(accept(header)) {
+                append(&in_block[index], size);
+                if(header->tag == CODA_Event && ++copied == max_events) {
+                    in.Close();
+                    return false;
+                }
+            } else {
+                skipped_events++;
+            }
+            index += size;
+        }
+    }
+
+    in.Close();
+    return true;
+}
+
+bool PRadEvioSkimmer::accept(const PRadEventHeader *header)
+const
+{
+    switch(header->tag)
+    {
+    case CODA_Event:
+        break;
+    // scalers
+    case CODA_Sync:
+        return true;
+    case CODA_Prestart:
+    case CODA_Go:
+    case CODA_End:
+    case EPICS_Info:
+        return keep_control;
+    default:
+        return false;
+    }
+
+    if(trigger_mask) {
+        PRadTriggerType trg = PRadEvioParser::peek_trigger(header);
+        if((trg != NotFromTI) && !(trigger_mask & PRadEvioParser::trigger_to_bit(trg)))
+            return false;
+    }
+
+    if(ranges.empty())
+        return true;
+
+    uint32_t ev = PRadEvioParser::peek_event_number(header);
+    for(auto &range : ranges)
+    {
+        if(ev >= range.first && ev <= range.second)
+            return true;
+    }
+    return false;
+}
+
+// pack the event into the current block
+void PRadEvioSkimmer::append(const uint32_t *event, uint32_t size)
+{
+    if(!out_block.empty() && SKIM_HEADER_WORDS + out_block.size() + size > block_words)
+        flushBlock(false);
+
+    out_block.insert(out_block.end(), event, event + size);
+    block_events++;
+}
+
+// write the block with the rewritten header
+void PRadEvioSkimmer::flushBlock(bool last)
+{
+    if(out_block.empty() && !last)
+        return;
+
+    uint32_t header[SKIM_HEADER_WORDS];
+    if(has_tmpl) {
+        memcpy(header, header_tmpl, sizeof(header));
+    } else {
+        memset(header, 0, sizeof(header));
+        header[BLOCK_VERSION] = 4;
+        header[BLOCK_MAGIC] = EVIO_MAGIC;
+    }
+
+    uint32_t version = header[BLOCK_VERSION]&0xff;
+    header[BLOCK_LENGTH] = SKIM_HEADER_WORDS + out_block.size();
+    header[BLOCK_NUMBER] = block_number++;
+    header[BLOCK_HEADER_LENGTH] = SKIM_HEADER_WORDS;
+    if(version >= 4) {
+        header[BLOCK_EVENT_COUNT] = block_events;
+        if(last)
+            header[BLOCK_VERSION] |= LAST_BLOCK_BIT;
+        else
+            header[BLOCK_VERSION] &= ~LAST_BLOCK_BIT;
+    } else {
+        // the start of the first event and the used words in version 3
+        header[BLOCK_EVENT_COUNT] = SKIM_HEADER_WORDS;
+        header[BLOCK_EVENT_COUNT + 1] = header[BLOCK_LENGTH];
+    }
+
+    out.Write(header, sizeof(header));
+    out.Write(out_block.data(), out_block.size()*sizeof(uint32_t));
+    output_bytes += header[BLOCK_LENGTH]*sizeof(uint32_t);
+
+    out_block.clear();
+    block_events = 0;
+}
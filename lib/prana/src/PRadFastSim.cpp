@@ -0,0 +1,472 @@
+//============================================================================//
+// Fast parametric simulation of the HyCal and GEM responses                  //
+// The generated particles are converted to the raw adc values and gem strip  //
+// hits with the resolutions, cluster profiles and calibration constants, so  //
+// large dst files can be produced for testing the reconstruction             //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadFastSim.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadDSTParser.h"
+#include "PRadBenchMark.h"
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#ifdef MULTI_THREAD
+#include <thread>
+#endif
+#include "canalib.h"
+
+typedef cana::rand_gen<double, cana::philox4x32> stream_rng;
+
+// call func(i) for i from 0 to n - 1 by several threads
+template<class Func>
+inline void parallel_for(size_t n, unsigned int nthreads, Func func)
+{
+    std::atomic<size_t> next(0);
+    auto work = [&] ()
+                {
+                    size_t i;
+                    while((i = next++) < n)
+                        func(i);
+                };
+
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, n));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(work);
+    work();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    (void) nthreads;
+    work();
+#endif
+}
+
+// standard normal number by the Box-Muller method
+inline double gauss(stream_rng &rng)
+{
+    double u1 = 1. - rng(), u2 = rng();
+    return std::sqrt(-2.*std::log(u1))*std::cos(cana::pi*2.*u2);
+}
+
+// shape of the apv time samples, normalized to 1 at the second sample
+inline float sample_shape(uint32_t i)
+{
+    float t = 0.5*(i + 1);
+    return t*std::exp(1. - t);
+}
+
+// buffers of a simulation task
+struct PRadFastSim::Scratch
+{
+    stream_rng rng;
+    // deposited energy by module index, and the modules with energy
+    std::vector<float> energy;
+    std::vector<int> touched;
+    // modules visited by the current shower
+    std::vector<uint32_t> stamp;
+    uint32_t shower;
+    std::vector<const PRadHyCalModule*> mods;
+    std::vector<float> dist, frac;
+
+    Scratch(size_t nmods)
+    : rng(cana::philox4x32()), energy(nmods, 0.), stamp(nmods, 0), shower(0)
+    {}
+};
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadFastSim::PRadFastSim(PRadHyCalSystem *h, PRadGEMSystem *g, PRadCoordSystem *c)
+: hycal(h), gem(g), coord(c), nthreads(0), seed(1), trigger(PHYS_TotalSum),
+  min_energy(10.), non_linear(true), sparsify(true),
+  gem_eff(0.95), gem_charge(1500.), gem_charge_sig(500.), gem_spread(0.3),
+  gem_thres(50.), prepared(false), sparsifier(nullptr), profile(nullptr)
+{
+    ptypes[0] = Charged;
+    ptypes[1] = Charged;
+    ptypes[2] = Neutral;
+}
+
+PRadFastSim::~PRadFastSim()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+void PRadFastSim::SetParticleType(int i, ParticleType t)
+{
+    if(i < 0 || i >= GEN_EVENT_PARTICLES) {
+        std::cerr << "PRad Fast Sim Error: Particle " << i << " is out of the "
+                  << GEN_EVENT_PARTICLES << " particles of a generator event."
+                  << std::endl;
+        return;
+    }
+    ptypes[i] = t;
+}
+
+bool PRadFastSim::Prepare()
+{
+    prepared = false;
+    if(!hycal || !hycal->GetDetector()) {
+        std::cerr << "PRad Fast Sim Error: HyCal system or its detector is not set, "
+                  << "cannot simulate events." << std::endl;
+        return false;
+    }
+
+    // hycal, the calibration and pedestals of the current run
+    calib = hycal->TakeCalibSnapshot();
+    sparsifier = hycal->GetSparsifier().GetSize() ? &hycal->GetSparsifier() : nullptr;
+    profile = hycal->GetReconstructor()->GetProfile();
+
+    auto &modules = hycal->GetDetector()->GetModuleList();
+    mod_channel.assign(modules.size(), -1);
+    for(auto module : modules)
+    {
+        int idx = module->GetIndex();
+        if(idx >= 0 && idx < (int)modules.size() && module->GetChannel())
+            mod_channel[idx] = module->GetChannel()->GetID();
+    }
+
+    // positions of the detector planes
+    if(coord) {
+        run_coord = coord->GetCurrentCoords();
+    } else {
+        run_coord = RunCoord();
+        run_coord.dets[(int)PRadDetector::HyCal].trans.z = PRadCoordSystem::hycal_z();
+    }
+
+    // gems, plane strips to the apv channels
+    gem_layouts.clear();
+    if(gem && coord) {
+        for(auto det : gem->GetDetectorList())
+        {
+            GEMLayout layout;
+            layout.det_id = det->GetDetID();
+            for(auto plane : det->GetPlaneList())
+            {
+                int type = (int)plane->GetType();
+                if(type < 0 || type >= 2)
+                    continue;
+
+                StripMap &smap = layout.planes[type];
+                smap.pos0 = plane->GetStripPosition(0);
+                smap.pitch = plane->GetStripPosition(1) - smap.pos0;
+                for(auto apv : plane->GetAPVList())
+                {
+                    smap.time_samples = std::max(smap.time_samples, apv->GetNTimeSamples());
+                    for(uint32_t ch = 0; ch < APV_CHANNEL_SIZE; ++ch)
+                    {
+                        int strip = apv->GetPlaneStripNb(ch);
+                        if(strip < 0)
+                            continue;
+                        if((size_t)strip >= smap.strips.size()) {
+                            smap.strips.resize(strip + 1);
+                            smap.valid.resize(strip + 1, 0);
+                        }
+                        smap.strips[strip] = GEMChannelAddress(apv->GetFECID(), apv->GetADCChannel(), ch);
+                        smap.valid[strip] = 1;
+                    }
+                }
+            }
+            gem_layouts.emplace_back(std::move(layout));
+        }
+    }
+
+    prepared = true;
+    return true;
+}
+
+void PRadFastSim::Simulate(const PRadGenEventFile::Event *gen, size_t n, EventData *out,
+                           uint64_t first)
+{
+    if(!prepared && !Prepare())
+        return;
+
+    size_t ntasks = (n + FASTSIM_TASK_EVENTS - 1)/FASTSIM_TASK_EVENTS;
+    size_t nmods = mod_channel.size();
+
+    parallel_for(ntasks, nthreads,
+                 [&] (size_t i)
+                 {
+                     Scratch scr(nmods);
+                     size_t beg = i*FASTSIM_TASK_EVENTS;
+                     size_t end = std::min(n, beg + FASTSIM_TASK_EVENTS);
+                     for(size_t j = beg; j < end; ++j)
+                         simEvent(gen[j], first + j, out[j], scr);
+                 });
+}
+
+int64_t PRadFastSim::Simulate(const std::string &gen_path, const std::string &dst_path,
+                              int64_t max_events, bool verbose)
+{
+    if(!prepared && !Prepare())
+        return -1;
+
+    PRadGenEventFile input;
+    if(!input.Open(gen_path))
+        return -1;
+
+    PRadDSTParser dst;
+    dst.SetAsyncOutput(true);
+    dst.OpenOutput(dst_path);
+
+    PRadBenchMark timer;
+    std::vector<PRadGenEventFile::Event> gen;
+    std::vector<EventData> events(FASTSIM_BLOCK);
+    int64_t count = 0;
+
+    try {
+        while(max_events <= 0 || count < max_events)
+        {
+            size_t nread = FASTSIM_BLOCK;
+            if(max_events > 0)
+                nread = std::min<int64_t>(nread, max_events - count);
+            if(!input.Read(gen, nread))
+                break;
+
+            Simulate(gen.data(), gen.size(), events.data(), count);
+            for(size_t i = 0; i < gen.size(); ++i)
+                dst.Write(events[i]);
+            count += gen.size();
+
+            if(verbose) {
+                double sec = timer.GetElapsedTime()/1000.;
+                std::cout << "Simulated " << count << " events, "
+                          << ((sec > 0.) ? count/sec : 0.) << " ev/s\r"
+                          << std::flush;
+            }
+        }
+    } catch(PRadException &e) {
+        std::cerr << e.FailureType() << ": " << e.FailureDesc() << std::endl;
+        dst.CloseOutput();
+        return -1;
+    }
+
+    dst.CloseOutput();
+
+    if(verbose) {
+        std::cout << "Simulated " << count << " events in " << timer.GetElapsedTime()/1000.
+                  << " s, saved in file \"" << dst_path << "\"." << std::endl;
+    }
+    return count;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+void PRadFastSim::simEvent(const PRadGenEventFile::Event &gen, uint64_t index,
+                           EventData &event, Scratch &scr)
+const
+{
+    scr.rng = stream_rng(cana::philox4x32(seed, index));
+
+    event.clear();
+    event.event_number = index + 1;
+    event.type = CODA_Event;
+    event.trigger = trigger;
+
+    for(int i = 0; i < GEN_EVENT_PARTICLES; ++i)
+    {
+        const auto &part = gen.part[i];
+        if(ptypes[i] == Ignored || part.p <= 0.)
+            continue;
+
+        float x, y;
+        if(project((int)PRadDetector::HyCal, part, x, y))
+            simShower(x, y, part.p, scr);
+
+        if(ptypes[i] != Charged)
+            continue;
+
+        for(auto &layout : gem_layouts)
+        {
+            if(scr.rng() >= gem_eff || !project(layout.det_id, part, x, y))
+                continue;
+            float charge = gem_charge + gem_charge_sig*gauss(scr.rng);
+            if(charge <= 0.)
+                continue;
+            simStrips(layout.planes[0], x, charge, event);
+            simStrips(layout.planes[1], y, charge, event);
+        }
+    }
+
+    // deposited energies to adc values, with the pedestal noise
+    for(auto idx : scr.touched)
+    {
+        float energy = scr.energy[idx];
+        scr.energy[idx] = 0.;
+
+        int ch = mod_channel[idx];
+        double factor = calib->GetCalibFactor(idx);
+        if(ch < 0 || (size_t)ch >= calib->GetChannelCount() || calib->IsDead(ch) || factor <= 0.)
+            continue;
+
+        double adc = calib->GetPedestalMean(ch) + energy/factor
+                     + calib->GetPedestalSigma(ch)*gauss(scr.rng);
+        adc = std::min<double>(std::max(adc, 0.), FASTSIM_ADC_MAX);
+        event.adc_data.emplace_back((uint16_t) ch, (uint16_t) std::lround(adc));
+    }
+    scr.touched.clear();
+
+    // zero suppression the same as the daq
+    if(sparsify && sparsifier) {
+        size_t np = sparsifier->Apply(event.adc_data.data(), event.adc_data.size(),
+                                      event.adc_data.data());
+        event.adc_data.resize(np);
+    }
+}
+
+// share the shower energy to the modules around the center
+void PRadFastSim::simShower(float x, float y, double energy, Scratch &scr)
+const
+{
+    const PRadHyCalDetector *det = hycal->GetDetector();
+    const PRadHyCalModule *center = det->GetModule(x, y);
+    if(!center)
+        return;
+
+    // detector resolutions
+    energy += det->GetEneRes(center, energy)*gauss(scr.rng);
+    if(energy < min_energy)
+        return;
+    double pos_res = det->GetPosRes(center, energy);
+    x += pos_res*gauss(scr.rng);
+    y += pos_res*gauss(scr.rng);
+
+    int sid = det->GetSectorID(x, y);
+    int type = det->GetSectorInfo().at(sid).mtype;
+
+    // modules within two layers of neighbors
+    if(!++scr.shower)
+        std::fill(scr.stamp.begin(), scr.stamp.end(), 0), scr.shower = 1;
+    scr.mods.clear();
+    scr.dist.clear();
+    auto visit = [&] (const PRadHyCalModule *m)
+                 {
+                     int idx = m->GetIndex();
+                     if(idx < 0 || (size_t)idx >= scr.stamp.size() || scr.stamp[idx] == scr.shower)
+                         return;
+                     scr.stamp[idx] = scr.shower;
+                     float dist = det->QuantizedDist(x, y, sid, m->GetX(), m->GetY(), m->GetSectorID());
+                     if(dist <= FASTSIM_SHOWER_DIST) {
+                         scr.mods.push_back(m);
+                         scr.dist.push_back(dist);
+                     }
+                 };
+
+    visit(center);
+    for(auto &nb : center->GetNeighbors())
+    {
+        visit(nb.ptr);
+        for(auto &nb2 : nb->GetNeighbors())
+            visit(nb2.ptr);
+    }
+
+    scr.frac.resize(scr.mods.size());
+    profile->GetBatch(type, scr.dist.data(), energy, scr.frac.data(), nullptr, scr.mods.size());
+
+    // the reconstruction divides the energy by 1 + alpha(E)
+    double scale = 1.;
+    if(non_linear)
+        scale += calib->NonLinearCorr(center->GetIndex(), energy);
+
+    for(size_t i = 0; i < scr.mods.size(); ++i)
+    {
+        float e = scr.frac[i]*energy*scale;
+        if(e <= 0.)
+            continue;
+        int idx = scr.mods[i]->GetIndex();
+        if(scr.energy[idx] == 0.)
+            scr.touched.push_back(idx);
+        scr.energy[idx] += e;
+    }
+}
+
+// gaussian charge on the strips of a plane
+void PRadFastSim::simStrips(const StripMap &plane, float pos, float charge, EventData &event)
+const
+{
+    if(plane.strips.empty())
+        return;
+
+    // position and spread in strips
+    float center = (pos - plane.pos0)/plane.pitch;
+    float sigma = gem_spread/std::abs(plane.pitch);
+    int first, last;
+    if(sigma < 1e-3) {
+        first = last = std::lround(center);
+    } else {
+        first = std::ceil(center - FASTSIM_STRIP_SIGMAS*sigma - 0.5);
+        last = std::floor(center + FASTSIM_STRIP_SIGMAS*sigma + 0.5);
+    }
+
+    first = std::max(first, 0);
+    last = std::min(last, (int)plane.strips.size() - 1);
+    for(int s = first; s <= last; ++s)
+    {
+        if(!plane.valid[s])
+            continue;
+
+        float frac = 1.;
+        if(sigma >= 1e-3) {
+            float norm = 1./(sigma*std::sqrt(2.));
+            frac = 0.5*(std::erf((s + 0.5 - center)*norm) - std::erf((s - 0.5 - center)*norm));
+        }
+
+        float q = charge*frac;
+        if(q < gem_thres)
+            continue;
+
+        const auto &addr = plane.strips[s];
+        GEM_Data hit(addr.fec, addr.adc, addr.strip);
+        for(uint32_t i = 0; i < plane.time_samples; ++i)
+            hit.add_value(q*sample_shape(i));
+        event.gem_data.emplace_back(hit);
+    }
+}
+
+// project the particle from the target to the detector plane, the position is
+// in the detector frame
+bool PRadFastSim::project(int det_id, const PRadGenEventFile::Particle &part,
+                          float &x, float &y)
+const
+{
+    float dz = std::cos(part.theta);
+    if(dz <= 0.)
+        return false;
+
+    Point target = PRadCoordSystem::target();
+    float z = run_coord.dets[det_id].trans.z;
+    float l = (z - target.z)/dz;
+    float st = std::sin(part.theta);
+    // the generators give the azimuthal angle by atan2(px, py)
+    x = target.x + l*st*std::sin(part.phi);
+    y = target.y + l*st*std::cos(part.phi);
+
+    if(coord)
+        coord->InvTransform(det_id, x, y, z);
+    return true;
+}
@@ -8,15 +8,69 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <tuple>
 #include "PRadGEMFEC.h"
 #include "PRadGEMPlane.h"
 #include "PRadGEMAPV.h"
+#include "PRadProfiler.h"
+#include "PRadGEMKernels.h"
+#ifndef PRAD_NO_ROOT
 #include "TF1.h"
 #include "TH1.h"
+#endif
 
 
 // macro to get the data index
 #define DATA_INDEX(ch, ts) (ts_begin + ch + ts*TIME_SAMPLE_DIFF)
+// macro to get the strip major data index
+#define STRIP_INDEX(ch, ts) (ch*strip_stride + ts)
+
+// mapping the channel to local and plane strip number
+// special is for the X plane APV at index 11, reversed is for the APV that has
+// an orientation different from the plane
+static PRadGEMAPV::StripNb map_strip(int ch, bool special, bool reversed, int plane_index)
+{
+    PRadGEMAPV::StripNb result;
+
+    // calculate local strip mapping
+    // APV25 Internal Channel Mapping
+    int strip = 32*(ch%4) + 8*(ch/4) - 31*(ch/16);
+
+    // APV25 Channel to readout strip Mapping
+    if(special) {
+        if(strip & 1)
+            strip = 48 - (strip + 1)/2;
+        else
+            strip = 48 + strip/2;
+    } else {
+        if(strip & 1)
+            strip = 32 - (strip + 1)/2;
+        else
+            strip = 32 + strip/2;
+    }
+
+    strip &= 0x7f;
+    result.local = strip;
+
+    // calculate plane strip mapping
+    // reverse strip number by orient
+    if(reversed)
+        strip = 127 - strip;
+
+    // special APV
+    if(special) {
+        strip += -16 + APV_CHANNEL_SIZE * (plane_index - 1);
+    } else {
+        strip += APV_CHANNEL_SIZE * plane_index;
+    }
+
+    result.plane = strip;
+
+    return result;
+}
 
 //============================================================================//
 // constructor, assigment operator, destructor                                //
@@ -31,12 +85,16 @@ PRadGEMAPV::PRadGEMAPV(const int &o,
                        const float &zth,
                        const float &ctth)
 : orient(o), header_level(hl),
-  common_thres(cth), zerosup_thres(zth), crosstalk_thres(ctth)
+  common_thres(cth), zerosup_thres(zth), crosstalk_thres(ctth), ped_clip(5.),
+  ped_track(0.), common_method(CM_Mean), common_trim(GEM_CM_TRIM)
 {
     // initialize
     initialize();
 
     raw_data = nullptr;
+    strip_data = nullptr;
+    // default mapping before connected to a plane
+    strip_map = StripTable(false, false, 0);
     SetTimeSample(t);
 
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
@@ -65,6 +123,9 @@ void PRadGEMAPV::initialize()
     // these can only be assigned by a Plane (SetDetectorPlane)
     plane = nullptr;
     plane_index = -1;
+
+    // kernel arrays are rebuilt from the copied members
+    kernel_update = true;
 }
 
 // The copy and move constructor/assignment operator won't copy or replace the
@@ -74,40 +135,48 @@ PRadGEMAPV::PRadGEMAPV(const PRadGEMAPV &that)
 : time_samples(that.time_samples), orient(that.orient),
   header_level(that.header_level), split(that.split),
   common_thres(that.common_thres), zerosup_thres(that.zerosup_thres),
-  crosstalk_thres(that.crosstalk_thres)
+  crosstalk_thres(that.crosstalk_thres), ped_stats(that.ped_stats),
+  ped_clip(that.ped_clip), ped_track(that.ped_track), common_method(that.common_method),
+  common_trim(that.common_trim)
 {
     initialize();
+    strip_map = that.strip_map;
 
     // raw data related
     buffer_size = that.buffer_size;
     ts_begin = that.ts_begin;
     // dangerous part, may fail due to lack of memory
     raw_data = new float[buffer_size];
+    strip_stride = that.strip_stride;
+    strip_data = new float[APV_CHANNEL_SIZE*strip_stride];
     // copy values
     for(uint32_t i = 0; i < buffer_size; ++i)
     {
         raw_data[i] = that.raw_data[i];
     }
+    for(uint32_t i = 0; i < APV_CHANNEL_SIZE*strip_stride; ++i)
+    {
+        strip_data[i] = that.strip_data[i];
+    }
+
+    std::copy(that.hit_mask, that.hit_mask + APV_CHANNEL_SIZE/32, hit_mask);
 
     // copy other arrays
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
         pedestal[i] = that.pedestal[i];
-        strip_map[i] = that.strip_map[i];
         hit_pos[i] = that.hit_pos[i];
 
+        offset_hist[i] = nullptr;
+        noise_hist[i] = nullptr;
+#ifndef PRAD_NO_ROOT
         // dangerous part, may fail due to lack of memory
-        if(that.offset_hist[i] != nullptr) {
+        if(that.offset_hist[i] != nullptr)
             offset_hist[i] = new TH1I(*that.offset_hist[i]);
-        } else {
-            offset_hist[i] = nullptr;
-        }
 
-        if(that.noise_hist[i] != nullptr) {
+        if(that.noise_hist[i] != nullptr)
             noise_hist[i] = new TH1I(*that.noise_hist[i]);
-        } else {
-            noise_hist[i] = nullptr;
-        }
+#endif
     }
 }
 
@@ -116,24 +185,32 @@ PRadGEMAPV::PRadGEMAPV(PRadGEMAPV &&that)
 : time_samples(that.time_samples), orient(that.orient),
   header_level(that.header_level), split(that.split),
   common_thres(that.common_thres), zerosup_thres(that.zerosup_thres),
-  crosstalk_thres(that.crosstalk_thres)
+  crosstalk_thres(that.crosstalk_thres), ped_stats(that.ped_stats),
+  ped_clip(that.ped_clip), ped_track(that.ped_track), common_method(that.common_method),
+  common_trim(that.common_trim)
 {
     initialize();
+    strip_map = that.strip_map;
 
     // raw_data related
     buffer_size = that.buffer_size;
     ts_begin = that.ts_begin;
     raw_data = that.raw_data;
+    strip_stride = that.strip_stride;
+    strip_data = that.strip_data;
     // null the pointer of that
     that.buffer_size = 0;
     that.raw_data = nullptr;
+    that.strip_stride = 0;
+    that.strip_data = nullptr;
+
+    std::copy(that.hit_mask, that.hit_mask + APV_CHANNEL_SIZE/32, hit_mask);
 
     // other arrays
     // static array, so no need to move, just copy elements
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
         pedestal[i] = that.pedestal[i];
-        strip_map[i] = that.strip_map[i];
         hit_pos[i] = that.hit_pos[i];
 
         // these need to be moved
@@ -152,6 +229,7 @@ PRadGEMAPV::~PRadGEMAPV()
     ReleasePedHist();
 
     delete[] raw_data;
+    delete[] strip_data;
 }
 
 // copy assignment operator
@@ -174,6 +252,7 @@ PRadGEMAPV &PRadGEMAPV::operator= (PRadGEMAPV &&rhs)
     // release memory
     ReleasePedHist();
     delete[] raw_data;
+    delete[] strip_data;
 
     // members
     time_samples = rhs.time_samples;
@@ -183,21 +262,33 @@ PRadGEMAPV &PRadGEMAPV::operator= (PRadGEMAPV &&rhs)
     common_thres = rhs.common_thres;
     zerosup_thres = rhs.zerosup_thres;
     crosstalk_thres = rhs.crosstalk_thres;
+    ped_stats = rhs.ped_stats;
+    ped_clip = rhs.ped_clip;
+    ped_track = rhs.ped_track;
+    common_method = rhs.common_method;
+    common_trim = rhs.common_trim;
+    strip_map = rhs.strip_map;
+    kernel_update = true;
 
     // raw_data related
     buffer_size = rhs.buffer_size;
     ts_begin = rhs.ts_begin;
     raw_data = rhs.raw_data;
+    strip_stride = rhs.strip_stride;
+    strip_data = rhs.strip_data;
     // null the pointer of that
     rhs.buffer_size = 0;
     rhs.raw_data = nullptr;
+    rhs.strip_stride = 0;
+    rhs.strip_data = nullptr;
+
+    std::copy(rhs.hit_mask, rhs.hit_mask + APV_CHANNEL_SIZE/32, hit_mask);
 
     // other arrays
     // static array, so no need to move, just copy elements
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
         pedestal[i] = rhs.pedestal[i];
-        strip_map[i] = rhs.strip_map[i];
         hit_pos[i] = rhs.hit_pos[i];
 
         // these need to be moved
@@ -276,9 +367,10 @@ void PRadGEMAPV::UnsetDetectorPlane(bool force_unset)
     plane_index = -1;
 }
 
-// create histograms
+// create histograms, the pedestals are only from the statistics without ROOT
 void PRadGEMAPV::CreatePedHist()
 {
+#ifndef PRAD_NO_ROOT
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
         if(offset_hist[i] == nullptr) {
@@ -294,10 +386,14 @@ void PRadGEMAPV::CreatePedHist()
             noise_hist[i] = new TH1I(name.c_str(), "Noise", 400, -200, 200);
         }
     }
+#endif
 }
 
 void PRadGEMAPV::ResetPedHist()
 {
+    ped_stats.Reset();
+
+#ifndef PRAD_NO_ROOT
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
         if(offset_hist[i])
@@ -305,28 +401,54 @@ void PRadGEMAPV::ResetPedHist()
         if(noise_hist[i])
             noise_hist[i]->Reset();
     }
+#endif
 }
 
 // release the memory for histograms
 void PRadGEMAPV::ReleasePedHist()
 {
+#ifndef PRAD_NO_ROOT
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
         delete offset_hist[i], offset_hist[i] = nullptr;
         delete noise_hist[i], noise_hist[i] = nullptr;
     }
+#endif
+}
+
+// the median and trimmed mean use all the channels of a group
+void PRadGEMAPV::SetCommonModeMethod(int m, float trim)
+{
+    if(m < 0 || m >= Max_CommonModeMethods) {
+        std::cerr << "GEM APV Warning: Unknown common mode method " << m
+                  << ", use the mean instead." << std::endl;
+        m = CM_Mean;
+    }
+
+    common_method = m;
+    common_trim = std::max(0.f, std::min(0.5f, trim));
 }
 
 // set time samples and reserve memory for raw data
 void PRadGEMAPV::SetTimeSample(const uint32_t &t)
 {
+    if(t > GEM_MAX_TIME_SAMPLES) {
+        std::cerr << "GEM APV Warning: " << t << " time samples exceed the "
+                  << "maximum " << GEM_MAX_TIME_SAMPLES << " of a zero "
+                  << "suppressed hit, the extra samples will be discarded."
+                  << std::endl;
+    }
+
     time_samples = t;
     buffer_size = t*TIME_SAMPLE_DIFF + APV_EXTEND_SIZE;
+    strip_stride = (t + STRIP_DATA_PAD - 1)/STRIP_DATA_PAD*STRIP_DATA_PAD;
 
     // reallocate the memory for proper size
     delete[] raw_data;
+    delete[] strip_data;
 
     raw_data = new float[buffer_size];
+    strip_data = new float[APV_CHANNEL_SIZE*strip_stride];
 
     ClearData();
 }
@@ -337,6 +459,8 @@ void PRadGEMAPV::ClearData()
     // set to a high value that won't trigger zero suppression
     for(uint32_t i = 0; i < buffer_size; ++i)
         raw_data[i] = 5000.;
+    for(uint32_t i = 0; i < APV_CHANNEL_SIZE*strip_stride; ++i)
+        strip_data[i] = 5000.;
 
     ResetHitPos();
 }
@@ -346,6 +470,8 @@ void PRadGEMAPV::ResetHitPos()
 {
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
         hit_pos[i] = false;
+    for(auto &bits : hit_mask)
+        bits = 0;
 }
 
 // clear all the pedestal
@@ -353,6 +479,7 @@ void PRadGEMAPV::ClearPedestal()
 {
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
         pedestal[i] = Pedestal(0, 0);
+    kernel_update = true;
 }
 
 // update pedestal
@@ -360,6 +487,7 @@ void PRadGEMAPV::UpdatePedestal(std::vector<Pedestal> &ped)
 {
     for(uint32_t i = 0; (i < ped.size()) && (i < APV_CHANNEL_SIZE); ++i)
         pedestal[i] = ped[i];
+    kernel_update = true;
 }
 
 // update single channel pedestal
@@ -369,6 +497,7 @@ void PRadGEMAPV::UpdatePedestal(const Pedestal &ped, const uint32_t &index)
         return;
 
     pedestal[index] = ped;
+    kernel_update = true;
 }
 
 // update single channel pedestal
@@ -379,25 +508,7 @@ void PRadGEMAPV::UpdatePedestal(const float &offset, const float &noise, const u
 
     pedestal[index].offset = offset;
     pedestal[index].noise = noise;
-}
-
-// split data word to adc values. Note that the endianness is changed
-inline void split_data(const uint32_t &data, float &val1, float &val2)
-{
-    union
-    {
-        uint8_t bytes[4];
-        uint16_t vals[2];
-    } word;
-
-    const uint8_t *dbyte = (const uint8_t*) &data;
-    for(int i = 0; i < 4; ++i)
-    {
-        word.bytes[i] = dbyte[3 - i];
-    }
-
-    val1 = static_cast<float>(word.vals[0]);
-    val2 = static_cast<float>(word.vals[1]);
+    kernel_update = true;
 }
 
 // fill raw data
@@ -411,10 +522,7 @@ void PRadGEMAPV::FillRawData(const uint32_t *buf, const uint32_t &size)
     }
 
     // split 1 32-bit word into 2 16-bit ADC values/
-    for(uint32_t i = 0; i < size; ++i)
-    {
-        split_data(buf[i], raw_data[2*i], raw_data[2*i+1]);
-    }
+    PRadGEMKernels::UnpackRaw(buf, size, raw_data);
 
     ts_begin = getTimeSampleStart();
 }
@@ -436,39 +544,51 @@ void PRadGEMAPV::FillZeroSupData(const uint32_t &ch, const uint32_t &ts, const u
     }
 
     hit_pos[ch] = true;
+    hit_mask[ch/32] |= (1u << (ch%32));
     raw_data[idx] = val;
+    strip_data[STRIP_INDEX(ch, ts)] = val;
 }
 
 // fill zero suppressed data
 void PRadGEMAPV::FillZeroSupData(const uint32_t &ch, const std::vector<float> &vals)
+{
+    FillZeroSupData(ch, vals.data(), vals.size());
+}
+
+// fill zero suppressed data from an array of time samples
+void PRadGEMAPV::FillZeroSupData(const uint32_t &ch, const float *vals, const uint32_t &size)
 {
     ts_begin = 0;
 
-    if(vals.size() != time_samples || ch >= APV_CHANNEL_SIZE)
+    if(size != time_samples || ch >= APV_CHANNEL_SIZE)
     {
         std::cerr << "GEM APV Error: Failed to fill zero suppressed data, "
-                  << " channel " << ch << " or time sample " << vals.size()
+                  << " channel " << ch << " or time sample " << size
                   << " is not allowed."
                   << std::endl;
         return;
     }
 
     hit_pos[ch] = true;
+    hit_mask[ch/32] |= (1u << (ch%32));
 
-    for(uint32_t i = 0; i < vals.size(); ++i)
+    for(uint32_t i = 0; i < size; ++i)
     {
         uint32_t idx = DATA_INDEX(ch, i);
         raw_data[idx] = vals[i];
+        strip_data[STRIP_INDEX(ch, i)] = vals[i];
     }
 
 }
 
-// fill pedestal histogram
+// fill pedestal statistics, and the histograms if they are created
 void PRadGEMAPV::FillPedHist()
 {
-    float average[2][3];
+    // the extra time samples are not used
+    uint32_t nts = std::min<uint32_t>(time_samples, GEM_MAX_TIME_SAMPLES);
+    float average[2][GEM_MAX_TIME_SAMPLES];
 
-    for(uint32_t i = 0; i < time_samples; ++i)
+    for(uint32_t i = 0; i < nts; ++i)
     {
         if(split) {
             getAverage(average[0][i], &raw_data[DATA_INDEX(0, i)], 1);
@@ -482,7 +602,7 @@ void PRadGEMAPV::FillPedHist()
     {
         float ch_average = 0.;
         float noise_average = 0.;
-        for(uint32_t j = 0; j < time_samples; ++j)
+        for(uint32_t j = 0; j < nts; ++j)
         {
             ch_average += raw_data[DATA_INDEX(i, j)];
             if(split) {
@@ -495,23 +615,42 @@ void PRadGEMAPV::FillPedHist()
             }
         }
 
+        ch_average /= nts;
+        noise_average /= nts;
+        ped_stats.Add(i, ch_average, noise_average, ped_clip);
+
+#ifndef PRAD_NO_ROOT
         if(offset_hist[i])
-            offset_hist[i]->Fill(ch_average/time_samples);
+            offset_hist[i]->Fill(ch_average);
 
         if(noise_hist[i])
-            noise_hist[i]->Fill(noise_average/time_samples);
+            noise_hist[i]->Fill(noise_average);
+#endif
     }
 }
 
-// fit pedestal histogram
-void PRadGEMAPV::FitPedestal()
+// update pedestal from the statistics or the histogram fits
+void PRadGEMAPV::FitPedestal(bool root_fit)
 {
+#ifdef PRAD_NO_ROOT
+    root_fit = false;
+#endif
+
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
+        if(!root_fit) {
+            if(ped_stats.count[i] < GEM_PED_MIN_ENTRIES)
+                continue;
+
+            UpdatePedestal((float)ped_stats.GetOffset(i), (float)ped_stats.GetNoise(i), i);
+            continue;
+        }
+
+#ifndef PRAD_NO_ROOT
         if( (offset_hist[i] == nullptr) ||
             (noise_hist[i] == nullptr) ||
-            (offset_hist[i]->Integral() < 1000) ||
-            (noise_hist[i]->Integral() < 1000) )
+            (offset_hist[i]->Integral() < GEM_PED_MIN_ENTRIES) ||
+            (noise_hist[i]->Integral() < GEM_PED_MIN_ENTRIES) )
             continue;
 
         offset_hist[i]->Fit("gaus", "qww");
@@ -521,12 +660,15 @@ void PRadGEMAPV::FitPedestal()
         myfit = (TF1*) noise_hist[i]->GetFunction("gaus");
         double p1 = myfit->GetParameter(2);
         UpdatePedestal((float)p0, (float)p1, i);
+#endif
     }
 }
 
 // do zero suppression in raw data space
 void PRadGEMAPV::ZeroSuppression()
 {
+    PRAD_PROFILE_SCOPE("GEM::ZeroSuppression");
+
     if(plane == nullptr)
     {
         std::cerr << "GEM APV Error: APV "
@@ -546,29 +688,39 @@ void PRadGEMAPV::ZeroSuppression()
         return;
     }
 
+    if(kernel_update)
+        updateKernelArrays();
+
     // common mode correction
-    for(uint32_t ts = 0; ts < time_samples; ++ts)
-    {
-        if(split)
-            CommonModeCorrection_Split(&raw_data[DATA_INDEX(0, ts)], APV_CHANNEL_SIZE);
-        else
-            CommonModeCorrection(&raw_data[DATA_INDEX(0, ts)], APV_CHANNEL_SIZE);
+    if(common_method == CM_Mean) {
+        for(uint32_t ts = 0; ts < time_samples; ++ts)
+        {
+            PRadGEMKernels::CommonMode(&raw_data[DATA_INDEX(0, ts)], cm_offset, cm_thres,
+                                       cm_group, APV_CHANNEL_SIZE);
+        }
+    } else {
+        float trim = sortedTrim();
+        for(uint32_t ts = 0; ts < time_samples; ++ts)
+        {
+            PRadGEMKernels::SortedCommonMode(&raw_data[DATA_INDEX(0, ts)], cm_offset,
+                                             cm_group, APV_CHANNEL_SIZE, trim);
+        }
     }
 
+    // the hits are read from the strip major data
+    transposeData();
+
+    // zero suppression, fired channels are returned in bits
+    PRadGEMKernels::ZeroSup(&raw_data[DATA_INDEX(0, 0)], TIME_SAMPLE_DIFF, time_samples,
+                            zs_thres, APV_CHANNEL_SIZE, hit_mask);
+
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
-        float average = 0.;
-        for(uint32_t j = 0; j < time_samples; ++j)
-        {
-            average += raw_data[DATA_INDEX(i, j)];
-        }
-        average /= time_samples;
-
-        if(average > pedestal[i].noise * zerosup_thres)
-            hit_pos[i] = true;
-        else
-            hit_pos[i] = false;
+        hit_pos[i] = (hit_mask[i/32] >> (i%32)) & 1;
     }
+
+    if(ped_track > 0.)
+        trackPedestal();
 }
 
 // collect zero suppressed hit in raw data space, need a container input
@@ -580,36 +732,85 @@ void PRadGEMAPV::CollectZeroSupHits(std::vector<GEM_Data> &hits)
             continue;
 
         GEM_Data hit(fec_id, adc_ch, i);
+        const float *strip = &strip_data[STRIP_INDEX(i, 0)];
         for(uint32_t j = 0; j < time_samples; ++j)
         {
-            hit.values.emplace_back(raw_data[DATA_INDEX(i, j)]);
+            hit.add_value(strip[j]);
         }
         hits.emplace_back(hit);
     }
 }
 
 // collect zero suppressed hit in raw data space, directly to connected Plane
+// the hits are found from the bit mask, and the max charge of every hit is
+// computed once for its charge and the cross talk flags of its neighbors,
+// the results are the same as GetMaxCharge and IsCrossTalkStrip
 void PRadGEMAPV::CollectZeroSupHits()
 {
     if(plane == nullptr)
         return;
 
-    for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
+    // max charges with a zero on both ends for the neighbors
+    float max_charge[APV_CHANNEL_SIZE + 2];
+    max_charge[0] = max_charge[APV_CHANNEL_SIZE + 1] = 0.;
+    for(uint32_t w = 0; w < APV_CHANNEL_SIZE/32; ++w)
     {
-        if(!hit_pos[i])
-            continue;
+        uint32_t bits = hit_mask[w];
+        for(uint32_t i = w*32; i < (w + 1)*32; ++i)
+            max_charge[i + 1] = 0.;
 
-        plane->AddStripHit(strip_map[i].plane,
-                           GetMaxCharge(i),
-                           IsCrossTalkStrip(i),
-                           fec_id,
-                           adc_ch);
+        while(bits)
+        {
+            uint32_t i = w*32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+
+            float val = 0.;
+            const float *strip = &strip_data[STRIP_INDEX(i, 0)];
+            for(uint32_t j = 0; j < time_samples; ++j)
+                val = (val < strip[j]) ? strip[j] : val;
+            max_charge[i + 1] = val;
+        }
+    }
+
+    for(uint32_t w = 0; w < APV_CHANNEL_SIZE/32; ++w)
+    {
+        uint32_t bits = hit_mask[w];
+        while(bits)
+        {
+            uint32_t i = w*32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+
+            float charge = max_charge[i + 1], thres = charge*crosstalk_thres;
+            bool xtalk = (thres < max_charge[i]) || (thres < max_charge[i + 2]);
+            plane->AddStripHit(strip_map[i].plane, charge, xtalk, fec_id, adc_ch);
+        }
     }
 }
 
+// number of the zero suppressed hits
+uint32_t PRadGEMAPV::GetHitCount()
+const
+{
+    uint32_t count = 0;
+    for(auto bits : hit_mask)
+        count += __builtin_popcount(bits);
+    return count;
+}
+
 // do common mode correction (bring the signal average to 0)
+// ZeroSuppression uses the same correction from PRadGEMKernels
 void PRadGEMAPV::CommonModeCorrection(float *buf, const uint32_t &size)
 {
+    if(common_method != CM_Mean) {
+        int32_t group[APV_CHANNEL_SIZE] = {0};
+        float offset[APV_CHANNEL_SIZE];
+        uint32_t n = std::min(size, (uint32_t)APV_CHANNEL_SIZE);
+        for(uint32_t i = 0; i < n; ++i)
+            offset[i] = pedestal[i].offset;
+        PRadGEMKernels::SortedCommonMode(buf, offset, group, n, sortedTrim());
+        return;
+    }
+
     int count = 0;
     float average = 0;
 
@@ -635,6 +836,19 @@ void PRadGEMAPV::CommonModeCorrection(float *buf, const uint32_t &size)
 // do common mode correction for split APV
 void PRadGEMAPV::CommonModeCorrection_Split(float *buf, const uint32_t &size)
 {
+    if(common_method != CM_Mean) {
+        int32_t group[APV_CHANNEL_SIZE];
+        float offset[APV_CHANNEL_SIZE];
+        uint32_t n = std::min(size, (uint32_t)APV_CHANNEL_SIZE);
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            offset[i] = pedestal[i].offset;
+            group[i] = (strip_map[i].local < 16) ? -1 : 0;
+        }
+        PRadGEMKernels::SortedCommonMode(buf, offset, group, n, sortedTrim());
+        return;
+    }
+
     int count1 = 0, count2 = 0;
     float average1 = 0, average2 = 0;
 
@@ -703,43 +917,33 @@ const
 // mapping the channel to strip number
 PRadGEMAPV::StripNb PRadGEMAPV::MapStrip(int ch)
 {
-    StripNb result;
-
-    // calculate local strip mapping
-    // APV25 Internal Channel Mapping
-    int strip = 32*(ch%4) + 8*(ch/4) - 31*(ch/16);
-
-    // APV25 Channel to readout strip Mapping
-    if((plane->GetType() == PRadGEMPlane::Plane_X) && (plane_index == 11)) {
-        if(strip & 1)
-            strip = 48 - (strip + 1)/2;
-        else
-            strip = 48 + strip/2;
-    } else {
-        if(strip & 1)
-            strip = 32 - (strip + 1)/2;
-        else
-            strip = 32 + strip/2;
-    }
-
-    strip &= 0x7f;
-    result.local = strip;
-
-    // calculate plane strip mapping
+    // special APV
+    bool special = (plane->GetType() == PRadGEMPlane::Plane_X) && (plane_index == 11);
     // reverse strip number by orient
-    if(orient != plane->GetOrientation())
-        strip = 127 - strip;
+    bool reversed = (orient != plane->GetOrientation());
 
-    // special APV
-    if((plane->GetType() == PRadGEMPlane::Plane_X) && (plane_index == 11)) {
-        strip += -16 + APV_CHANNEL_SIZE * (plane_index - 1);
-    } else {
-        strip += APV_CHANNEL_SIZE * plane_index;
-    }
+    return map_strip(ch, special, reversed, plane_index);
+}
 
-    result.plane = strip;
+// get the shared table, the tables are kept in a map so their addresses are
+// stable
+const PRadGEMAPV::StripNb *PRadGEMAPV::StripTable(bool special, bool reversed, int plane_index)
+{
+    typedef std::array<StripNb, APV_CHANNEL_SIZE> Table;
+    static std::map<std::tuple<bool, bool, int>, Table> tables;
+    static std::mutex tables_locker;
+
+    std::lock_guard<std::mutex> lock(tables_locker);
+    auto key = std::make_tuple(special, reversed, plane_index);
+    auto it = tables.find(key);
+    if(it == tables.end()) {
+        Table table;
+        for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
+            table[i] = map_strip(i, special, reversed, plane_index);
+        it = tables.emplace(key, table).first;
+    }
 
-    return result;
+    return it->second.data();
 }
 
 // print the pedestal information to ofstream
@@ -776,6 +980,26 @@ const
     return hist_list;
 }
 
+// buffers of the time samples and the pedestal histograms
+MemoryUsage PRadGEMAPV::GetMemoryUsage()
+const
+{
+    MemoryUsage res;
+    if(raw_data)
+        res.Add(raw_data, buffer_size*sizeof(float));
+    if(strip_data)
+        res.Add(strip_data, APV_CHANNEL_SIZE*strip_stride*sizeof(float));
+
+#ifndef PRAD_NO_ROOT
+    for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
+    {
+        res.Add(offset_hist[i]);
+        res.Add(noise_hist[i]);
+    }
+#endif
+    return res;
+}
+
 // pack all pedestal info into a vector and return
 std::vector<PRadGEMAPV::Pedestal> PRadGEMAPV::GetPedestalList()
 const
@@ -797,9 +1021,10 @@ const
         return 0.;
 
     float val = 0.;
+    const float *strip = &strip_data[STRIP_INDEX(ch, 0)];
     for(uint32_t j = 0; j < time_samples; ++j)
     {
-        float this_val = raw_data[DATA_INDEX(ch, j)];
+        float this_val = strip[j];
         if(val < this_val)
             val = this_val;
     }
@@ -815,9 +1040,10 @@ const
         return 0.;
 
     float val = 0.;
+    const float *strip = &strip_data[STRIP_INDEX(ch, 0)];
     for(uint32_t j = 0; j < time_samples; ++j)
     {
-        val += raw_data[DATA_INDEX(ch, j)];
+        val += strip[j];
     }
 
     return val;
@@ -831,9 +1057,10 @@ const
         return 0.;
 
     float val = 0.;
+    const float *strip = &strip_data[STRIP_INDEX(ch, 0)];
     for(uint32_t j = 0; j < time_samples; ++j)
     {
-        val += raw_data[DATA_INDEX(ch, j)];
+        val += strip[j];
     }
 
     return val/time_samples;
@@ -904,13 +1131,114 @@ void PRadGEMAPV::getAverage(float &average, const float *buf, const uint32_t &se
 // both local strip map and plane strip map are related to the connected plane
 // thus this function will only be called when the APV is connected to the plane
 void PRadGEMAPV::buildStripMap()
+{
+    bool special = (plane->GetType() == PRadGEMPlane::Plane_X) && (plane_index == 11);
+    bool reversed = (orient != plane->GetOrientation());
+    strip_map = StripTable(special, reversed, plane_index);
+    kernel_update = true;
+}
+
+// copy the time sample rows of the raw data to the strip major data
+void PRadGEMAPV::transposeData()
+{
+    for(uint32_t ts = 0; ts < time_samples; ++ts)
+    {
+        const float *row = &raw_data[DATA_INDEX(0, ts)];
+        for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
+        {
+            strip_data[STRIP_INDEX(i, ts)] = row[i];
+        }
+    }
+}
+
+// update the pedestal by the strips without hits, the corrected values are
+// offset - raw - common mode, so their average is the offset drift, and their
+// variance is the squared noise
+// the values beyond the zero suppression threshold are not used, for both signs
+void PRadGEMAPV::trackPedestal()
 {
     for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
     {
-        strip_map[i] = MapStrip(i);
+        if(hit_pos[i])
+            continue;
+
+        const float *strip = &strip_data[STRIP_INDEX(i, 0)];
+        float val = 0.;
+        for(uint32_t j = 0; j < time_samples; ++j)
+        {
+            val += strip[j];
+        }
+        val /= time_samples;
+
+        auto &ped = pedestal[i];
+        if(std::abs(val) > ped.noise*zerosup_thres)
+            continue;
+
+        ped.offset -= ped_track*val;
+        ped.noise = std::sqrt((1. - ped_track)*ped.noise*ped.noise + ped_track*val*val);
     }
+
+    kernel_update = true;
+}
+
+// update the kernel arrays, the thresholds of the first 16 strips of a split
+// apv are 10 times higher and they have their own common mode
+void PRadGEMAPV::updateKernelArrays()
+{
+    for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
+    {
+        bool low = split && (strip_map[i].local < 16);
+        cm_offset[i] = pedestal[i].offset;
+        cm_thres[i] = low ? pedestal[i].noise*common_thres*10. : pedestal[i].noise*common_thres;
+        cm_group[i] = low ? -1 : 0;
+        zs_thres[i] = pedestal[i].noise*zerosup_thres;
+    }
+    kernel_update = false;
 }
 
+//============================================================================//
+// Pedestal Statistics                                                        //
+//============================================================================//
+
+void PRadGEMAPV::PedestalStats::Reset()
+{
+    for(uint32_t i = 0; i < APV_CHANNEL_SIZE; ++i)
+    {
+        count[i] = 0;
+        offset_mean[i] = 0.;
+        offset_m2[i] = 0.;
+        noise_mean[i] = 0.;
+        noise_m2[i] = 0.;
+    }
+}
+
+// Welford's update of the running mean and variance
+void PRadGEMAPV::PedestalStats::Add(uint32_t ch, double offset, double noise, double clip)
+{
+    uint32_t n = count[ch];
+
+    // robust clipping, reject signals and bad samples
+    if(clip > 0. && n >= GEM_PED_CLIP_START) {
+        double offset_sig = std::sqrt(offset_m2[ch]/(n - 1));
+        double noise_sig = std::sqrt(noise_m2[ch]/(n - 1));
+        if((std::abs(offset - offset_mean[ch]) > clip*offset_sig) ||
+           (std::abs(noise - noise_mean[ch]) > clip*noise_sig))
+            return;
+    }
+
+    count[ch] = ++n;
+
+    double delta = offset - offset_mean[ch];
+    offset_mean[ch] += delta/n;
+    offset_m2[ch] += delta*(offset - offset_mean[ch]);
+
+    delta = noise - noise_mean[ch];
+    noise_mean[ch] += delta/n;
+    noise_m2[ch] += delta*(noise - noise_mean[ch]);
+}
+
+
+
 //============================================================================//
 // Non-Class-Member Functions                                                 //
 //============================================================================//
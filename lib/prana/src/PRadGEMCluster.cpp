@@ -15,10 +15,10 @@
 #include <algorithm>
 #include <cmath>
 #include <vector>
-#include <deque>
 #include <cmath>
 #include "PRadGEMCluster.h"
 #include "PRadGEMDetector.h"
+#include "PRadReconCache.h"
 
 // constructor
 PRadGEMCluster::PRadGEMCluster(const std::string &config_path)
@@ -48,6 +48,8 @@ void PRadGEMCluster::Configure(const std::string &path)
     CONF_CONN(split_cluster_diff, "Split Threshold", 14, verbose);
     CONF_CONN(cross_talk_width, "Cross Talk Width", 2, verbose);
     CONF_CONN(consecutive_thres, "Consecutive Threshold", 1, verbose);
+    CONF_CONN(charge_ratio_window, "Charge Ratio Window", 0, verbose);
+    CONF_CONN(charge_ratio_center, "Charge Ratio Center", 1, verbose);
 
     // get cross talk characteristic distance
     charac_dists.clear();
@@ -55,16 +57,41 @@ void PRadGEMCluster::Configure(const std::string &path)
     charac_dists = ConfigParser::stofs(dist_str, ",", " \t");
 }
 
+// the parameters are hashed one by one
+uint64_t PRadGEMCluster::SettingHash()
+const
+{
+    unsigned int counts[] = {min_cluster_hits, max_cluster_hits, consecutive_thres};
+    float values[] = {split_cluster_diff, cross_talk_width,
+                      charge_ratio_window, charge_ratio_center};
+
+    uint64_t h = recon_hash(counts, sizeof(counts));
+    h = recon_hash(values, sizeof(values), h);
+    return recon_hash(charac_dists.data(), charac_dists.size()*sizeof(float), h);
+}
+
 // group hits into clusters
 void PRadGEMCluster::FormClusters(std::vector<StripHit> &hits,
                                   std::vector<StripCluster> &clusters)
 const
 {
+    StripClusterContext ctx;
+
     // clean container first
     clusters.clear();
 
+    FormClusters(hits, clusters, ctx);
+}
+
+// group hits into clusters with the scratch buffers
+void PRadGEMCluster::FormClusters(std::vector<StripHit> &hits,
+                                  std::vector<StripCluster> &clusters,
+                                  StripClusterContext &ctx)
+const
+{
     // group consecutive hits as the preliminary clusters
-    groupHits(hits, clusters);
+    // the clusters from last event are overwritten
+    clusters.resize(groupHits(hits, clusters, ctx));
 
     // reconstruct the cluster position
     for(auto &cluster : clusters)
@@ -73,16 +100,33 @@ const
     }
 
     // set cross talk flag
-    setCrossTalk(clusters);
+    setCrossTalk(clusters, ctx);
+}
+
+// a helper function to add a cluster, it reuses the clusters in the container
+// so their hit vectors keep the memory
+template<class Iter>
+inline void add_cluster(Iter beg, Iter end, std::vector<StripCluster> &clusters, size_t &n)
+{
+    if(n == clusters.size())
+        clusters.emplace_back();
+
+    auto &cluster = clusters[n++];
+    cluster.position = 0.;
+    cluster.peak_charge = 0.;
+    cluster.total_charge = 0.;
+    cluster.cross_talk = false;
+    cluster.hits.assign(beg, end);
 }
 
 // a helper function to further separate hits at minimum
 template<class Iter>
-void split_cluster(Iter beg, Iter end, double thres, std::vector<StripCluster> &clusters)
+void split_cluster(Iter beg, Iter end, double thres, std::vector<StripCluster> &clusters,
+                   size_t &n)
 {
     auto size = end - beg;
     if(size < 3) {
-        clusters.emplace_back(std::vector<StripHit>(beg, end));
+        add_cluster(beg, end, clusters, n);
         return;
     }
 
@@ -116,25 +160,26 @@ void split_cluster(Iter beg, Iter end, double thres, std::vector<StripCluster> &
         minimum->charge /= 2.;
 
         // new split cluster
-        clusters.emplace_back(std::vector<StripHit>(beg, minimum));
+        add_cluster(beg, minimum, clusters, n);
 
         // check the leftover strips
-        split_cluster(minimum, end, thres, clusters);
+        split_cluster(minimum, end, thres, clusters, n);
     } else {
-        clusters.emplace_back(std::vector<StripHit>(beg, end));
+        add_cluster(beg, end, clusters, n);
     }
 }
 
 // cluster consecutive hits
 template<class Iter>
-inline void cluster_hits(Iter beg, Iter end, int con_thres, double diff_thres, std::vector<StripCluster> &clusters)
+inline void cluster_hits(Iter beg, Iter end, int con_thres, double diff_thres,
+                         std::vector<StripCluster> &clusters, size_t &n)
 {
     auto cbeg = beg;
     for(auto it = beg; it != end; ++it)
     {
         auto it_n = it + 1;
         if((it_n == end) || (it_n->strip - it->strip > con_thres)) {
-            split_cluster(cbeg, it_n, diff_thres, clusters);
+            split_cluster(cbeg, it_n, diff_thres, clusters, n);
             cbeg = it_n;
         }
     }
@@ -160,32 +205,63 @@ inline bool is_duplicated_strip(Iter it)
     return false;
 }
 
-template<class Iter, template<class, class> class Container>
+template<class Iter>
 inline void separate_duplicates(Iter beg, Iter end,
-                                Container<StripHit, std::allocator<StripHit>> &dup1,
-                                Container<StripHit, std::allocator<StripHit>> &dup2)
+                                std::vector<StripHit> &dup1,
+                                std::vector<StripHit> &dup2)
 {
     for(auto it = beg; it != end; ++it)
     {
         if(IS_FROM_APV_SET1(*it))
-            dup1.emplace_back(*it);
+            dup1.push_back(*it);
         else
-            dup2.emplace_back(*it);
+            dup2.push_back(*it);
     }
 }
 
-// group consecutive hits
-void PRadGEMCluster::groupHits(std::vector<StripHit> &hits,
-                               std::vector<StripCluster> &clusters)
+// stable counting sort of the hits by strip number, the strip numbers are
+// bounded by the plane capacity
+inline void sort_strips(std::vector<StripHit> &hits, StripClusterContext &ctx)
+{
+    int max_strip = 0;
+    for(auto &hit : hits)
+    {
+        // not a strip of plane, should not happen
+        if(hit.strip < 0) {
+            std::stable_sort(hits.begin(), hits.end(),
+                             [](const StripHit &h1, const StripHit &h2)
+                             {
+                                 return h1.strip < h2.strip;
+                             });
+            return;
+        }
+        max_strip = std::max(max_strip, hit.strip);
+    }
+
+    ctx.counts.assign(max_strip + 2, 0);
+    for(auto &hit : hits)
+        ctx.counts[hit.strip + 1]++;
+    for(int i = 1; i <= max_strip; ++i)
+        ctx.counts[i + 1] += ctx.counts[i];
+
+    ctx.sorted.resize(hits.size());
+    for(auto &hit : hits)
+        ctx.sorted[ctx.counts[hit.strip]++] = hit;
+
+    // both vectors keep their memory
+    hits.swap(ctx.sorted);
+}
+
+// group consecutive hits, returns the number of clusters in the container
+size_t PRadGEMCluster::groupHits(std::vector<StripHit> &hits,
+                                 std::vector<StripCluster> &clusters,
+                                 StripClusterContext &ctx)
 const
 {
+    size_t n = 0;
+
     // sort the hits by its strip number
-    std::sort(hits.begin(), hits.end(),
-              // lamda expr, compare hit by their strip numbers
-              [](const StripHit &h1, const StripHit &h2)
-              {
-                  return h1.strip < h2.strip;
-              });
+    sort_strips(hits, ctx);
 
     // for X-plane, we have strips at the same x-position (same strip number),
     // but they are segmented due to the central hole, this needs special treatment
@@ -193,59 +269,73 @@ const
     auto normal_end = hits.begin();
     // find the end of the normal group
     while((normal_end != hits.end()) && !is_duplicated_strip(normal_end)) {normal_end ++;}
-    // separate the duplicated strips into two groups (upper and lower)
-    std::deque<StripHit> dup1, dup2;
-    separate_duplicates(normal_end, hits.end(), dup1, dup2);
+    // the first hits of the duplicated groups (upper and lower)
+    auto first1 = hits.end(), first2 = hits.end();
+    for(auto it = normal_end; it != hits.end(); ++it)
+    {
+        if(IS_FROM_APV_SET1(*it)) {
+            if(first1 == hits.end())
+                first1 = it;
+        } else if(first2 == hits.end()) {
+            first2 = it;
+        }
+    }
 
     // no need the special treatment
-    if(dup1.empty() || dup2.empty()) {
-        cluster_hits(hits.begin(), hits.end(), consecutive_thres, split_cluster_diff, clusters);
-    // no normal hits
-    } else if(normal_end == hits.begin()) {
-        cluster_hits(dup1.begin(), dup1.end(), consecutive_thres, split_cluster_diff, clusters);
-        cluster_hits(dup2.begin(), dup2.end(), consecutive_thres, split_cluster_diff, clusters);
-    } else {
+    if(first1 == hits.end() || first2 == hits.end()) {
+        cluster_hits(hits.begin(), hits.end(), consecutive_thres, split_cluster_diff, clusters, n);
+        return n;
+    }
+
+    auto &dup1 = ctx.dup1, &dup2 = ctx.dup2;
+    dup1.clear();
+    dup2.clear();
+
+    // the last normal cluster is merged to the front of the duplicates groups
+    if(normal_end != hits.begin()) {
         // group normal first
-        cluster_hits(hits.begin(), normal_end, consecutive_thres, split_cluster_diff, clusters);
+        cluster_hits(hits.begin(), normal_end, consecutive_thres, split_cluster_diff, clusters, n);
         // check if the last hit is consecutive to the duplicated groups
         auto lastn = normal_end - 1;
-        bool neighbor1 = (dup1.begin()->strip - lastn->strip > (int)consecutive_thres);
-        bool neighbor2 = (dup2.begin()->strip - lastn->strip > (int)consecutive_thres);
+        bool neighbor1 = (first1->strip - lastn->strip > (int)consecutive_thres);
+        bool neighbor2 = (first2->strip - lastn->strip > (int)consecutive_thres);
         // last hits
-        auto &last_hits = clusters.back().hits;
+        auto &last_hits = clusters[n - 1].hits;
         // share last hits
         if(neighbor1 & neighbor2) {
             // determine share by the closest hit charge
-            double factor1 = 1./(dup2.begin()->charge/dup1.begin()->charge + 1.);
-            for(auto it = last_hits.rbegin(); it != last_hits.rend(); ++it)
+            double factor1 = 1./(first2->charge/first1->charge + 1.);
+            for(auto &hit : last_hits)
             {
-                auto share_hit = *it;
-                share_hit.charge *= factor1;
-                dup1.emplace_front(share_hit);
+                dup1.push_back(hit);
+                dup1.back().charge *= factor1;
             }
             double factor2 = 1. - factor1;
-            for(auto it = last_hits.rbegin(); it != last_hits.rend(); ++it)
+            for(auto &hit : last_hits)
             {
-                auto share_hit = *it;
-                share_hit.charge *= factor2;
-                dup2.emplace_front(share_hit);
+                dup2.push_back(hit);
+                dup2.back().charge *= factor2;
             }
         // merge to dup1
         } else if (neighbor1) {
-            dup1.insert(dup1.begin(), last_hits.begin(), last_hits.end());
+            dup1.insert(dup1.end(), last_hits.begin(), last_hits.end());
         // merge to dup2
         } else if(neighbor2) {
-            dup2.insert(dup2.begin(), last_hits.begin(), last_hits.end());
+            dup2.insert(dup2.end(), last_hits.begin(), last_hits.end());
         }
 
         // discard last cluster, since it is merged into duplicates groups
         if(neighbor1 | neighbor2)
-            clusters.pop_back();
-
-        // cluster the duplicates groups
-        cluster_hits(dup1.begin(), dup1.end(), consecutive_thres, split_cluster_diff, clusters);
-        cluster_hits(dup2.begin(), dup2.end(), consecutive_thres, split_cluster_diff, clusters);
+            --n;
     }
+
+    // separate the duplicated strips into two groups
+    separate_duplicates(normal_end, hits.end(), dup1, dup2);
+
+    // cluster the duplicates groups
+    cluster_hits(dup1.begin(), dup1.end(), consecutive_thres, split_cluster_diff, clusters, n);
+    cluster_hits(dup2.begin(), dup2.end(), consecutive_thres, split_cluster_diff, clusters, n);
+    return n;
 }
 
 // helper function to check cross talk strips
@@ -285,6 +375,93 @@ inline bool ct_distance(SCit it, SCit end, float width, const std::vector<float>
 
 void PRadGEMCluster::setCrossTalk(std::vector<StripCluster> &clusters)
 const
+{
+    StripClusterContext ctx;
+    setCrossTalk(clusters, ctx);
+}
+
+// a cross talk cluster should have a cluster with higher peak charge at one of
+// the characteristic distances, the clusters are also sorted by positions, so
+// only the windows [pos +- dist +- width] are checked by binary search, and the
+// highest peak order in a window is from a sparse table
+void PRadGEMCluster::setCrossTalk(std::vector<StripCluster> &clusters, StripClusterContext &ctx)
+const
+{
+    size_t n = clusters.size();
+    if(n < CROSS_TALK_WINDOW_MIN) {
+        setCrossTalkDirect(clusters);
+        return;
+    }
+
+    // sort by peak charge
+    std::sort(clusters.begin(), clusters.end(),
+              [](const StripCluster &c1, const StripCluster &c2)
+              {
+                  return c1.peak_charge < c2.peak_charge;
+              });
+
+    // positions with the peak order
+    auto &pos = ctx.ct_pos;
+    pos.resize(n);
+    for(size_t i = 0; i < n; ++i)
+        pos[i] = std::make_pair(clusters[i].position, static_cast<uint32_t>(i));
+    std::sort(pos.begin(), pos.end());
+
+    // table[l*n + i] is the highest order in [i, i + 2^l)
+    size_t levels = 1;
+    while((size_t(1) << levels) <= n)
+        ++levels;
+    auto &table = ctx.ct_table;
+    table.resize(levels*n);
+    for(size_t i = 0; i < n; ++i)
+        table[i] = pos[i].second;
+    for(size_t l = 1; l < levels; ++l)
+    {
+        size_t half = size_t(1) << (l - 1);
+        for(size_t i = 0; i + (half << 1) <= n; ++i)
+            table[l*n + i] = std::max(table[(l - 1)*n + i], table[(l - 1)*n + i + half]);
+    }
+
+    // if any cluster with a higher order is in (lo, hi)
+    auto higher_in = [&] (float lo, float hi, uint32_t order)
+                     {
+                         auto beg = std::upper_bound(pos.begin(), pos.end(), lo,
+                                                     [] (float v, const std::pair<float, uint32_t> &p)
+                                                     {return v < p.first;});
+                         auto end = std::lower_bound(beg, pos.end(), hi,
+                                                     [] (const std::pair<float, uint32_t> &p, float v)
+                                                     {return p.first < v;});
+                         if(beg >= end)
+                             return false;
+                         size_t i = beg - pos.begin(), j = end - pos.begin(), l = 0;
+                         while((size_t(2) << l) <= j - i)
+                             ++l;
+                         uint32_t m = std::max(table[l*n + i], table[l*n + j - (size_t(1) << l)]);
+                         return m > order;
+                     };
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        auto &cl = clusters[i];
+        // only remove cross talk clusters that is a composite of cross talk strips
+        if(!is_pure_ct(cl))
+            continue;
+
+        for(auto &dist : charac_dists)
+        {
+            float p = cl.position;
+            if(higher_in(p - dist - cross_talk_width, p - dist + cross_talk_width, i) ||
+               higher_in(p + dist - cross_talk_width, p + dist + cross_talk_width, i)) {
+                cl.cross_talk = true;
+                break;
+            }
+        }
+    }
+}
+
+// compare with all the clusters of higher peak charge
+void PRadGEMCluster::setCrossTalkDirect(std::vector<StripCluster> &clusters)
+const
 {
     // sort by peak charge
     std::sort(clusters.begin(), clusters.end(),
@@ -355,23 +532,60 @@ const
     // empty first
     container.clear();
 
-    // TODO, probably add some criteria here to filter out some bad clusters
-    // fill possible clusters in
+    auto add_hit = [&] (const StripCluster &xc, const StripCluster &yc)
+                   {
+                       container.emplace_back(xc.position, yc.position, 0.,        // by default z = 0
+                                              det_id,                              // detector id
+                                              xc.total_charge, yc.total_charge,    // fill in total charge
+                                              xc.peak_charge, yc.peak_charge,      // fill in peak charge
+                                              xc.hits.size(), yc.hits.size(),      // number of hits
+                                              res);                                // position resolution
+                   };
+
+    // fill all possible combinations
+    if(charge_ratio_window <= 1.) {
+        for(auto &xc : x_cluster)
+        {
+            if(!IsGoodCluster(xc))
+                continue;
+            for(auto &yc : y_cluster)
+            {
+                if(!IsGoodCluster(yc))
+                    continue;
+                add_hit(xc, yc);
+            }
+        }
+        return;
+    }
+
+    // charge correlation, y clusters are sorted by the total charge, and each x
+    // cluster only looks for the y clusters in its charge window
+    std::vector<const StripCluster*> y_sorted;
+    y_sorted.reserve(y_cluster.size());
+    for(auto &yc : y_cluster)
+    {
+        if(IsGoodCluster(yc))
+            y_sorted.push_back(&yc);
+    }
+    std::sort(y_sorted.begin(), y_sorted.end(),
+              [](const StripCluster *c1, const StripCluster *c2)
+              {
+                  return c1->total_charge < c2->total_charge;
+              });
+
     for(auto &xc : x_cluster)
     {
         if(!IsGoodCluster(xc))
             continue;
-        for(auto &yc : y_cluster)
-        {
-            if(!IsGoodCluster(yc))
-                continue;
 
-            container.emplace_back(xc.position, yc.position, 0.,        // by default z = 0
-                                   det_id,                              // detector id
-                                   xc.total_charge, yc.total_charge,    // fill in total charge
-                                   xc.peak_charge, yc.peak_charge,      // fill in peak charge
-                                   xc.hits.size(), yc.hits.size(),      // number of hits
-                                   res);                                // position resolution
-        }
+        float q_min = xc.total_charge*charge_ratio_center/charge_ratio_window;
+        float q_max = xc.total_charge*charge_ratio_center*charge_ratio_window;
+        auto it = std::lower_bound(y_sorted.begin(), y_sorted.end(), q_min,
+                                   [](const StripCluster *c, float q)
+                                   {
+                                       return c->total_charge < q;
+                                   });
+        for(; it != y_sorted.end() && (*it)->total_charge <= q_max; ++it)
+            add_hit(xc, **it);
     }
 }
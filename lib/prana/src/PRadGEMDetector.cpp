@@ -9,6 +9,7 @@
 //============================================================================//
 
 #include "PRadGEMDetector.h"
+#include "PRadProfiler.h"
 #include "PRadGEMSystem.h"
 #include "PRadGEMCluster.h"
 #include "PRadGEMAPV.h"
@@ -226,14 +227,24 @@ void PRadGEMDetector::ConnectPlanes()
 // reconstruct hits on planes, need PRadGEMCluster as an input
 void PRadGEMDetector::Reconstruct(PRadGEMCluster *gem_recon)
 {
-    // group strip hits into clusters
+    FormClusters(gem_recon);
+    ReconstructHits(gem_recon);
+}
+
+// group strip hits into clusters
+void PRadGEMDetector::FormClusters(PRadGEMCluster *gem_recon)
+{
     for(auto &plane : planes)
     {
         if(plane == nullptr)
             continue;
         plane->FormClusters(gem_recon);
     }
+}
 
+// reconstruct the hits from the clusters on planes
+void PRadGEMDetector::ReconstructHits(PRadGEMCluster *gem_recon)
+{
     // Cartesian reconstruction method
     // reconstruct event hits from clusters
     PRadGEMPlane *plane_x = GetPlane(PRadGEMPlane::Plane_X);
@@ -251,6 +262,8 @@ void PRadGEMDetector::Reconstruct(PRadGEMCluster *gem_recon)
 // collect all the hits from APVs
 void PRadGEMDetector::CollectHits()
 {
+    PRAD_PROFILE_SCOPE("GEM::CollectHits");
+
     for(auto &plane : planes)
     {
         if(plane != nullptr)
@@ -0,0 +1,692 @@
+//============================================================================//
+// Vectorized kernels for GEM APV data processing                             //
+// The raw SRS words are byte swapped, widened and converted to float, and    //
+// the common mode correction and zero suppression are done by the SSE/AVX2/  //
+// AVX-512 kernels chosen at runtime, the median and trimmed mean common      //
+// modes sort the channels with bitonic networks in the vector registers      //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadGEMKernels.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PRAD_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+
+//============================================================================//
+// Kernels                                                                    //
+//============================================================================//
+
+// split data word to adc values. Note that the endianness is changed
+static inline void split_data(const uint32_t &data, float &val1, float &val2)
+{
+    union
+    {
+        uint8_t bytes[4];
+        uint16_t vals[2];
+    } word;
+
+    const uint8_t *dbyte = (const uint8_t*) &data;
+    for(int i = 0; i < 4; ++i)
+    {
+        word.bytes[i] = dbyte[3 - i];
+    }
+
+    val1 = static_cast<float>(word.vals[0]);
+    val2 = static_cast<float>(word.vals[1]);
+}
+
+// scalar version, it is also used for the tails of the vectorized versions
+static void unpack_scalar(const uint32_t *buf, size_t size, float *out)
+{
+    for(size_t i = 0; i < size; ++i)
+    {
+        split_data(buf[i], out[2*i], out[2*i + 1]);
+    }
+}
+
+// scalar version of common mode correction, in the same order as
+// PRadGEMAPV::CommonModeCorrection
+static void common_mode_scalar(float *buf, const float *offset, const float *thres,
+                               const int32_t *group, size_t size)
+{
+    int count[2] = {0, 0};
+    float average[2] = {0., 0.};
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        buf[i] = offset[i] - buf[i];
+        if(buf[i] < thres[i]) {
+            int g = (group[i] != 0);
+            average[g] += buf[i];
+            count[g]++;
+        }
+    }
+
+    for(int g = 0; g < 2; ++g)
+    {
+        if(count[g])
+            average[g] /= (float)count[g];
+    }
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        buf[i] -= average[group[i] != 0];
+    }
+}
+
+// median (trim >= 0.5) or trimmed mean of the sorted values, the trimmed
+// values are summed in order so the vectorized sorts give the same result
+static inline float sorted_estimate(const float *vals, size_t n, float trim)
+{
+    if(!n)
+        return 0.;
+
+    if(trim >= 0.5)
+        return (n%2) ? vals[n/2] : 0.5*(vals[n/2 - 1] + vals[n/2]);
+
+    size_t lo = (trim > 0.) ? (size_t)(n*trim) : 0, hi = n - lo;
+    float sum = 0.;
+    for(size_t i = lo; i < hi; ++i)
+        sum += vals[i];
+    return sum/(float)(hi - lo);
+}
+
+// subtract the estimates of the two groups
+static inline void subtract_groups(float *buf, const int32_t *group, size_t beg, size_t size,
+                                   const float *est)
+{
+    for(size_t i = beg; i < size; ++i)
+    {
+        buf[i] -= est[group[i] != 0];
+    }
+}
+
+static void common_mode_sort_scalar(float *buf, const float *offset, const int32_t *group,
+                                    size_t size, float trim)
+{
+    float stack_vals[2][CM_SORT_SIZE];
+    std::vector<float> heap_vals[2];
+    float *vals[2] = {stack_vals[0], stack_vals[1]};
+    if(size > CM_SORT_SIZE) {
+        for(int g = 0; g < 2; ++g)
+        {
+            heap_vals[g].resize(size);
+            vals[g] = heap_vals[g].data();
+        }
+    }
+
+    size_t n[2] = {0, 0};
+    for(size_t i = 0; i < size; ++i)
+    {
+        buf[i] = offset[i] - buf[i];
+        int g = (group[i] != 0);
+        vals[g][n[g]++] = buf[i];
+    }
+
+    float est[2];
+    for(int g = 0; g < 2; ++g)
+    {
+        std::sort(vals[g], vals[g] + n[g]);
+        est[g] = sorted_estimate(vals[g], n[g], trim);
+    }
+
+    subtract_groups(buf, group, 0, size, est);
+}
+
+// number of vector registers for n values, a power of 2
+static inline unsigned int sort_registers(size_t n, unsigned int lanes)
+{
+    unsigned int nreg = 1;
+    while(nreg*lanes < n)
+        nreg *= 2;
+    return nreg;
+}
+
+// clear the bit mask
+static inline void clear_mask(size_t size, uint32_t *mask)
+{
+    for(size_t i = 0; i < (size + 31)/32; ++i)
+        mask[i] = 0;
+}
+
+// scalar zero suppression for the channels from beg, the mask should be cleared
+static inline void zero_sup_tail(const float *buf, size_t stride, uint32_t nts,
+                                 const float *thres, size_t beg, size_t size,
+                                 uint32_t *mask)
+{
+    for(size_t i = beg; i < size; ++i)
+    {
+        float average = 0.;
+        for(uint32_t j = 0; j < nts; ++j)
+        {
+            average += buf[i + j*stride];
+        }
+        average /= nts;
+
+        if(average > thres[i])
+            mask[i/32] |= (1u << (i%32));
+    }
+}
+
+static void zero_sup_scalar(const float *buf, size_t stride, uint32_t nts,
+                            const float *thres, size_t size, uint32_t *mask)
+{
+    clear_mask(size, mask);
+    zero_sup_tail(buf, stride, nts, thres, 0, size, mask);
+}
+
+#ifdef PRAD_X86_SIMD
+// after swapping the bytes in every word, the 16 bit values are in the order
+// of the output, they only need to be widened and converted
+__attribute__((target("sse4.1")))
+static void unpack_sse(const uint32_t *buf, size_t size, float *out)
+{
+    const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                        11, 10, 9, 8, 15, 14, 13, 12);
+
+    size_t i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        __m128i words = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) &buf[i]), bswap);
+        __m128i lo = _mm_cvtepu16_epi32(words);
+        __m128i hi = _mm_cvtepu16_epi32(_mm_srli_si128(words, 8));
+        _mm_storeu_ps(&out[2*i], _mm_cvtepi32_ps(lo));
+        _mm_storeu_ps(&out[2*i + 4], _mm_cvtepi32_ps(hi));
+    }
+
+    unpack_scalar(&buf[i], size - i, &out[2*i]);
+}
+
+__attribute__((target("avx2")))
+static void unpack_avx2(const uint32_t *buf, size_t size, float *out)
+{
+    const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                           11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4,
+                                           11, 10, 9, 8, 15, 14, 13, 12);
+
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256i words = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*) &buf[i]), bswap);
+        __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(words));
+        __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(words, 1));
+        _mm256_storeu_ps(&out[2*i], _mm256_cvtepi32_ps(lo));
+        _mm256_storeu_ps(&out[2*i + 8], _mm256_cvtepi32_ps(hi));
+    }
+
+    unpack_scalar(&buf[i], size - i, &out[2*i]);
+}
+
+// the lanes are summed separately for the two groups, masked by the threshold
+// comparison, and the counts are from the population of the masks
+__attribute__((target("avx2,popcnt")))
+static void common_mode_avx2(float *buf, const float *offset, const float *thres,
+                             const int32_t *group, size_t size)
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    int count[2] = {0, 0};
+    float average[2] = {0., 0.};
+
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 val = _mm256_sub_ps(_mm256_loadu_ps(&offset[i]), _mm256_loadu_ps(&buf[i]));
+        _mm256_storeu_ps(&buf[i], val);
+
+        __m256 below = _mm256_cmp_ps(val, _mm256_loadu_ps(&thres[i]), _CMP_LT_OQ);
+        __m256 g1 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*) &group[i]));
+        __m256 m0 = _mm256_andnot_ps(g1, below);
+        __m256 m1 = _mm256_and_ps(g1, below);
+
+        sum0 = _mm256_add_ps(sum0, _mm256_and_ps(m0, val));
+        sum1 = _mm256_add_ps(sum1, _mm256_and_ps(m1, val));
+        count[0] += __builtin_popcount(_mm256_movemask_ps(m0));
+        count[1] += __builtin_popcount(_mm256_movemask_ps(m1));
+    }
+
+    float lanes[2][8];
+    _mm256_storeu_ps(lanes[0], sum0);
+    _mm256_storeu_ps(lanes[1], sum1);
+    for(int k = 0; k < 8; ++k)
+    {
+        average[0] += lanes[0][k];
+        average[1] += lanes[1][k];
+    }
+
+    for(size_t j = i; j < size; ++j)
+    {
+        buf[j] = offset[j] - buf[j];
+        if(buf[j] < thres[j]) {
+            int g = (group[j] != 0);
+            average[g] += buf[j];
+            count[g]++;
+        }
+    }
+
+    for(int g = 0; g < 2; ++g)
+    {
+        if(count[g])
+            average[g] /= (float)count[g];
+    }
+
+    __m256 ave0 = _mm256_set1_ps(average[0]), ave1 = _mm256_set1_ps(average[1]);
+    for(i = 0; i + 8 <= size; i += 8)
+    {
+        __m256 g1 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*) &group[i]));
+        __m256 val = _mm256_sub_ps(_mm256_loadu_ps(&buf[i]), _mm256_blendv_ps(ave0, ave1, g1));
+        _mm256_storeu_ps(&buf[i], val);
+    }
+
+    for(; i < size; ++i)
+    {
+        buf[i] -= average[group[i] != 0];
+    }
+}
+
+// bitonic sort of nreg*8 values in registers, nreg is a power of 2 up to 16
+// the partners are in other registers for the distances of 8 and above, and
+// they are permuted in the same register for the shorter distances
+__attribute__((target("avx2")))
+static void bitonic_sort_avx2(float *vals, unsigned int nreg)
+{
+    __m256 r[16];
+    for(unsigned int a = 0; a < 16; ++a)
+        r[a] = (a < nreg) ? _mm256_loadu_ps(&vals[a*8]) : _mm256_setzero_ps();
+
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i zero = _mm256_setzero_si256();
+    const size_t n = nreg*8;
+
+    for(size_t k = 2; k <= n; k *= 2)
+    {
+        for(size_t j = k/2; j > 0; j /= 2)
+        {
+            if(j >= 8) {
+                for(unsigned int a = 0; a < nreg; ++a)
+                {
+                    unsigned int b = a ^ (j/8);
+                    if(b < a)
+                        continue;
+                    __m256 mn = _mm256_min_ps(r[a], r[b]), mx = _mm256_max_ps(r[a], r[b]);
+                    bool asc = ((a*8) & k) == 0;
+                    r[a] = asc ? mn : mx;
+                    r[b] = asc ? mx : mn;
+                }
+                continue;
+            }
+
+            const __m256i vj = _mm256_set1_epi32(j);
+            const __m256i idx = _mm256_xor_si256(lane, vj);
+            const __m256i lower = _mm256_cmpeq_epi32(_mm256_and_si256(lane, vj), zero);
+            const __m256i lane_asc = _mm256_cmpeq_epi32(_mm256_and_si256(lane, _mm256_set1_epi32(k)), zero);
+            for(unsigned int a = 0; a < nreg; ++a)
+            {
+                __m256i asc = (k >= 8) ? (((a*8) & k) ? zero : _mm256_set1_epi32(-1)) : lane_asc;
+                __m256 take_min = _mm256_castsi256_ps(_mm256_cmpeq_epi32(lower, asc));
+                __m256 p = _mm256_permutevar8x32_ps(r[a], idx);
+                __m256 mn = _mm256_min_ps(r[a], p), mx = _mm256_max_ps(r[a], p);
+                r[a] = _mm256_blendv_ps(mx, mn, take_min);
+            }
+        }
+    }
+
+    for(unsigned int a = 0; a < nreg; ++a)
+        _mm256_storeu_ps(&vals[a*8], r[a]);
+}
+
+__attribute__((target("avx2")))
+static void common_mode_sort_avx2(float *buf, const float *offset, const int32_t *group,
+                                  size_t size, float trim)
+{
+    if(size > CM_SORT_SIZE) {
+        common_mode_sort_scalar(buf, offset, group, size, trim);
+        return;
+    }
+
+    float vals[2][CM_SORT_SIZE];
+    size_t n[2] = {0, 0};
+
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 val = _mm256_sub_ps(_mm256_loadu_ps(&offset[i]), _mm256_loadu_ps(&buf[i]));
+        _mm256_storeu_ps(&buf[i], val);
+    }
+    for(; i < size; ++i)
+        buf[i] = offset[i] - buf[i];
+
+    for(i = 0; i < size; ++i)
+    {
+        int g = (group[i] != 0);
+        vals[g][n[g]++] = buf[i];
+    }
+
+    float est[2];
+    for(int g = 0; g < 2; ++g)
+    {
+        if(!n[g]) {
+            est[g] = 0.;
+            continue;
+        }
+        unsigned int nreg = sort_registers(n[g], 8);
+        std::fill(&vals[g][n[g]], &vals[g][nreg*8], std::numeric_limits<float>::infinity());
+        bitonic_sort_avx2(vals[g], nreg);
+        est[g] = sorted_estimate(vals[g], n[g], trim);
+    }
+
+    __m256 ave0 = _mm256_set1_ps(est[0]), ave1 = _mm256_set1_ps(est[1]);
+    for(i = 0; i + 8 <= size; i += 8)
+    {
+        __m256 g1 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*) &group[i]));
+        __m256 val = _mm256_sub_ps(_mm256_loadu_ps(&buf[i]), _mm256_blendv_ps(ave0, ave1, g1));
+        _mm256_storeu_ps(&buf[i], val);
+    }
+    subtract_groups(buf, group, i, size, est);
+}
+
+// the time samples are summed in the same order as the scalar version
+__attribute__((target("avx2")))
+static void zero_sup_avx2(const float *buf, size_t stride, uint32_t nts,
+                          const float *thres, size_t size, uint32_t *mask)
+{
+    clear_mask(size, mask);
+
+    const __m256 div = _mm256_set1_ps((float)nts);
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        for(uint32_t j = 0; j < nts; ++j)
+        {
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(&buf[i + j*stride]));
+        }
+        __m256 above = _mm256_cmp_ps(_mm256_div_ps(sum, div), _mm256_loadu_ps(&thres[i]), _CMP_GT_OQ);
+        mask[i/32] |= (uint32_t) _mm256_movemask_ps(above) << (i%32);
+    }
+
+    zero_sup_tail(buf, stride, nts, thres, i, size, mask);
+}
+
+// same as the avx2 version with the mask registers
+__attribute__((target("avx512f,popcnt")))
+static void common_mode_avx512(float *buf, const float *offset, const float *thres,
+                               const int32_t *group, size_t size)
+{
+    __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+    int count[2] = {0, 0};
+    float average[2] = {0., 0.};
+
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m512 val = _mm512_sub_ps(_mm512_loadu_ps(&offset[i]), _mm512_loadu_ps(&buf[i]));
+        _mm512_storeu_ps(&buf[i], val);
+
+        __m512i grp = _mm512_loadu_si512(&group[i]);
+        __mmask16 below = _mm512_cmp_ps_mask(val, _mm512_loadu_ps(&thres[i]), _CMP_LT_OQ);
+        __mmask16 g1 = _mm512_test_epi32_mask(grp, grp);
+        __mmask16 m0 = below & ~g1;
+        __mmask16 m1 = below & g1;
+
+        sum0 = _mm512_mask_add_ps(sum0, m0, sum0, val);
+        sum1 = _mm512_mask_add_ps(sum1, m1, sum1, val);
+        count[0] += __builtin_popcount(m0);
+        count[1] += __builtin_popcount(m1);
+    }
+
+    float lanes[2][16];
+    _mm512_storeu_ps(lanes[0], sum0);
+    _mm512_storeu_ps(lanes[1], sum1);
+    for(int k = 0; k < 16; ++k)
+    {
+        average[0] += lanes[0][k];
+        average[1] += lanes[1][k];
+    }
+
+    for(size_t j = i; j < size; ++j)
+    {
+        buf[j] = offset[j] - buf[j];
+        if(buf[j] < thres[j]) {
+            int g = (group[j] != 0);
+            average[g] += buf[j];
+            count[g]++;
+        }
+    }
+
+    for(int g = 0; g < 2; ++g)
+    {
+        if(count[g])
+            average[g] /= (float)count[g];
+    }
+
+    __m512 ave0 = _mm512_set1_ps(average[0]), ave1 = _mm512_set1_ps(average[1]);
+    for(i = 0; i + 16 <= size; i += 16)
+    {
+        __m512i grp = _mm512_loadu_si512(&group[i]);
+        __mmask16 g1 = _mm512_test_epi32_mask(grp, grp);
+        __m512 val = _mm512_sub_ps(_mm512_loadu_ps(&buf[i]), _mm512_mask_blend_ps(g1, ave0, ave1));
+        _mm512_storeu_ps(&buf[i], val);
+    }
+
+    for(; i < size; ++i)
+    {
+        buf[i] -= average[group[i] != 0];
+    }
+}
+
+// the zero masked forms avoid the undefined source of the unmasked intrinsics
+#define min16(a, b) _mm512_maskz_min_ps(0xffff, a, b)
+#define max16(a, b) _mm512_maskz_max_ps(0xffff, a, b)
+
+// same as the avx2 version with 16 lanes, nreg is a power of 2 up to 8
+__attribute__((target("avx512f")))
+static void bitonic_sort_avx512(float *vals, unsigned int nreg)
+{
+    __m512 r[8];
+    for(unsigned int a = 0; a < 8; ++a)
+        r[a] = (a < nreg) ? _mm512_loadu_ps(&vals[a*16]) : _mm512_setzero_ps();
+
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                           8, 9, 10, 11, 12, 13, 14, 15);
+    const size_t n = nreg*16;
+
+    for(size_t k = 2; k <= n; k *= 2)
+    {
+        for(size_t j = k/2; j > 0; j /= 2)
+        {
+            if(j >= 16) {
+                for(unsigned int a = 0; a < nreg; ++a)
+                {
+                    unsigned int b = a ^ (j/16);
+                    if(b < a)
+                        continue;
+                    __m512 mn = min16(r[a], r[b]), mx = max16(r[a], r[b]);
+                    bool asc = ((a*16) & k) == 0;
+                    r[a] = asc ? mn : mx;
+                    r[b] = asc ? mx : mn;
+                }
+                continue;
+            }
+
+            const __m512i vj = _mm512_set1_epi32(j);
+            const __m512i idx = _mm512_xor_si512(lane, vj);
+            const __mmask16 lower = _mm512_testn_epi32_mask(lane, vj);
+            const __mmask16 lane_asc = _mm512_testn_epi32_mask(lane, _mm512_set1_epi32(k));
+            for(unsigned int a = 0; a < nreg; ++a)
+            {
+                __mmask16 asc = (k >= 16) ? (((a*16) & k) ? 0 : 0xffff) : lane_asc;
+                __mmask16 take_min = ~(lower ^ asc);
+                __m512 p = _mm512_maskz_permutexvar_ps(0xffff, idx, r[a]);
+                __m512 mn = min16(r[a], p), mx = max16(r[a], p);
+                r[a] = _mm512_mask_blend_ps(take_min, mx, mn);
+            }
+        }
+    }
+
+    for(unsigned int a = 0; a < nreg; ++a)
+        _mm512_storeu_ps(&vals[a*16], r[a]);
+}
+
+// the channels are compressed into the groups by the masks
+__attribute__((target("avx512f,popcnt")))
+static void common_mode_sort_avx512(float *buf, const float *offset, const int32_t *group,
+                                    size_t size, float trim)
+{
+    if(size > CM_SORT_SIZE) {
+        common_mode_sort_scalar(buf, offset, group, size, trim);
+        return;
+    }
+
+    float vals[2][CM_SORT_SIZE];
+    size_t n[2] = {0, 0};
+
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m512 val = _mm512_sub_ps(_mm512_loadu_ps(&offset[i]), _mm512_loadu_ps(&buf[i]));
+        _mm512_storeu_ps(&buf[i], val);
+
+        __m512i grp = _mm512_loadu_si512(&group[i]);
+        __mmask16 g1 = _mm512_test_epi32_mask(grp, grp);
+        _mm512_mask_compressstoreu_ps(&vals[0][n[0]], ~g1, val);
+        _mm512_mask_compressstoreu_ps(&vals[1][n[1]], g1, val);
+        n[1] += __builtin_popcount(g1);
+        n[0] += 16 - __builtin_popcount(g1);
+    }
+    for(; i < size; ++i)
+    {
+        buf[i] = offset[i] - buf[i];
+        int g = (group[i] != 0);
+        vals[g][n[g]++] = buf[i];
+    }
+
+    float est[2];
+    for(int g = 0; g < 2; ++g)
+    {
+        if(!n[g]) {
+            est[g] = 0.;
+            continue;
+        }
+        unsigned int nreg = sort_registers(n[g], 16);
+        std::fill(&vals[g][n[g]], &vals[g][nreg*16], std::numeric_limits<float>::infinity());
+        bitonic_sort_avx512(vals[g], nreg);
+        est[g] = sorted_estimate(vals[g], n[g], trim);
+    }
+
+    __m512 ave0 = _mm512_set1_ps(est[0]), ave1 = _mm512_set1_ps(est[1]);
+    for(i = 0; i + 16 <= size; i += 16)
+    {
+        __m512i grp = _mm512_loadu_si512(&group[i]);
+        __mmask16 g1 = _mm512_test_epi32_mask(grp, grp);
+        __m512 val = _mm512_sub_ps(_mm512_loadu_ps(&buf[i]), _mm512_mask_blend_ps(g1, ave0, ave1));
+        _mm512_storeu_ps(&buf[i], val);
+    }
+    subtract_groups(buf, group, i, size, est);
+}
+
+__attribute__((target("avx512f")))
+static void zero_sup_avx512(const float *buf, size_t stride, uint32_t nts,
+                            const float *thres, size_t size, uint32_t *mask)
+{
+    clear_mask(size, mask);
+
+    const __m512 div = _mm512_set1_ps((float)nts);
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m512 sum = _mm512_setzero_ps();
+        for(uint32_t j = 0; j < nts; ++j)
+        {
+            sum = _mm512_add_ps(sum, _mm512_loadu_ps(&buf[i + j*stride]));
+        }
+        __mmask16 above = _mm512_cmp_ps_mask(_mm512_div_ps(sum, div), _mm512_loadu_ps(&thres[i]), _CMP_GT_OQ);
+        mask[i/32] |= (uint32_t) above << (i%32);
+    }
+
+    zero_sup_tail(buf, stride, nts, thres, i, size, mask);
+}
+#endif
+
+
+
+//============================================================================//
+// Kernel Selection                                                           //
+//============================================================================//
+
+PRadGEMKernels::KernelType PRadGEMKernels::ktype = Scalar;
+PRadGEMKernels::UnpackKernel PRadGEMKernels::unpack_kernel = &unpack_scalar;
+PRadGEMKernels::CommonModeKernel PRadGEMKernels::cm_kernel = &common_mode_scalar;
+PRadGEMKernels::SortedCommonModeKernel PRadGEMKernels::cm_sort_kernel = &common_mode_sort_scalar;
+PRadGEMKernels::ZeroSupKernel PRadGEMKernels::zs_kernel = &zero_sup_scalar;
+
+// choose the best kernels when the library is loaded
+static struct KernelInit
+{
+    KernelInit() {PRadGEMKernels::SetKernel(PRadGEMKernels::BestKernel());}
+} kernel_init;
+
+// it is not thread safe, the kernels should be set before processing
+void PRadGEMKernels::SetKernel(KernelType type)
+{
+    KernelType best = BestKernel();
+    if(type > best)
+        type = best;
+
+    ktype = type;
+    switch(type)
+    {
+#ifdef PRAD_X86_SIMD
+    // no 512 bit version for unpacking, it is limited by the memory
+    case AVX512:
+        unpack_kernel = &unpack_avx2;
+        cm_kernel = &common_mode_avx512;
+        cm_sort_kernel = &common_mode_sort_avx512;
+        zs_kernel = &zero_sup_avx512;
+        break;
+    case AVX2:
+        unpack_kernel = &unpack_avx2;
+        cm_kernel = &common_mode_avx2;
+        cm_sort_kernel = &common_mode_sort_avx2;
+        zs_kernel = &zero_sup_avx2;
+        break;
+    // the apv channels are too few to gain from the 128 bit versions
+    case SSE:
+        unpack_kernel = &unpack_sse;
+        cm_kernel = &common_mode_scalar;
+        cm_sort_kernel = &common_mode_sort_scalar;
+        zs_kernel = &zero_sup_scalar;
+        break;
+#endif
+    default:
+        ktype = Scalar;
+        unpack_kernel = &unpack_scalar;
+        cm_kernel = &common_mode_scalar;
+        cm_sort_kernel = &common_mode_sort_scalar;
+        zs_kernel = &zero_sup_scalar;
+        break;
+    }
+}
+
+// the best kernel supported by current cpu
+PRadGEMKernels::KernelType PRadGEMKernels::BestKernel()
+{
+#ifdef PRAD_X86_SIMD
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2"))
+        return AVX512;
+    if(__builtin_cpu_supports("avx2"))
+        return AVX2;
+    if(__builtin_cpu_supports("sse4.1"))
+        return SSE;
+#endif
+    return Scalar;
+}
@@ -12,6 +12,7 @@
 //============================================================================//
 
 #include "PRadGEMPlane.h"
+#include "PRadProfiler.h"
 #include "PRadGEMDetector.h"
 #include "PRadGEMCluster.h"
 #include "PRadGEMAPV.h"
@@ -254,11 +255,20 @@ void PRadGEMPlane::AddStripHit(int strip, float charge, bool xtalk, int fec, int
     strip_hits.emplace_back(strip, charge, GetStripPosition(strip), xtalk, fec, adc);
 }
 
-// collect hits from the connected APVs
+// collect hits from the connected APVs, the container is reserved for the
+// hits of all the APVs first
 void PRadGEMPlane::CollectAPVHits()
 {
     ClearStripHits();
 
+    size_t nhits = 0;
+    for(auto &apv : apv_list)
+    {
+        if(apv != nullptr)
+            nhits += apv->GetHitCount();
+    }
+    strip_hits.reserve(nhits);
+
     for(auto &apv : apv_list)
     {
         if(apv != nullptr)
@@ -269,6 +279,8 @@ void PRadGEMPlane::CollectAPVHits()
 // form clusters by the clustering method
 void PRadGEMPlane::FormClusters(PRadGEMCluster *method)
 {
-    method->FormClusters(strip_hits, strip_clusters);
+    PRAD_PROFILE_SCOPE("GEM::PlaneClusters");
+
+    method->FormClusters(strip_hits, strip_clusters, cluster_ctx);
 }
 
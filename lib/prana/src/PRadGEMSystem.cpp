@@ -16,13 +16,49 @@
 //============================================================================//
 
 #include "PRadGEMSystem.h"
+#include "PRadProfiler.h"
 #include "ConfigParser.h"
+#include "PRadTaskPool.h"
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
 #include <list>
+#include <atomic>
+#include <thread>
+#ifndef PRAD_NO_ROOT
 #include "TFile.h"
 #include "TH1.h"
+#endif
+
+
+// call func(i) for i from 0 to n - 1 by several threads
+template<class Func>
+inline void parallel_for(size_t n, unsigned int nthreads, Func func)
+{
+    std::atomic<size_t> next(0);
+    auto work = [&] ()
+                {
+                    size_t i;
+                    while((i = next++) < n)
+                        func(i);
+                };
+
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, n));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(work);
+    work();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    (void) nthreads;
+    work();
+#endif
+}
 
 
 
@@ -32,7 +68,8 @@
 
 // constructor
 PRadGEMSystem::PRadGEMSystem(const std::string &config_file, int daq_cap, int det_cap)
-: PedestalMode(false), def_ts(3), def_cth(20.), def_zth(5.), def_ctth(8.)
+: PedestalMode(false), def_ts(3), def_cth(20.), def_zth(5.), def_ctth(8.),
+  apv_threads(1), apv_pool(nullptr)
 {
     daq_slots.resize(daq_cap, nullptr);
     det_slots.resize(det_cap, nullptr);
@@ -49,8 +86,12 @@ PRadGEMSystem::PRadGEMSystem(const PRadGEMSystem &that)
 : ConfigObject(that),
   gem_recon(that.gem_recon), PedestalMode(that.PedestalMode),
   def_ts(that.def_ts), def_cth(that.def_cth), def_zth(that.def_zth),
-  def_ctth(that.def_ctth)
+  def_ctth(that.def_ctth), recon_cache(that.recon_cache),
+  apv_threads(1), apv_pool(nullptr)
 {
+    // the pool is not shared
+    SetAPVThreads(that.apv_threads);
+
     // copy daq system first
     for(auto &fec : that.daq_slots)
     {
@@ -93,8 +134,13 @@ PRadGEMSystem::PRadGEMSystem(PRadGEMSystem &&that)
   gem_recon(std::move(that.gem_recon)), PedestalMode(that.PedestalMode),
   daq_slots(std::move(that.daq_slots)), det_slots(std::move(that.det_slots)),
   det_name_map(std::move(that.det_name_map)), def_ts(that.def_ts),
-  def_cth(that.def_cth), def_zth(that.def_zth), def_ctth(that.def_ctth)
+  def_cth(that.def_cth), def_zth(that.def_zth), def_ctth(that.def_ctth),
+  recon_cache(std::move(that.recon_cache)), apv_threads(that.apv_threads),
+  apv_pool(that.apv_pool)
 {
+    that.apv_threads = 1;
+    that.apv_pool = nullptr;
+
     // reset the system for all components
     for(auto &fec : daq_slots)
     {
@@ -113,6 +159,7 @@ PRadGEMSystem::PRadGEMSystem(PRadGEMSystem &&that)
 PRadGEMSystem::~PRadGEMSystem()
 {
     Clear();
+    delete apv_pool;
 }
 
 // copy assignment operator
@@ -149,6 +196,13 @@ PRadGEMSystem &PRadGEMSystem::operator =(PRadGEMSystem &&rhs)
     def_cth = rhs.def_cth;
     def_zth = rhs.def_zth;
     def_ctth = rhs.def_ctth;
+    recon_cache = std::move(rhs.recon_cache);
+
+    delete apv_pool;
+    apv_threads = rhs.apv_threads;
+    apv_pool = rhs.apv_pool;
+    rhs.apv_threads = 1;
+    rhs.apv_pool = nullptr;
 
     // reset the system for all components
     for(auto &fec : daq_slots)
@@ -182,6 +236,8 @@ void PRadGEMSystem::Configure(const std::string &path)
         verbose = true;
     }
 
+    ClearCache();
+
     CONF_CONN(def_ts, "Default Time Samples", 3, verbose);
     CONF_CONN(def_cth, "Default Common Mode Threshold", 20, verbose);
     CONF_CONN(def_zth, "Default Zero Suppression Threshold", 5, verbose);
@@ -198,6 +254,20 @@ void PRadGEMSystem::Configure(const std::string &path)
                   << e.FailureDesc() << std::endl;
     }
 
+    // common mode method for all APVs, the mean by default
+    std::string cm_method = GetConfig<std::string>("Common Mode Method");
+    if(!cm_method.empty()) {
+        auto trim_val = GetConfigValue("Common Mode Trim");
+        float trim = trim_val.IsEmpty() ? GEM_CM_TRIM : trim_val.Float();
+        if(ConfigParser::case_ins_equal(cm_method, "Median"))
+            SetUnivCommonModeMethod(PRadGEMAPV::CM_Median, trim);
+        else if(ConfigParser::case_ins_equal(cm_method, "Trimmed Mean"))
+            SetUnivCommonModeMethod(PRadGEMAPV::CM_TrimmedMean, trim);
+        else if(!ConfigParser::case_ins_equal(cm_method, "Mean"))
+            std::cerr << "PRad GEM System Warning: Unknown common mode method "
+                      << cm_method << ", use the mean instead." << std::endl;
+    }
+
     // set resolution for each detector, defalt 0.1
     float def_res = 0.1;
     for(auto &det : det_slots)
@@ -215,6 +285,8 @@ void PRadGEMSystem::Configure(const std::string &path)
 // remove all the components
 void PRadGEMSystem::Clear()
 {
+    ClearCache();
+
     // DAQ removal
     for(auto &fec : daq_slots)
     {
@@ -245,7 +317,7 @@ void PRadGEMSystem::ReadMapFile(const std::string &path) throw(PRadException)
     ConfigParser c_parser;
     c_parser.SetSplitters(",");
 
-    if(!c_parser.ReadFile(path)) {
+    if(!c_parser.MapFile(path)) {
         throw PRadException("GEM System", "cannot open GEM map file " + path);
     }
 
@@ -308,6 +380,8 @@ void PRadGEMSystem::ReadPedestalFile(const std::string &path) throw(PRadExceptio
     if(path.empty())
         return;
 
+    ClearCache();
+
     ConfigParser c_parser;
     c_parser.SetSplitters(",: \t");
 
@@ -469,6 +543,8 @@ void PRadGEMSystem::RemoveFEC(int fec_id)
 // rebuild detector related maps
 void PRadGEMSystem::RebuildDetectorMap()
 {
+    ClearCache();
+
     det_name_map.clear();
 
     for(auto &det : det_slots)
@@ -536,26 +612,39 @@ const
 // fill raw data to a certain apv
 void PRadGEMSystem::FillRawData(const GEMRawData &raw, EventData &event)
 {
-    PRadGEMAPV *apv = GetAPV(raw.addr);
-
-    if(apv != nullptr) {
+    processAPV(raw, event, event.get_gem_data());
+}
 
-        apv->FillRawData(raw.buf, raw.size);
+// fill raw data of the APVs from an event, each APV collects its hits to its
+// own slice, and the slices are concatenated by their offsets
+void PRadGEMSystem::FillRawData(const GEMRawData *raws, size_t n, EventData &event)
+{
+    if(!apv_pool || n < 2) {
+        for(size_t i = 0; i < n; ++i)
+            processAPV(raws[i], event, event.get_gem_data());
+        return;
+    }
 
-        if(event.is_monitor_event()) {
-            if(PedestalMode)
-                apv->FillPedHist();
-        } else {
-            apv->ZeroSuppression();
-#ifdef MULTI_THREAD
-            __gem_locker.lock();
-#endif
-            apv->CollectZeroSupHits(event.get_gem_data());
-#ifdef MULTI_THREAD
-            __gem_locker.unlock();
-#endif
-        }
+    std::vector<std::vector<GEM_Data>> slices(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        apv_pool->Submit([this, raws, i, &event, &slices] ()
+                         {
+                             processAPV(raws[i], event, slices[i]);
+                         });
     }
+    apv_pool->Wait();
+
+    // prefix sum of the slice sizes
+    auto &gem_data = event.get_gem_data();
+    std::vector<size_t> offsets(n + 1);
+    offsets[0] = gem_data.size();
+    for(size_t i = 0; i < n; ++i)
+        offsets[i + 1] = offsets[i] + slices[i].size();
+
+    gem_data.resize(offsets[n]);
+    for(size_t i = 0; i < n; ++i)
+        std::move(slices[i].begin(), slices[i].end(), gem_data.begin() + offsets[i]);
 }
 
 // clear all APVs' raw data space
@@ -582,6 +671,18 @@ void PRadGEMSystem::Reset()
 void PRadGEMSystem::FillZeroSupData(const std::vector<GEMZeroSupData> &data_pack,
                                     EventData &event)
 {
+    FillZeroSupData(data_pack.data(), data_pack.size(), event);
+}
+
+// the words are grouped by the 8-bit key of fec and adc channel, the words out
+// of the key range are filled one by one
+void PRadGEMSystem::FillZeroSupData(const GEMZeroSupData *data, size_t n, EventData &event)
+{
+#ifdef MULTI_THREAD
+    // all the APVs are involved, and events can be decoded in parallel
+    std::lock_guard<std::mutex> gem_lock(__gem_locker);
+#endif
+
     // clear all the APVs' hits
     for(auto &fec : daq_slots)
     {
@@ -589,22 +690,54 @@ void PRadGEMSystem::FillZeroSupData(const std::vector<GEMZeroSupData> &data_pack
             fec->APVControl(&PRadGEMAPV::ResetHitPos);
     }
 
-    // fill in the online zero-suppressed data
-    for(auto &data : data_pack)
-        FillZeroSupData(data);
+    auto zs_key = [] (const APVAddress &addr)
+                  {
+                      return (addr.fec_id >= 0 && addr.fec_id < 16 && addr.adc_ch >= 0 && addr.adc_ch < 16) ?
+                             (addr.fec_id << 4 | addr.adc_ch) : -1;
+                  };
+
+    // counting sort by the keys
+    zs_start.assign(GEM_ZEROSUP_KEYS + 1, 0);
+    for(size_t i = 0; i < n; ++i)
+    {
+        int key = zs_key(data[i].addr);
+        if(key >= 0)
+            zs_start[key + 1]++;
+        else
+            FillZeroSupData(data[i]);
+    }
+    for(int k = 0; k < GEM_ZEROSUP_KEYS; ++k)
+        zs_start[k + 1] += zs_start[k];
+
+    zs_sorted.resize(zs_start.back());
+    zs_fill.assign(zs_start.begin(), zs_start.end() - 1);
+    for(size_t i = 0; i < n; ++i)
+    {
+        int key = zs_key(data[i].addr);
+        if(key >= 0)
+            zs_sorted[zs_fill[key]++] = data[i];
+    }
+
+    // fill in the online zero-suppressed data, one APV lookup for a group
+    for(int k = 0; k < GEM_ZEROSUP_KEYS; ++k)
+    {
+        uint32_t beg = zs_start[k], end = zs_start[k + 1];
+        if(beg == end)
+            continue;
+        PRadGEMAPV *apv = GetAPV(k >> 4, k&0xf);
+        if(!apv)
+            continue;
+        for(uint32_t i = beg; i < end; ++i)
+            apv->FillZeroSupData(zs_sorted[i].channel, zs_sorted[i].time_sample,
+                                 zs_sorted[i].adc_value);
+    }
 
-#ifdef MULTI_THREAD
-        __gem_locker.lock();
-#endif
     // collect these zero-suppressed hits
     for(auto &fec : daq_slots)
     {
         if(fec)
             fec->APVControl(&PRadGEMAPV::CollectZeroSupHits, event.get_gem_data());
     }
-#ifdef MULTI_THREAD
-        __gem_locker.unlock();
-#endif
 }
 
 // fill zero suppressed data
@@ -631,7 +764,7 @@ void PRadGEMSystem::ChooseEvent(const EventData &data)
     {
         auto apv = GetAPV(hit.addr.fec, hit.addr.adc);
         if(apv)
-            apv->FillZeroSupData(hit.addr.strip, hit.values);
+            apv->FillZeroSupData(hit.addr.strip, hit.values, hit.nvalues);
     }
 
     for(auto &det : det_slots)
@@ -644,32 +777,158 @@ void PRadGEMSystem::ChooseEvent(const EventData &data)
 // reconstruct certain event
 void PRadGEMSystem::Reconstruct(const EventData &data)
 {
+    PRAD_PROFILE_SCOPE("GEM::Reconstruct");
+
     // only reconstruct physics event
     if(!data.is_physics_event())
         return;
 
+    ReconCacheKey key(data, gem_recon.SettingHash());
+    if(recon_cache.GetCapacity()) {
+        auto cached = recon_cache.Find(key);
+        if(cached) {
+            for(size_t i = 0; i < det_slots.size() && i < cached->size(); ++i)
+            {
+                if(det_slots[i])
+                    det_slots[i]->GetHits() = cached->at(i);
+            }
+            return;
+        }
+    }
+
     ChooseEvent(data);
     Reconstruct();
+
+    if(recon_cache.GetCapacity()) {
+        std::vector<std::vector<GEMHit>> hits(det_slots.size());
+        for(size_t i = 0; i < det_slots.size(); ++i)
+        {
+            if(det_slots[i])
+                hits[i] = det_slots[i]->GetHits();
+        }
+        recon_cache.Insert(key, hits);
+    }
 }
 
 void PRadGEMSystem::Reconstruct()
 {
+    if(!apv_pool) {
+        for(auto &det : det_slots)
+        {
+            if(det)
+                det->Reconstruct(&gem_recon);
+        }
+        return;
+    }
+
+    // planes are independent, and the cluster method only reads its settings
+    for(auto &det : det_slots)
+    {
+        if(!det)
+            continue;
+
+        for(auto &plane : det->GetPlaneList())
+        {
+            if(!plane)
+                continue;
+            apv_pool->Submit([this, plane] () {plane->FormClusters(&gem_recon);});
+        }
+    }
+    apv_pool->Wait();
+
     for(auto &det : det_slots)
     {
         if(det)
-            det->Reconstruct(&gem_recon);
+            det->ReconstructHits(&gem_recon);
     }
 }
 
-// fit pedestal for all APVs
+// reconstruct events in parallel, the copies of system have their own apvs and
+// planes, so they can choose different events at the same time
+void PRadGEMSystem::ReconstructBatch(const EventData *events, size_t n,
+                                     std::vector<GEMHit> *out, unsigned int nthreads)
+const
+{
+    if(!n)
+        return;
+
+    std::atomic<size_t> next(0);
+    auto recon_blocks = [&] ()
+                        {
+                            PRadGEMSystem gem_sys(*this);
+                            gem_sys.SetAPVThreads(1);
+                            size_t beg;
+                            while((beg = next.fetch_add(GEM_BATCH_BLOCK)) < n)
+                            {
+                                size_t end = std::min<size_t>(beg + GEM_BATCH_BLOCK, n);
+                                for(size_t i = beg; i < end; ++i)
+                                {
+                                    out[i].clear();
+                                    if(!events[i].is_physics_event())
+                                        continue;
+
+                                    gem_sys.ChooseEvent(events[i]);
+                                    gem_sys.Reconstruct();
+                                    for(auto &det : gem_sys.det_slots)
+                                    {
+                                        if(!det)
+                                            continue;
+                                        auto &hits = det->GetHits();
+                                        out[i].insert(out[i].end(), hits.begin(), hits.end());
+                                    }
+                                }
+                            }
+                        };
+
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    // no need to have more threads than blocks
+    size_t nblocks = (n + GEM_BATCH_BLOCK - 1)/GEM_BATCH_BLOCK;
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, nblocks));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(recon_blocks);
+    recon_blocks();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    (void) nthreads;
+    recon_blocks();
+#endif
+}
+
+void PRadGEMSystem::ReconstructBatch(const EventData *events, size_t n,
+                                     GEMHitSoA &out, unsigned int nthreads)
+const
+{
+    std::vector<std::vector<GEMHit>> hits(n);
+    ReconstructBatch(events, n, hits.data(), nthreads);
+
+    size_t total = 0;
+    for(auto &h : hits)
+        total += h.size();
+
+    out.clear();
+    out.reserve(total);
+    for(size_t i = 0; i < n; ++i)
+        out.Append(hits[i], i);
+}
+
+// update pedestal for all APVs
 // this requires pedestal mode is on, otherwise there won't be any data to fit
-void PRadGEMSystem::FitPedestal()
+// the APVs are independent so they are updated in parallel, except the ROOT
+// fits
+void PRadGEMSystem::FitPedestal(bool root_fit, unsigned int nthreads)
 {
-    for(auto &fec : daq_slots)
-    {
-        if(fec)
-            fec->APVControl(&PRadGEMAPV::FitPedestal);
-    }
+    ClearCache();
+
+    auto apvs = GetAPVList();
+    if(root_fit)
+        nthreads = 1;
+
+    parallel_for(apvs.size(), nthreads, [&] (size_t i) {apvs[i]->FitPedestal(root_fit);});
 }
 
 // save pedestal file for all APVs
@@ -692,11 +951,11 @@ const
 }
 
 // set pedestal mode on/off
-// if the pedestal mode is on, filling raw data will also fill the histograms in
-// APV for future pedestal fitting
-// turn on the pedestal mode will greatly slow down the raw data handling and
-// consume a significant amount of memories
-void PRadGEMSystem::SetPedestalMode(const bool &m)
+// if the pedestal mode is on, filling raw data will also fill the pedestal
+// statistics in APV for future pedestal update
+// the histograms are only created with root_hist, they will greatly slow down
+// the raw data handling and consume a significant amount of memories
+void PRadGEMSystem::SetPedestalMode(const bool &m, bool root_hist)
 {
     PedestalMode = m;
 
@@ -705,13 +964,36 @@ void PRadGEMSystem::SetPedestalMode(const bool &m)
         if(!fec)
             continue;
 
-        if(m)
+        fec->APVControl(&PRadGEMAPV::ResetPedHist);
+        if(m && root_hist)
             fec->APVControl(&PRadGEMAPV::CreatePedHist);
         else
             fec->APVControl(&PRadGEMAPV::ReleasePedHist);
     }
 }
 
+// set the number of threads processing the APVs of one event, it should not be
+// called during decoding
+void PRadGEMSystem::SetAPVThreads(unsigned int n)
+{
+#ifdef MULTI_THREAD
+    if(n == 0)
+        n = std::thread::hardware_concurrency();
+    n = std::max(n, 1u);
+
+    if(n == apv_threads)
+        return;
+
+    delete apv_pool;
+    apv_pool = nullptr;
+    apv_threads = n;
+    if(apv_threads > 1)
+        apv_pool = new PRadTaskPool(apv_threads);
+#else
+    (void) n;
+#endif
+}
+
 // collect the zero suppressed data from APV
 std::vector<GEM_Data> PRadGEMSystem::GetZeroSupData()
 const
@@ -730,6 +1012,8 @@ const
 // change the common mode threshold level for all APVs
 void PRadGEMSystem::SetUnivCommonModeThresLevel(const float &thres)
 {
+    ClearCache();
+
     for(auto &fec : daq_slots)
     {
         if(fec)
@@ -737,9 +1021,23 @@ void PRadGEMSystem::SetUnivCommonModeThresLevel(const float &thres)
     }
 }
 
+// change the common mode method for all APVs
+void PRadGEMSystem::SetUnivCommonModeMethod(int method, float trim)
+{
+    ClearCache();
+
+    for(auto &fec : daq_slots)
+    {
+        if(fec)
+            fec->APVControl(&PRadGEMAPV::SetCommonModeMethod, int(method), float(trim));
+    }
+}
+
 // change the zero suppression threshold level for all APVs
 void PRadGEMSystem::SetUnivZeroSupThresLevel(const float &thres)
 {
+    ClearCache();
+
     for(auto &fec : daq_slots)
     {
         if(fec)
@@ -747,9 +1045,21 @@ void PRadGEMSystem::SetUnivZeroSupThresLevel(const float &thres)
     }
 }
 
+// change the pedestal tracking weight for all APVs
+void PRadGEMSystem::SetUnivPedestalTracking(const float &weight)
+{
+    for(auto &fec : daq_slots)
+    {
+        if(fec)
+            fec->APVControl(&PRadGEMAPV::SetPedestalTracking, weight);
+    }
+}
+
 // change the time sample for all APVs
 void PRadGEMSystem::SetUnivTimeSample(const uint32_t &ts)
 {
+    ClearCache();
+
     for(auto &fec : daq_slots)
     {
         if(fec)
@@ -761,6 +1071,11 @@ void PRadGEMSystem::SetUnivTimeSample(const uint32_t &ts)
 void PRadGEMSystem::SaveHistograms(const std::string &path)
 const
 {
+#ifdef PRAD_NO_ROOT
+    std::cerr << "PRad GEM System Error: Cannot save histograms to "
+              << path << ", there is no histogram without ROOT."
+              << std::endl;
+#else
     TFile *f = new TFile(path.c_str(), "recreate");
 
     for(auto &fec : daq_slots)
@@ -785,6 +1100,46 @@ const
 
     f->Close();
     delete f;
+#endif
+}
+
+// the same directories as SaveHistograms
+PRadHistSnapshot PRadGEMSystem::SnapshotHistograms()
+const
+{
+    PRadHistSnapshot snap;
+#ifdef PRAD_NO_ROOT
+    std::cerr << "PRad GEM System Error: Cannot take the snapshot of the "
+              << "histograms, there is no histogram without ROOT."
+              << std::endl;
+#else
+    for(auto &fec : daq_slots)
+    {
+        if(!fec)
+            continue;
+
+        std::string fec_name = "FEC " + std::to_string(fec->GetID());
+        for(auto apv : fec->GetAPVList())
+        {
+            std::string dir = fec_name + "/ADC " + std::to_string(apv->GetADCChannel());
+            for(auto hist : apv->GetHistList())
+                snap.Add(dir, hist);
+        }
+    }
+#endif
+    return snap;
+}
+
+bool PRadGEMSystem::SaveHistSnapshot(const std::string &path)
+const
+{
+    return SnapshotHistograms().Save(path);
+}
+
+std::future<bool> PRadGEMSystem::SaveHistogramsAsync(const std::string &path)
+const
+{
+    return SnapshotHistograms().ExportROOTAsync(path);
 }
 
 // get the whole APV list
@@ -817,6 +1172,22 @@ const
     return res;
 }
 
+// memory held by the APVs and the hits of the detectors
+MemoryUsage PRadGEMSystem::GetMemoryUsage()
+const
+{
+    MemoryUsage res;
+    for(auto &apv : GetAPVList())
+        res += apv->GetMemoryUsage();
+
+    for(auto &det : det_slots)
+    {
+        if(det)
+            res.Add(det->GetHits());
+    }
+    return res;
+}
+
 std::vector<PRadGEMDetector*> PRadGEMSystem::GetDetectorList()
 const
 {
@@ -836,6 +1207,30 @@ const
 // Private Member Functions                                                   //
 //============================================================================//
 
+// process the raw data of an apv, the zero suppressed hits are added to hits
+void PRadGEMSystem::processAPV(const GEMRawData &raw, const EventData &event,
+                               std::vector<GEM_Data> &hits)
+{
+    PRadGEMAPV *apv = GetAPV(raw.addr);
+
+    if(apv != nullptr) {
+#ifdef MULTI_THREAD
+        // events can be decoded in parallel, lock the apv until its hits
+        // are collected
+        std::lock_guard<std::mutex> apv_lock(apv->GetLocker());
+#endif
+        apv->FillRawData(raw.buf, raw.size);
+
+        if(event.is_monitor_event()) {
+            if(PedestalMode)
+                apv->FillPedHist();
+        } else {
+            apv->ZeroSuppression();
+            apv->CollectZeroSupHits(hits);
+        }
+    }
+}
+
 // a helper operator to make arguments reading easier
 template<typename T>
 std::list<ConfigValue> &operator >>(std::list<ConfigValue> &lhs, T &t)
@@ -0,0 +1,242 @@
+//============================================================================//
+// Gain monitoring from the LMS events, the running means of the led signals  //
+// give the gain factors in windows of monitor events, so the gain drifts are //
+// available during the replay or online running                              //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadGainMonitor.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadGainMonitor::PRadGainMonitor(unsigned int window, int r)
+: window_size(window), ref(r), run(0), keep(true), index(0), led_events(0),
+  alpha_events(0), first_event(0), last_event(0), begin_time(0), end_time(0)
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// the reference PMTs are indexed by their names, LMS1 is 0
+void PRadGainMonitor::SetChannels(const std::vector<Channel> &chs)
+{
+    close();
+
+    channels = chs;
+    leds.assign(channels.size(), Stat());
+
+    int nref = 0;
+    for(auto &ch : channels)
+        nref = std::max(nref, ch.ref + 1);
+
+    ref_channels.assign(nref, -1);
+    for(size_t i = 0; i < channels.size(); ++i)
+    {
+        if(channels[i].ref >= 0)
+            ref_channels[channels[i].ref] = i;
+    }
+
+    ref_peds.resize(nref);
+    ref_alphas.resize(nref);
+    last_peds.resize(nref, 0.);
+    last_alphas.resize(nref, 0.);
+}
+
+// the windows do not go across the runs
+void PRadGainMonitor::SetRun(int r)
+{
+    if(r == run)
+        return;
+
+    close();
+    run = r;
+    index = 0;
+}
+
+void PRadGainMonitor::Fill(const EventData &event)
+{
+    if(!window_size || !event.is_monitor_event())
+        return;
+
+    if(!led_events && !alpha_events) {
+        first_event = event.event_number;
+        begin_time = event.timestamp;
+    }
+    last_event = event.event_number;
+    end_time = event.timestamp;
+
+    if(event.trigger == LMS_Led) {
+        led_events++;
+        for(auto &adc : event.adc_data)
+        {
+            if(adc.channel_id < leds.size())
+                leds[adc.channel_id].Add(adc.value);
+        }
+    } else {
+        // only the reference PMTs see the alpha source
+        alpha_events++;
+        for(auto &adc : event.adc_data)
+        {
+            if(adc.channel_id >= channels.size() || channels[adc.channel_id].ref < 0)
+                continue;
+
+            int r = channels[adc.channel_id].ref;
+            if(adc.value < GAIN_MONITOR_REF_SEP)
+                ref_peds[r].Add(adc.value);
+            else
+                ref_alphas[r].Add(adc.value);
+        }
+    }
+
+    if(led_events + alpha_events >= window_size)
+        close();
+}
+
+void PRadGainMonitor::Flush()
+{
+    close();
+}
+
+void PRadGainMonitor::Reset()
+{
+    series.clear();
+    leds.assign(channels.size(), Stat());
+    ref_peds.assign(ref_peds.size(), Stat());
+    ref_alphas.assign(ref_alphas.size(), Stat());
+    last_peds.assign(last_peds.size(), 0.);
+    last_alphas.assign(last_alphas.size(), 0.);
+    index = 0;
+    led_events = 0;
+    alpha_events = 0;
+}
+
+// a block for each window, the first line is
+// WINDOW run index first_event last_event begin_time end_time led_events
+//        alpha_events ref_gains...
+// followed by the channel lines
+// name led led_sigma entries gain
+bool PRadGainMonitor::SaveSeries(const std::string &path)
+const
+{
+    std::ofstream out(path);
+    if(!out.is_open()) {
+        std::cerr << "PRad Gain Monitor Error: Cannot open file "
+                  << "\"" << path << "\" to save the gain series."
+                  << std::endl;
+        return false;
+    }
+
+    out << "# gain monitor windows of " << window_size << " monitor events, "
+        << "module gains normalized to LMS" << ref << std::endl;
+
+    for(auto &w : series)
+    {
+        out << "WINDOW " << w.run << " " << w.index
+            << " " << w.first_event << " " << w.last_event
+            << " " << w.begin_time << " " << w.end_time
+            << " " << w.led_events << " " << w.alpha_events;
+        for(auto &g : w.ref_gains)
+            out << " " << std::setprecision(6) << g;
+        out << std::endl;
+
+        for(size_t i = 0; i < w.channels.size() && i < channels.size(); ++i)
+        {
+            auto &ch = w.channels[i];
+            if(!ch.entries)
+                continue;
+            out << std::setw(8) << channels[i].name
+                << std::setw(12) << std::setprecision(6) << ch.led
+                << std::setw(12) << std::setprecision(4) << ch.led_sigma
+                << std::setw(8) << ch.entries
+                << std::setw(12) << std::setprecision(6) << ch.gain
+                << std::endl;
+        }
+    }
+
+    return true;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// close the current window, emit it and start the next one
+void PRadGainMonitor::close()
+{
+    if(!led_events && !alpha_events)
+        return;
+
+    Window w;
+    w.run = run;
+    w.index = index++;
+    w.first_event = first_event;
+    w.last_event = last_event;
+    w.begin_time = begin_time;
+    w.end_time = end_time;
+    w.led_events = led_events;
+    w.alpha_events = alpha_events;
+
+    // the reference pedestal and alpha are updated when they have enough
+    // entries, otherwise they continue to the next window
+    w.ref_gains.assign(ref_channels.size(), 0.);
+    for(size_t r = 0; r < ref_channels.size(); ++r)
+    {
+        if(ref_peds[r].Valid()) {
+            last_peds[r] = ref_peds[r].mean;
+            ref_peds[r] = Stat();
+        }
+        if(ref_alphas[r].Valid()) {
+            last_alphas[r] = ref_alphas[r].mean;
+            ref_alphas[r] = Stat();
+        }
+
+        int id = ref_channels[r];
+        if(id < 0 || !leds[id].Valid() || last_alphas[r] <= last_peds[r])
+            continue;
+        w.ref_gains[r] = (leds[id].mean - last_peds[r])/(last_alphas[r] - last_peds[r]);
+    }
+
+    double ref_gain = (ref > 0 && ref <= (int)w.ref_gains.size()) ? w.ref_gains[ref - 1] : 0.;
+
+    w.channels.resize(channels.size());
+    for(size_t i = 0; i < channels.size(); ++i)
+    {
+        auto &led = leds[i];
+        auto &ch = w.channels[i];
+        ch.led = led.mean;
+        ch.led_sigma = led.Sigma();
+        ch.entries = led.n;
+        ch.gain = 0.;
+
+        double signal = led.mean - channels[i].ped;
+        if(channels[i].module && led.Valid() && ref_gain > 0. && signal > GAIN_MONITOR_MIN_LED)
+            ch.gain = signal/ref_gain;
+
+        led = Stat();
+    }
+
+    led_events = 0;
+    alpha_events = 0;
+
+    if(callback)
+        callback(w);
+    if(keep)
+        series.emplace_back(std::move(w));
+}
@@ -0,0 +1,124 @@
+//============================================================================//
+// Native estimation of a gaussian peak from histogram bins                   //
+// It replaces the gaussian fits of pedestal and LED signals, the estimation  //
+// only iterates the truncated moments, so it is fast and thread safe         //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadGausEstimator.h"
+#include <cmath>
+#include <algorithm>
+#ifndef PRAD_NO_ROOT
+#include "TH1.h"
+#include "TAxis.h"
+#endif
+
+// sigma of a gaussian truncated at +- k sigma is reduced by this factor
+inline double truncation_factor(double k)
+{
+    double pdf = std::exp(-0.5*k*k)/std::sqrt(2.*M_PI);
+    double prob = std::erf(k/std::sqrt(2.));
+    return std::sqrt(1. - 2.*k*pdf/prob);
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// estimate from the bin contents
+PRadGausEstimator::Result PRadGausEstimator::Estimate(const double *bins, int nbins,
+                                                      double xmin, double width,
+                                                      double min_entries)
+{
+    static const double trunc = truncation_factor(GAUS_EST_WINDOW);
+
+    Result res;
+    if(nbins <= 0 || width <= 0.)
+        return res;
+
+    int imax = 0;
+    for(int i = 0; i < nbins; ++i)
+    {
+        res.entries += bins[i];
+        if(bins[i] > bins[imax])
+            imax = i;
+    }
+
+    if(res.entries <= 0. || res.entries < min_entries)
+        return res;
+
+    // initial values from the highest bin and its full width at half maximum
+    double half = bins[imax]/2.;
+    int left = imax, right = imax;
+    while(left > 0 && bins[left - 1] > half) --left;
+    while(right < nbins - 1 && bins[right + 1] > half) ++right;
+
+    double mean = xmin + (imax + 0.5)*width;
+    double sigma = std::max((right - left + 1)*width/2.3548, width);
+
+    // moments in the window, bins are included by their centers
+    for(res.iters = 1; res.iters <= GAUS_EST_ITERS; ++res.iters)
+    {
+        double half_win = std::max(GAUS_EST_WINDOW*sigma, width);
+        int beg = std::max(0, (int)std::ceil((mean - half_win - xmin)/width - 0.5));
+        int end = std::min(nbins - 1, (int)std::floor((mean + half_win - xmin)/width - 0.5));
+
+        double s0 = 0., s1 = 0., s2 = 0.;
+        for(int i = beg; i <= end; ++i)
+        {
+            double dx = (i + 0.5)*width + xmin - mean;
+            s0 += bins[i];
+            s1 += bins[i]*dx;
+            s2 += bins[i]*dx*dx;
+        }
+
+        if(s0 <= 0.)
+            return res;
+
+        // mean and variance, Sheppard's correction for the bin width
+        double shift = s1/s0;
+        double var = s2/s0 - shift*shift - width*width/12.;
+        double new_sigma = std::sqrt(std::max(var, 0.))/trunc;
+
+        bool converged = (std::abs(shift) < 1e-4*width) &&
+                         (std::abs(new_sigma - sigma) < 1e-4*width);
+        mean += shift;
+        sigma = new_sigma;
+
+        if(converged)
+            break;
+    }
+
+    res.iters = std::min<unsigned int>(res.iters, GAUS_EST_ITERS);
+    res.mean = mean;
+    res.sigma = sigma;
+    res.valid = true;
+    return res;
+}
+
+#ifndef PRAD_NO_ROOT
+// estimate from the histogram bins in the range, the binning is fixed
+PRadGausEstimator::Result PRadGausEstimator::Estimate(const TH1 *hist, double range_min,
+                                                      double range_max, double min_entries)
+{
+    if(!hist)
+        return Result();
+
+    const TAxis *axis = hist->GetXaxis();
+    int beg_bin = std::max(1, axis->FindFixBin(range_min));
+    int end_bin = std::min(axis->GetNbins(), axis->FindFixBin(range_max) - 1);
+    if(end_bin < beg_bin)
+        return Result();
+
+    std::vector<double> bins(end_bin - beg_bin + 1);
+    for(int i = beg_bin; i <= end_bin; ++i)
+        bins[i - beg_bin] = hist->GetBinContent(i);
+
+    return Estimate(bins.data(), bins.size(), axis->GetBinLowEdge(beg_bin),
+                    axis->GetBinWidth(beg_bin), min_entries);
+}
+#endif
@@ -0,0 +1,117 @@
+//============================================================================//
+// Binary event file of the event generators                                  //
+// The events are fixed size records of floats after a header, so they can be //
+// read by the simulation in blocks without parsing any text                  //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadGenEventFile.h"
+#include <iostream>
+#include <cstring>
+
+static const char event_magic[8] = {'P', 'R', 'A', 'D', 'G', 'E', 'N', '\0'};
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadGenEventFile::PRadGenEventFile()
+: header(MakeHeader("")), nread(0)
+{
+    // place holder
+}
+
+PRadGenEventFile::~PRadGenEventFile()
+{
+    Close();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// open the file and read its header
+bool PRadGenEventFile::Open(const std::string &path)
+{
+    Close();
+
+    in.open(path, std::ios::binary);
+    if(!in.is_open()) {
+        std::cerr << "PRad Gen Event Error: Cannot open file "
+                  << "\"" << path << "\"."
+                  << std::endl;
+        return false;
+    }
+
+    if(!in.read((char*) &header, sizeof(header)) ||
+       memcmp(header.magic, event_magic, sizeof(event_magic)) ||
+       header.version != GEN_EVENT_VERSION ||
+       header.nparticles != GEN_EVENT_PARTICLES) {
+        std::cerr << "PRad Gen Event Error: "
+                  << "\"" << path << "\" is not a valid event file."
+                  << std::endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void PRadGenEventFile::Close()
+{
+    if(in.is_open())
+        in.close();
+    in.clear();
+    header = MakeHeader("");
+    nread = 0;
+}
+
+bool PRadGenEventFile::Read(Event &event)
+{
+    if(!in.read((char*) &event, sizeof(Event)))
+        return false;
+
+    nread++;
+    return true;
+}
+
+size_t PRadGenEventFile::Read(std::vector<Event> &events, size_t n)
+{
+    events.resize(n);
+    in.read((char*) events.data(), n*sizeof(Event));
+
+    size_t count = in.gcount()/sizeof(Event);
+    events.resize(count);
+    nread += count;
+    return count;
+}
+
+PRadGenEventFile::Header PRadGenEventFile::MakeHeader(const std::string &generator)
+{
+    Header res;
+    memset(&res, 0, sizeof(res));
+    memcpy(res.magic, event_magic, sizeof(event_magic));
+    res.version = GEN_EVENT_VERSION;
+    res.nparticles = GEN_EVENT_PARTICLES;
+    strncpy(res.generator, generator.c_str(), GEN_EVENT_NAME - 1);
+    return res;
+}
+
+// event from the values in the order of the text output columns
+PRadGenEventFile::Event PRadGenEventFile::MakeEvent(const double *vals)
+{
+    Event res;
+    for(int i = 0; i < GEN_EVENT_PARTICLES; ++i)
+    {
+        res.part[i].p = vals[3*i];
+        res.part[i].theta = vals[3*i + 1];
+        res.part[i].phi = vals[3*i + 2];
+    }
+    return res;
+}
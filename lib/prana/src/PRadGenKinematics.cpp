@@ -0,0 +1,104 @@
+//============================================================================//
+// Kinematics of the generated particles for blocks of events                 //
+// The momenta are boosted and converted to the output variables with plain   //
+// loops over arrays, one array for one component                             //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadGenKinematics.h"
+#include <cmath>
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+void PRadGenKinematics::BoostZ(Block &block, double beta)
+{
+    double gamma = sqrt(1./(1. - beta*beta));
+    double *e = block.e.data(), *pz = block.pz.data();
+    size_t n = block.size();
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        double e0 = e[i], pz0 = pz[i];
+        e[i] = gamma*(e0 - beta*pz0);
+        pz[i] = gamma*(pz0 - beta*e0);
+    }
+}
+
+void PRadGenKinematics::Momentum(const Block &block, double *p)
+{
+    const double *px = block.px.data(), *py = block.py.data(), *pz = block.pz.data();
+    size_t n = block.size();
+
+    for(size_t i = 0; i < n; ++i)
+        p[i] = sqrt(px[i]*px[i] + py[i]*py[i] + pz[i]*pz[i]);
+}
+
+void PRadGenKinematics::Polar(const Block &block, double *theta)
+{
+    const double *px = block.px.data(), *py = block.py.data(), *pz = block.pz.data();
+    size_t n = block.size();
+
+    for(size_t i = 0; i < n; ++i)
+        theta[i] = sqrt((px[i]*px[i] + py[i]*py[i])/(pz[i]*pz[i]));
+    for(size_t i = 0; i < n; ++i)
+        theta[i] = atan(theta[i]);
+}
+
+void PRadGenKinematics::Azimuthal(const Block &block, double *phi)
+{
+    const double *px = block.px.data(), *py = block.py.data();
+    size_t n = block.size();
+
+    for(size_t i = 0; i < n; ++i)
+        phi[i] = atan2(px[i], py[i]);
+}
+
+void PRadGenKinematics::FillEvents(const Block *parts, const char *const *masks,
+                                   PRadGenEventFile::Event *events, size_t n)
+{
+    std::vector<double> p(n), theta(n), phi(n);
+    for(int k = 0; k < GEN_EVENT_PARTICLES; ++k)
+    {
+        Momentum(parts[k], p.data());
+        Polar(parts[k], theta.data());
+        Azimuthal(parts[k], phi.data());
+
+        const char *mask = (masks) ? masks[k] : nullptr;
+        for(size_t i = 0; i < n; ++i)
+        {
+            auto &part = events[i].part[k];
+            bool emitted = !mask || mask[i];
+            part.p = (emitted) ? p[i] : 0.;
+            part.theta = (emitted) ? theta[i] : 0.;
+            part.phi = (emitted) ? phi[i] : 0.;
+        }
+    }
+}
+
+void PRadGenKinematics::FillValues(const Block *parts, const char *const *masks,
+                                   double *vals, size_t n)
+{
+    std::vector<double> p(n), theta(n), phi(n);
+    const size_t nvals = 3*GEN_EVENT_PARTICLES;
+    for(int k = 0; k < GEN_EVENT_PARTICLES; ++k)
+    {
+        Momentum(parts[k], p.data());
+        Polar(parts[k], theta.data());
+        Azimuthal(parts[k], phi.data());
+
+        const char *mask = (masks) ? masks[k] : nullptr;
+        for(size_t i = 0; i < n; ++i)
+        {
+            bool emitted = !mask || mask[i];
+            vals[i*nvals + 3*k] = (emitted) ? p[i] : 0.;
+            vals[i*nvals + 3*k + 1] = (emitted) ? theta[i] : 0.;
+            vals[i*nvals + 3*k + 2] = (emitted) ? phi[i] : 0.;
+        }
+    }
+}
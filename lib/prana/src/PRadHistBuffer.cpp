@@ -0,0 +1,207 @@
+//============================================================================//
+// Integer histogram buffer for the ROOT histograms of HyCal channels         //
+// The bins are counted in plain arrays, one buffer for each thread, and they //
+// are added to the ROOT histograms only when the histograms are needed       //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadHistBuffer.h"
+#include "PRadADCChannel.h"
+#include "PRadTDCChannel.h"
+#include <unordered_map>
+#include <algorithm>
+#ifndef PRAD_NO_ROOT
+#include "TH1.h"
+#include "TAxis.h"
+#endif
+
+
+
+//============================================================================//
+// Histogram Binning                                                          //
+//============================================================================//
+
+// same as TAxis::FindFixBin
+int PRadHistBuffer::Hist::FindBin(double x)
+const
+{
+#ifndef PRAD_NO_ROOT
+    if(!fixed)
+        return axis->FindFixBin(x);
+#endif
+
+    if(x < min)
+        return 0;
+    if(!(x < max))
+        return nbins + 1;
+    return 1 + int(nbins*(x - min)/(max - min));
+}
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadHistBuffer::PRadHistBuffer(std::shared_ptr<const Layout> l)
+: layout((l) ? l : std::make_shared<const Layout>())
+{
+    Reset();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// build the layout from the histograms of the channels
+std::shared_ptr<const PRadHistBuffer::Layout>
+PRadHistBuffer::BuildLayout(const std::vector<PRadADCChannel*> &adcs,
+                            const std::vector<PRadTDCChannel*> &tdcs,
+                            TH1 *energy_hist)
+{
+    auto layout = std::make_shared<Layout>();
+
+    // one buffered histogram for one ROOT histogram
+    std::unordered_map<TH1*, int> hist_index;
+    auto add_hist = [&] (TH1 *target)
+                    {
+                        if(!target)
+                            return -1;
+
+                        auto it = hist_index.find(target);
+                        if(it != hist_index.end())
+                            return it->second;
+
+                        Hist hist;
+                        hist.target = target;
+                        hist.offset = layout->nbins;
+#ifndef PRAD_NO_ROOT
+                        hist.axis = target->GetXaxis();
+                        hist.nbins = hist.axis->GetNbins();
+                        hist.min = hist.axis->GetXmin();
+                        hist.max = hist.axis->GetXmax();
+                        hist.fixed = (hist.axis->GetXbins()->GetSize() == 0);
+#else
+                        // the channels have no histograms without ROOT
+                        hist.axis = nullptr;
+                        hist.nbins = 0;
+                        hist.min = hist.max = 0.;
+                        hist.fixed = true;
+#endif
+
+                        int index = layout->hists.size();
+                        layout->hists.push_back(hist);
+                        layout->nbins += hist.nbins + 2;
+                        hist_index[target] = index;
+                        return index;
+                    };
+
+    layout->adcs.assign(adcs.begin(), adcs.end());
+    layout->adc_hists.assign(adcs.size()*MAX_Trigger, -1);
+    for(size_t i = 0; i < adcs.size(); ++i)
+    {
+        for(int t = 0; t < MAX_Trigger; ++t)
+            layout->adc_hists[i*MAX_Trigger + t] = add_hist(adcs[i]->GetHist((PRadTriggerType) t));
+    }
+
+    layout->tdc_hists.assign(tdcs.size(), -1);
+    for(size_t i = 0; i < tdcs.size(); ++i)
+        layout->tdc_hists[i] = add_hist(tdcs[i]->GetHist());
+
+    layout->energy_hist = add_hist(energy_hist);
+
+    return layout;
+}
+
+// same as PRadHyCalSystem::FillHists
+void PRadHistBuffer::Fill(const EventData &event)
+{
+    double energy = 0.;
+    uint32_t trg = event.get_trigger();
+
+    // adc hists for all types of events
+    for(auto &adc : event.get_adc_data())
+    {
+        if(adc.channel_id >= layout->adcs.size())
+            continue;
+
+        if(trg < MAX_Trigger)
+            fill(layout->adc_hists[adc.channel_id*MAX_Trigger + trg], adc.value);
+        energy += layout->adcs[adc.channel_id]->GetEnergy(adc.value);
+    }
+
+    // energy and tdc for only physics events
+    if(!event.is_physics_event())
+        return;
+
+    fill(layout->energy_hist, energy);
+
+    for(auto &tdc : event.get_tdc_data())
+    {
+        if(tdc.channel_id >= layout->tdc_hists.size())
+            continue;
+
+        fill(layout->tdc_hists[tdc.channel_id], tdc.value);
+    }
+}
+
+// add the counts from another thread
+bool PRadHistBuffer::Merge(const PRadHistBuffer &that)
+{
+    if(layout != that.layout)
+        return false;
+
+    for(size_t i = 0; i < counts.size(); ++i)
+        counts[i] += that.counts[i];
+    for(size_t i = 0; i < entries.size(); ++i)
+        entries[i] += that.entries[i];
+    entries_total += that.entries_total;
+    return true;
+}
+
+// clear the counts
+void PRadHistBuffer::Reset()
+{
+    counts.assign(layout->nbins, 0);
+    entries.assign(layout->hists.size(), 0);
+    entries_total = 0;
+}
+
+// add the counts to the ROOT histograms, the statistics of the histograms are
+// recalculated from the bin contents
+void PRadHistBuffer::Flush()
+{
+    if(!entries_total)
+        return;
+
+    for(size_t h = 0; h < layout->hists.size(); ++h)
+    {
+        if(!entries[h])
+            continue;
+
+#ifndef PRAD_NO_ROOT
+        auto &hist = layout->hists[h];
+        double nentries = hist.target->GetEntries() + entries[h];
+        for(int bin = 0; bin <= hist.nbins + 1; ++bin)
+        {
+            uint32_t count = counts[hist.offset + bin];
+            if(!count)
+                continue;
+            hist.target->AddBinContent(bin, count);
+            // the sum of squares of weights is the content for unit weights
+            if(hist.target->GetSumw2N()) {
+                auto sumw2 = hist.target->GetSumw2();
+                sumw2->AddAt(sumw2->At(bin) + count, bin);
+            }
+        }
+        hist.target->ResetStats();
+        hist.target->SetEntries(nentries);
+#endif
+    }
+
+    Reset();
+}
@@ -0,0 +1,342 @@
+//============================================================================//
+// Snapshot of the channel histograms                                         //
+// The bins of the histograms are copied to one contiguous array, a snapshot  //
+// file is the metadata records, a string table and the bins, written with a  //
+// single I/O, the ROOT file can be exported from it later, or on a           //
+// background thread                                                          //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadHistSnapshot.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <map>
+#include <memory>
+#ifndef PRAD_NO_ROOT
+#include "TROOT.h"
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TH1.h"
+#include "TH1D.h"
+#include "TAxis.h"
+#endif
+
+static const char snapshot_magic[8] = {'P', 'R', 'A', 'D', 'H', 'S', 'T', '\0'};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version, nhists;
+    uint64_t nbins, nchars;
+};
+
+// strings are offset and length in the string table
+struct SnapshotRecord
+{
+    uint32_t dir, dir_len, name, name_len, title, title_len;
+    int32_t nbins;
+    uint32_t fixed;
+    double min, max, entries;
+    uint64_t offset, edges;
+};
+
+// the bins are aligned to 8 bytes after the string table
+inline uint64_t align8(uint64_t n) {return (n + 7) & ~(uint64_t)7;}
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadHistSnapshot::PRadHistSnapshot()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+bool PRadHistSnapshot::Add(const std::string &dir, const TH1 *hist)
+{
+#ifdef PRAD_NO_ROOT
+    (void) dir;
+    (void) hist;
+    std::cerr << "PRad Hist Snapshot Error: Cannot take the snapshot of a "
+              << "histogram without ROOT." << std::endl;
+    return false;
+#else
+    if(!hist)
+        return false;
+
+    Hist h;
+    h.dir = dir;
+    h.name = hist->GetName();
+    h.title = hist->GetTitle();
+    h.nbins = hist->GetNbinsX();
+    h.entries = hist->GetEntries();
+
+    const TAxis *axis = hist->GetXaxis();
+    h.min = axis->GetXmin();
+    h.max = axis->GetXmax();
+    h.fixed = (axis->GetXbins()->GetSize() == 0);
+
+    h.edges = bins.size();
+    if(!h.fixed) {
+        for(int i = 1; i <= h.nbins + 1; ++i)
+            bins.push_back(axis->GetBinLowEdge(i));
+    }
+
+    h.offset = bins.size();
+    for(int i = 0; i <= h.nbins + 1; ++i)
+        bins.push_back(hist->GetBinContent(i));
+
+    hists.emplace_back(std::move(h));
+    return true;
+#endif
+}
+
+void PRadHistSnapshot::Clear()
+{
+    hists.clear();
+    bins.clear();
+}
+
+bool PRadHistSnapshot::Save(const std::string &path)
+const
+{
+    // build the string table
+    std::string chars;
+    std::vector<SnapshotRecord> records(hists.size());
+    auto add_str = [&chars] (const std::string &s, uint32_t &off, uint32_t &len)
+                   {
+                       off = chars.size();
+                       len = s.size();
+                       chars += s;
+                   };
+
+    for(size_t i = 0; i < hists.size(); ++i)
+    {
+        auto &h = hists[i];
+        auto &rec = records[i];
+        add_str(h.dir, rec.dir, rec.dir_len);
+        add_str(h.name, rec.name, rec.name_len);
+        add_str(h.title, rec.title, rec.title_len);
+        rec.nbins = h.nbins;
+        rec.fixed = h.fixed;
+        rec.min = h.min;
+        rec.max = h.max;
+        rec.entries = h.entries;
+        rec.offset = h.offset;
+        rec.edges = h.edges;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.version = HIST_SNAPSHOT_VERSION;
+    header.nhists = hists.size();
+    header.nbins = bins.size();
+    header.nchars = align8(chars.size());
+
+    // everything goes to one buffer
+    size_t rec_size = records.size()*sizeof(SnapshotRecord);
+    size_t bin_size = bins.size()*sizeof(double);
+    std::vector<char> buf(sizeof(header) + rec_size + header.nchars + bin_size, 0);
+    char *ptr = buf.data();
+    std::memcpy(ptr, &header, sizeof(header));
+    ptr += sizeof(header);
+    if(rec_size)
+        std::memcpy(ptr, records.data(), rec_size);
+    ptr += rec_size;
+    if(!chars.empty())
+        std::memcpy(ptr, chars.data(), chars.size());
+    ptr += header.nchars;
+    if(bin_size)
+        std::memcpy(ptr, bins.data(), bin_size);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << "PRad Hist Snapshot Error: Cannot open file "
+                  << "\"" << path << "\" to save the histograms."
+                  << std::endl;
+        return false;
+    }
+
+    out.write(buf.data(), buf.size());
+    if(!out.good()) {
+        std::cerr << "PRad Hist Snapshot Error: Failed to write "
+                  << "\"" << path << "\"." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool PRadHistSnapshot::Load(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if(!in.is_open()) {
+        std::cerr << "PRad Hist Snapshot Error: Cannot open file "
+                  << "\"" << path << "\"." << std::endl;
+        return false;
+    }
+
+    std::vector<char> buf(in.tellg());
+    in.seekg(0);
+    in.read(buf.data(), buf.size());
+
+    SnapshotHeader header;
+    if(buf.size() < sizeof(header)) {
+        std::cerr << "PRad Hist Snapshot Error: " << path
+                  << " is not a histogram snapshot." << std::endl;
+        return false;
+    }
+    std::memcpy(&header, buf.data(), sizeof(header));
+
+    if(std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) ||
+       header.version != HIST_SNAPSHOT_VERSION) {
+        std::cerr << "PRad Hist Snapshot Error: " << path
+                  << " is not a histogram snapshot of version "
+                  << HIST_SNAPSHOT_VERSION << "." << std::endl;
+        return false;
+    }
+
+    size_t rec_size = header.nhists*sizeof(SnapshotRecord);
+    size_t bin_size = header.nbins*sizeof(double);
+    if(buf.size() != sizeof(header) + rec_size + header.nchars + bin_size) {
+        std::cerr << "PRad Hist Snapshot Error: " << path
+                  << " is truncated." << std::endl;
+        return false;
+    }
+
+    const char *ptr = buf.data() + sizeof(header);
+    std::vector<SnapshotRecord> records(header.nhists);
+    if(rec_size)
+        std::memcpy(records.data(), ptr, rec_size);
+    const char *chars = ptr + rec_size;
+
+    Clear();
+    bins.resize(header.nbins);
+    if(bin_size)
+        std::memcpy(bins.data(), chars + header.nchars, bin_size);
+
+    for(auto &rec : records)
+    {
+        // the records should index into the tables
+        uint64_t need = rec.offset + rec.nbins + 2;
+        if(rec.nbins < 0 || need > bins.size() ||
+           (!rec.fixed && rec.edges + rec.nbins + 1 > bins.size()) ||
+           (uint64_t)rec.dir + rec.dir_len > header.nchars ||
+           (uint64_t)rec.name + rec.name_len > header.nchars ||
+           (uint64_t)rec.title + rec.title_len > header.nchars) {
+            std::cerr << "PRad Hist Snapshot Error: " << path
+                      << " has corrupted records." << std::endl;
+            Clear();
+            return false;
+        }
+
+        Hist h;
+        h.dir.assign(chars + rec.dir, rec.dir_len);
+        h.name.assign(chars + rec.name, rec.name_len);
+        h.title.assign(chars + rec.title, rec.title_len);
+        h.nbins = rec.nbins;
+        h.fixed = rec.fixed;
+        h.min = rec.min;
+        h.max = rec.max;
+        h.entries = rec.entries;
+        h.offset = rec.offset;
+        h.edges = rec.edges;
+        hists.emplace_back(std::move(h));
+    }
+
+    return true;
+}
+
+bool PRadHistSnapshot::ExportROOT(const std::string &path)
+const
+{
+#ifdef PRAD_NO_ROOT
+    std::cerr << "PRad Hist Snapshot Error: Cannot export the histograms to "
+              << path << " without ROOT." << std::endl;
+    return false;
+#else
+    TFile f(path.c_str(), "recreate");
+    if(!f.IsOpen()) {
+        std::cerr << "PRad Hist Snapshot Error: Cannot open file "
+                  << "\"" << path << "\" to export the histograms."
+                  << std::endl;
+        return false;
+    }
+
+    // the directories are created level by level
+    std::map<std::string, TDirectory*> dirs;
+    auto get_dir = [&f, &dirs] (const std::string &dir) -> TDirectory*
+                   {
+                       if(dir.empty())
+                           return (TDirectory*) &f;
+                       auto it = dirs.find(dir);
+                       if(it != dirs.end())
+                           return it->second;
+
+                       TDirectory *cur = &f;
+                       size_t beg = 0;
+                       while(beg <= dir.size())
+                       {
+                           size_t end = dir.find('/', beg);
+                           if(end == std::string::npos)
+                               end = dir.size();
+                           std::string sub = dir.substr(0, end);
+                           auto sit = dirs.find(sub);
+                           if(sit != dirs.end()) {
+                               cur = sit->second;
+                           } else {
+                               cur = cur->mkdir(dir.substr(beg, end - beg).c_str());
+                               dirs[sub] = cur;
+                           }
+                           beg = end + 1;
+                       }
+                       return cur;
+                   };
+
+    for(auto &h : hists)
+    {
+        TDirectory *dir = get_dir(h.dir);
+        TH1D *hist = h.fixed ? new TH1D(h.name.c_str(), h.title.c_str(), h.nbins, h.min, h.max)
+                             : new TH1D(h.name.c_str(), h.title.c_str(), h.nbins, GetEdges(h));
+        hist->SetDirectory(nullptr);
+
+        const double *contents = GetContents(h);
+        for(int i = 0; i <= h.nbins + 1; ++i)
+            hist->SetBinContent(i, contents[i]);
+        hist->SetEntries(h.entries);
+
+        dir->cd();
+        hist->Write();
+        delete hist;
+    }
+
+    f.Close();
+    return true;
+#endif
+}
+
+std::future<bool> PRadHistSnapshot::ExportROOTAsync(const std::string &path)
+const
+{
+#if defined(MULTI_THREAD) && !defined(PRAD_NO_ROOT)
+    // the directories and files are thread local once it is enabled
+    ROOT::EnableThreadSafety();
+
+    auto snap = std::make_shared<PRadHistSnapshot>(*this);
+    return std::async(std::launch::async, [snap, path] () {return snap->ExportROOT(path);});
+#else
+    std::promise<bool> res;
+    res.set_value(ExportROOT(path));
+    return res.get_future();
+#endif
+}
@@ -7,6 +7,8 @@
 //============================================================================//
 
 #include "PRadHyCalCluster.h"
+#include "PRadHyCalModule.h"
+#include <cmath>
 
 
 
@@ -26,9 +28,121 @@ const
     return new PRadHyCalCluster(*this);
 }
 
-void PRadHyCalCluster::FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls)
+void PRadHyCalCluster::FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls,
+                                   ClusterContext &ctx)
 const
 {
     // to be implemented by methods
 }
 
+// the events are clustered one by one with FormCluster, it is the reference
+// for the methods that cluster many events together (on an accelerator)
+void PRadHyCalCluster::FormClusterBatch(std::vector<ModuleHit> *hs,
+                                        std::vector<ModuleCluster> *cls,
+                                        size_t n, ClusterContext &ctx)
+const
+{
+    for(size_t i = 0; i < n; ++i)
+        FormCluster(hs[i], cls[i], ctx);
+}
+
+void PRadHyCalCluster::UpdateLayout(const PRadHyCalDetector *)
+{
+    // to be implemented by methods
+}
+
+
+
+//============================================================================//
+// Shape moments                                                              //
+//============================================================================//
+
+inline const ModuleHit &hit_ref(const ModuleHit *hit) {return *hit;}
+inline const ModuleHit &hit_ref(const ModuleHit &hit) {return hit;}
+
+// the line fit and energy uniformity are the ones of the cosmic rejection
+template<class Container>
+ShapeMoments eval_shape(const Container &hits)
+{
+    ShapeMoments res;
+    res.nhits = hits.size();
+    if(hits.empty())
+        return res;
+
+    double ax = 0., ay = 0., ex = 0., ey = 0.;
+    for(auto &h : hits)
+    {
+        auto &hit = hit_ref(h);
+        double x = hit->GetX(), y = hit->GetY();
+        res.energy += hit.energy;
+        res.max_energy = std::max(res.max_energy, hit.energy);
+        ax += x;
+        ay += y;
+        ex += hit.energy*x;
+        ey += hit.energy*y;
+    }
+
+    double n = hits.size();
+    ax /= n;
+    ay /= n;
+    if(res.energy > 0.) {
+        res.x = ex/res.energy;
+        res.y = ey/res.energy;
+    }
+
+    double lxx = 0., lxy = 0., lyy = 0., exx = 0., eyy = 0., exy = 0., dev = 0.;
+    double average = res.energy/n;
+    for(auto &h : hits)
+    {
+        auto &hit = hit_ref(h);
+        double dx = hit->GetX() - ax, dy = hit->GetY() - ay;
+        lxx += dx*dx;
+        lxy += dx*dy;
+        lyy += dy*dy;
+
+        double cx = hit->GetX() - res.x, cy = hit->GetY() - res.y;
+        exx += hit.energy*cx*cx;
+        eyy += hit.energy*cy*cy;
+        exy += hit.energy*cx*cy;
+
+        if(average > 0.)
+            dev += std::abs(hit.energy - average)/average;
+    }
+
+    if(res.energy > 0.) {
+        res.sxx = exx/res.energy;
+        res.syy = eyy/res.energy;
+        res.sxy = exy/res.energy;
+    }
+
+    if(hits.size() > 1)
+        res.uniform = dev/(n - 1.);
+
+    if(hits.size() < 3 || lxx == 0.)
+        return res;
+
+    res.k = lxy/lxx;
+    res.b = ay - res.k*ax;
+    if(lyy > 0.)
+        res.rsq = res.k*res.k*lxx/lyy;
+
+    double chisq = 0.;
+    for(auto &h : hits)
+    {
+        auto &hit = hit_ref(h);
+        double r = (hit->GetY() - res.k*hit->GetX() - res.b)/hit->GetSizeY();
+        chisq += r*r;
+    }
+    res.chisq = chisq/(n - 2.);
+    return res;
+}
+
+ShapeMoments ShapeMoments::Eval(const std::vector<ModuleHit*> &hits)
+{
+    return eval_shape(hits);
+}
+
+ShapeMoments ShapeMoments::Eval(const std::vector<ModuleHit> &hits)
+{
+    return eval_shape(hits);
+}
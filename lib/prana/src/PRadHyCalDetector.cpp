@@ -7,7 +7,7 @@
 
 #include "PRadHyCalDetector.h"
 #include "PRadHyCalSystem.h"
-#include "TH1.h"
+#include "PRadCalibCache.h"
 #include <algorithm>
 #include <fstream>
 #include <iomanip>
@@ -84,6 +84,18 @@ inline void qdist(double x1, double y1, int s1, double x2, double y2, int s2,
     dy = (y2 - y1)/sec1.msize_y;
 }
 
+// key of a module pair in the cache, 0 is reserved for the empty slot
+inline uint32_t pair_key(uint32_t i1, uint32_t i2)
+{
+    return ((i1 << 16) | i2) + 1;
+}
+
+// slot of the key in the cache with 2^bits slots
+inline uint32_t pair_slot(uint32_t key, unsigned int bits)
+{
+    return (key*2654435761u) >> (32 - bits);
+}
+
 
 
 
@@ -93,7 +105,7 @@ inline void qdist(double x1, double y1, int s1, double x2, double y2, int s2,
 
 // constructor
 PRadHyCalDetector::PRadHyCalDetector(const std::string &det, PRadHyCalSystem *sys)
-: PRadDetector(det), system(sys)
+: PRadDetector(det), system(sys), pair_bits(0), std_geo(false)
 {
     // place holder
 }
@@ -103,7 +115,7 @@ PRadHyCalDetector::PRadHyCalDetector(const std::string &det, PRadHyCalSystem *sy
 // copy constructor
 PRadHyCalDetector::PRadHyCalDetector(const PRadHyCalDetector &that)
 : PRadDetector(that), system(nullptr), hycal_hits(that.hycal_hits),
-  sector_info(that.sector_info), res_pars(that.res_pars)
+  sector_info(that.sector_info), pair_bits(0), std_geo(false), res_pars(that.res_pars)
 {
     for(auto module : that.module_list)
     {
@@ -116,6 +128,9 @@ PRadHyCalDetector::PRadHyCalDetector(const PRadHyCalDetector &that)
         vm->SetDetector(this);
         vmodule_list.push_back(vm);
     }
+
+    // the neighbors are not copied with the modules
+    InitLayout();
 }
 
 // move constructor
@@ -123,7 +138,9 @@ PRadHyCalDetector::PRadHyCalDetector(PRadHyCalDetector &&that)
 : PRadDetector(that), system(nullptr), module_list(std::move(that.module_list)),
   vmodule_list(std::move(vmodule_list)), id_map(std::move(that.id_map)),
   name_map(std::move(that.name_map)), hycal_hits(std::move(that.hycal_hits)),
-  sector_info(std::move(that.sector_info)), res_pars(std::move(that.res_pars))
+  sector_info(std::move(that.sector_info)), pair_dists(std::move(that.pair_dists)),
+  pair_bits(that.pair_bits), std_geo(that.std_geo), module_grids(std::move(that.module_grids)),
+  res_pars(std::move(that.res_pars))
 {
     // reset the connections between module and HyCal
     for(auto module : module_list)
@@ -168,6 +185,10 @@ PRadHyCalDetector &PRadHyCalDetector::operator =(PRadHyCalDetector &&rhs)
     name_map = std::move(rhs.name_map);
     hycal_hits = std::move(rhs.hycal_hits);
     sector_info = std::move(rhs.sector_info);
+    pair_dists = std::move(rhs.pair_dists);
+    pair_bits = rhs.pair_bits;
+    std_geo = rhs.std_geo;
+    module_grids = std::move(rhs.module_grids);
     res_pars = std::move(rhs.res_pars);
 
     for(auto module : module_list)
@@ -220,7 +241,7 @@ bool PRadHyCalDetector::ReadModuleList(const std::string &path)
         return false;
 
     ConfigParser c_parser;
-    if(!c_parser.ReadFile(path)) {
+    if(!c_parser.MapFile(path)) {
         std::cerr << "PRad HyCal Detector Error: Failed to read module list file "
                   << "\"" << path << "\"."
                   << std::endl;
@@ -300,7 +321,7 @@ bool PRadHyCalDetector::ReadVModuleList(const std::string &path)
 }
 
 // read calibration constants file
-bool PRadHyCalDetector::ReadCalibrationFile(const std::string &path)
+bool PRadHyCalDetector::ReadCalibrationFile(const std::string &path, PRadCalibCache *cache)
 {
     if(path.empty())
         return false;
@@ -328,21 +349,31 @@ bool PRadHyCalDetector::ReadCalibrationFile(const std::string &path)
             gains.push_back(c_parser.TakeFirst<double>());
         }
 
-        PRadCalibConst cal_const(factor, Ecal, nl, gains);
+        if(cache)
+            cache->AddCalib(name, factor, Ecal, nl, gains);
 
-        PRadHyCalModule *module = GetModule(name);
-        if(module) {
-            module->SetCalibConst(cal_const);
-        } else {
-            std::cout << "PRad HyCal Detector Warning: Cannot find HyCal module "
-                      << name << ", skipped its update for calibration constant."
-                      << std::endl;
-        }
+        setCalibConst(name, PRadCalibConst(factor, Ecal, nl, gains));
     }
 
+    if(cache)
+        cache->SetCalibRead(true);
+
     return true;
 }
 
+// update the calibration constants from the records of a cache
+void PRadHyCalDetector::SetCalibration(const PRadCalibCache &cache)
+{
+    auto entries = cache.GetCalib();
+    for(size_t i = 0; i < cache.GetCalibCount(); ++i)
+    {
+        auto &entry = entries[i];
+        std::vector<double> gains(entry.gains, entry.gains + entry.ngains);
+        setCalibConst(PRadCalibCache::GetName(entry.name),
+                      PRadCalibConst(entry.factor, entry.energy, entry.non_linear, gains));
+    }
+}
+
 void PRadHyCalDetector::SaveModuleList(const std::string &path)
 const
 {
@@ -395,9 +426,15 @@ bool PRadHyCalDetector::AddModule(PRadHyCalModule *module)
 
     module->SetDetector(this);
     setLayout(*module);
+    module->index = module_list.size();
     module_list.push_back(module);
     name_map[name] = module;
     id_map[id] = module;
+    // rebuilt with the layout
+    module_grids.clear();
+
+    if(system)
+        system->GetReconstructor()->ClearCache();
 
     return true;
 }
@@ -433,6 +470,7 @@ void PRadHyCalDetector::RemoveModule(PRadHyCalModule *module)
     module_list.clear();
     for(auto &it : id_map)
         module_list.push_back(it.second);
+    indexModules();
 }
 
 // disconnect module
@@ -456,11 +494,13 @@ void PRadHyCalDetector::DisconnectModule(PRadHyCalModule *module, bool force_dis
 
     if(!force_disconn)
         module->UnsetDetector(true);
+    module->index = -1;
 
     // rebuild module list
     module_list.clear();
     for(auto &it : id_map)
         module_list.push_back(it.second);
+    indexModules();
 }
 
 void PRadHyCalDetector::SortModuleList()
@@ -470,6 +510,7 @@ void PRadHyCalDetector::SortModuleList()
              {
                 return *m1 < *m2;
              });
+    indexModules();
 }
 
 void PRadHyCalDetector::ClearModuleList()
@@ -484,6 +525,10 @@ void PRadHyCalDetector::ClearModuleList()
     module_list.clear();
     id_map.clear();
     name_map.clear();
+    module_grids.clear();
+
+    if(system)
+        system->GetReconstructor()->ClearCache();
 }
 
 void PRadHyCalDetector::ClearVModuleList()
@@ -576,25 +621,78 @@ const
     return it->second;
 }
 
-PRadHyCalModule *PRadHyCalDetector::GetModule(double x, double y)
+// check if the point is within the module
+inline bool module_contains(const PRadHyCalModule *module, double x, double y)
+{
+    double pos_x = module->GetX();
+    double size_x = module->GetSizeX();
+    if((x > pos_x + size_x/2.) || (x < pos_x - size_x/2.))
+        return false;
+    double pos_y = module->GetY();
+    double size_y = module->GetSizeY();
+    if((y > pos_y + size_y/2.) || (y < pos_y - size_y/2.))
+        return false;
+    return true;
+}
+
+PRadHyCalModule *PRadHyCalDetector::SectorGrid::Find(double x, double y)
 const
 {
-    for(auto &module : module_list)
+    if(!nx || !ny)
+        return nullptr;
+
+    double fx = (x - xmin)/cell_x, fy = (y - ymin)/cell_y;
+    if(!(fx >= 0. && fx < nx && fy >= 0. && fy < ny))
+        return nullptr;
+
+    int c = static_cast<int>(fy)*nx + static_cast<int>(fx);
+    for(uint32_t i = start[c]; i < start[c + 1]; ++i)
     {
-        double pos_x = module->GetX();
-        double size_x = module->GetSizeX();
-        if((x > pos_x + size_x/2.) || (x < pos_x - size_x/2.))
-            continue;
-        double pos_y = module->GetY();
-        double size_y = module->GetSizeY();
-        if((y > pos_y + size_y/2.) || (y < pos_y - size_x/2.))
-            continue;
+        if(module_contains(modules[i], x, y))
+            return modules[i];
+    }
+    return nullptr;
+}
 
+// the sector from GetSectorID is tried first, the other sectors are checked
+// for the modules near the sector boundaries
+// the list is scanned if the layout is not initialized
+PRadHyCalModule *PRadHyCalDetector::GetModule(double x, double y)
+const
+{
+    if(module_grids.empty() || sector_info.size() != module_grids.size()) {
+        for(auto &module : module_list)
+        {
+            if(module_contains(module, x, y))
+                return module;
+        }
+        return nullptr;
+    }
+
+    int sid = GetSectorID(x, y);
+    PRadHyCalModule *module = module_grids[sid].Find(x, y);
+    if(module)
         return module;
+
+    for(int i = 0; i < static_cast<int>(module_grids.size()); ++i)
+    {
+        if(i == sid)
+            continue;
+        module = module_grids[i].Find(x, y);
+        if(module)
+            return module;
     }
     return nullptr;
 }
 
+void PRadHyCalDetector::GetModules(const float *x, const float *y, size_t n,
+                                   PRadHyCalModule **mods)
+const
+{
+    for(size_t i = 0; i < n; ++i)
+        mods[i] = GetModule(x[i], y[i]);
+}
+
 double PRadHyCalDetector::GetEnergy()
 const
 {
@@ -637,6 +735,10 @@ const
 {
     int rid = static_cast<int>(r);
     if(rid < 0) return 0.;
+
+    double res;
+    if(interpolate(res_pars.ene_table[rid], E, res))
+        return res;
     return E*resolution(E/1000., res_pars.ene[rid])/100.;
 }
 
@@ -653,6 +755,10 @@ const
 {
     int rid = static_cast<int>(r);
     if(rid < 0) return 0.;
+
+    double res;
+    if(interpolate(res_pars.pos_table[rid], E, res))
+        return res;
     return resolution(E/1000., res_pars.pos[rid]);
 }
 
@@ -665,6 +771,7 @@ bool PRadHyCalDetector::SetEneRes(ResRegion r, double a, double b, double c)
     res_pars.ene[rid][0] = a;
     res_pars.ene[rid][1] = b;
     res_pars.ene[rid][2] = c;
+    res_pars.UpdateTables();
     return true;
 }
 
@@ -677,15 +784,50 @@ bool PRadHyCalDetector::SetPosRes(ResRegion r, double a, double b, double c)
     res_pars.pos[rid][0] = a;
     res_pars.pos[rid][1] = b;
     res_pars.pos[rid][2] = c;
+    res_pars.UpdateTables();
     return true;
 }
 
+// resolutions of the hits
+void PRadHyCalDetector::SetResolutions(HyCalHit *hits, size_t n)
+const
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        auto &hit = hits[i];
+        auto module = GetModule(hit.cid);
+        if(!module) {
+            hit.sig_ene = 0.;
+            hit.sig_pos = 0.;
+            continue;
+        }
+
+        ResRegion r = GetResRegion(module);
+        hit.sig_ene = GetEneRes(r, hit.E);
+        hit.sig_pos = GetPosRes(r, hit.E);
+    }
+}
+
+// trigger efficiencies of the hits
+void PRadHyCalDetector::GetTriggerEfficiency(const HyCalHit *hits, size_t n, double *eff)
+const
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        auto module = GetModule(hits[i].cid);
+        eff[i] = (module) ? module->GetTriggerEfficiency(hits[i].E) : 1.;
+    }
+}
+
 // get the sector id for quantized distance, highly specific for HyCal layout
 // Notice that out of hycal will also be given a valid id, corresponding to the
 // closest lead glass sector, this is intended
 int PRadHyCalDetector::GetSectorID(double x, double y)
 const
 {
+    if(std_geo)
+        return HyCalStdGeometry::SectorID(x, y);
+
     // get the central area
     auto &center = sector_info[static_cast<int>(Center)];
     double x1, y1, x2, y2;
@@ -714,9 +856,9 @@ void PRadHyCalDetector::InitLayout()
         for(auto itn = std::next(it); itn != module_list.end(); ++itn)
         {
             double dx, dy;
-            qdist((*it)->GetX(), (*it)->GetY(), (*it)->GetSectorID(),
-                  (*itn)->GetX(), (*itn)->GetY(), (*itn)->GetSectorID(),
-                  sector_info, dx, dy);
+            quantizedDist((*it)->GetX(), (*it)->GetY(), (*it)->GetSectorID(),
+                          (*itn)->GetX(), (*itn)->GetY(), (*itn)->GetSectorID(),
+                          dx, dy);
             if(std::abs(dx) < 1.01 && std::abs(dy) < 1.01) {
                 (*it)->AddNeighbor(*itn, dx, dy);
                 (*itn)->AddNeighbor(*it, -dx, -dy);
@@ -761,6 +903,17 @@ void PRadHyCalDetector::UpdateSectorInfo()
     // form boundary points
     for(int i = 0; i < Ns; ++i)
         sector_info[i].SetBoundary(xmin[i], ymin[i], xmax[i], ymax[i]);
+
+    // the geometry is fixed now, the standard layout uses the compiled kernels,
+    // the others cache the distances that need the boundaries
+    std_geo = matchStdGeometry();
+    if(std_geo) {
+        pair_dists.clear();
+        pair_bits = 0;
+    } else {
+        buildPairCache();
+    }
+    buildModuleGrids();
 }
 
 // the distance quantized by the module size
@@ -769,17 +922,15 @@ double PRadHyCalDetector::QuantizedDist(const PRadHyCalModule *m1, const PRadHyC
 const
 {
     double dx, dy;
-    qdist(m1->GetX(), m1->GetY(), m1->GetSectorID(),
-          m2->GetX(), m2->GetY(), m2->GetSectorID(),
-          sector_info, dx, dy);
+    QuantizedDist(m1, m2, dx, dy);
     return std::sqrt(dx*dx + dy*dy);
 }
 
-double PRadHyCalDetector::QuantizedDist(double x1, double x2, double y1, double y2)
+double PRadHyCalDetector::QuantizedDist(double x1, double y1, double x2, double y2)
 const
 {
     double dx, dy;
-    qdist(x1, y1, GetSectorID(x1, y1), x2, y2, GetSectorID(x2, y2), sector_info, dx, dy);
+    QuantizedDist(x1, y1, x2, y2, dx, dy);
     return std::sqrt(dx*dx + dy*dy);
 }
 
@@ -788,7 +939,7 @@ double PRadHyCalDetector::QuantizedDist(double x1, double y1, int s1,
 const
 {
     double dx, dy;
-    qdist(x1, y1, s1, x2, y2, s2, sector_info, dx, dy);
+    quantizedDist(x1, y1, s1, x2, y2, s2, dx, dy);
     return std::sqrt(dx*dx + dy*dy);
 }
 
@@ -796,16 +947,28 @@ void PRadHyCalDetector::QuantizedDist(const PRadHyCalModule *m1, const PRadHyCal
                                       double &dx, double &dy)
 const
 {
-    qdist(m1->GetX(), m1->GetY(), m1->GetSectorID(),
-          m2->GetX(), m2->GetY(), m2->GetSectorID(),
-          sector_info, dx, dy);
+    if(!std_geo && m1->GetSectorID() != m2->GetSectorID()) {
+        auto pair = findPair(m1, m2);
+        if(pair) {
+            dx = pair->dx;
+            dy = pair->dy;
+            return;
+        }
+    }
+
+    quantizedDist(m1->GetX(), m1->GetY(), m1->GetSectorID(),
+                  m2->GetX(), m2->GetY(), m2->GetSectorID(),
+                  dx, dy);
 }
 
-void PRadHyCalDetector::QuantizedDist(double x1, double x2, double y1, double y2,
+void PRadHyCalDetector::QuantizedDist(double x1, double y1, double x2, double y2,
                                       double &dx, double &dy)
 const
 {
-    qdist(x1, y1, GetSectorID(x1, y1), x2, y2, GetSectorID(x2, y2), sector_info, dx, dy);
+    if(std_geo)
+        HyCalStdGeometry::QuantizedDist(x1, y1, x2, y2, dx, dy);
+    else
+        qdist(x1, y1, GetSectorID(x1, y1), x2, y2, GetSectorID(x2, y2), sector_info, dx, dy);
 }
 
 void PRadHyCalDetector::QuantizedDist(double x1, double y1, int s1,
@@ -813,7 +976,243 @@ void PRadHyCalDetector::QuantizedDist(double x1, double y1, int s1,
                                       double &dx, double &dy)
 const
 {
-    qdist(x1, y1, s1, x2, y2, s2, sector_info, dx, dy);
+    quantizedDist(x1, y1, s1, x2, y2, s2, dx, dy);
+}
+
+// index of the modules in the list, they are used to locate the module hits
+void PRadHyCalDetector::indexModules()
+{
+    for(size_t i = 0; i < module_list.size(); ++i)
+        module_list[i]->index = i;
+
+    // the cached pairs are keyed by the index, they are rebuilt with the layout
+    pair_dists.clear();
+    pair_bits = 0;
+    module_grids.clear();
+
+    // the channel constants of the reconstructor refer to the modules
+    if(system)
+        system->GetReconstructor()->ClearCache();
+}
+
+// the sectors have the module sizes and the center boundary of the standard
+// layout, the outer boundaries are not used by the kernels
+bool PRadHyCalDetector::matchStdGeometry()
+const
+{
+    if(sector_info.size() != static_cast<size_t>(Max_Sector))
+        return false;
+
+    auto near = [](double a, double b) {return std::abs(a - b) < 1e-3;};
+
+    double x1, y1, x2, y2;
+    auto &center = sector_info[static_cast<int>(Center)];
+    center.GetBoundary(x1, y1, x2, y2);
+    if(center.mtype != static_cast<int>(PRadHyCalModule::PbWO4)
+       || !near(center.msize_x, HyCalStdLayout::center_size_x)
+       || !near(center.msize_y, HyCalStdLayout::center_size_y)
+       || !near(x1, HyCalStdLayout::center_x1) || !near(y1, HyCalStdLayout::center_y1)
+       || !near(x2, HyCalStdLayout::center_x2) || !near(y2, HyCalStdLayout::center_y2))
+        return false;
+
+    for(int i = static_cast<int>(Top); i < static_cast<int>(Max_Sector); ++i)
+    {
+        auto &sec = sector_info[i];
+        if(sec.mtype != static_cast<int>(PRadHyCalModule::PbGlass)
+           || !near(sec.msize_x, HyCalStdLayout::outer_size_x)
+           || !near(sec.msize_y, HyCalStdLayout::outer_size_y))
+            return false;
+    }
+    return true;
+}
+
+// the compiled kernel for the standard layout, the sector information otherwise
+void PRadHyCalDetector::quantizedDist(double x1, double y1, int s1,
+                                      double x2, double y2, int s2,
+                                      double &dx, double &dy)
+const
+{
+    if(std_geo)
+        HyCalStdGeometry::QuantizedDist(x1, y1, x2, y2, dx, dy);
+    else
+        qdist(x1, y1, s1, x2, y2, s2, sector_info, dx, dy);
+}
+
+// cache the quantized distances between the modules in different sectors, they
+// need the intersections with the sector boundaries, while the distance within
+// a sector is simply a division by the module size
+void PRadHyCalDetector::buildPairCache()
+{
+    pair_dists.clear();
+    pair_bits = 0;
+
+    // the index is limited to 16 bits in the key
+    if(module_list.empty() || module_list.size() >= 0xffff)
+        return;
+
+    std::vector<PairDist> pairs;
+    int Ns = sector_info.size();
+    for(size_t i = 0; i < module_list.size(); ++i)
+    {
+        const auto m1 = module_list[i];
+        int s1 = m1->GetSectorID();
+        if(s1 < 0 || s1 >= Ns)
+            continue;
+
+        for(size_t j = 0; j < module_list.size(); ++j)
+        {
+            const auto m2 = module_list[j];
+            int s2 = m2->GetSectorID();
+            if(s2 == s1 || s2 < 0 || s2 >= Ns)
+                continue;
+
+            // quantized distance is not less than the distance over the largest size
+            double msize = std::max({sector_info[s1].msize_x, sector_info[s1].msize_y,
+                                     sector_info[s2].msize_x, sector_info[s2].msize_y});
+            double range = QDIST_CACHE_RANGE*msize;
+            if(std::abs(m2->GetX() - m1->GetX()) >= range ||
+               std::abs(m2->GetY() - m1->GetY()) >= range)
+                continue;
+
+            PairDist pair;
+            qdist(m1->GetX(), m1->GetY(), s1, m2->GetX(), m2->GetY(), s2,
+                  sector_info, pair.dx, pair.dy);
+            pair.dist = std::sqrt(pair.dx*pair.dx + pair.dy*pair.dy);
+            if(pair.dist >= QDIST_CACHE_RANGE)
+                continue;
+
+            pair.key = pair_key(i, j);
+            pairs.push_back(pair);
+        }
+    }
+
+    if(pairs.empty())
+        return;
+
+    // open addressing table, at least half of the slots are empty
+    pair_bits = 1;
+    while((1u << pair_bits) < 2*pairs.size())
+        pair_bits++;
+
+    uint32_t mask = (1u << pair_bits) - 1;
+    pair_dists.resize(1u << pair_bits);
+    for(auto &slot : pair_dists)
+        slot.key = 0;
+
+    for(auto &pair : pairs)
+    {
+        uint32_t slot = pair_slot(pair.key, pair_bits);
+        while(pair_dists[slot].key != 0)
+            slot = (slot + 1)&mask;
+        pair_dists[slot] = pair;
+    }
+}
+
+// find the cached pair, return nullptr if it is not in the cache
+const PRadHyCalDetector::PairDist *PRadHyCalDetector::findPair(const PRadHyCalModule *m1,
+                                                               const PRadHyCalModule *m2)
+const
+{
+    if(!pair_bits)
+        return nullptr;
+
+    // the modules should belong to this detector
+    int i1 = m1->GetIndex(), i2 = m2->GetIndex();
+    if(i1 < 0 || i2 < 0 || (size_t)i1 >= module_list.size() || (size_t)i2 >= module_list.size() ||
+       module_list[i1] != m1 || module_list[i2] != m2)
+        return nullptr;
+
+    uint32_t key = pair_key(i1, i2), mask = (1u << pair_bits) - 1;
+    for(uint32_t slot = pair_slot(key, pair_bits); ; slot = (slot + 1)&mask)
+    {
+        const auto &pair = pair_dists[slot];
+        if(pair.key == key)
+            return &pair;
+        if(pair.key == 0)
+            return nullptr;
+    }
+}
+
+// a grid for each sector covering its boundary, the cells are in the module
+// size of the sector, so there are only a few modules in a cell
+void PRadHyCalDetector::buildModuleGrids()
+{
+    module_grids.clear();
+    module_grids.resize(sector_info.size());
+
+    for(size_t s = 0; s < sector_info.size(); ++s)
+    {
+        SectorGrid &grid = module_grids[s];
+        const SectorInfo &sector = sector_info[s];
+        if(sector.boundpts.size() < 4 || sector.msize_x <= 0. || sector.msize_y <= 0.)
+            continue;
+
+        double x1, y1, x2, y2;
+        sector.GetBoundary(x1, y1, x2, y2);
+        grid.xmin = x1;
+        grid.ymin = y1;
+        grid.cell_x = sector.msize_x;
+        grid.cell_y = sector.msize_y;
+        grid.nx = static_cast<int>((x2 - x1)/grid.cell_x) + 1;
+        grid.ny = static_cast<int>((y2 - y1)/grid.cell_y) + 1;
+
+        // cells overlapped by the module box, a small margin for the rounding
+        auto cell_range = [&grid] (const PRadHyCalModule *m, int &ix0, int &ix1, int &iy0, int &iy1)
+                          {
+                              double hx = m->GetSizeX()/2. + 1e-3, hy = m->GetSizeY()/2. + 1e-3;
+                              auto clamp = [] (double v, int n)
+                                           {
+                                               return std::min(n - 1, std::max(0, static_cast<int>(std::floor(v))));
+                                           };
+                              ix0 = clamp((m->GetX() - hx - grid.xmin)/grid.cell_x, grid.nx);
+                              ix1 = clamp((m->GetX() + hx - grid.xmin)/grid.cell_x, grid.nx);
+                              iy0 = clamp((m->GetY() - hy - grid.ymin)/grid.cell_y, grid.ny);
+                              iy1 = clamp((m->GetY() + hy - grid.ymin)/grid.cell_y, grid.ny);
+                          };
+
+        // two passes, counting then filling
+        grid.start.assign(grid.nx*grid.ny + 1, 0);
+        int ix0, ix1, iy0, iy1;
+        for(auto &module : module_list)
+        {
+            if(module->GetSectorID() != static_cast<int>(s))
+                continue;
+            cell_range(module, ix0, ix1, iy0, iy1);
+            for(int iy = iy0; iy <= iy1; ++iy)
+                for(int ix = ix0; ix <= ix1; ++ix)
+                    grid.start[iy*grid.nx + ix + 1]++;
+        }
+        for(int c = 0; c < grid.nx*grid.ny; ++c)
+            grid.start[c + 1] += grid.start[c];
+
+        std::vector<uint32_t> fill(grid.start);
+        grid.modules.resize(grid.start.back());
+        for(auto &module : module_list)
+        {
+            if(module->GetSectorID() != static_cast<int>(s))
+                continue;
+            cell_range(module, ix0, ix1, iy0, iy1);
+            for(int iy = iy0; iy <= iy1; ++iy)
+                for(int ix = ix0; ix <= ix1; ++ix)
+                    grid.modules[fill[iy*grid.nx + ix]++] = module;
+        }
+    }
+}
+
+// update the calibration constant of a module
+void PRadHyCalDetector::setCalibConst(const std::string &name, const PRadCalibConst &cal_const)
+{
+    PRadHyCalModule *module = GetModule(name);
+    if(module) {
+        module->SetCalibConst(cal_const);
+        // the cached reconstruction results are out of date
+        if(system)
+            system->GetReconstructor()->ClearCache();
+    } else {
+        std::cout << "PRad HyCal Detector Warning: Cannot find HyCal module "
+                  << name << ", skipped its update for calibration constant."
+                  << std::endl;
+    }
 }
 
 // using primex id to get layout information
@@ -888,3 +1287,22 @@ const
 
     module.SetLayout(Layout(flag, sector, row-1, col-1));
 }
+
+
+
+//============================================================================//
+// Resolution Tables                                                          //
+//============================================================================//
+
+void PRadHyCalDetector::ResParams::UpdateTables()
+{
+    for(int i = 0; i < static_cast<int>(Max_ResRegions); ++i)
+    {
+        for(int j = 0; j <= RES_TABLE_BINS; ++j)
+        {
+            double E = RES_TABLE_MIN + j*RES_TABLE_STEP;
+            ene_table[i][j] = E*resolution(E/1000., ene[i])/100.;
+            pos_table[i][j] = resolution(E/1000., pos[i]);
+        }
+    }
+}
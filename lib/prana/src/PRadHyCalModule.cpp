@@ -24,20 +24,20 @@
 PRadHyCalModule::PRadHyCalModule(const std::string &n,
                                  const Geometry &geo,
                                  PRadHyCalDetector *det)
-: detector(det), daq_ch(nullptr), name(n), geometry(geo)
+: detector(det), daq_ch(nullptr), name(n), index(-1), geometry(geo)
 {
     id = name_to_id(n);
 }
 
 PRadHyCalModule::PRadHyCalModule(int pid, const Geometry &geo, PRadHyCalDetector *det)
-: detector(det), daq_ch(nullptr), id(pid), geometry(geo)
+: detector(det), daq_ch(nullptr), id(pid), index(-1), geometry(geo)
 {
     name = id_to_name(id);
 }
 
 // copy constructor
 PRadHyCalModule::PRadHyCalModule(const PRadHyCalModule &that)
-: detector(nullptr), daq_ch(nullptr), name(that.name), id(that.id),
+: detector(nullptr), daq_ch(nullptr), name(that.name), id(that.id), index(-1),
   geometry(that.geometry), layout(that.layout), cal_const(that.cal_const),
   trg_const(that.trg_const)
 {
@@ -47,7 +47,7 @@ PRadHyCalModule::PRadHyCalModule(const PRadHyCalModule &that)
 // move constructor
 PRadHyCalModule::PRadHyCalModule(PRadHyCalModule &&that)
 : detector(nullptr), daq_ch(nullptr), name(std::move(that.name)), id(that.id),
-  geometry(that.geometry), layout(that.layout), cal_const(that.cal_const),
+  index(-1), geometry(that.geometry), layout(that.layout), cal_const(that.cal_const),
   trg_const(that.trg_const)
 {
     // place holder
@@ -7,13 +7,21 @@
 //============================================================================//
 
 #include "PRadHyCalReconstructor.h"
+#include "PRadProfiler.h"
 #include "PRadSquareCluster.h"
 #include "PRadIslandCluster.h"
 #include "PRadHyCalDetector.h"
 #include "PRadHyCalSystem.h"
 #include "PRadClusterProfile.h"
 #include <unordered_map>
+#include <limits>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#ifdef MULTI_THREAD
+#include <thread>
+#endif
 
 
 
@@ -23,7 +31,8 @@
 
 // constructor
 PRadHyCalReconstructor::PRadHyCalReconstructor(const std::string &conf_path)
-: cltype(Undefined_ClMethod), cluster(nullptr), postype(Logarithmic)
+: cltype(Undefined_ClMethod), cluster(nullptr), postype(Logarithmic),
+  pos_kernel(&PRadHyCalReconstructor::posKernel<Logarithmic>), config(), setting(0)
 {
     // default island method
     SetClusterMethod(Island);
@@ -32,18 +41,28 @@ PRadHyCalReconstructor::PRadHyCalReconstructor(const std::string &conf_path)
 
 // copy/move constructor
 PRadHyCalReconstructor::PRadHyCalReconstructor(const PRadHyCalReconstructor &that)
-: ConfigObject(that), profile(that.profile),
-  cltype(that.cltype), postype(that.postype), config(that.config)
+: ConfigObject(that), profile(that.profile), density(that.density),
+  cltype(that.cltype), postype(that.postype), pos_kernel(that.pos_kernel),
+  config(that.config), setting(that.setting), recon_cache(that.recon_cache.GetCapacity())
 {
+    // the cached results refer to the modules of another detector
     cluster = that.cluster->Clone();
+    // the method reads the settings of its own reconstructor
+    cluster->SetReconstructor(this);
+    context.cluster.keep_groups = that.context.cluster.keep_groups;
 }
 
 PRadHyCalReconstructor::PRadHyCalReconstructor(PRadHyCalReconstructor &&that)
-: ConfigObject(that), profile(std::move(that.profile)),
-  cltype(that.cltype), postype(that.postype), config(std::move(that.config))
+: ConfigObject(that), profile(std::move(that.profile)), density(std::move(that.density)),
+  cltype(that.cltype), postype(that.postype), pos_kernel(that.pos_kernel),
+  config(std::move(that.config)), setting(that.setting),
+  recon_cache(std::move(that.recon_cache))
 {
     cluster = that.cluster;
     that.cluster = nullptr;
+    if(cluster)
+        cluster->SetReconstructor(this);
+    context.cluster.keep_groups = that.context.cluster.keep_groups;
 }
 
 // destructor
@@ -70,11 +89,19 @@ PRadHyCalReconstructor &PRadHyCalReconstructor::operator =(PRadHyCalReconstructo
 
     ConfigObject::operator =(rhs);
     profile = std::move(rhs.profile);
+    density = std::move(rhs.density);
     cltype = rhs.cltype;
+    delete cluster;
     cluster = rhs.cluster;
     rhs.cluster = nullptr;
+    if(cluster)
+        cluster->SetReconstructor(this);
     postype = rhs.postype;
+    pos_kernel = rhs.pos_kernel;
     config = std::move(rhs.config);
+    setting = rhs.setting;
+    recon_cache = std::move(rhs.recon_cache);
+    context.cluster.keep_groups = rhs.context.cluster.keep_groups;
     return *this;
 }
 
@@ -106,6 +133,7 @@ void PRadHyCalReconstructor::Configure(const std::string &path)
     CONF_CONN(config.min_cluster_size, "Minimum Cluster Size", 1, verbose);
     CONF_CONN(config.least_leak, "Least Leakage Fraction", 0.05, verbose);
     CONF_CONN(config.leak_iters, "Leakage Iterations", 3, verbose);
+    CONF_CONN(config.leak_conv, "Leakage Convergence", 0., verbose);
     CONF_CONN(config.linear_corr_limit, "Non Linearity Limit", 0.6, verbose);
 
     // square
@@ -115,6 +143,9 @@ void PRadHyCalReconstructor::Configure(const std::string &path)
     CONF_CONN(config.corner_conn, "Corner Connection", false, verbose);
     CONF_CONN(config.split_iter, "Split Iteration", 6, verbose);
     CONF_CONN(config.least_split, "Least Split Fraction", 0.01, verbose);
+    CONF_CONN(config.split_conv, "Split Convergence", 0., verbose);
+    CONF_CONN(config.intra_hits, "Intra-Event Hits", 200, verbose);
+    CONF_CONN(config.intra_threads, "Intra-Event Threads", 1, verbose);
 
     // default min module energy
     config.min_module_energy.resize(static_cast<int>(PRadHyCalModule::Max_Types), 0.);
@@ -129,6 +160,18 @@ void PRadHyCalReconstructor::Configure(const std::string &path)
         if(!value.IsEmpty())
             config.min_module_energy[i] = value.Float();
     }
+
+    updateSetting();
+}
+
+// prepare the clustering method with the detector layout, it should be called
+// after the configuration or the method is changed
+void PRadHyCalReconstructor::UpdateLayout(const PRadHyCalDetector *det)
+{
+    if(cluster)
+        cluster->UpdateLayout(det);
+    density.UpdateLayout(det);
+    ClearCache();
 }
 
 // reconstruct the event to clusters
@@ -146,6 +189,20 @@ void PRadHyCalReconstructor::Reconstruct(PRadHyCalDetector *hycal, const EventDa
     if(!event.is_physics_event())
         return;
 
+    // the cached results have no group information
+    bool use_cache = recon_cache.GetCapacity() && !context.cluster.keep_groups;
+
+    ReconCacheKey key(event, setting);
+    if(use_cache) {
+        auto cached = recon_cache.Find(key);
+        if(cached) {
+            context.module_hits = cached->module_hits;
+            context.module_clusters = cached->module_clusters;
+            hycal->GetHits() = cached->hits;
+            return;
+        }
+    }
+
     // collect hits
     CollectHits(hycal, event);
 
@@ -153,6 +210,11 @@ void PRadHyCalReconstructor::Reconstruct(PRadHyCalDetector *hycal, const EventDa
 
     // add timing information
     AddTiming(hycal, event);
+
+    if(use_cache)
+        recon_cache.Insert(key, CachedEvent{context.module_hits,
+                                            context.module_clusters,
+                                            hycal->GetHits()});
 }
 
 void PRadHyCalReconstructor::Reconstruct(PRadHyCalDetector *hycal)
@@ -178,30 +240,13 @@ void PRadHyCalReconstructor::Reconstruct(PRadHyCalDetector *hycal)
 // steps to do cluster reconstruction
 void PRadHyCalReconstructor::ReconstructHits(PRadHyCalDetector *det)
 {
-    // form clusters
-    cluster->FormCluster(module_hits, module_clusters);
-
-    // hits container from the detector
-    auto &container = det->GetHits();
-    container.clear();
-
-    for(auto &cluster : module_clusters)
-    {
-        // discard cluster that does not satisfy certain conditions
-        if(!CheckCluster(cluster))
-            continue;
-
-        // leakage correction for dead modules
-        LeakCorr(cluster);
-
-        // reconstruct hit the position based on the cluster
-        container.emplace_back(Cluster2Hit(cluster));
-    }
+    ReconstructHits(context, det->GetHits());
 }
 
 // collect hits from detector
 void PRadHyCalReconstructor::CollectHits(PRadHyCalDetector *det)
 {
+    auto &module_hits = context.module_hits;
     module_hits.clear();
 
     for(auto &module : det->GetModuleList())
@@ -213,9 +258,161 @@ void PRadHyCalReconstructor::CollectHits(PRadHyCalDetector *det)
     }
 }
 
-// collect hits from event
+// collect hits from event, the flat channel constants are taken from the
+// detector and its DAQ system when they are needed
 void PRadHyCalReconstructor::CollectHits(PRadHyCalDetector *det, const EventData &event)
 {
+    auto &channels = context.channels;
+    if((!channels || channels->GetDetector() != det) && det->GetSystem())
+        channels = PRadCalibSnapshot::Take(*det->GetSystem());
+
+    if(channels && channels->GetDetector() == det)
+        CollectHits(*channels, event, context.module_hits);
+    else
+        CollectHits(det, event, context.module_hits);
+}
+
+// add timing information from detector
+void PRadHyCalReconstructor::AddTiming(PRadHyCalDetector *det)
+{
+    auto sys = det->GetSystem();
+    if(!sys) return;
+
+    // add timing information
+    for(auto &hit : det->GetHits())
+    {
+        auto center = det->GetModule(hit.cid);
+        if(!center) continue;
+
+        auto tdc = center->GetTDC();
+        if(!tdc) continue;
+
+        auto times = sys->GetTimeMeasure(tdc->GetID());
+        hit.set_time(times.begin(), times.size());
+    }
+}
+
+// add timing information from event
+void PRadHyCalReconstructor::AddTiming(PRadHyCalDetector *det, const EventData &event)
+{
+    AddTiming(det, event, det->GetHits());
+}
+
+// reconstruct the event with the given context, the reconstructed hits are
+// saved in hits, it can be called by several threads at the same time
+void PRadHyCalReconstructor::Reconstruct(const PRadHyCalDetector *hycal, const EventData &event,
+                                         Context &ctx, std::vector<HyCalHit> &hits)
+const
+{
+    hits.clear();
+
+    // cannot reconstruct without necessary objects
+    if(!hycal || !cluster) {
+        std::cerr << "PRad HyCal Reconstructor Error: undefined method or null "
+                  << "detector pointer. Abort event reconstruction."
+                  << std::endl;
+        return;
+    }
+
+    // no need to reconstruct non-physics event
+    if(!event.is_physics_event())
+        return;
+
+    if(ctx.calib)
+        CollectHits(*ctx.calib, event, ctx.module_hits);
+    else if(ctx.channels && ctx.channels->GetDetector() == hycal)
+        CollectHits(*ctx.channels, event, ctx.module_hits);
+    else
+        CollectHits(hycal, event, ctx.module_hits);
+    ReconstructHits(ctx, hits);
+    AddTiming(hycal, event, hits);
+}
+
+// reconstruct a batch of events, the hits of events[i] are saved in out[i]
+// every thread has its own context and takes a block of events at a time,
+// the detector and the calibration constants are shared and only read
+// nthreads = 0 means using all the hardware threads
+// the threads share the calibration snapshot if it is given
+void PRadHyCalReconstructor::ReconstructBatch(const PRadHyCalDetector *hycal,
+                                              const EventData *events, size_t n,
+                                              std::vector<HyCalHit> *out,
+                                              unsigned int nthreads,
+                                              ReconStats *stats,
+                                              const PRadCalibSnapshot::Ptr &calib)
+const
+{
+    PRAD_PROFILE_SCOPE("HyCal::ReconstructBatch");
+
+    if(!n)
+        return;
+
+    // cannot reconstruct without necessary objects
+    if(!hycal || !cluster) {
+        std::cerr << "PRad HyCal Reconstructor Error: undefined method or null "
+                  << "detector pointer. Abort event reconstruction."
+                  << std::endl;
+        for(size_t i = 0; i < n; ++i)
+            out[i].clear();
+        return;
+    }
+
+    // the flat channel constants are shared by the threads if there is no
+    // calibration snapshot
+    PRadCalibSnapshot::Ptr channels = context.channels;
+    if(!calib && (!channels || channels->GetDetector() != hycal) && hycal->GetSystem())
+        channels = PRadCalibSnapshot::Take(*hycal->GetSystem());
+    if(channels && channels->GetDetector() != hycal)
+        channels.reset();
+
+    std::atomic<size_t> next(0);
+    std::mutex stats_locker;
+    auto recon_blocks = [&] ()
+                        {
+                            Context ctx;
+                            // the events are already in parallel
+                            ctx.cluster.intra_event = (nthreads <= 1);
+                            ctx.calib = calib;
+                            ctx.channels = channels;
+                            size_t beg;
+                            while((beg = next.fetch_add(RECON_BATCH_BLOCK)) < n)
+                            {
+                                size_t end = std::min<size_t>(beg + RECON_BATCH_BLOCK, n);
+                                reconstructBlock(hycal, events + beg, end - beg, ctx, out + beg);
+                            }
+
+                            if(stats) {
+                                std::lock_guard<std::mutex> lock(stats_locker);
+                                *stats += ctx.cluster.stats;
+                            }
+                        };
+
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    // no need to have more threads than blocks
+    size_t nblocks = (n + RECON_BATCH_BLOCK - 1)/RECON_BATCH_BLOCK;
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, nblocks));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(recon_blocks);
+    recon_blocks();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    // no threads at all, the events are reconstructed one by one
+    (void) nthreads;
+    recon_blocks();
+#endif
+}
+
+// collect hits from event, the calibration constants are only read
+void PRadHyCalReconstructor::CollectHits(const PRadHyCalDetector *det, const EventData &event,
+                                         std::vector<ModuleHit> &module_hits)
+const
+{
+    PRAD_PROFILE_SCOPE("HyCal::CollectHits");
+
     module_hits.clear();
 
     auto sys = det->GetSystem();
@@ -245,39 +442,90 @@ void PRadHyCalReconstructor::CollectHits(PRadHyCalDetector *det, const EventData
     }
 }
 
-// add timing information from detector
-void PRadHyCalReconstructor::AddTiming(PRadHyCalDetector *det)
+// collect hits from event with the flat channel constants of the snapshot
+// the energies of a block of adc words are computed without branches, so the
+// loop can be vectorized, and then the hits above the thresholds are picked
+void PRadHyCalReconstructor::CollectHits(const PRadCalibSnapshot &calib, const EventData &event,
+                                         std::vector<ModuleHit> &module_hits)
+const
 {
-    // add timing information
-    for(auto &hit : det->GetHits())
+    PRAD_PROFILE_SCOPE("HyCal::CollectHits");
+
+    module_hits.clear();
+
+    const size_t nch = calib.GetChannelCount();
+    const double *ped = calib.GetPedestalData();
+    const double *gain = calib.GetChannelFactorData();
+    const uint8_t *type = calib.GetChannelTypeData();
+
+    // thresholds by module type, the channels without a module never pass
+    double thres[PRadHyCalModule::Max_Types + 1];
+    for(int i = 0; i < PRadHyCalModule::Max_Types; ++i)
+        thres[i] = config.min_module_energy[i];
+    thres[PRadHyCalModule::Max_Types] = std::numeric_limits<double>::infinity();
+
+    const auto &adcs = event.get_adc_data();
+    uint16_t chs[COLLECT_HITS_BLOCK];
+    double energies[COLLECT_HITS_BLOCK];
+    uint8_t pass[COLLECT_HITS_BLOCK];
+    for(size_t beg = 0; beg < adcs.size(); beg += COLLECT_HITS_BLOCK)
     {
-        auto center = det->GetModule(hit.cid);
-        if(!center) continue;
+        size_t n = std::min<size_t>(COLLECT_HITS_BLOCK, adcs.size() - beg);
+        const ADC_Data *words = &adcs[beg];
 
-        auto tdc = center->GetTDC();
-        if(tdc) hit.set_time(tdc->GetTimeMeasure());
+        for(size_t i = 0; i < n; ++i)
+        {
+            uint16_t ch = (words[i].channel_id < nch) ? words[i].channel_id : nch;
+            double val = (double)words[i].value - ped[ch];
+            double energy = (val < 0.) ? 0. : gain[ch]*val;
+            chs[i] = ch;
+            energies[i] = energy;
+            pass[i] = (energy > thres[type[ch]]);
+        }
+
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(pass[i])
+                module_hits.emplace_back(calib.GetModule(chs[i]), calib.GetModuleID(chs[i]),
+                                         energies[i]);
+        }
     }
 }
 
-// add timing information from event
-void PRadHyCalReconstructor::AddTiming(PRadHyCalDetector *det, const EventData &event)
+// form clusters from the module hits of context, and reconstruct the hits
+void PRadHyCalReconstructor::ReconstructHits(Context &ctx, std::vector<HyCalHit> &hits)
+const
 {
-    // build map for tdc information
-    std::unordered_map<uint16_t, std::vector<uint16_t>> tdc_info;
-    for(auto &tdc : event.tdc_data)
+    // form clusters
     {
-        auto it = tdc_info.find(tdc.channel_id);
-        if(it == tdc_info.end()) {
-            std::vector<uint16_t> info;
-            info.push_back(tdc.value);
-            tdc_info[tdc.channel_id] = info;
-        } else {
-            it->second.push_back(tdc.value);
-        }
+        PRAD_PROFILE_SCOPE("HyCal::FormCluster");
+        cluster->FormCluster(ctx.module_hits, ctx.module_clusters, ctx.cluster);
+    }
+
+    // the shapes of the clusters before the leakage correction adds hits
+    if(ctx.cluster.keep_groups) {
+        ctx.cluster.cluster_shapes.clear();
+        for(auto &cl : ctx.module_clusters)
+            ctx.cluster.cluster_shapes.emplace_back(ShapeMoments::Eval(cl.hits));
     }
 
+    PRAD_PROFILE_SCOPE("HyCal::ClustersToHits");
+    clustersToHits(ctx.module_clusters, ctx.cluster, ctx.calib.get(), hits);
+}
+
+// add timing information from event to the hits
+void PRadHyCalReconstructor::AddTiming(const PRadHyCalDetector *det, const EventData &event,
+                                       std::vector<HyCalHit> &hits)
+const
+{
+    PRAD_PROFILE_SCOPE("HyCal::AddTiming");
+
+    // tdc values sorted by the channels
+    TDCTable tdc_info;
+    tdc_info.Build(event.tdc_data);
+
     // add timing information
-    for(auto &hit : det->GetHits())
+    for(auto &hit : hits)
     {
         auto center = det->GetModule(hit.cid);
         if(!center) continue;
@@ -285,10 +533,9 @@ void PRadHyCalReconstructor::AddTiming(PRadHyCalDetector *det, const EventData &
         auto tdc = center->GetTDC();
         if(!tdc) continue;
 
-        auto it = tdc_info.find(tdc->GetID());
-
-        if(it != tdc_info.end()) {
-            hit.set_time(it->second);
+        auto times = tdc_info.Get(tdc->GetID());
+        if(!times.empty()) {
+            hit.set_time(times.begin(), times.size());
         }
     }
 }
@@ -329,6 +576,7 @@ bool PRadHyCalReconstructor::SetClusterMethod(ClMethod newtype)
     delete cluster;
     cluster = newone;
     cltype = newtype;
+    updateSetting();
     return true;
 }
 
@@ -370,6 +618,17 @@ bool PRadHyCalReconstructor::SetPositionMethod(PosMethod newtype)
     }
 
     postype = newtype;
+    switch(postype)
+    {
+    default:
+    case Logarithmic:
+        pos_kernel = &PRadHyCalReconstructor::posKernel<Logarithmic>;
+        break;
+    case Linear:
+        pos_kernel = &PRadHyCalReconstructor::posKernel<Linear>;
+        break;
+    }
+    updateSetting();
     return true;
 }
 
@@ -404,7 +663,9 @@ const
 }
 
 // reconstruct hit from cluster
-HyCalHit PRadHyCalReconstructor::Cluster2Hit(const ModuleCluster &cluster)
+// the non-linearity and density set are from calib if it is given
+HyCalHit PRadHyCalReconstructor::Cluster2Hit(const ModuleCluster &cluster,
+                                             const PRadCalibSnapshot *calib)
 const
 {
 
@@ -421,7 +682,8 @@ const
     hycal_hit.npos = reconstructPos(cluster, (BaseHit*)&hycal_hit);
 
     // get non-linear correction factor
-    float alpE = cluster.center->GetCalibConst().NonLinearCorr(cluster.energy);
+    float alpE = (calib) ? calib->NonLinearCorr(cluster.center->GetIndex(), cluster.energy)
+                         : cluster.center->GetCalibConst().NonLinearCorr(cluster.energy);
 
     // do non-linearity energy correction
     if(config.linear_corr && fabs(alpE) < config.linear_corr_limit) {
@@ -439,29 +701,42 @@ const
     hycal_hit.sig_pos = cluster.center->GetPosRes(hycal_hit.E);
 
     // position density correction and energy S shape correction
-    density.CorrectBias(cluster.center, hycal_hit, config.den_corr, config.sene_corr);
+    if(calib)
+        density.CorrectBias(cluster.center, hycal_hit, config.den_corr, config.sene_corr,
+                            calib->GetDensitySet());
+    else
+        density.CorrectBias(cluster.center, hycal_hit, config.den_corr, config.sene_corr);
 
     return hycal_hit;
 }
 
 // leakage correction, dead module hits will be provided by hycal detector
-void PRadHyCalReconstructor::LeakCorr(ModuleCluster &cluster)
+unsigned int PRadHyCalReconstructor::LeakCorr(ModuleCluster &cluster)
+const
+{
+    ClusterContext ctx;
+    return LeakCorr(cluster, ctx);
+}
+
+// the virtual hits are kept in the context, so there is no allocation once the
+// buffers are large enough
+unsigned int PRadHyCalReconstructor::LeakCorr(ModuleCluster &cluster, ClusterContext &ctx)
 const
 {
     if(!config.leak_corr ||                     // correction disabled
        TEST_BIT(cluster.flag, kLeakCorr) ||     // already corrected
        cluster.hits.size() < 4)                 // insufficient hits to constrain
-        return;
+        return 0;
 
     const auto &vnbrs = cluster.center->GetVirtNeighbors();
 
     // no need to correct
     if(vnbrs.empty())
-        return;
+        return 0;
 
     // add virtual hits for each virtual neighbor module
-    std::vector<ModuleHit> vhits;
-    vhits.reserve(vnbrs.size());
+    auto &vhits = ctx.vhits;
+    vhits.clear();
     for(auto &vnbr : vnbrs)
     {
         vhits.emplace_back(vnbr.ptr, vnbr->GetID(), 0., false);
@@ -474,9 +749,11 @@ const
     double est = EvalCluster(pos, cluster);
 
     // iteration to correct virtual hits
-    int iter = config.leak_iters;
-    std::vector<double> vhits_e(vhits.size());
-    while(iter-- > 0) {
+    unsigned int iters = 0;
+    auto &vhits_e = ctx.vhits_e;
+    vhits_e.resize(vhits.size());
+    while(iters < config.leak_iters) {
+        iters++;
         // save current status of vhits
         for(size_t i = 0; i < vhits.size(); ++i)
         {
@@ -497,9 +774,13 @@ const
             }
             // done
             break;
-        } else {
-            est = new_est;
         }
+
+        // converged, the estimator is not improved much
+        bool converged = (config.leak_conv > 0.) && (est - new_est < config.leak_conv*est);
+        est = new_est;
+        if(converged)
+            break;
     }
 
     // apply the virtual hits
@@ -513,6 +794,7 @@ const
 
     // including leakage correction
     SET_BIT(cluster.flag, kLeakCorr);
+    return iters;
 }
 
 // correct virtual hits energy with given hit, and update the hit after correction
@@ -520,12 +802,19 @@ void PRadHyCalReconstructor::CorrectVirtHits(BaseHit &hit, std::vector<ModuleHit
                                              const ModuleCluster &cluster)
 const
 {
+    // the sector of the center is the same for all the virtual hits
+    const PRadHyCalDetector *det = cluster.center->GetDetector();
+    int sid = det->GetSectorID(hit.x, hit.y);
+    int type = det->GetSectorInfo().at(sid).mtype;
+
     // update virtual hit energy
     double tote = cluster.energy;
     for(auto &vhit : vhits)
     {
         // check profile
-        float frac = getProf(hit.x, hit.y, cluster.energy, vhit).frac;
+        double dist = det->QuantizedDist(hit.x, hit.y, sid,
+                                         vhit->GetX(), vhit->GetY(), vhit->GetSectorID());
+        float frac = profile.Get(type, dist, cluster.energy).frac;
 
         double ene;
         if(frac > config.least_leak && frac < 1.) {
@@ -546,23 +835,31 @@ const
 }
 
 // evaluate how well this cluster can be described by the profile
+// the sector of the center and the constant factors are only evaluated once,
+// the loop over the hits has the same operations as the profile by hit
 double PRadHyCalReconstructor::EvalCluster(const BaseHit &c, const ModuleCluster &cl)
 const
 {
     double res = cl.center->GetEneRes(c.E);
     double est = 0.;
 
+    const PRadHyCalDetector *det = cl.center->GetDetector();
+    int sid = det->GetSectorID(c.x, c.y);
+    int type = det->GetSectorInfo().at(sid).mtype;
+    double e2 = c.E*c.E, res2 = res*res;
+
     int count = 0;
     for(auto &hit : cl.hits)
     {
-        auto prof = getProf(c, hit);
+        double dist = det->QuantizedDist(c.x, c.y, sid, hit->GetX(), hit->GetY(), hit->GetSectorID());
+        auto prof = profile.Get(type, dist, c.E);
         if(prof.frac < 0.01)
           continue;
 
         ++count;
 
         double diff = hit.energy - c.E*prof.frac;
-        double sigma2 = c.E*c.E*prof.err*prof.err + res*res*prof.frac*prof.frac;
+        double sigma2 = e2*prof.err*prof.err + res2*prof.frac*prof.frac;
 
         // log likelyhood for double exponential distribution
         est += fabs(diff)/sqrt(sigma2);
@@ -575,6 +872,31 @@ const
 // Protected/Private Functions                                                //
 //============================================================================//
 
+// hash the configuration and methods for the cache keys, the cached results
+// with other settings are removed
+void PRadHyCalReconstructor::updateSetting()
+{
+    int methods[] = {static_cast<int>(cltype), static_cast<int>(postype),
+                     static_cast<int>(density.GetSet())};
+    // the members are hashed one by one because of the paddings in Config
+    bool flags[] = {config.depth_corr, config.leak_corr, config.linear_corr,
+                    config.den_corr, config.sene_corr, config.corner_conn};
+    float values[] = {config.log_weight_thres, config.min_cluster_energy,
+                      config.min_center_energy, config.least_leak,
+                      config.linear_corr_limit, config.leak_conv,
+                      config.least_split, config.split_conv};
+    unsigned int counts[] = {config.min_cluster_size, config.leak_iters,
+                             config.split_iter, config.square_size};
+
+    uint64_t h = recon_hash(methods, sizeof(methods));
+    h = recon_hash(flags, sizeof(flags), h);
+    h = recon_hash(values, sizeof(values), h);
+    h = recon_hash(counts, sizeof(counts), h);
+    setting = recon_hash(config.min_module_energy.data(),
+                         config.min_module_energy.size()*sizeof(float), h);
+    recon_cache.Clear();
+}
+
 // get position weight
 float PRadHyCalReconstructor::getWeight(const float &E, const float &E0)
 const
@@ -619,20 +941,57 @@ const
     return 0.;
 }
 
-// reconstruct position from the temp container
-int PRadHyCalReconstructor::reconstructPos(const ModuleHit &center,
-                                           BaseHit *temp, int count, BaseHit *hit)
+// weights of the hits for position reconstruction, w = 0 if it is negative
+// the energies are in a contiguous array so the loop can be vectorized
+template<PRadHyCalReconstructor::PosMethod M>
+inline void pos_weights(const float *E, int n, float E0, float thres, float *w);
+
+template<>
+inline void pos_weights<PRadHyCalReconstructor::Logarithmic>(const float *E, int n, float E0,
+                                                             float thres, float *w)
+{
+    // thres + log(E/E0), log(E0) is the same for all hits
+    float base = thres - std::log(E0);
+    for(int i = 0; i < n; ++i)
+    {
+        float val = base + std::log(E[i]);
+        w[i] = (val < 0.f) ? 0.f : val;
+    }
+}
+
+template<>
+inline void pos_weights<PRadHyCalReconstructor::Linear>(const float *E, int n, float E0,
+                                                        float, float *w)
+{
+    float inv = 1.f/E0;
+    for(int i = 0; i < n; ++i)
+    {
+        float val = E[i]*inv;
+        w[i] = (val < 0.f) ? 0.f : val;
+    }
+}
+
+// reconstruct position from the temp container, the weighting method is fixed
+// at compile time, the kernel is chosen in SetPositionMethod
+template<PRadHyCalReconstructor::PosMethod M>
+int PRadHyCalReconstructor::posKernel(const ModuleHit &center,
+                                      BaseHit *temp, int count, BaseHit *hit)
 const
 {
-    // get total energy
+    // energies with the center at first, and get total energy
+    float ene[POS_RECON_HITS + 1], weight[POS_RECON_HITS + 1];
     float energy = center.energy;
-    for(int i= 0; i < count; ++i)
+    ene[0] = center.energy;
+    for(int i = 0; i < count; ++i)
     {
+        ene[i + 1] = temp[i].E;
         energy += temp[i].E;
     }
 
+    pos_weights<M>(ene, count + 1, energy, config.log_weight_thres, weight);
+
     // reconstruct position
-    float wx = 0, wy = 0, wtot = getWeight(center.energy, energy);
+    float wx = 0, wy = 0, wtot = weight[0];
     // center only contains a little portion of the total energy
     // possibly cosmic
     if(wtot == 0.) {
@@ -645,11 +1004,11 @@ const
     int phits = 0;
     for(int i = 0; i < count; ++i)
     {
-        float weight = getWeight(temp[i].E, energy);
-        if(weight > 0.) {
-            wx += temp[i].x*weight;
-            wy += temp[i].y*weight;
-            wtot += weight;
+        float w = weight[i + 1];
+        if(w > 0.) {
+            wx += temp[i].x*w;
+            wy += temp[i].y*w;
+            wtot += w;
             phits++;
         }
     }
@@ -704,6 +1063,68 @@ const
 }
 
 
+// reconstruct hits from the clusters
+void PRadHyCalReconstructor::clustersToHits(std::vector<ModuleCluster> &clusters,
+                                            ClusterContext &ctx,
+                                            const PRadCalibSnapshot *calib,
+                                            std::vector<HyCalHit> &hits)
+const
+{
+    hits.clear();
+
+    for(auto &cluster : clusters)
+    {
+        // discard cluster that does not satisfy certain conditions
+        if(!CheckCluster(cluster))
+            continue;
+
+        // leakage correction for dead modules
+        unsigned int leak_iters = LeakCorr(cluster, ctx);
+        if(leak_iters) {
+            ctx.stats.leak_clusters++;
+            ctx.stats.leak_iters += leak_iters;
+        }
+
+        // reconstruct hit the position based on the cluster
+        hits.emplace_back(Cluster2Hit(cluster, calib));
+    }
+}
+
+// reconstruct a block of events, the hits of all events are collected first,
+// and then clustered together by the clustering method
+void PRadHyCalReconstructor::reconstructBlock(const PRadHyCalDetector *hycal,
+                                              const EventData *events, size_t n,
+                                              Context &ctx, std::vector<HyCalHit> *out)
+const
+{
+    if(ctx.batch_hits.size() < n) {
+        ctx.batch_hits.resize(n);
+        ctx.batch_clusters.resize(n);
+    }
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        // no need to reconstruct non-physics event
+        if(!events[i].is_physics_event())
+            ctx.batch_hits[i].clear();
+        else if(ctx.calib)
+            CollectHits(*ctx.calib, events[i], ctx.batch_hits[i]);
+        else if(ctx.channels)
+            CollectHits(*ctx.channels, events[i], ctx.batch_hits[i]);
+        else
+            CollectHits(hycal, events[i], ctx.batch_hits[i]);
+    }
+
+    cluster->FormClusterBatch(ctx.batch_hits.data(), ctx.batch_clusters.data(), n, ctx.cluster);
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        clustersToHits(ctx.batch_clusters[i], ctx.cluster, ctx.calib.get(), out[i]);
+        if(!out[i].empty())
+            AddTiming(hycal, events[i], out[i]);
+    }
+}
+
 // get profiles
 typedef PRadClusterProfile::Value ProfVal;
 
@@ -737,3 +1158,34 @@ const
     return profile.Get(type, dist, c.E);
 }
 
+// get profiles of the hits to the same center, dist is a buffer for the distances
+void PRadHyCalReconstructor::getProfBatch(const ModuleHit &c, const std::vector<ModuleHit*> &hits,
+                                          float *dist, float *frac)
+const
+{
+    for(size_t i = 0; i < hits.size(); ++i)
+        dist[i] = c->QuantizedDist(hits[i]->ptr);
+    profile.GetBatch(c->GetType(), dist, c.energy/0.78, frac, nullptr, hits.size());
+}
+
+// the distance profile is only interpolated again if the center type or energy
+// is different from the cached row
+void PRadHyCalReconstructor::getProfBatch(const BaseHit &c, const std::vector<ModuleHit*> &hits,
+                                          float *dist, float *frac, PRadClusterProfile::Row &row)
+const
+{
+    if(hits.empty())
+        return;
+
+    // the center sector is the same for all the hits
+    auto detector = hits.front()->ptr->GetDetector();
+    int sid = detector->GetSectorID(c.x, c.y);
+    int type = detector->GetSectorInfo().at(sid).mtype;
+    for(size_t i = 0; i < hits.size(); ++i)
+    {
+        const auto &hit = *hits[i];
+        dist[i] = detector->QuantizedDist(c.x, c.y, sid,
+                                          hit->GetX(), hit->GetY(), hit->GetSectorID());
+    }
+    profile.GetRow(type, c.E, row).Get(dist, frac, nullptr, hits.size());
+}
@@ -9,13 +9,104 @@
 #include "PRadHyCalSystem.h"
 #include "PRadHyCalCluster.h"
 #include "PRadInfoCenter.h"
+#include "PRadCalibCache.h"
+#include "PRadGausEstimator.h"
+#include "PRadConfigLoader.h"
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
+#ifdef MULTI_THREAD
+#include <thread>
+#endif
 #include "canalib.h"
+#ifndef PRAD_NO_ROOT
 #include "TFile.h"
 #include "TF1.h"
 #include "TH1D.h"
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PRAD_X86_SIMD
+#include <immintrin.h>
+#endif
+
+typedef PRadGausEstimator::Result GausResult;
+
+// increment the counters of the channel ids, the ids beyond nch are skipped
+static size_t count_scalar(const ADC_Data *data, size_t n, uint32_t *counts, size_t nch)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(data[i].channel_id < nch)
+            counts[data[i].channel_id]++;
+    }
+    return n;
+}
+
+#ifdef PRAD_X86_SIMD
+// avx512 version, 16 data at a time, the counters are gathered, incremented
+// and scattered back, the data with repeated ids go to the scalar version
+__attribute__((target("avx512f,avx512cd")))
+static size_t count_avx512(const ADC_Data *data, size_t n, uint32_t *counts, size_t nch)
+{
+    const __m512i id_mask = _mm512_set1_epi32(0xFFFF);
+    const __m512i nch_v = _mm512_set1_epi32((int)nch);
+    const __m512i one = _mm512_set1_epi32(1);
+
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        // the id is in the lower 16 bits of every data
+        __m512i ids = _mm512_and_si512(_mm512_loadu_si512(&data[i]), id_mask);
+        __mmask16 valid = _mm512_cmplt_epu32_mask(ids, nch_v);
+        __m512i conflict = _mm512_maskz_conflict_epi32(valid, ids);
+        if(_mm512_test_epi32_mask(conflict, conflict)) {
+            count_scalar(&data[i], 16, counts, nch);
+            continue;
+        }
+
+        __m512i vals = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), valid, ids, counts, 4);
+        _mm512_mask_i32scatter_epi32(counts, valid, ids, _mm512_add_epi32(vals, one), 4);
+    }
+    return i;
+}
+
+static bool use_avx512()
+{
+    static const bool res = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd");
+    return res;
+}
+#endif
+
+// call func(i) for i from 0 to n - 1 by several threads
+template<class Func>
+inline void parallel_for(size_t n, unsigned int nthreads, Func func)
+{
+    std::atomic<size_t> next(0);
+    auto work = [&] ()
+                {
+                    size_t i;
+                    while((i = next++) < n)
+                        func(i);
+                };
+
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, n));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(work);
+    work();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    (void) nthreads;
+    work();
+#endif
+}
 
 
 
@@ -25,14 +116,19 @@
 
 // constructor
 PRadHyCalSystem::PRadHyCalSystem(const std::string &path)
-: hycal(new PRadHyCalDetector("HyCal", this))
+: hycal(new PRadHyCalDetector("HyCal", this)), info_center(&PRadInfoCenter::Instance()),
+  reset_all(true)
 {
     // reserve enough buckets for the adc maps
     adc_addr_map.reserve(ADC_BUCKETS);
     adc_name_map.reserve(ADC_BUCKETS);
 
     // initialize energy histogram
+#ifndef PRAD_NO_ROOT
     energy_hist = new TH1D("HyCal Energy", "Total Energy (MeV)", 2000, 0, 2500);
+#else
+    energy_hist = nullptr;
+#endif
 
     if(!path.empty())
         Configure(path);
@@ -42,8 +138,12 @@ PRadHyCalSystem::PRadHyCalSystem(const std::string &path)
 // it does not only copy the members, but also copy the connections between the
 // members
 PRadHyCalSystem::PRadHyCalSystem(const PRadHyCalSystem &that)
-: ConfigObject(that), hycal(nullptr), recon(that.recon), cal_period(that.cal_period)
+: ConfigObject(that), hycal(nullptr), info_center(that.info_center), recon(that.recon),
+  cal_period(that.cal_period), reset_all(true)
 {
+    // the histograms are copied with the buffered counts
+    that.SyncHists();
+
     // copy detector
     if(that.hycal) {
         hycal = new PRadHyCalDetector(*that.hycal);
@@ -51,7 +151,11 @@ PRadHyCalSystem::PRadHyCalSystem(const PRadHyCalSystem &that)
     }
 
     // copy histogram
-    energy_hist = new TH1D(*that.energy_hist);
+#ifndef PRAD_NO_ROOT
+    energy_hist = (TH1*) that.energy_hist->Clone();
+#else
+    energy_hist = nullptr;
+#endif
 
     // copy tdc
     for(auto tdc : that.tdc_list)
@@ -73,14 +177,23 @@ PRadHyCalSystem::PRadHyCalSystem(const PRadHyCalSystem &that)
 
     // build connections between adc channels and modules
     BuildConnections();
+
+    // the layout tables of the methods refer to the modules of the detector
+    if(hycal)
+        recon.UpdateLayout(hycal);
 }
 
 // move constructor
 PRadHyCalSystem::PRadHyCalSystem(PRadHyCalSystem &&that)
-: ConfigObject(that), recon(std::move(that.recon)), cal_period(std::move(that.cal_period)),
+: ConfigObject(that), info_center(that.info_center), recon(std::move(that.recon)),
+  cal_period(std::move(that.cal_period)),
   adc_list(std::move(that.adc_list)), tdc_list(std::move(that.tdc_list)),
+  adc_values(std::move(that.adc_values)), adc_touched(std::move(that.adc_touched)),
+  tdc_table(std::move(that.tdc_table)), reset_all(that.reset_all),
   adc_addr_map(std::move(that.adc_addr_map)), adc_name_map(std::move(that.adc_name_map)),
-  tdc_addr_map(std::move(that.tdc_addr_map)), tdc_name_map(std::move(that.tdc_name_map))
+  tdc_addr_map(std::move(that.tdc_addr_map)), tdc_name_map(std::move(that.tdc_name_map)),
+  adc_addr_table(std::move(that.adc_addr_table)), tdc_addr_table(std::move(that.tdc_addr_table)),
+  sparsifier(std::move(that.sparsifier)), gain_monitor(std::move(that.gain_monitor))
 {
     hycal = that.hycal;
     that.hycal = nullptr;
@@ -88,15 +201,21 @@ PRadHyCalSystem::PRadHyCalSystem(PRadHyCalSystem &&that)
 
     energy_hist = that.energy_hist;
     that.energy_hist = nullptr;
+
+    hist_buffer = std::move(that.hist_buffer);
+    that.hist_buffer = PRadHistBuffer();
 }
 
 // destructor
 PRadHyCalSystem::~PRadHyCalSystem()
 {
     delete hycal;
-    delete energy_hist;
+    // the buffered counts are flushed before the channels are removed
     ClearADCChannel();
     ClearTDCChannel();
+#ifndef PRAD_NO_ROOT
+    delete energy_hist;
+#endif
 }
 
 // copy assignment operator
@@ -120,13 +239,16 @@ PRadHyCalSystem &PRadHyCalSystem::operator =(PRadHyCalSystem &&rhs)
 
     // release memories
     delete hycal;
-    delete energy_hist;
     ClearADCChannel();
     ClearTDCChannel();
+#ifndef PRAD_NO_ROOT
+    delete energy_hist;
+#endif
 
     hycal = rhs.hycal;
     rhs.hycal = nullptr;
     hycal->SetSystem(this, true);
+    info_center = rhs.info_center;
     recon = std::move(rhs.recon);
     energy_hist = rhs.energy_hist;
     rhs.energy_hist = nullptr;
@@ -134,10 +256,20 @@ PRadHyCalSystem &PRadHyCalSystem::operator =(PRadHyCalSystem &&rhs)
 
     adc_list = std::move(rhs.adc_list);
     tdc_list = std::move(rhs.tdc_list);
+    adc_values = std::move(rhs.adc_values);
+    adc_touched = std::move(rhs.adc_touched);
+    tdc_table = std::move(rhs.tdc_table);
+    reset_all = rhs.reset_all;
     adc_addr_map = std::move(rhs.adc_addr_map);
     adc_name_map = std::move(rhs.adc_name_map);
+    adc_addr_table = std::move(rhs.adc_addr_table);
     tdc_addr_map = std::move(rhs.tdc_addr_map);
     tdc_name_map = std::move(rhs.tdc_name_map);
+    tdc_addr_table = std::move(rhs.tdc_addr_table);
+    sparsifier = std::move(rhs.sparsifier);
+    gain_monitor = std::move(rhs.gain_monitor);
+    hist_buffer = std::move(rhs.hist_buffer);
+    rhs.hist_buffer = PRadHistBuffer();
 
     return *this;
 }
@@ -170,6 +302,7 @@ void PRadHyCalSystem::Configure(const std::string &path)
 
     // configurate reconstructor
     recon.Configure(GetConfig<std::string>("Reconstructor Configuration"));
+    recon.UpdateLayout(hycal);
 
     // lamda to help find strings with "key [type]" in configuration
     auto findstr = [&](const std::string &key, const std::string &type)
@@ -177,28 +310,52 @@ void PRadHyCalSystem::Configure(const std::string &path)
                        return GetConfigValue(key + " [" + type + "]");
                    };
 
+    // the profiles, density parameters and calibration periods are independent
+    // files, they are loaded concurrently
+    PRadConfigLoader loader;
+
     // load cluster profile
+    auto profile = recon.GetProfile();
     for(int i = 0; i < static_cast<int>(PRadHyCalModule::Max_Types); ++i)
     {
-        auto value = findstr("Cluster Profile", PRadHyCalModule::Type2str(i));
-        if(!value.IsEmpty())
-            recon.LoadProfile(i, value.String());
+        std::string type_name = PRadHyCalModule::Type2str(i);
+        auto value = findstr("Cluster Profile", type_name);
+        if(!value.IsEmpty()) {
+            std::string path = value.String();
+            loader.Add("Cluster Profile [" + type_name + "]",
+                       [profile, i, path] () {profile->Load(i, path);});
+        }
     }
 
     // load density parameters
+    auto density = recon.GetDensityParams();
     for(int i = 0; i < static_cast<int>(PRadClusterDensity::Max_SetEnums); ++i)
     {
         std::string set_name = PRadClusterDensity::SetEnum2str(i);
-        auto value1 = findstr("Density Profile", set_name);
-        auto value2 = findstr("S-Shape Energy Profile", set_name);
-        recon.LoadDensityParams(i, value1.String(), value2.String());
+        std::string path1 = findstr("Density Profile", set_name).String();
+        std::string path2 = findstr("S-Shape Energy Profile", set_name).String();
+        loader.Add("Density Profile [" + set_name + "]",
+                   [density, i, path1, path2] () {density->Load(i, path1, path2);});
     }
 
     // read calibration period
     std::string file_path = ConfigParser::form_path(
                             GetConfig<std::string>("Calibration Folder"),
                             GetConfig<std::string>("Calibration Period File"));
-    ReadCalPeriodFile(file_path);
+    loader.Add("Calibration Period", [this, file_path] () {ReadCalPeriodFile(file_path);});
+
+    // join before the run files are chosen
+    loader.Wait();
+    recon.ClearCache();
+
+    // database of the run files, the run switches use its cache
+    std::string db_path = getDefConfig<std::string>("Calibration Database", "", false);
+    if(!db_path.empty() && !PRadDBManager::Instance().IsDatabaseOpen())
+        PRadDBManager::Instance().OpenDatabase(db_path);
+
+    // gain monitoring from the LMS events
+    SetGainMonitor(getDefConfig<unsigned int>("Gain Monitor Window", 0, false),
+                   getDefConfig<int>("Gain Monitor Reference", 2, false));
 
     // set run number
     int run_number;
@@ -337,6 +494,12 @@ bool PRadHyCalSystem::ReadChannelList(const std::string &path)
 // build connections between ADC channels and HyCal modules
 void PRadHyCalSystem::BuildConnections()
 {
+    // daq address look-up tables
+    buildChannelTables();
+    UpdateHistLayout();
+    // the channel constants of the reconstructor are rebuilt
+    recon.ClearCache();
+
     if(!hycal) {
         std::cout << "PRad HyCal System Warning: HyCal detector does not exist "
                   << "in the system, abort building connections between ADCs "
@@ -364,7 +527,7 @@ void PRadHyCalSystem::BuildConnections()
 }
 
 // read module status file
-bool PRadHyCalSystem::ReadRunInfoFile(const std::string &path)
+bool PRadHyCalSystem::ReadRunInfoFile(const std::string &path, PRadCalibCache *cache)
 {
     if(path.empty())
         return false;
@@ -422,27 +585,37 @@ bool PRadHyCalSystem::ReadRunInfoFile(const std::string &path)
 
         c_parser >> name >> ped_mean >> ped_sig >> lms_mean >> lms_sig >> status;
 
-        PRadADCChannel *ch = GetADCChannel(name);
-        if(ch) {
-            ch->SetPedestal(ped_mean, ped_sig);
-            ch->SetDead(status&1);
-            PRadHyCalModule *module = ch->GetModule();
-            if(module)
-                module->GainCorrection((lms_mean - ped_mean)/ref_gain[ref], ref);
-        } else {
-            std::cout << "PRad HyCal System Warning: Cannot find ADC Channel "
-                      << name << ", skip status update and gain correction."
-                      << std::endl;
-        }
+        if(cache)
+            cache->AddStatus(name, ped_mean, ped_sig, lms_mean, lms_sig, status);
+
+        setChannelStatus(name, ped_mean, ped_sig, lms_mean, ref_gain[ref], ref, status);
     }
 
-    // finished reading, inform detector to update virtual and dead module neighbors
-    if(hycal)
-        hycal->UpdateDeadModules();
+    if(cache) {
+        cache->SetRefGains(ref, ref_gain);
+        cache->SetInfoRead(true);
+    }
 
+    runInfoUpdated();
     return true;
 }
 
+// update the run information from the records of a cache
+void PRadHyCalSystem::SetRunInfo(const PRadCalibCache &cache)
+{
+    auto &ref_gains = cache.GetRefGains();
+    int ref = ref_gains.ref;
+    auto entries = cache.GetStatus();
+    for(size_t i = 0; i < cache.GetStatusCount(); ++i)
+    {
+        auto &entry = entries[i];
+        setChannelStatus(PRadCalibCache::GetName(entry.name), entry.ped_mean, entry.ped_sigma,
+                         entry.lms_mean, ref_gains.gains[ref], ref, entry.status);
+    }
+
+    runInfoUpdated();
+}
+
 // update the trigger efficiency
 bool PRadHyCalSystem::ReadTriggerEffFile(const std::string &path)
 {
@@ -515,10 +688,10 @@ bool PRadHyCalSystem::ReadCalPeriodFile(const std::string &path)
 // set run number from data file path and update related file
 void PRadHyCalSystem::ChooseRun(const std::string &path, bool verbose)
 {
-    if(PRadInfoCenter::SetRunNumber(path)) {
+    if(info_center->ChangeRunNumber(path)) {
         if(verbose) {
             std::cout << "PRad HyCal System: Set Run Number "
-                      << PRadInfoCenter::GetRunNumber()
+                      << info_center->RunNumber()
                       << std::endl;
         }
         UpdateRunFiles(verbose);
@@ -528,57 +701,85 @@ void PRadHyCalSystem::ChooseRun(const std::string &path, bool verbose)
 // set run number and update related file
 void PRadHyCalSystem::ChooseRun(int run, bool verbose)
 {
-    if(PRadInfoCenter::SetRunNumber(run)) {
+    if(info_center->ChangeRunNumber(run)) {
         if(verbose) {
             std::cout << "PRad HyCal System: Set Run Number "
-                      << PRadInfoCenter::GetRunNumber()
+                      << info_center->RunNumber()
                       << std::endl;
         }
         UpdateRunFiles(verbose);
     }
 }
 
+// set the run information context, nullptr goes back to the global one
+void PRadHyCalSystem::SetInfoCenter(PRadInfoCenter *info)
+{
+    info_center = (info) ? info : &PRadInfoCenter::Instance();
+}
+
 // read run number from information center and update related file
 void PRadHyCalSystem::UpdateRunFiles(bool verbose)
 {
-    int run = PRadInfoCenter::GetRunNumber();
-
-    // update config value first since file path will need them
-    SetConfigValue("Run Number", run);
-
-    auto it = cana::binary_search(cal_period.begin(), cal_period.end(), run);
-    if(it == cal_period.end()) {
-        std::cout << "PRad HyCal System Warning: Cannot find calibration period "
-                  << "for run " << run << ", assuming period 1-1."
-                  << std::endl;
-        SetConfigValue("Period", 1);
-        SetConfigValue("Sub-period", 1);
-    } else {
-        SetConfigValue("Period", it->main);
-        SetConfigValue("Sub-period", it->sub);
+    int run = info_center->RunNumber();
+    auto files = runFiles(run, true);
+    gain_monitor.SetRun(run);
+    const std::string &calib_path = files.calib, &info_path = files.info;
+
+    // records shared by the systems of the process, they may be read ahead
+    auto &db = PRadDBManager::Instance();
+    PRadDBManager::Record record;
+    if(db.IsCacheEnabled())
+        record = db.GetRun(files);
+
+    // binary cache of the two files, it is used if the files are not changed
+    const std::string &cache_dir = GetConfig(run_conf.cache_dir);
+    std::string cache_path;
+    if(!cache_dir.empty() && !record) {
+        cache_path = ConfigParser::form_path(cache_dir,
+                                             "hycal_calib_" + std::to_string(run) + ".bin");
     }
 
-    std::string file_path;
-    // calibration file
-    file_path = ConfigParser::form_path(GetConfig<std::string>("Calibration Folder"),
-                                        GetConfig<std::string>("Calibration File"));
-
-    if(hycal && hycal->ReadCalibrationFile(file_path) && verbose) {
-        std::cout << "PRad HyCal System: Read Calibration File "
-                  << "\"" << file_path << "\""
-                  << std::endl;
-    }
+    PRadCalibCache cache(run);
+    if(record) {
+        if(hycal && record->IsCalibRead())
+            hycal->SetCalibration(*record);
+        if(record->IsInfoRead())
+            SetRunInfo(*record);
+        if(verbose) {
+            std::cout << "PRad HyCal System: Read Run " << run
+                      << " from Calibration Database"
+                      << std::endl;
+        }
+    } else if(!cache_path.empty() && cache.Load(cache_path, run, calib_path, info_path)) {
+        if(hycal && cache.IsCalibRead())
+            hycal->SetCalibration(cache);
+        if(cache.IsInfoRead())
+            SetRunInfo(cache);
+        if(verbose) {
+            std::cout << "PRad HyCal System: Read Calibration Cache "
+                      << "\"" << cache_path << "\""
+                      << std::endl;
+        }
+    } else {
+        cache.Reset(run);
+        PRadCalibCache *rec = (cache_path.empty()) ? nullptr : &cache;
+        if(hycal && hycal->ReadCalibrationFile(calib_path, rec) && verbose) {
+            std::cout << "PRad HyCal System: Read Calibration File "
+                      << "\"" << calib_path << "\""
+                      << std::endl;
+        }
 
-    // run info file
-    // calibration file should be read first, since the gain will be corrected
-    // based on the read calibration constants
-    file_path = ConfigParser::form_path(GetConfig<std::string>("Run Info Folder"),
-                                        GetConfig<std::string>("Run Info File"));
+        // calibration file should be read first, since the gain will be corrected
+        // based on the read calibration constants
+        if(ReadRunInfoFile(info_path, rec) && verbose) {
+            std::cout << "PRad HyCal System: Read Run Info File "
+                      << "\"" << info_path << "\""
+                      << std::endl;
+        }
 
-    if(ReadRunInfoFile(file_path) && verbose) {
-        std::cout << "PRad HyCal System: Read Run Info File "
-                  << "\"" << file_path << "\""
-                  << std::endl;
+        // the cache is regenerated from the text files
+        if(rec && hycal)
+            cache.Save(cache_path, calib_path, info_path);
     }
 
     // choose density profile set for reconstructor
@@ -589,19 +790,48 @@ void PRadHyCalSystem::UpdateRunFiles(bool verbose)
     }
 }
 
+// the run files of the runs are read by the database manager on its thread,
+// the run switches of this system and its copies take them from the cache
+void PRadHyCalSystem::PrefetchRuns(const std::vector<int> &runs)
+{
+    std::vector<PRadDBManager::RunFiles> files;
+    for(auto &run : runs)
+        files.emplace_back(runFiles(run, false));
+
+    // back to the current run
+    runFiles(info_center->RunNumber(), false);
+    PRadDBManager::Instance().Prefetch(files);
+}
+
+// the monitor windows are emitted to its callback while the events are filled
+void PRadHyCalSystem::SetGainMonitor(unsigned int window, int ref)
+{
+    gain_monitor.SetWindow(window);
+    gain_monitor.SetReference(ref);
+    updateGainMonitor();
+    gain_monitor.SetRun(info_center->RunNumber());
+}
+
 // update the event info to DAQ system
 void PRadHyCalSystem::ChooseEvent(const EventData &event)
 {
-    // clear all the channels
-    for(auto &ch : adc_list)
-    {
-        ch->SetValue(0);
-    }
-
-    for(auto &ch : tdc_list)
-    {
-        ch->ClearTimeMeasure();
+    // clear the channels of the last event, or all the channels if they may
+    // have values from elsewhere
+    if(reset_all) {
+        for(auto &ch : adc_list)
+            ch->SetValue(0);
+        adc_values.assign(adc_list.size(), 0);
+        reset_all = false;
+    } else {
+        for(auto &id : adc_touched)
+        {
+            adc_list[id]->SetValue(0);
+            adc_values[id] = 0;
+        }
+        // channels may be added after the last event
+        adc_values.resize(adc_list.size(), 0);
     }
+    adc_touched.clear();
 
     for(auto &adc : event.adc_data)
     {
@@ -609,15 +839,13 @@ void PRadHyCalSystem::ChooseEvent(const EventData &event)
             continue;
 
         adc_list[adc.channel_id]->SetValue(adc.value);
+        adc_values[adc.channel_id] = adc.value;
+        adc_touched.push_back(adc.channel_id);
     }
 
-    for(auto &tdc : event.tdc_data)
-    {
-        if(tdc.channel_id >= tdc_list.size())
-            continue;
-
-        tdc_list[tdc.channel_id]->AddTimeMeasure(tdc.value);
-    }
+    // the tdc values are sorted to the channel slices, it does not go through
+    // the channels
+    tdc_table.Build(event.tdc_data, tdc_list.size());
 }
 
 // reset current histograms and detector status
@@ -630,7 +858,30 @@ void PRadHyCalSystem::Reset()
         adc->Reset();
     for(auto &tdc : tdc_list)
         tdc->Reset();
-    ResetEnergyHist();
+    hist_buffer.Reset();
+    gain_monitor.Reset();
+#ifndef PRAD_NO_ROOT
+    energy_hist->Reset();
+#endif
+}
+
+// the hits are reconstructed by the batch, then put in columns
+void PRadHyCalSystem::ReconstructBatch(const EventData *events, size_t n, HyCalHitSoA &out,
+                                       unsigned int nthreads, ReconStats *stats,
+                                       const PRadCalibSnapshot::Ptr &calib)
+const
+{
+    std::vector<std::vector<HyCalHit>> hits(n);
+    recon.ReconstructBatch(hycal, events, n, hits.data(), nthreads, stats, calib);
+
+    size_t total = 0;
+    for(auto &h : hits)
+        total += h.size();
+
+    out.clear();
+    out.reserve(total);
+    for(size_t i = 0; i < n; ++i)
+        out.Append(hits[i], i);
 }
 
 // add detector, remove the original detector
@@ -651,6 +902,7 @@ void PRadHyCalSystem::RemoveDetector()
         hycal->UnsetSystem(true);
         delete hycal, hycal = nullptr;
     }
+    recon.ClearCache();
 }
 
 void PRadHyCalSystem::DisconnectDetector(bool force_disconn)
@@ -686,6 +938,8 @@ bool PRadHyCalSystem::AddADCChannel(PRadADCChannel *adc)
     adc_list.push_back(adc);
     adc_name_map[adc->GetName()] = adc;
     adc_addr_map[adc->GetAddress()] = adc;
+    adc_addr_table.set(adc->GetAddress(), adc);
+    sparsifier.Update(adc);
     return true;
 }
 
@@ -713,25 +967,37 @@ bool PRadHyCalSystem::AddTDCChannel(PRadTDCChannel *tdc)
     tdc_list.push_back(tdc);
     tdc_name_map[tdc->GetName()] = tdc;
     tdc_addr_map[tdc->GetAddress()] = tdc;
+    tdc_addr_table.set(tdc->GetAddress(), tdc);
     return true;
 }
 
 void PRadHyCalSystem::ClearADCChannel()
 {
+    SyncHists();
     for(auto &adc : adc_list)
         delete adc;
     adc_list.clear();
+    adc_values.clear();
+    adc_touched.clear();
     adc_name_map.clear();
     adc_addr_map.clear();
+    adc_addr_table.clear();
+    sparsifier.Clear();
+    buildHistLayout();
+    recon.ClearCache();
 }
 
 void PRadHyCalSystem::ClearTDCChannel()
 {
+    SyncHists();
     for(auto &tdc : tdc_list)
         delete tdc;
     tdc_list.clear();
+    tdc_table.Clear();
     tdc_name_map.clear();
     tdc_addr_map.clear();
+    tdc_addr_table.clear();
+    buildHistLayout();
 }
 
 PRadHyCalModule *PRadHyCalSystem::GetModule(const int &id)
@@ -776,15 +1042,6 @@ const
     return nullptr;
 }
 
-PRadADCChannel *PRadHyCalSystem::GetADCChannel(const ChannelAddress &addr)
-const
-{
-    auto it = adc_addr_map.find(addr);
-    if(it != adc_addr_map.end())
-        return it->second;
-    return nullptr;
-}
-
 PRadTDCChannel *PRadHyCalSystem::GetTDCChannel(const int &id)
 const
 {
@@ -802,15 +1059,6 @@ const
     return nullptr;
 }
 
-PRadTDCChannel *PRadHyCalSystem::GetTDCChannel(const ChannelAddress &addr)
-const
-{
-    auto it = tdc_addr_map.find(addr);
-    if(it != tdc_addr_map.end())
-        return it->second;
-    return nullptr;
-}
-
 void PRadHyCalSystem::Sparsify(const EventData &event)
 {
     for(auto &adc : event.adc_data)
@@ -820,11 +1068,63 @@ void PRadHyCalSystem::Sparsify(const EventData &event)
     }
 }
 
+// count the channels of an event, the counters are resized to the channels
+void PRadHyCalSystem::CountOccupancy(const EventData &event, std::vector<uint32_t> &counts)
+const
+{
+    if(counts.size() != adc_list.size())
+        counts.resize(adc_list.size(), 0);
+
+    if(!event.adc_data.empty() && !counts.empty())
+        CountOccupancy(&event.adc_data[0], event.adc_data.size(), &counts[0], counts.size());
+}
+
+void PRadHyCalSystem::CountOccupancy(const ADC_Data *data, size_t n, uint32_t *counts, size_t nch)
+{
+    size_t i = 0;
+#ifdef PRAD_X86_SIMD
+    if(use_avx512())
+        i = count_avx512(data, n, counts, nch);
+#endif
+    // the tails
+    count_scalar(data + i, n - i, counts, nch);
+}
+
+// add the flat counters to the channels
+void PRadHyCalSystem::AddOccupancy(const std::vector<uint32_t> &counts)
+{
+    size_t n = std::min(counts.size(), adc_list.size());
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(counts[i])
+            adc_list[i]->AddOccupancy(counts[i]);
+    }
+}
+
+// zero suppression for a bank of adc data, the passed data are compressed to
+// the front in place, return the number of passed data
+size_t PRadHyCalSystem::Sparsify(ADC_Data *data, size_t n)
+{
+    size_t np = sparsifier.Apply(data, n, data);
+
+    for(size_t i = 0; i < np; ++i)
+        adc_list[data[i].channel_id]->Sparsify();
+
+    return np;
+}
+
 double PRadHyCalSystem::GetEnergy(const EventData &event)
 const
+{
+    return GetEnergy(DataRange<ADC_Data>(event.adc_data.data(),
+                                         event.adc_data.data() + event.adc_data.size()));
+}
+
+double PRadHyCalSystem::GetEnergy(const DataRange<ADC_Data> &adcs)
+const
 {
     double energy = 0.;
-    for(auto &adc : event.adc_data)
+    for(auto &adc : adcs)
     {
         if(adc.channel_id >= adc_list.size())
             continue;
@@ -836,63 +1136,134 @@ const
 }
 
 // histogram manipulation
-void PRadHyCalSystem::FillHists(const EventData &event)
+void PRadHyCalSystem::FillEnergyHist()
 {
-    double energy = 0.;
+    if(!hycal)
+        return;
 
-    // adc hists for all types of events
-    for(auto &adc : event.get_adc_data())
-    {
-        if(adc.channel_id >= adc_list.size())
-            continue;
+    hist_buffer.FillEnergy(hycal->GetEnergy());
+}
 
-        PRadADCChannel *channel = adc_list.at(adc.channel_id);
-        channel->FillHist(adc.value, event.get_trigger());
-        energy += channel->GetEnergy(adc.value);
-    }
+void PRadHyCalSystem::FillEnergyHist(const double &e)
+{
+    hist_buffer.FillEnergy(e);
+}
 
-    // energy and tdc for only physics events
-    if(!event.is_physics_event())
-        return;
+void PRadHyCalSystem::FillEnergyHist(const EventData &event)
+{
+    hist_buffer.FillEnergy(GetEnergy(event));
+}
+
+void PRadHyCalSystem::FillEnergyHist(const EventView &event)
+{
+    hist_buffer.FillEnergy(GetEnergy(event.adc_data()));
+}
 
-    energy_hist->Fill(energy);
+void PRadHyCalSystem::ResetEnergyHist()
+{
+    SyncHists();
+#ifndef PRAD_NO_ROOT
+    energy_hist->Reset();
+#endif
+}
+
+// add the histograms from a copy of this system, it is used to collect the
+// results from the systems processing data in parallel
+void PRadHyCalSystem::MergeHists(const PRadHyCalSystem &that)
+{
+    SyncHists();
+    that.SyncHists();
+
+#ifndef PRAD_NO_ROOT
+    energy_hist->Add(that.energy_hist);
+#endif
 
-    for(auto &tdc : event.get_tdc_data())
+    for(auto &adc : adc_list)
     {
-        if(tdc.channel_id >= tdc_list.size())
-            continue;
+        PRadADCChannel *that_adc = that.GetADCChannel(adc->GetName());
+        if(that_adc)
+            adc->MergeHists(*that_adc);
+    }
 
-        PRadTDCChannel *channel = tdc_list.at(tdc.channel_id);
-        channel->FillHist(tdc.value);
+    for(auto &tdc : tdc_list)
+    {
+        PRadTDCChannel *that_tdc = that.GetTDCChannel(tdc->GetName());
+        if(that_tdc)
+            tdc->MergeHists(*that_tdc);
     }
 }
 
-void PRadHyCalSystem::FillEnergyHist()
+// rebuild the histogram buffer from the current channels and histograms, it
+// should be called if the histograms of the channels are changed
+void PRadHyCalSystem::UpdateHistLayout()
 {
-    if(!hycal)
-        return;
+    SyncHists();
+    buildHistLayout();
+}
 
-    energy_hist->Fill(hycal->GetEnergy());
+// memory held by the histograms of the channels and the detector hits
+MemoryUsage PRadHyCalSystem::GetMemoryUsage()
+const
+{
+    MemoryUsage res;
+    for(auto &adc : adc_list)
+    {
+        for(auto &hist : adc->GetHistList())
+            res.Add(hist);
+    }
+
+    for(auto &tdc : tdc_list)
+        res.Add(tdc->GetHist());
+
+    res.Add(energy_hist);
+    if(hycal)
+        res.Add(hycal->GetHits());
+    return res;
 }
 
-void PRadHyCalSystem::FillEnergyHist(const double &e)
+// the histograms are copied at once, so they can be reset or filled for the
+// next run while the file is being written
+bool PRadHyCalSystem::SaveHistSnapshot(const std::string &path)
+const
 {
-    energy_hist->Fill(e);
+    return SnapshotHists().Save(path);
 }
 
-void PRadHyCalSystem::FillEnergyHist(const EventData &event)
+std::future<bool> PRadHyCalSystem::SaveHistsAsync(const std::string &path)
+const
 {
-    energy_hist->Fill(GetEnergy(event));
+    return SnapshotHists().ExportROOTAsync(path);
 }
 
-void PRadHyCalSystem::ResetEnergyHist()
+#ifndef PRAD_NO_ROOT
+// the channels are saved in the order of their names, and the numbers in the
+// names, such as W1, W2, ..., W10
+static int channel_number(const PRadDAQChannel &ch)
 {
-    energy_hist->Reset();
+    int id = ch.GetName().at(0)*10000;
+
+    size_t i = 1;
+    for(; i < ch.GetName().size(); ++i)
+    {
+       if(isdigit(ch.GetName().at(i)))
+           break;
+    }
+    if(i < ch.GetName().size())
+        id += std::stoi(ch.GetName().substr(i));
+
+    return id;
+}
+
+static bool channel_order(const PRadDAQChannel *a, const PRadDAQChannel *b)
+{
+    return channel_number(*a) < channel_number(*b);
 }
 
 void PRadHyCalSystem::SaveHists(const std::string &path)
 const
 {
+    SyncHists();
+
     TFile f(path.c_str(), "recreate");
 
     energy_hist->Write();
@@ -901,27 +1272,9 @@ const
     TDirectory *cur_dir = f.mkdir("TDC Histograms");
     cur_dir->cd();
 
-    auto ch_id = [] (const PRadDAQChannel &ch)
-                 {
-                     int id = ch.GetName().at(0)*10000;
-
-                     size_t i = 1;
-                     for(; i < ch.GetName().size(); ++i)
-                     {
-                        if(isdigit(ch.GetName().at(i)))
-                            break;
-                     }
-                     if(i < ch.GetName().size())
-                         id += std::stoi(ch.GetName().substr(i));
-
-                     return id;
-                 };
-    auto ch_order = [ch_id] (const PRadDAQChannel *a, const PRadDAQChannel *b)
-                    {return ch_id(*a) < ch_id(*b);};
-
     // copy the tdc list
     auto tlist = tdc_list;
-    std::sort(tlist.begin(), tlist.end(), ch_order);
+    std::sort(tlist.begin(), tlist.end(), channel_order);
 
     for(auto tdc : tlist)
     {
@@ -935,7 +1288,7 @@ const
 
     // copy the adc list
     auto ch_list = adc_list;
-    std::sort(ch_list.begin(), ch_list.end(), ch_order);
+    std::sort(ch_list.begin(), ch_list.end(), channel_order);
 
     TDirectory *mod_dir[PRadHyCalModule::Max_Types];
     for(int i = 0; i < (int) PRadHyCalModule::Max_Types; ++i)
@@ -966,6 +1319,38 @@ const
     f.Close();
 }
 
+// the same directories and order as SaveHists
+PRadHistSnapshot PRadHyCalSystem::SnapshotHists()
+const
+{
+    SyncHists();
+
+    PRadHistSnapshot snap;
+    snap.Add("", energy_hist);
+
+    auto tlist = tdc_list;
+    std::sort(tlist.begin(), tlist.end(), channel_order);
+    for(auto tdc : tlist)
+        snap.Add("TDC Histograms", tdc->GetHist());
+
+    auto ch_list = adc_list;
+    std::sort(ch_list.begin(), ch_list.end(), channel_order);
+    for(auto channel : ch_list)
+    {
+        std::string dir = "ADC Histograms/";
+        if(!channel->GetModule() || channel->GetModule()->GetType() < 0)
+            dir += "Others/";
+        else
+            dir += PRadHyCalModule::Type2str(channel->GetModule()->GetType()) + "/";
+        dir += channel->GetName();
+
+        for(auto hist : channel->GetHistList())
+            snap.Add(dir, hist);
+    }
+
+    return snap;
+}
+
 std::vector<double> PRadHyCalSystem::FitHist(const std::string &channel,
                                              const std::string &hist_name,
                                              const std::string &fit_function,
@@ -975,6 +1360,8 @@ std::vector<double> PRadHyCalSystem::FitHist(const std::string &channel,
 const
 throw(PRadException)
 {
+    SyncHists();
+
     PRadADCChannel *ch = GetADCChannel(channel);
     if(!ch) {
         throw PRadException("Fit Histogram Failure", "Channel " + channel + " does not exist!");
@@ -1020,26 +1407,57 @@ throw(PRadException)
     return result;
 }
 
-void PRadHyCalSystem::FitPedestal()
+void PRadHyCalSystem::FitPedestal(bool root_fit, unsigned int nthreads)
 {
-    for(auto &channel : adc_list)
-    {
-        TH1 *ped_hist = channel->GetHist("Pedestal");
+    SyncHists();
 
-        if(ped_hist == nullptr || ped_hist->Integral() < 1000)
-            continue;
+    // ROOT fits are not thread safe
+    if(root_fit) {
+        for(auto &channel : adc_list)
+        {
+            TH1 *ped_hist = channel->GetHist("Pedestal");
+
+            if(ped_hist == nullptr || ped_hist->Integral() < 1000)
+                continue;
+
+            ped_hist->Fit("gaus", "qww");
+
+            TF1 *myfit = (TF1*) ped_hist->GetFunction("gaus");
+            double p0 = myfit->GetParameter(1);
+            double p1 = myfit->GetParameter(2);
 
-        ped_hist->Fit("gaus", "qww");
+            channel->SetPedestal(p0, p1);
+        }
 
-        TF1 *myfit = (TF1*) ped_hist->GetFunction("gaus");
-        double p0 = myfit->GetParameter(1);
-        double p1 = myfit->GetParameter(2);
+        UpdateSparsifier();
+        recon.ClearCache();
+        return;
+    }
+
+    std::vector<GausResult> peds(adc_list.size());
+    parallel_for(adc_list.size(), nthreads,
+                 [&] (size_t i)
+                 {
+                     const TH1 *ped_hist = adc_list[i]->GetHist("Pedestal");
+                     if(ped_hist) {
+                         peds[i] = PRadGausEstimator::Estimate(ped_hist,
+                                                               ped_hist->GetXaxis()->GetXmin(),
+                                                               ped_hist->GetXaxis()->GetXmax(),
+                                                               1000);
+                     }
+                 });
 
-        channel->SetPedestal(p0, p1);
+    for(size_t i = 0; i < adc_list.size(); ++i)
+    {
+        if(peds[i].valid)
+            adc_list[i]->SetPedestal(peds[i].mean, peds[i].sigma);
     }
+
+    UpdateSparsifier();
+    recon.ClearCache();
 }
 
-void PRadHyCalSystem::CorrectGainFactor(int ref)
+void PRadHyCalSystem::CorrectGainFactor(int ref, bool root_fit, unsigned int nthreads)
 {
 // We had some reference PMT shifts, one happened at run 1228
 // If try to do the gain correction that the PMT shifts happened between, it
@@ -1048,6 +1466,8 @@ void PRadHyCalSystem::CorrectGainFactor(int ref)
 #define PED_LED_HYC 30 // separation value for led signal and pedestal signal of all HyCal Modules
 
 
+    SyncHists();
+
     std::string reference = "LMS" + std::to_string(ref);
 
     // firstly, get the reference factor from LMS PMT
@@ -1084,44 +1504,59 @@ void PRadHyCalSystem::CorrectGainFactor(int ref)
         return;
     }
 
-    // lamda expression, fit a gaussian and return the mean value
-    auto fit_gaussian = [] (TH1* hist,
-                            const int &range_min = 0,
-                            const int &range_max = 8191,
-                            const double &warn_ratio = 0.06)
+    // lamda expression, get the gaussian peak in the range
+    // the estimation only reads the histogram, but ROOT fit changes it
+    auto fit_gaussian = [root_fit] (TH1* hist,
+                                    const int &range_min = 0,
+                                    const int &range_max = 8191)
                         {
+                            if(!root_fit)
+                                return PRadGausEstimator::Estimate(hist, range_min, range_max, 1000);
+
+                            GausResult res;
                             int beg_bin = hist->GetXaxis()->FindBin(range_min);
                             int end_bin = hist->GetXaxis()->FindBin(range_max) - 1;
 
-                            if(hist->Integral(beg_bin, end_bin) < 1000) {
-                                std::cout << "PRad HyCal System Warning: "
-                                          << "Not enough entries in histogram "
-                                          << hist->GetName()
-                                          << ". Abort fitting!"
-                                          << std::endl;
-                                return 0.;
-                            }
+                            res.entries = hist->Integral(beg_bin, end_bin);
+                            if(res.entries < 1000)
+                                return res;
 
                             TF1 *fit = new TF1("tmpfit", "gaus", range_min, range_max);
 
                             hist->Fit(fit, "qR");
                             TF1 *hist_fit = hist->GetFunction("tmpfit");
-                            double mean = hist_fit->GetParameter(1);
-                            double sigma = hist_fit->GetParameter(2);
-                            if(sigma/mean > warn_ratio) {
-                                std::cout << "PRad HyCal System Warning: "
-                                          << "Bad fit for " << hist->GetTitle()
-                                          << ". Mean: " << mean
-                                          << ", sigma: " << sigma
-                                          << std::endl;
-                            }
+                            res.mean = hist_fit->GetParameter(1);
+                            res.sigma = hist_fit->GetParameter(2);
+                            res.valid = true;
                             delete fit;
-                            return mean;
+                            return res;
                         };
 
-    double ped_mean = fit_gaussian(ref_alpha, 0, PED_LED_REF, 0.02);
-    double alpha_mean = fit_gaussian(ref_alpha, PED_LED_REF + 1, 8191, 0.05);
-    double led_mean = fit_gaussian(ref_led);
+    // lamda expression, check the peak and return the mean value
+    auto peak_mean = [] (TH1* hist, const GausResult &res, const double &warn_ratio = 0.06)
+                     {
+                         if(!res.valid) {
+                             std::cout << "PRad HyCal System Warning: "
+                                       << "Not enough entries in histogram "
+                                       << hist->GetName()
+                                       << ". Abort fitting!"
+                                       << std::endl;
+                             return 0.;
+                         }
+
+                         if(res.sigma/res.mean > warn_ratio) {
+                             std::cout << "PRad HyCal System Warning: "
+                                       << "Bad fit for " << hist->GetTitle()
+                                       << ". Mean: " << res.mean
+                                       << ", sigma: " << res.sigma
+                                       << std::endl;
+                         }
+                         return res.mean;
+                     };
+
+    double ped_mean = peak_mean(ref_alpha, fit_gaussian(ref_alpha, 0, PED_LED_REF), 0.02);
+    double alpha_mean = peak_mean(ref_alpha, fit_gaussian(ref_alpha, PED_LED_REF + 1, 8191), 0.05);
+    double led_mean = peak_mean(ref_led, fit_gaussian(ref_led));
 
     if(ped_mean == 0. || alpha_mean == 0. || led_mean == 0.) {
         std::cerr << "PRad HyCal System Error: Failed to get gain factor from "
@@ -1132,8 +1567,19 @@ void PRadHyCalSystem::CorrectGainFactor(int ref)
 
     double ref_factor = (led_mean - ped_mean)/(alpha_mean - ped_mean);
 
-    for(auto channel : adc_list)
+    // led signals of all channels, the messages are printed in order afterwards
+    std::vector<GausResult> leds(adc_list.size());
+    parallel_for(adc_list.size(), (root_fit) ? 1 : nthreads,
+                 [&] (size_t i)
+                 {
+                     TH1 *hist = adc_list[i]->GetHist("LMS");
+                     if(adc_list[i]->GetModule() && hist)
+                         leds[i] = fit_gaussian(hist);
+                 });
+
+    for(size_t i = 0; i < adc_list.size(); ++i)
     {
+        PRadADCChannel *channel = adc_list[i];
         PRadHyCalModule *module = channel->GetModule();
         if(!module)
             continue;
@@ -1142,7 +1588,7 @@ void PRadHyCalSystem::CorrectGainFactor(int ref)
         if(!hist)
             continue;
 
-        double ch_led = fit_gaussian(hist) - channel->GetPedestal().mean;
+        double ch_led = peak_mean(hist, leds[i]) - channel->GetPedestal().mean;
 
         if(ch_led > PED_LED_HYC) {// meaningful led signal
             module->GainCorrection(ch_led/ref_factor, ref);
@@ -1153,5 +1599,226 @@ void PRadHyCalSystem::CorrectGainFactor(int ref)
                       << std::endl;
         }
     }
+    // the gain factors are changed
+    recon.ClearCache();
 }
 
+PRadHyCalSystem::GainTable PRadHyCalSystem::ExtractGains(unsigned int nthreads)
+const
+{
+    SyncHists();
+
+    GainTable table;
+    table.run = info_center->RunNumber();
+    table.channels.resize(adc_list.size());
+
+    parallel_for(adc_list.size(), nthreads,
+                 [&] (size_t i)
+                 {
+                     PRadADCChannel *channel = adc_list[i];
+                     GainEntry &entry = table.channels[i];
+                     entry.name = channel->GetName();
+
+                     const TH1 *led_hist = channel->GetHist("LMS");
+                     if(led_hist)
+                         entry.lms = PRadGausEstimator::Estimate(led_hist, 0, 8191, 1000);
+
+                     // reference pmt has both pedestal and alpha source signals
+                     // in the physics histogram
+                     if(entry.name.find("LMS") == 0) {
+                         const TH1 *alpha_hist = channel->GetHist("Physics");
+                         if(alpha_hist) {
+                             entry.ped = PRadGausEstimator::Estimate(alpha_hist, 0, PED_LED_REF, 1000);
+                             entry.alpha = PRadGausEstimator::Estimate(alpha_hist, PED_LED_REF + 1,
+                                                                       8191, 1000);
+                         }
+                         return;
+                     }
+
+                     const TH1 *ped_hist = channel->GetHist("Pedestal");
+                     if(ped_hist) {
+                         entry.ped = PRadGausEstimator::Estimate(ped_hist,
+                                                                 ped_hist->GetXaxis()->GetXmin(),
+                                                                 ped_hist->GetXaxis()->GetXmax(),
+                                                                 1000);
+                     }
+                 });
+
+    // reference gains in the order of LMS1, LMS2, ...
+    for(auto &entry : table.channels)
+    {
+        if(entry.name.find("LMS") != 0)
+            continue;
+
+        int ref = ConfigParser::find_integer(entry.name);
+        if(ref <= 0)
+            continue;
+
+        if((int) table.ref_gains.size() < ref)
+            table.ref_gains.resize(ref, 0.);
+
+        if(entry.ped.valid && entry.alpha.valid && entry.lms.valid &&
+           entry.alpha.mean > entry.ped.mean) {
+            table.ref_gains[ref - 1] = (entry.lms.mean - entry.ped.mean)/
+                                       (entry.alpha.mean - entry.ped.mean);
+        }
+    }
+
+    return table;
+}
+
+#else // PRAD_NO_ROOT
+
+// the histograms and fits are only available with ROOT
+static void no_root_error(const char *func)
+{
+    std::cerr << "PRad HyCal System Error: " << func << " requires the "
+              << "histograms, which are not available without ROOT."
+              << std::endl;
+}
+
+void PRadHyCalSystem::SaveHists(const std::string &)
+const
+{
+    no_root_error("SaveHists");
+}
+
+PRadHistSnapshot PRadHyCalSystem::SnapshotHists()
+const
+{
+    no_root_error("SnapshotHists");
+    return PRadHistSnapshot();
+}
+
+std::vector<double> PRadHyCalSystem::FitHist(const std::string &channel,
+                                             const std::string &,
+                                             const std::string &,
+                                             const double &,
+                                             const double &,
+                                             const bool &)
+const
+throw(PRadException)
+{
+    throw PRadException("Fit Histogram Failure", "No histogram of channel " + channel
+                        + " without ROOT!");
+}
+
+void PRadHyCalSystem::FitPedestal(bool, unsigned int)
+{
+    no_root_error("FitPedestal");
+}
+
+void PRadHyCalSystem::CorrectGainFactor(int, bool, unsigned int)
+{
+    no_root_error("CorrectGainFactor");
+}
+
+PRadHyCalSystem::GainTable PRadHyCalSystem::ExtractGains(unsigned int)
+const
+{
+    no_root_error("ExtractGains");
+
+    GainTable table;
+    table.run = info_center->RunNumber();
+    return table;
+}
+
+#endif // PRAD_NO_ROOT
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// build the dense daq address tables from the channel lists
+void PRadHyCalSystem::buildChannelTables()
+{
+    adc_addr_table.build(adc_list);
+    tdc_addr_table.build(tdc_list);
+    sparsifier.Build(adc_list);
+    updateGainMonitor();
+}
+
+// update the status of a channel and the gain of its module
+void PRadHyCalSystem::setChannelStatus(const std::string &name, double ped_mean, double ped_sig,
+                                       double lms_mean, double ref_gain, int ref,
+                                       unsigned int status)
+{
+    PRadADCChannel *ch = GetADCChannel(name);
+    if(ch) {
+        ch->SetPedestal(ped_mean, ped_sig);
+        ch->SetDead(status&1);
+        PRadHyCalModule *module = ch->GetModule();
+        if(module)
+            module->GainCorrection((lms_mean - ped_mean)/ref_gain, ref);
+    } else {
+        std::cout << "PRad HyCal System Warning: Cannot find ADC Channel "
+                  << name << ", skip status update and gain correction."
+                  << std::endl;
+    }
+}
+
+// the run information is updated
+void PRadHyCalSystem::runInfoUpdated()
+{
+    // pedestals are changed
+    UpdateSparsifier();
+    recon.ClearCache();
+    updateGainMonitor();
+
+    // finished reading, inform detector to update virtual and dead module neighbors
+    if(hycal)
+        hycal->UpdateDeadModules();
+}
+
+// set the run and period config values, the file paths depend on them
+PRadDBManager::RunFiles PRadHyCalSystem::runFiles(int run, bool verbose)
+{
+    SetConfigValue(run_conf.run, run);
+
+    auto it = cana::fast_binary_search(cal_period.begin(), cal_period.end(), run);
+    if(it == cal_period.end()) {
+        if(verbose) {
+            std::cout << "PRad HyCal System Warning: Cannot find calibration period "
+                      << "for run " << run << ", assuming period 1-1."
+                      << std::endl;
+        }
+        SetConfigValue(run_conf.period, 1);
+        SetConfigValue(run_conf.sub_period, 1);
+    } else {
+        SetConfigValue(run_conf.period, it->main);
+        SetConfigValue(run_conf.sub_period, it->sub);
+    }
+
+    return PRadDBManager::RunFiles(run,
+                                   ConfigParser::form_path(GetConfig(run_conf.calib_dir),
+                                                           GetConfig(run_conf.calib_file)),
+                                   ConfigParser::form_path(GetConfig(run_conf.info_dir),
+                                                           GetConfig(run_conf.info_file)));
+}
+
+// the channels and pedestals of the gain monitor
+void PRadHyCalSystem::updateGainMonitor()
+{
+    if(!gain_monitor.IsEnabled())
+        return;
+
+    std::vector<PRadGainMonitor::Channel> channels;
+    for(auto &adc : adc_list)
+    {
+        PRadGainMonitor::Channel ch;
+        ch.name = adc->GetName();
+        ch.ped = adc->GetPedestal().mean;
+        ch.ref = (ch.name.find("LMS") == 0) ? ConfigParser::find_integer(ch.name) - 1 : -1;
+        ch.module = adc->GetModule() != nullptr;
+        channels.emplace_back(std::move(ch));
+    }
+    gain_monitor.SetChannels(channels);
+}
+
+// build the histogram buffer, the buffered counts are discarded
+void PRadHyCalSystem::buildHistLayout()
+{
+    hist_buffer = PRadHistBuffer(PRadHistBuffer::BuildLayout(adc_list, tdc_list, energy_hist));
+}
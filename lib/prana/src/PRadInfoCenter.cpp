@@ -1,6 +1,10 @@
 //============================================================================//
-// A singleton class that stores and manages the run information or online    //
-// information, it can be shared through all the classes                      //
+// A class that stores and manages the run information and online information //
+// The global instance can be shared through all the classes, and separate    //
+// instances serve as the contexts of the pipelines running in parallel       //
+// Run counters are atomic, threads may also accumulate their own counters    //
+// and merge them to the context at the end, a sequence counter lets the      //
+// readers take consistent snapshots without blocking the merges              //
 // TODO merge live_scaled_charge into RunInfo                                 //
 // It may change existing DST file parsing, so need a careful treatment       //
 //                                                                            //
@@ -12,9 +16,50 @@
 #include "ConfigParser.h"
 #include <iostream>
 
+// add a value to atomic double
+static inline void atomic_add(std::atomic<double> &val, const double &inc)
+{
+    double cur = val.load(std::memory_order_relaxed);
+    while(!val.compare_exchange_weak(cur, cur + inc, std::memory_order_relaxed))
+    {
+        // cur is updated by the failed exchange
+    }
+}
+
+
+
+//============================================================================//
+// Run Counter                                                                //
+//============================================================================//
+
+// accumulate the counters from a synchronization event
+void PRadInfoCenter::RunCounter::Add(const EventData &event)
+{
+    // only collect run information for physics synchronization events
+    if(event.get_type() != CODA_Sync || !event.is_physics_event())
+        return;
+
+    double charge = event.get_beam_charge();
+    unsigned int dead = event.get_ref_channel().gated_count;
+    unsigned int total = event.get_ref_channel().ungated_count;
+
+    beam_charge += charge;
+    dead_count += dead;
+    ungated_count += total;
+    if(total)
+        live_charge += charge * (1. - (double)dead/(double)total);
+}
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
 // add the trigger channels
 PRadInfoCenter::PRadInfoCenter()
-: live_scaled_charge(0)
+: run_number(0), beam_charge(0.), live_charge(0.), dead_count(0), ungated_count(0),
+  counter_seq(0)
 {
     online_info.add_trigger("Lead Glass Sum", PHYS_LeadGlassSum);
     online_info.add_trigger("Total Sum", PHYS_TotalSum);
@@ -24,25 +69,46 @@ PRadInfoCenter::PRadInfoCenter()
     online_info.add_trigger("Scintillator", PHYS_Scintillator);
 }
 
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
 // clear all the information
 void PRadInfoCenter::Reset()
 {
-    run_info.reset();
+    run_number = 0;
+    setCounter(RunCounter(), false);
+
+    std::lock_guard<std::mutex> lock(online_locker);
     online_info.reset();
-    live_scaled_charge = 0.;
 }
 
 // update information from event data
 void PRadInfoCenter::UpdateInfo(const EventData &event)
+{
+    UpdateOnlineInfo(event);
+
+    RunCounter counter;
+    counter.Add(event);
+    if(!counter.empty())
+        Merge(counter);
+}
+
+// update online information from event data
+void PRadInfoCenter::UpdateOnlineInfo(const EventData &event)
 {
     // only synchronization event contains the following information
     // this is by the design of our DAQ system
     if(event.get_type() != CODA_Sync)
         return;
 
+    std::lock_guard<std::mutex> lock(online_locker);
+
     // online information update, update to the latest values
     // update triggers
-    for(auto trg_ch : online_info.trigger_info)
+    for(auto &trg_ch : online_info.trigger_info)
     {
         if(trg_ch.id < event.dsc_data.size())
         {
@@ -67,69 +133,171 @@ void PRadInfoCenter::UpdateInfo(const EventData &event)
 
     //update beam current
     online_info.beam_current = event.get_beam_current();
+}
 
-    // run information, accu
-    // only collect run information for physics events
-    if(!event.is_physics_event())
+// add the counters accumulated by a thread
+void PRadInfoCenter::Merge(const RunCounter &counter)
+{
+    setCounter(counter, true);
+}
+
+// merge the information from another context that processed a part of the
+// same run, run information is accumulated, and online information is taken
+// from the other context since it is the latest
+void PRadInfoCenter::Merge(const PRadInfoCenter &that)
+{
+    if(this == &that)
         return;
 
-    double beam_charge = event.get_beam_charge();
-    unsigned int dead_count = event.get_ref_channel().gated_count;
-    unsigned int total_count = event.get_ref_channel().ungated_count;
-    run_info.beam_charge += beam_charge;
-    run_info.ungated_count += total_count;
-    run_info.dead_count += dead_count;
-    live_scaled_charge += beam_charge * (1. - (double)dead_count/(double)total_count);
+    int run = 0;
+    run_number.compare_exchange_strong(run, that.RunNumber());
+
+    Merge(that.GetRunCounter());
+
+    SetOnlineInfo(that.GetOnlineInfo());
 }
 
-// set run number
-bool PRadInfoCenter::SetRunNumber(int run)
+// set run information, the live scaled charge is not included
+void PRadInfoCenter::SetRunInfo(const RunInfo &info)
+{
+    run_number = info.run_number;
+
+    // live charge is kept
+    RunCounter counter;
+    counter.beam_charge = info.beam_charge;
+    counter.live_charge = live_charge.load();
+    counter.dead_count = (uint64_t)info.dead_count;
+    counter.ungated_count = (uint64_t)info.ungated_count;
+    setCounter(counter, false);
+}
+
+void PRadInfoCenter::SetOnlineInfo(const OnlineInfo &info)
+{
+    std::lock_guard<std::mutex> lock(online_locker);
+    online_info = info;
+}
+
+// snapshot of the run counters, retry if there is an update in between
+PRadInfoCenter::RunCounter PRadInfoCenter::GetRunCounter()
+const
 {
-    if(Instance().run_info.run_number != run) {
-        Instance().run_info.run_number = run;
-        return true;
+    RunCounter counter;
+    while(true)
+    {
+        uint64_t seq = counter_seq.load(std::memory_order_acquire);
+        if(seq & 1)
+            continue;
+
+        counter.beam_charge = beam_charge.load(std::memory_order_relaxed);
+        counter.live_charge = live_charge.load(std::memory_order_relaxed);
+        counter.dead_count = dead_count.load(std::memory_order_relaxed);
+        counter.ungated_count = ungated_count.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(counter_seq.load(std::memory_order_relaxed) == seq)
+            return counter;
     }
+}
+
+// snapshot of the run information
+RunInfo PRadInfoCenter::GetRunInfo()
+const
+{
+    RunCounter counter = GetRunCounter();
+    return RunInfo(run_number.load(), counter.beam_charge,
+                   (double)counter.dead_count, (double)counter.ungated_count);
+}
+
+// snapshot of the online information
+OnlineInfo PRadInfoCenter::GetOnlineInfo()
+const
+{
+    std::lock_guard<std::mutex> lock(online_locker);
+    return online_info;
+}
+
+// change run number of this context
+bool PRadInfoCenter::ChangeRunNumber(int run)
+{
+    return run_number.exchange(run) != run;
+}
+
+// change run number of this context from file path
+bool PRadInfoCenter::ChangeRunNumber(const std::string &path)
+{
+    std::string file_name = ConfigParser::decompose_path(path).name;
+    int run = ConfigParser::find_integer(file_name);
+
+    if(run > 0)
+        return ChangeRunNumber(run);
 
     return false;
 }
 
+// live time of this context
+double PRadInfoCenter::LiveTime()
+const
+{
+    return GetRunCounter().live_time();
+}
+
+// add or overwrite the run counters, the sequence marks the update for the
+// readers
+void PRadInfoCenter::setCounter(const RunCounter &counter, bool add)
+{
+    std::lock_guard<std::mutex> lock(counter_locker);
+
+    uint64_t seq = counter_seq.load(std::memory_order_relaxed);
+    counter_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if(add) {
+        atomic_add(beam_charge, counter.beam_charge);
+        atomic_add(live_charge, counter.live_charge);
+        dead_count.fetch_add(counter.dead_count, std::memory_order_relaxed);
+        ungated_count.fetch_add(counter.ungated_count, std::memory_order_relaxed);
+    } else {
+        beam_charge.store(counter.beam_charge, std::memory_order_relaxed);
+        live_charge.store(counter.live_charge, std::memory_order_relaxed);
+        dead_count.store(counter.dead_count, std::memory_order_relaxed);
+        ungated_count.store(counter.ungated_count, std::memory_order_relaxed);
+    }
+
+    counter_seq.store(seq + 2, std::memory_order_release);
+}
+
+// set run number
+bool PRadInfoCenter::SetRunNumber(int run)
+{
+    return Instance().ChangeRunNumber(run);
+}
+
 // get run number
 int PRadInfoCenter::GetRunNumber()
 {
-    return Instance().run_info.run_number;
+    return Instance().RunNumber();
 }
 
 // get beam charge
 double PRadInfoCenter::GetBeamCharge()
 {
-    return Instance().run_info.beam_charge;
+    return Instance().BeamCharge();
 }
 
 // get beam charge scaled by live time
 double PRadInfoCenter::GetLiveBeamCharge()
 {
-    return Instance().live_scaled_charge;
+    return Instance().LiveBeamCharge();
 }
 
 // get live time
 double PRadInfoCenter::GetLiveTime()
 {
-    const RunInfo &run = Instance().run_info;
-    if(!run.ungated_count)
-        return 0.;
-    return (1. - (double)run.dead_count/(double)run.ungated_count);
-};
+    return Instance().LiveTime();
+}
 
 // set run number from file path
 bool PRadInfoCenter::SetRunNumber(const std::string &path)
 {
-    std::string file_name = ConfigParser::decompose_path(path).name;
-    int run = ConfigParser::find_integer(file_name);
-
-    if(run > 0 && Instance().run_info.run_number != run) {
-        Instance().run_info.run_number = run;
-        return true;
-    }
-
-    return false;
+    return Instance().ChangeRunNumber(path);
 }
@@ -0,0 +1,251 @@
+//============================================================================//
+// Binary snapshot of the initialization by data                              //
+// The pedestals and gain factors from the first events of a run are saved    //
+// with the checksum of the data file, the next initialization by the same    //
+// file restores them instead of decoding and fitting again                   //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadInitSnapshot.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadDSTParser.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+
+static const char snapshot_magic[8] = {'P', 'R', 'A', 'D', 'I', 'N', 'I', '\0'};
+
+// copy the name to the fixed size array
+inline void copy_name(char *dst, const std::string &name)
+{
+    memset(dst, 0, CALIB_CACHE_NAME);
+    strncpy(dst, name.c_str(), CALIB_CACHE_NAME - 1);
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadInitSnapshot::PRadInitSnapshot()
+{
+    // place holder
+}
+
+PRadInitSnapshot::~PRadInitSnapshot()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+void PRadInitSnapshot::Clear()
+{
+    source = Source();
+    adc_entries.clear();
+    module_entries.clear();
+    apv_entries.clear();
+}
+
+void PRadInitSnapshot::Take(const Source &src, const PRadHyCalSystem *hycal,
+                            const PRadGEMSystem *gem)
+{
+    Clear();
+    source = src;
+
+    if(hycal) {
+        for(auto &channel : hycal->GetADCList())
+        {
+            ADCEntry entry;
+            copy_name(entry.name, channel->GetName());
+            entry.ped_mean = channel->GetPedestal().mean;
+            entry.ped_sigma = channel->GetPedestal().sigma;
+            adc_entries.push_back(entry);
+        }
+
+        for(auto &module : hycal->GetModuleList())
+        {
+            ModuleEntry entry;
+            copy_name(entry.name, module->GetName());
+            entry.base_factor = module->GetCalibConst().GetBaseConst();
+            entry.factor = module->GetCalibConst().GetCalibConst();
+            module_entries.push_back(entry);
+        }
+    }
+
+    if(gem) {
+        for(auto &apv : gem->GetAPVList())
+        {
+            APVEntry entry;
+            entry.fec = apv->GetFECID();
+            entry.adc = apv->GetADCChannel();
+            auto peds = apv->GetPedestalList();
+            for(size_t i = 0; i < peds.size() && i < APV_CHANNEL_SIZE; ++i)
+                entry.pedestal[i] = peds[i];
+            apv_entries.push_back(entry);
+        }
+    }
+}
+
+// the entries are matched by names and addresses, the ones not found in the
+// systems are skipped
+void PRadInitSnapshot::Apply(PRadHyCalSystem *hycal, PRadGEMSystem *gem)
+const
+{
+    if(hycal) {
+        for(auto &entry : adc_entries)
+        {
+            PRadADCChannel *channel = hycal->GetADCChannel(PRadCalibCache::GetName(entry.name));
+            if(channel)
+                channel->SetPedestal(entry.ped_mean, entry.ped_sigma);
+        }
+
+        for(auto &entry : module_entries)
+        {
+            PRadHyCalModule *module = hycal->GetModule(PRadCalibCache::GetName(entry.name));
+            if(!module || module->GetCalibConst().GetBaseConst() != entry.base_factor)
+                continue;
+
+            PRadCalibConst cal = module->GetCalibConst();
+            cal.SetCorrectedConst(entry.factor);
+            module->SetCalibConst(cal);
+        }
+
+        // the pedestals and gain factors are changed
+        hycal->UpdateSparsifier();
+        hycal->GetReconstructor()->ClearCache();
+    }
+
+    if(gem) {
+        gem->ClearCache();
+        for(auto &entry : apv_entries)
+        {
+            PRadGEMAPV *apv = gem->GetAPV(entry.fec, entry.adc);
+            if(!apv)
+                continue;
+
+            std::vector<PRadGEMAPV::Pedestal> peds(entry.pedestal, entry.pedestal + APV_CHANNEL_SIZE);
+            apv->UpdatePedestal(peds);
+        }
+    }
+}
+
+// it is written to a temporary file first so the other processes never see
+// an incomplete snapshot
+bool PRadInitSnapshot::Save(const std::string &path)
+const
+{
+    Header header;
+    memset(static_cast<void*>(&header), 0, sizeof(header));
+    memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.version = INIT_SNAPSHOT_VERSION;
+    header.src = source;
+    header.nadc = adc_entries.size();
+    header.nmodules = module_entries.size();
+    header.napvs = apv_entries.size();
+
+    // create the folder if it does not exist
+    size_t pos = path.find_last_of('/');
+    if(pos != std::string::npos && pos > 0)
+        mkdir(path.substr(0, pos).c_str(), 0755);
+
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << "PRad Init Snapshot Warning: Cannot write snapshot file "
+                  << "\"" << tmp_path << "\"."
+                  << std::endl;
+        return false;
+    }
+
+    out.write((const char*) &header, sizeof(header));
+    out.write((const char*) adc_entries.data(), adc_entries.size()*sizeof(ADCEntry));
+    out.write((const char*) module_entries.data(), module_entries.size()*sizeof(ModuleEntry));
+    out.write((const char*) apv_entries.data(), apv_entries.size()*sizeof(APVEntry));
+    out.close();
+
+    if(!out || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "PRad Init Snapshot Warning: Failed to save snapshot file "
+                  << "\"" << path << "\"."
+                  << std::endl;
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool PRadInitSnapshot::Load(const std::string &path, const Source &src)
+{
+    Clear();
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if(!in.is_open())
+        return false;
+
+    size_t size = in.tellg();
+    in.seekg(0);
+
+    Header header;
+    if(size < sizeof(header) || !in.read((char*) &header, sizeof(header)))
+        return false;
+
+    if(memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) ||
+       header.version != INIT_SNAPSHOT_VERSION ||
+       header.src != src ||
+       size != sizeof(Header) + header.nadc*sizeof(ADCEntry)
+               + header.nmodules*sizeof(ModuleEntry)
+               + header.napvs*sizeof(APVEntry))
+        return false;
+
+    adc_entries.resize(header.nadc);
+    module_entries.resize(header.nmodules);
+    apv_entries.resize(header.napvs);
+    in.read((char*) adc_entries.data(), adc_entries.size()*sizeof(ADCEntry));
+    in.read((char*) module_entries.data(), module_entries.size()*sizeof(ModuleEntry));
+    in.read((char*) apv_entries.data(), apv_entries.size()*sizeof(APVEntry));
+
+    if(!in) {
+        Clear();
+        return false;
+    }
+
+    source = header.src;
+    return true;
+}
+
+// the checksum is from the beginning of the file, which contains the events
+// used by the initialization, the size is -1 if the file does not exist
+PRadInitSnapshot::Source PRadInitSnapshot::file_source(const std::string &path, int run, int ref)
+{
+    Source src;
+    src.run = run;
+    src.ref = ref;
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if(!in.is_open())
+        return src;
+
+    src.size = in.tellg();
+    in.seekg(0);
+
+    std::vector<char> buf(std::min<int64_t>(src.size, INIT_SNAPSHOT_CHECK));
+    if(!in.read(buf.data(), buf.size())) {
+        src.size = -1;
+        return src;
+    }
+
+    src.checksum = PRadDSTParser::Checksum(buf.data(), buf.size());
+    return src;
+}
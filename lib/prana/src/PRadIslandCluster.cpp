@@ -12,12 +12,16 @@
 // Chao Peng, rewrote the whole fortran code into C++. 11/21/2016             //
 //            improve the island clustering with DFS method, remove LX's      //
 //            non-splitting method since it is no longer used, 03/17/2018     //
+//            group the hits of the large events by sectors in parallel, and  //
+//            split the groups concurrently, 10/14/2026                       //
 //============================================================================//
 
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <atomic>
 #include "PRadIslandCluster.h"
+#include "PRadTaskPool.h"
 #include "PRadHyCalReconstructor.h"
 #include "PRadHyCalDetector.h"
 #include "PRadADCChannel.h"
@@ -26,7 +30,7 @@
 
 
 PRadIslandCluster::PRadIslandCluster(PRadHyCalReconstructor *r)
-: rec(r)
+: rec(r), nsectors(0)
 {
     // place holder
 }
@@ -42,78 +46,376 @@ const
     return new PRadIslandCluster(*this);
 }
 
+// the threads are from the configuration of the reconstructor
+void PRadIslandCluster::UpdateLayout(const PRadHyCalDetector *det)
+{
+    nsectors = det ? det->GetSectorInfo().size() : 0;
+
+#ifdef MULTI_THREAD
+    unsigned int n = rec->config.intra_threads;
+    if(n == 0)
+        n = std::thread::hardware_concurrency();
+
+    if(n <= 1)
+        intra_pool.reset();
+    else if(!intra_pool || intra_pool->GetThreadNumber() != n)
+        intra_pool = std::make_shared<PRadTaskPool>(n);
+#endif
+}
+
+unsigned int PRadIslandCluster::GetIntraEventThreads()
+const
+{
+    return intra_pool ? intra_pool->GetThreadNumber() : 1;
+}
+
 
 
 //============================================================================//
 // Method based on the code from I. Larin for PrimEx                          //
 //============================================================================//
 
-void PRadIslandCluster::FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls)
+void PRadIslandCluster::FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls,
+                                    ClusterContext &ctx)
 const
 {
-    // clear container first
-    cls.clear();
+    // clear container first, the clusters go back to the pool
+    ctx.RecycleClusters(cls);
 
-    std::vector<std::vector<ModuleHit*>> groups;
+    // the large events are clustered by several threads
+    if(useIntraEvent(hs, ctx) && formClusterIntra(hs, cls, ctx))
+        return;
 
     // group adjacent hits
-    groupHits(hs, groups);
+    groupHits(hs, ctx);
+
+    if(ctx.keep_groups)
+        ctx.ClearGroups();
 
     // try to split the group
-    for(auto &group : groups)
+    for(size_t i = 0; i < ctx.groups.size(); ++i)
     {
-        splitCluster(group, cls);
+        auto &group = ctx.groups[i];
+        auto &maxima = ctx.local_max;
+        findMaximums(group, maxima);
+
+        if(ctx.keep_groups) {
+            GroupInfo info;
+            info.group = i;
+            info.max_begin = ctx.maxima.size();
+            ctx.maxima.insert(ctx.maxima.end(), maxima.begin(), maxima.end());
+            info.max_end = ctx.maxima.size();
+            info.cl_begin = cls.size();
+            // before the split, which does not change the group hits
+            info.shape = ShapeMoments::Eval(group);
+            splitCluster(group, maxima, cls, ctx);
+            info.cl_end = cls.size();
+            ctx.group_info.push_back(info);
+        } else {
+            splitCluster(group, maxima, cls, ctx);
+        }
     }
 }
 
 
-// recursive function for the DFS grouping
-void dfs_group(std::vector<ModuleHit*> &container, int idx,
-               std::vector<ModuleHit> &hits, std::vector<bool> &visits, bool corner)
+// group adjacent hits into raw clusters
+// the hits are connected through the neighbors of their modules, which are
+// built with the detector layout, and a hit is found from its module by the
+// table of hit slots, so the grouping is linear in the number of hits
+void PRadIslandCluster::groupHits(std::vector<ModuleHit> &hits, ClusterContext &ctx)
+const
+{
+    ctx.RecycleGroups();
+    fillHitSlots(hits, ctx);
+
+    ctx.visits.assign(hits.size(), 0);
+    for(size_t i = 0; i < hits.size(); ++i)
+    {
+        // already in a group
+        if(ctx.visits[i])
+            continue;
+
+        traverseGroup(hits, ctx, i, ctx.NewGroup());
+    }
+
+    resetHitSlots(hits, ctx);
+}
+
+// hit slot of every module, the table should be reset after grouping
+void PRadIslandCluster::fillHitSlots(std::vector<ModuleHit> &hits, ClusterContext &ctx)
+const
 {
-    auto &hit = hits[idx];
-    container.push_back(&hit);
-    visits[idx] = true;
+    auto &hit_slots = ctx.hit_slots;
     for(size_t i = 0; i < hits.size(); ++i)
     {
-        if(visits[i] || ! hit->IsNeighbor(hits[i].id, corner))
+        int idx = hits[i]->GetIndex();
+        if(idx < 0)
+            continue;
+        if((size_t)idx >= hit_slots.size())
+            hit_slots.resize(idx + 1, -1);
+        hit_slots[idx] = i;
+    }
+}
+
+void PRadIslandCluster::resetHitSlots(std::vector<ModuleHit> &hits, ClusterContext &ctx)
+const
+{
+    for(auto &hit : hits)
+    {
+        int idx = hit->GetIndex();
+        if(idx >= 0)
+            ctx.hit_slots[idx] = -1;
+    }
+}
+
+// group all the hits connected to the seed, the group itself is the search
+// queue, only the visits of the group hits are changed, so the disjoint groups
+// can be traversed at the same time
+void PRadIslandCluster::traverseGroup(std::vector<ModuleHit> &hits, ClusterContext &ctx,
+                                      int seed, std::vector<ModuleHit*> &group)
+const
+{
+    bool corner = rec->config.corner_conn;
+    auto &hit_slots = ctx.hit_slots;
+    auto &visits = ctx.visits;
+
+    // reserve some space for the possible hits
+    group.reserve(ISLAND_GROUP_RESERVE);
+
+    visits[seed] = 1;
+    group.push_back(&hits[seed]);
+    for(size_t k = 0; k < group.size(); ++k)
+    {
+        for(auto &neighbor : (*group[k])->GetNeighbors())
+        {
+            // circle range, use 1.2 for the transition region
+            if(!corner && neighbor.dist >= 1.2)
+                continue;
+
+            int idx = neighbor->GetIndex();
+            if(idx < 0 || (size_t)idx >= hit_slots.size())
                 continue;
-        dfs_group(container, i, hits, visits, corner);
+
+            int j = hit_slots[idx];
+            if(j < 0 || visits[j])
+                continue;
+
+            visits[j] = 1;
+            group.push_back(&hits[j]);
+        }
     }
 }
 
-// group adjacent hits into raw clusters
-// list is suitable for the merge process, but it has poor performance while loop
-// over all the elements, the test with real data prefers vector as container
-void PRadIslandCluster::groupHits(std::vector<ModuleHit> &hits,
-                                  std::vector<std::vector<ModuleHit*>> &groups)
+
+
+//============================================================================//
+// Intra-event clustering for the large events                                //
+//============================================================================//
+
+// the topology of the groups is only recorded by the serial clustering
+bool PRadIslandCluster::useIntraEvent(const std::vector<ModuleHit> &hits,
+                                      const ClusterContext &ctx)
 const
 {
-    std::vector<bool> visits(hits.size(), false);
+    return intra_pool && ctx.intra_event && !ctx.keep_groups && nsectors > 0 &&
+           hits.size() >= rec->config.intra_hits;
+}
+
+// the hits are grouped in every sector by a thread and the groups are stitched
+// by the links across sectors, then the groups are traversed again and split
+// by the threads, the seeds and the traversals are the same as the serial
+// grouping, so the clusters are identical and in the same order
+// it returns false without clustering if some hits do not own their module
+// slots (such as two hits in one module), they cannot be reached from their
+// neighbors, so the connections are not symmetric
+bool PRadIslandCluster::formClusterIntra(std::vector<ModuleHit> &hits,
+                                         std::vector<ModuleCluster> &cls,
+                                         ClusterContext &ctx)
+const
+{
+    fillHitSlots(hits, ctx);
     for(size_t i = 0; i < hits.size(); ++i)
     {
-        // already in a group
-        if(visits[i])
+        int idx = hits[i]->GetIndex();
+        if(idx < 0 || ctx.hit_slots[idx] != (int)i) {
+            resetHitSlots(hits, ctx);
+            return false;
+        }
+    }
+    ctx.RecycleGroups();
+
+    // bucket the hits by sectors, the hits without a sector are the last one
+    ctx.sector_hits.resize(nsectors + 1);
+    ctx.sector_links.resize(nsectors + 1);
+    for(int s = 0; s <= nsectors; ++s)
+    {
+        ctx.sector_hits[s].clear();
+        ctx.sector_links[s].clear();
+    }
+
+    ctx.hit_sectors.resize(hits.size());
+    for(size_t i = 0; i < hits.size(); ++i)
+    {
+        int s = hits[i]->GetSectorID();
+        if(s < 0 || s >= nsectors)
+            s = nsectors;
+        ctx.hit_sectors[i] = s;
+        ctx.sector_hits[s].push_back(i);
+    }
+
+    ctx.labels.assign(hits.size(), -1);
+    for(int s = 0; s <= nsectors; ++s)
+    {
+        if(ctx.sector_hits[s].empty())
             continue;
+        intra_pool->Submit([this, &hits, &ctx, s] () {groupSector(hits, ctx, s);});
+    }
+    intra_pool->Wait();
+
+    stitchSectors(hits, ctx);
+
+    // scratch of the threads, the pooled clusters are shared to them
+    size_t ngroups = ctx.seeds.size();
+    size_t nworkers = std::min<size_t>(intra_pool->GetThreadNumber(), ngroups);
+    while(ctx.workers.size() < nworkers)
+        ctx.workers.emplace_back(new ClusterContext());
+    for(size_t i = 0; i < ctx.cluster_pool.size(); ++i)
+        ctx.workers[i%nworkers]->cluster_pool.emplace_back(std::move(ctx.cluster_pool[i]));
+    ctx.cluster_pool.clear();
+
+    for(size_t g = 0; g < ngroups; ++g)
+        ctx.NewGroup();
+    if(ctx.group_clusters.size() < ngroups)
+        ctx.group_clusters.resize(ngroups);
+
+    // split the groups concurrently
+    ctx.visits.assign(hits.size(), 0);
+    std::atomic<size_t> next(0);
+    for(size_t w = 0; w < nworkers; ++w)
+    {
+        intra_pool->Submit([this, &hits, &ctx, &next, ngroups, w] ()
+                           {
+                               auto &wctx = *ctx.workers[w];
+                               size_t g;
+                               while((g = next.fetch_add(1)) < ngroups)
+                               {
+                                   auto &group = ctx.groups[g];
+                                   traverseGroup(hits, ctx, ctx.seeds[g], group);
+                                   findMaximums(group, wctx.local_max);
+                                   splitCluster(group, wctx.local_max,
+                                                ctx.group_clusters[g], wctx);
+                               }
+                           });
+    }
+    intra_pool->Wait();
 
-        // create a new group and reserve some space for the possible hits
-        groups.emplace_back();
-        groups.back().reserve(ISLAND_GROUP_RESERVE);
+    // collect the clusters in the order of groups
+    for(size_t g = 0; g < ngroups; ++g)
+    {
+        for(auto &cl : ctx.group_clusters[g])
+            cls.emplace_back(std::move(cl));
+        ctx.group_clusters[g].clear();
+    }
 
-        // group all the possible hits
-        dfs_group(groups.back(), i, hits, visits, rec->config.corner_conn);
+    for(size_t w = 0; w < nworkers; ++w)
+    {
+        ctx.stats += ctx.workers[w]->stats;
+        ctx.workers[w]->stats.Clear();
     }
 
+    resetHitSlots(hits, ctx);
+    return true;
 }
 
-// split one group into several clusters
-void PRadIslandCluster::splitCluster(const std::vector<ModuleHit*> &group,
-                                     std::vector<ModuleCluster> &clusters)
+// group the hits of a sector, the label of a hit is the first hit of its group
+// in the sector, and the connections to other sectors are saved as links
+void PRadIslandCluster::groupSector(std::vector<ModuleHit> &hits, ClusterContext &ctx,
+                                    int sector)
 const
 {
-    // find local maximum
-    auto maxima = findMaximums(group);
+    bool corner = rec->config.corner_conn;
+    auto &hit_slots = ctx.hit_slots;
+    auto &labels = ctx.labels;
+    auto &links = ctx.sector_links[sector];
+    std::vector<int> queue;
 
+    for(int i : ctx.sector_hits[sector])
+    {
+        if(labels[i] >= 0)
+            continue;
+
+        labels[i] = i;
+        queue.assign(1, i);
+        for(size_t k = 0; k < queue.size(); ++k)
+        {
+            int cur = queue[k];
+            for(auto &neighbor : hits[cur]->GetNeighbors())
+            {
+                if(!corner && neighbor.dist >= 1.2)
+                    continue;
+
+                int idx = neighbor->GetIndex();
+                if(idx < 0 || (size_t)idx >= hit_slots.size())
+                    continue;
+
+                int j = hit_slots[idx];
+                if(j < 0)
+                    continue;
+
+                if(ctx.hit_sectors[j] != sector) {
+                    links.emplace_back(cur, j);
+                } else if(labels[j] < 0) {
+                    labels[j] = i;
+                    queue.push_back(j);
+                }
+            }
+        }
+    }
+}
+
+// union the sector groups by the links, the root of a group is its smallest
+// hit index, which is the seed of the serial grouping
+void PRadIslandCluster::stitchSectors(std::vector<ModuleHit> &hits, ClusterContext &ctx)
+const
+{
+    auto &labels = ctx.labels;
+    auto find = [&labels] (int i)
+                {
+                    while(labels[i] != i)
+                    {
+                        labels[i] = labels[labels[i]];
+                        i = labels[i];
+                    }
+                    return i;
+                };
+
+    for(auto &links : ctx.sector_links)
+    {
+        for(auto &link : links)
+        {
+            int r1 = find(link.first), r2 = find(link.second);
+            if(r1 < r2)
+                labels[r2] = r1;
+            else if(r2 < r1)
+                labels[r1] = r2;
+        }
+    }
+
+    ctx.seeds.clear();
+    for(size_t i = 0; i < hits.size(); ++i)
+    {
+        if(find(i) == (int)i)
+            ctx.seeds.push_back(i);
+    }
+}
+
+// split one group into several clusters around its local maxima
+void PRadIslandCluster::splitCluster(const std::vector<ModuleHit*> &group,
+                                     const std::vector<ModuleHit*> &maxima,
+                                     std::vector<ModuleCluster> &clusters,
+                                     ClusterContext &ctx)
+const
+{
     // no cluster center found
     if(maxima.empty())
         return;
@@ -122,14 +424,14 @@ const
        (group.size() >= SPLIT_MAX_HITS) ||          // too many hits
        (maxima.size() >= SPLIT_MAX_MAXIMA)) {     // too many local maxima
         // create cluster based on the center
-        clusters.emplace_back(*maxima.front(), (*maxima.front())->GetLayoutFlag());
-        auto &cluster = clusters.back();
+        auto &cluster = ctx.NewCluster(clusters, *maxima.front(),
+                                       (*maxima.front())->GetLayoutFlag());
 
         for(auto &hit : group)
             cluster.AddHit(*hit);
     // split hits between several maxima
     } else {
-        splitHits(maxima, group, clusters);
+        splitHits(maxima, group, clusters, ctx);
     }
 }
 
@@ -139,6 +441,16 @@ const
 {
     std::vector<ModuleHit*> local_max;
     local_max.reserve(20);
+    findMaximums(hits, local_max);
+    return local_max;
+}
+
+// the maxima are filled to the given container
+void PRadIslandCluster::findMaximums(const std::vector<ModuleHit*> &hits,
+                                     std::vector<ModuleHit*> &local_max)
+const
+{
+    local_max.clear();
     for(auto it = hits.begin(); it != hits.end(); ++it)
     {
         auto &hit1 = *it;
@@ -164,37 +476,36 @@ const
             local_max.push_back(hit1);
         }
     }
-
-    return local_max;
 }
 
 // split hits between several local maxima inside a cluster group
 void PRadIslandCluster::splitHits(const std::vector<ModuleHit*> &maxima,
                                   const std::vector<ModuleHit*> &hits,
-                                  std::vector<ModuleCluster> &clusters)
+                                  std::vector<ModuleCluster> &clusters,
+                                  ClusterContext &ctx)
 const
 {
-    static SplitContainer split;
+    auto &split = ctx.split;
+    auto &stats = ctx.stats;
 
     // initialize fractions
     for(size_t i = 0; i < maxima.size(); ++i)
     {
+        split.rows[i] = PRadClusterProfile::Row();
         auto &center = *maxima.at(i);
+        rec->getProfBatch(center, hits, split.dist, split.prof);
         for(size_t j = 0; j < hits.size(); ++j)
-        {
-            auto &hit = *hits.at(j);
-            split.frac[j][i] = rec->getProf(center, hit).frac*center.energy;
-        }
+            split.frac[j][i] = split.prof[j]*center.energy;
     }
 
     // do iteration to evaluate the share of hits between several maxima
-    evalFraction(hits, maxima, split);
+    stats.split_groups++;
+    stats.split_iters += evalFraction(hits, maxima, split);
 
     // done iteration, add cluster according to the final share of energy
     for(size_t i = 0; i < maxima.size(); ++i)
     {
-        clusters.emplace_back(*maxima[i], (*maxima[i])->GetLayoutFlag());
-        auto &cluster = clusters.back();
+        auto &cluster = ctx.NewCluster(clusters, *maxima[i], (*maxima[i])->GetLayoutFlag());
 
         for(size_t j = 0; j < hits.size(); ++j)
         {
@@ -221,18 +532,23 @@ const
     }
 }
 
-inline void PRadIslandCluster::evalFraction(const std::vector<ModuleHit*> &hits,
-                                            const std::vector<ModuleHit*> &maxima,
-                                            SplitContainer &split)
+// iterate to refine the split fractions, return the number of iterations
+// it stops early if the largest relative change is below the convergence
+inline unsigned int PRadIslandCluster::evalFraction(const std::vector<ModuleHit*> &hits,
+                                                    const std::vector<ModuleHit*> &maxima,
+                                                    SplitContainer &split)
 const
 {
     // temp containers for reconstruction
     BaseHit temp[POS_RECON_HITS];
 
     // iterations to refine the split energies
-    size_t iters = rec->config.split_iter;
-    while(iters-- > 0)
+    unsigned int iters = 0;
+    float conv = rec->config.split_conv;
+    while(iters < rec->config.split_iter)
     {
+        iters++;
+        float max_change = 0.;
         split.sum_frac(hits.size(), maxima.size());
         for(size_t i = 0; i < maxima.size(); ++i)
         {
@@ -263,13 +579,24 @@ const
             rec->reconstructPos(center, temp, count, &recon);
 
             // update profile with the reconstructed center
+            rec->getProfBatch(recon, hits, split.dist, split.prof, split.rows[i]);
             for(size_t j = 0; j < hits.size(); ++j)
             {
-                auto &hit = *hits.at(j);
-                split.frac[j][i] = rec->getProf(recon, hit).frac*tot_E;
+                float frac = split.prof[j]*tot_E, prev = split.frac[j][i];
+                if(conv > 0.) {
+                    float change = (prev != 0.) ? std::abs(frac - prev)/prev
+                                                : ((frac != 0.) ? 1. : 0.);
+                    max_change = std::max(max_change, change);
+                }
+                split.frac[j][i] = frac;
             }
         }
+
+        // converged
+        if(conv > 0. && max_change < conv)
+            break;
     }
     split.sum_frac(hits.size(), maxima.size());
+    return iters;
 }
 
@@ -0,0 +1,178 @@
+//============================================================================//
+// Memory accounting of the subsystems                                        //
+// The subsystems report the memory held by their containers and histograms, //
+// the report is requested by the applications, such as the profiler output  //
+// and the event viewer                                                       //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadMemoryTracker.h"
+#include "PRadEventStruct.h"
+#ifndef PRAD_NO_ROOT
+#include "TH1.h"
+#include "TClass.h"
+#include "TArrayD.h"
+#include "TArrayF.h"
+#include "TArrayI.h"
+#include "TArrayS.h"
+#include "TArrayC.h"
+#endif
+#include <iostream>
+#include <iomanip>
+
+
+
+//============================================================================//
+// Memory Usage                                                               //
+//============================================================================//
+
+// the bin contents and the errors of a histogram, there is no histogram
+// without ROOT
+void MemoryUsage::Add(const TH1 *hist)
+{
+#ifdef PRAD_NO_ROOT
+    (void)hist;
+#else
+    if(!hist)
+        return;
+
+    bytes += hist->IsA()->Size();
+    blocks++;
+
+    // the bin contents are in the TArray base of the concrete histograms
+    size_t contents = 0;
+    if(auto arr = dynamic_cast<const TArrayD*>(hist))
+        contents = arr->GetSize()*sizeof(Double_t);
+    else if(auto arr = dynamic_cast<const TArrayF*>(hist))
+        contents = arr->GetSize()*sizeof(Float_t);
+    else if(auto arr = dynamic_cast<const TArrayI*>(hist))
+        contents = arr->GetSize()*sizeof(Int_t);
+    else if(auto arr = dynamic_cast<const TArrayS*>(hist))
+        contents = arr->GetSize()*sizeof(Short_t);
+    else if(auto arr = dynamic_cast<const TArrayC*>(hist))
+        contents = arr->GetSize()*sizeof(Char_t);
+    Add(hist, contents);
+
+    const TArrayD *sumw2 = hist->GetSumw2();
+    if(sumw2 && sumw2->GetSize()) {
+        bytes += sumw2->GetSize()*sizeof(Double_t);
+        blocks++;
+    }
+#endif
+}
+
+void MemoryUsage::Add(const EventData &event)
+{
+    Add(event.adc_data);
+    Add(event.tdc_data);
+    Add(event.gem_data);
+    Add(event.dsc_data);
+}
+
+
+
+//============================================================================//
+// Memory Tracker                                                             //
+//============================================================================//
+
+PRadMemoryTracker &PRadMemoryTracker::Instance()
+{
+    static PRadMemoryTracker instance;
+    return instance;
+}
+
+// register a subsystem, the one with the same name is replaced
+void PRadMemoryTracker::Register(const std::string &name, Accountant acc)
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    for(auto &it : accountants)
+    {
+        if(it.first == name) {
+            it.second = acc;
+            return;
+        }
+    }
+    accountants.emplace_back(name, acc);
+}
+
+void PRadMemoryTracker::Unregister(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    for(auto it = accountants.begin(); it != accountants.end(); ++it)
+    {
+        if(it->first == name) {
+            accountants.erase(it);
+            return;
+        }
+    }
+}
+
+// the number of events to show the usage per event
+void PRadMemoryTracker::SetEventCounter(std::function<size_t()> counter)
+{
+    std::lock_guard<std::mutex> lock(locker);
+    event_counter = counter;
+}
+
+bool PRadMemoryTracker::IsEmpty()
+const
+{
+    std::lock_guard<std::mutex> lock(locker);
+    return accountants.empty();
+}
+
+std::vector<PRadMemoryTracker::Entry> PRadMemoryTracker::GetUsage()
+const
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    std::vector<Entry> res;
+    for(auto &it : accountants)
+        res.push_back(Entry{it.first, it.second()});
+    return res;
+}
+
+size_t PRadMemoryTracker::GetEventCount()
+const
+{
+    std::lock_guard<std::mutex> lock(locker);
+    return event_counter ? event_counter() : 0;
+}
+
+void PRadMemoryTracker::PrintSummary(std::ostream &os)
+const
+{
+    auto usage = GetUsage();
+    size_t nevents = GetEventCount();
+
+    os << std::setw(32) << std::left << "Subsystem" << std::right
+       << std::setw(14) << "Live (MB)"
+       << std::setw(12) << "Blocks"
+       << std::setw(14) << "Bytes/Event"
+       << std::endl;
+
+    MemoryUsage total;
+    for(auto &entry : usage)
+    {
+        total += entry.usage;
+        os << std::setw(32) << std::left << entry.name << std::right
+           << std::setw(14) << std::fixed << std::setprecision(3)
+           << entry.usage.bytes/1048576.
+           << std::setw(12) << entry.usage.blocks
+           << std::setw(14) << std::setprecision(1)
+           << (nevents ? (double)entry.usage.bytes/nevents : 0.)
+           << std::endl;
+    }
+
+    os << std::setw(32) << std::left << "Total" << std::right
+       << std::setw(14) << std::setprecision(3) << total.bytes/1048576.
+       << std::setw(12) << total.blocks
+       << std::setw(14) << std::setprecision(1)
+       << (nevents ? (double)total.bytes/nevents : 0.)
+       << std::endl;
+    os.unsetf(std::ios::floatfield);
+}
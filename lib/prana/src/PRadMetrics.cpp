@@ -0,0 +1,270 @@
+//============================================================================//
+// Live metrics of the long running jobs                                      //
+// Counters and gauges are registered by the data handler and the pipeline    //
+// stages, and dumped periodically in JSON or Prometheus text format          //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadMetrics.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+
+
+PRadMetrics::PRadMetrics()
+: start_time(std::chrono::steady_clock::now()), last_time(start_time), dump_stop(false)
+{
+    // place holder
+}
+
+PRadMetrics::~PRadMetrics()
+{
+    StopDump();
+}
+
+PRadMetrics &PRadMetrics::Instance()
+{
+    static PRadMetrics instance;
+    return instance;
+}
+
+// get the counter with the name, it is created on the first request
+PRadMetricCounter *PRadMetrics::GetCounter(const std::string &name, const std::string &help,
+                                            double scale)
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    auto it = counter_map.find(name);
+    if(it != counter_map.end())
+        return &it->second->counter;
+
+    counters.emplace_back();
+    CounterEntry &entry = counters.back();
+    entry.name = name;
+    entry.help = help;
+    entry.scale = scale;
+    entry.last = 0;
+    counter_map[name] = &entry;
+    return &entry.counter;
+}
+
+// add a gauge, the one with the same name is replaced
+void PRadMetrics::AddGauge(const std::string &name, Gauge func, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    for(auto &gauge : gauges)
+    {
+        if(gauge.name == name) {
+            gauge.func = func;
+            gauge.help = help;
+            return;
+        }
+    }
+    gauges.push_back(GaugeEntry{name, help, func});
+}
+
+// the gauge is not evaluated anymore after this returns
+void PRadMetrics::RemoveGauge(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    gauges.erase(std::remove_if(gauges.begin(), gauges.end(),
+                                [&name] (const GaugeEntry &g) {return g.name == name;}),
+                 gauges.end());
+}
+
+void PRadMetrics::Write(std::ostream &os, Format format)
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    switch(format)
+    {
+    case JSON:
+        writeJSON(os);
+        break;
+    case Prometheus:
+        writePrometheus(os);
+        break;
+    }
+}
+
+// write to a temporary file and rename it, so the readers never see a
+// partially written file
+bool PRadMetrics::Save(const std::string &path, Format format)
+{
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp);
+        if(!out.is_open()) {
+            std::cerr << "PRad Metrics Error: cannot open file "
+                      << "\"" << temp << "\"" << std::endl;
+            return false;
+        }
+        Write(out, format);
+    }
+
+    if(std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "PRad Metrics Error: cannot rename "
+                  << "\"" << temp << "\" to \"" << path << "\"" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// dump the metrics every interval in a thread, and once more when stopped
+void PRadMetrics::StartDump(const std::string &path, unsigned int interval_ms, Format format)
+{
+    StopDump();
+
+    dump_stop = false;
+    dump_thread = std::thread(&PRadMetrics::dump, this, path, std::max(interval_ms, 1u), format);
+}
+
+void PRadMetrics::StopDump()
+{
+    if(!dump_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(dump_locker);
+        dump_stop = true;
+    }
+    dump_cond.notify_all();
+    dump_thread.join();
+}
+
+void PRadMetrics::dump(std::string path, unsigned int interval_ms, Format format)
+{
+    auto next = std::chrono::steady_clock::now();
+    while(true)
+    {
+        next += std::chrono::milliseconds(interval_ms);
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(dump_locker);
+            stop = dump_cond.wait_until(lock, next, [this] {return dump_stop;});
+        }
+
+        Save(path, format);
+        if(stop)
+            return;
+    }
+}
+
+// json names are quoted, so the quotes of the labels are escaped
+static std::string json_name(const std::string &name)
+{
+    std::string res;
+    for(auto &c : name)
+    {
+        if(c == '"' || c == '\\')
+            res += '\\';
+        res += c;
+    }
+    return res;
+}
+
+// the rate of a counter is from the previous json output
+void PRadMetrics::writeJSON(std::ostream &os)
+{
+    auto now = std::chrono::steady_clock::now();
+    double uptime = std::chrono::duration<double>(now - start_time).count();
+    double interval = std::chrono::duration<double>(now - last_time).count();
+    last_time = now;
+
+    os << std::fixed << std::setprecision(3)
+       << "{" << std::endl
+       << "  \"timestamp\": " << std::time(nullptr) << "," << std::endl
+       << "  \"uptime\": " << uptime << "," << std::endl
+       << "  \"counters\": {";
+
+    for(size_t i = 0; i < counters.size(); ++i)
+    {
+        auto &entry = counters[i];
+        uint64_t value = entry.counter.Get();
+        double rate = (interval > 0.) ? (value - entry.last)*entry.scale/interval : 0.;
+        entry.last = value;
+
+        os << ((i == 0) ? "" : ",") << std::endl
+           << "    \"" << json_name(entry.name) << "\": {\"value\": ";
+        if(entry.scale == 1.)
+            os << value;
+        else
+            os << value*entry.scale;
+        os << ", \"rate\": " << rate << "}";
+    }
+
+    os << std::endl << "  }," << std::endl
+       << "  \"gauges\": {";
+
+    for(size_t i = 0; i < gauges.size(); ++i)
+    {
+        os << ((i == 0) ? "" : ",") << std::endl
+           << "    \"" << json_name(gauges[i].name) << "\": " << gauges[i].func();
+    }
+
+    os << std::endl << "  }" << std::endl
+       << "}" << std::endl;
+    os.unsetf(std::ios::floatfield);
+}
+
+// the help and type lines are written once for the metrics sharing a name
+// with different labels
+void PRadMetrics::writePrometheus(std::ostream &os)
+const
+{
+    std::vector<std::string> described;
+    auto describe = [&] (const std::string &name, const std::string &help, const char *type)
+                    {
+                        std::string base = name.substr(0, name.find('{'));
+                        if(std::find(described.begin(), described.end(), base) != described.end())
+                            return;
+                        described.push_back(base);
+                        if(!help.empty())
+                            os << "# HELP " << base << " " << help << "\n";
+                        os << "# TYPE " << base << " " << type << "\n";
+                    };
+
+    double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                  - start_time).count();
+    describe("prad_uptime_seconds", "time since the metrics are created", "gauge");
+    os << "prad_uptime_seconds " << uptime << "\n";
+
+    // the samples of a metric with different labels should be together
+    std::vector<const CounterEntry*> sorted_counters;
+    for(auto &entry : counters)
+        sorted_counters.push_back(&entry);
+    std::sort(sorted_counters.begin(), sorted_counters.end(),
+              [] (const CounterEntry *a, const CounterEntry *b) {return a->name < b->name;});
+
+    for(auto &entry : sorted_counters)
+    {
+        describe(entry->name, entry->help, "counter");
+        os << entry->name << " ";
+        if(entry->scale == 1.)
+            os << entry->counter.Get();
+        else
+            os << entry->counter.Get()*entry->scale;
+        os << "\n";
+    }
+
+    std::vector<const GaugeEntry*> sorted_gauges;
+    for(auto &gauge : gauges)
+        sorted_gauges.push_back(&gauge);
+    std::sort(sorted_gauges.begin(), sorted_gauges.end(),
+              [] (const GaugeEntry *a, const GaugeEntry *b) {return a->name < b->name;});
+
+    for(auto &gauge : sorted_gauges)
+    {
+        describe(gauge->name, gauge->help, "gauge");
+        os << gauge->name << " " << gauge->func() << "\n";
+    }
+    os.flush();
+}
@@ -30,7 +30,23 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <map>
+#include <memory>
 #include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "PRadGenEventFile.h"
+#include "PRadGenKinematics.h"
 #include "PRadBenchMark.h"
 
 #define PROGRESS_EVENT_COUNT 1000
@@ -54,8 +70,8 @@ const double alp3 = alp2*cana::alpha;
 // convert MeV^-2 to nbarn
 const double unit = cana::hbarc2*1e7;
 
-// random number generator
-static cana::rand_gen<> rng;
+// random number generator, every block of events has its own stream
+typedef cana::rand_gen<double, cana::philox4x32> stream_rng;
 
 // some inlines
 // square
@@ -154,26 +170,121 @@ void show_progress(const PRadBenchMark &timer, int count, int max, const char *s
         std::cout << std::endl;
 }
 
+// call func(i) for i from 0 to n - 1 by several threads
+template<class Func>
+inline void parallel_for(size_t n, unsigned int nthreads, Func func)
+{
+    std::atomic<size_t> next(0);
+    auto work = [&] ()
+                {
+                    size_t i;
+                    while((i = next++) < n)
+                        func(i);
+                };
+
+#ifdef MULTI_THREAD
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, n));
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < nthreads; ++i)
+        workers.emplace_back(work);
+    work();
+    for(auto &worker : workers)
+        worker.join();
+#else
+    (void) nthreads;
+    work();
+#endif
+}
+
+// format of the cached grids, a header and the t bins followed by all the
+// v bins, the v bins of a t bin are identified by their offset and count
+static const char grid_magic[8] = {'P', 'R', 'A', 'D', 'M', 'G', 'R', 'D'};
+
+struct GridHeader
+{
+    char magic[8];
+    uint32_t version, min_bins;
+    // the parameters that determine the grids
+    double s, t_min, t_max, v_min, v_cut, t_prec, v_prec;
+    uint64_t nt, nv;
+};
+
+struct GridTBin
+{
+    double val, cdf, sig_nrad, sig_rad;
+    uint64_t v_offset, v_count;
+};
+
+struct GridVBin
+{
+    double val, cdf, sig;
+};
+
+// header of the grids with the parameters, the others are zero padded so it
+// can be compared by memcmp
+inline GridHeader grid_header(double s, double t_min, double t_max,
+                              double v_min, double v_cut, unsigned int min_bins,
+                              double t_prec, double v_prec)
+{
+    GridHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, grid_magic, sizeof(grid_magic));
+    header.version = MOLLER_GRID_VERSION;
+    header.min_bins = min_bins;
+    header.s = s;
+    header.t_min = t_min;
+    header.t_max = t_max;
+    header.v_min = v_min;
+    header.v_cut = v_cut;
+    header.t_prec = t_prec;
+    header.v_prec = v_prec;
+    return header;
+}
+
+// FNV-1a hash of the header, it names the cache file
+inline uint64_t grid_hash(const GridHeader &header)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto bytes = (const unsigned char*) &header;
+    for(size_t i = 0; i < offsetof(GridHeader, nt); ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// end point of a t bin, the v distribution is not needed for refinement
+struct TPoint
+{
+    double val, sig_nrad, sig_rad;
+
+    TPoint(const TDist &d) : val(d.val), sig_nrad(d.sig_nrad), sig_rad(d.sig_rad) {}
+};
+
 // refine t bin til the interpolation precision reaches required value
+// the new points are appended to the container, limited by max_bins
 inline void refine_t_bin(const PRadMollerGen &model,
-                         std::vector<TDist> &container, size_t i, size_t f,
-                         double prec, double s)
+                         std::vector<TDist> &container, const TPoint &beg, const TPoint &end,
+                         double prec, double s, size_t max_bins)
 {
     // safety check
-    if(container.size() >= MAX_T_BINS)
+    if(container.size() >= max_bins)
         return;
 
-    const TDist &beg = container.at(i), &end = container.at(f);
     double t = (beg.val + end.val)/2.;
 
-    container.emplace_back(t, model.GetNonRadXSdQsq(s, t), model.GetRadVDist(s, t));
-    const TDist &center = container.back();
+    container.emplace_back(model.GetGridPoint(s, t));
+    TPoint center(container.back());
 
     if(std::abs(1. - 2.*center.sig_nrad/(beg.sig_nrad + end.sig_nrad)) > prec ||
        std::abs(1. - 2.*center.sig_rad/(beg.sig_rad + end.sig_rad)) > prec)
     {
-        refine_t_bin(model, container, i, container.size() - 1, prec, s);
-        refine_t_bin(model, container, container.size() - 1, f, prec, s);
+        refine_t_bin(model, container, beg, center, prec, s, max_bins);
+        refine_t_bin(model, container, center, end, prec, s, max_bins);
     }
 
 }
@@ -199,15 +310,147 @@ inline void refine_v_bin(std::vector<VDist> &container, size_t i, size_t f,
 
 
 
+// tables to sample the grids without searching, the t bins are sampled by an
+// alias table of their cross sections, and the v distributions are inverted
+// by their guide tables
+struct GridSampler
+{
+    cana::alias_table t_alias;
+    std::vector<cana::guide_table> v_guides;
+
+    GridSampler(const std::vector<TDist> &t_dist)
+    {
+        std::vector<double> weights;
+        for(size_t i = 1; i < t_dist.size(); ++i)
+            weights.push_back(t_dist[i].cdf - t_dist[i - 1].cdf);
+        t_alias.build(weights.begin(), weights.end());
+
+        for(auto &t_bin : t_dist)
+            v_guides.emplace_back(t_bin.v_dist.begin(), t_bin.v_dist.end());
+    }
+};
+
+// sample one event from the grids, the four momenta of the two electrons and
+// the photon are in the CM frame, radiative is false if there is no hard photon
+// the grids are searched by binary search if the sampler is not provided
+// false if the random number is not found in the grids
+inline bool sample_event(const std::vector<TDist> &t_dist, const GridSampler *sampler,
+                         double s, stream_rng &rng, double *k2_CM, double *p2_CM, double *k_CM,
+                         bool &radiative)
+{
+    // kinematic variables
+    double t, v, t1, z;
+
+    double rnd;
+    std::vector<TDist>::const_iterator fp, sp;
+    if(sampler) {
+        // the bin from the alias table, linear in cdf within the bin
+        double frac;
+        fp = t_dist.begin() + sampler->t_alias.sample(rng(), frac);
+        sp = fp + 1;
+        rnd = fp->cdf + frac*(sp->cdf - fp->cdf);
+    } else {
+        rnd = rng()*t_dist.back().cdf;
+        auto interval = cana::fast_binary_search_interval(t_dist.begin(), t_dist.end(), rnd);
+        fp = interval.first, sp = interval.second;
+    }
+
+    // v at the cdf value of the v distribution of a t bin
+    auto v_inverse = [&] (std::vector<TDist>::const_iterator it, double cdf)
+                     {
+                         if(sampler)
+                             return sampler->v_guides[it - t_dist.begin()].inverse(it->v_dist.begin(), cdf);
+                         return cana::uni2dist(it->v_dist.begin(), it->v_dist.end(), cdf);
+                     };
+
+    // should not happen
+    if(fp == t_dist.end() || sp == t_dist.end()) {
+        std::cerr << "Could not find CDF value at " << rnd << std::endl;
+        return false;
+    }
+
+    // check if this event has a hard photon emission
+    double rnd2 = rng();
+    double sig_rad, sig_nrad, rnd_rad;
+
+    // exactly matched one point
+    if(fp == sp) {
+        t = fp->val;
+
+        sig_rad = fp->sig_rad;
+        sig_nrad = fp->sig_nrad;
+        rnd_rad = (rnd2*(sig_nrad + sig_rad) - sig_nrad)/sig_rad;
+        if(rnd_rad > 0.) {
+            v = v_inverse(fp, rnd*fp->v_dist.back().cdf);
+            t1 = merad_sample_t1(t, v, 0., rng());
+            z = merad_sample_z(t, t1, v, 0., rng());
+        } else {
+            v = 0., t1 = t, z = 0.;
+        }
+    // in an interval, interpolate everything between two points
+    } else {
+        t = cana::linear_interp(fp->cdf, fp->val, sp->cdf, sp->val, rnd);
+        sig_nrad = cana::linear_interp(fp->cdf, fp->sig_nrad, sp->cdf, sp->sig_nrad, rnd);
+        sig_rad = cana::linear_interp(fp->cdf, fp->sig_rad, sp->cdf, sp->sig_rad, rnd);
+
+        rnd_rad = (rnd2*(sig_nrad + sig_rad) - sig_nrad)/sig_rad;
+        if(rnd_rad > 0.) {
+            double v1 = v_inverse(fp, rnd_rad*fp->v_dist.back().cdf);
+            double v2 = v_inverse(sp, rnd_rad*sp->v_dist.back().cdf);
+
+            v = cana::linear_interp(fp->cdf, v1, sp->cdf, v2, rnd);
+            t1 = merad_sample_t1(t, v, 0., rng());
+            z = merad_sample_z(t, t1, v, 0., rng());
+        } else {
+            v = 0., t1 = t, z = 0.;
+        }
+    }
+
+    PRadMollerGen::MomentumRec(k2_CM, p2_CM, k_CM, s, t, t1, v, z, rng(), rng());
+    radiative = (rnd_rad > 0.);
+
+#ifdef MOLLER_TEST_KIN
+    double k2[4], p2[4], k[4], beta_CM = get_CM_beta(Es);
+    four_momentum_boost_z(k2, k2_CM, -beta_CM);
+    four_momentum_boost_z(p2, p2_CM, -beta_CM);
+    four_momentum_boost_z(k, k_CM, -beta_CM);
+    std::cout << i << ", " << angle << ", "
+              << k2[0] << ", " << calc_mass2(k2) << ", "
+              << p2[0] << ", " << calc_mass2(p2) << ", "
+              << k[0] << ", " << calc_mass2(k) << ", "
+              << z << ", " << 2.*(k[0]*k2[0] - k[1]*k2[1] - k[2]*k2[2] - k[3]*k2[3]) << ", "
+              << t1 << ", " << pow2(p2[0] - m) - p2[1]*p2[1] - p2[2]*p2[2] - p2[3]*p2[3] << ", "
+              << pow2(Es - k2[0] - k[0]) - pow2(k2[1] + k[1]) - pow2(k2[2] + k[2]) - pow2(sqrt(Es*Es - m*m) - k2[3] - k[3])
+              << std::endl;
+    std::cout << sqrt(s) << ", "
+              << k2_CM[0] + p2_CM[0] + k_CM[0] << ", "
+              << k2_CM[1] + p2_CM[1] + k_CM[1] << ", "
+              << k2_CM[2] + p2_CM[2] + k_CM[2] << ", "
+              << k2_CM[3] + p2_CM[3] + k_CM[3]
+              << std::endl;
+    std::cout << Es + m << ", "
+              << k2[0] + p2[0] + k[0] << ", "
+              << k2[1] + p2[1] + k[1] << ", "
+              << k2[2] + p2[2] + k[2] << ", "
+              << k2[3] + p2[3] + k[3]
+              << std::endl;
+#endif //MOLLER_TEST_KIN
+
+    return true;
+}
+
+
+
 //============================================================================//
 // Constructor, destructor                                                    //
 //============================================================================//
 
 // constructor
 PRadMollerGen::PRadMollerGen(double vmin, double vmax, int nbins, double t_res, double v_res)
-: v_min(vmin), v_cut(vmax), min_bins(nbins), t_prec(t_res), v_prec(v_res)
+: v_min(vmin), v_cut(vmax), min_bins(nbins), t_prec(t_res), v_prec(v_res), nthreads(0), seed(0), binary_output(false), alias_sampling(false),
+  use_memo(true)
 {
-    // place holder
+    ClearPointMemo();
 }
 
 // destructor
@@ -239,7 +482,7 @@ const
     }
 
     // kinematic variables
-    double s, t, u, v, t1, z, t_min, t_max;
+    double s, u, t_min, t_max;
     double beta_CM = get_CM_beta(Es);
 
     // determine t range
@@ -247,119 +490,250 @@ const
     get_moller_stu(Es, max_angle, s, t_max, u);
 
     // prepare grid for interpolation of angle
-    std::vector<TDist> t_dist = init_grids(s, t_min, t_max, verbose);
+    std::vector<TDist> t_dist = get_grids(s, t_min, t_max, verbose);
+
+    double lumin = (double)nevents/(t_dist.back().cdf*unit);
+    std::ofstream fout(save_path, (binary_output) ? std::ios::binary : std::ios::out);
+
+    // the events are sampled in blocks by several threads, block i uses the
+    // random stream i of the seed and the blocks are written in order, so the
+    // output only depends on the seed
+    size_t nblocks = (nevents + MOLLER_SAMPLE_BLOCK - 1)/MOLLER_SAMPLE_BLOCK;
+    uint64_t stream_seed = seed;
+    if(!stream_seed) {
+        std::random_device rd;
+        stream_seed = ((uint64_t)rd() << 32) | rd();
+    }
+
+    // header of the binary output
+    if(binary_output) {
+        auto header = PRadGenEventFile::MakeHeader("moller");
+        header.energy = Es;
+        header.min_angle = min_angle;
+        header.max_angle = max_angle;
+        header.v_min = v_min;
+        header.v_cut = v_cut;
+        header.luminosity = lumin;
+        header.nevents = nevents;
+        header.seed = stream_seed;
+        fout.write((const char*) &header, sizeof(header));
+    }
 
-    // prepare variables
-    double k2[4], p2[4], k[4], k2_CM[4], p2_CM[4], k_CM[4];
-    std::ofstream fout(save_path);
+    // tables for sampling without searching the grids
+    std::unique_ptr<GridSampler> sampler;
+    if(alias_sampling)
+        sampler.reset(new GridSampler(t_dist));
 
     // event sampling
     PRadBenchMark timer;
-    for(int i = 0; i < nevents; ++i)
-    {
-        double rnd = rng()*t_dist.back().cdf;
-        auto interval = cana::binary_search_interval(t_dist.begin(), t_dist.end(), rnd);
-        const auto &fp = interval.first, &sp = interval.second;
-
-        // should not happen
-        if(fp == t_dist.end() || sp == t_dist.end()) {
-            std::cerr << "Could not find CDF value at " << rnd << std::endl;
-            i--;
-            continue;
-        }
-
-        // check if this event has a hard photon emission
-        double rnd2 = rng();
-        double sig_rad, sig_nrad, rnd_rad;
-
-        // exactly matched one point
-        if(fp == sp) {
-            t = fp->val;
-
-            sig_rad = fp->sig_rad;
-            sig_nrad = fp->sig_nrad;
-            rnd_rad = (rnd2*(sig_nrad + sig_rad) - sig_nrad)/sig_rad;
-            if(rnd_rad > 0.) {
-                v = cana::uni2dist(fp->v_dist.begin(), fp->v_dist.end(), rnd*fp->v_dist.back().cdf);
-                t1 = merad_sample_t1(t, v, 0., rng());
-                z = merad_sample_z(t, t1, v, 0., rng());
-            } else {
-                v = 0., t1 = t, z = 0.;
-            }
-        // in an interval, interpolate everything between two points
-        } else {
-            t = cana::linear_interp(fp->cdf, fp->val, sp->cdf, sp->val, rnd);
-            sig_nrad = cana::linear_interp(fp->cdf, fp->sig_nrad, sp->cdf, sp->sig_nrad, rnd);
-            sig_rad = cana::linear_interp(fp->cdf, fp->sig_rad, sp->cdf, sp->sig_rad, rnd);
-
-            rnd_rad = (rnd2*(sig_nrad + sig_rad) - sig_nrad)/sig_rad;
-            if(rnd_rad > 0.) {
-                double v1 = cana::uni2dist(fp->v_dist.begin(),
-                                           fp->v_dist.end(),
-                                           rnd_rad*fp->v_dist.back().cdf);
-                double v2 = cana::uni2dist(sp->v_dist.begin(),
-                                           sp->v_dist.end(),
-                                           rnd_rad*sp->v_dist.back().cdf);
-
-                v = cana::linear_interp(fp->cdf, v1, sp->cdf, v2, rnd);
-                t1 = merad_sample_t1(t, v, 0., rng());
-                z = merad_sample_z(t, t1, v, 0., rng());
-            } else {
-                v = 0., t1 = t, z = 0.;
-            }
-        }
+    std::mutex output_locker;
+    std::map<size_t, std::string> finished;
+    size_t next_block = 0;
+    int count = 0;
 
-        MomentumRec(k2_CM, p2_CM, k_CM, s, t, t1, v, z, rng(), rng());
-        four_momentum_boost_z(k2, k2_CM, -beta_CM);
-        four_momentum_boost_z(p2, p2_CM, -beta_CM);
-        four_momentum_boost_z(k, k_CM, -beta_CM);
+    parallel_for(nblocks, nthreads,
+                 [&] (size_t i)
+                 {
+                     // MERADGEN is initialized for every thread
+                     merad_init(s);
+                     stream_rng rng(cana::philox4x32(stream_seed, i));
+                     std::ostringstream block;
+
+                     int beg = i*MOLLER_SAMPLE_BLOCK;
+                     int end = std::min(nevents, beg + MOLLER_SAMPLE_BLOCK);
+                     size_t n = end - beg;
+
+                     // sample the CM momenta of the whole block first, then
+                     // boost and convert them to the outputs together
+                     PRadGenKinematics::Block parts[3];
+                     std::vector<char> radiative(n);
+                     for(auto &part : parts)
+                         part.resize(n);
+
+                     for(size_t j = 0; j < n; ++j)
+                     {
+                         double k2_CM[4], p2_CM[4], k_CM[4];
+                         bool rad;
+                         while(!sample_event(t_dist, sampler.get(), s, rng, k2_CM, p2_CM, k_CM, rad))
+                             ;
+
+                         parts[0].set(j, k2_CM);
+                         parts[1].set(j, p2_CM);
+                         parts[2].set(j, k_CM);
+                         radiative[j] = rad;
+                     }
 
-        fout << sqrt(calc_p2(k2)) << "   " << calc_polar(k2) << "   " << calc_azimuthal(k2) << "   "
-             << sqrt(calc_p2(p2)) << "   " << calc_polar(p2) << "   " << calc_azimuthal(p2) << "   ";
-        if(rnd_rad > 0.) {
-            fout << sqrt(calc_p2(k)) << "   " << calc_polar(k) << "   " << calc_azimuthal(k) << std::endl;
-        } else {
-            fout << 0. << "   " << 0. << "   " << 0. << std::endl;
-        }
+                     for(auto &part : parts)
+                         PRadGenKinematics::BoostZ(part, -beta_CM);
+
+                     // no photon for the non-radiative events
+                     const char *masks[3] = {nullptr, nullptr, radiative.data()};
+                     if(binary_output) {
+                         std::vector<PRadGenEventFile::Event> events(n);
+                         PRadGenKinematics::FillEvents(parts, masks, events.data(), n);
+                         block.write((const char*) events.data(), n*sizeof(PRadGenEventFile::Event));
+                     } else {
+                         std::vector<double> vals(9*n);
+                         PRadGenKinematics::FillValues(parts, masks, vals.data(), n);
+                         for(size_t j = 0; j < 9*n; ++j)
+                             block << vals[j] << ((j%9 < 8) ? "   " : "\n");
+                     }
 
-        // show progress
-        if(verbose && (i%PROGRESS_EVENT_COUNT == 0))
-            show_progress(timer, i, nevents, "ev");
+                     // write the finished blocks in order
+                     std::lock_guard<std::mutex> lock(output_locker);
+                     finished[i] = block.str();
+                     for(auto it = finished.begin();
+                         it != finished.end() && it->first == next_block;
+                         it = finished.erase(it), ++next_block)
+                     {
+                         fout << it->second;
+                     }
 
-#ifdef MOLLER_TEST_KIN
-        std::cout << i << ", " << angle << ", "
-                  << k2[0] << ", " << calc_mass2(k2) << ", "
-                  << p2[0] << ", " << calc_mass2(p2) << ", "
-                  << k[0] << ", " << calc_mass2(k) << ", "
-                  << z << ", " << 2.*(k[0]*k2[0] - k[1]*k2[1] - k[2]*k2[2] - k[3]*k2[3]) << ", "
-                  << t1 << ", " << pow2(p2[0] - m) - p2[1]*p2[1] - p2[2]*p2[2] - p2[3]*p2[3] << ", "
-                  << pow2(Es - k2[0] - k[0]) - pow2(k2[1] + k[1]) - pow2(k2[2] + k[2]) - pow2(sqrt(Es*Es - m*m) - k2[3] - k[3])
-                  << std::endl;
-        std::cout << sqrt(s) << ", "
-                  << k2_CM[0] + p2_CM[0] + k_CM[0] << ", "
-                  << k2_CM[1] + p2_CM[1] + k_CM[1] << ", "
-                  << k2_CM[2] + p2_CM[2] + k_CM[2] << ", "
-                  << k2_CM[3] + p2_CM[3] + k_CM[3]
-                  << std::endl;
-        std::cout << Es + m << ", "
-                  << k2[0] + p2[0] + k[0] << ", "
-                  << k2[1] + p2[1] + k[1] << ", "
-                  << k2[2] + p2[2] + k[2] << ", "
-                  << k2[3] + p2[3] + k[3]
-                  << std::endl;
-#endif //MOLLER_TEST_KIN
-    }
+                     count += end - beg;
+                     // show progress
+                     if(verbose)
+                         show_progress(timer, count, nevents, "ev");
+                 });
 
     if(verbose) {
         show_progress(timer, nevents, nevents, "ev", true);
         std::cout << "Events generation done! Saved in file \"" << save_path << "\".\n"
-                  << "Integrated luminosity = " << (double)nevents/(unit*t_dist.back().cdf)
+                  << "Integrated luminosity = " << lumin
                   << " nb^-1."
                   << std::endl;
     }
 
     // return integrated luminosity
-    return (double)nevents/(t_dist.back().cdf*unit);
+    return lumin;
+}
+
+// path of the cached grids in the cache folder
+std::string PRadMollerGen::GetGridCachePath(double s, double t_min, double t_max)
+const
+{
+    GridHeader header = grid_header(s, t_min, t_max, v_min, v_cut, min_bins, t_prec, v_prec);
+
+    char name[64];
+    snprintf(name, sizeof(name), "moller_grids_%016llx.bin",
+             (unsigned long long) grid_hash(header));
+
+    if(cache_dir.empty())
+        return name;
+    return cache_dir + "/" + name;
+}
+
+// save the finalized grids with the generator parameters, it is written to a
+// temporary file first so the other processes never see an incomplete cache
+bool PRadMollerGen::SaveGrids(const std::string &path, double s, double t_min, double t_max,
+                              const std::vector<TDist> &grids)
+const
+{
+    GridHeader header = grid_header(s, t_min, t_max, v_min, v_cut, min_bins, t_prec, v_prec);
+    header.nt = grids.size();
+
+    std::vector<GridTBin> t_bins;
+    std::vector<GridVBin> v_bins;
+    t_bins.reserve(grids.size());
+    for(auto &t_bin : grids)
+    {
+        t_bins.push_back({t_bin.val, t_bin.cdf, t_bin.sig_nrad, t_bin.sig_rad,
+                          v_bins.size(), t_bin.v_dist.size()});
+        for(auto &v_bin : t_bin.v_dist)
+            v_bins.push_back({v_bin.val, v_bin.cdf, v_bin.sig});
+    }
+    header.nv = v_bins.size();
+
+    // create the folder if it does not exist
+    size_t pos = path.find_last_of('/');
+    if(pos != std::string::npos && pos > 0)
+        mkdir(path.substr(0, pos).c_str(), 0755);
+
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << "PRad Moller Generator Warning: Cannot write grids to "
+                  << "\"" << tmp_path << "\"."
+                  << std::endl;
+        return false;
+    }
+
+    out.write((const char*) &header, sizeof(header));
+    out.write((const char*) t_bins.data(), t_bins.size()*sizeof(GridTBin));
+    out.write((const char*) v_bins.data(), v_bins.size()*sizeof(GridVBin));
+    out.close();
+
+    if(!out || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "PRad Moller Generator Warning: Failed to save grids to "
+                  << "\"" << path << "\"."
+                  << std::endl;
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// load the grids from the mapped file, false if it does not exist or it was
+// saved with different parameters or by a different version
+bool PRadMollerGen::LoadGrids(const std::string &path, double s, double t_min, double t_max,
+                              std::vector<TDist> &grids)
+const
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat fs;
+    if(fstat(fd, &fs) < 0 || (size_t)fs.st_size < sizeof(GridHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t length = fs.st_size;
+    void *ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED)
+        return false;
+
+    const char *addr = (const char*) ptr;
+    GridHeader key = grid_header(s, t_min, t_max, v_min, v_cut, min_bins, t_prec, v_prec);
+    GridHeader header;
+    memcpy(&header, addr, sizeof(header));
+
+    bool valid = !memcmp(&header, &key, offsetof(GridHeader, nt)) &&
+                 header.nt >= 2 &&
+                 length == sizeof(GridHeader) + header.nt*sizeof(GridTBin)
+                           + header.nv*sizeof(GridVBin);
+
+    auto t_bins = (const GridTBin*) (addr + sizeof(GridHeader));
+    auto v_bins = (const GridVBin*) (addr + sizeof(GridHeader) + header.nt*sizeof(GridTBin));
+    for(uint64_t i = 0; valid && i < header.nt; ++i)
+    {
+        valid = (t_bins[i].v_count > 0) &&
+                (t_bins[i].v_offset + t_bins[i].v_count <= header.nv);
+    }
+
+    if(valid) {
+        grids.clear();
+        grids.reserve(header.nt);
+        for(uint64_t i = 0; i < header.nt; ++i)
+        {
+            const GridTBin &t_bin = t_bins[i];
+            std::vector<VDist> v_dist;
+            v_dist.reserve(t_bin.v_count);
+            for(uint64_t j = t_bin.v_offset; j < t_bin.v_offset + t_bin.v_count; ++j)
+            {
+                v_dist.emplace_back(v_bins[j].val, v_bins[j].sig);
+                v_dist.back().cdf = v_bins[j].cdf;
+            }
+            grids.emplace_back(t_bin.val, t_bin.sig_nrad, std::move(v_dist));
+            grids.back().cdf = t_bin.cdf;
+            grids.back().sig_rad = t_bin.sig_rad;
+        }
+    }
+
+    munmap(ptr, length);
+    return valid;
 }
 
 // get differential cross section dsigma/dOmega
@@ -384,6 +758,40 @@ const
     sig_rad *= jacob*unit;
 }
 
+// get differential cross sections dsigma/dOmega for the angles (deg) at the
+// same beam energy (MeV), the angles are calculated by several threads
+void PRadMollerGen::GetXS(double Es, const std::vector<double> &angles,
+                          std::vector<double> &sig_born, std::vector<double> &sig_nrad,
+                          std::vector<double> &sig_rad)
+const
+{
+    sig_born.resize(angles.size());
+    sig_nrad.resize(angles.size());
+    sig_rad.resize(angles.size());
+
+    // shared by all the angles
+    double k1p = sqrt(Es*Es - m2);
+    double s = 2.*m*(Es + m);
+    double jacob0 = (s - 2.*m2)*4.*m*(Es - m)/2./cana::pi*unit;
+
+    parallel_for(angles.size(), nthreads,
+                 [&] (size_t i)
+                 {
+                     double theta = angles[i]*cana::deg2rad;
+                     double cos2 = pow2(cos(theta));
+                     double cosE = (Es - m)*cos2;
+                     double Ep = m*(Es + m + cosE)/(Es + m - cosE);
+                     double k2p = sqrt(Ep*Ep - m2);
+                     double t = pow2(Es - Ep) - pow2(k2p*sin(theta)) - pow2(k2p*cos(theta) - k1p);
+                     double jacob = jacob0/pow2(Es + m - cosE);
+
+                     GetXSdQsq(s, t, sig_born[i], sig_nrad[i], sig_rad[i]);
+                     sig_born[i] *= jacob;
+                     sig_nrad[i] *= jacob;
+                     sig_rad[i] *= jacob;
+                 });
+}
+
 // get differential cross section dsigma/dQ2
 // input Mandelstam variables s, t (MeV^2)
 // output Born, non-radiative, radiative cross sections (MeV^-4)
@@ -493,6 +901,65 @@ const
     return sig_born + sig_IR + sig_S + sig_vert + sig_B + sig_Fs;
 }
 
+// a point of the sampling grids
+// the adaptive refinements already evaluate every point once in a grid, so the
+// memo only helps the later grids, the points are kept until the v range or
+// the v binning changes, or the memo reaches MOLLER_MEMO_VBINS v bins
+TDist PRadMollerGen::GetGridPoint(double s, double t)
+const
+{
+    if(!use_memo)
+        return TDist(t, GetNonRadXSdQsq(s, t), GetRadVDist(s, t));
+
+    auto key = std::make_pair(s, t);
+    {
+        std::lock_guard<std::mutex> lock(memo_locker);
+        double params[4] = {v_min, v_cut, (double)min_bins, v_prec};
+        if(!std::equal(params, params + 4, memo_params)) {
+            memo.clear();
+            memo_stats.points = memo_stats.vbins = 0;
+            std::copy(params, params + 4, memo_params);
+        }
+
+        memo_stats.lookups++;
+        auto it = memo.find(key);
+        if(it != memo.end()) {
+            memo_stats.hits++;
+            return it->second;
+        }
+    }
+
+    // the threads evaluate their points without the lock
+    TDist point(t, GetNonRadXSdQsq(s, t), GetRadVDist(s, t));
+
+    std::lock_guard<std::mutex> lock(memo_locker);
+    if(memo_stats.vbins + point.v_dist.size() <= MOLLER_MEMO_VBINS &&
+       memo.emplace(key, point).second) {
+        memo_stats.points++;
+        memo_stats.vbins += point.v_dist.size();
+    }
+    return point;
+}
+
+PRadMollerGen::MemoStats PRadMollerGen::GetMemoStats()
+const
+{
+    std::lock_guard<std::mutex> lock(memo_locker);
+    return memo_stats;
+}
+
+void PRadMollerGen::ClearPointMemo()
+const
+{
+    std::lock_guard<std::mutex> lock(memo_locker);
+    memo.clear();
+    memo_stats = MemoStats();
+    memo_params[0] = v_min;
+    memo_params[1] = v_cut;
+    memo_params[2] = min_bins;
+    memo_params[3] = v_prec;
+}
+
 // returns the whole v distribution of radiative part in val-cdf way
 std::vector<VDist> PRadMollerGen::GetRadVDist(double s, double t)
 const
@@ -992,28 +1459,67 @@ void PRadMollerGen::MomentumRec(double *k2, double *p2, double *k,
 // Private Function                                                           //
 //============================================================================//
 
+// load the grids from the cache if it is enabled, otherwise initialize them
+// and save them to the cache
+std::vector<TDist> PRadMollerGen::get_grids(double s, double t_min, double t_max, bool verbose)
+const
+{
+    std::vector<TDist> res;
+    if(cache_dir.empty())
+        return init_grids(s, t_min, t_max, verbose);
+
+    std::string path = GetGridCachePath(s, t_min, t_max);
+    if(LoadGrids(path, s, t_min, t_max, res)) {
+        if(verbose) {
+            std::cout << "Loaded sampling grids from \"" << path << "\"."
+                      << std::endl;
+        }
+        return res;
+    }
+
+    res = init_grids(s, t_min, t_max, verbose);
+    if(SaveGrids(path, s, t_min, t_max, res) && verbose) {
+        std::cout << "Saved sampling grids to \"" << path << "\"."
+                  << std::endl;
+    }
+    return res;
+}
+
 // initialize theta grids for events generation
 std::vector<TDist> PRadMollerGen::init_grids(double s, double t_min, double t_max, bool verbose)
 const
 {
-    std::vector<TDist> res;
-    res.reserve(MAX_T_BINS);
     PRadBenchMark timer;
+    MemoStats memo_beg = GetMemoStats();
 
     if(verbose) {
         std::cout << "Initializing grids in theta to sample events..."
                   << std::endl;
     }
 
+    // the points are independent, they are calculated by several threads and
+    // saved by their indices, so the grid does not depend on the threads
+    std::mutex progress_locker;
+    size_t count = 0;
+    auto progress = [&] ()
+                    {
+                        if(!verbose)
+                            return;
+                        std::lock_guard<std::mutex> lock(progress_locker);
+                        show_progress(timer, ++count, min_bins, "bin");
+                    };
+
     double t_step = (t_max - t_min)/(double)min_bins;
+    std::vector<std::vector<TDist>> points(min_bins + 1);
 
-    for(unsigned int i = 0; i <= min_bins; ++i)
-    {
-        // new point
-        double t = t_min + t_step*i;
-        res.emplace_back(t, GetNonRadXSdQsq(s, t), GetRadVDist(s, t));
-        if(verbose) show_progress(timer, i, min_bins, "bin");
-    }
+    parallel_for(points.size(), nthreads,
+                 [&] (size_t i)
+                 {
+                     // new point
+                     double t = t_min + t_step*i;
+                     points[i].emplace_back(GetGridPoint(s, t));
+                     progress();
+                 });
 
     if(verbose) {
         show_progress(timer, min_bins, min_bins, "bin", true);
@@ -1022,14 +1528,33 @@ const
     }
 
     timer.Reset();
+    count = 0;
 
     // refine t bin
-    // the content in the loop will change container's size, so a fix number needs
-    // to be used in for loop
-    for(unsigned int i = 1; i <= min_bins; ++i)
+    // every interval is refined into its own container, with an equal share of
+    // the maximum number of bins
+    size_t max_bins = (min_bins) ? (MAX_T_BINS - points.size())/min_bins : 0;
+    std::vector<std::vector<TDist>> refined(min_bins);
+
+    parallel_for(refined.size(), nthreads,
+                 [&] (size_t i)
+                 {
+                     refine_t_bin(*this, refined[i], points[i].front(), points[i + 1].front(),
+                                  t_prec, s, max_bins);
+                     progress();
+                 });
+
+    // merge in the interval order
+    std::vector<TDist> res;
+    for(auto &bins : refined)
+        count += bins.size();
+    res.reserve(points.size() + count);
+
+    for(size_t i = 0; i < points.size(); ++i)
     {
-        refine_t_bin(*this, res, i - 1, i, t_prec, s);
-        if(verbose) show_progress(timer, i, min_bins, "bin");
+        std::move(points[i].begin(), points[i].end(), std::back_inserter(res));
+        if(i < refined.size())
+            std::move(refined[i].begin(), refined[i].end(), std::back_inserter(res));
     }
 
     // sort in Q2 transcendent (t descendant) order
@@ -1057,6 +1582,16 @@ const
         std::cout << "Interpolation grids finalized! \n"
                   << "Total number of grids t: " << res.size() - 1 << ", v: "
                   << tot_vbins << std::endl;
+
+        MemoStats memo_end = GetMemoStats();
+        if(use_memo && memo_end.lookups >= memo_beg.lookups) {
+            uint64_t lookups = memo_end.lookups - memo_beg.lookups;
+            uint64_t hits = memo_end.hits - memo_beg.hits;
+            std::cout << "Reused " << hits << " of " << lookups << " points from the memo ("
+                      << std::fixed << std::setprecision(1)
+                      << (lookups ? 100.*hits/lookups : 0.) << "%)"
+                      << std::defaultfloat << std::endl;
+        }
     }
 
     res.shrink_to_fit();
@@ -0,0 +1,315 @@
+//============================================================================//
+// A bounded buffer of the most recent events for online monitoring           //
+// The decoding thread writes the events into fixed-size slots, and viewer or //
+// histogram threads read them without locks and without touching the heap    //
+// memory of the buffer, consistency is ensured by per-slot sequence numbers  //
+// The slots can be in a shared memory segment, one process decodes and the   //
+// monitors in the other processes read the same slots                        //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadOnlineBuffer.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <thread>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char shared_magic[8] = {'P', 'R', 'A', 'D', 'S', 'H', 'M', '\0'};
+
+// the slots start at a cache line after the header
+inline size_t slots_offset() {return (sizeof(PRadOnlineBuffer::Header) + 63) & ~(size_t)63;}
+
+inline std::string shm_path(const std::string &name)
+{
+    return (!name.empty() && name[0] == '/') ? name : "/" + name;
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadOnlineBuffer::PRadOnlineBuffer(size_t cap)
+: header(&local_header), slots(nullptr), capacity(0), read_only(false),
+  shm_addr(nullptr), shm_size(0)
+{
+    local_header.written.store(0);
+    local_header.truncated.store(0);
+    Resize(cap);
+}
+
+PRadOnlineBuffer::~PRadOnlineBuffer()
+{
+    release();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// allocate the slots, all the events are removed
+void PRadOnlineBuffer::Resize(size_t cap)
+{
+    if(cap == capacity && !IsShared()) {
+        Clear();
+        return;
+    }
+
+    release();
+    slots = (cap > 0) ? new Slot[cap] : nullptr;
+    capacity = cap;
+    header->written.store(0, std::memory_order_release);
+    header->truncated.store(0, std::memory_order_relaxed);
+}
+
+bool PRadOnlineBuffer::CreateShared(const std::string &name, size_t cap)
+{
+    release();
+    if(!cap)
+        return false;
+
+    std::string path = shm_path(name);
+    // a segment left by a crashed publisher is replaced
+    shm_unlink(path.c_str());
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0) {
+        std::cerr << "PRad Online Buffer Error: Cannot create shared memory "
+                  << path << ", " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    size_t size = slots_offset() + cap*sizeof(Slot);
+    void *addr = MAP_FAILED;
+    if(ftruncate(fd, size) == 0)
+        addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(addr == MAP_FAILED) {
+        std::cerr << "PRad Online Buffer Error: Cannot map shared memory "
+                  << path << ", " << strerror(errno) << std::endl;
+        shm_unlink(path.c_str());
+        return false;
+    }
+
+    // the segment is zero filled, the slots and counters are constructed in it
+    Header *h = new(addr) Header;
+    h->version = ONLINE_SHARED_VERSION;
+    h->slot_size = sizeof(Slot);
+    h->capacity = cap;
+    h->written.store(0, std::memory_order_relaxed);
+    h->truncated.store(0, std::memory_order_relaxed);
+    slots = (Slot*)((char*)addr + slots_offset());
+    for(size_t i = 0; i < cap; ++i)
+        new(&slots[i]) Slot;
+
+    // readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(h->magic, shared_magic, sizeof(shared_magic));
+
+    header = h;
+    capacity = cap;
+    shm_name = path;
+    shm_addr = addr;
+    shm_size = size;
+    read_only = false;
+    return true;
+}
+
+bool PRadOnlineBuffer::OpenShared(const std::string &name)
+{
+    release();
+
+    std::string path = shm_path(name);
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if(fd < 0) {
+        std::cerr << "PRad Online Buffer Error: Cannot open shared memory "
+                  << path << ", " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && (size_t)st.st_size >= slots_offset())
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(addr == MAP_FAILED) {
+        std::cerr << "PRad Online Buffer Error: Cannot map shared memory "
+                  << path << "." << std::endl;
+        return false;
+    }
+
+    // the layout should be from the same version of the library
+    Header *h = (Header*)addr;
+    if(memcmp(h->magic, shared_magic, sizeof(shared_magic)) ||
+       h->version != ONLINE_SHARED_VERSION || h->slot_size != sizeof(Slot) ||
+       slots_offset() + h->capacity*sizeof(Slot) > (size_t)st.st_size) {
+        std::cerr << "PRad Online Buffer Error: " << path
+                  << " is not an online buffer of this version." << std::endl;
+        munmap(addr, st.st_size);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    header = h;
+    slots = (Slot*)((char*)addr + slots_offset());
+    capacity = h->capacity;
+    shm_name = path;
+    shm_addr = addr;
+    shm_size = st.st_size;
+    read_only = true;
+    return true;
+}
+
+// copy an event into the oldest slot
+void PRadOnlineBuffer::Push(const EventData &event)
+{
+    if(!capacity || read_only)
+        return;
+
+    uint64_t idx = header->written.load(std::memory_order_relaxed);
+    Slot &slot = slots[idx%capacity];
+
+    // odd sequence means the slot is being written
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.index = idx;
+    slot.event_number = event.event_number;
+    slot.type = event.type;
+    slot.trigger = event.trigger;
+    slot.timestamp = event.timestamp;
+    slot.epics_index = event.epics_index;
+
+    slot.nadc = std::min<size_t>(event.adc_data.size(), ONLINE_MAX_ADC);
+    slot.ntdc = std::min<size_t>(event.tdc_data.size(), ONLINE_MAX_TDC);
+    slot.ndsc = std::min<size_t>(event.dsc_data.size(), ONLINE_MAX_DSC);
+    slot.ngem = std::min<size_t>(event.gem_data.size(), ONLINE_MAX_GEM);
+    std::copy(event.adc_data.begin(), event.adc_data.begin() + slot.nadc, slot.adc);
+    std::copy(event.tdc_data.begin(), event.tdc_data.begin() + slot.ntdc, slot.tdc);
+    std::copy(event.dsc_data.begin(), event.dsc_data.begin() + slot.ndsc, slot.dsc);
+    std::copy(event.gem_data.begin(), event.gem_data.begin() + slot.ngem, slot.gem);
+
+    if(slot.nadc < event.adc_data.size() || slot.ntdc < event.tdc_data.size() ||
+       slot.ndsc < event.dsc_data.size() || slot.ngem < event.gem_data.size())
+        header->truncated.fetch_add(1, std::memory_order_relaxed);
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+    header->written.store(idx + 1, std::memory_order_release);
+}
+
+// remove all the events, the slots are kept
+void PRadOnlineBuffer::Clear()
+{
+    if(read_only)
+        return;
+
+    header->written.store(0, std::memory_order_release);
+    header->truncated.store(0, std::memory_order_relaxed);
+}
+
+// number of the events available
+size_t PRadOnlineBuffer::Size()
+const
+{
+    return std::min<uint64_t>(GetWritten(), capacity);
+}
+
+// read the event that is back from the latest one, the memory of event is
+// reused, return false if the event is not available or overwritten
+bool PRadOnlineBuffer::Read(size_t back, EventData &event)
+const
+{
+    uint64_t total = GetWritten();
+    if(back >= std::min<uint64_t>(total, capacity))
+        return false;
+
+    return ReadAt(total - 1 - back, event);
+}
+
+bool PRadOnlineBuffer::ReadAt(uint64_t idx, EventData &event)
+const
+{
+    if(!capacity || idx >= GetWritten())
+        return false;
+
+    const Slot &slot = slots[idx%capacity];
+
+    while(true)
+    {
+        uint32_t seq1 = slot.seq.load(std::memory_order_acquire);
+        if(seq1 & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // the contents may be modified during copying, check it afterwards
+        uint64_t sidx = slot.index;
+        event.event_number = slot.event_number;
+        event.type = slot.type;
+        event.trigger = slot.trigger;
+        event.timestamp = slot.timestamp;
+        event.epics_index = slot.epics_index;
+
+        uint32_t nadc = std::min<uint32_t>(slot.nadc, ONLINE_MAX_ADC);
+        uint32_t ntdc = std::min<uint32_t>(slot.ntdc, ONLINE_MAX_TDC);
+        uint32_t ndsc = std::min<uint32_t>(slot.ndsc, ONLINE_MAX_DSC);
+        uint32_t ngem = std::min<uint32_t>(slot.ngem, ONLINE_MAX_GEM);
+        event.adc_data.assign(slot.adc, slot.adc + nadc);
+        event.tdc_data.assign(slot.tdc, slot.tdc + ntdc);
+        event.dsc_data.assign(slot.dsc, slot.dsc + ndsc);
+        event.gem_data.assign(slot.gem, slot.gem + ngem);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t seq2 = slot.seq.load(std::memory_order_relaxed);
+
+        // the slot is written during copying, try again
+        if(seq1 != seq2)
+            continue;
+
+        // the event has been overwritten by a newer one
+        return sidx == idx;
+    }
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// free the slots or unmap the shared segment
+void PRadOnlineBuffer::release()
+{
+    if(shm_addr) {
+        munmap(shm_addr, shm_size);
+        // the publisher removes the segment, the mapped readers keep it until
+        // they are done
+        if(!read_only)
+            shm_unlink(shm_name.c_str());
+        shm_addr = nullptr;
+        shm_size = 0;
+        shm_name.clear();
+    } else {
+        delete [] slots;
+    }
+
+    slots = nullptr;
+    capacity = 0;
+    read_only = false;
+    header = &local_header;
+    header->written.store(0, std::memory_order_release);
+    header->truncated.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,214 @@
+//============================================================================//
+// A scoped profiler for the hot paths                                        //
+// Regions are timed by PRAD_PROFILE_SCOPE, each thread accumulates the       //
+// timing in its own counters, so the instrumentation does not contend        //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadProfiler.h"
+#include "PRadMemoryTracker.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+
+
+PRadProfiler::PRadProfiler()
+: trace(false), origin(Clock::now())
+{
+    regions.reserve(PROFILER_MAX_REGIONS);
+}
+
+PRadProfiler::~PRadProfiler()
+{
+    for(auto &td : threads)
+        delete td;
+}
+
+PRadProfiler &PRadProfiler::Instance()
+{
+    static PRadProfiler instance;
+    return instance;
+}
+
+// register a region and return its id, regions with the same name share the
+// counters, it returns -1 if there is no more space
+int PRadProfiler::Register(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    for(size_t i = 0; i < regions.size(); ++i)
+    {
+        if(regions[i] == name)
+            return i;
+    }
+
+    if(regions.size() >= PROFILER_MAX_REGIONS) {
+        std::cerr << "PRad Profiler Error: reached the maximum number of regions ("
+                  << PROFILER_MAX_REGIONS << "), region " << name
+                  << " is not profiled." << std::endl;
+        return -1;
+    }
+
+    regions.push_back(name);
+    return regions.size() - 1;
+}
+
+// the counters of the calling thread
+PRadProfiler::ThreadData *PRadProfiler::getThreadData()
+{
+    static thread_local ThreadData *data = nullptr;
+
+    if(!data) {
+        std::lock_guard<std::mutex> lock(locker);
+        data = new ThreadData(threads.size());
+        threads.push_back(data);
+    }
+
+    return data;
+}
+
+// only the owner thread writes the counters, relaxed load and store is enough
+void PRadProfiler::Record(int region, const Clock::time_point &beg, const Clock::time_point &end)
+{
+    if(region < 0)
+        return;
+
+    ThreadData *data = getThreadData();
+    uint64_t dur = std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg).count();
+
+    Counter &c = data->counters[region];
+    c.calls.store(c.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    c.total_ns.store(c.total_ns.load(std::memory_order_relaxed) + dur, std::memory_order_relaxed);
+    if(dur > c.max_ns.load(std::memory_order_relaxed))
+        c.max_ns.store(dur, std::memory_order_relaxed);
+
+    // the trace buffer is bounded, only the beginning is kept
+    if(trace && data->trace.size() < PROFILER_TRACE_SIZE) {
+        TraceRecord rec;
+        rec.region = region;
+        rec.begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(beg - origin).count();
+        rec.dur_ns = dur;
+        data->trace.push_back(rec);
+    }
+}
+
+// reset the counters, the trace should not be recording when it is called
+void PRadProfiler::Reset()
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    for(auto &td : threads)
+    {
+        for(auto &c : td->counters)
+        {
+            c.calls.store(0, std::memory_order_relaxed);
+            c.total_ns.store(0, std::memory_order_relaxed);
+            c.max_ns.store(0, std::memory_order_relaxed);
+        }
+        td->trace.clear();
+    }
+    origin = Clock::now();
+}
+
+// merge the counters from all threads
+std::vector<PRadProfiler::Summary> PRadProfiler::GetSummary()
+const
+{
+    std::lock_guard<std::mutex> lock(locker);
+
+    std::vector<Summary> res(regions.size());
+    for(size_t i = 0; i < regions.size(); ++i)
+    {
+        res[i].name = regions[i];
+        for(auto &td : threads)
+        {
+            const Counter &c = td->counters[i];
+            uint64_t calls = c.calls.load(std::memory_order_relaxed);
+            if(!calls)
+                continue;
+            res[i].calls += calls;
+            res[i].total_ns += c.total_ns.load(std::memory_order_relaxed);
+            res[i].max_ns = std::max(res[i].max_ns, c.max_ns.load(std::memory_order_relaxed));
+            res[i].threads++;
+        }
+    }
+
+    // the most expensive region first
+    std::sort(res.begin(), res.end(), [] (const Summary &a, const Summary &b)
+                                      {return a.total_ns > b.total_ns;});
+    return res;
+}
+
+void PRadProfiler::PrintSummary(std::ostream &os)
+const
+{
+    auto summary = GetSummary();
+
+    os << std::setw(32) << std::left << "Region" << std::right
+       << std::setw(12) << "Calls"
+       << std::setw(14) << "Total (ms)"
+       << std::setw(12) << "Mean (us)"
+       << std::setw(12) << "Max (us)"
+       << std::setw(9) << "Threads"
+       << std::endl;
+
+    for(auto &s : summary)
+    {
+        if(!s.calls)
+            continue;
+        os << std::setw(32) << std::left << s.name << std::right
+           << std::setw(12) << s.calls
+           << std::setw(14) << std::fixed << std::setprecision(3) << s.total_ns*1e-6
+           << std::setw(12) << std::setprecision(3) << (double)s.total_ns/s.calls*1e-3
+           << std::setw(12) << std::setprecision(3) << s.max_ns*1e-3
+           << std::setw(9) << s.threads
+           << std::endl;
+    }
+    os.unsetf(std::ios::floatfield);
+
+    // memory of the registered subsystems
+    if(!PRadMemoryTracker::Instance().IsEmpty()) {
+        os << std::endl;
+        PRadMemoryTracker::Instance().PrintSummary(os);
+    }
+}
+
+// save the trace in the chrome tracing format (chrome://tracing), the time
+// is in microseconds, it should be called after the recording threads stopped
+bool PRadProfiler::SaveTrace(const std::string &path)
+const
+{
+    std::ofstream out(path);
+    if(!out.is_open()) {
+        std::cerr << "PRad Profiler Error: cannot open file "
+                  << "\"" << path << "\"" << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(locker);
+
+    out << "{\"traceEvents\":[";
+    out << std::fixed << std::setprecision(3);
+    bool first = true;
+    for(auto &td : threads)
+    {
+        for(auto &rec : td->trace)
+        {
+            if(!first)
+                out << ",";
+            first = false;
+            out << "\n{\"name\":\"" << regions[rec.region] << "\","
+                << "\"ph\":\"X\",\"pid\":0,"
+                << "\"tid\":" << td->tid << ","
+                << "\"ts\":" << rec.begin_ns*1e-3 << ","
+                << "\"dur\":" << rec.dur_ns*1e-3 << "}";
+        }
+    }
+    out << "\n]}" << std::endl;
+
+    return true;
+}
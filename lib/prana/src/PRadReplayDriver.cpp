@@ -0,0 +1,611 @@
+//============================================================================//
+// A driver that processes the split files of a run in parallel               //
+// Each worker has its own copies of the detector systems, data handler and   //
+// run information, and takes the split files one by one. The histograms,     //
+// run information and replayed DST files are merged at the end.              //
+// EPICS values are not carried over between split files, so the first        //
+// EPICS event of a split file may only have values of the updated channels   //
+// In auto-tune mode, the stage thread allocations are benchmarked over the   //
+// first events of the input, and the best one is saved for the host         //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadReplayDriver.h"
+#include "PRadHyCalSystem.h"
+#include "PRadGEMSystem.h"
+#include "PRadEPICSystem.h"
+#include "PRadTaggerSystem.h"
+#include "PRadDSTParser.h"
+#include "PRadDSTMerger.h"
+#include "PRadBenchMark.h"
+#include "PRadThreadTopology.h"
+#include "ConfigParser.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#ifdef MULTI_THREAD
+#include <thread>
+#endif
+
+
+
+//============================================================================//
+// Worker                                                                     //
+//============================================================================//
+
+// copy the systems from driver and connect them to its own handler
+PRadReplayDriver::Worker::Worker(const PRadReplayDriver &driver, unsigned int i)
+: hycal(nullptr), gem(nullptr), epics(nullptr), tagger(nullptr),
+  id(i), count(0), nfiles(0), last_split(-1)
+{
+    // the copies start with empty histograms and data
+    if(driver.hycal_sys) {
+        hycal = new PRadHyCalSystem(*driver.hycal_sys);
+        hycal->SetInfoCenter(&info);
+        hycal->Reset();
+    }
+
+    if(driver.gem_sys) {
+        gem = new PRadGEMSystem(*driver.gem_sys);
+        gem->Reset();
+    }
+
+    if(driver.epic_sys) {
+        epics = new PRadEPICSystem(*driver.epic_sys);
+        epics->Reset();
+    }
+
+    if(driver.tagger_sys) {
+        tagger = new PRadTaggerSystem(*driver.tagger_sys);
+        tagger->Reset();
+    }
+
+    // the files are in parallel, only use the decoding threads of driver
+    handler.SetDecodeThreads(driver.decode_threads);
+    handler.SetInfoCenter(&info);
+    handler.SetHyCalSystem(hycal);
+    handler.SetGEMSystem(gem);
+    handler.SetEPICSystem(epics);
+    handler.SetTaggerSystem(tagger);
+}
+
+PRadReplayDriver::Worker::~Worker()
+{
+    delete hycal;
+    delete gem;
+    delete epics;
+    delete tagger;
+}
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadReplayDriver::PRadReplayDriver(unsigned int nthreads)
+: hycal_sys(nullptr), gem_sys(nullptr), epic_sys(nullptr), tagger_sys(nullptr),
+  info_center(&PRadInfoCenter::Instance()), decode_threads(1), chunk_events(0),
+  chunk_level(DST_CHUNK_LEVEL), epics_keyframe(0), resume(false), next_split(0), auto_tune(false),
+  tune_events(TUNE_EVENTS)
+{
+    SetThreads(nthreads);
+}
+
+PRadReplayDriver::~PRadReplayDriver()
+{
+    // place holder
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// set the run information context to merge results, nullptr means global one
+void PRadReplayDriver::SetInfoCenter(PRadInfoCenter *info)
+{
+    info_center = (info) ? info : &PRadInfoCenter::Instance();
+}
+
+// set number of workers, 0 means using all the hardware threads
+void PRadReplayDriver::SetThreads(unsigned int n)
+{
+#ifdef MULTI_THREAD
+    if(n == 0)
+        n = std::thread::hardware_concurrency();
+    threads = (n > 0) ? n : 1;
+#else
+    // no threads at all, the files are processed one by one
+    (void) n;
+    threads = 1;
+#endif
+}
+
+// replay the split files into DST format, they are merged into one file in
+// the split order, return the number of replayed events
+int PRadReplayDriver::Replay(const std::string &r_path, int split, const std::string &w_path)
+{
+    if(w_path.empty()) {
+        std::cerr << "Replay Driver Error: Output path is required." << std::endl;
+        return 0;
+    }
+
+    prepareTune(r_path, split);
+    int count = run(r_path, split, w_path);
+
+    if(!mergeDST(w_path, split)) {
+        std::cerr << "Replay Driver Error: Failed to merge the replayed files "
+                  << "into \"" << w_path << "\"."
+                  << std::endl;
+    }
+
+    return count;
+}
+
+// decode the split files and only fill histograms and run information, the
+// events are not kept, return the number of processed events
+int PRadReplayDriver::Process(const std::string &r_path, int split)
+{
+    prepareTune(r_path, split);
+    return run(r_path, split, "");
+}
+
+// try the workers and decoding threads within the hardware threads, every
+// worker reads the first events of a split file without keeping the events,
+// the allocation with the highest event rate is applied and saved
+bool PRadReplayDriver::AutoTune(const std::string &r_path, int split, const std::string &file)
+{
+    int nfiles = (split < 0) ? 1 : split + 1;
+    unsigned int nthreads = 1;
+#ifdef MULTI_THREAD
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+#endif
+
+    // powers of 2 and the hardware threads
+    std::vector<unsigned int> counts;
+    for(unsigned int n = 1; n < nthreads; n *= 2)
+        counts.push_back(n);
+    counts.push_back(nthreads);
+
+    tune_results.clear();
+
+    std::cout << "Replay Driver: Tuning " << host_name() << " with the first "
+              << tune_events << " events of \"" << r_path << "\"."
+              << std::endl;
+
+    // warm up the page cache, so the first trial is not penalized
+    tuneTrial(r_path, split, 1, 1);
+
+    for(auto nworkers : counts)
+    {
+        if(nworkers > (unsigned int)nfiles)
+            break;
+
+        for(auto ndecode : counts)
+        {
+            if(nworkers*ndecode > nthreads)
+                break;
+
+            tune_results.emplace_back(tuneTrial(r_path, split, nworkers, ndecode));
+            auto &res = tune_results.back();
+            std::cout << "Replay Driver: " << std::setw(4) << nworkers << " workers, "
+                      << std::setw(4) << ndecode << " decoding threads, "
+                      << std::setw(10) << std::fixed << std::setprecision(1)
+                      << res.Rate() << " events/s"
+                      << std::endl;
+            std::cout.unsetf(std::ios::floatfield);
+
+            // stage throughput from the profiled regions
+            for(auto &stage : res.stages)
+            {
+                if(!stage.calls || !stage.total_ns)
+                    continue;
+                std::cout << "    " << std::setw(36) << std::left << stage.name
+                          << std::right << std::setw(12)
+                          << (uint64_t)(stage.calls*1e9*stage.threads/stage.total_ns)
+                          << " calls/s"
+                          << std::endl;
+            }
+        }
+    }
+
+    auto best = std::max_element(tune_results.begin(), tune_results.end(),
+                                 [] (const TuneResult &a, const TuneResult &b)
+                                 {
+                                     return a.Rate() < b.Rate();
+                                 });
+    if(best == tune_results.end() || !best->events) {
+        std::cerr << "Replay Driver Error: No events from \"" << r_path << "\" "
+                  << "to tune the workers."
+                  << std::endl;
+        return false;
+    }
+
+    threads = best->workers;
+    decode_threads = best->decode_threads;
+
+    std::cout << "Replay Driver: Using " << threads << " workers and "
+              << decode_threads << " decoding threads."
+              << std::endl;
+
+    return SaveTune(file);
+}
+
+// load the tuned configuration of this host
+bool PRadReplayDriver::LoadTune(const std::string &file)
+{
+    ConfigParser c_parser;
+    if(!c_parser.ReadFile(tune_path(file)))
+        return false;
+
+    std::string host = host_name(), name;
+    unsigned int nworkers, ndecode;
+    double rate;
+    while(c_parser.ParseLine())
+    {
+        if(!c_parser.CheckElements(4))
+            continue;
+
+        c_parser >> name >> nworkers >> ndecode >> rate;
+        if(name != host)
+            continue;
+
+        SetThreads(nworkers);
+        SetDecodeThreads(ndecode);
+        return true;
+    }
+
+    return false;
+}
+
+// save the current configuration for this host, the other hosts are kept
+bool PRadReplayDriver::SaveTune(const std::string &file)
+const
+{
+    std::string path = tune_path(file), host = host_name();
+
+    std::vector<std::string> lines;
+    ConfigParser c_parser;
+    if(c_parser.ReadFile(path)) {
+        std::string name;
+        while(c_parser.ParseLine())
+        {
+            if(!c_parser.CheckElements(4))
+                continue;
+            std::string line = c_parser.CurrentLine();
+            c_parser >> name;
+            if(name != host)
+                lines.push_back(line);
+        }
+    }
+
+    double rate = 0.;
+    for(auto &res : tune_results)
+    {
+        if(res.workers == threads && res.decode_threads == decode_threads)
+            rate = res.Rate();
+    }
+
+    std::ofstream out(path);
+    if(!out.is_open()) {
+        std::cerr << "Replay Driver Error: Cannot write the tuned configuration to "
+                  << "\"" << path << "\"." << std::endl;
+        return false;
+    }
+
+    out << "# host, workers, decoding threads, events/s" << std::endl;
+    for(auto &line : lines)
+        out << line << std::endl;
+    out << host << "  " << threads << "  " << decode_threads << "  "
+        << std::fixed << std::setprecision(1) << rate << std::endl;
+    return true;
+}
+
+// path of the split file
+std::string PRadReplayDriver::split_path(const std::string &path, int i)
+{
+    if(i < 0)
+        return path;
+    return path + "." + std::to_string(i);
+}
+
+// path of the tune file, default one is under the home directory
+std::string PRadReplayDriver::tune_path(const std::string &file)
+{
+    if(!file.empty())
+        return file;
+
+    const char *home = getenv("HOME");
+    return ConfigParser::form_path((home && *home) ? home : ".", TUNE_FILE);
+}
+
+std::string PRadReplayDriver::host_name()
+{
+    char name[256];
+    if(gethostname(name, sizeof(name)) != 0)
+        return "localhost";
+    name[sizeof(name) - 1] = '\0';
+    return name;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// create workers and process the files
+int PRadReplayDriver::run(const std::string &r_path, int split, const std::string &w_path)
+{
+    PRadBenchMark timer;
+
+    // no split is treated as a single file
+    int nfiles = (split < 0) ? 1 : split + 1;
+    unsigned int nworkers = std::min<unsigned int>(threads, nfiles);
+
+    std::cout << "Replay Driver: Processing " << nfiles << " files from "
+              << "\"" << r_path << "\" with " << nworkers << " workers."
+              << std::endl;
+
+    // systems are copied in this thread
+    std::vector<Worker*> workers;
+    for(unsigned int i = 0; i < nworkers; ++i)
+    {
+        workers.push_back(new Worker(*this, i));
+    }
+
+    next_split = (split < 0) ? -1 : 0;
+
+#ifdef MULTI_THREAD
+    std::vector<std::thread> worker_threads;
+    for(auto &worker : workers)
+    {
+        worker_threads.emplace_back(&PRadReplayDriver::work, this, worker,
+                                    std::cref(r_path), split, std::cref(w_path));
+    }
+
+    for(auto &thread : worker_threads)
+        thread.join();
+#else
+    for(auto &worker : workers)
+        work(worker, r_path, split, w_path);
+#endif
+
+    merge(workers);
+
+    int count = 0;
+    for(auto &worker : workers)
+    {
+        count += worker->count;
+        delete worker;
+    }
+
+    std::cout << "Replay Driver: Done, took "
+              << timer.GetElapsedTime()/1000. << " s! "
+              << "Processed " << count << " events."
+              << std::endl;
+
+    return count;
+}
+
+// take the split files one by one until all of them are taken
+void PRadReplayDriver::work(Worker *worker, const std::string &r_path, int split,
+                            const std::string &w_path)
+{
+    // the events and buffers of the files are allocated after pinning, so they
+    // are on the memory of the worker node
+#ifdef MULTI_THREAD
+    PRadThreadTopology::Instance().PinWorker(worker->id);
+#endif
+
+    // keep the events only for the current one
+    if(w_path.empty())
+        worker->handler.SetOnlineMode(true);
+
+    // the split outputs are temporary, only the final output is chunked
+    if(split < 0)
+        worker->handler.SetChunkedDST(chunk_events, chunk_level);
+    worker->handler.SetEPICSDeltaDST(epics_keyframe);
+
+    // use the run number of driver, or find it from the file name
+    worker->info.ChangeRunNumber(info_center->RunNumber());
+    if(worker->info.RunNumber() <= 0)
+        worker->info.ChangeRunNumber(r_path);
+
+    while(true)
+    {
+        int i = next_split.fetch_add(1);
+        if(i > split)
+            break;
+
+        std::string path = split_path(r_path, i);
+        if(w_path.empty())
+            worker->count += worker->handler.ReadFromEvio(path);
+        else
+            worker->count += worker->handler.Replay(path, -1, split_path(w_path, i), resume);
+
+        worker->nfiles++;
+        worker->last_split = i;
+
+        // no split, only one file
+        if(i < 0)
+            break;
+    }
+}
+
+// merge the results from workers to the original systems
+void PRadReplayDriver::merge(const std::vector<Worker*> &workers)
+{
+    // the online information is the latest, so merge the worker processed the
+    // last file at the end
+    std::vector<Worker*> ordered(workers);
+    std::sort(ordered.begin(), ordered.end(),
+              [] (const Worker *a, const Worker *b)
+              {
+                  return a->last_split < b->last_split;
+              });
+
+    for(auto &worker : ordered)
+    {
+        // the worker did not process any file
+        if(!worker->nfiles)
+            continue;
+
+        if(hycal_sys && worker->hycal)
+            hycal_sys->MergeHists(*worker->hycal);
+
+        if(tagger_sys && worker->tagger)
+            tagger_sys->MergeHists(*worker->tagger);
+
+        info_center->Merge(worker->info);
+    }
+}
+
+// apply the tuned configuration of this host, or benchmark it
+void PRadReplayDriver::prepareTune(const std::string &r_path, int split)
+{
+    if(!auto_tune || LoadTune(tune_file))
+        return;
+
+    AutoTune(r_path, split, tune_file);
+}
+
+// read the first events of the split files by nworkers, the profiler is reset
+// so the stages are only from this trial
+PRadReplayDriver::TuneResult PRadReplayDriver::tuneTrial(const std::string &r_path,
+                                                         int split,
+                                                         unsigned int nworkers,
+                                                         unsigned int ndecode)
+{
+    TuneResult res(nworkers, ndecode);
+
+    unsigned int decode_save = decode_threads;
+    decode_threads = ndecode;
+    std::vector<Worker*> workers;
+    for(unsigned int i = 0; i < nworkers; ++i)
+        workers.push_back(new Worker(*this, i));
+    decode_threads = decode_save;
+
+    int nfiles = (split < 0) ? 1 : split + 1;
+    auto trial = [&] (Worker *worker)
+                 {
+#ifdef MULTI_THREAD
+                     PRadThreadTopology::Instance().PinWorker(worker->id);
+#endif
+                     worker->handler.SetOnlineMode(true);
+                     worker->info.ChangeRunNumber(info_center->RunNumber());
+                     if(worker->info.RunNumber() <= 0)
+                         worker->info.ChangeRunNumber(r_path);
+
+                     int i = (split < 0) ? -1 : (int)(worker->id%nfiles);
+                     worker->count = worker->handler.ReadFromEvio(split_path(r_path, i),
+                                                                  tune_events);
+                 };
+
+    PRadProfiler::Instance().Reset();
+    PRadBenchMark timer;
+
+#ifdef MULTI_THREAD
+    std::vector<std::thread> trial_threads;
+    for(auto &worker : workers)
+        trial_threads.emplace_back(trial, worker);
+    for(auto &thread : trial_threads)
+        thread.join();
+#else
+    for(auto &worker : workers)
+        trial(worker);
+#endif
+
+    res.time = timer.GetElapsedTime();
+    res.stages = PRadProfiler::Instance().GetSummary();
+
+    for(auto &worker : workers)
+    {
+        res.events += worker->count;
+        delete worker;
+    }
+
+    return res;
+}
+
+// merge the replayed split files to one file, the split files are removed
+bool PRadReplayDriver::mergeDST(const std::string &w_path, int split)
+{
+    // no split, the replay is already in the output
+    if(split < 0)
+        return true;
+
+    // the split files are copied as they are if no conversion is needed
+    if(!chunk_events) {
+        std::vector<std::string> inputs;
+        for(int i = 0; i <= split; ++i)
+            inputs.push_back(split_path(w_path, i));
+
+        PRadDSTMerger merger(threads);
+        if(!merger.Merge(inputs, w_path))
+            return false;
+
+        for(auto &path : inputs)
+            std::remove(path.c_str());
+        return true;
+    }
+
+    PRadDSTParser dst_parser;
+    dst_parser.SetChunkedOutput(chunk_events, chunk_level);
+    dst_parser.SetEPICSDelta(epics_keyframe);
+    dst_parser.OpenOutput(w_path);
+
+    bool success = true;
+    for(int i = 0; i <= split; ++i)
+    {
+        std::string path = split_path(w_path, i);
+        dst_parser.OpenInput(path);
+        if(dst_parser.HasInputSummary())
+            dst_parser.GetOutputSummary().Merge(dst_parser.GetInputSummary());
+
+        bool merged = true;
+        try {
+            while(dst_parser.Read())
+            {
+                switch(dst_parser.EventType())
+                {
+                case PRadDSTParser::Type::event:
+                    dst_parser.WriteEvent();
+                    break;
+                case PRadDSTParser::Type::epics:
+                    dst_parser.WriteEPICS();
+                    break;
+                case PRadDSTParser::Type::recon:
+                    dst_parser.WriteRecon();
+                    break;
+                default:
+                    break;
+                }
+            }
+        } catch(PRadException &e) {
+            std::cerr << e.FailureType() << ": "
+                      << e.FailureDesc() << std::endl;
+            merged = false;
+        }
+
+        dst_parser.CloseInput();
+
+        // keep the file if it failed to be merged
+        if(merged)
+            std::remove(path.c_str());
+        else
+            success = false;
+    }
+
+    dst_parser.CloseOutput();
+    return success;
+}
@@ -0,0 +1,661 @@
+//============================================================================//
+// A coordinator distributing the replay of many runs to worker processes     //
+// The split files are grouped into units balanced by bytes, the units are    //
+// dispatched to the workers through pipes with a simple line protocol, and   //
+// failed units are retried. The progress is recorded in a checkpoint file,   //
+// and the DST files and histograms of the units are merged for every run     //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadReplayFarm.h"
+#include "PRadReplayDriver.h"
+#include "PRadDataHandler.h"
+#include "PRadHyCalSystem.h"
+#include "PRadInfoCenter.h"
+#include "PRadDSTMerger.h"
+#include "PRadException.h"
+#include "PRadBenchMark.h"
+#ifndef PRAD_NO_ROOT
+#include "TFileMerger.h"
+#endif
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+PRadReplayFarm::PRadReplayFarm()
+: unit_bytes(FARM_UNIT_BYTES), retries(FARM_RETRIES), keep_parts(false)
+{
+    // place holder
+}
+
+PRadReplayFarm::~PRadReplayFarm()
+{
+    for(auto &w : workers)
+        stop(w, true);
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+void PRadReplayFarm::AddRun(const std::string &input, int split, const std::string &output)
+{
+    Run run;
+    run.input = input;
+    run.output = output;
+    run.split = split;
+    run.merged = false;
+    runs.push_back(run);
+}
+
+// remove the runs and units, the workers are kept
+void PRadReplayFarm::Clear()
+{
+    runs.clear();
+    units.clear();
+    queue.clear();
+    finished.clear();
+}
+
+// replay the runs with the workers, the units are taken by the idle workers
+// until all of them are done or failed, and then the runs are merged
+bool PRadReplayFarm::Process()
+{
+    if(workers.empty()) {
+        std::cerr << "Replay Farm Error: No worker is added." << std::endl;
+        return false;
+    }
+
+    // a dead worker should not kill the coordinator
+    std::signal(SIGPIPE, SIG_IGN);
+
+    PRadBenchMark timer;
+    partition();
+    loadCheckpoint();
+
+    // the largest units go first so the long ones do not end up last
+    uint64_t total_bytes = 0;
+    std::vector<int> pending;
+    for(auto &unit : units)
+    {
+        if(unit.status == Pending) {
+            pending.push_back(unit.id);
+            total_bytes += unit.bytes;
+        }
+    }
+    std::stable_sort(pending.begin(), pending.end(),
+                     [this] (int a, int b) {return units[a].bytes > units[b].bytes;});
+    queue.assign(pending.begin(), pending.end());
+
+    std::cout << "Replay Farm: " << runs.size() << " runs in " << units.size()
+              << " units, " << queue.size() << " units (" << total_bytes/1e9
+              << " GB) to be replayed by " << workers.size() << " workers."
+              << std::endl;
+
+    if(!queue.empty()) {
+        for(auto &w : workers)
+            start(w);
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<Worker*> polled;
+    while(true)
+    {
+        fds.clear();
+        polled.clear();
+        bool busy = false;
+        for(auto &w : workers)
+        {
+            if(w.out_fd < 0)
+                continue;
+            fds.push_back(pollfd{w.out_fd, POLLIN, 0});
+            polled.push_back(&w);
+            busy |= (w.unit >= 0);
+        }
+
+        // finished, or no worker is left
+        if((queue.empty() && !busy) || fds.empty())
+            break;
+
+        if(poll(fds.data(), fds.size(), -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            std::cerr << "Replay Farm Error: Failed to poll the workers." << std::endl;
+            break;
+        }
+
+        for(size_t i = 0; i < fds.size(); ++i)
+        {
+            if(fds[i].revents)
+                receive(*polled[i]);
+        }
+    }
+
+    for(auto &w : workers)
+    {
+        if(w.in_fd >= 0 && write(w.in_fd, "QUIT\n", 5) < 0) {
+            // the worker is already gone
+        }
+        stop(w, false);
+    }
+
+    // units left in the queue have no worker to run them
+    for(auto &id : queue)
+        units[id].status = Failed;
+    queue.clear();
+
+    bool success = true;
+    for(auto &run : runs)
+    {
+        if(run.merged)
+            continue;
+
+        bool done = true;
+        for(auto &id : run.units)
+            done &= (units[id].status == Done);
+
+        if(!done) {
+            std::cerr << "Replay Farm Error: Run \"" << run.input << "\" is not "
+                      << "completely replayed, it is not merged." << std::endl;
+            success = false;
+        } else if(mergeRun(run)) {
+            run.merged = true;
+            record("MERGED " + run.output);
+        } else {
+            std::cerr << "Replay Farm Error: Failed to merge run \"" << run.input
+                      << "\" into \"" << run.output << "\"." << std::endl;
+            success = false;
+        }
+    }
+
+    std::cout << "Replay Farm: Done, took " << timer.GetElapsedTime()/1000. << " s."
+              << std::endl;
+    return success;
+}
+
+std::string PRadReplayFarm::hist_path(const std::string &output)
+{
+    std::string stem = output;
+    if(stem.size() > 4 && stem.substr(stem.size() - 4) == ".dst")
+        stem.erase(stem.size() - 4);
+    return stem + "_hist.root";
+}
+
+// the unit of a run without splitting writes the run histograms directly
+std::string PRadReplayFarm::unit_hist_path(const std::string &output, int first)
+{
+    return PRadReplayDriver::split_path(hist_path(output), first);
+}
+
+
+
+//============================================================================//
+// Worker Side                                                                //
+//============================================================================//
+
+static bool write_all(int fd, const std::string &str)
+{
+    size_t pos = 0;
+    while(pos < str.size())
+    {
+        ssize_t n = write(fd, str.data() + pos, str.size() - pos);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        pos += n;
+    }
+    return true;
+}
+
+// replay the units requested by the coordinator, the run is initialized by
+// its first file when it is changed, and the histograms are reset for every
+// unit, so the coordinator can add them
+int PRadReplayFarm::Serve(PRadDataHandler *handler)
+{
+    // the protocol takes the standard output, the other outputs go to the
+    // standard error
+    std::cout.flush();
+    int proto_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    auto reply = [proto_fd] (const std::string &line)
+                 {
+                     return write_all(proto_fd, line + "\n");
+                 };
+
+    reply("READY");
+
+    int count = 0;
+    std::string line, init_file;
+    while(std::getline(std::cin, line))
+    {
+        std::istringstream iss(line);
+        std::string cmd, input, output, hist;
+        int id = -1, first = -1, last = -1, resume = 0;
+        iss >> cmd;
+
+        if(cmd == "QUIT")
+            break;
+
+        if(cmd != "UNIT" || !(iss >> id >> input >> first >> last >> output >> hist >> resume)) {
+            reply("FAIL " + std::to_string(id) + " cannot understand \"" + line + "\"");
+            continue;
+        }
+
+        std::string reason;
+        int nevents = 0;
+        try {
+            // the run is initialized by its first file
+            std::string init = PRadReplayDriver::split_path(input, (first < 0) ? -1 : 0);
+            if(init != init_file) {
+                if(!std::ifstream(init).good())
+                    throw PRadException("FILE ERROR", "cannot open " + init);
+                handler->InitializeByData(init);
+                init_file = init;
+            } else {
+                int run_number = handler->GetInfoCenter()->RunNumber();
+                handler->Clear();
+                handler->GetInfoCenter()->ChangeRunNumber(run_number);
+            }
+
+            for(int i = first; i <= last; ++i)
+            {
+                std::string path = PRadReplayDriver::split_path(input, i);
+                if(!std::ifstream(path).good())
+                    throw PRadException("FILE ERROR", "cannot open " + path);
+                nevents += handler->Replay(path, -1, PRadReplayDriver::split_path(output, i),
+                                           resume != 0);
+            }
+
+#ifndef PRAD_NO_ROOT
+            if(handler->GetHyCalSystem())
+                handler->GetHyCalSystem()->SaveHists(hist);
+#endif
+        } catch(PRadException &e) {
+            reason = std::string(e.FailureType()) + ": " + e.FailureDesc();
+            std::replace(reason.begin(), reason.end(), '\n', ' ');
+        }
+
+        std::cout.flush();
+        bool sent;
+        if(reason.empty())
+            sent = reply("DONE " + std::to_string(id) + " " + std::to_string(nevents));
+        else
+            sent = reply("FAIL " + std::to_string(id) + " " + reason);
+
+        // the coordinator is gone
+        if(!sent)
+            break;
+        count++;
+    }
+
+    close(proto_fd);
+    return count;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+static uint64_t file_size(const std::string &path)
+{
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0)
+        return 0;
+    return st.st_size;
+}
+
+// group the consecutive split files of a run until the unit size is reached
+void PRadReplayFarm::partition()
+{
+    units.clear();
+
+    for(size_t r = 0; r < runs.size(); ++r)
+    {
+        Run &run = runs[r];
+        run.units.clear();
+
+        if(run.split < 0) {
+            units.emplace_back(units.size(), r, -1, -1);
+            units.back().bytes = file_size(run.input);
+            run.units.push_back(units.back().id);
+            continue;
+        }
+
+        for(int i = 0; i <= run.split; ++i)
+        {
+            uint64_t bytes = file_size(PRadReplayDriver::split_path(run.input, i));
+            if(!bytes) {
+                std::cerr << "Replay Farm Warning: Cannot find the size of \""
+                          << PRadReplayDriver::split_path(run.input, i) << "\"."
+                          << std::endl;
+            }
+
+            if(run.units.empty() || units.back().bytes + bytes > unit_bytes) {
+                units.emplace_back(units.size(), r, i, i);
+                run.units.push_back(units.back().id);
+            }
+            units.back().last = i;
+            units.back().bytes += bytes;
+        }
+    }
+}
+
+// the units and runs recorded in the checkpoint are not processed again
+void PRadReplayFarm::loadCheckpoint()
+{
+    finished.clear();
+    if(ckpt_path.empty())
+        return;
+
+    std::ifstream ckpt(ckpt_path);
+    std::string line;
+    while(std::getline(ckpt, line))
+    {
+        if(!line.empty())
+            finished.push_back(line);
+    }
+
+    auto is_finished = [this] (const std::string &line)
+                       {
+                           return std::find(finished.begin(), finished.end(), line) != finished.end();
+                       };
+
+    int nunits = 0;
+    for(auto &run : runs)
+    {
+        run.merged = is_finished("MERGED " + run.output);
+        for(auto &id : run.units)
+        {
+            Unit &unit = units[id];
+            if(run.merged || is_finished("DONE " + unitKey(unit))) {
+                unit.status = Done;
+                nunits++;
+            }
+        }
+    }
+
+    if(!finished.empty()) {
+        std::cout << "Replay Farm: Resumed from \"" << ckpt_path << "\", "
+                  << nunits << " units are already done." << std::endl;
+    }
+}
+
+// append a line to the checkpoint file, it is closed so the line is kept
+// even if the coordinator is killed
+void PRadReplayFarm::record(const std::string &line)
+{
+    finished.push_back(line);
+    if(ckpt_path.empty())
+        return;
+
+    std::ofstream ckpt(ckpt_path, std::ios::app);
+    ckpt << line << std::endl;
+}
+
+// the unit is identified by its files, so the checkpoint is valid as long as
+// the files are grouped in the same way
+std::string PRadReplayFarm::unitKey(const Unit &unit)
+const
+{
+    return runs[unit.run].input + " " + std::to_string(unit.first) + " "
+           + std::to_string(unit.last);
+}
+
+// start the worker command with its standard input and output connected to
+// the pipes
+bool PRadReplayFarm::start(Worker &w)
+{
+    int to_worker[2], from_worker[2];
+    if(pipe(to_worker) != 0)
+        return false;
+    if(pipe(from_worker) != 0) {
+        close(to_worker[0]);
+        close(to_worker[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if(pid < 0) {
+        std::cerr << "Replay Farm Error: Cannot start worker \"" << w.command << "\"."
+                  << std::endl;
+        close(to_worker[0]);
+        close(to_worker[1]);
+        close(from_worker[0]);
+        close(from_worker[1]);
+        return false;
+    }
+
+    if(pid == 0) {
+        dup2(to_worker[0], STDIN_FILENO);
+        dup2(from_worker[1], STDOUT_FILENO);
+        close(to_worker[0]);
+        close(to_worker[1]);
+        close(from_worker[0]);
+        close(from_worker[1]);
+        execl("/bin/sh", "sh", "-c", w.command.c_str(), (char*) nullptr);
+        _exit(127);
+    }
+
+    close(to_worker[0]);
+    close(from_worker[1]);
+    // the later workers should not hold the pipes, or the end of a worker
+    // cannot be seen
+    fcntl(to_worker[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_worker[0], F_SETFD, FD_CLOEXEC);
+
+    w.pid = pid;
+    w.in_fd = to_worker[1];
+    w.out_fd = from_worker[0];
+    w.ready = false;
+    w.unit = -1;
+    w.buffer.clear();
+    return true;
+}
+
+void PRadReplayFarm::stop(Worker &w, bool kill_it)
+{
+    if(w.pid < 0)
+        return;
+
+    if(kill_it)
+        kill(w.pid, SIGTERM);
+
+    if(w.in_fd >= 0)
+        close(w.in_fd);
+    if(w.out_fd >= 0)
+        close(w.out_fd);
+    waitpid(w.pid, nullptr, 0);
+
+    w.pid = -1;
+    w.in_fd = w.out_fd = -1;
+    w.ready = false;
+}
+
+// give the next unit to an idle worker
+bool PRadReplayFarm::dispatch(Worker &w)
+{
+    if(!w.ready || w.unit >= 0 || queue.empty())
+        return false;
+
+    int id = queue.front();
+    queue.pop_front();
+
+    Unit &unit = units[id];
+    const Run &run = runs[unit.run];
+
+    // the outputs of a retried or resumed unit continue from their checkpoints
+    bool resume = (unit.attempts > 0) || !finished.empty();
+
+    std::ostringstream oss;
+    oss << "UNIT " << id << " " << run.input << " " << unit.first << " " << unit.last
+        << " " << run.output << " " << unit_hist_path(run.output, unit.first)
+        << " " << (resume ? 1 : 0) << "\n";
+
+    unit.status = Running;
+    w.unit = id;
+    if(!write_all(w.in_fd, oss.str())) {
+        release(w);
+        return false;
+    }
+
+    std::cout << "Replay Farm: Unit " << id << " (" << unit.bytes/1e6 << " MB of \""
+              << run.input << "\") is sent to worker " << w.pid << "." << std::endl;
+    return true;
+}
+
+// read the replies of a worker, it is restarted if it is ended
+void PRadReplayFarm::receive(Worker &w)
+{
+    char buf[4096];
+    ssize_t n = read(w.out_fd, buf, sizeof(buf));
+    if(n < 0 && errno == EINTR)
+        return;
+
+    if(n <= 0) {
+        std::cerr << "Replay Farm Error: Worker " << w.pid << " (" << w.command
+                  << ") is ended." << std::endl;
+        release(w);
+        stop(w, true);
+        if(!queue.empty() && w.restarts < retries) {
+            w.restarts++;
+            start(w);
+        }
+        return;
+    }
+
+    w.buffer.append(buf, n);
+    size_t pos;
+    while((pos = w.buffer.find('\n')) != std::string::npos)
+    {
+        std::string line = w.buffer.substr(0, pos);
+        w.buffer.erase(0, pos + 1);
+        handle(w, line);
+    }
+}
+
+void PRadReplayFarm::handle(Worker &w, const std::string &line)
+{
+    std::istringstream iss(line);
+    std::string cmd;
+    int id = -1;
+    iss >> cmd >> id;
+
+    // the worker may print before it starts serving, such as the messages of
+    // loading its configurations
+    if(!w.ready && cmd != "READY") {
+        std::cout << line << std::endl;
+        return;
+    }
+
+    if(cmd == "READY") {
+        w.ready = true;
+    } else if(cmd == "DONE" && id == w.unit) {
+        int nevents = 0;
+        iss >> nevents;
+        Unit &unit = units[id];
+        unit.status = Done;
+        record("DONE " + unitKey(unit));
+        w.unit = -1;
+        std::cout << "Replay Farm: Unit " << id << " is done by worker " << w.pid
+                  << ", " << nevents << " events." << std::endl;
+    } else if(cmd == "FAIL" && id == w.unit) {
+        std::string reason;
+        std::getline(iss, reason);
+        std::cerr << "Replay Farm Error: Unit " << id << " failed on worker " << w.pid
+                  << ":" << reason << std::endl;
+        release(w);
+    } else {
+        std::cerr << "Replay Farm Warning: Unexpected reply \"" << line << "\" from worker "
+                  << w.pid << "." << std::endl;
+    }
+
+    dispatch(w);
+}
+
+// put the unit of the worker back to the queue if it can be retried
+void PRadReplayFarm::release(Worker &w)
+{
+    if(w.unit < 0)
+        return;
+
+    Unit &unit = units[w.unit];
+    w.unit = -1;
+
+    if(++unit.attempts <= retries) {
+        unit.status = Pending;
+        queue.push_back(unit.id);
+    } else {
+        unit.status = Failed;
+        std::cerr << "Replay Farm Error: Unit " << unit.id << " failed "
+                  << unit.attempts << " times, give up." << std::endl;
+    }
+}
+
+// merge the split outputs into the run DST file, and the unit histograms into
+// the run histograms
+bool PRadReplayFarm::mergeRun(Run &run)
+{
+    // no split, the unit outputs are the run outputs
+    if(run.split < 0)
+        return true;
+
+    std::vector<std::string> dsts, hists;
+    for(auto &id : run.units)
+    {
+        const Unit &unit = units[id];
+        hists.push_back(unit_hist_path(run.output, unit.first));
+        for(int i = unit.first; i <= unit.last; ++i)
+            dsts.push_back(PRadReplayDriver::split_path(run.output, i));
+    }
+
+    PRadDSTMerger dst_merger;
+    if(!dst_merger.Merge(dsts, run.output))
+        return false;
+
+    // the units do not save histograms without ROOT
+#ifndef PRAD_NO_ROOT
+    TFileMerger hist_merger(false, false);
+    hist_merger.OutputFile(hist_path(run.output).c_str(), true);
+    for(auto &hist : hists)
+        hist_merger.AddFile(hist.c_str(), false);
+    if(!hist_merger.Merge())
+        return false;
+#endif
+
+    if(!keep_parts) {
+        for(auto &path : dsts)
+            std::remove(path.c_str());
+#ifndef PRAD_NO_ROOT
+        for(auto &path : hists)
+            std::remove(path.c_str());
+#endif
+    }
+
+    std::cout << "Replay Farm: Run \"" << run.input << "\" is merged into \""
+              << run.output << "\"." << std::endl;
+    return true;
+}
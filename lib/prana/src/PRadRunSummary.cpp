@@ -0,0 +1,261 @@
+//============================================================================//
+// Summary of the events in a DST file                                        //
+// The trigger counts, beam charge, live time, channel occupancies and the    //
+// ranges of EPICS values are accumulated while the events are written, it    //
+// is saved after the event map and read without going through the events    //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadRunSummary.h"
+#include <algorithm>
+#include <cstring>
+
+// encoding helpers, the values are in the native layout like the records
+template<typename T>
+inline void sum_write(std::vector<char> &buf, const T &val)
+{
+    const char *p = reinterpret_cast<const char*>(&val);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+template<typename T>
+inline void sum_write(std::vector<char> &buf, const std::vector<T> &vec)
+{
+    sum_write(buf, (uint32_t)vec.size());
+    const char *p = reinterpret_cast<const char*>(vec.data());
+    buf.insert(buf.end(), p, p + vec.size()*sizeof(T));
+}
+
+template<typename T>
+inline bool sum_read(const char *buf, size_t size, size_t &idx, T &val)
+{
+    if(idx + sizeof(T) > size)
+        return false;
+    memcpy(&val, buf + idx, sizeof(T));
+    idx += sizeof(T);
+    return true;
+}
+
+template<typename T>
+inline bool sum_read(const char *buf, size_t size, size_t &idx, std::vector<T> &vec)
+{
+    uint32_t n;
+    if(!sum_read(buf, size, idx, n) || idx + (uint64_t)n*sizeof(T) > size)
+        return false;
+    vec.resize(n);
+    if(n)
+        memcpy(&vec[0], buf + idx, n*sizeof(T));
+    idx += n*sizeof(T);
+    return true;
+}
+
+
+
+//============================================================================//
+// EPICS Range                                                                //
+//============================================================================//
+
+void PRadRunSummary::EPICSRange::Add(float val)
+{
+    if(!count) {
+        min = max = val;
+    } else {
+        min = std::min(min, val);
+        max = std::max(max, val);
+    }
+    count++;
+}
+
+void PRadRunSummary::EPICSRange::Merge(const EPICSRange &that)
+{
+    if(!that.count)
+        return;
+
+    if(!count) {
+        *this = that;
+        return;
+    }
+
+    min = std::min(min, that.min);
+    max = std::max(max, that.max);
+    count += that.count;
+}
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadRunSummary::PRadRunSummary()
+{
+    Clear();
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+void PRadRunSummary::Clear()
+{
+    run_number = 0;
+    complete = true;
+    nevents = nphysics = nepics = 0;
+    first_event = last_event = -1;
+    first_time = last_time = 0;
+    trg_counts.assign(MAX_Trigger, 0);
+    counter.reset();
+    occupancy.clear();
+    epics_ranges.clear();
+}
+
+void PRadRunSummary::Add(const EventData &event)
+{
+    if(!nevents) {
+        first_event = event.event_number;
+        first_time = event.timestamp;
+    }
+    last_event = event.event_number;
+    last_time = event.timestamp;
+    nevents++;
+
+    if(event.trigger < trg_counts.size())
+        trg_counts[event.trigger]++;
+
+    // only the sync events add to the counter
+    counter.Add(event);
+
+    if(!event.is_physics_event())
+        return;
+
+    nphysics++;
+    for(auto &adc : event.adc_data)
+    {
+        if(adc.channel_id >= occupancy.size())
+            occupancy.resize(adc.channel_id + 1, 0);
+        occupancy[adc.channel_id]++;
+    }
+}
+
+void PRadRunSummary::Add(const EpicsData &epics)
+{
+    nepics++;
+
+    if(epics.values.size() > epics_ranges.size())
+        epics_ranges.resize(epics.values.size());
+    for(size_t i = 0; i < epics.values.size(); ++i)
+        epics_ranges[i].Add(epics.values[i]);
+}
+
+void PRadRunSummary::Merge(const PRadRunSummary &that)
+{
+    if(!run_number)
+        run_number = that.run_number;
+    complete = complete && that.complete;
+
+    if(that.nevents) {
+        if(!nevents) {
+            first_event = that.first_event;
+            first_time = that.first_time;
+        }
+        last_event = that.last_event;
+        last_time = that.last_time;
+    }
+    nevents += that.nevents;
+    nphysics += that.nphysics;
+    nepics += that.nepics;
+
+    if(that.trg_counts.size() > trg_counts.size())
+        trg_counts.resize(that.trg_counts.size(), 0);
+    for(size_t i = 0; i < that.trg_counts.size(); ++i)
+        trg_counts[i] += that.trg_counts[i];
+
+    counter.Merge(that.counter);
+
+    if(that.occupancy.size() > occupancy.size())
+        occupancy.resize(that.occupancy.size(), 0);
+    for(size_t i = 0; i < that.occupancy.size(); ++i)
+        occupancy[i] += that.occupancy[i];
+
+    if(that.epics_ranges.size() > epics_ranges.size())
+        epics_ranges.resize(that.epics_ranges.size());
+    for(size_t i = 0; i < that.epics_ranges.size(); ++i)
+        epics_ranges[i].Merge(that.epics_ranges[i]);
+}
+
+void PRadRunSummary::Encode(std::vector<char> &buf)
+const
+{
+    sum_write(buf, (uint32_t)RUN_SUMMARY_VERSION);
+    sum_write(buf, run_number);
+    sum_write(buf, (uint32_t)complete);
+    sum_write(buf, nevents);
+    sum_write(buf, nphysics);
+    sum_write(buf, nepics);
+    sum_write(buf, first_event);
+    sum_write(buf, last_event);
+    sum_write(buf, first_time);
+    sum_write(buf, last_time);
+    sum_write(buf, counter.beam_charge);
+    sum_write(buf, counter.live_charge);
+    sum_write(buf, counter.dead_count);
+    sum_write(buf, counter.ungated_count);
+    sum_write(buf, trg_counts);
+    sum_write(buf, occupancy);
+    sum_write(buf, epics_ranges);
+}
+
+bool PRadRunSummary::Decode(const char *buf, size_t size)
+{
+    Clear();
+
+    size_t idx = 0;
+    uint32_t version, comp;
+    if(!sum_read(buf, size, idx, version) || version != RUN_SUMMARY_VERSION)
+        return false;
+
+    bool success = sum_read(buf, size, idx, run_number)
+                && sum_read(buf, size, idx, comp)
+                && sum_read(buf, size, idx, nevents)
+                && sum_read(buf, size, idx, nphysics)
+                && sum_read(buf, size, idx, nepics)
+                && sum_read(buf, size, idx, first_event)
+                && sum_read(buf, size, idx, last_event)
+                && sum_read(buf, size, idx, first_time)
+                && sum_read(buf, size, idx, last_time)
+                && sum_read(buf, size, idx, counter.beam_charge)
+                && sum_read(buf, size, idx, counter.live_charge)
+                && sum_read(buf, size, idx, counter.dead_count)
+                && sum_read(buf, size, idx, counter.ungated_count)
+                && sum_read(buf, size, idx, trg_counts)
+                && sum_read(buf, size, idx, occupancy)
+                && sum_read(buf, size, idx, epics_ranges);
+
+    if(!success) {
+        Clear();
+        return false;
+    }
+
+    complete = comp;
+    return true;
+}
+
+uint64_t PRadRunSummary::GetTriggerCount(int trg)
+const
+{
+    if(trg < 0 || (size_t)trg >= trg_counts.size())
+        return 0;
+    return trg_counts[trg];
+}
+
+uint32_t PRadRunSummary::GetOccupancy(uint32_t ch)
+const
+{
+    if(ch >= occupancy.size())
+        return 0;
+    return occupancy[ch];
+}
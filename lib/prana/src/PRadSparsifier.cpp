@@ -0,0 +1,243 @@
+//============================================================================//
+// Zero suppression for a bank of ADC data                                    //
+// Pedestals are kept in arrays indexed by channel id, and the threshold is   //
+// applied to a whole bank at once, with SSE/AVX2 kernels chosen at runtime   //
+// The output is identical to PRadADCChannel::Sparsify on every word          //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadSparsifier.h"
+#include <limits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PRAD_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#define INVALID_THRES std::numeric_limits<int32_t>::max()
+
+
+
+//============================================================================//
+// Kernels                                                                    //
+//============================================================================//
+
+// scalar version, it is also used for the tails of the vectorized versions
+static size_t sparsify_scalar(const int32_t *thres, size_t nthres,
+                              const ADC_Data *in, size_t n, ADC_Data *out)
+{
+    size_t k = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        const ADC_Data &adc = in[i];
+        if(adc.channel_id < nthres && (int32_t)adc.value >= thres[adc.channel_id])
+            out[k++] = adc;
+    }
+    return k;
+}
+
+#ifdef PRAD_X86_SIMD
+// an ADC_Data is a 32 bit word with channel id in the low 16 bits and value
+// in the high 16 bits, the passed words are compressed to the front by the
+// shuffle/permutation tables indexed by the pass mask
+struct CompressTables
+{
+    alignas(16) uint8_t sse[16][16];
+    alignas(32) int32_t avx[256][8];
+
+    CompressTables()
+    {
+        for(int mask = 0; mask < 16; ++mask)
+        {
+            int k = 0;
+            for(int j = 0; j < 4; ++j)
+            {
+                if(!(mask & (1 << j)))
+                    continue;
+                for(int b = 0; b < 4; ++b)
+                    sse[mask][k*4 + b] = j*4 + b;
+                k++;
+            }
+            for(; k < 4; ++k)
+                for(int b = 0; b < 4; ++b)
+                    sse[mask][k*4 + b] = 0x80;
+        }
+
+        for(int mask = 0; mask < 256; ++mask)
+        {
+            int k = 0;
+            for(int j = 0; j < 8; ++j)
+            {
+                if(mask & (1 << j))
+                    avx[mask][k++] = j;
+            }
+            for(; k < 8; ++k)
+                avx[mask][k] = 0;
+        }
+    }
+};
+
+static const CompressTables &compress_tables()
+{
+    static const CompressTables tables;
+    return tables;
+}
+
+// sse version, no gather instruction, thresholds are loaded by scalar
+__attribute__((target("ssse3")))
+static size_t sparsify_sse(const int32_t *thres, size_t nthres,
+                           const ADC_Data *in, size_t n, ADC_Data *out)
+{
+    static_assert(sizeof(ADC_Data) == 4, "ADC_Data is expected to be a 32 bit word");
+
+    const CompressTables &tables = compress_tables();
+    size_t i = 0, k = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        int32_t t[4];
+        for(int j = 0; j < 4; ++j)
+        {
+            uint16_t id = in[i + j].channel_id;
+            t[j] = (id < nthres) ? thres[id] : INVALID_THRES;
+        }
+
+        __m128i words = _mm_loadu_si128((const __m128i*) &in[i]);
+        __m128i vals = _mm_srli_epi32(words, 16);
+        __m128i thrs = _mm_loadu_si128((const __m128i*) t);
+        __m128i rej = _mm_cmpgt_epi32(thrs, vals);
+        int mask = ~_mm_movemask_ps(_mm_castsi128_ps(rej)) & 0xf;
+
+        __m128i shuf = _mm_load_si128((const __m128i*) tables.sse[mask]);
+        _mm_storeu_si128((__m128i*) &out[k], _mm_shuffle_epi8(words, shuf));
+        k += __builtin_popcount(mask);
+    }
+
+    return k + sparsify_scalar(thres, nthres, &in[i], n - i, &out[k]);
+}
+
+// avx2 version, gather the thresholds and permute the passed words
+__attribute__((target("avx2")))
+static size_t sparsify_avx2(const int32_t *thres, size_t nthres,
+                            const ADC_Data *in, size_t n, ADC_Data *out)
+{
+    const CompressTables &tables = compress_tables();
+    const __m256i id_mask = _mm256_set1_epi32(0xffff);
+    const __m256i id_size = _mm256_set1_epi32((int32_t)nthres);
+    const __m256i invalid = _mm256_set1_epi32(INVALID_THRES);
+
+    size_t i = 0, k = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i words = _mm256_loadu_si256((const __m256i*) &in[i]);
+        __m256i ids = _mm256_and_si256(words, id_mask);
+        __m256i vals = _mm256_srli_epi32(words, 16);
+        __m256i valid = _mm256_cmpgt_epi32(id_size, ids);
+        __m256i thrs = _mm256_mask_i32gather_epi32(invalid, thres, ids, valid, 4);
+        __m256i rej = _mm256_cmpgt_epi32(thrs, vals);
+        int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(rej)) & 0xff;
+
+        __m256i perm = _mm256_load_si256((const __m256i*) tables.avx[mask]);
+        _mm256_storeu_si256((__m256i*) &out[k], _mm256_permutevar8x32_epi32(words, perm));
+        k += __builtin_popcount(mask);
+    }
+
+    return k + sparsify_scalar(thres, nthres, &in[i], n - i, &out[k]);
+}
+#endif
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadSparsifier::PRadSparsifier()
+{
+    SetKernel(BestKernel());
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// fill the pedestal arrays from the adc channels
+void PRadSparsifier::Build(const std::vector<PRadADCChannel*> &adc_list)
+{
+    Clear();
+
+    ped_mean.resize(adc_list.size(), 0.);
+    ped_sigma.resize(adc_list.size(), 0.);
+    threshold.resize(adc_list.size(), INVALID_THRES);
+
+    for(auto &adc : adc_list)
+        Update(adc);
+}
+
+// update the pedestal of one channel
+void PRadSparsifier::Update(const PRadADCChannel *adc)
+{
+    if(!adc)
+        return;
+
+    size_t id = adc->GetID();
+    if(id >= threshold.size()) {
+        ped_mean.resize(id + 1, 0.);
+        ped_sigma.resize(id + 1, 0.);
+        threshold.resize(id + 1, INVALID_THRES);
+    }
+
+    const PRadADCChannel::Pedestal &ped = adc->GetPedestal();
+    ped_mean[id] = ped.mean;
+    ped_sigma[id] = ped.sigma;
+    threshold[id] = PRadADCChannel::SparsifyThreshold(ped);
+}
+
+void PRadSparsifier::Clear()
+{
+    ped_mean.clear();
+    ped_sigma.clear();
+    threshold.clear();
+}
+
+// apply zero suppression to n adc data, the passed data are compressed to out
+// out should have space for n data, it can be the same as in
+// return the number of passed data
+size_t PRadSparsifier::Apply(const ADC_Data *in, size_t n, ADC_Data *out)
+const
+{
+    return kernel(threshold.data(), threshold.size(), in, n, out);
+}
+
+// choose the kernel, fall back to the best supported one
+void PRadSparsifier::SetKernel(KernelType type)
+{
+    KernelType best = BestKernel();
+    if(type > best)
+        type = best;
+
+    ktype = type;
+    switch(type)
+    {
+#ifdef PRAD_X86_SIMD
+    case AVX2: kernel = &sparsify_avx2; break;
+    case SSE: kernel = &sparsify_sse; break;
+#endif
+    default: ktype = Scalar; kernel = &sparsify_scalar; break;
+    }
+}
+
+// the best kernel supported by current cpu
+PRadSparsifier::KernelType PRadSparsifier::BestKernel()
+{
+#ifdef PRAD_X86_SIMD
+    if(__builtin_cpu_supports("avx2"))
+        return AVX2;
+    if(__builtin_cpu_supports("ssse3"))
+        return SSE;
+#endif
+    return Scalar;
+}
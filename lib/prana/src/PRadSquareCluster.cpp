@@ -9,13 +9,14 @@
 #include "PRadSquareCluster.h"
 #include "PRadHyCalReconstructor.h"
 #include "PRadHyCalModule.h"
+#include "PRadHyCalDetector.h"
 #include <algorithm>
 #include <cmath>
 
 
 
 PRadSquareCluster::PRadSquareCluster(PRadHyCalReconstructor *r)
-: rec(r)
+: rec(r), mask_det(nullptr), mask_size(0), mask_modules(0), mask_words(0)
 {
     // place holder
 }
@@ -31,33 +32,85 @@ const
     return new PRadSquareCluster(*this);
 }
 
+// check if the module is inside the square centered at the center module
+inline bool in_square(const PRadHyCalModule *center, const PRadHyCalModule *module, float factor)
+{
+    float dist_x = factor*center->GetSizeX();
+    float dist_y = factor*center->GetSizeY();
+
+    if((fabs(center->GetX() - module->GetX()) > dist_x) ||
+       (fabs(center->GetY() - module->GetY()) > dist_y))
+        return false;
+
+    return true;
+}
+
 inline bool PRadSquareCluster::checkBelongs(const ModuleHit &center,
                                             const ModuleHit &hit,
                                             float factor)
 const
 {
-    float dist_x = factor*center->GetSizeX();
-    float dist_y = factor*center->GetSizeY();
+    return in_square(center.ptr, hit.ptr, factor);
+}
 
-    if((fabs(center->GetX() - hit->GetX()) > dist_x) ||
-       (fabs(center->GetY() - hit->GetY()) > dist_y))
+// check if the masks can be used for the hit, they are built for a detector
+// layout and square size
+inline bool PRadSquareCluster::checkMasks(const ModuleHit &hit)
+const
+{
+    if(masks.empty() || hit->GetDetector() != mask_det ||
+       rec->config.square_size != mask_size ||
+       mask_det->GetModuleList().size() != mask_modules)
         return false;
 
-    return true;
+    int idx = hit->GetIndex();
+    return (idx >= 0) && ((size_t)idx < mask_modules) &&
+           (mask_det->GetModuleList()[idx] == hit.ptr);
 }
 
-void PRadSquareCluster::FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls)
+// build the square window of every module from the detector layout
+void PRadSquareCluster::UpdateLayout(const PRadHyCalDetector *det)
+{
+    masks.clear();
+    mask_det = det;
+    mask_size = rec->config.square_size;
+    mask_modules = 0;
+    mask_words = 0;
+
+    if(!det)
+        return;
+
+    const auto &modules = det->GetModuleList();
+    mask_modules = modules.size();
+    mask_words = (mask_modules + 63)/64;
+    masks.assign(mask_modules*mask_words, 0);
+
+    float factor = float(mask_size)/2.;
+    for(size_t i = 0; i < mask_modules; ++i)
+    {
+        uint64_t *row = &masks[i*mask_words];
+        for(size_t j = 0; j < mask_modules; ++j)
+        {
+            if(in_square(modules[i], modules[j], factor))
+                row[j/64] |= (uint64_t(1) << (j%64));
+        }
+    }
+}
+
+void PRadSquareCluster::FormCluster(std::vector<ModuleHit> &hs, std::vector<ModuleCluster> &cls,
+                                    ClusterContext &ctx)
 const
 {
-    // clear container first
-    cls.clear();
+    // clear container first, the clusters go back to the pool
+    ctx.RecycleClusters(cls);
 
     // form clusters with high energy hit seed
-    groupHits(hs, cls);
+    groupHits(hs, cls, ctx);
 }
 
 void PRadSquareCluster::groupHits(std::vector<ModuleHit> &hits,
-                                  std::vector<ModuleCluster> &clusters)
+                                  std::vector<ModuleCluster> &clusters,
+                                  ClusterContext &ctx)
 const
 {
     // sort hits by energy
@@ -71,26 +124,37 @@ const
     for(auto &hit : hits)
     {
         // not belongs to any cluster, and the energy is larger than center threshold
-        if(!fillClusters(hit, clusters) && (hit.energy > rec->config.min_center_energy)) {
-            clusters.emplace_back(hit, hit->GetLayoutFlag());
-            clusters.back().AddHit(hit);
+        if(!fillClusters(hit, clusters, ctx) && (hit.energy > rec->config.min_center_energy)) {
+            ctx.NewCluster(clusters, hit, hit->GetLayoutFlag()).AddHit(hit);
         }
     }
 }
 
-bool PRadSquareCluster::fillClusters(ModuleHit &hit, std::vector<ModuleCluster> &c)
+bool PRadSquareCluster::fillClusters(ModuleHit &hit, std::vector<ModuleCluster> &c,
+                                     ClusterContext &ctx)
 const
 {
-    std::vector<unsigned int> indices;
-    indices.reserve(50);
+    auto &indices = ctx.indices;
+    indices.clear();
 
     // check how many clusters the hit belongs to
-    for(unsigned int i = 0; i < c.size(); ++i)
-    {
-        const auto &center = c.at(i).center;
-        // within the square range
-        if(checkBelongs(center, hit, float(rec->config.square_size)/2.)) {
-            indices.push_back(i);
+    if(checkMasks(hit)) {
+        // look up the hit in the square of every center
+        size_t word = hit->GetIndex()/64;
+        uint64_t bit = uint64_t(1) << (hit->GetIndex()%64);
+        for(unsigned int i = 0; i < c.size(); ++i)
+        {
+            if(masks[c[i].center->GetIndex()*mask_words + word] & bit)
+                indices.push_back(i);
+        }
+    } else {
+        for(unsigned int i = 0; i < c.size(); ++i)
+        {
+            const auto &center = c.at(i).center;
+            // within the square range
+            if(checkBelongs(center, hit, float(rec->config.square_size)/2.)) {
+                indices.push_back(i);
+            }
         }
     }
 
@@ -7,7 +7,9 @@
 
 #include "PRadTDCChannel.h"
 #include "PRadADCChannel.h"
+#ifndef PRAD_NO_ROOT
 #include "TH1I.h"
+#endif
 
 
 
@@ -19,23 +21,29 @@
 PRadTDCChannel::PRadTDCChannel(const std::string &name, const ChannelAddress &addr)
 : PRadDAQChannel(name, addr)
 {
+#ifndef PRAD_NO_ROOT
     std::string tdc_name = "TDC_" + name;
     tdc_hist = new TH1I(tdc_name.c_str(), "Time Measure", 20000, 0, 19999);
+#else
+    tdc_hist = nullptr;
+#endif
 }
 
 // copy/move constructors
 // connections to ADC channels won't be copied
 PRadTDCChannel::PRadTDCChannel(const PRadTDCChannel &that)
-: PRadDAQChannel(that), time_measure(that.time_measure)
+: PRadDAQChannel(that)
 {
+#ifndef PRAD_NO_ROOT
     if(that.tdc_hist)
         tdc_hist = (TH1*) that.tdc_hist->Clone();
     else
+#endif
         tdc_hist = nullptr;
 }
 
 PRadTDCChannel::PRadTDCChannel(PRadTDCChannel &&that)
-: PRadDAQChannel(that), time_measure(std::move(that.time_measure))
+: PRadDAQChannel(that)
 {
     tdc_hist = that.tdc_hist;
     that.tdc_hist = nullptr;
@@ -45,7 +53,9 @@ PRadTDCChannel::PRadTDCChannel(PRadTDCChannel &&that)
 PRadTDCChannel::~PRadTDCChannel()
 {
     DisconnectChannels();
+#ifndef PRAD_NO_ROOT
     delete tdc_hist;
+#endif
 }
 
 // copy/move assignment operators
@@ -54,12 +64,15 @@ PRadTDCChannel &PRadTDCChannel::operator =(const PRadTDCChannel &rhs)
     if(this == &rhs)
         return *this;
 
+#ifndef PRAD_NO_ROOT
     delete tdc_hist, tdc_hist = nullptr;
+#endif
 
     PRadDAQChannel::operator =(rhs);
+#ifndef PRAD_NO_ROOT
     if(rhs.tdc_hist)
         tdc_hist = (TH1*) rhs.tdc_hist->Clone();
-    time_measure = rhs.time_measure;
+#endif
 
     return *this;
 }
@@ -69,12 +82,13 @@ PRadTDCChannel &PRadTDCChannel::operator =(PRadTDCChannel &&rhs)
     if(this == &rhs)
         return *this;
 
+#ifndef PRAD_NO_ROOT
     delete tdc_hist;
+#endif
 
     PRadDAQChannel::operator =(rhs);
     tdc_hist = rhs.tdc_hist;
     rhs.tdc_hist = nullptr;
-    time_measure = std::move(rhs.time_measure);
 
     return *this;
 }
@@ -127,47 +141,38 @@ void PRadTDCChannel::DisconnectChannels()
     group_map.clear();
 }
 
-// add a time measure value
-void PRadTDCChannel::AddTimeMeasure(const unsigned short &count)
-{
-    time_measure.push_back(count);
-}
-
-// add multiple time measure values
-void PRadTDCChannel::AddTimeMeasure(const std::vector<unsigned short> &counts)
-{
-    time_measure.insert(time_measure.end(), counts.begin(), counts.end());
-}
-
-// set time measure values
-void PRadTDCChannel::SetTimeMeasure(const std::vector<unsigned short> &counts)
-{
-    time_measure = counts;
-}
-
-// fill histogram
+// fill histogram, there is no histogram without ROOT
 void PRadTDCChannel::FillHist(const unsigned short &time)
 {
+#ifndef PRAD_NO_ROOT
     tdc_hist->Fill(time);
+#else
+    (void)time;
+#endif
 }
 
 // reset all data
 void PRadTDCChannel::Reset()
 {
     ResetHists();
-    ClearTimeMeasure();
 }
 
 // reset histogram
 void PRadTDCChannel::ResetHists()
 {
+#ifndef PRAD_NO_ROOT
     tdc_hist->Reset();
+#endif
 }
 
-// clear time measure
-void PRadTDCChannel::ClearTimeMeasure()
+// add the histogram from a copy of this channel
+void PRadTDCChannel::MergeHists(const PRadTDCChannel &that)
 {
-    time_measure.clear();
+#ifndef PRAD_NO_ROOT
+    tdc_hist->Add(that.tdc_hist);
+#else
+    (void)that;
+#endif
 }
 
 // get adc channel
@@ -0,0 +1,242 @@
+//============================================================================//
+// Unpacker of the CAEN V1190 and V767 data words                             //
+// The word types are classified for several words at once by vector         //
+// compare, the measurement words are left-packed to the staging arrays with  //
+// their slots and channels, AVX2 kernel is chosen at runtime                 //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadTDCUnpacker.h"
+#include "datastruct.h"
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PRAD_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// word format of V1190, type is in bits 27-31, the global header has the geo
+// address in bits 0-4, and the measurement has channel in bits 19-25, value in
+// bits 0-18
+#define V1190_TYPE(word) ((word)>>27)
+#define V1190_GEO(word) ((word)&0x1F)
+#define V1190_CHANNEL(word) (((word)>>19)&0x7F)
+#define V1190_VALUE(word) ((word)&0x7FFFF)
+// word format of V767, channel is in bits 24-30, value in bits 0-19
+#define V767_CHANNEL(word) (((word)>>24)&0x7F)
+#define V767_VALUE(word) ((word)&0xFFFFF)
+
+
+
+//============================================================================//
+// Kernels                                                                    //
+//============================================================================//
+
+// scalar versions, they are also used for the tails of the vectorized versions
+static size_t unpack_v1190_scalar(const uint32_t *words, size_t n, uint32_t &slot,
+                                  bool geo, uint32_t *keys, uint32_t *values)
+{
+    size_t nh = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        switch(V1190_TYPE(words[i]))
+        {
+        case V1190_GLOBAL_HEADER:
+            // geo address not supported in some crates
+            slot = geo ? V1190_GEO(words[i]) : 0;
+            break;
+        case V1190_TDC_MEASURE:
+            keys[nh] = TDC_KEY(slot, V1190_CHANNEL(words[i]));
+            values[nh] = V1190_VALUE(words[i]);
+            ++nh;
+            break;
+        default:
+            break;
+        }
+    }
+    return nh;
+}
+
+static size_t unpack_v767_scalar(const uint32_t *words, size_t n, uint32_t slot,
+                                 uint32_t *keys, uint32_t *values)
+{
+    size_t nh = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(words[i]&V767_INVALID_BIT)
+            continue;
+        keys[nh] = TDC_KEY(slot, V767_CHANNEL(words[i]));
+        values[nh] = V767_VALUE(words[i]);
+        ++nh;
+    }
+    return nh;
+}
+
+#ifdef PRAD_X86_SIMD
+// lane indices to left-pack the selected lanes of 8, one byte for each lane
+static const uint64_t *compress_table()
+{
+    static uint64_t table[256] = {0};
+    static bool init = [] () {
+        for(unsigned int mask = 0; mask < 256; ++mask)
+        {
+            unsigned int k = 0;
+            for(unsigned int lane = 0; lane < 8; ++lane)
+            {
+                if(mask & (1u << lane))
+                    table[mask] |= (uint64_t)lane << (8*k++);
+            }
+        }
+        return true;
+    } ();
+    (void)init;
+    return table;
+}
+
+// left-pack the selected lanes of keys and values, the stores write all 8
+// lanes, so there should be space for 8 words at the destinations
+__attribute__((target("avx2")))
+static inline size_t compress_store(const uint64_t *table, int mask,
+                                    __m256i key, __m256i val,
+                                    uint32_t *keys, uint32_t *values)
+{
+    __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) &table[mask]));
+    _mm256_storeu_si256((__m256i*) keys, _mm256_permutevar8x32_epi32(key, idx));
+    _mm256_storeu_si256((__m256i*) values, _mm256_permutevar8x32_epi32(val, idx));
+    return __builtin_popcount(mask);
+}
+
+// avx2 versions, 8 words at a time, the hits never exceed the words read, so
+// the 8 lanes stored are always inside the staging arrays
+__attribute__((target("avx2")))
+static size_t unpack_v1190_avx2(const uint32_t *words, size_t n, uint32_t &slot,
+                                bool geo, uint32_t *keys, uint32_t *values)
+{
+    const uint64_t *table = compress_table();
+    const __m256i header_v = _mm256_set1_epi32(V1190_GLOBAL_HEADER);
+    const __m256i measure_v = _mm256_set1_epi32(V1190_TDC_MEASURE);
+    const __m256i ch_mask = _mm256_set1_epi32(0x7F);
+    const __m256i val_mask = _mm256_set1_epi32(0x7FFFF);
+
+    size_t i = 0, nh = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i w = _mm256_loadu_si256((const __m256i*) &words[i]);
+        __m256i type = _mm256_srli_epi32(w, 27);
+
+        // the slot changes inside these words, leave them to scalar version
+        if(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(type, header_v)))) {
+            nh += unpack_v1190_scalar(&words[i], 8, slot, geo, &keys[nh], &values[nh]);
+            continue;
+        }
+
+        int meas = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(type, measure_v)));
+        if(!meas)
+            continue;
+
+        __m256i key = _mm256_or_si256(_mm256_set1_epi32((int32_t)TDC_KEY(slot, 0)),
+                                      _mm256_and_si256(_mm256_srli_epi32(w, 19), ch_mask));
+        __m256i val = _mm256_and_si256(w, val_mask);
+        nh += compress_store(table, meas, key, val, &keys[nh], &values[nh]);
+    }
+
+    return nh + unpack_v1190_scalar(&words[i], n - i, slot, geo, &keys[nh], &values[nh]);
+}
+
+__attribute__((target("avx2")))
+static size_t unpack_v767_avx2(const uint32_t *words, size_t n, uint32_t slot,
+                               uint32_t *keys, uint32_t *values)
+{
+    const uint64_t *table = compress_table();
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i invalid_mask = _mm256_set1_epi32(V767_INVALID_BIT);
+    const __m256i slot_v = _mm256_set1_epi32((int32_t)TDC_KEY(slot, 0));
+    const __m256i ch_mask = _mm256_set1_epi32(0x7F);
+    const __m256i val_mask = _mm256_set1_epi32(0xFFFFF);
+
+    size_t i = 0, nh = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i w = _mm256_loadu_si256((const __m256i*) &words[i]);
+        __m256i valid = _mm256_cmpeq_epi32(_mm256_and_si256(w, invalid_mask), zero);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(valid));
+        if(!mask)
+            continue;
+
+        __m256i key = _mm256_or_si256(slot_v, _mm256_and_si256(_mm256_srli_epi32(w, 24), ch_mask));
+        __m256i val = _mm256_and_si256(w, val_mask);
+        nh += compress_store(table, mask, key, val, &keys[nh], &values[nh]);
+    }
+
+    return nh + unpack_v767_scalar(&words[i], n - i, slot, &keys[nh], &values[nh]);
+}
+#endif
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadTDCUnpacker::PRadTDCUnpacker()
+{
+    SetKernel(BestKernel());
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+size_t PRadTDCUnpacker::UnpackV1190(const uint32_t *words, size_t n, uint32_t &slot,
+                                    bool geo, Staging &out)
+const
+{
+    return v1190_kernel(words, std::min<size_t>(n, TDC_UNPACK_BLOCK), slot, geo,
+                        out.key, out.value);
+}
+
+size_t PRadTDCUnpacker::UnpackV767(const uint32_t *words, size_t n, uint32_t slot,
+                                   Staging &out)
+const
+{
+    return v767_kernel(words, std::min<size_t>(n, TDC_UNPACK_BLOCK), slot,
+                       out.key, out.value);
+}
+
+// choose the kernel, fall back to the best supported one
+void PRadTDCUnpacker::SetKernel(KernelType type)
+{
+    KernelType best = BestKernel();
+    if(type > best)
+        type = best;
+
+    ktype = type;
+    switch(type)
+    {
+#ifdef PRAD_X86_SIMD
+    case AVX2:
+        v1190_kernel = &unpack_v1190_avx2;
+        v767_kernel = &unpack_v767_avx2;
+        break;
+#endif
+    default:
+        ktype = Scalar;
+        v1190_kernel = &unpack_v1190_scalar;
+        v767_kernel = &unpack_v767_scalar;
+        break;
+    }
+}
+
+// the best kernel supported by current cpu
+PRadTDCUnpacker::KernelType PRadTDCUnpacker::BestKernel()
+{
+#ifdef PRAD_X86_SIMD
+    if(__builtin_cpu_supports("avx2"))
+        return AVX2;
+#endif
+    return Scalar;
+}
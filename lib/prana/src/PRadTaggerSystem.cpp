@@ -7,7 +7,59 @@
 //============================================================================//
 
 #include "PRadTaggerSystem.h"
+#ifndef PRAD_NO_ROOT
 #include "TH2I.h"
+#endif
+#include <vector>
+
+
+
+//============================================================================//
+// Channel Table                                                              //
+//============================================================================//
+
+// tagger channel from the tdc slot and channel
+// E channels: slot 3, 5, 7 have 64 channels each
+// T channels: slot 14, left and right have 64 channels each, and the channels
+//             are shifted by 16 in every 32 channels
+static int tagger_channel(unsigned int slot, unsigned int channel)
+{
+    // E Channel 30000 + channel
+    if(slot == 3 || slot == 5 || slot == 7)
+        return channel + (slot - 3)*64 + TAGGER_CHANID;
+
+    // T Channel
+    if(slot == 14) {
+        int t_lr = channel/64;
+        int t_ch = channel%64;
+        if(t_ch > 31)
+            t_ch = 32 + (t_ch + 16)%32;
+        else
+            t_ch = (t_ch + 16)%32;
+        t_ch += t_lr*64;
+        return t_ch + TAGGER_CHANID + TAGGER_T_CHANID;
+    }
+
+    return -1;
+}
+
+static std::vector<int> build_channel_table()
+{
+    std::vector<int> table(TAGGER_TDC_SLOTS*TAGGER_TDC_CHANNELS);
+    for(unsigned int slot = 0; slot < TAGGER_TDC_SLOTS; ++slot)
+    {
+        for(unsigned int ch = 0; ch < TAGGER_TDC_CHANNELS; ++ch)
+            table[slot*TAGGER_TDC_CHANNELS + ch] = tagger_channel(slot, ch);
+    }
+    return table;
+}
+
+// the table is built once and shared by all the tagger systems
+const int *PRadTaggerSystem::channelTable()
+{
+    static const std::vector<int> table = build_channel_table();
+    return table.data();
+}
 
 
 
@@ -15,18 +67,26 @@
 // Constructors, Destructor, Assignment Operators                             //
 //============================================================================//
 
-// constructor
+// constructor, the counters are only histogrammed with ROOT
 PRadTaggerSystem::PRadTaggerSystem()
+: hist_E(nullptr), hist_T(nullptr)
 {
+#ifndef PRAD_NO_ROOT
     hist_E = new TH2I("Tagger E", "Tagger E counter", 2000, 0, 20000, 384, 0, 383);
     hist_T = new TH2I("Tagger T", "Tagger T counter", 2000, 0, 20000, 128, 0, 127);
+#endif
 }
 
 // copy/move constructors
 PRadTaggerSystem::PRadTaggerSystem(const PRadTaggerSystem &that)
+: hist_E(nullptr), hist_T(nullptr)
 {
+#ifndef PRAD_NO_ROOT
     hist_E = new TH2I(*that.hist_E);
     hist_T = new TH2I(*that.hist_T);
+#else
+    (void)that;
+#endif
 }
 
 PRadTaggerSystem::PRadTaggerSystem(PRadTaggerSystem &&that)
@@ -40,8 +100,10 @@ PRadTaggerSystem::PRadTaggerSystem(PRadTaggerSystem &&that)
 // destructor
 PRadTaggerSystem::~PRadTaggerSystem()
 {
+#ifndef PRAD_NO_ROOT
     delete hist_E;
     delete hist_T;
+#endif
 }
 
 // copy/move assignment operators
@@ -60,11 +122,15 @@ PRadTaggerSystem &PRadTaggerSystem::operator =(PRadTaggerSystem &&rhs)
     if(this == &rhs)
         return *this;
 
+#ifndef PRAD_NO_ROOT
     delete hist_E;
     delete hist_T;
+#endif
 
     hist_E = rhs.hist_E;
+    rhs.hist_E = nullptr;
     hist_T = rhs.hist_T;
+    rhs.hist_T = nullptr;
 
     return *this;
 }
@@ -78,37 +144,67 @@ PRadTaggerSystem &PRadTaggerSystem::operator =(PRadTaggerSystem &&rhs)
 // reset current data and hists
 void PRadTaggerSystem::Reset()
 {
+#ifndef PRAD_NO_ROOT
     hist_E->Reset();
     hist_T->Reset();
+#endif
+}
+
+// add the histograms from a copy of this system
+void PRadTaggerSystem::MergeHists(const PRadTaggerSystem &that)
+{
+#ifndef PRAD_NO_ROOT
+    hist_E->Add(that.hist_E);
+    hist_T->Add(that.hist_T);
+#else
+    (void)that;
+#endif
 }
 
 // feed tagger hits to event data
 void PRadTaggerSystem::FeedTaggerHits(const TDCV1190Data &tdcData, EventData &event)
 {
-    // E channel
-    if(tdcData.addr.slot == 3 || tdcData.addr.slot == 5 || tdcData.addr.slot == 7)
+    int id = GetChannelID(tdcData.addr.slot, tdcData.addr.channel);
+    if(id >= 0)
+        event.add_tdc(TDC_Data(id, tdcData.val));
+}
+
+// feed a bank of tagger hits to event data
+void PRadTaggerSystem::FeedTaggerHits(const TDCV1190Data *tdcData, size_t n, EventData &event)
+{
+    const int *table = channelTable();
+    for(size_t i = 0; i < n; ++i)
     {
-        int e_ch = tdcData.addr.channel + (tdcData.addr.slot - 3)*64 + TAGGER_CHANID;
-        // E Channel 30000 + channel
-        event.add_tdc(TDC_Data(e_ch, tdcData.val));
+        unsigned int slot = tdcData[i].addr.slot, ch = tdcData[i].addr.channel;
+        if(slot >= TAGGER_TDC_SLOTS || ch >= TAGGER_TDC_CHANNELS)
+            continue;
+
+        int id = table[slot*TAGGER_TDC_CHANNELS + ch];
+        if(id >= 0)
+            event.add_tdc(TDC_Data(id, tdcData[i].val));
     }
-    // T Channel
-    if(tdcData.addr.slot == 14)
+}
+
+// feed the unpacked tagger hits to event data
+void PRadTaggerSystem::FeedTaggerHits(const uint32_t *keys, const uint32_t *values,
+                                      size_t n, EventData &event)
+{
+    const int *table = channelTable();
+    for(size_t i = 0; i < n; ++i)
     {
-        int t_lr = tdcData.addr.channel/64;
-        int t_ch = tdcData.addr.channel%64;
-        if(t_ch > 31)
-            t_ch = 32 + (t_ch + 16)%32;
-        else
-            t_ch = (t_ch + 16)%32;
-        t_ch += t_lr*64;
-        event.add_tdc(TDC_Data(t_ch + TAGGER_CHANID + TAGGER_T_CHANID, tdcData.val));
+        if(keys[i] >= TAGGER_TDC_SLOTS*TAGGER_TDC_CHANNELS)
+            continue;
+
+        int id = table[keys[i]];
+        if(id >= 0)
+            event.add_tdc(TDC_Data(id, values[i]));
     }
 }
 
 // fill tagger hits to histograms
 void PRadTaggerSystem::FillHists(const EventData &event)
 {
+#ifndef PRAD_NO_ROOT
     for(auto &tdc : event.get_tdc_data())
     {
         if(tdc.channel_id < TAGGER_CHANID)
@@ -119,4 +215,7 @@ void PRadTaggerSystem::FillHists(const EventData &event)
         else
             hist_E->Fill(tdc.value, id);
     }
+#else
+    (void)event;
+#endif
 }
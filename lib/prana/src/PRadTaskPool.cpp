@@ -0,0 +1,153 @@
+//============================================================================//
+// A persistent thread pool with work stealing                                //
+// Tasks are distributed to the worker queues in turn, an idle worker takes   //
+// tasks from its own queue first and then steals from the others             //
+// The thread that waits for the tasks also helps to run them                 //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadTaskPool.h"
+
+
+
+//============================================================================//
+// Constructor, Destructor                                                    //
+//============================================================================//
+
+// constructor, 0 means using all the hardware threads
+PRadTaskPool::PRadTaskPool(unsigned int nthreads)
+: next_queue(0), queued(0), unfinished(0), stop(false)
+{
+    if(nthreads == 0)
+        nthreads = std::thread::hardware_concurrency();
+    if(nthreads == 0)
+        nthreads = 1;
+
+    nqueues = nthreads;
+    queues = new TaskQueue[nqueues];
+
+    for(unsigned int i = 0; i < nthreads; ++i)
+        threads.emplace_back(&PRadTaskPool::work, this, i);
+}
+
+// destructor
+PRadTaskPool::~PRadTaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(cond_locker);
+        stop = true;
+    }
+    task_cond.notify_all();
+
+    for(auto &thread : threads)
+    {
+        if(thread.joinable()) thread.join();
+    }
+
+    delete [] queues;
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// add a new task to the pool
+void PRadTaskPool::Submit(Task &&task)
+{
+    unsigned int id = next_queue.fetch_add(1)%nqueues;
+
+    unfinished.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[id].locker);
+        queues[id].tasks.emplace_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cond_locker);
+        queued.fetch_add(1);
+    }
+    task_cond.notify_one();
+}
+
+// wait until all the submitted tasks are done, run the tasks while waiting
+void PRadTaskPool::Wait()
+{
+    Task task;
+    while(unfinished.load() > 0)
+    {
+        if(takeTask(0, task)) {
+            task();
+            finishTask();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(cond_locker);
+        done_cond.wait(lock, [this] {return unfinished.load() == 0 || queued.load() > 0;});
+    }
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// worker thread
+void PRadTaskPool::work(unsigned int id)
+{
+    Task task;
+    while(true)
+    {
+        if(takeTask(id, task)) {
+            task();
+            finishTask();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(cond_locker);
+        task_cond.wait(lock, [this] {return stop || queued.load() > 0;});
+        if(stop)
+            return;
+    }
+}
+
+// take a task from its own queue, or steal one from the other queues
+bool PRadTaskPool::takeTask(unsigned int id, Task &task)
+{
+    if(queued.load() == 0)
+        return false;
+
+    for(unsigned int i = 0; i < nqueues; ++i)
+    {
+        auto &queue = queues[(id + i)%nqueues];
+        std::lock_guard<std::mutex> lock(queue.locker);
+        if(queue.tasks.empty())
+            continue;
+
+        // own tasks from the front, stolen tasks from the back
+        if(i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        queued.fetch_sub(1);
+        return true;
+    }
+
+    return false;
+}
+
+// mark a task done, inform the waiting thread if all the tasks are done
+void PRadTaskPool::finishTask()
+{
+    if(unfinished.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(cond_locker);
+        done_cond.notify_all();
+    }
+}
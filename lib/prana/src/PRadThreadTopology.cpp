@@ -0,0 +1,335 @@
+//============================================================================//
+// Placement of the pipeline workers on the NUMA nodes                        //
+// The workers pin themselves to the cores or nodes at their start, so their  //
+// memory is allocated on the local node, large buffers can use huge pages    //
+//                                                                            //
+// Chao Peng                                                                  //
+// 10/14/2026                                                                 //
+//============================================================================//
+
+#include "PRadThreadTopology.h"
+#include "ConfigParser.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+
+//============================================================================//
+// Constructor                                                                //
+//============================================================================//
+
+PRadThreadTopology::PRadThreadTopology()
+: pin_mode(Pin_None), huge_pages(false), compact(false)
+{
+    detectNodes();
+}
+
+PRadThreadTopology &PRadThreadTopology::Instance()
+{
+    static PRadThreadTopology instance;
+    return instance;
+}
+
+
+
+//============================================================================//
+// Public Member Functions                                                    //
+//============================================================================//
+
+// read the placement and the nodes, the nodes are detected if the file does
+// not list them
+void PRadThreadTopology::Configure(const std::string &path)
+{
+    bool verbose = false;
+
+    if(!path.empty()) {
+        ConfigObject::Configure(path);
+        verbose = true;
+    }
+
+    std::string mode = ConfigParser::str_lower(getDefConfig<std::string>("Pin Mode", "none", verbose));
+    if(mode == "core")
+        pin_mode = Pin_Core;
+    else if(mode == "node")
+        pin_mode = Pin_Node;
+    else
+        pin_mode = Pin_None;
+
+    std::string place = ConfigParser::str_lower(getDefConfig<std::string>("Worker Placement", "spread", verbose));
+    compact = (place == "compact");
+    huge_pages = getDefConfig<bool>("Huge Pages", false, verbose);
+
+    // nodes listed as NUMA Node 0 = 0-15,32-47, only the cpus allowed for the
+    // process are kept, such as the slot of a batch job
+    std::vector<int> allowed = allowedCPUs();
+    std::vector<Node> conf_nodes;
+    for(int i = 0; HasKey("NUMA Node " + std::to_string(i)); ++i)
+    {
+        Node node;
+        node.id = i;
+        for(auto &cpu : ParseCPUList(GetConfig<std::string>("NUMA Node " + std::to_string(i))))
+        {
+            if(std::binary_search(allowed.begin(), allowed.end(), cpu))
+                node.cpus.push_back(cpu);
+        }
+        if(!node.cpus.empty())
+            conf_nodes.emplace_back(std::move(node));
+    }
+
+    if(conf_nodes.empty())
+        detectNodes();
+    else
+        nodes = std::move(conf_nodes);
+}
+
+// pin the calling thread by the worker number
+bool PRadThreadTopology::PinWorker(unsigned int worker)
+const
+{
+    int node, core;
+    if(pin_mode == Pin_None || !workerPlace(worker, node, core))
+        return false;
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(pin_mode == Pin_Core) {
+        CPU_SET(core, &set);
+    } else {
+        for(auto &cpu : nodes[node].cpus)
+            CPU_SET(cpu, &set);
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if(err) {
+        std::cerr << "PRad Thread Topology Error: Failed to pin worker " << worker
+                  << " to " << ((pin_mode == Pin_Core) ? "core " : "node ")
+                  << ((pin_mode == Pin_Core) ? core : nodes[node].id)
+                  << ", error " << err << "." << std::endl;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+int PRadThreadTopology::GetWorkerNode(unsigned int worker)
+const
+{
+    int node, core;
+    if(!workerPlace(worker, node, core))
+        return -1;
+    return nodes[node].id;
+}
+
+int PRadThreadTopology::GetWorkerCore(unsigned int worker)
+const
+{
+    int node, core;
+    if(!workerPlace(worker, node, core))
+        return -1;
+    return core;
+}
+
+// anonymous mapping for a large buffer, the large ones are rounded to the
+// huge pages, reserved huge pages are used if there are, transparent huge
+// pages otherwise
+void *PRadThreadTopology::Allocate(size_t bytes)
+const
+{
+    if(!bytes)
+        return nullptr;
+
+    bool huge = bytes >= TOPOLOGY_HUGE_MIN;
+    size_t size = huge ? (bytes + TOPOLOGY_HUGE_PAGE - 1)/TOPOLOGY_HUGE_PAGE*TOPOLOGY_HUGE_PAGE
+                       : bytes;
+
+    void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if(huge_pages && huge)
+        ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+    if(ptr == MAP_FAILED) {
+        ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ptr == MAP_FAILED) {
+            std::cerr << "PRad Thread Topology Error: Failed to allocate "
+                      << bytes << " bytes." << std::endl;
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if(huge_pages && huge)
+            madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    return ptr;
+}
+
+// the same size as the allocation
+void PRadThreadTopology::Free(void *ptr, size_t bytes)
+const
+{
+    if(!ptr || !bytes)
+        return;
+
+    if(bytes >= TOPOLOGY_HUGE_MIN)
+        bytes = (bytes + TOPOLOGY_HUGE_PAGE - 1)/TOPOLOGY_HUGE_PAGE*TOPOLOGY_HUGE_PAGE;
+    munmap(ptr, bytes);
+}
+
+size_t PRadThreadTopology::GetCoreCount()
+const
+{
+    size_t count = 0;
+    for(auto &node : nodes)
+        count += node.cpus.size();
+    return count;
+}
+
+void PRadThreadTopology::PrintSummary(std::ostream &os)
+const
+{
+    static const char *modes[] = {"none", "node", "core"};
+
+    os << "Thread Topology: " << nodes.size() << " nodes, " << GetCoreCount()
+       << " cores, pin mode " << modes[pin_mode]
+       << ", " << (compact ? "compact" : "spread") << " placement"
+       << ", huge pages " << (huge_pages ? "on" : "off") << std::endl;
+
+    for(auto &node : nodes)
+    {
+        os << "    node " << std::setw(3) << node.id << ":";
+        for(auto &cpu : node.cpus)
+            os << " " << cpu;
+        os << std::endl;
+    }
+}
+
+// a list such as "0-15,32-47"
+std::vector<int> PRadThreadTopology::ParseCPUList(const std::string &list)
+{
+    std::vector<int> cpus;
+    for(auto &part : ConfigParser::split(list, ", \t\n"))
+    {
+        if(part.empty())
+            continue;
+
+        size_t dash = part.find('-');
+        try {
+            int first = std::stoi(part.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(part.substr(dash + 1));
+            for(int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        } catch(...) {
+            std::cerr << "PRad Thread Topology Error: Unknown cpu list part \""
+                      << part << "\"." << std::endl;
+        }
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+
+
+//============================================================================//
+// Private Member Functions                                                   //
+//============================================================================//
+
+// nodes from sysfs, only the cpus allowed for this process are kept
+void PRadThreadTopology::detectNodes()
+{
+    std::vector<int> allowed = allowedCPUs();
+
+    nodes.clear();
+    for(int i = 0; ; ++i)
+    {
+        std::ifstream in(std::string(TOPOLOGY_NODE_DIR) + "/node" + std::to_string(i) + "/cpulist");
+        if(!in.is_open())
+            break;
+
+        std::string list;
+        std::getline(in, list);
+
+        Node node;
+        node.id = i;
+        for(auto &cpu : ParseCPUList(list))
+        {
+            if(std::binary_search(allowed.begin(), allowed.end(), cpu))
+                node.cpus.push_back(cpu);
+        }
+        if(!node.cpus.empty())
+            nodes.emplace_back(std::move(node));
+    }
+
+    if(nodes.empty())
+        nodes.push_back(Node{0, allowed});
+}
+
+// sorted cpus of the process affinity
+std::vector<int> PRadThreadTopology::allowedCPUs()
+const
+{
+    std::vector<int> cpus;
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if(CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+#endif
+
+    if(cpus.empty()) {
+        unsigned int n = std::max(1u, std::thread::hardware_concurrency());
+        for(unsigned int cpu = 0; cpu < n; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// spread: the workers go to the nodes in turn, so a few workers already use
+//         all the sockets
+// compact: the cores of a node are filled before the next node
+bool PRadThreadTopology::workerPlace(unsigned int worker, int &node, int &core)
+const
+{
+    size_t ncores = GetCoreCount();
+    if(!ncores)
+        return false;
+
+    if(compact) {
+        size_t index = worker%ncores;
+        for(size_t i = 0; i < nodes.size(); ++i)
+        {
+            if(index < nodes[i].cpus.size()) {
+                node = i;
+                core = nodes[i].cpus[index];
+                return true;
+            }
+            index -= nodes[i].cpus.size();
+        }
+        return false;
+    }
+
+    node = worker%nodes.size();
+    auto &cpus = nodes[node].cpus;
+    core = cpus[(worker/nodes.size())%cpus.size()];
+    return true;
+}